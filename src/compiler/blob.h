@@ -252,6 +252,19 @@ blob_overwrite_intptr(struct blob *blob,
                       size_t offset,
                       intptr_t value);
 
+/**
+ * Add a uint32_t to a blob using a variable-length encoding.
+ *
+ * The value is written seven bits at a time, least significant bits first,
+ * with the top bit of each byte set when more bytes follow.  Values below 128
+ * take a single byte and no value takes more than five.  Unlike
+ * blob_write_uint32, no padding is ever added before the value.
+ *
+ * \return True unless allocation failed.
+ */
+bool
+blob_write_varint(struct blob *blob, uint32_t value);
+
 /**
  * Add a NULL-terminated string to a blob, (including the NULL terminator).
  *
@@ -330,6 +343,15 @@ blob_read_uint64(struct blob_reader *blob);
 intptr_t
 blob_read_intptr(struct blob_reader *blob);
 
+/**
+ * Read a uint32_t written by blob_write_varint from the current location,
+ * (and update the current location to just past it).
+ *
+ * \return The uint32_t read
+ */
+uint32_t
+blob_read_varint(struct blob_reader *blob);
+
 /**
  * Read a NULL-terminated string from the current location, (and update the
  * current location to just past this string).
@@ -75,6 +75,7 @@
 #include "program/program.h"
 #include "util/mesa-sha1.h"
 #include "util/set.h"
+#include "util/u_queue.h"
 #include "string_to_uint_map.h"
 #include "linker.h"
 #include "link_varyings.h"
@@ -4715,6 +4716,92 @@ link_varyings_and_uniforms(unsigned first, unsigned last,
    return true;
 }
 
+/* Worker threads for link_foreach_stage_parallel(), shared by all contexts
+ * and started the first time a program with more than one stage is linked.
+ */
+static struct util_queue link_queue;
+static bool link_queue_ok;
+static once_flag link_queue_once = ONCE_FLAG_INIT;
+
+static void
+init_link_queue(void)
+{
+   /* There are at most five graphics stages, and the thread doing the link
+    * takes one of them itself.
+    */
+   link_queue_ok = util_queue_init(&link_queue, "glsl_link",
+                                   MESA_SHADER_STAGES, MESA_SHADER_STAGES - 2,
+                                   0);
+}
+
+struct link_stage_job {
+   link_stage_func func;
+   struct gl_context *ctx;
+   struct gl_shader_program *prog;
+   struct gl_linked_shader *shader;
+   void *data;
+   struct util_queue_fence fence;
+};
+
+static void
+execute_link_stage_job(void *data, int thread_index)
+{
+   struct link_stage_job *job = (struct link_stage_job *) data;
+
+   job->func(job->ctx, job->prog, job->shader, job->data);
+}
+
+/**
+ * Call \p func for every linked shader in \p prog, on worker threads when
+ * there is more than one.
+ *
+ * \p func may only modify its own stage.  In particular it must not report
+ * link errors, and anything it allocates must come from that stage's IR
+ * context: see reparent_ir().
+ */
+void
+link_foreach_stage_parallel(struct gl_context *ctx,
+                            struct gl_shader_program *prog,
+                            link_stage_func func, void *data)
+{
+   struct link_stage_job jobs[MESA_SHADER_STAGES];
+   unsigned num_jobs = 0;
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (prog->_LinkedShaders[i] == NULL)
+         continue;
+
+      jobs[num_jobs].func = func;
+      jobs[num_jobs].ctx = ctx;
+      jobs[num_jobs].prog = prog;
+      jobs[num_jobs].shader = prog->_LinkedShaders[i];
+      jobs[num_jobs].data = data;
+      num_jobs++;
+   }
+
+   if (num_jobs > 1)
+      call_once(&link_queue_once, init_link_queue);
+
+   if (num_jobs <= 1 || !link_queue_ok) {
+      for (unsigned i = 0; i < num_jobs; i++)
+         execute_link_stage_job(&jobs[i], 0);
+      return;
+   }
+
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&link_queue, &jobs[i], &jobs[i].fence,
+                         execute_link_stage_job, NULL);
+   }
+
+   execute_link_stage_job(&jobs[0], 0);
+
+   for (unsigned i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
 static void
 linker_optimisation_loop(struct gl_context *ctx, exec_list *ir,
                          unsigned stage)
@@ -4733,6 +4820,32 @@ linker_optimisation_loop(struct gl_context *ctx, exec_list *ir,
       }
 }
 
+static void
+optimize_linked_stage(struct gl_context *ctx, struct gl_shader_program *prog,
+                      struct gl_linked_shader *shader, void *data)
+{
+   const gl_shader_stage stage = shader->Stage;
+
+   if (ctx->Const.ShaderCompilerOptions[stage].LowerCombinedClipCullDistance) {
+      lower_clip_cull_distance(prog, shader);
+   }
+
+   if (ctx->Const.LowerTessLevel) {
+      lower_tess_level(shader);
+   }
+
+   /* Call opts before lowering const arrays to uniforms so we can const
+    * propagate any elements accessed directly.
+    */
+   linker_optimisation_loop(ctx, shader->ir, stage);
+
+   /* Call opts after lowering const arrays to copy propagate things. */
+   if (lower_const_arrays_to_uniforms(shader->ir, stage))
+      linker_optimisation_loop(ctx, shader->ir, stage);
+
+   propagate_invariance(shader->ir);
+}
+
 void
 link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
 {
@@ -5029,10 +5142,6 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
    if (!interstage_cross_validate_uniform_blocks(prog, true))
       goto done;
 
-   /* Do common optimization before assigning storage for attributes,
-    * uniforms, and varyings.  Later optimization could possibly make
-    * some of that unused.
-    */
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
       if (prog->_LinkedShaders[i] == NULL)
          continue;
@@ -5041,26 +5150,19 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
       if (!prog->data->LinkStatus)
          goto done;
 
-      if (ctx->Const.ShaderCompilerOptions[i].LowerCombinedClipCullDistance) {
-         lower_clip_cull_distance(prog, prog->_LinkedShaders[i]);
-      }
-
-      if (ctx->Const.LowerTessLevel) {
-         lower_tess_level(prog->_LinkedShaders[i]);
-      }
-
-      /* Call opts before lowering const arrays to uniforms so we can const
-       * propagate any elements accessed directly.
+      /* Until now the IR of every stage has been allocated out of mem_ctx.
+       * Give each its own context so that the stages can be optimized in
+       * parallel.
        */
-      linker_optimisation_loop(ctx, prog->_LinkedShaders[i]->ir, i);
-
-      /* Call opts after lowering const arrays to copy propagate things. */
-      if (lower_const_arrays_to_uniforms(prog->_LinkedShaders[i]->ir, i))
-         linker_optimisation_loop(ctx, prog->_LinkedShaders[i]->ir, i);
-
-      propagate_invariance(prog->_LinkedShaders[i]->ir);
+      reparent_ir(prog->_LinkedShaders[i]->ir, prog->_LinkedShaders[i]->ir);
    }
 
+   /* Do common optimization before assigning storage for attributes,
+    * uniforms, and varyings.  Later optimization could possibly make
+    * some of that unused.
+    */
+   link_foreach_stage_parallel(ctx, prog, optimize_linked_stage, NULL);
+
    /* Validation for special cases where we allow sampler array indexing
     * with loop induction variable. This check emits a warning or error
     * depending if backend can handle dynamic indexing.
@@ -1288,20 +1288,13 @@ fail:
    blob_finish(&metadata);
 }
 
-bool
-shader_cache_read_program_metadata(struct gl_context *ctx,
-                                   struct gl_shader_program *prog)
+/**
+ * Compute the key the metadata of \p prog is stored under.
+ */
+static void
+compute_program_key(struct gl_context *ctx, struct disk_cache *cache,
+                    struct gl_shader_program *prog, cache_key key)
 {
-   /* Fixed function programs generated by Mesa are not cached. So don't
-    * try to read metadata for them from the cache.
-    */
-   if (prog->Name == 0)
-      return false;
-
-   struct disk_cache *cache = ctx->Cache;
-   if (!cache)
-      return false;
-
    /* Include bindings when creating sha1. These bindings change the resulting
     * binary so they are just as important as the shader source.
     */
@@ -1349,8 +1342,45 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
       ralloc_asprintf_append(&buf, "%s: %s\n",
                              _mesa_shader_stage_to_abbrev(sh->Stage), sha1buf);
    }
-   disk_cache_compute_key(cache, buf, strlen(buf), prog->data->sha1);
+   disk_cache_compute_key(cache, buf, strlen(buf), key);
    ralloc_free(buf);
+}
+
+/**
+ * Start loading the cached metadata of \p prog on the cache's thread, so
+ * that a link queued behind other work finds it in memory.
+ */
+void
+shader_cache_prefetch_program_metadata(struct gl_context *ctx,
+                                       struct gl_shader_program *prog)
+{
+   if (prog->Name == 0)
+      return;
+
+   struct disk_cache *cache = ctx->Cache;
+   if (!cache)
+      return;
+
+   cache_key key;
+   compute_program_key(ctx, cache, prog, key);
+   disk_cache_prefetch(cache, &key, 1);
+}
+
+bool
+shader_cache_read_program_metadata(struct gl_context *ctx,
+                                   struct gl_shader_program *prog)
+{
+   /* Fixed function programs generated by Mesa are not cached. So don't
+    * try to read metadata for them from the cache.
+    */
+   if (prog->Name == 0)
+      return false;
+
+   struct disk_cache *cache = ctx->Cache;
+   if (!cache)
+      return false;
+
+   compute_program_key(ctx, cache, prog, prog->data->sha1);
 
    size_t size;
    uint8_t *buffer = (uint8_t *) disk_cache_get(cache, prog->data->sha1,
@@ -1371,6 +1401,7 @@ shader_cache_read_program_metadata(struct gl_context *ctx,
    }
 
    if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
+      char sha1buf[41];
       _mesa_sha1_format(sha1buf, prog->data->sha1);
       fprintf(stderr, "loading shader program meta data from cache: %s\n",
               sha1buf);
@@ -34,4 +34,8 @@ bool
 shader_cache_read_program_metadata(struct gl_context *ctx,
                                    struct gl_shader_program *prog);
 
+void
+shader_cache_prefetch_program_metadata(struct gl_context *ctx,
+                                       struct gl_shader_program *prog);
+
 #endif /* GLSL_SYMBOL_TABLE */
@@ -0,0 +1,272 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Compare the shader cache compression codecs on a corpus of blobs.
+ *
+ * Usage: cache_bench <file or directory>...
+ *
+ * Every regular file found is stored in a fresh cache for each codec
+ * supported by this build, then read back from a newly created cache, once
+ * with plain gets and once prefetching every key first.  Throughput is
+ * reported in MB/s of uncompressed data, along with the space the cache
+ * takes on disk.  Set MESA_DISK_CACHE_SINGLE_FILE to measure the single
+ * file backend instead of the one file per entry one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ftw.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "util/disk_cache.h"
+#include "util/os_time.h"
+
+#ifdef ENABLE_SHADER_CACHE
+
+#define CACHE_BENCH_TMP "./cache-bench-tmp"
+
+struct blob_item {
+   uint8_t *data;
+   size_t size;
+   cache_key key;
+};
+
+static struct blob_item *corpus;
+static unsigned corpus_count, corpus_capacity;
+static uint64_t corpus_size;
+
+static uint64_t disk_usage;
+
+static int
+add_corpus_file(const char *path, const struct stat *sb, int typeflag,
+                struct FTW *ftwbuf)
+{
+   struct blob_item *item;
+   int fd;
+
+   if (typeflag != FTW_F || sb->st_size == 0)
+      return 0;
+
+   if (corpus_count == corpus_capacity) {
+      corpus_capacity = corpus_capacity ? corpus_capacity * 2 : 256;
+      corpus = realloc(corpus, corpus_capacity * sizeof(*corpus));
+      if (corpus == NULL)
+         return -1;
+   }
+
+   item = &corpus[corpus_count];
+   item->size = sb->st_size;
+   item->data = malloc(item->size);
+   if (item->data == NULL)
+      return -1;
+
+   fd = open(path, O_RDONLY);
+   if (fd == -1 || read(fd, item->data, item->size) != item->size) {
+      fprintf(stderr, "Error reading %s: %s\n", path, strerror(errno));
+      if (fd != -1)
+         close(fd);
+      free(item->data);
+      return 0;
+   }
+   close(fd);
+
+   corpus_count++;
+   corpus_size += item->size;
+
+   return 0;
+}
+
+static int
+add_disk_usage(const char *path, const struct stat *sb, int typeflag,
+               struct FTW *ftwbuf)
+{
+   if (typeflag == FTW_F)
+      disk_usage += sb->st_blocks * 512;
+
+   return 0;
+}
+
+static int
+remove_entry(const char *path, const struct stat *sb, int typeflag,
+             struct FTW *ftwbuf)
+{
+   return remove(path);
+}
+
+static double
+mb_per_s(uint64_t bytes, int64_t ns)
+{
+   return ns ? bytes / (1024.0 * 1024.0) / (ns / 1e9) : 0.0;
+}
+
+static void
+bench_codec(const char *codec)
+{
+   struct disk_cache *cache;
+   cache_key *keys;
+   int64_t start, put_ns, get_ns, prefetch_ns;
+   unsigned i, misses = 0;
+
+   nftw(CACHE_BENCH_TMP, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+
+   setenv("MESA_DISK_CACHE_COMPRESSION", codec, 1);
+
+   cache = disk_cache_create("bench", "cache_bench", 0);
+   if (cache == NULL) {
+      fprintf(stderr, "Failed to create a cache in " CACHE_BENCH_TMP "\n");
+      exit(1);
+   }
+
+   for (i = 0; i < corpus_count; i++) {
+      disk_cache_compute_key(cache, corpus[i].data, corpus[i].size,
+                             corpus[i].key);
+   }
+
+   start = os_time_get_nano();
+   for (i = 0; i < corpus_count; i++) {
+      disk_cache_put(cache, corpus[i].key, corpus[i].data, corpus[i].size,
+                     NULL);
+   }
+   disk_cache_wait_for_idle(cache);
+   put_ns = os_time_get_nano() - start;
+
+   disk_cache_destroy(cache);
+
+   /* Read back through a new cache, as an application starting up would. */
+   cache = disk_cache_create("bench", "cache_bench", 0);
+
+   start = os_time_get_nano();
+   for (i = 0; i < corpus_count; i++) {
+      size_t size;
+      void *data = disk_cache_get(cache, corpus[i].key, &size);
+
+      if (data == NULL || size != corpus[i].size)
+         misses++;
+      free(data);
+   }
+   get_ns = os_time_get_nano() - start;
+
+   disk_cache_destroy(cache);
+
+   /* Same again, warming the cache up front with a prefetch of every key. */
+   cache = disk_cache_create("bench", "cache_bench", 0);
+
+   keys = malloc(corpus_count * sizeof(cache_key));
+   for (i = 0; i < corpus_count; i++)
+      memcpy(keys[i], corpus[i].key, sizeof(cache_key));
+
+   start = os_time_get_nano();
+   disk_cache_prefetch(cache, keys, corpus_count);
+   disk_cache_wait_for_idle(cache);
+   for (i = 0; i < corpus_count; i++) {
+      size_t size;
+      void *data = disk_cache_get(cache, corpus[i].key, &size);
+
+      if (data == NULL || size != corpus[i].size)
+         misses++;
+      free(data);
+   }
+   prefetch_ns = os_time_get_nano() - start;
+
+   disk_cache_destroy(cache);
+   free(keys);
+
+   disk_usage = 0;
+   nftw(CACHE_BENCH_TMP, add_disk_usage, 64, FTW_PHYS);
+
+   printf("%-6s %10.1f %10.1f %13.1f %12" PRIu64 " %7.3f %7u\n", codec,
+          mb_per_s(corpus_size, put_ns), mb_per_s(corpus_size, get_ns),
+          mb_per_s(corpus_size, prefetch_ns), disk_usage,
+          corpus_size ? (double) disk_usage / corpus_size : 0.0, misses);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const char *codecs[] = {
+      "none",
+      "zlib",
+#ifdef HAVE_LZ4
+      "lz4",
+#endif
+#ifdef HAVE_ZSTD
+      "zstd",
+#endif
+   };
+   unsigned i;
+
+   if (argc < 2) {
+      fprintf(stderr, "Usage: %s <file or directory>...\n", argv[0]);
+      return 1;
+   }
+
+   for (i = 1; i < argc; i++) {
+      if (nftw(argv[i], add_corpus_file, 64, FTW_PHYS) != 0) {
+         fprintf(stderr, "Error reading corpus %s\n", argv[i]);
+         return 1;
+      }
+   }
+
+   if (corpus_count == 0) {
+      fprintf(stderr, "Empty corpus\n");
+      return 1;
+   }
+
+   printf("%u blobs, %" PRIu64 " bytes\n\n", corpus_count, corpus_size);
+   printf("%-6s %10s %10s %13s %12s %7s %7s\n", "codec", "put MB/s",
+          "get MB/s", "prefetch MB/s", "disk bytes", "ratio", "misses");
+
+   setenv("MESA_GLSL_CACHE_DIR", CACHE_BENCH_TMP, 1);
+   unsetenv("MESA_GLSL_CACHE_DISABLE");
+
+   /* Nothing should be evicted while measuring. */
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1024G", 1);
+   setenv("MESA_DISK_CACHE_MEMORY_SIZE", "1024G", 1);
+
+   for (i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++)
+      bench_codec(codecs[i]);
+
+   nftw(CACHE_BENCH_TMP, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+
+   for (i = 0; i < corpus_count; i++)
+      free(corpus[i].data);
+   free(corpus);
+
+   return 0;
+}
+
+#else
+
+int
+main(void)
+{
+   fprintf(stderr, "Shader cache support is disabled in this build.\n");
+   return 1;
+}
+
+#endif /* ENABLE_SHADER_CACHE */
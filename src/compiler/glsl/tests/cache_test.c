@@ -230,6 +230,8 @@ wait_until_file_written(struct disk_cache *cache, const cache_key key)
    struct timespec req;
    struct timespec rem;
 
+   disk_cache_wait_for_idle(cache);
+
    /* Set 100ms delay */
    req.tv_sec = 0;
    req.tv_nsec = 100000000;
@@ -477,6 +479,177 @@ test_put_key_and_get_key(void)
 
    disk_cache_destroy(cache);
 }
+
+static void
+test_single_file(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   uint8_t *items[3];
+   uint8_t item_keys[3][20];
+   char *result;
+   size_t size;
+   struct stat sb;
+   int i, j;
+
+   setenv("MESA_DISK_CACHE_SINGLE_FILE", "true", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+
+   cache = disk_cache_create("test", "make_check", 0);
+
+   expect_true(stat(CACHE_TEST_TMP "/mesa-glsl-cache-dir/" CACHE_DIR_NAME
+                    "/pack.idx", &sb) == 0,
+               "single file cache index created");
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "single file disk_cache_get (pointer)");
+   expect_equal(size, sizeof(blob), "single file disk_cache_get (size)");
+   free(result);
+
+   /* Entries must survive reopening the cache. */
+   disk_cache_destroy(cache);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   expect_true(does_cache_contain(cache, blob_key),
+               "single file entry persists across disk_cache_create");
+
+   disk_cache_remove(cache, blob_key);
+   expect_true(!does_cache_contain(cache, blob_key),
+               "single file disk_cache_remove");
+
+   /* Three incompressible 400KB items don't fit in 1MB, the least recently
+    * used one should be evicted to make room for the last one.
+    */
+   for (i = 0; i < 3; i++) {
+      items[i] = malloc(400 * 1024);
+      for (j = 0; j < 400 * 1024; j++)
+         items[i][j] = rand();
+
+      disk_cache_compute_key(cache, items[i], 400 * 1024, item_keys[i]);
+      disk_cache_put(cache, item_keys[i], items[i], 400 * 1024, NULL);
+      wait_until_file_written(cache, item_keys[i]);
+   }
+
+   expect_true(!does_cache_contain(cache, item_keys[0]),
+               "single file eviction of the least recently used item");
+   expect_true(does_cache_contain(cache, item_keys[1]),
+               "single file eviction keeps recently used items");
+
+   result = disk_cache_get(cache, item_keys[2], &size);
+   expect_true(result && size == 400 * 1024 &&
+               memcmp(result, items[2], size) == 0,
+               "single file get of the item causing the eviction");
+   free(result);
+
+   for (i = 0; i < 3; i++)
+      free(items[i]);
+
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_DISK_CACHE_SINGLE_FILE");
+}
+
+static void
+test_compression(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   char *result;
+   size_t size;
+
+   setenv("MESA_DISK_CACHE_COMPRESSION", "none", 1);
+
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "uncompressed disk_cache_get (pointer)");
+   expect_equal(size, sizeof(blob), "uncompressed disk_cache_get (size)");
+   free(result);
+
+   disk_cache_destroy(cache);
+
+   /* The codec is recorded per entry, so changing it must not lose any. */
+   unsetenv("MESA_DISK_CACHE_COMPRESSION");
+   cache = disk_cache_create("test", "make_check", 0);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "get after changing the codec (pointer)");
+   expect_equal(size, sizeof(blob), "get after changing the codec (size)");
+   free(result);
+
+   disk_cache_remove(cache, blob_key);
+   disk_cache_destroy(cache);
+}
+
+static void
+test_memory_cache(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   char string[] = "While this string has thirty-four";
+   uint8_t string_key[20];
+   cache_key keys[2];
+   char *result;
+   size_t size;
+   int err;
+
+   setenv("MESA_DISK_CACHE_MEMORY_SIZE", "1M", 1);
+
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_compute_key(cache, string, sizeof(string), string_key);
+
+   /* Items are available from memory before being written out. */
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "disk_cache_get from memory (pointer)");
+   expect_equal(size, sizeof(blob), "disk_cache_get from memory (size)");
+   free(result);
+
+   disk_cache_put(cache, string_key, string, sizeof(string), NULL);
+   disk_cache_wait_for_idle(cache);
+   disk_cache_destroy(cache);
+
+   /* Prefetched items must still be returned once the files are gone. */
+   cache = disk_cache_create("test", "make_check", 0);
+
+   memcpy(keys[0], blob_key, sizeof(cache_key));
+   memcpy(keys[1], string_key, sizeof(cache_key));
+   disk_cache_prefetch(cache, keys, 2);
+   disk_cache_wait_for_idle(cache);
+
+   err = rmrf_local(CACHE_TEST_TMP "/mesa-glsl-cache-dir");
+   expect_equal(err, 0, "Removing the cache directory after prefetching");
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "disk_cache_get of prefetched item");
+   free(result);
+
+   result = disk_cache_get(cache, string_key, &size);
+   expect_equal_str(string, result, "2nd disk_cache_get of prefetched item");
+   expect_equal(size, sizeof(string), "disk_cache_get of prefetched item size");
+   free(result);
+
+   disk_cache_remove(cache, blob_key);
+   expect_true(!does_cache_contain(cache, blob_key),
+               "disk_cache_remove drops the item from memory");
+
+   disk_cache_destroy(cache);
+
+   setenv("MESA_DISK_CACHE_MEMORY_SIZE", "0", 1);
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 int
@@ -485,12 +658,21 @@ main(void)
 #ifdef ENABLE_SHADER_CACHE
    int err;
 
+   /* Most tests check what ends up on disk, keep entries out of memory. */
+   setenv("MESA_DISK_CACHE_MEMORY_SIZE", "0", 1);
+
    test_disk_cache_create();
 
    test_put_and_get();
 
    test_put_key_and_get_key();
 
+   test_single_file();
+
+   test_compression();
+
+   test_memory_cache();
+
    err = rmrf_local(CACHE_TEST_TMP);
    expect_equal(err, 0, "Removing " CACHE_TEST_TMP " again");
 #endif /* ENABLE_SHADER_CACHE */
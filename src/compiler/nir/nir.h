@@ -2704,6 +2704,7 @@ bool nir_opt_algebraic(nir_shader *shader);
 bool nir_opt_algebraic_before_ffma(nir_shader *shader);
 bool nir_opt_algebraic_late(nir_shader *shader);
 bool nir_opt_constant_folding(nir_shader *shader);
+nir_ssa_def *nir_constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx);
 
 bool nir_opt_global_to_local(nir_shader *shader);
 
@@ -25,6 +25,7 @@
 
 from __future__ import print_function
 import ast
+from collections import defaultdict
 import itertools
 import struct
 import sys
@@ -495,113 +496,329 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class TreeAutomaton(object):
+   """A bottom-up tree automaton recognizing the search patterns of a pass.
+
+   Every SSA value gets a state, which stands for the set of pattern
+   subtrees ("items") the value might match when only opcodes and the
+   shape of the expression are taken into account.  The state of an ALU
+   instruction is looked up from its opcode and the states of its sources
+   in a transition table, so a single walk over the shader tells which
+   patterns are worth handing to nir_replace_instr() for each instruction,
+   rather than trying every pattern for the opcode in turn.
+
+   Variables, constants, conditions, bit sizes and exactness are not
+   tracked here.  The automaton only rules candidates out, nir_search still
+   does the precise matching.
+
+   To keep the tables small, source states are first mapped to "filtered"
+   states which only keep the items that can be a source of the given
+   opcode, following the construction in "Tree Automata" by Cleophas
+   (algorithm 5.7.38).
+   """
+
+   class IndexMap(object):
+      """A list which can also find the index of an object in constant time."""
+      def __init__(self):
+         self.objects = []
+         self.map = {}
+
+      def __getitem__(self, i):
+         return self.objects[i]
+
+      def __contains__(self, obj):
+         return obj in self.map
+
+      def __len__(self):
+         return len(self.objects)
+
+      def __iter__(self):
+         return iter(self.objects)
+
+      def index(self, obj):
+         return self.map[obj]
+
+      def add(self, obj):
+         if obj not in self.map:
+            self.map[obj] = len(self.objects)
+            self.objects.append(obj)
+         return self.map[obj]
+
+   class Item(object):
+      """A subtree of one or more search patterns.
+
+      Identical subtrees are shared between patterns.
+      """
+      def __init__(self, opcode, children):
+         self.opcode = opcode
+         self.children = children
+         # Indices of the patterns this item is the root of
+         self.patterns = []
+         # Opcodes of the expressions this item is a source of
+         self.parent_ops = set()
+
+   def __init__(self, patterns):
+      self._compute_items(patterns)
+      self._build_table()
+
+   def _compute_items(self, patterns):
+      # Map from (opcode, children) to item
+      self.items = {}
+      # Opcodes used by the patterns, the only ones needing a table
+      self.opcodes = self.IndexMap()
+
+      def get_item(opcode, children):
+         key = (opcode, children)
+         if key not in self.items:
+            item = self.Item(opcode, children)
+            self.items[key] = item
+            # nir_search tries both orders of commutative sources
+            if len(children) == 2 and \
+               "commutative" in opcodes[opcode].algebraic_properties:
+               self.items[(opcode, (children[1], children[0]))] = item
+         return self.items[key]
+
+      self.wildcard = get_item("__wildcard", ())
+      self.const = get_item("__const", ())
+
+      def process(val):
+         if isinstance(val, Constant):
+            return self.const
+         elif isinstance(val, Variable):
+            return self.const if val.is_constant else self.wildcard
+         else:
+            assert isinstance(val, Expression)
+            self.opcodes.add(val.opcode)
+            children = tuple(process(src) for src in val.sources)
+            for child in children:
+               child.parent_ops.add(val.opcode)
+            return get_item(val.opcode, children)
+
+      for i, pattern in enumerate(patterns):
+         process(pattern).patterns.append(i)
+
+   def _build_table(self):
+      # All the states found so far, each a frozenset of items
+      self.states = self.IndexMap()
+      # Sorted pattern indices matched by each state
+      self.state_patterns = []
+      # Map from state to filtered state, for each opcode
+      self.filter = defaultdict(list)
+      # The filtered states of each opcode
+      self.rep = defaultdict(self.IndexMap)
+      # Map from tuples of filtered source states to state, for each opcode
+      self.table = defaultdict(dict)
+
+      # Filtered states below this index have been combined already
+      done_rep = defaultdict(int)
+      # Opcodes with new filtered states
+      new_opcodes = set()
+
+      def process_new_states():
+         while len(self.state_patterns) < len(self.states):
+            state = self.states[len(self.state_patterns)]
+
+            # Patterns are tried in the order they were given
+            self.state_patterns.append(sorted(p for item in state
+                                              for p in item.patterns))
+
+            for op in self.opcodes:
+               filtered = frozenset(item for item in state
+                                    if op in item.parent_ops)
+               if filtered not in self.rep[op]:
+                  new_opcodes.add(op)
+               self.filter[op].append(self.rep[op].add(filtered))
+
+      # The states of values which aren't ALU instructions and of
+      # load_const instructions.  These must match the WILDCARD_STATE and
+      # CONST_STATE defines in nir_search.h.
+      self.states.add(frozenset((self.wildcard,)))
+      self.states.add(frozenset((self.wildcard, self.const)))
+      process_new_states()
+
+      while new_opcodes:
+         for op in sorted(new_opcodes):
+            rep = self.rep[op]
+            num_srcs = opcodes[op].num_inputs
+
+            # Visit every combination involving a new filtered state
+            for srcs in itertools.product(range(len(rep)), repeat=num_srcs):
+               if all(src < done_rep[op] for src in srcs):
+                  continue
+
+               items = set([self.wildcard])
+               for children in itertools.product(*(rep[src] for src in srcs)):
+                  if (op, children) in self.items:
+                     items.add(self.items[(op, children)])
+
+               self.table[op][srcs] = self.states.add(frozenset(items))
+
+            done_rep[op] = len(rep)
+
+         new_opcodes.clear()
+         process_new_states()
+
+   def flat_table(self, op):
+      """The transition table of an opcode, in the order nir_search indexes
+      it: sources are the digits of a number in base num_filtered_states,
+      the first source being the most significant one.
+      """
+      num_srcs = opcodes[op].num_inputs
+      return [self.table[op][srcs] for srcs in
+              itertools.product(range(len(self.rep[op])), repeat=num_srcs)]
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
 #include "nir_search_helpers.h"
 
-#ifndef NIR_OPT_ALGEBRAIC_STRUCT_DEFS
-#define NIR_OPT_ALGEBRAIC_STRUCT_DEFS
+% for xform in xforms:
+   ${xform.search.render()}
+   ${xform.replace.render()}
+% endfor
 
-struct transform {
-   const nir_search_expression *search;
-   const nir_search_value *replace;
-   unsigned condition_offset;
+% for state_id, patterns in enumerate(automaton.state_patterns):
+% if patterns:
+static const struct transform ${pass_name}_state${state_id}_xforms[] = {
+% for i in patterns:
+   { &${xforms[i].search.name}, ${xforms[i].replace.c_ptr}, ${xforms[i].condition_index} },
+% endfor
 };
+% endif
+% endfor
 
-#endif
-
-% for (opcode, xform_list) in xform_dict.iteritems():
-% for xform in xform_list:
-   ${xform.search.render()}
-   ${xform.replace.render()}
+static const struct transform *${pass_name}_transforms[] = {
+% for state_id, patterns in enumerate(automaton.state_patterns):
+% if patterns:
+   ${pass_name}_state${state_id}_xforms,
+% else:
+   NULL,
+% endif
 % endfor
+};
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
-% for xform in xform_list:
-   { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
+static const uint16_t ${pass_name}_transform_counts[] = {
+<% counts = [len(patterns) for patterns in automaton.state_patterns] %>\\
+% for i in range(0, len(counts), 16):
+   ${', '.join(str(e) for e in counts[i:i + 16])},
 % endfor
 };
+
+% for op in automaton.opcodes:
+static const uint16_t ${pass_name}_${op}_filter[] = {
+% for i in range(0, len(automaton.filter[op]), 16):
+   ${', '.join(str(e) for e in automaton.filter[op][i:i + 16])},
 % endfor
+};
 
-static bool
-${pass_name}_block(nir_block *block, const bool *condition_flags,
-                   void *mem_ctx)
-{
-   bool progress = false;
+static const uint16_t ${pass_name}_${op}_table[] = {
+<% table = automaton.flat_table(op) %>\\
+% for i in range(0, len(table), 16):
+   ${', '.join(str(e) for e in table[i:i + 16])},
+% endfor
+};
 
-   nir_foreach_instr_reverse_safe(instr, block) {
-      if (instr->type != nir_instr_type_alu)
-         continue;
-
-      nir_alu_instr *alu = nir_instr_as_alu(instr);
-      if (!alu->dest.dest.is_ssa)
-         continue;
-
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
-            if (condition_flags[xform->condition_offset] &&
-                nir_replace_instr(alu, xform->search, xform->replace,
-                                  mem_ctx)) {
-               progress = true;
-               break;
-            }
-         }
-         break;
-      % endfor
-      default:
-         break;
-      }
-   }
+% endfor
+static const struct per_op_table ${pass_name}_table[nir_num_opcodes] = {
+% for op in automaton.opcodes:
+   [nir_op_${op}] = {
+      ${pass_name}_${op}_filter,
+      ${len(automaton.rep[op])},
+      ${pass_name}_${op}_table,
+   },
+% endfor
+};
 
-   return progress;
-}
+<%def name="condition_flags()">\\
+   bool condition_flags[${len(condition_list)}];
+   const nir_shader_compiler_options *options = shader->options;
+   (void) options;
 
-static bool
-${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
+   % for index, condition in enumerate(condition_list):
+   condition_flags[${index}] = ${condition};
+   % endfor
+</%def>\\
+bool
+${pass_name}(nir_shader *shader)
 {
-   void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
-
-   nir_foreach_block_reverse(block, impl) {
-      progress |= ${pass_name}_block(block, condition_flags, mem_ctx);
+${condition_flags()}
+   nir_foreach_function(function, shader) {
+      if (function->impl)
+         progress |= nir_algebraic_impl(function->impl, condition_flags,
+                                       ${pass_name}_transforms,
+                                       ${pass_name}_transform_counts,
+                                       ${pass_name}_table);
    }
 
-   if (progress)
-      nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
-
    return progress;
 }
+% if reference:
+
+/* The transforms by opcode of their search expression, for the reference
+ * matcher the tests compare the automaton against.
+ */
+% for op, indices in op_xforms:
+static const struct transform ${pass_name}_${op}_xforms[] = {
+% for i in indices:
+   { &${xforms[i].search.name}, ${xforms[i].replace.c_ptr}, ${xforms[i].condition_index} },
+% endfor
+};
 
+% endfor
+static const struct transform *${pass_name}_op_transforms[nir_num_opcodes] = {
+% for op, indices in op_xforms:
+   [nir_op_${op}] = ${pass_name}_${op}_xforms,
+% endfor
+};
+
+static const uint16_t ${pass_name}_op_transform_counts[nir_num_opcodes] = {
+% for op, indices in op_xforms:
+   [nir_op_${op}] = ${len(indices)},
+% endfor
+};
 
 bool
-${pass_name}(nir_shader *shader)
+${pass_name}_reference(nir_shader *shader)
 {
    bool progress = false;
-   bool condition_flags[${len(condition_list)}];
-   const nir_shader_compiler_options *options = shader->options;
-   (void) options;
+${condition_flags()}
+   nir_foreach_function(function, shader) {
+      if (function->impl)
+         progress |= nir_algebraic_reference_impl(function->impl,
+                                                  condition_flags,
+                                                  ${pass_name}_op_transforms,
+                                                  ${pass_name}_op_transform_counts);
+   }
 
-   % for index, condition in enumerate(condition_list):
-   condition_flags[${index}] = ${condition};
-   % endfor
+   return progress;
+}
 
+unsigned
+${pass_name}_check_automaton(nir_shader *shader, unsigned *num_matched)
+{
+   unsigned num_mismatches = 0;
+${condition_flags()}
    nir_foreach_function(function, shader) {
       if (function->impl)
-         progress |= ${pass_name}_impl(function->impl, condition_flags);
+         num_mismatches +=
+            nir_algebraic_check_automaton(function->impl, condition_flags,
+                                          ${pass_name}_transforms,
+                                          ${pass_name}_transform_counts,
+                                          ${pass_name}_table,
+                                          ${pass_name}_op_transforms,
+                                          ${pass_name}_op_transform_counts,
+                                          num_matched);
    }
 
-   return progress;
+   return num_mismatches;
 }
+% endif
 """)
 
 class AlgebraicPass(object):
    def __init__(self, pass_name, transforms):
-      self.xform_dict = {}
+      self.xforms = []
       self.pass_name = pass_name
 
       error = False
@@ -618,15 +835,29 @@ class AlgebraicPass(object):
                error = True
                continue
 
-         if xform.search.opcode not in self.xform_dict:
-            self.xform_dict[xform.search.opcode] = []
-
-         self.xform_dict[xform.search.opcode].append(xform)
+         self.xforms.append(xform)
 
       if error:
          sys.exit(1)
 
-   def render(self):
+      self.automaton = TreeAutomaton(xform.search for xform in self.xforms)
+
+   def render(self, reference=False):
+      """Render the C code of the pass.
+
+      With reference set, also render ${pass_name}_reference(), which tries
+      every transform rooted at the opcode of each instruction in turn like
+      the generated code did before the automaton, and
+      ${pass_name}_check_automaton(), which compares the two matchers.
+      They are only meant for the tests and benchmarks.
+      """
+      op_xforms = defaultdict(list)
+      for i, xform in enumerate(self.xforms):
+         op_xforms[xform.search.opcode].append(i)
+
       return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
-                                             condition_list=condition_list)
+                                             xforms=self.xforms,
+                                             automaton=self.automaton,
+                                             condition_list=condition_list,
+                                             reference=reference,
+                                             op_xforms=sorted(op_xforms.items()))
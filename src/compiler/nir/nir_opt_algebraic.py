@@ -587,8 +587,10 @@ late_optimizations = [
    (('fmax', ('fadd(is_used_once)', '#c', a), ('fadd(is_used_once)', '#c', b)), ('fadd', c, ('fmax', a, b))),
 ]
 
-print nir_algebraic.AlgebraicPass("nir_opt_algebraic", optimizations).render()
-print nir_algebraic.AlgebraicPass("nir_opt_algebraic_before_ffma",
-                                  before_ffma_optimizations).render()
-print nir_algebraic.AlgebraicPass("nir_opt_algebraic_late",
-                                  late_optimizations).render()
+# The tests import the lists above to build their own passes from them.
+if __name__ == '__main__':
+   print nir_algebraic.AlgebraicPass("nir_opt_algebraic", optimizations).render()
+   print nir_algebraic.AlgebraicPass("nir_opt_algebraic_before_ffma",
+                                     before_ffma_optimizations).render()
+   print nir_algebraic.AlgebraicPass("nir_opt_algebraic_late",
+                                     late_optimizations).render()
@@ -38,13 +38,20 @@ struct constant_fold_state {
    bool progress;
 };
 
-static bool
-constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx)
+/**
+ * Evaluate an ALU instruction whose sources are all load_const and insert
+ * the result as a new load_const right before it.  Uses of the instruction
+ * are left alone, so that callers can track what they rewrite.
+ *
+ * \return the folded value, or NULL if the instruction can't be folded.
+ */
+nir_ssa_def *
+nir_constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx)
 {
    nir_const_value src[4];
 
-   if (!instr->dest.dest.is_ssa)
-      return false;
+   if (!instr->dest.dest.is_ssa || instr->dest.saturate)
+      return NULL;
 
    /* In the case that any outputs/inputs have unsized types, then we need to
     * guess the bit-size. In this case, the validator ensures that all
@@ -60,8 +67,9 @@ constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx)
       bit_size = instr->dest.dest.ssa.bit_size;
 
    for (unsigned i = 0; i < nir_op_infos[instr->op].num_inputs; i++) {
-      if (!instr->src[i].src.is_ssa)
-         return false;
+      if (!instr->src[i].src.is_ssa ||
+          instr->src[i].abs || instr->src[i].negate)
+         return NULL;
 
       if (bit_size == 0 &&
           !nir_alu_type_get_type_size(nir_op_infos[instr->op].input_sizes[i])) {
@@ -71,7 +79,7 @@ constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx)
       nir_instr *src_instr = instr->src[i].src.ssa->parent_instr;
 
       if (src_instr->type != nir_instr_type_load_const)
-         return false;
+         return NULL;
       nir_load_const_instr* load_const = nir_instr_as_load_const(src_instr);
 
       for (unsigned j = 0; j < nir_ssa_alu_instr_src_components(instr, i);
@@ -81,17 +89,11 @@ constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx)
          else
             src[i].u32[j] = load_const->value.u32[instr->src[i].swizzle[j]];
       }
-
-      /* We shouldn't have any source modifiers in the optimization loop. */
-      assert(!instr->src[i].abs && !instr->src[i].negate);
    }
 
    if (bit_size == 0)
       bit_size = 32;
 
-   /* We shouldn't have any saturate modifiers in the optimization loop. */
-   assert(!instr->dest.saturate);
-
    nir_const_value dest =
       nir_eval_const_opcode(instr->op, instr->dest.dest.ssa.num_components,
                             bit_size, src);
@@ -105,8 +107,17 @@ constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx)
 
    nir_instr_insert_before(&instr->instr, &new_instr->instr);
 
-   nir_ssa_def_rewrite_uses(&instr->dest.dest.ssa,
-                            nir_src_for_ssa(&new_instr->def));
+   return &new_instr->def;
+}
+
+static bool
+constant_fold_alu_instr(nir_alu_instr *instr, void *mem_ctx)
+{
+   nir_ssa_def *def = nir_constant_fold_alu_instr(instr, mem_ctx);
+   if (!def)
+      return false;
+
+   nir_ssa_def_rewrite_uses(&instr->dest.dest.ssa, nir_src_for_ssa(def));
 
    nir_instr_remove(&instr->instr);
    ralloc_free(instr);
@@ -27,14 +27,33 @@
 
 #include <inttypes.h>
 #include "nir_search.h"
+#include "nir_worklist.h"
+
+/* nir_instr::pass_flags bits used by nir_algebraic_impl() */
+#define ALGEBRAIC_QUEUED  (1 << 0)
+#define ALGEBRAIC_REMOVED (1 << 1)
 
 struct match_state {
    bool inexact_match;
    bool has_exact_alu;
    unsigned variables_seen;
    nir_alu_src variables[NIR_SEARCH_MAX_VARIABLES];
+
+   /* Automaton states to keep up to date for the instructions we create,
+    * NULL when not called from nir_algebraic_impl().
+    */
+   struct util_dynarray *states;
+   const struct per_op_table *pass_op_table;
+   nir_instr_worklist *worklist;
 };
 
+static bool
+nir_algebraic_automaton(nir_instr *instr, struct util_dynarray *states,
+                        const struct per_op_table *pass_op_table);
+
+static void
+nir_algebraic_queue(nir_instr_worklist *worklist, nir_instr *instr);
+
 static bool
 match_expression(const nir_search_expression *expr, nir_alu_instr *instr,
                  unsigned num_components, const uint8_t *swizzle,
@@ -449,6 +468,7 @@ construct_value(const nir_search_value *value,
          num_components = nir_op_infos[expr->opcode].output_size;
 
       nir_alu_instr *alu = nir_alu_instr_create(mem_ctx, expr->opcode);
+      alu->instr.pass_flags = 0;
       nir_ssa_dest_init(&alu->instr, &alu->dest.dest, num_components,
                         bitsize->dest_size, NULL);
       alu->dest.write_mask = (1 << num_components) - 1;
@@ -475,6 +495,12 @@ construct_value(const nir_search_value *value,
 
       nir_instr_insert_before(instr, &alu->instr);
 
+      if (state->states) {
+         nir_algebraic_automaton(&alu->instr, state->states,
+                                 state->pass_op_table);
+         nir_algebraic_queue(state->worklist, &alu->instr);
+      }
+
       nir_alu_src val;
       val.src = nir_src_for_ssa(&alu->dest.dest.ssa);
       val.negate = false;
@@ -553,6 +579,10 @@ construct_value(const nir_search_value *value,
 
       nir_instr_insert_before(instr, &load->instr);
 
+      if (state->states)
+         nir_algebraic_automaton(&load->instr, state->states,
+                                 state->pass_op_table);
+
       nir_alu_src val;
       val.src = nir_src_for_ssa(&load->def);
       val.negate = false;
@@ -567,9 +597,30 @@ construct_value(const nir_search_value *value,
    }
 }
 
-nir_alu_instr *
-nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
-                  const nir_search_value *replace, void *mem_ctx)
+/**
+ * Whether a source can stand in for the value of a whole instruction with
+ * the given number of components and bit size, without a mov.
+ */
+static bool
+alu_src_is_trivial(const nir_alu_src *src, unsigned num_components,
+                   unsigned bit_size)
+{
+   if (!src->src.is_ssa || src->abs || src->negate ||
+       src->src.ssa->num_components != num_components ||
+       src->src.ssa->bit_size != bit_size)
+      return false;
+
+   for (unsigned i = 0; i < num_components; i++) {
+      if (src->swizzle[i] != i)
+         return false;
+   }
+
+   return true;
+}
+
+static bool
+match_instr(nir_alu_instr *instr, const nir_search_expression *search,
+            struct match_state *state)
 {
    uint8_t swizzle[4] = { 0, 0, 0, 0 };
 
@@ -578,13 +629,28 @@ nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
 
    assert(instr->dest.dest.is_ssa);
 
+   state->inexact_match = false;
+   state->has_exact_alu = false;
+   state->variables_seen = 0;
+
+   return match_expression(search, instr, instr->dest.dest.ssa.num_components,
+                           swizzle, state);
+}
+
+static nir_ssa_def *
+replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
+              const nir_search_value *replace,
+              struct util_dynarray *states,
+              const struct per_op_table *pass_op_table,
+              nir_instr_worklist *worklist,
+              void *mem_ctx)
+{
    struct match_state state;
-   state.inexact_match = false;
-   state.has_exact_alu = false;
-   state.variables_seen = 0;
+   state.states = states;
+   state.pass_op_table = pass_op_table;
+   state.worklist = worklist;
 
-   if (!match_expression(search, instr, instr->dest.dest.ssa.num_components,
-                         swizzle, &state))
+   if (!match_instr(instr, search, &state))
       return NULL;
 
    void *bitsize_ctx = ralloc_context(NULL);
@@ -592,23 +658,40 @@ nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
    bitsize_tree_filter_up(tree);
    bitsize_tree_filter_down(tree, instr->dest.dest.ssa.bit_size);
 
-   /* Inserting a mov may be unnecessary.  However, it's much easier to
-    * simply let copy propagation clean this up than to try to go through
-    * and rewrite swizzles ourselves.
-    */
-   nir_alu_instr *mov = nir_alu_instr_create(mem_ctx, nir_op_imov);
-   mov->dest.write_mask = instr->dest.write_mask;
-   nir_ssa_dest_init(&mov->instr, &mov->dest.dest,
-                     instr->dest.dest.ssa.num_components,
-                     instr->dest.dest.ssa.bit_size, NULL);
+   nir_alu_src val = construct_value(replace,
+                                     instr->dest.dest.ssa.num_components,
+                                     tree, &state, &instr->instr, mem_ctx);
+   nir_ssa_def *def;
+
+   if (worklist && alu_src_is_trivial(&val, instr->dest.dest.ssa.num_components,
+                                      instr->dest.dest.ssa.bit_size)) {
+      /* The replacement value can be used as it is, which saves waiting for
+       * copy propagation before the users can match against it.
+       */
+      def = val.src.ssa;
+   } else {
+      /* Inserting a mov may be unnecessary.  However, it's much easier to
+       * simply let copy propagation clean this up than to try to go through
+       * and rewrite swizzles ourselves.
+       */
+      nir_alu_instr *mov = nir_alu_instr_create(mem_ctx, nir_op_imov);
+      mov->instr.pass_flags = 0;
+      mov->dest.write_mask = instr->dest.write_mask;
+      nir_ssa_dest_init(&mov->instr, &mov->dest.dest,
+                        instr->dest.dest.ssa.num_components,
+                        instr->dest.dest.ssa.bit_size, NULL);
+      mov->src[0] = val;
+      nir_instr_insert_before(&instr->instr, &mov->instr);
+
+      if (states) {
+         nir_algebraic_automaton(&mov->instr, states, pass_op_table);
+         nir_algebraic_queue(worklist, &mov->instr);
+      }
 
-   mov->src[0] = construct_value(replace,
-                                 instr->dest.dest.ssa.num_components, tree,
-                                 &state, &instr->instr, mem_ctx);
-   nir_instr_insert_before(&instr->instr, &mov->instr);
+      def = &mov->dest.dest.ssa;
+   }
 
-   nir_ssa_def_rewrite_uses(&instr->dest.dest.ssa,
-                            nir_src_for_ssa(&mov->dest.dest.ssa));
+   nir_ssa_def_rewrite_uses(&instr->dest.dest.ssa, nir_src_for_ssa(def));
 
    /* We know this one has no more uses because we just rewrote them all,
     * so we can remove it.  The rest of the matched expression, however, we
@@ -618,5 +701,387 @@ nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
 
    ralloc_free(bitsize_ctx);
 
-   return mov;
+   return def;
+}
+
+nir_alu_instr *
+nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
+                  const nir_search_value *replace, void *mem_ctx)
+{
+   nir_ssa_def *def = replace_instr(instr, search, replace,
+                                    NULL, NULL, NULL, mem_ctx);
+
+   return def ? nir_instr_as_alu(def->parent_instr) : NULL;
+}
+
+/**
+ * Get the automaton state of an SSA value, growing the array for values
+ * created since the states were first computed.
+ */
+static uint16_t *
+get_state(struct util_dynarray *states, unsigned index)
+{
+   const unsigned size = (index + 1) * sizeof(uint16_t);
+
+   if (states->size < size) {
+      const unsigned old_size = states->size;
+      util_dynarray_resize(states, size);
+      memset((char *)states->data + old_size, 0, size - old_size);
+   }
+
+   return util_dynarray_element(states, uint16_t, index);
+}
+
+/**
+ * Compute the automaton state of the value an instruction defines, from
+ * the states of its sources.  See struct per_op_table.
+ *
+ * \return whether the state changed.
+ */
+static bool
+nir_algebraic_automaton(nir_instr *instr, struct util_dynarray *states,
+                        const struct per_op_table *pass_op_table)
+{
+   switch (instr->type) {
+   case nir_instr_type_alu: {
+      nir_alu_instr *alu = nir_instr_as_alu(instr);
+      const struct per_op_table *tbl = &pass_op_table[alu->op];
+      uint16_t new_state = WILDCARD_STATE;
+
+      if (!alu->dest.dest.is_ssa)
+         return false;
+
+      if (tbl->num_filtered_states != 0) {
+         unsigned index = 0;
+
+         /* Must match the order TreeAutomaton.flat_table() emits in */
+         for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+            uint16_t src_state = WILDCARD_STATE;
+
+            if (alu->src[i].src.is_ssa)
+               src_state = *get_state(states, alu->src[i].src.ssa->index);
+
+            index = index * tbl->num_filtered_states + tbl->filter[src_state];
+         }
+
+         new_state = tbl->table[index];
+      }
+
+      uint16_t *state = get_state(states, alu->dest.dest.ssa.index);
+      if (*state == new_state)
+         return false;
+
+      *state = new_state;
+      return true;
+   }
+
+   case nir_instr_type_load_const: {
+      nir_load_const_instr *load = nir_instr_as_load_const(instr);
+      *get_state(states, load->def.index) = CONST_STATE;
+      return false;
+   }
+
+   default:
+      /* Everything else is WILDCARD_STATE, which get_state() starts with */
+      return false;
+   }
+}
+
+static void
+nir_algebraic_queue(nir_instr_worklist *worklist, nir_instr *instr)
+{
+   if (instr->type != nir_instr_type_alu ||
+       (instr->pass_flags & ALGEBRAIC_QUEUED))
+      return;
+
+   instr->pass_flags |= ALGEBRAIC_QUEUED;
+   nir_instr_worklist_push_tail(worklist, instr);
+}
+
+/**
+ * Queue the users of a value which just replaced another one for matching
+ * again.  Their automaton states are recomputed on the way, and any change
+ * is followed down to the users of the users, as their states are derived
+ * from it.
+ */
+static void
+nir_algebraic_update_uses(nir_ssa_def *def, struct util_dynarray *states,
+                          const struct per_op_table *pass_op_table,
+                          nir_instr_worklist *worklist)
+{
+   nir_instr_worklist changed;
+
+   if (!nir_instr_worklist_init(&changed))
+      return;
+
+   nir_foreach_use(use_src, def) {
+      nir_instr *user = use_src->parent_instr;
+
+      if (nir_algebraic_automaton(user, states, pass_op_table))
+         nir_instr_worklist_push_tail(&changed, user);
+
+      nir_algebraic_queue(worklist, user);
+   }
+
+   /* Only ALU instructions ever change state */
+   while (!nir_instr_worklist_is_empty(&changed)) {
+      nir_alu_instr *alu =
+         nir_instr_as_alu(nir_instr_worklist_pop_head(&changed));
+
+      nir_foreach_use(use_src, &alu->dest.dest.ssa) {
+         nir_instr *user = use_src->parent_instr;
+
+         if (nir_algebraic_automaton(user, states, pass_op_table)) {
+            nir_instr_worklist_push_tail(&changed, user);
+            nir_algebraic_queue(worklist, user);
+         }
+      }
+   }
+
+   nir_instr_worklist_fini(&changed);
+}
+
+static bool
+nir_algebraic_instr(nir_instr *instr, const bool *condition_flags,
+                    const struct transform **transforms,
+                    const uint16_t *transform_counts,
+                    struct util_dynarray *states,
+                    const struct per_op_table *pass_op_table,
+                    nir_instr_worklist *worklist,
+                    void *mem_ctx)
+{
+   if (instr->type != nir_instr_type_alu)
+      return false;
+
+   nir_alu_instr *alu = nir_instr_as_alu(instr);
+   if (!alu->dest.dest.is_ssa)
+      return false;
+
+   /* Fold constants as we go, so that the users of the result get a chance
+    * to match against it in this same run.
+    */
+   nir_ssa_def *def = nir_constant_fold_alu_instr(alu, mem_ctx);
+
+   if (!def) {
+      /* Only the patterns the automaton says might match are tried. */
+      const uint16_t xform_idx = *get_state(states, alu->dest.dest.ssa.index);
+      for (uint16_t i = 0; i < transform_counts[xform_idx]; i++) {
+         const struct transform *xform = &transforms[xform_idx][i];
+         if (condition_flags[xform->condition_offset]) {
+            def = replace_instr(alu, xform->search, xform->replace,
+                                states, pass_op_table, worklist, mem_ctx);
+            if (def)
+               break;
+         }
+      }
+
+      if (!def)
+         return false;
+   } else {
+      nir_algebraic_automaton(def->parent_instr, states, pass_op_table);
+      nir_ssa_def_rewrite_uses(&alu->dest.dest.ssa, nir_src_for_ssa(def));
+      nir_instr_remove(instr);
+   }
+
+   /* The instruction may still be in the worklist, so it can't be freed. */
+   instr->pass_flags |= ALGEBRAIC_REMOVED;
+
+   nir_algebraic_update_uses(def, states, pass_op_table, worklist);
+
+   return true;
+}
+
+/**
+ * Run the transforms of an algebraic pass generated by nir_algebraic.py.
+ *
+ * The automaton states of all the values are computed in a first walk over
+ * the shader, then each ALU instruction only tries the transforms listed
+ * for its state.  Instructions are matched from a worklist, starting with
+ * every ALU instruction from the bottom of the shader up.  Whenever one is
+ * replaced, only the instructions created for the replacement and the
+ * users of the new value are queued again, so a single call reaches the
+ * same fixed point as calling the pass over and over with constant folding
+ * and copy propagation in between, at a fraction of the cost.
+ */
+bool
+nir_algebraic_impl(nir_function_impl *impl,
+                   const bool *condition_flags,
+                   const struct transform **transforms,
+                   const uint16_t *transform_counts,
+                   const struct per_op_table *pass_op_table)
+{
+   void *mem_ctx = ralloc_parent(impl);
+   struct util_dynarray states;
+   nir_instr_worklist worklist;
+   bool progress = false;
+
+   if (!nir_instr_worklist_init(&worklist))
+      return false;
+
+   util_dynarray_init(&states, NULL);
+   if (impl->ssa_alloc)
+      get_state(&states, impl->ssa_alloc - 1);
+
+   /* Sources come before the instructions using them, except for phis
+    * which are WILDCARD_STATE anyway.
+    */
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         instr->pass_flags = 0;
+         nir_algebraic_automaton(instr, &states, pass_op_table);
+      }
+   }
+
+   nir_foreach_block_reverse(block, impl) {
+      nir_foreach_instr_reverse(instr, block)
+         nir_algebraic_queue(&worklist, instr);
+   }
+
+   while (!nir_instr_worklist_is_empty(&worklist)) {
+      nir_instr *instr = nir_instr_worklist_pop_head(&worklist);
+
+      if (instr->pass_flags & ALGEBRAIC_REMOVED)
+         continue;
+
+      instr->pass_flags &= ~ALGEBRAIC_QUEUED;
+
+      progress |= nir_algebraic_instr(instr, condition_flags,
+                                      transforms, transform_counts,
+                                      &states, pass_op_table, &worklist,
+                                      mem_ctx);
+   }
+
+   nir_instr_worklist_fini(&worklist);
+   util_dynarray_fini(&states);
+
+   if (progress)
+      nir_metadata_preserve(impl, nir_metadata_block_index |
+                                  nir_metadata_dominance);
+
+   return progress;
+}
+
+/**
+ * Run the transforms of an algebraic pass the way nir_algebraic.py used to
+ * generate it: a single walk from the bottom of the shader up, trying every
+ * transform rooted at the opcode of each ALU instruction in turn.
+ *
+ * Only the reference passes the tests compare nir_algebraic_impl() against
+ * use this.
+ */
+bool
+nir_algebraic_reference_impl(nir_function_impl *impl,
+                             const bool *condition_flags,
+                             const struct transform **op_transforms,
+                             const uint16_t *op_transform_counts)
+{
+   void *mem_ctx = ralloc_parent(impl);
+   bool progress = false;
+
+   nir_foreach_block_reverse(block, impl) {
+      nir_foreach_instr_reverse_safe(instr, block) {
+         if (instr->type != nir_instr_type_alu)
+            continue;
+
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         if (!alu->dest.dest.is_ssa)
+            continue;
+
+         for (uint16_t i = 0; i < op_transform_counts[alu->op]; i++) {
+            const struct transform *xform = &op_transforms[alu->op][i];
+            if (condition_flags[xform->condition_offset] &&
+                nir_replace_instr(alu, xform->search, xform->replace,
+                                  mem_ctx)) {
+               progress = true;
+               break;
+            }
+         }
+      }
+   }
+
+   if (progress)
+      nir_metadata_preserve(impl, nir_metadata_block_index |
+                                  nir_metadata_dominance);
+
+   return progress;
+}
+
+static const struct transform *
+first_match(nir_alu_instr *alu, const bool *condition_flags,
+            const struct transform *transforms, unsigned count)
+{
+   struct match_state state;
+   state.states = NULL;
+   state.pass_op_table = NULL;
+   state.worklist = NULL;
+
+   for (unsigned i = 0; i < count; i++) {
+      if (condition_flags[transforms[i].condition_offset] &&
+          match_instr(alu, transforms[i].search, &state))
+         return &transforms[i];
+   }
+
+   return NULL;
+}
+
+/**
+ * Check the automaton of an algebraic pass against trying every transform
+ * rooted at the opcode: for each ALU instruction, the first transform that
+ * matches among those listed for its automaton state must be the first
+ * that matches among all of them.  Nothing is replaced.
+ *
+ * Returns the number of instructions for which this doesn't hold, and adds
+ * the number of instructions some transform matched to *num_matched.
+ */
+unsigned
+nir_algebraic_check_automaton(nir_function_impl *impl,
+                              const bool *condition_flags,
+                              const struct transform **transforms,
+                              const uint16_t *transform_counts,
+                              const struct per_op_table *pass_op_table,
+                              const struct transform **op_transforms,
+                              const uint16_t *op_transform_counts,
+                              unsigned *num_matched)
+{
+   struct util_dynarray states;
+   unsigned num_mismatches = 0;
+
+   util_dynarray_init(&states, NULL);
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block)
+         nir_algebraic_automaton(instr, &states, pass_op_table);
+   }
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_alu)
+            continue;
+
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         if (!alu->dest.dest.is_ssa)
+            continue;
+
+         const uint16_t state = *get_state(&states, alu->dest.dest.ssa.index);
+         const struct transform *automaton =
+            first_match(alu, condition_flags, transforms[state],
+                        transform_counts[state]);
+         const struct transform *reference =
+            first_match(alu, condition_flags, op_transforms[alu->op],
+                        op_transform_counts[alu->op]);
+
+         /* The tables hold copies, so compare what they point to. */
+         if ((automaton == NULL) != (reference == NULL) ||
+             (automaton && (automaton->search != reference->search ||
+                            automaton->replace != reference->replace)))
+            num_mismatches++;
+
+         if (reference)
+            (*num_matched)++;
+      }
+   }
+
+   util_dynarray_fini(&states);
+
+   return num_mismatches;
 }
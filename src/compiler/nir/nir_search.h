@@ -29,6 +29,7 @@
 #define _NIR_SEARCH_
 
 #include "nir.h"
+#include "util/u_dynarray.h"
 
 #define NIR_SEARCH_MAX_VARIABLES 16
 
@@ -123,8 +124,64 @@ NIR_DEFINE_CAST(nir_search_value_as_expression, nir_search_value,
                 nir_search_expression, value,
                 type, nir_search_value_expression)
 
+struct transform {
+   const nir_search_expression *search;
+   const nir_search_value *replace;
+   unsigned condition_offset;
+};
+
+/**
+ * Transition table of the tree automaton generated by nir_algebraic.py for
+ * one opcode.
+ *
+ * The automaton gives every SSA value a state, standing for the set of
+ * search expressions (and their subexpressions) the value may match.  The
+ * state of an ALU instruction is
+ *
+ *    table[filter[s0] * num_filtered_states^(n-1) + ... + filter[sn-1]]
+ *
+ * where s0..sn-1 are the states of its sources.  An opcode not used by any
+ * search expression has num_filtered_states == 0 and always gets
+ * WILDCARD_STATE.
+ */
+struct per_op_table {
+   const uint16_t *filter;
+   unsigned num_filtered_states;
+   const uint16_t *table;
+};
+
+/* These must match the start states of TreeAutomaton in nir_algebraic.py */
+#define WILDCARD_STATE 0
+#define CONST_STATE 1
+
 nir_alu_instr *
 nir_replace_instr(nir_alu_instr *instr, const nir_search_expression *search,
                   const nir_search_value *replace, void *mem_ctx);
 
+bool
+nir_algebraic_impl(nir_function_impl *impl,
+                   const bool *condition_flags,
+                   const struct transform **transforms,
+                   const uint16_t *transform_counts,
+                   const struct per_op_table *pass_op_table);
+
+/* For the passes nir_algebraic.py generates with reference=True, which also
+ * list the transforms by opcode of their search expression.
+ */
+bool
+nir_algebraic_reference_impl(nir_function_impl *impl,
+                             const bool *condition_flags,
+                             const struct transform **op_transforms,
+                             const uint16_t *op_transform_counts);
+
+unsigned
+nir_algebraic_check_automaton(nir_function_impl *impl,
+                              const bool *condition_flags,
+                              const struct transform **transforms,
+                              const uint16_t *transform_counts,
+                              const struct per_op_table *pass_op_table,
+                              const struct transform **op_transforms,
+                              const uint16_t *op_transform_counts,
+                              unsigned *num_matched);
+
 #endif /* _NIR_SEARCH_ */
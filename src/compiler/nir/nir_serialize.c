@@ -23,29 +23,41 @@
 
 #include "nir_serialize.h"
 #include "nir_control_flow.h"
-#include "util/u_dynarray.h"
 
-typedef struct {
-   size_t blob_offset;
-   nir_ssa_def *src;
-   nir_block *block;
-} write_phi_fixup;
+/* The encoding is byte oriented: almost every field is written with
+ * blob_write_varint, and small fields are packed together into a single
+ * varint wherever possible.  Each instruction starts with a header holding
+ * the instruction type in its low bits and the most common per-type fields
+ * above that, so a typical ALU instruction with SSA operands takes well
+ * under ten bytes.
+ *
+ * Objects which can be referenced (variables, registers, functions, blocks
+ * and SSA values) are numbered in the order they are written, which is the
+ * order the reader creates them in.  Sources store the distance back from
+ * the last numbered object, which keeps them to a byte or two.
+ */
+
+#define NIR_SERIALIZE_INSTR_TYPE_BITS 4
 
 typedef struct {
    const nir_shader *nir;
 
    struct blob *blob;
 
-   /* maps pointer to index */
+   /* maps variable, function and block pointers to index */
    struct hash_table *remap_table;
 
-   /* the next index to assign to a NIR in-memory object */
-   uintptr_t next_idx;
-
-   /* Array of write_phi_fixup structs representing phi sources that need to
-    * be resolved in the second pass.
+   /* Maps the index of an SSA value or register in the current function
+    * implementation to its object index.  Those are dense and checked to be
+    * unique by nir_validate, so no hashing is needed for the most frequent
+    * references.
     */
-   struct util_dynarray phi_fixups;
+   uint32_t *ssa_remap;
+   uint32_t *reg_remap;
+   uint32_t *global_reg_remap;
+
+   /* the next index to assign to a NIR in-memory object */
+   uint32_t next_idx;
 } write_ctx;
 
 typedef struct {
@@ -54,10 +66,10 @@ typedef struct {
    struct blob_reader *blob;
 
    /* the next index to assign to a NIR in-memory object */
-   uintptr_t next_idx;
+   uint32_t next_idx;
 
    /* The length of the index -> object table */
-   uintptr_t idx_table_len;
+   uint32_t idx_table_len;
 
    /* map from index to deserialized pointer */
    void **idx_table;
@@ -70,22 +82,54 @@ typedef struct {
 static void
 write_add_object(write_ctx *ctx, const void *obj)
 {
-   uintptr_t index = ctx->next_idx++;
-   _mesa_hash_table_insert(ctx->remap_table, obj, (void *) index);
+   uint32_t index = ctx->next_idx++;
+   _mesa_hash_table_insert(ctx->remap_table, obj, (void *)(uintptr_t) index);
 }
 
-static uintptr_t
+static uint32_t
 write_lookup_object(write_ctx *ctx, const void *obj)
 {
    struct hash_entry *entry = _mesa_hash_table_search(ctx->remap_table, obj);
    assert(entry);
-   return (uintptr_t) entry->data;
+   return (uint32_t)(uintptr_t) entry->data;
 }
 
 static void
 write_object(write_ctx *ctx, const void *obj)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, obj));
+   blob_write_varint(ctx->blob, write_lookup_object(ctx, obj));
+}
+
+static void
+write_add_ssa_def(write_ctx *ctx, const nir_ssa_def *def)
+{
+   /* The index was handed out by write_function_impl already. */
+   assert(ctx->ssa_remap[def->index] == ctx->next_idx);
+   ctx->next_idx++;
+}
+
+static uint32_t
+write_lookup_ssa_def(write_ctx *ctx, const nir_ssa_def *def)
+{
+   return ctx->ssa_remap[def->index];
+}
+
+static uint32_t
+write_lookup_reg(write_ctx *ctx, const nir_register *reg)
+{
+   return reg->is_global ? ctx->global_reg_remap[reg->index] :
+                           ctx->reg_remap[reg->index];
+}
+
+/* Values and registers are always written before they are used, except by
+ * phis, so a reference is stored as a (small) distance back from the last
+ * object written.
+ */
+static uint32_t
+write_relative_index(write_ctx *ctx, uint32_t idx)
+{
+   assert(idx < ctx->next_idx);
+   return ctx->next_idx - idx;
 }
 
 static void
@@ -96,7 +140,7 @@ read_add_object(read_ctx *ctx, void *obj)
 }
 
 static void *
-read_lookup_object(read_ctx *ctx, uintptr_t idx)
+read_lookup_object(read_ctx *ctx, uint32_t idx)
 {
    assert(idx < ctx->idx_table_len);
    return ctx->idx_table[idx];
@@ -105,14 +149,30 @@ read_lookup_object(read_ctx *ctx, uintptr_t idx)
 static void *
 read_object(read_ctx *ctx)
 {
-   return read_lookup_object(ctx, blob_read_intptr(ctx->blob));
+   return read_lookup_object(ctx, blob_read_varint(ctx->blob));
+}
+
+static void *
+read_relative_object(read_ctx *ctx, uint32_t delta)
+{
+   assert(delta > 0 && delta <= ctx->next_idx);
+   return read_lookup_object(ctx, ctx->next_idx - delta);
 }
 
 static void
 write_constant(write_ctx *ctx, const nir_constant *c)
 {
-   blob_write_bytes(ctx->blob, c->values, sizeof(c->values));
-   blob_write_uint32(ctx->blob, c->num_elements);
+   /* Most of the value storage is unused, only write up to the last non-zero
+    * byte.
+    */
+   const uint8_t *values = (const uint8_t *) c->values;
+   uint32_t size = sizeof(c->values);
+   while (size > 0 && values[size - 1] == 0)
+      size--;
+
+   blob_write_varint(ctx->blob, size);
+   blob_write_bytes(ctx->blob, values, size);
+   blob_write_varint(ctx->blob, c->num_elements);
    for (unsigned i = 0; i < c->num_elements; i++)
       write_constant(ctx, c->elements[i]);
 }
@@ -120,10 +180,12 @@ write_constant(write_ctx *ctx, const nir_constant *c)
 static nir_constant *
 read_constant(read_ctx *ctx, nir_variable *nvar)
 {
-   nir_constant *c = ralloc(nvar, nir_constant);
+   nir_constant *c = rzalloc(nvar, nir_constant);
 
-   blob_copy_bytes(ctx->blob, (uint8_t *)c->values, sizeof(c->values));
-   c->num_elements = blob_read_uint32(ctx->blob);
+   uint32_t size = blob_read_varint(ctx->blob);
+   assert(size <= sizeof(c->values));
+   blob_copy_bytes(ctx->blob, (uint8_t *)c->values, size);
+   c->num_elements = blob_read_varint(ctx->blob);
    c->elements = ralloc_array(ctx->nir, nir_constant *, c->num_elements);
    for (unsigned i = 0; i < c->num_elements; i++)
       c->elements[i] = read_constant(ctx, nvar);
@@ -131,21 +193,34 @@ read_constant(read_ctx *ctx, nir_variable *nvar)
    return c;
 }
 
+enum var_flags {
+   VAR_HAS_NAME              = 1 << 0,
+   VAR_HAS_CONST_INITIALIZER = 1 << 1,
+   VAR_HAS_INTERFACE_TYPE    = 1 << 2,
+};
+
 static void
 write_variable(write_ctx *ctx, const nir_variable *var)
 {
    write_add_object(ctx, var);
    encode_type_to_blob(ctx->blob, var->type);
-   blob_write_uint32(ctx->blob, !!(var->name));
-   blob_write_string(ctx->blob, var->name);
+
+   uint32_t flags = 0;
+   if (var->name)
+      flags |= VAR_HAS_NAME;
+   if (var->constant_initializer)
+      flags |= VAR_HAS_CONST_INITIALIZER;
+   if (var->interface_type)
+      flags |= VAR_HAS_INTERFACE_TYPE;
+   blob_write_varint(ctx->blob, flags | var->num_state_slots << 3);
+
+   if (var->name)
+      blob_write_string(ctx->blob, var->name);
    blob_write_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   blob_write_uint32(ctx->blob, var->num_state_slots);
    blob_write_bytes(ctx->blob, (uint8_t *) var->state_slots,
                     var->num_state_slots * sizeof(nir_state_slot));
-   blob_write_uint32(ctx->blob, !!(var->constant_initializer));
    if (var->constant_initializer)
       write_constant(ctx, var->constant_initializer);
-   blob_write_uint32(ctx->blob, !!(var->interface_type));
    if (var->interface_type)
       encode_type_to_blob(ctx->blob, var->interface_type);
 }
@@ -157,25 +232,25 @@ read_variable(read_ctx *ctx)
    read_add_object(ctx, var);
 
    var->type = decode_type_from_blob(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
-   if (has_name) {
+
+   uint32_t flags = blob_read_varint(ctx->blob);
+   var->num_state_slots = flags >> 3;
+
+   if (flags & VAR_HAS_NAME) {
       const char *name = blob_read_string(ctx->blob);
       var->name = ralloc_strdup(var, name);
    } else {
       var->name = NULL;
    }
    blob_copy_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   var->num_state_slots = blob_read_uint32(ctx->blob);
    var->state_slots = ralloc_array(var, nir_state_slot, var->num_state_slots);
    blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
                    var->num_state_slots * sizeof(nir_state_slot));
-   bool has_const_initializer = blob_read_uint32(ctx->blob);
-   if (has_const_initializer)
+   if (flags & VAR_HAS_CONST_INITIALIZER)
       var->constant_initializer = read_constant(ctx, var);
    else
       var->constant_initializer = NULL;
-   bool has_interface_type = blob_read_uint32(ctx->blob);
-   if (has_interface_type)
+   if (flags & VAR_HAS_INTERFACE_TYPE)
       var->interface_type = decode_type_from_blob(ctx->blob);
    else
       var->interface_type = NULL;
@@ -186,7 +261,7 @@ read_variable(read_ctx *ctx)
 static void
 write_var_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_variable, var, node, src) {
       write_variable(ctx, var);
    }
@@ -196,7 +271,7 @@ static void
 read_var_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_vars = blob_read_uint32(ctx->blob);
+   unsigned num_vars = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_vars; i++) {
       nir_variable *var = read_variable(ctx);
       exec_list_push_tail(dst, &var->node);
@@ -206,15 +281,20 @@ read_var_list(read_ctx *ctx, struct exec_list *dst)
 static void
 write_register(write_ctx *ctx, const nir_register *reg)
 {
-   write_add_object(ctx, reg);
-   blob_write_uint32(ctx->blob, reg->num_components);
-   blob_write_uint32(ctx->blob, reg->bit_size);
-   blob_write_uint32(ctx->blob, reg->num_array_elems);
-   blob_write_uint32(ctx->blob, reg->index);
-   blob_write_uint32(ctx->blob, !!(reg->name));
+   if (reg->is_global)
+      ctx->global_reg_remap[reg->index] = ctx->next_idx++;
+   else
+      ctx->reg_remap[reg->index] = ctx->next_idx++;
+
+   blob_write_varint(ctx->blob, reg->index);
+   blob_write_varint(ctx->blob, reg->num_array_elems);
+   blob_write_varint(ctx->blob, reg->num_components |
+                                reg->bit_size << 3 |
+                                !!(reg->name) << 10 |
+                                reg->is_global << 11 |
+                                reg->is_packed << 12);
    if (reg->name)
       blob_write_string(ctx->blob, reg->name);
-   blob_write_uint32(ctx->blob, reg->is_global << 1 | reg->is_packed);
 }
 
 static nir_register *
@@ -222,20 +302,19 @@ read_register(read_ctx *ctx)
 {
    nir_register *reg = ralloc(ctx->nir, nir_register);
    read_add_object(ctx, reg);
-   reg->num_components = blob_read_uint32(ctx->blob);
-   reg->bit_size = blob_read_uint32(ctx->blob);
-   reg->num_array_elems = blob_read_uint32(ctx->blob);
-   reg->index = blob_read_uint32(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
-   if (has_name) {
+   reg->index = blob_read_varint(ctx->blob);
+   reg->num_array_elems = blob_read_varint(ctx->blob);
+   uint32_t flags = blob_read_varint(ctx->blob);
+   reg->num_components = flags & 0x7;
+   reg->bit_size = (flags >> 3) & 0x7f;
+   reg->is_global = flags & (1 << 11);
+   reg->is_packed = flags & (1 << 12);
+   if (flags & (1 << 10)) {
       const char *name = blob_read_string(ctx->blob);
       reg->name = ralloc_strdup(reg, name);
    } else {
       reg->name = NULL;
    }
-   unsigned flags = blob_read_uint32(ctx->blob);
-   reg->is_global = flags & 0x2;
-   reg->is_packed = flags & 0x1;
 
    list_inithead(&reg->uses);
    list_inithead(&reg->defs);
@@ -247,7 +326,7 @@ read_register(read_ctx *ctx)
 static void
 write_reg_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_register, reg, node, src)
       write_register(ctx, reg);
 }
@@ -256,7 +335,7 @@ static void
 read_reg_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_regs = blob_read_uint32(ctx->blob);
+   unsigned num_regs = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_regs; i++) {
       nir_register *reg = read_register(ctx);
       exec_list_push_tail(dst, &reg->node);
@@ -268,20 +347,19 @@ write_src(write_ctx *ctx, const nir_src *src)
 {
    /* Since sources are very frequent, we try to save some space when storing
     * them. In particular, we store whether the source is a register and
-    * whether the register has an indirect index in the low two bits. We can
-    * assume that the high two bits of the index are zero, since otherwise our
-    * address space would've been exhausted allocating the remap table!
+    * whether the register has an indirect index in the low two bits of the
+    * relative index.
     */
    if (src->is_ssa) {
-      uintptr_t idx = write_lookup_object(ctx, src->ssa) << 2;
-      idx |= 1;
-      blob_write_intptr(ctx->blob, idx);
+      uint32_t idx = write_lookup_ssa_def(ctx, src->ssa);
+      blob_write_varint(ctx->blob, write_relative_index(ctx, idx) << 2 | 1);
    } else {
-      uintptr_t idx = write_lookup_object(ctx, src->reg.reg) << 2;
+      uint32_t idx = write_lookup_reg(ctx, src->reg.reg);
+      uint32_t val = write_relative_index(ctx, idx) << 2;
       if (src->reg.indirect)
-         idx |= 2;
-      blob_write_intptr(ctx->blob, idx);
-      blob_write_uint32(ctx->blob, src->reg.base_offset);
+         val |= 2;
+      blob_write_varint(ctx->blob, val);
+      blob_write_varint(ctx->blob, src->reg.base_offset);
       if (src->reg.indirect) {
          write_src(ctx, src->reg.indirect);
       }
@@ -291,15 +369,15 @@ write_src(write_ctx *ctx, const nir_src *src)
 static void
 read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
 {
-   uintptr_t val = blob_read_intptr(ctx->blob);
-   uintptr_t idx = val >> 2;
+   uint32_t val = blob_read_varint(ctx->blob);
+   uint32_t delta = val >> 2;
    src->is_ssa = val & 0x1;
    if (src->is_ssa) {
-      src->ssa = read_lookup_object(ctx, idx);
+      src->ssa = read_relative_object(ctx, delta);
    } else {
       bool is_indirect = val & 0x2;
-      src->reg.reg = read_lookup_object(ctx, idx);
-      src->reg.base_offset = blob_read_uint32(ctx->blob);
+      src->reg.reg = read_relative_object(ctx, delta);
+      src->reg.base_offset = blob_read_varint(ctx->blob);
       if (is_indirect) {
          src->reg.indirect = ralloc(mem_ctx, nir_src);
          read_src(ctx, src->reg.indirect, mem_ctx);
@@ -312,22 +390,25 @@ read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
 static void
 write_dest(write_ctx *ctx, const nir_dest *dst)
 {
-   uint32_t val = dst->is_ssa;
    if (dst->is_ssa) {
+      /* Everything fits in a single byte unless the value has a name. */
+      assert(dst->ssa.num_components >= 1 && dst->ssa.num_components <= 4);
+      assert((dst->ssa.bit_size & (dst->ssa.bit_size - 1)) == 0);
+      uint32_t val = 1;
       val |= !!(dst->ssa.name) << 1;
-      val |= dst->ssa.num_components << 2;
-      val |= dst->ssa.bit_size << 5;
-   } else {
-      val |= !!(dst->reg.indirect) << 1;
-   }
-   blob_write_uint32(ctx->blob, val);
-   if (dst->is_ssa) {
-      write_add_object(ctx, &dst->ssa);
+      val |= (dst->ssa.num_components - 1) << 2;
+      val |= (ffs(dst->ssa.bit_size) - 1) << 4;
+      blob_write_varint(ctx->blob, val);
+
+      write_add_ssa_def(ctx, &dst->ssa);
       if (dst->ssa.name)
          blob_write_string(ctx->blob, dst->ssa.name);
    } else {
-      blob_write_intptr(ctx->blob, write_lookup_object(ctx, dst->reg.reg));
-      blob_write_uint32(ctx->blob, dst->reg.base_offset);
+      uint32_t idx = write_lookup_reg(ctx, dst->reg.reg);
+      uint32_t val = write_relative_index(ctx, idx) << 2;
+      val |= !!(dst->reg.indirect) << 1;
+      blob_write_varint(ctx->blob, val);
+      blob_write_varint(ctx->blob, dst->reg.base_offset);
       if (dst->reg.indirect)
          write_src(ctx, dst->reg.indirect);
    }
@@ -336,19 +417,19 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
 static void
 read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint(ctx->blob);
    bool is_ssa = val & 0x1;
    if (is_ssa) {
       bool has_name = val & 0x2;
-      unsigned num_components = (val >> 2) & 0x7;
-      unsigned bit_size = val >> 5;
+      unsigned num_components = ((val >> 2) & 0x3) + 1;
+      unsigned bit_size = 1 << ((val >> 4) & 0x7);
       char *name = has_name ? blob_read_string(ctx->blob) : NULL;
       nir_ssa_dest_init(instr, dst, num_components, bit_size, name);
       read_add_object(ctx, &dst->ssa);
    } else {
       bool is_indirect = val & 0x2;
-      dst->reg.reg = read_object(ctx);
-      dst->reg.base_offset = blob_read_uint32(ctx->blob);
+      dst->reg.reg = read_relative_object(ctx, val >> 2);
+      dst->reg.base_offset = blob_read_varint(ctx->blob);
       if (is_indirect) {
          dst->reg.indirect = ralloc(instr, nir_src);
          read_src(ctx, dst->reg.indirect, instr);
@@ -364,22 +445,23 @@ write_deref_chain(write_ctx *ctx, const nir_deref_var *deref_var)
    uint32_t len = 0;
    for (const nir_deref *d = deref_var->deref.child; d; d = d->child)
       len++;
-   blob_write_uint32(ctx->blob, len);
+   blob_write_varint(ctx->blob, len);
 
    for (const nir_deref *d = deref_var->deref.child; d; d = d->child) {
-      blob_write_uint32(ctx->blob, d->deref_type);
       switch (d->deref_type) {
       case nir_deref_type_array: {
          const nir_deref_array *deref_array = nir_deref_as_array(d);
-         blob_write_uint32(ctx->blob, deref_array->deref_array_type);
-         blob_write_uint32(ctx->blob, deref_array->base_offset);
+         blob_write_varint(ctx->blob, d->deref_type |
+                                      deref_array->deref_array_type << 2);
+         blob_write_varint(ctx->blob, deref_array->base_offset);
          if (deref_array->deref_array_type == nir_deref_array_type_indirect)
             write_src(ctx, &deref_array->indirect);
          break;
       }
       case nir_deref_type_struct: {
          const nir_deref_struct *deref_struct = nir_deref_as_struct(d);
-         blob_write_uint32(ctx->blob, deref_struct->index);
+         blob_write_varint(ctx->blob, d->deref_type |
+                                      deref_struct->index << 2);
          break;
       }
       case nir_deref_type_var:
@@ -396,29 +478,30 @@ read_deref_chain(read_ctx *ctx, void *mem_ctx)
    nir_variable *var = read_object(ctx);
    nir_deref_var *deref_var = nir_deref_var_create(mem_ctx, var);
 
-   uint32_t len = blob_read_uint32(ctx->blob);
+   uint32_t len = blob_read_varint(ctx->blob);
 
    nir_deref *tail = &deref_var->deref;
    for (uint32_t i = 0; i < len; i++) {
-      nir_deref_type deref_type = blob_read_uint32(ctx->blob);
+      uint32_t val = blob_read_varint(ctx->blob);
+      nir_deref_type deref_type = val & 0x3;
       nir_deref *deref = NULL;
       switch (deref_type) {
       case nir_deref_type_array: {
          nir_deref_array *deref_array = nir_deref_array_create(tail);
-         deref_array->deref_array_type = blob_read_uint32(ctx->blob);
-         deref_array->base_offset = blob_read_uint32(ctx->blob);
+         deref_array->deref_array_type = val >> 2;
+         deref_array->base_offset = blob_read_varint(ctx->blob);
          if (deref_array->deref_array_type == nir_deref_array_type_indirect)
             read_src(ctx, &deref_array->indirect, mem_ctx);
          deref = &deref_array->deref;
          break;
       }
       case nir_deref_type_struct: {
-         uint32_t index = blob_read_uint32(ctx->blob);
-         nir_deref_struct *deref_struct = nir_deref_struct_create(tail, index);
+         nir_deref_struct *deref_struct = nir_deref_struct_create(tail, val >> 2);
          deref = &deref_struct->deref;
          break;
       }
       case nir_deref_type_var:
+      default:
          unreachable("Invalid deref type");
       }
 
@@ -431,43 +514,76 @@ read_deref_chain(read_ctx *ctx, void *mem_ctx)
    return deref_var;
 }
 
+/* Whether every source is unmodified and reads the channels it uses in
+ * order, in which case the per-source modifier word is left out.
+ */
+static bool
+alu_srcs_are_trivial(const nir_alu_instr *alu)
+{
+   for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+      if (alu->src[i].negate || alu->src[i].abs)
+         return false;
+
+      for (unsigned j = 0; j < 4; j++) {
+         if (nir_alu_instr_channel_used(alu, i, j) &&
+             alu->src[i].swizzle[j] != j)
+            return false;
+      }
+   }
+
+   return true;
+}
+
 static void
 write_alu(write_ctx *ctx, const nir_alu_instr *alu)
 {
-   blob_write_uint32(ctx->blob, alu->op);
-   uint32_t flags = alu->exact;
-   flags |= alu->dest.saturate << 1;
-   flags |= alu->dest.write_mask << 2;
-   blob_write_uint32(ctx->blob, flags);
+   bool trivial_srcs = alu_srcs_are_trivial(alu);
+
+   uint32_t header = nir_instr_type_alu;
+   header |= alu->exact << 4;
+   header |= alu->dest.saturate << 5;
+   header |= alu->dest.write_mask << 6;
+   header |= trivial_srcs << 10;
+   header |= alu->op << 11;
+   blob_write_varint(ctx->blob, header);
 
    write_dest(ctx, &alu->dest.dest);
 
    for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
       write_src(ctx, &alu->src[i].src);
-      flags = alu->src[i].negate;
+      if (trivial_srcs)
+         continue;
+
+      uint32_t flags = alu->src[i].negate;
       flags |= alu->src[i].abs << 1;
       for (unsigned j = 0; j < 4; j++)
          flags |= alu->src[i].swizzle[j] << (2 + 2 * j);
-      blob_write_uint32(ctx->blob, flags);
+      blob_write_varint(ctx->blob, flags);
    }
 }
 
 static nir_alu_instr *
-read_alu(read_ctx *ctx)
+read_alu(read_ctx *ctx, uint32_t header)
 {
-   nir_op op = blob_read_uint32(ctx->blob);
+   nir_op op = header >> 11;
    nir_alu_instr *alu = nir_alu_instr_create(ctx->nir, op);
 
-   uint32_t flags = blob_read_uint32(ctx->blob);
-   alu->exact = flags & 1;
-   alu->dest.saturate = flags & 2;
-   alu->dest.write_mask = flags >> 2;
+   alu->exact = header & (1 << 4);
+   alu->dest.saturate = header & (1 << 5);
+   alu->dest.write_mask = (header >> 6) & 0xf;
+   bool trivial_srcs = header & (1 << 10);
 
    read_dest(ctx, &alu->dest.dest, &alu->instr);
 
+   /* nir_alu_instr_create() already set up unmodified sources with an
+    * identity swizzle.
+    */
    for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++) {
       read_src(ctx, &alu->src[i].src, &alu->instr);
-      flags = blob_read_uint32(ctx->blob);
+      if (trivial_srcs)
+         continue;
+
+      uint32_t flags = blob_read_varint(ctx->blob);
       alu->src[i].negate = flags & 1;
       alu->src[i].abs = flags & 2;
       for (unsigned j = 0; j < 4; j++)
@@ -480,13 +596,14 @@ read_alu(read_ctx *ctx)
 static void
 write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
 {
-   blob_write_uint32(ctx->blob, intrin->intrinsic);
-
    unsigned num_variables = nir_intrinsic_infos[intrin->intrinsic].num_variables;
    unsigned num_srcs = nir_intrinsic_infos[intrin->intrinsic].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[intrin->intrinsic].num_indices;
 
-   blob_write_uint32(ctx->blob, intrin->num_components);
+   uint32_t header = nir_instr_type_intrinsic;
+   header |= intrin->num_components << 4;
+   header |= intrin->intrinsic << 7;
+   blob_write_varint(ctx->blob, header);
 
    if (nir_intrinsic_infos[intrin->intrinsic].has_dest)
       write_dest(ctx, &intrin->dest);
@@ -498,13 +615,13 @@ write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
       write_src(ctx, &intrin->src[i]);
 
    for (unsigned i = 0; i < num_indices; i++)
-      blob_write_uint32(ctx->blob, intrin->const_index[i]);
+      blob_write_varint(ctx->blob, intrin->const_index[i]);
 }
 
 static nir_intrinsic_instr *
-read_intrinsic(read_ctx *ctx)
+read_intrinsic(read_ctx *ctx, uint32_t header)
 {
-   nir_intrinsic_op op = blob_read_uint32(ctx->blob);
+   nir_intrinsic_op op = header >> 7;
 
    nir_intrinsic_instr *intrin = nir_intrinsic_instr_create(ctx->nir, op);
 
@@ -512,7 +629,7 @@ read_intrinsic(read_ctx *ctx)
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[op].num_indices;
 
-   intrin->num_components = blob_read_uint32(ctx->blob);
+   intrin->num_components = (header >> 4) & 0x7;
 
    if (nir_intrinsic_infos[op].has_dest)
       read_dest(ctx, &intrin->dest, &intrin->instr);
@@ -524,30 +641,45 @@ read_intrinsic(read_ctx *ctx)
       read_src(ctx, &intrin->src[i], &intrin->instr);
 
    for (unsigned i = 0; i < num_indices; i++)
-      intrin->const_index[i] = blob_read_uint32(ctx->blob);
+      intrin->const_index[i] = blob_read_varint(ctx->blob);
 
    return intrin;
 }
 
+/* Header shared by the instructions which only define a value of the given
+ * size: load_const and ssa_undef.
+ */
+static uint32_t
+ssa_def_header(nir_instr_type type, const nir_ssa_def *def)
+{
+   assert(def->num_components >= 1 && def->num_components <= 4);
+   return type | (def->num_components - 1) << 4 |
+          (ffs(def->bit_size) - 1) << 6;
+}
+
 static void
 write_load_const(write_ctx *ctx, const nir_load_const_instr *lc)
 {
-   uint32_t val = lc->def.num_components;
-   val |= lc->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
-   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
-   write_add_object(ctx, &lc->def);
+   blob_write_varint(ctx->blob,
+                     ssa_def_header(nir_instr_type_load_const, &lc->def));
+
+   /* Only the channels that exist, the arrays of the nir_const_value union
+    * all start at the same place.
+    */
+   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value,
+                    lc->def.num_components * lc->def.bit_size / 8);
+   write_add_ssa_def(ctx, &lc->def);
 }
 
 static nir_load_const_instr *
-read_load_const(read_ctx *ctx)
+read_load_const(read_ctx *ctx, uint32_t header)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
-
    nir_load_const_instr *lc =
-      nir_load_const_instr_create(ctx->nir, val & 0x7, val >> 3);
+      nir_load_const_instr_create(ctx->nir, ((header >> 4) & 0x3) + 1,
+                                  1 << ((header >> 6) & 0x7));
 
-   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value,
+                   lc->def.num_components * lc->def.bit_size / 8);
    read_add_object(ctx, &lc->def);
    return lc;
 }
@@ -555,19 +687,17 @@ read_load_const(read_ctx *ctx)
 static void
 write_ssa_undef(write_ctx *ctx, const nir_ssa_undef_instr *undef)
 {
-   uint32_t val = undef->def.num_components;
-   val |= undef->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
-   write_add_object(ctx, &undef->def);
+   blob_write_varint(ctx->blob,
+                     ssa_def_header(nir_instr_type_ssa_undef, &undef->def));
+   write_add_ssa_def(ctx, &undef->def);
 }
 
 static nir_ssa_undef_instr *
-read_ssa_undef(read_ctx *ctx)
+read_ssa_undef(read_ctx *ctx, uint32_t header)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
-
    nir_ssa_undef_instr *undef =
-      nir_ssa_undef_instr_create(ctx->nir, val & 0x7, val >> 3);
+      nir_ssa_undef_instr_create(ctx->nir, ((header >> 4) & 0x3) + 1,
+                                 1 << ((header >> 6) & 0x7));
 
    read_add_object(ctx, &undef->def);
    return undef;
@@ -591,11 +721,11 @@ union packed_tex_data {
 static void
 write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 {
-   blob_write_uint32(ctx->blob, tex->num_srcs);
-   blob_write_uint32(ctx->blob, tex->op);
-   blob_write_uint32(ctx->blob, tex->texture_index);
-   blob_write_uint32(ctx->blob, tex->texture_array_size);
-   blob_write_uint32(ctx->blob, tex->sampler_index);
+   blob_write_varint(ctx->blob, nir_instr_type_tex | tex->num_srcs << 4 |
+                                tex->op << 9);
+   blob_write_varint(ctx->blob, tex->texture_index);
+   blob_write_varint(ctx->blob, tex->texture_array_size);
+   blob_write_varint(ctx->blob, tex->sampler_index);
 
    STATIC_ASSERT(sizeof(union packed_tex_data) == sizeof(uint32_t));
    union packed_tex_data packed = {
@@ -609,11 +739,11 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
       .u.has_texture_deref = tex->texture != NULL,
       .u.has_sampler_deref = tex->sampler != NULL,
    };
-   blob_write_uint32(ctx->blob, packed.u32);
+   blob_write_varint(ctx->blob, packed.u32);
 
    write_dest(ctx, &tex->dest);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      blob_write_uint32(ctx->blob, tex->src[i].src_type);
+      blob_write_varint(ctx->blob, tex->src[i].src_type);
       write_src(ctx, &tex->src[i].src);
    }
 
@@ -624,18 +754,18 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 }
 
 static nir_tex_instr *
-read_tex(read_ctx *ctx)
+read_tex(read_ctx *ctx, uint32_t header)
 {
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   unsigned num_srcs = (header >> 4) & 0x1f;
    nir_tex_instr *tex = nir_tex_instr_create(ctx->nir, num_srcs);
 
-   tex->op = blob_read_uint32(ctx->blob);
-   tex->texture_index = blob_read_uint32(ctx->blob);
-   tex->texture_array_size = blob_read_uint32(ctx->blob);
-   tex->sampler_index = blob_read_uint32(ctx->blob);
+   tex->op = header >> 9;
+   tex->texture_index = blob_read_varint(ctx->blob);
+   tex->texture_array_size = blob_read_varint(ctx->blob);
+   tex->sampler_index = blob_read_varint(ctx->blob);
 
    union packed_tex_data packed;
-   packed.u32 = blob_read_uint32(ctx->blob);
+   packed.u32 = blob_read_varint(ctx->blob);
    tex->sampler_dim = packed.u.sampler_dim;
    tex->dest_type = packed.u.dest_type;
    tex->coord_components = packed.u.coord_components;
@@ -646,7 +776,7 @@ read_tex(read_ctx *ctx)
 
    read_dest(ctx, &tex->dest, &tex->instr);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      tex->src[i].src_type = blob_read_uint32(ctx->blob);
+      tex->src[i].src_type = blob_read_varint(ctx->blob);
       read_src(ctx, &tex->src[i].src, &tex->instr);
    }
 
@@ -661,41 +791,24 @@ read_tex(read_ctx *ctx)
 static void
 write_phi(write_ctx *ctx, const nir_phi_instr *phi)
 {
-   /* Phi nodes are special, since they may reference SSA definitions and
-    * basic blocks that don't exist yet. We leave two empty uintptr_t's here,
-    * and then store enough information so that a later fixup pass can fill
-    * them in correctly.
-    */
+   blob_write_varint(ctx->blob, nir_instr_type_phi);
+
    write_dest(ctx, &phi->dest);
 
-   blob_write_uint32(ctx->blob, exec_list_length(&phi->srcs));
+   blob_write_varint(ctx->blob, exec_list_length(&phi->srcs));
 
+   /* Phi nodes are special, since they may reference SSA definitions and
+    * basic blocks that haven't been written yet.  Their indices are known
+    * already though, so we store them as plain indices rather than relative
+    * to the current object.
+    */
    nir_foreach_phi_src(src, phi) {
       assert(src->src.is_ssa);
-      size_t blob_offset = blob_reserve_intptr(ctx->blob);
-      MAYBE_UNUSED size_t blob_offset2 = blob_reserve_intptr(ctx->blob);
-      assert(blob_offset + sizeof(uintptr_t) == blob_offset2);
-      write_phi_fixup fixup = {
-         .blob_offset = blob_offset,
-         .src = src->src.ssa,
-         .block = src->pred,
-      };
-      util_dynarray_append(&ctx->phi_fixups, write_phi_fixup, fixup);
+      blob_write_varint(ctx->blob, write_lookup_ssa_def(ctx, src->src.ssa));
+      blob_write_varint(ctx->blob, write_lookup_object(ctx, src->pred));
    }
 }
 
-static void
-write_fixup_phis(write_ctx *ctx)
-{
-   util_dynarray_foreach(&ctx->phi_fixups, write_phi_fixup, fixup) {
-      uintptr_t *blob_ptr = (uintptr_t *)(ctx->blob->data + fixup->blob_offset);
-      blob_ptr[0] = write_lookup_object(ctx, fixup->src);
-      blob_ptr[1] = write_lookup_object(ctx, fixup->block);
-   }
-
-   util_dynarray_clear(&ctx->phi_fixups);
-}
-
 static nir_phi_instr *
 read_phi(read_ctx *ctx, nir_block *blk)
 {
@@ -703,10 +816,10 @@ read_phi(read_ctx *ctx, nir_block *blk)
 
    read_dest(ctx, &phi->dest, &phi->instr);
 
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   unsigned num_srcs = blob_read_varint(ctx->blob);
 
-   /* For similar reasons as before, we just store the index directly into the
-    * pointer, and let a later pass resolve the phi sources.
+   /* The sources may not have been read yet, so we just store the index
+    * directly into the pointer, and let a later pass resolve the phi sources.
     *
     * In order to ensure that the copied sources (which are just the indices
     * from the blob for now) don't get inserted into the old shader's use-def
@@ -719,8 +832,8 @@ read_phi(read_ctx *ctx, nir_block *blk)
       nir_phi_src *src = ralloc(phi, nir_phi_src);
 
       src->src.is_ssa = true;
-      src->src.ssa = (nir_ssa_def *) blob_read_intptr(ctx->blob);
-      src->pred = (nir_block *) blob_read_intptr(ctx->blob);
+      src->src.ssa = (nir_ssa_def *)(uintptr_t) blob_read_varint(ctx->blob);
+      src->pred = (nir_block *)(uintptr_t) blob_read_varint(ctx->blob);
 
       /* Since we're not letting nir_insert_instr handle use/def stuff for us,
        * we have to set the parent_instr manually.  It doesn't really matter
@@ -757,13 +870,13 @@ read_fixup_phis(read_ctx *ctx)
 static void
 write_jump(write_ctx *ctx, const nir_jump_instr *jmp)
 {
-   blob_write_uint32(ctx->blob, jmp->type);
+   blob_write_varint(ctx->blob, nir_instr_type_jump | jmp->type << 4);
 }
 
 static nir_jump_instr *
-read_jump(read_ctx *ctx)
+read_jump(read_ctx *ctx, uint32_t header)
 {
-   nir_jump_type type = blob_read_uint32(ctx->blob);
+   nir_jump_type type = header >> 4;
    nir_jump_instr *jmp = nir_jump_instr_create(ctx->nir, type);
    return jmp;
 }
@@ -771,7 +884,8 @@ read_jump(read_ctx *ctx)
 static void
 write_call(write_ctx *ctx, const nir_call_instr *call)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, call->callee));
+   blob_write_varint(ctx->blob, nir_instr_type_call);
+   write_object(ctx, call->callee);
 
    for (unsigned i = 0; i < call->num_params; i++)
       write_deref_chain(ctx, call->params[i]);
@@ -796,7 +910,9 @@ read_call(read_ctx *ctx)
 static void
 write_instr(write_ctx *ctx, const nir_instr *instr)
 {
-   blob_write_uint32(ctx->blob, instr->type);
+   /* Each write_* function starts with a header holding the instruction type
+    * in its low NIR_SERIALIZE_INSTR_TYPE_BITS bits.
+    */
    switch (instr->type) {
    case nir_instr_type_alu:
       write_alu(ctx, nir_instr_as_alu(instr));
@@ -832,23 +948,25 @@ write_instr(write_ctx *ctx, const nir_instr *instr)
 static void
 read_instr(read_ctx *ctx, nir_block *block)
 {
-   nir_instr_type type = blob_read_uint32(ctx->blob);
+   uint32_t header = blob_read_varint(ctx->blob);
+   nir_instr_type type =
+      header & ((1 << NIR_SERIALIZE_INSTR_TYPE_BITS) - 1);
    nir_instr *instr;
    switch (type) {
    case nir_instr_type_alu:
-      instr = &read_alu(ctx)->instr;
+      instr = &read_alu(ctx, header)->instr;
       break;
    case nir_instr_type_intrinsic:
-      instr = &read_intrinsic(ctx)->instr;
+      instr = &read_intrinsic(ctx, header)->instr;
       break;
    case nir_instr_type_load_const:
-      instr = &read_load_const(ctx)->instr;
+      instr = &read_load_const(ctx, header)->instr;
       break;
    case nir_instr_type_ssa_undef:
-      instr = &read_ssa_undef(ctx)->instr;
+      instr = &read_ssa_undef(ctx, header)->instr;
       break;
    case nir_instr_type_tex:
-      instr = &read_tex(ctx)->instr;
+      instr = &read_tex(ctx, header)->instr;
       break;
    case nir_instr_type_phi:
       /* Phi instructions are a bit of a special case when reading because we
@@ -859,7 +977,7 @@ read_instr(read_ctx *ctx, nir_block *block)
       read_phi(ctx, block);
       return;
    case nir_instr_type_jump:
-      instr = &read_jump(ctx)->instr;
+      instr = &read_jump(ctx, header)->instr;
       break;
    case nir_instr_type_call:
       instr = &read_call(ctx)->instr;
@@ -876,8 +994,11 @@ read_instr(read_ctx *ctx, nir_block *block)
 static void
 write_block(write_ctx *ctx, const nir_block *block)
 {
-   write_add_object(ctx, block);
-   blob_write_uint32(ctx->blob, exec_list_length(&block->instr_list));
+   /* The index was handed out by write_function_impl already. */
+   assert(write_lookup_object(ctx, block) == ctx->next_idx);
+   ctx->next_idx++;
+
+   blob_write_varint(ctx->blob, exec_list_length(&block->instr_list));
    nir_foreach_instr(instr, block)
       write_instr(ctx, instr);
 }
@@ -893,7 +1014,7 @@ read_block(read_ctx *ctx, struct exec_list *cf_list)
       exec_node_data(nir_block, exec_list_get_tail(cf_list), cf_node.node);
 
    read_add_object(ctx, block);
-   unsigned num_instrs = blob_read_uint32(ctx->blob);
+   unsigned num_instrs = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_instrs; i++) {
       read_instr(ctx, block);
    }
@@ -946,7 +1067,7 @@ read_loop(read_ctx *ctx, struct exec_list *cf_list)
 static void
 write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 {
-   blob_write_uint32(ctx->blob, cf->type);
+   blob_write_varint(ctx->blob, cf->type);
 
    switch (cf->type) {
    case nir_cf_node_block:
@@ -966,7 +1087,7 @@ write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 static void
 read_cf_node(read_ctx *ctx, struct exec_list *list)
 {
-   nir_cf_node_type type = blob_read_uint32(ctx->blob);
+   nir_cf_node_type type = blob_read_varint(ctx->blob);
 
    switch (type) {
    case nir_cf_node_block:
@@ -986,7 +1107,7 @@ read_cf_node(read_ctx *ctx, struct exec_list *list)
 static void
 write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(cf_list));
+   blob_write_varint(ctx->blob, exec_list_length(cf_list));
    foreach_list_typed(nir_cf_node, cf, node, cf_list) {
       write_cf_node(ctx, cf);
    }
@@ -995,29 +1116,61 @@ write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 static void
 read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
 {
-   uint32_t num_cf_nodes = blob_read_uint32(ctx->blob);
+   uint32_t num_cf_nodes = blob_read_varint(ctx->blob);
    for (unsigned i = 0; i < num_cf_nodes; i++)
       read_cf_node(ctx, cf_list);
 }
 
+static bool
+assign_ssa_def_index(nir_ssa_def *def, void *state)
+{
+   write_ctx *ctx = state;
+   ctx->ssa_remap[def->index] = ctx->next_idx++;
+   return true;
+}
+
+/* Number the blocks and SSA values of the function implementation up front,
+ * in the order write_cf_list will write them, so that phis can refer to the
+ * ones that come later.
+ */
+static void
+assign_impl_indices(write_ctx *ctx, nir_function_impl *fi)
+{
+   ctx->ssa_remap = realloc(ctx->ssa_remap,
+                            MAX2(fi->ssa_alloc, 1) * sizeof(uint32_t));
+
+   uint32_t first_idx = ctx->next_idx;
+
+   nir_foreach_block(block, fi) {
+      write_add_object(ctx, block);
+      nir_foreach_instr(instr, block)
+         nir_foreach_ssa_def(instr, assign_ssa_def_index, ctx);
+   }
+
+   ctx->next_idx = first_idx;
+}
+
 static void
 write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 {
+   ctx->reg_remap = realloc(ctx->reg_remap,
+                            MAX2(fi->reg_alloc, 1) * sizeof(uint32_t));
+
    write_var_list(ctx, &fi->locals);
    write_reg_list(ctx, &fi->registers);
-   blob_write_uint32(ctx->blob, fi->reg_alloc);
+   blob_write_varint(ctx->blob, fi->reg_alloc);
 
-   blob_write_uint32(ctx->blob, fi->num_params);
+   blob_write_varint(ctx->blob, fi->num_params);
    for (unsigned i = 0; i < fi->num_params; i++) {
       write_variable(ctx, fi->params[i]);
    }
 
-   blob_write_uint32(ctx->blob, !!(fi->return_var));
+   blob_write_varint(ctx->blob, !!(fi->return_var));
    if (fi->return_var)
       write_variable(ctx, fi->return_var);
 
+   assign_impl_indices(ctx, (nir_function_impl *) fi);
    write_cf_list(ctx, &fi->body);
-   write_fixup_phis(ctx);
 }
 
 static nir_function_impl *
@@ -1028,14 +1181,15 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 
    read_var_list(ctx, &fi->locals);
    read_reg_list(ctx, &fi->registers);
-   fi->reg_alloc = blob_read_uint32(ctx->blob);
+   fi->reg_alloc = blob_read_varint(ctx->blob);
 
-   fi->num_params = blob_read_uint32(ctx->blob);
+   fi->num_params = blob_read_varint(ctx->blob);
+   fi->params = ralloc_array(fi, nir_variable *, fi->num_params);
    for (unsigned i = 0; i < fi->num_params; i++) {
       fi->params[i] = read_variable(ctx);
    }
 
-   bool has_return = blob_read_uint32(ctx->blob);
+   bool has_return = blob_read_varint(ctx->blob);
    if (has_return)
       fi->return_var = read_variable(ctx);
    else
@@ -1052,15 +1206,14 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 static void
 write_function(write_ctx *ctx, const nir_function *fxn)
 {
-   blob_write_uint32(ctx->blob, !!(fxn->name));
+   blob_write_varint(ctx->blob, (fxn->name != NULL) | fxn->num_params << 1);
    if (fxn->name)
       blob_write_string(ctx->blob, fxn->name);
 
    write_add_object(ctx, fxn);
 
-   blob_write_uint32(ctx->blob, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      blob_write_uint32(ctx->blob, fxn->params[i].param_type);
+      blob_write_varint(ctx->blob, fxn->params[i].param_type);
       encode_type_to_blob(ctx->blob, fxn->params[i].type);
    }
 
@@ -1076,16 +1229,17 @@ write_function(write_ctx *ctx, const nir_function *fxn)
 static void
 read_function(read_ctx *ctx)
 {
-   bool has_name = blob_read_uint32(ctx->blob);
-   char *name = has_name ? blob_read_string(ctx->blob) : NULL;
+   uint32_t flags = blob_read_varint(ctx->blob);
+   char *name = (flags & 1) ? blob_read_string(ctx->blob) : NULL;
 
    nir_function *fxn = nir_function_create(ctx->nir, name);
 
    read_add_object(ctx, fxn);
 
-   fxn->num_params = blob_read_uint32(ctx->blob);
+   fxn->num_params = flags >> 1;
+   fxn->params = ralloc_array(fxn, nir_parameter, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      fxn->params[i].param_type = blob_read_uint32(ctx->blob);
+      fxn->params[i].param_type = blob_read_varint(ctx->blob);
       fxn->params[i].type = decode_type_from_blob(ctx->blob);
    }
 
@@ -1101,9 +1255,11 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    ctx.next_idx = 0;
    ctx.blob = blob;
    ctx.nir = nir;
-   util_dynarray_init(&ctx.phi_fixups, NULL);
+   ctx.ssa_remap = NULL;
+   ctx.reg_remap = NULL;
+   ctx.global_reg_remap = malloc(MAX2(nir->reg_alloc, 1) * sizeof(uint32_t));
 
-   size_t idx_size_offset = blob_reserve_intptr(blob);
+   size_t idx_size_offset = blob_reserve_uint32(blob);
 
    struct shader_info info = nir->info;
    uint32_t strings = 0;
@@ -1111,7 +1267,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
       strings |= 0x1;
    if (info.label)
       strings |= 0x2;
-   blob_write_uint32(blob, strings);
+   blob_write_varint(blob, strings);
    if (info.name)
       blob_write_string(blob, info.name);
    if (info.label)
@@ -1127,13 +1283,13 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    write_var_list(&ctx, &nir->system_values);
 
    write_reg_list(&ctx, &nir->registers);
-   blob_write_uint32(blob, nir->reg_alloc);
-   blob_write_uint32(blob, nir->num_inputs);
-   blob_write_uint32(blob, nir->num_uniforms);
-   blob_write_uint32(blob, nir->num_outputs);
-   blob_write_uint32(blob, nir->num_shared);
+   blob_write_varint(blob, nir->reg_alloc);
+   blob_write_varint(blob, nir->num_inputs);
+   blob_write_varint(blob, nir->num_uniforms);
+   blob_write_varint(blob, nir->num_outputs);
+   blob_write_varint(blob, nir->num_shared);
 
-   blob_write_uint32(blob, exec_list_length(&nir->functions));
+   blob_write_varint(blob, exec_list_length(&nir->functions));
    nir_foreach_function(fxn, nir) {
       write_function(&ctx, fxn);
    }
@@ -1142,10 +1298,12 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
       write_function_impl(&ctx, fxn->impl);
    }
 
-   *(uintptr_t *)(blob->data + idx_size_offset) = ctx.next_idx;
+   blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
-   util_dynarray_fini(&ctx.phi_fixups);
+   free(ctx.ssa_remap);
+   free(ctx.reg_remap);
+   free(ctx.global_reg_remap);
 }
 
 nir_shader *
@@ -1156,11 +1314,11 @@ nir_deserialize(void *mem_ctx,
    read_ctx ctx;
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
-   ctx.idx_table_len = blob_read_intptr(blob);
-   ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
+   ctx.idx_table_len = blob_read_uint32(blob);
+   ctx.idx_table = malloc(ctx.idx_table_len * sizeof(void *));
    ctx.next_idx = 0;
 
-   uint32_t strings = blob_read_uint32(blob);
+   uint32_t strings = blob_read_varint(blob);
    char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
    char *label = (strings & 0x2) ? blob_read_string(blob) : NULL;
 
@@ -1182,13 +1340,13 @@ nir_deserialize(void *mem_ctx,
    read_var_list(&ctx, &ctx.nir->system_values);
 
    read_reg_list(&ctx, &ctx.nir->registers);
-   ctx.nir->reg_alloc = blob_read_uint32(blob);
-   ctx.nir->num_inputs = blob_read_uint32(blob);
-   ctx.nir->num_uniforms = blob_read_uint32(blob);
-   ctx.nir->num_outputs = blob_read_uint32(blob);
-   ctx.nir->num_shared = blob_read_uint32(blob);
+   ctx.nir->reg_alloc = blob_read_varint(blob);
+   ctx.nir->num_inputs = blob_read_varint(blob);
+   ctx.nir->num_uniforms = blob_read_varint(blob);
+   ctx.nir->num_outputs = blob_read_varint(blob);
+   ctx.nir->num_shared = blob_read_varint(blob);
 
-   unsigned num_functions = blob_read_uint32(blob);
+   unsigned num_functions = blob_read_varint(blob);
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
@@ -136,3 +136,34 @@ nir_block_worklist_pop_tail(nir_block_worklist *w)
    BITSET_CLEAR(w->blocks_present, w->blocks[tail]->index);
    return w->blocks[tail];
 }
+
+bool
+nir_instr_worklist_init(nir_instr_worklist *w)
+{
+   return u_vector_init(&w->instrs, sizeof(nir_instr *),
+                        64 * sizeof(nir_instr *));
+}
+
+void
+nir_instr_worklist_fini(nir_instr_worklist *w)
+{
+   u_vector_finish(&w->instrs);
+}
+
+void
+nir_instr_worklist_push_tail(nir_instr_worklist *w, nir_instr *instr)
+{
+   nir_instr **tail = u_vector_add(&w->instrs);
+
+   /* Allocation failure only loses the instruction, not correctness */
+   if (tail)
+      *tail = instr;
+}
+
+nir_instr *
+nir_instr_worklist_pop_head(nir_instr_worklist *w)
+{
+   nir_instr **head = u_vector_remove(&w->instrs);
+
+   return head ? *head : NULL;
+}
@@ -30,6 +30,7 @@
 #define _NIR_WORKLIST_
 
 #include "nir.h"
+#include "util/u_vector.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -83,6 +84,29 @@ nir_block *nir_block_worklist_peek_tail(const nir_block_worklist *w);
 
 nir_block *nir_block_worklist_pop_tail(nir_block_worklist *w);
 
+/** Represents a first-in first-out queue of instructions
+ *
+ * Unlike the block worklist, this one grows as needed and doesn't check
+ * for duplicates.  Callers which care can use nir_instr::pass_flags to
+ * keep track of which instructions are already queued.
+ */
+typedef struct {
+   struct u_vector instrs;
+} nir_instr_worklist;
+
+bool nir_instr_worklist_init(nir_instr_worklist *w);
+void nir_instr_worklist_fini(nir_instr_worklist *w);
+
+static inline bool
+nir_instr_worklist_is_empty(nir_instr_worklist *w)
+{
+   return u_vector_length(&w->instrs) == 0;
+}
+
+void nir_instr_worklist_push_tail(nir_instr_worklist *w, nir_instr *instr);
+
+nir_instr *nir_instr_worklist_pop_head(nir_instr_worklist *w);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,344 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Compare the compile time of the automaton-driven algebraic pass with the
+ * old one that tries every transform of the opcode, instruction by
+ * instruction.
+ *
+ * Usage: nir_algebraic_bench [-n iterations] [file.spv...]
+ *
+ * Each SPIR-V file is converted to NIR, with the stage taken from the file
+ * name (.vert.spv, .frag.spv, ...; fragment otherwise), and lowered to SSA.
+ * Without files, a fixed set of random shaders is used instead.  Both
+ * passes then run the usual algebraic, constant folding, copy propagation
+ * and dead code loop to completion on copies of every shader, and the time
+ * spent is reported along with the instruction counts reached.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "spirv/nir_spirv.h"
+#include "util/os_time.h"
+
+/* Generated from nir_opt_algebraic.py by algebraic_passes.py. */
+bool test_opt_algebraic(nir_shader *shader);
+bool test_opt_algebraic_reference(nir_shader *shader);
+
+static const nir_shader_compiler_options options = {
+   .lower_fpow = true,
+   .lower_fsat = true,
+   .lower_flrp32 = true,
+};
+
+static nir_shader **shaders;
+static unsigned num_shaders, shaders_capacity;
+
+static void
+add_shader(nir_shader *shader)
+{
+   if (num_shaders == shaders_capacity) {
+      shaders_capacity = shaders_capacity ? shaders_capacity * 2 : 64;
+      shaders = realloc(shaders, shaders_capacity * sizeof(*shaders));
+      if (shaders == NULL) {
+         fprintf(stderr, "Out of memory\n");
+         exit(1);
+      }
+   }
+
+   shaders[num_shaders++] = shader;
+}
+
+static gl_shader_stage
+stage_from_path(const char *path)
+{
+   static const struct {
+      const char *ext;
+      gl_shader_stage stage;
+   } exts[] = {
+      { ".vert", MESA_SHADER_VERTEX },
+      { ".tesc", MESA_SHADER_TESS_CTRL },
+      { ".tese", MESA_SHADER_TESS_EVAL },
+      { ".geom", MESA_SHADER_GEOMETRY },
+      { ".frag", MESA_SHADER_FRAGMENT },
+      { ".comp", MESA_SHADER_COMPUTE },
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(exts); i++) {
+      if (strstr(path, exts[i].ext))
+         return exts[i].stage;
+   }
+
+   return MESA_SHADER_FRAGMENT;
+}
+
+static bool
+load_spirv(const char *path)
+{
+   FILE *f = fopen(path, "rb");
+   struct stat st;
+
+   if (f == NULL || fstat(fileno(f), &st) != 0 || st.st_size % 4 != 0) {
+      fprintf(stderr, "Can't read SPIR-V from %s\n", path);
+      if (f)
+         fclose(f);
+      return false;
+   }
+
+   uint32_t *words = malloc(st.st_size);
+   if (words == NULL || fread(words, 1, st.st_size, f) != (size_t) st.st_size) {
+      fprintf(stderr, "Can't read SPIR-V from %s\n", path);
+      free(words);
+      fclose(f);
+      return false;
+   }
+   fclose(f);
+
+   nir_function *entry_point =
+      spirv_to_nir(words, st.st_size / 4, NULL, 0, stage_from_path(path),
+                   "main", NULL, &options);
+   free(words);
+   if (entry_point == NULL) {
+      fprintf(stderr, "Can't convert %s to NIR\n", path);
+      return false;
+   }
+
+   nir_shader *shader = entry_point->shader;
+
+   nir_lower_returns(shader);
+   nir_inline_functions(shader);
+   foreach_list_typed_safe(nir_function, func, node, &shader->functions) {
+      if (func != entry_point)
+         exec_node_remove(&func->node);
+   }
+
+   nir_lower_global_vars_to_local(shader);
+   nir_split_var_copies(shader);
+   nir_lower_var_copies(shader);
+   nir_lower_vars_to_ssa(shader);
+   nir_copy_prop(shader);
+   nir_opt_dce(shader);
+
+   add_shader(shader);
+   return true;
+}
+
+static uint32_t rand_state;
+
+static unsigned
+random_below(unsigned n)
+{
+   rand_state = rand_state * 1103515245 + 12345;
+   return (rand_state >> 16) % n;
+}
+
+/* Scalar 32-bit opcodes the random shaders are built from. */
+static bool
+random_op_ok(nir_op op)
+{
+   const nir_op_info *info = &nir_op_infos[op];
+
+   if (info->output_size != 0 || info->num_inputs == 0)
+      return false;
+
+   unsigned bit_size = nir_alu_type_get_type_size(info->output_type);
+   if (bit_size != 0 && bit_size != 32)
+      return false;
+
+   for (unsigned i = 0; i < info->num_inputs; i++) {
+      if (info->input_sizes[i] != 0)
+         return false;
+
+      bit_size = nir_alu_type_get_type_size(info->input_types[i]);
+      if (bit_size != 0 && bit_size != 32)
+         return false;
+   }
+
+   return strstr(info->name, "div") == NULL &&
+          strstr(info->name, "mod") == NULL &&
+          strstr(info->name, "rem") == NULL &&
+          strstr(info->name, "pack") == NULL &&
+          strstr(info->name, "fquantize") == NULL;
+}
+
+struct random_shader {
+   nir_builder b;
+   nir_op ops[nir_num_opcodes];
+   unsigned num_ops;
+   nir_ssa_def *values[256];
+   unsigned num_values;
+   unsigned num_leaves;
+};
+
+static nir_ssa_def *
+random_expr(struct random_shader *rs, unsigned depth)
+{
+   if (depth == 0 || random_below(4) == 0) {
+      if (rs->num_values > rs->num_leaves && random_below(3) == 0) {
+         return rs->values[rs->num_leaves +
+                           random_below(rs->num_values - rs->num_leaves)];
+      }
+      return rs->values[random_below(rs->num_leaves)];
+   }
+
+   nir_op op = rs->ops[random_below(rs->num_ops)];
+   nir_ssa_def *srcs[4] = { NULL };
+   for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++)
+      srcs[i] = random_expr(rs, depth - 1);
+
+   nir_ssa_def *def = nir_build_alu(&rs->b, op, srcs[0], srcs[1], srcs[2],
+                                    srcs[3]);
+   if (rs->num_values < ARRAY_SIZE(rs->values))
+      rs->values[rs->num_values++] = def;
+
+   return def;
+}
+
+static void
+add_random_shaders(unsigned count)
+{
+   static const float float_leaves[] = { 0.0, -0.0, 1.0, -1.0, 2.0, 0.5 };
+   static const int int_leaves[] = { 0, 1, -1, 2, 16, 31, 0xff };
+   struct random_shader rs;
+
+   rs.num_ops = 0;
+   for (unsigned op = 0; op < nir_num_opcodes; op++) {
+      if (random_op_ok(op))
+         rs.ops[rs.num_ops++] = op;
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      nir_builder_init_simple_shader(&rs.b, NULL, MESA_SHADER_FRAGMENT,
+                                     &options);
+      nir_variable *out = nir_variable_create(rs.b.shader, nir_var_shader_out,
+                                              glsl_float_type(), "out");
+      nir_variable *in = nir_variable_create(rs.b.shader, nir_var_shader_in,
+                                             glsl_vec4_type(), "in");
+      nir_ssa_def *in_value = nir_load_var(&rs.b, in);
+
+      rand_state = i + 1;
+      rs.num_values = 0;
+      for (unsigned j = 0; j < ARRAY_SIZE(float_leaves); j++)
+         rs.values[rs.num_values++] = nir_imm_float(&rs.b, float_leaves[j]);
+      for (unsigned j = 0; j < ARRAY_SIZE(int_leaves); j++)
+         rs.values[rs.num_values++] = nir_imm_int(&rs.b, int_leaves[j]);
+      for (unsigned j = 0; j < 4; j++)
+         rs.values[rs.num_values++] = nir_channel(&rs.b, in_value, j);
+      rs.num_leaves = rs.num_values;
+
+      for (unsigned j = 0; j < 64; j++)
+         nir_store_var(&rs.b, out, random_expr(&rs, 7), 0x1);
+
+      add_shader(rs.b.shader);
+   }
+}
+
+static unsigned
+count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block)
+            count++;
+      }
+   }
+
+   return count;
+}
+
+static void
+run(const char *name, bool (*algebraic)(nir_shader *), unsigned iterations)
+{
+   uint64_t total_ns = 0;
+   unsigned instrs = 0, loops = 0;
+
+   for (unsigned i = 0; i < num_shaders; i++) {
+      for (unsigned n = 0; n < iterations; n++) {
+         nir_shader *shader = nir_shader_clone(NULL, shaders[i]);
+         bool progress;
+
+         int64_t start = os_time_get_nano();
+         do {
+            progress = algebraic(shader);
+            progress |= nir_opt_constant_folding(shader);
+            progress |= nir_copy_prop(shader);
+            progress |= nir_opt_dce(shader);
+            if (n == 0)
+               loops++;
+         } while (progress);
+         total_ns += os_time_get_nano() - start;
+
+         if (n == 0)
+            instrs += count_instrs(shader);
+         ralloc_free(shader);
+      }
+   }
+
+   printf("%-10s %10.3f ms %10u instructions %8u loop iterations\n", name,
+          total_ns / 1e6 / iterations, instrs, loops);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned iterations = 10;
+   int i = 1;
+
+   if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      iterations = MAX2(atoi(argv[i + 1]), 1);
+      i += 2;
+   }
+
+   for (; i < argc; i++) {
+      if (!load_spirv(argv[i]))
+         return 1;
+   }
+
+   if (num_shaders == 0)
+      add_random_shaders(200);
+
+   unsigned instrs = 0;
+   for (unsigned s = 0; s < num_shaders; s++)
+      instrs += count_instrs(shaders[s]);
+   printf("%u shaders, %u instructions, %u iterations\n",
+          num_shaders, instrs, iterations);
+
+   run("automaton", test_opt_algebraic, iterations);
+   run("reference", test_opt_algebraic_reference, iterations);
+
+   for (unsigned s = 0; s < num_shaders; s++)
+      ralloc_free(shaders[s]);
+   free(shaders);
+
+   return 0;
+}
@@ -0,0 +1,41 @@
+#
+# Copyright (C) 2026 agent <agent@local>
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# Generates copies of the passes of nir_opt_algebraic.py, named test_*,
+# along with the reference matcher and the automaton check of each, for
+# algebraic_tests.cpp and algebraic_bench.c.
+
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                os.pardir))
+
+import nir_algebraic
+import nir_opt_algebraic
+
+print nir_algebraic.AlgebraicPass("test_opt_algebraic",
+                                  nir_opt_algebraic.optimizations).render(reference=True)
+print nir_algebraic.AlgebraicPass("test_opt_algebraic_before_ffma",
+                                  nir_opt_algebraic.before_ffma_optimizations).render(reference=True)
+print nir_algebraic.AlgebraicPass("test_opt_algebraic_late",
+                                  nir_opt_algebraic.late_optimizations).render(reference=True)
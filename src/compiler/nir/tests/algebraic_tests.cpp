@@ -0,0 +1,343 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <string.h>
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+
+/* Generated from nir_opt_algebraic.py by algebraic_passes.py. */
+extern "C" {
+unsigned test_opt_algebraic_check_automaton(nir_shader *shader,
+                                            unsigned *num_matched);
+unsigned test_opt_algebraic_before_ffma_check_automaton(nir_shader *shader,
+                                                        unsigned *num_matched);
+unsigned test_opt_algebraic_late_check_automaton(nir_shader *shader,
+                                                 unsigned *num_matched);
+bool test_opt_algebraic_reference(nir_shader *shader);
+}
+
+class nir_algebraic_test : public ::testing::Test {
+protected:
+   nir_algebraic_test();
+   ~nir_algebraic_test();
+
+   void check_automaton();
+   nir_ssa_def *input();
+   nir_ssa_def *stored_value(unsigned index);
+   void optimize_loop();
+   void random_shader(unsigned seed);
+   nir_ssa_def *random_expr(unsigned depth);
+   unsigned random(unsigned n);
+
+   nir_shader_compiler_options options;
+   nir_builder b;
+   nir_variable *out;
+
+   nir_op ops[nir_num_opcodes];
+   unsigned num_ops;
+   nir_ssa_def *values[64];
+   unsigned num_values;
+   unsigned num_leaves;
+   uint32_t rand_state;
+};
+
+/* Scalar 32-bit opcodes the random shaders are built from.  Division and
+ * packing are left out, constant folding them isn't interesting here.
+ */
+static bool
+random_op_ok(nir_op op)
+{
+   const nir_op_info *info = &nir_op_infos[op];
+
+   if (info->output_size != 0 || info->num_inputs == 0)
+      return false;
+
+   unsigned bit_size = nir_alu_type_get_type_size(info->output_type);
+   if (bit_size != 0 && bit_size != 32)
+      return false;
+
+   for (unsigned i = 0; i < info->num_inputs; i++) {
+      if (info->input_sizes[i] != 0)
+         return false;
+
+      bit_size = nir_alu_type_get_type_size(info->input_types[i]);
+      if (bit_size != 0 && bit_size != 32)
+         return false;
+   }
+
+   return strstr(info->name, "div") == NULL &&
+          strstr(info->name, "mod") == NULL &&
+          strstr(info->name, "rem") == NULL &&
+          strstr(info->name, "pack") == NULL &&
+          strstr(info->name, "fquantize") == NULL;
+}
+
+nir_algebraic_test::nir_algebraic_test()
+{
+   memset(&options, 0, sizeof(options));
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   out = nir_variable_create(b.shader, nir_var_shader_out,
+                             glsl_float_type(), "out");
+
+   num_ops = 0;
+   for (unsigned op = 0; op < nir_num_opcodes; op++) {
+      if (random_op_ok((nir_op) op))
+         ops[num_ops++] = (nir_op) op;
+   }
+
+   num_values = 0;
+   num_leaves = 0;
+   rand_state = 0;
+}
+
+nir_algebraic_test::~nir_algebraic_test()
+{
+   ralloc_free(b.shader);
+}
+
+unsigned
+nir_algebraic_test::random(unsigned n)
+{
+   rand_state = rand_state * 1103515245 + 12345;
+   return (rand_state >> 16) % n;
+}
+
+nir_ssa_def *
+nir_algebraic_test::random_expr(unsigned depth)
+{
+   if (depth == 0 || random(4) == 0) {
+      /* Earlier expressions as well as the leaves, to get some sharing. */
+      if (num_values > num_leaves && random(3) == 0)
+         return values[num_leaves + random(num_values - num_leaves)];
+      return values[random(num_leaves)];
+   }
+
+   nir_op op = ops[random(num_ops)];
+   nir_ssa_def *srcs[4] = { NULL, NULL, NULL, NULL };
+   for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++)
+      srcs[i] = random_expr(depth - 1);
+
+   nir_ssa_def *def = nir_build_alu(&b, op, srcs[0], srcs[1], srcs[2], srcs[3]);
+   if (num_values < ARRAY_SIZE(values))
+      values[num_values++] = def;
+
+   return def;
+}
+
+void
+nir_algebraic_test::random_shader(unsigned seed)
+{
+   static const float float_leaves[] = { 0.0, -0.0, 1.0, -1.0, 2.0, 0.5 };
+   static const int int_leaves[] = { 0, 1, -1, 2, 16, 31, 0xff };
+
+   ralloc_free(b.shader);
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+   out = nir_variable_create(b.shader, nir_var_shader_out,
+                             glsl_float_type(), "out");
+
+   rand_state = seed;
+   num_values = 0;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(float_leaves); i++)
+      values[num_values++] = nir_imm_float(&b, float_leaves[i]);
+   for (unsigned i = 0; i < ARRAY_SIZE(int_leaves); i++)
+      values[num_values++] = nir_imm_int(&b, int_leaves[i]);
+   for (unsigned i = 0; i < 4; i++)
+      values[num_values++] = nir_ssa_undef(&b, 1, 32);
+   num_leaves = num_values;
+
+   for (unsigned i = 0; i < 16; i++)
+      nir_store_var(&b, out, random_expr(7), 0x1);
+}
+
+void
+nir_algebraic_test::check_automaton()
+{
+   unsigned matched = 0;
+
+   nir_validate_shader(b.shader);
+   nir_index_ssa_defs(b.impl);
+
+   EXPECT_EQ(0u, test_opt_algebraic_check_automaton(b.shader, &matched));
+   EXPECT_EQ(0u, test_opt_algebraic_before_ffma_check_automaton(b.shader,
+                                                                &matched));
+   EXPECT_EQ(0u, test_opt_algebraic_late_check_automaton(b.shader, &matched));
+   EXPECT_GT(matched, 0u);
+}
+
+nir_ssa_def *
+nir_algebraic_test::input()
+{
+   nir_variable *var = nir_variable_create(b.shader, nir_var_shader_in,
+                                           glsl_float_type(), "in");
+   return nir_load_var(&b, var);
+}
+
+/* The value written by the index-th store_var of the shader. */
+nir_ssa_def *
+nir_algebraic_test::stored_value(unsigned index)
+{
+   nir_foreach_block(block, b.impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_intrinsic)
+            continue;
+
+         nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(instr);
+         if (intrin->intrinsic == nir_intrinsic_store_var && index-- == 0) {
+            EXPECT_TRUE(intrin->src[0].is_ssa);
+            return intrin->src[0].ssa;
+         }
+      }
+   }
+
+   return NULL;
+}
+
+/* The loop drivers run after nir_opt_algebraic. */
+void
+nir_algebraic_test::optimize_loop()
+{
+   bool progress;
+
+   do {
+      progress = nir_opt_algebraic(b.shader);
+      progress |= nir_opt_constant_folding(b.shader);
+      progress |= nir_copy_prop(b.shader);
+      progress |= nir_opt_dce(b.shader);
+   } while (progress);
+}
+
+TEST_F(nir_algebraic_test, worklist_chain)
+{
+   /* fadd(fmul(x, 1.0), 0.0) needs the fadd to be looked at again once the
+    * fmul is gone.
+    */
+   nir_ssa_def *x = input();
+   nir_ssa_def *y = nir_fmul(&b, x, nir_imm_float(&b, 1.0));
+   nir_store_var(&b, out, nir_fadd(&b, y, nir_imm_float(&b, 0.0)), 0x1);
+
+   EXPECT_TRUE(nir_opt_algebraic(b.shader));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(x, stored_value(0));
+
+   EXPECT_FALSE(nir_opt_algebraic(b.shader));
+}
+
+TEST_F(nir_algebraic_test, worklist_users)
+{
+   /* Each fneg pair only becomes visible to the one above once the one
+    * below it is gone.
+    */
+   nir_ssa_def *x = input();
+   nir_ssa_def *y = x;
+   for (unsigned i = 0; i < 8; i++)
+      y = nir_fneg(&b, y);
+   nir_store_var(&b, out, y, 0x1);
+   nir_store_var(&b, out, nir_fneg(&b, y), 0x1);
+
+   EXPECT_TRUE(nir_opt_algebraic(b.shader));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(x, stored_value(0));
+
+   nir_ssa_def *neg = stored_value(1);
+   ASSERT_EQ(nir_instr_type_alu, neg->parent_instr->type);
+   nir_alu_instr *alu = nir_instr_as_alu(neg->parent_instr);
+   EXPECT_EQ(nir_op_fneg, alu->op);
+   EXPECT_EQ(x, alu->src[0].src.ssa);
+
+   EXPECT_FALSE(nir_opt_algebraic(b.shader));
+}
+
+TEST_F(nir_algebraic_test, worklist_constant_folding)
+{
+   /* The fadd is folded to 1.0 by the pass itself, which lets the fmul
+    * match in the same run.
+    */
+   nir_ssa_def *x = input();
+   nir_ssa_def *one = nir_fadd(&b, nir_imm_float(&b, 0.5),
+                               nir_imm_float(&b, 0.5));
+   nir_store_var(&b, out, nir_fmul(&b, x, one), 0x1);
+
+   EXPECT_TRUE(nir_opt_algebraic(b.shader));
+   nir_validate_shader(b.shader);
+   EXPECT_EQ(x, stored_value(0));
+
+   EXPECT_FALSE(nir_opt_algebraic(b.shader));
+}
+
+TEST_F(nir_algebraic_test, worklist_fixed_point)
+{
+   /* Whatever the worklist leaves behind, the old matcher must not find
+    * anything to do with either.
+    */
+   for (unsigned seed = 1; seed <= 200; seed++) {
+      random_shader(seed);
+      optimize_loop();
+      nir_validate_shader(b.shader);
+
+      EXPECT_FALSE(nir_opt_algebraic(b.shader));
+      EXPECT_FALSE(test_opt_algebraic_reference(b.shader));
+   }
+}
+
+TEST_F(nir_algebraic_test, simple_patterns)
+{
+   nir_ssa_def *x = nir_load_var(&b, nir_variable_create(b.shader,
+                                                          nir_var_shader_in,
+                                                          glsl_float_type(),
+                                                          "x"));
+   nir_ssa_def *y = nir_fadd(&b, x, nir_imm_float(&b, 1.0));
+
+   nir_store_var(&b, out, nir_fmul(&b, x, nir_imm_float(&b, 1.0)), 0x1);
+   nir_store_var(&b, out, nir_fadd(&b, nir_fmul(&b, x, y), x), 0x1);
+   nir_store_var(&b, out, nir_fneg(&b, nir_fneg(&b, y)), 0x1);
+   nir_store_var(&b, out, nir_fsat(&b, nir_fsat(&b, x)), 0x1);
+   nir_store_var(&b, out, nir_flrp(&b, x, y, nir_imm_float(&b, 0.0)), 0x1);
+   nir_store_var(&b, out, nir_fpow(&b, x, nir_imm_float(&b, 2.0)), 0x1);
+   nir_store_var(&b, out, nir_b2f(&b, nir_flt(&b, x, y)), 0x1);
+
+   check_automaton();
+}
+
+TEST_F(nir_algebraic_test, random_shaders)
+{
+   for (unsigned seed = 1; seed <= 200; seed++) {
+      random_shader(seed);
+      check_automaton();
+   }
+}
+
+TEST_F(nir_algebraic_test, random_shaders_lowering)
+{
+   options.lower_flrp32 = true;
+   options.lower_fpow = true;
+   options.lower_fsat = true;
+   options.lower_sub = true;
+   options.lower_negate = true;
+   options.fuse_ffma = true;
+
+   for (unsigned seed = 1; seed <= 200; seed++) {
+      random_shader(seed);
+      check_automaton();
+   }
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+
+class nir_serialize_test : public ::testing::Test {
+protected:
+   nir_serialize_test();
+   ~nir_serialize_test();
+
+   void build_loop();
+   void round_trip(size_t offset);
+
+   nir_builder b;
+   nir_variable *in, *out, *tmp;
+
+   struct blob blob;
+};
+
+static const nir_shader_compiler_options options = { };
+
+nir_serialize_test::nir_serialize_test()
+{
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_FRAGMENT, &options);
+
+   in = nir_variable_create(b.shader, nir_var_shader_in, glsl_vec4_type(),
+                            "in");
+   out = nir_variable_create(b.shader, nir_var_shader_out, glsl_vec4_type(),
+                             "out");
+   tmp = nir_local_variable_create(b.impl, glsl_float_type(), "tmp");
+
+   blob_init(&blob);
+}
+
+nir_serialize_test::~nir_serialize_test()
+{
+   blob_finish(&blob);
+   ralloc_free(b.shader);
+}
+
+static std::string
+print_shader(nir_shader *shader)
+{
+   char *buf = NULL;
+   size_t size = 0;
+   FILE *f = open_memstream(&buf, &size);
+
+   /* Value numbers depend on creation order, which serialization changes. */
+   nir_foreach_function(function, shader) {
+      if (function->impl)
+         nir_index_ssa_defs(function->impl);
+   }
+   nir_print_shader(shader, f);
+   fclose(f);
+
+   std::string str(buf, size);
+   free(buf);
+   return str;
+}
+
+/* Serialize b.shader and read it back from a copy placed \offset bytes into
+ * a buffer, then check that the result prints the same and serializes to
+ * the same bytes.
+ */
+void
+nir_serialize_test::round_trip(size_t offset)
+{
+   nir_validate_shader(b.shader);
+   nir_serialize(&blob, b.shader);
+
+   uint8_t *copy = (uint8_t *) malloc(offset + blob.size);
+   memcpy(copy + offset, blob.data, blob.size);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, copy + offset, blob.size);
+   nir_shader *shader = nir_deserialize(b.shader, &options, &reader);
+
+   EXPECT_FALSE(reader.overrun);
+   EXPECT_EQ(reader.end, reader.current);
+   free(copy);
+
+   nir_validate_shader(shader);
+   EXPECT_EQ(print_shader(b.shader), print_shader(shader));
+
+   struct blob again;
+   blob_init(&again);
+   nir_serialize(&again, shader);
+   EXPECT_EQ(blob.size, again.size);
+   EXPECT_EQ(0, memcmp(blob.data, again.data, MIN2(blob.size, again.size)));
+   blob_finish(&again);
+}
+
+/* A loop accumulating into tmp, which becomes phis once lowered to SSA:
+ *
+ * tmp = in.x;
+ * while (true) {
+ *    if (tmp >= in.y)
+ *       break;
+ *    tmp = tmp * 2.0 - in.z;
+ * }
+ * out = vec4(tmp, in.wzy);
+ */
+void
+nir_serialize_test::build_loop()
+{
+   nir_ssa_def *v = nir_load_var(&b, in);
+   nir_store_var(&b, tmp, nir_channel(&b, v, 0), 1);
+
+   nir_loop *loop = nir_push_loop(&b);
+   {
+      nir_ssa_def *t = nir_load_var(&b, tmp);
+      nir_if *nif = nir_push_if(&b, nir_fge(&b, t, nir_channel(&b, v, 1)));
+      nir_jump(&b, nir_jump_break);
+      nir_pop_if(&b, nif);
+
+      nir_ssa_def *mul = nir_fmul(&b, t, nir_imm_float(&b, 2.0));
+      nir_store_var(&b, tmp, nir_fsub(&b, mul, nir_channel(&b, v, 2)), 1);
+   }
+   nir_pop_loop(&b, loop);
+
+   static const unsigned swiz[4] = { 3, 2, 1, 0 };
+   nir_ssa_def *rest = nir_swizzle(&b, v, swiz, 3, false);
+   nir_store_var(&b, out, nir_vec4(&b, nir_load_var(&b, tmp),
+                                   nir_channel(&b, rest, 0),
+                                   nir_channel(&b, rest, 1),
+                                   nir_channel(&b, rest, 2)), 0xf);
+}
+
+TEST_F(nir_serialize_test, variables)
+{
+   build_loop();
+   round_trip(0);
+}
+
+TEST_F(nir_serialize_test, phis)
+{
+   build_loop();
+   nir_lower_vars_to_ssa(b.shader);
+   round_trip(0);
+}
+
+TEST_F(nir_serialize_test, registers)
+{
+   build_loop();
+   nir_lower_vars_to_ssa(b.shader);
+   nir_convert_from_ssa(b.shader, true);
+   round_trip(0);
+}
+
+TEST_F(nir_serialize_test, modifiers_and_constants)
+{
+   nir_ssa_def *v = nir_load_var(&b, in);
+   nir_ssa_def *d = nir_fadd(&b, v, nir_imm_vec4(&b, 1.0, -2.0, 0.5, 8.0));
+
+   nir_alu_instr *alu = nir_instr_as_alu(d->parent_instr);
+   alu->src[0].negate = true;
+   alu->src[1].abs = true;
+   alu->src[1].swizzle[0] = 3;
+   alu->dest.saturate = true;
+
+   nir_ssa_def *wide = nir_u2f64(&b, nir_imm_int64(&b, 0x123456789abcdll));
+   nir_ssa_def *x = nir_fadd(&b, nir_f2f32(&b, wide), nir_ssa_undef(&b, 1, 32));
+
+   nir_store_var(&b, out, nir_fmul(&b, d, x), 0xf);
+   round_trip(0);
+}
+
+/* The encoding is made of bytes, so the reader works wherever the data
+ * lives, without copying it to an aligned buffer first.
+ */
+TEST_F(nir_serialize_test, unaligned)
+{
+   build_loop();
+   nir_lower_vars_to_ssa(b.shader);
+   round_trip(1);
+}
+
+/* Simple SSA ALU instructions should take well under ten bytes each. */
+TEST_F(nir_serialize_test, compact)
+{
+   nir_ssa_def *v = nir_channel(&b, nir_load_var(&b, in), 0);
+
+   nir_serialize(&blob, b.shader);
+   size_t base_size = blob.size;
+   blob_finish(&blob);
+   blob_init(&blob);
+
+   const unsigned count = 1000;
+   for (unsigned i = 0; i < count; i++)
+      v = nir_fadd(&b, v, nir_fmul(&b, v, v));
+   nir_store_var(&b, out, nir_vec4(&b, v, v, v, v), 0xf);
+
+   round_trip(0);
+   EXPECT_LT(blob.size - base_size, 2 * count * 8);
+}
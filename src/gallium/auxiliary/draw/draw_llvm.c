@@ -52,11 +52,13 @@
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
 
 #include "util/u_math.h"
 #include "util/u_pointer.h"
 #include "util/u_string.h"
 #include "util/simple_list.h"
+#include "util/mesa-sha1.h"
 
 
 #define DEBUG_STORE 0
@@ -516,6 +518,12 @@ draw_llvm_create(struct draw_context *draw, LLVMContextRef context)
    llvm->nr_gs_variants = 0;
    make_empty_list(&llvm->gs_variants_list);
 
+   llvm->nr_tcs_variants = 0;
+   make_empty_list(&llvm->tcs_variants_list);
+
+   llvm->nr_tes_variants = 0;
+   make_empty_list(&llvm->tes_variants_list);
+
    return llvm;
 
 fail:
@@ -539,6 +547,27 @@ draw_llvm_destroy(struct draw_llvm *llvm)
 }
 
 
+/**
+ * Compute the shader cache key of a variant, which must cover everything
+ * that influences the generated code.
+ */
+static void
+draw_get_ir_cache_key(const struct tgsi_token *tokens,
+                      const void *key, unsigned key_size,
+                      unsigned num_attribs,
+                      unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, tokens,
+                     tgsi_num_tokens(tokens) * sizeof(struct tgsi_token));
+   _mesa_sha1_update(&ctx, key, key_size);
+   _mesa_sha1_update(&ctx, &num_attribs, sizeof(num_attribs));
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
 /**
  * Create LLVM-generated code for a vertex shader.
  */
@@ -552,6 +581,9 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
       llvm_vertex_shader(llvm->draw->vs.vertex_shader);
    LLVMTypeRef vertex_header;
    char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
 
    variant = MALLOC(sizeof *variant +
                     shader->variant_key_size -
@@ -565,7 +597,19 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u",
                  variant->shader->variants_cached);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   if (llvm->draw->disk_cache_find_shader) {
+      draw_get_ir_cache_key(llvm->draw->vs.vertex_shader->state.tokens,
+                            key, shader->variant_key_size, num_inputs,
+                            ir_sha1_cache_key);
+      llvm->draw->disk_cache_find_shader(llvm->draw->disk_cache_cookie,
+                                         &cached,
+                                         ir_sha1_cache_key);
+      needs_caching = !cached.data_size;
+   }
+
+   variant->gallivm = gallivm_create(module_name, llvm->context,
+                                     llvm->draw->disk_cache_find_shader ?
+                                     &cached : NULL);
 
    create_jit_types(variant);
 
@@ -587,7 +631,12 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    variant->jit_func = (draw_jit_vert_func)
          gallivm_jit_function(variant->gallivm, variant->function);
 
+   if (needs_caching)
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached,
+                                           ir_sha1_cache_key);
    gallivm_free_ir(variant->gallivm);
+   free(cached.data);
 
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -629,6 +678,8 @@ generate_vs(struct draw_llvm_variant *variant,
                      NULL,
                      draw_sampler,
                      &llvm->draw->vs.vertex_shader->info,
+                     NULL,
+                     NULL,
                      NULL);
 
    {
@@ -1553,19 +1604,19 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
    struct lp_build_sampler_soa *sampler = 0;
    LLVMValueRef ret, clipmask_bool_ptr;
    struct draw_llvm_variant_key *key = &variant->key;
-   /* If geometry shader is present we need to skip both the viewport
-    * transformation and clipping otherwise the inputs to the geometry
-    * shader will be incorrect.
+   /* If geometry or tessellation shaders are present we need to skip both
+    * the viewport transformation and clipping otherwise their inputs will
+    * be incorrect.
     * The code can't handle vp transform when vs writes vp index neither
     * (though this would be fixable here, but couldn't just broadcast
     * the values).
     */
-   const boolean bypass_viewport = key->has_gs || key->bypass_viewport ||
+   const boolean bypass_viewport = key->has_gs_or_tes || key->bypass_viewport ||
                                    vs_info->writes_viewport_index;
-   const boolean enable_cliptest = !key->has_gs && (key->clip_xy ||
-                                                    key->clip_z ||
-                                                    key->clip_user ||
-                                                    key->need_edgeflags);
+   const boolean enable_cliptest = !key->has_gs_or_tes && (key->clip_xy ||
+                                                           key->clip_z ||
+                                                           key->clip_user ||
+                                                           key->need_edgeflags);
    LLVMValueRef variant_func;
    const unsigned pos = draw->vs.position_output;
    const unsigned cv = draw->vs.clipvertex_output;
@@ -1983,7 +2034,8 @@ draw_llvm_make_variant_key(struct draw_llvm *llvm, char *store)
    /* XXX assumes edgeflag output not at 0 */
    key->need_edgeflags = (llvm->draw->vs.edgeflag_output ? TRUE : FALSE);
    key->ucp_enable = llvm->draw->rasterizer->clip_plane_enable;
-   key->has_gs = llvm->draw->gs.geometry_shader != NULL;
+   key->has_gs_or_tes = llvm->draw->gs.geometry_shader != NULL ||
+                        llvm->draw->tes.tess_eval_shader != NULL;
    key->num_outputs = draw_total_vs_outputs(llvm->draw);
 
    /* All variants of this shader will have the same value for
@@ -2054,7 +2106,7 @@ draw_llvm_dump_variant_key(struct draw_llvm_variant_key *key)
    debug_printf("bypass_viewport = %u\n", key->bypass_viewport);
    debug_printf("clip_halfz = %u\n", key->clip_halfz);
    debug_printf("need_edgeflags = %u\n", key->need_edgeflags);
-   debug_printf("has_gs = %u\n", key->has_gs);
+   debug_printf("has_gs_or_tes = %u\n", key->has_gs_or_tes);
    debug_printf("ucp_enable = %u\n", key->ucp_enable);
 
    for (i = 0 ; i < key->nr_vertex_elements; i++) {
@@ -2085,7 +2137,9 @@ draw_llvm_set_mapped_texture(struct draw_context *draw,
    struct draw_jit_texture *jit_tex;
 
    assert(shader_stage == PIPE_SHADER_VERTEX ||
-          shader_stage == PIPE_SHADER_GEOMETRY);
+          shader_stage == PIPE_SHADER_GEOMETRY ||
+          shader_stage == PIPE_SHADER_TESS_CTRL ||
+          shader_stage == PIPE_SHADER_TESS_EVAL);
 
    if (shader_stage == PIPE_SHADER_VERTEX) {
       assert(sview_idx < ARRAY_SIZE(draw->llvm->jit_context.textures));
@@ -2095,6 +2149,14 @@ draw_llvm_set_mapped_texture(struct draw_context *draw,
       assert(sview_idx < ARRAY_SIZE(draw->llvm->gs_jit_context.textures));
 
       jit_tex = &draw->llvm->gs_jit_context.textures[sview_idx];
+   } else if (shader_stage == PIPE_SHADER_TESS_CTRL) {
+      assert(sview_idx < ARRAY_SIZE(draw->llvm->tcs_jit_context.textures));
+
+      jit_tex = &draw->llvm->tcs_jit_context.textures[sview_idx];
+   } else if (shader_stage == PIPE_SHADER_TESS_EVAL) {
+      assert(sview_idx < ARRAY_SIZE(draw->llvm->tes_jit_context.textures));
+
+      jit_tex = &draw->llvm->tes_jit_context.textures[sview_idx];
    } else {
       assert(0);
       return;
@@ -2147,6 +2209,24 @@ draw_llvm_set_sampler_state(struct draw_context *draw,
             COPY_4V(jit_sam->border_color, s->border_color.f);
          }
       }
+   } else if (shader_type == PIPE_SHADER_TESS_CTRL ||
+              shader_type == PIPE_SHADER_TESS_EVAL) {
+      struct draw_jit_context *jit_context =
+         shader_type == PIPE_SHADER_TESS_CTRL ?
+         &draw->llvm->tcs_jit_context : &draw->llvm->tes_jit_context;
+
+      for (i = 0; i < draw->num_samplers[shader_type]; i++) {
+         struct draw_jit_sampler *jit_sam = &jit_context->samplers[i];
+
+         if (draw->samplers[shader_type][i]) {
+            const struct pipe_sampler_state *s
+               = draw->samplers[shader_type][i];
+            jit_sam->min_lod = s->min_lod;
+            jit_sam->max_lod = s->max_lod;
+            jit_sam->lod_bias = s->lod_bias;
+            COPY_4V(jit_sam->border_color, s->border_color.f);
+         }
+      }
    }
 }
 
@@ -2356,7 +2436,9 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
                      NULL,
                      sampler,
                      &llvm->draw->gs.geometry_shader->info,
-                     (const struct lp_build_tgsi_gs_iface *)&gs_iface);
+                     (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                     NULL,
+                     NULL);
 
    sampler->destroy(sampler);
 
@@ -2378,6 +2460,9 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
       llvm_geometry_shader(llvm->draw->gs.geometry_shader);
    LLVMTypeRef vertex_header;
    char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
 
    variant = MALLOC(sizeof *variant +
                     shader->variant_key_size -
@@ -2391,7 +2476,19 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_gs_variant%u",
                  variant->shader->variants_cached);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   if (llvm->draw->disk_cache_find_shader) {
+      draw_get_ir_cache_key(llvm->draw->gs.geometry_shader->state.tokens,
+                            key, shader->variant_key_size, num_outputs,
+                            ir_sha1_cache_key);
+      llvm->draw->disk_cache_find_shader(llvm->draw->disk_cache_cookie,
+                                         &cached,
+                                         ir_sha1_cache_key);
+      needs_caching = !cached.data_size;
+   }
+
+   variant->gallivm = gallivm_create(module_name, llvm->context,
+                                     llvm->draw->disk_cache_find_shader ?
+                                     &cached : NULL);
 
    create_gs_jit_types(variant);
 
@@ -2408,7 +2505,12 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    variant->jit_func = (draw_gs_jit_func)
          gallivm_jit_function(variant->gallivm, variant->function);
 
+   if (needs_caching)
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached,
+                                           ir_sha1_cache_key);
    gallivm_free_ir(variant->gallivm);
+   free(cached.data);
 
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -2490,3 +2592,784 @@ draw_gs_llvm_dump_variant_key(struct draw_gs_llvm_variant_key *key)
                    util_format_name(sampler[i].texture_state.format));
    }
 }
+
+
+/*
+ * Tessellation shaders.
+ */
+
+struct draw_tess_llvm_iface {
+   struct lp_build_tgsi_tess_iface base;
+
+   LLVMValueRef input;
+   LLVMValueRef output;
+};
+
+static inline const struct draw_tess_llvm_iface *
+draw_tess_llvm_iface(const struct lp_build_tgsi_tess_iface *iface)
+{
+   return (const struct draw_tess_llvm_iface *)iface;
+}
+
+/**
+ * Create LLVM type for the inputs and outputs of the tessellation
+ * shaders, an array of struct tgsi_exec_vector with
+ * TGSI_EXEC_TESS_ATTRIB_STRIDE attributes per vertex.
+ */
+static LLVMTypeRef
+create_tess_jit_io_type(struct gallivm_state *gallivm)
+{
+   LLVMTypeRef float_type = LLVMFloatTypeInContext(gallivm->context);
+   LLVMTypeRef io_array;
+
+   io_array = LLVMVectorType(float_type, TGSI_QUAD_SIZE); /* num patches */
+   io_array = LLVMArrayType(io_array, TGSI_NUM_CHANNELS); /* num channels */
+   io_array = LLVMArrayType(io_array, TGSI_EXEC_TESS_ATTRIB_STRIDE); /* num attrs per vertex */
+   io_array = LLVMPointerType(io_array, 0); /* num vertices per patch */
+
+   return io_array;
+}
+
+/**
+ * Return the address of a channel of vertex_index/attrib_index, with
+ * the indices of the given SoA channel if they are indirect.
+ */
+static LLVMValueRef
+draw_tess_llvm_chan_ptr(struct lp_build_tgsi_context *bld_base,
+                        LLVMValueRef io,
+                        boolean is_vindex_indirect,
+                        LLVMValueRef vertex_index,
+                        boolean is_aindex_indirect,
+                        LLVMValueRef attrib_index,
+                        LLVMValueRef swizzle_index,
+                        LLVMValueRef lane)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef indices[3];
+
+   indices[0] = vertex_index;
+   indices[1] = attrib_index;
+   indices[2] = swizzle_index;
+
+   if (is_vindex_indirect)
+      indices[0] = LLVMBuildExtractElement(builder, vertex_index, lane, "");
+   if (is_aindex_indirect)
+      indices[1] = LLVMBuildExtractElement(builder, attrib_index, lane, "");
+
+   return LLVMBuildGEP(builder, io, indices, 3, "");
+}
+
+/**
+ * Vertex indices come straight from the shader, keep them within the
+ * arrays.  Attribute indices are clamped already.
+ */
+static LLVMValueRef
+draw_tess_llvm_clamp_vertex_index(struct lp_build_tgsi_context *bld_base,
+                                  LLVMValueRef vertex_index)
+{
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+
+   return lp_build_min(uint_bld, vertex_index,
+                       lp_build_const_int_vec(bld_base->base.gallivm,
+                                              uint_bld->type,
+                                              TGSI_MAX_PATCH_VERTICES - 1));
+}
+
+static LLVMValueRef
+draw_tess_llvm_fetch(struct lp_build_tgsi_context *bld_base,
+                     LLVMValueRef io,
+                     boolean is_vindex_indirect,
+                     LLVMValueRef vertex_index,
+                     boolean is_aindex_indirect,
+                     LLVMValueRef attrib_index,
+                     LLVMValueRef swizzle_index)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef res;
+   struct lp_type type = bld_base->base.type;
+
+   if (is_vindex_indirect)
+      vertex_index = draw_tess_llvm_clamp_vertex_index(bld_base, vertex_index);
+
+   if (is_vindex_indirect || is_aindex_indirect) {
+      int i;
+      res = bld_base->base.zero;
+      for (i = 0; i < type.length; ++i) {
+         LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+         LLVMValueRef channel_vec, value;
+
+         channel_vec = draw_tess_llvm_chan_ptr(bld_base, io,
+                                               is_vindex_indirect, vertex_index,
+                                               is_aindex_indirect, attrib_index,
+                                               swizzle_index, idx);
+         channel_vec = LLVMBuildLoad(builder, channel_vec, "");
+         value = LLVMBuildExtractElement(builder, channel_vec, idx, "");
+
+         res = LLVMBuildInsertElement(builder, res, value, idx, "");
+      }
+   } else {
+      res = draw_tess_llvm_chan_ptr(bld_base, io,
+                                    FALSE, vertex_index,
+                                    FALSE, attrib_index,
+                                    swizzle_index, NULL);
+      res = LLVMBuildLoad(builder, res, "");
+   }
+
+   return res;
+}
+
+static LLVMValueRef
+draw_tess_llvm_fetch_input(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base,
+                           boolean is_vindex_indirect,
+                           LLVMValueRef vertex_index,
+                           boolean is_aindex_indirect,
+                           LLVMValueRef attrib_index,
+                           LLVMValueRef swizzle_index)
+{
+   const struct draw_tess_llvm_iface *tess = draw_tess_llvm_iface(tess_iface);
+
+   return draw_tess_llvm_fetch(bld_base, tess->input,
+                               is_vindex_indirect, vertex_index,
+                               is_aindex_indirect, attrib_index,
+                               swizzle_index);
+}
+
+static LLVMValueRef
+draw_tcs_llvm_fetch_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base,
+                           boolean is_vindex_indirect,
+                           LLVMValueRef vertex_index,
+                           boolean is_aindex_indirect,
+                           LLVMValueRef attrib_index,
+                           LLVMValueRef swizzle_index)
+{
+   const struct draw_tess_llvm_iface *tess = draw_tess_llvm_iface(tess_iface);
+
+   return draw_tess_llvm_fetch(bld_base, tess->output,
+                               is_vindex_indirect, vertex_index,
+                               is_aindex_indirect, attrib_index,
+                               swizzle_index);
+}
+
+static void
+draw_tcs_llvm_store_output(const struct lp_build_tgsi_tess_iface *tess_iface,
+                           struct lp_build_tgsi_context *bld_base,
+                           boolean is_vindex_indirect,
+                           LLVMValueRef vertex_index,
+                           boolean is_aindex_indirect,
+                           LLVMValueRef attrib_index,
+                           LLVMValueRef swizzle_index,
+                           LLVMValueRef value,
+                           LLVMValueRef mask_vec)
+{
+   const struct draw_tess_llvm_iface *tess = draw_tess_llvm_iface(tess_iface);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef channel_ptr, channel_vec;
+   struct lp_type type = bld_base->base.type;
+
+   if (is_vindex_indirect)
+      vertex_index = draw_tess_llvm_clamp_vertex_index(bld_base, vertex_index);
+
+   if (is_vindex_indirect || is_aindex_indirect) {
+      /* channels may hit the same address, store them one at a time */
+      int i;
+      for (i = 0; i < type.length; ++i) {
+         LLVMValueRef idx = lp_build_const_int32(gallivm, i);
+         LLVMValueRef cond, scalar;
+
+         channel_ptr = draw_tess_llvm_chan_ptr(bld_base, tess->output,
+                                               is_vindex_indirect, vertex_index,
+                                               is_aindex_indirect, attrib_index,
+                                               swizzle_index, idx);
+         channel_vec = LLVMBuildLoad(builder, channel_ptr, "");
+
+         cond = LLVMBuildICmp(builder, LLVMIntNE,
+                              LLVMBuildExtractElement(builder, mask_vec, idx, ""),
+                              lp_build_const_int32(gallivm, 0), "");
+         scalar = LLVMBuildSelect(builder, cond,
+                                  LLVMBuildExtractElement(builder, value, idx, ""),
+                                  LLVMBuildExtractElement(builder, channel_vec, idx, ""),
+                                  "");
+         channel_vec = LLVMBuildInsertElement(builder, channel_vec, scalar, idx, "");
+         LLVMBuildStore(builder, channel_vec, channel_ptr);
+      }
+   } else {
+      channel_ptr = draw_tess_llvm_chan_ptr(bld_base, tess->output,
+                                            FALSE, vertex_index,
+                                            FALSE, attrib_index,
+                                            swizzle_index, NULL);
+      channel_vec = LLVMBuildLoad(builder, channel_ptr, "");
+      channel_vec = lp_build_select(&bld_base->base, mask_vec,
+                                    value, channel_vec);
+      LLVMBuildStore(builder, channel_vec, channel_ptr);
+   }
+}
+
+/**
+ * Load system value DRAW_TESS_SV_x.
+ */
+static LLVMValueRef
+draw_tess_llvm_system_value(struct gallivm_state *gallivm,
+                            struct lp_type type,
+                            LLVMValueRef sv_ptr,
+                            unsigned sv)
+{
+   LLVMValueRef index = lp_build_const_int32(gallivm, sv);
+   LLVMValueRef res;
+
+   res = LLVMBuildGEP(gallivm->builder, sv_ptr, &index, 1, "");
+   res = LLVMBuildLoad(gallivm->builder, res, "");
+   return LLVMBuildBitCast(gallivm->builder, res,
+                           lp_build_vec_type(gallivm, type), "");
+}
+
+static struct lp_type
+draw_tess_llvm_type(void)
+{
+   struct lp_type tess_type;
+
+   memset(&tess_type, 0, sizeof tess_type);
+   tess_type.floating = TRUE; /* floating point values */
+   tess_type.sign = TRUE;     /* values are signed */
+   tess_type.norm = FALSE;    /* values are not limited to [0,1] or [-1,1] */
+   tess_type.width = 32;      /* 32-bit float */
+   tess_type.length = TGSI_QUAD_SIZE;
+
+   return tess_type;
+}
+
+/**
+ * Create LLVM types for various structures.
+ */
+static void
+create_tess_jit_types(struct gallivm_state *gallivm,
+                      LLVMTypeRef *context_ptr_type,
+                      LLVMTypeRef *io_ptr_type)
+{
+   LLVMTypeRef texture_type, sampler_type, context_type;
+
+   texture_type = create_jit_texture_type(gallivm, "texture");
+   sampler_type = create_jit_sampler_type(gallivm, "sampler");
+
+   context_type = create_jit_context_type(gallivm, texture_type, sampler_type,
+                                          "draw_jit_context");
+   *context_ptr_type = LLVMPointerType(context_type, 0);
+
+   *io_ptr_type = create_tess_jit_io_type(gallivm);
+}
+
+static void
+draw_tcs_llvm_generate(struct draw_llvm *llvm,
+                       struct draw_tcs_llvm_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef arg_types[6];
+   LLVMTypeRef func_type;
+   LLVMValueRef variant_func;
+   LLVMValueRef context_ptr, sv_ptr, phase, temps_ptr, invocation_id;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_build_sampler_soa *sampler = 0;
+   struct lp_bld_tgsi_system_values system_values;
+   char func_name[64];
+   struct lp_type tess_type = draw_tess_llvm_type();
+   struct lp_type int_type = lp_int_type(tess_type);
+   unsigned i;
+   struct draw_tess_llvm_iface tess_iface;
+   const struct tgsi_token *tokens = variant->shader->base.state.tokens;
+   const struct tgsi_shader_info *info = &variant->shader->base.info;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   struct lp_build_mask_context mask;
+
+   memset(&system_values, 0, sizeof(system_values));
+   memset(&tess_iface, 0, sizeof(tess_iface));
+
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_tcs_variant%u",
+                 variant->shader->variants_cached);
+
+   arg_types[0] = variant->context_ptr_type;             /* context */
+   arg_types[1] = variant->io_ptr_type;                  /* inputs */
+   arg_types[2] = variant->io_ptr_type;                  /* outputs */
+   arg_types[3] = LLVMPointerType(
+      lp_build_vec_type(gallivm, int_type), 0);          /* system_values */
+   arg_types[4] = int32_type;                            /* phase */
+   arg_types[5] = LLVMPointerType(
+      lp_build_vec_type(gallivm, tess_type), 0);         /* temps */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   variant_func = LLVMAddFunction(gallivm->module, func_name, func_type);
+
+   variant->function = variant_func;
+
+   LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(variant_func, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   context_ptr      = LLVMGetParam(variant_func, 0);
+   tess_iface.input = LLVMGetParam(variant_func, 1);
+   tess_iface.output = LLVMGetParam(variant_func, 2);
+   sv_ptr           = LLVMGetParam(variant_func, 3);
+   phase            = LLVMGetParam(variant_func, 4);
+   temps_ptr        = LLVMGetParam(variant_func, 5);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(tess_iface.input, "inputs");
+   lp_build_name(tess_iface.output, "outputs");
+   lp_build_name(sv_ptr, "system_values");
+   lp_build_name(phase, "phase");
+   lp_build_name(temps_ptr, "temps");
+
+   tess_iface.base.fetch_input = draw_tess_llvm_fetch_input;
+   tess_iface.base.fetch_output = draw_tcs_llvm_fetch_output;
+   tess_iface.base.store_output = draw_tcs_llvm_store_output;
+   if (info->opcode_count[TGSI_OPCODE_BARRIER]) {
+      tess_iface.base.phase = phase;
+      tess_iface.base.temps_ptr = temps_ptr;
+   }
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, variant_func, "entry");
+   builder = gallivm->builder;
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   system_values.prim_id =
+      draw_tess_llvm_system_value(gallivm, int_type, sv_ptr,
+                                  DRAW_TESS_SV_PRIMID);
+   system_values.vertices_in =
+      draw_tess_llvm_system_value(gallivm, int_type, sv_ptr,
+                                  DRAW_TESS_SV_VERTICESIN);
+   /* the same for all the channels */
+   invocation_id =
+      draw_tess_llvm_system_value(gallivm, int_type, sv_ptr,
+                                  DRAW_TESS_SV_INVOCATIONID);
+   system_values.invocation_id =
+      LLVMBuildExtractElement(builder, invocation_id,
+                              lp_build_const_int32(gallivm, 0), "");
+
+   consts_ptr = draw_jit_context_vs_constants(gallivm, context_ptr);
+   num_consts_ptr = draw_jit_context_num_vs_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = draw_llvm_sampler_soa_create(variant->key.samplers);
+
+   /* the channels of missing patches just compute garbage nobody reads */
+   lp_build_mask_begin(&mask, gallivm, tess_type,
+                       lp_build_const_int_vec(gallivm, int_type, ~0));
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      tgsi_dump(tokens, 0);
+      draw_tess_llvm_dump_variant_key(&variant->key);
+   }
+
+   lp_build_tgsi_soa(gallivm,
+                     tokens,
+                     tess_type,
+                     &mask,
+                     consts_ptr,
+                     num_consts_ptr,
+                     &system_values,
+                     NULL,
+                     NULL,
+                     context_ptr,
+                     NULL,
+                     sampler,
+                     info,
+                     NULL,
+                     NULL,
+                     &tess_iface.base);
+
+   sampler->destroy(sampler);
+
+   lp_build_mask_end(&mask);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, variant_func);
+}
+
+static void
+draw_tes_llvm_generate(struct draw_llvm *llvm,
+                       struct draw_tes_llvm_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef arg_types[4];
+   LLVMTypeRef func_type;
+   LLVMValueRef variant_func;
+   LLVMValueRef context_ptr, sv_ptr, io_ptr;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_build_sampler_soa *sampler = 0;
+   struct lp_bld_tgsi_system_values system_values;
+   char func_name[64];
+   struct lp_type tess_type = draw_tess_llvm_type();
+   struct lp_type int_type = lp_int_type(tess_type);
+   unsigned i, chan;
+   struct draw_tess_llvm_iface tess_iface;
+   const struct tgsi_token *tokens = variant->shader->base.state.tokens;
+   const struct tgsi_shader_info *info = &variant->shader->base.info;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
+   struct lp_build_mask_context mask;
+
+   memset(&system_values, 0, sizeof(system_values));
+   memset(&tess_iface, 0, sizeof(tess_iface));
+   memset(outputs, 0, sizeof(outputs));
+
+   util_snprintf(func_name, sizeof(func_name), "draw_llvm_tes_variant%u",
+                 variant->shader->variants_cached);
+
+   arg_types[0] = variant->context_ptr_type;             /* context */
+   arg_types[1] = variant->io_ptr_type;                  /* inputs */
+   arg_types[2] = LLVMPointerType(
+      lp_build_vec_type(gallivm, int_type), 0);          /* system_values */
+   arg_types[3] = variant->io_ptr_type;                  /* outputs */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   variant_func = LLVMAddFunction(gallivm->module, func_name, func_type);
+
+   variant->function = variant_func;
+
+   LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(variant_func, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   context_ptr      = LLVMGetParam(variant_func, 0);
+   tess_iface.input = LLVMGetParam(variant_func, 1);
+   sv_ptr           = LLVMGetParam(variant_func, 2);
+   io_ptr           = LLVMGetParam(variant_func, 3);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(tess_iface.input, "inputs");
+   lp_build_name(sv_ptr, "system_values");
+   lp_build_name(io_ptr, "outputs");
+
+   tess_iface.base.fetch_input = draw_tess_llvm_fetch_input;
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, variant_func, "entry");
+   builder = gallivm->builder;
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   system_values.prim_id =
+      draw_tess_llvm_system_value(gallivm, int_type, sv_ptr,
+                                  DRAW_TESS_SV_PRIMID);
+   system_values.vertices_in =
+      draw_tess_llvm_system_value(gallivm, int_type, sv_ptr,
+                                  DRAW_TESS_SV_VERTICESIN);
+   for (chan = 0; chan < 3; chan++) {
+      system_values.tess_coord[chan] =
+         draw_tess_llvm_system_value(gallivm, tess_type, sv_ptr,
+                                     DRAW_TESS_SV_TESSCOORD + chan);
+   }
+   for (chan = 0; chan < 4; chan++) {
+      system_values.tess_outer[chan] =
+         draw_tess_llvm_system_value(gallivm, tess_type, sv_ptr,
+                                     DRAW_TESS_SV_TESSOUTER + chan);
+   }
+   for (chan = 0; chan < 2; chan++) {
+      system_values.tess_inner[chan] =
+         draw_tess_llvm_system_value(gallivm, tess_type, sv_ptr,
+                                     DRAW_TESS_SV_TESSINNER + chan);
+   }
+
+   consts_ptr = draw_jit_context_vs_constants(gallivm, context_ptr);
+   num_consts_ptr = draw_jit_context_num_vs_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = draw_llvm_sampler_soa_create(variant->key.samplers);
+
+   /* the outputs of the channels past the last domain point are ignored */
+   lp_build_mask_begin(&mask, gallivm, tess_type,
+                       lp_build_const_int_vec(gallivm, int_type, ~0));
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      tgsi_dump(tokens, 0);
+      draw_tess_llvm_dump_variant_key(&variant->key);
+   }
+
+   lp_build_tgsi_soa(gallivm,
+                     tokens,
+                     tess_type,
+                     &mask,
+                     consts_ptr,
+                     num_consts_ptr,
+                     &system_values,
+                     NULL,
+                     outputs,
+                     context_ptr,
+                     NULL,
+                     sampler,
+                     info,
+                     NULL,
+                     NULL,
+                     &tess_iface.base);
+
+   sampler->destroy(sampler);
+
+   lp_build_mask_end(&mask);
+
+   for (i = 0; i < info->num_outputs; i++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         LLVMValueRef indices[3];
+         LLVMValueRef out_ptr;
+
+         if (!outputs[i][chan])
+            continue;
+
+         indices[0] = lp_build_const_int32(gallivm, 0);
+         indices[1] = lp_build_const_int32(gallivm, i);
+         indices[2] = lp_build_const_int32(gallivm, chan);
+         out_ptr = LLVMBuildGEP(builder, io_ptr, indices, 3, "");
+         LLVMBuildStore(builder,
+                        LLVMBuildLoad(builder, outputs[i][chan], ""),
+                        out_ptr);
+      }
+   }
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, variant_func);
+}
+
+struct draw_tcs_llvm_variant *
+draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
+                             const struct draw_tess_llvm_variant_key *key)
+{
+   struct draw_tcs_llvm_variant *variant;
+   struct llvm_tess_ctrl_shader *shader =
+      llvm_tess_ctrl_shader(llvm->draw->tcs.tess_ctrl_shader);
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
+
+   variant = MALLOC(sizeof *variant +
+                    shader->variant_key_size -
+                    sizeof variant->key);
+   if (!variant)
+      return NULL;
+
+   variant->llvm = llvm;
+   variant->shader = shader;
+
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_tcs_variant%u",
+                 variant->shader->variants_cached);
+
+   if (llvm->draw->disk_cache_find_shader) {
+      draw_get_ir_cache_key(shader->base.state.tokens,
+                            key, shader->variant_key_size, 0,
+                            ir_sha1_cache_key);
+      llvm->draw->disk_cache_find_shader(llvm->draw->disk_cache_cookie,
+                                         &cached,
+                                         ir_sha1_cache_key);
+      needs_caching = !cached.data_size;
+   }
+
+   variant->gallivm = gallivm_create(module_name, llvm->context,
+                                     llvm->draw->disk_cache_find_shader ?
+                                     &cached : NULL);
+
+   create_tess_jit_types(variant->gallivm, &variant->context_ptr_type,
+                         &variant->io_ptr_type);
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   draw_tcs_llvm_generate(llvm, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_func = (draw_tcs_jit_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   if (needs_caching)
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached,
+                                           ir_sha1_cache_key);
+   gallivm_free_ir(variant->gallivm);
+   free(cached.data);
+
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   /*variant->no = */shader->variants_created++;
+
+   return variant;
+}
+
+void
+draw_tcs_llvm_destroy_variant(struct draw_tcs_llvm_variant *variant)
+{
+   struct draw_llvm *llvm = variant->llvm;
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      debug_printf("Deleting TCS variant: %u tcs variants,\t%u total variants\n",
+                    variant->shader->variants_cached, llvm->nr_tcs_variants);
+   }
+
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item_local);
+   variant->shader->variants_cached--;
+   remove_from_list(&variant->list_item_global);
+   llvm->nr_tcs_variants--;
+   FREE(variant);
+}
+
+struct draw_tes_llvm_variant *
+draw_tes_llvm_create_variant(struct draw_llvm *llvm,
+                             const struct draw_tess_llvm_variant_key *key)
+{
+   struct draw_tes_llvm_variant *variant;
+   struct llvm_tess_eval_shader *shader =
+      llvm_tess_eval_shader(llvm->draw->tes.tess_eval_shader);
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
+
+   variant = MALLOC(sizeof *variant +
+                    shader->variant_key_size -
+                    sizeof variant->key);
+   if (!variant)
+      return NULL;
+
+   variant->llvm = llvm;
+   variant->shader = shader;
+
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_tes_variant%u",
+                 variant->shader->variants_cached);
+
+   if (llvm->draw->disk_cache_find_shader) {
+      draw_get_ir_cache_key(shader->base.state.tokens,
+                            key, shader->variant_key_size, 0,
+                            ir_sha1_cache_key);
+      llvm->draw->disk_cache_find_shader(llvm->draw->disk_cache_cookie,
+                                         &cached,
+                                         ir_sha1_cache_key);
+      needs_caching = !cached.data_size;
+   }
+
+   variant->gallivm = gallivm_create(module_name, llvm->context,
+                                     llvm->draw->disk_cache_find_shader ?
+                                     &cached : NULL);
+
+   create_tess_jit_types(variant->gallivm, &variant->context_ptr_type,
+                         &variant->io_ptr_type);
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   draw_tes_llvm_generate(llvm, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_func = (draw_tes_jit_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   if (needs_caching)
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached,
+                                           ir_sha1_cache_key);
+   gallivm_free_ir(variant->gallivm);
+   free(cached.data);
+
+   variant->list_item_global.base = variant;
+   variant->list_item_local.base = variant;
+   /*variant->no = */shader->variants_created++;
+
+   return variant;
+}
+
+void
+draw_tes_llvm_destroy_variant(struct draw_tes_llvm_variant *variant)
+{
+   struct draw_llvm *llvm = variant->llvm;
+
+   if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
+      debug_printf("Deleting TES variant: %u tes variants,\t%u total variants\n",
+                    variant->shader->variants_cached, llvm->nr_tes_variants);
+   }
+
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item_local);
+   variant->shader->variants_cached--;
+   remove_from_list(&variant->list_item_global);
+   llvm->nr_tes_variants--;
+   FREE(variant);
+}
+
+struct draw_tess_llvm_variant_key *
+draw_tess_llvm_make_variant_key(struct draw_llvm *llvm,
+                                enum pipe_shader_type shader_stage,
+                                char *store)
+{
+   unsigned i;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_sampler_static_state *draw_sampler;
+   const struct tgsi_shader_info *info =
+      shader_stage == PIPE_SHADER_TESS_CTRL ?
+      &llvm->draw->tcs.tess_ctrl_shader->info :
+      &llvm->draw->tes.tess_eval_shader->info;
+
+   key = (struct draw_tess_llvm_variant_key *)store;
+
+   memset(key, 0, offsetof(struct draw_tess_llvm_variant_key, samplers[0]));
+
+   /* All variants of this shader will have the same value for
+    * nr_samplers.  Not yet trying to compact away holes in the
+    * sampler array.
+    */
+   key->nr_samplers = info->file_max[TGSI_FILE_SAMPLER] + 1;
+   if (info->file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+   }
+
+   draw_sampler = key->samplers;
+
+   memset(draw_sampler, 0, MAX2(key->nr_samplers, key->nr_sampler_views) * sizeof *draw_sampler);
+
+   for (i = 0 ; i < key->nr_samplers; i++) {
+      lp_sampler_static_sampler_state(&draw_sampler[i].sampler_state,
+                                      llvm->draw->samplers[shader_stage][i]);
+   }
+   for (i = 0 ; i < key->nr_sampler_views; i++) {
+      lp_sampler_static_texture_state(&draw_sampler[i].texture_state,
+                                      llvm->draw->sampler_views[shader_stage][i]);
+   }
+
+   return key;
+}
+
+void
+draw_tess_llvm_dump_variant_key(struct draw_tess_llvm_variant_key *key)
+{
+   unsigned i;
+   struct draw_sampler_static_state *sampler = key->samplers;
+
+   for (i = 0 ; i < key->nr_sampler_views; i++) {
+      debug_printf("sampler[%i].src_format = %s\n", i,
+                   util_format_name(sampler[i].texture_state.format));
+   }
+}
@@ -71,6 +71,7 @@ struct tgsi_buffer;
 struct draw_pt_front_end;
 struct draw_assembler;
 struct draw_llvm;
+struct lp_cached_code;
 
 
 /**
@@ -155,6 +156,7 @@ struct draw_context
       /* Current active frontend */
       struct draw_pt_front_end *frontend;
       unsigned prim;
+      unsigned vertices_per_patch;
       unsigned opt;     /**< bitmask of PT_x flags */
       unsigned eltSize; /* saved eltSize for flushing */
 
@@ -200,11 +202,15 @@ struct draw_context
          /** vertex arrays */
          struct draw_vertex_buffer vbuffer[PIPE_MAX_ATTRIBS];
          
-         /** constant buffers (for vertex/geometry shader) */
+         /** constant buffers (for vertex/tessellation/geometry shader) */
          const void *vs_constants[PIPE_MAX_CONSTANT_BUFFERS];
          unsigned vs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
          const void *gs_constants[PIPE_MAX_CONSTANT_BUFFERS];
          unsigned gs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
+         const void *tcs_constants[PIPE_MAX_CONSTANT_BUFFERS];
+         unsigned tcs_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
+         const void *tes_constants[PIPE_MAX_CONSTANT_BUFFERS];
+         unsigned tes_constants_size[PIPE_MAX_CONSTANT_BUFFERS];
          
          /* pointer to planes */
          float (*planes)[DRAW_TOTAL_CLIP_PLANES][4]; 
@@ -296,6 +302,40 @@ struct draw_context
 
    } gs;
 
+   /** Tessellation control shader state */
+   struct {
+      struct draw_tess_ctrl_shader *tess_ctrl_shader;
+
+      /** Fields for TGSI interpreter / execution */
+      struct {
+         struct tgsi_exec_machine *machine;
+
+         struct tgsi_sampler *sampler;
+         struct tgsi_image *image;
+         struct tgsi_buffer *buffer;
+      } tgsi;
+   } tcs;
+
+   /** Tessellation evaluation shader state */
+   struct {
+      struct draw_tess_eval_shader *tess_eval_shader;
+      uint num_tes_outputs;  /**< convenience, from tess_eval_shader */
+      uint position_output;
+
+      /** Fields for TGSI interpreter / execution */
+      struct {
+         struct tgsi_exec_machine *machine;
+
+         struct tgsi_sampler *sampler;
+         struct tgsi_image *image;
+         struct tgsi_buffer *buffer;
+      } tgsi;
+   } tes;
+
+   /** Tessellation levels used when there is no control shader */
+   float default_outer_tess_level[4];
+   float default_inner_tess_level[2];
+
    /** Fragment shader state */
    struct {
       struct draw_fragment_shader *fragment_shader;
@@ -326,10 +366,18 @@ struct draw_context
 
    struct draw_llvm *llvm;
 
+   /** Optional driver hooks to look up/store JIT code in a shader cache */
+   void *disk_cache_cookie;
+   void (*disk_cache_find_shader)(void *cookie,
+                                  struct lp_cached_code *cache,
+                                  unsigned char ir_sha1_cache_key[20]);
+   void (*disk_cache_insert_shader)(void *cookie,
+                                    struct lp_cached_code *cache,
+                                    unsigned char ir_sha1_cache_key[20]);
+
    /** Texture sampler and sampler view state.
-    * Note that we have arrays indexed by shader type.  At this time
-    * we only handle vertex and geometry shaders in the draw module, but
-    * there may be more in the future (ex: hull and tessellation).
+    * Note that we have arrays indexed by shader type.  We handle vertex,
+    * tessellation and geometry shaders in the draw module.
     */
    struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
    unsigned num_sampler_views[PIPE_SHADER_TYPES];
@@ -399,6 +447,12 @@ boolean draw_gs_init( struct draw_context *draw );
 
 void draw_gs_destroy( struct draw_context *draw );
 
+/*******************************************************************************
+ * Tessellation shading code:
+ */
+boolean draw_tess_init( struct draw_context *draw );
+void draw_tess_destroy( struct draw_context *draw );
+
 /*******************************************************************************
  * Common shading code:
  */
@@ -32,6 +32,7 @@
 
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
 #include "draw/draw_vbuf.h"
@@ -62,11 +63,21 @@ draw_pt_arrays(struct draw_context *draw,
    struct draw_pt_middle_end *middle = NULL;
    unsigned opt = 0;
 
+   /* Patches are meaningless without a tessellation evaluation shader */
+   if (prim == PIPE_PRIM_PATCHES && !draw->tes.tess_eval_shader)
+      return TRUE;
+
    /* Sanitize primitive length:
     */
    {
       unsigned first, incr;
-      draw_pt_split_prim(prim, &first, &incr);
+      if (prim == PIPE_PRIM_PATCHES) {
+         first = draw->pt.vertices_per_patch;
+         incr = draw->pt.vertices_per_patch;
+      }
+      else {
+         draw_pt_split_prim(prim, &first, &incr);
+      }
       count = draw_pt_trim_count(count, first, incr);
       if (count < first)
          return TRUE;
@@ -75,6 +86,8 @@ draw_pt_arrays(struct draw_context *draw,
    if (!draw->force_passthrough) {
       unsigned gs_out_prim = (draw->gs.geometry_shader ? 
                               draw->gs.geometry_shader->output_primitive :
+                              draw->tes.tess_eval_shader ?
+                              draw_tes_output_primitive(draw->tes.tess_eval_shader) :
                               prim);
 
       if (!draw->render) {
@@ -98,6 +111,9 @@ draw_pt_arrays(struct draw_context *draw,
 
    if (draw->pt.middle.llvm) {
       middle = draw->pt.middle.llvm;
+   } else if (draw->tes.tess_eval_shader) {
+      /* only the shading middle ends run the tessellation stages */
+      middle = draw->pt.middle.general;
    } else {
       if (opt == 0)
          middle = draw->pt.middle.fetch_emit;
@@ -481,6 +497,7 @@ draw_vbo(struct draw_context *draw,
    draw->pt.user.eltBias = info->index_bias;
    draw->pt.user.min_index = info->min_index;
    draw->pt.user.max_index = info->max_index;
+   draw->pt.vertices_per_patch = info->vertices_per_patch;
    draw->pt.user.eltSize = info->index_size ? draw->pt.user.eltSizeIB : 0;
 
    if (0)
@@ -35,6 +35,7 @@
 #include "draw/draw_pt.h"
 #include "draw/draw_vs.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 
 
 struct fetch_pipeline_middle_end {
@@ -76,15 +77,21 @@ fetch_pipeline_prepare(struct draw_pt_middle_end *middle,
    struct draw_context *draw = fpme->draw;
    struct draw_vertex_shader *vs = draw->vs.vertex_shader;
    struct draw_geometry_shader *gs = draw->gs.geometry_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
    unsigned i;
    unsigned instance_id_index = ~0;
    const unsigned gs_out_prim = (gs ? gs->output_primitive :
+                                 tes ? draw_tes_output_primitive(tes) :
                                  u_assembled_prim(prim));
    unsigned nr_vs_outputs = draw_total_vs_outputs(draw);
    unsigned nr = MAX2(vs->info.num_inputs, nr_vs_outputs);
    unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
                          gs_out_prim == PIPE_PRIM_POINTS;
 
+   if (tes) {
+      nr = MAX2(nr, tes->info.num_outputs + 1);
+   }
+
    if (gs) {
       nr = MAX2(nr, gs->info.num_outputs + 1);
    }
@@ -235,6 +242,10 @@ fetch_pipeline_generic(struct draw_pt_middle_end *middle,
    struct draw_context *draw = fpme->draw;
    struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_tess_eval_shader *teshader = draw->tes.tess_eval_shader;
+   const struct tgsi_shader_info *gs_input_info = &vshader->info;
+   struct draw_prim_info tes_prim_info;
+   struct draw_vertex_info tes_vert_info;
    struct draw_prim_info gs_prim_info;
    struct draw_vertex_info fetched_vert_info;
    struct draw_vertex_info vs_vert_info;
@@ -258,8 +269,12 @@ fetch_pipeline_generic(struct draw_pt_middle_end *middle,
    }
    if (draw->collect_statistics) {
       draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
+      if (prim_info->prim == PIPE_PRIM_PATCHES)
+         draw->statistics.ia_primitives +=
+            fetch_info->count / draw->pt.vertices_per_patch;
+      else
+         draw->statistics.ia_primitives +=
+            u_decomposed_prims_for_vertices(prim_info->prim, fetch_info->count);
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
@@ -286,13 +301,36 @@ fetch_pipeline_generic(struct draw_pt_middle_end *middle,
       vert_info = &vs_vert_info;
    }
 
+   if ((fpme->opt & PT_SHADE) && teshader) {
+      draw_tess_run(draw,
+                    vert_info,
+                    prim_info,
+                    &vshader->info,
+                    &tes_vert_info,
+                    &tes_prim_info);
+
+      FREE(vert_info->verts);
+      vert_info = &tes_vert_info;
+      prim_info = &tes_prim_info;
+      gs_input_info = &teshader->info;
+
+      if (!prim_info->count) {
+         FREE(vert_info->verts);
+         return;
+      }
+
+      /* the emit path counts vertices with 16 bits */
+      if (prim_info->count > 0xffff)
+         opt |= PT_PIPELINE;
+   }
+
    if ((fpme->opt & PT_SHADE) && gshader) {
       draw_geometry_shader_run(gshader,
                                draw->pt.user.gs_constants,
                                draw->pt.user.gs_constants_size,
                                vert_info,
                                prim_info,
-                               &vshader->info,
+                               gs_input_info,
                                &gs_vert_info,
                                &gs_prim_info);
 
@@ -25,11 +25,15 @@
  *
  **************************************************************************/
 
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
+#include "draw/draw_tess.h"
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "draw/draw_pt.h"
@@ -40,6 +44,33 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/** Max number of threads running the vertex shader of one draw */
+#define LLVM_VS_MAX_THREADS 8
+
+/**
+ * Don't split the vertices of a draw in chunks smaller than this, the
+ * cost of waking up a worker would outweigh the shading.
+ */
+#define LLVM_VS_MIN_CHUNK 256
+
+
+struct llvm_middle_end;
+
+/** A range of the fetched vertices shaded by one thread */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   struct util_queue_fence fence;
+
+   struct vertex_header *verts;
+   unsigned count;
+   unsigned start_or_maxelt;
+   const unsigned *elts;
+   unsigned vid_base;
+
+   boolean clipped;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -57,6 +88,14 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Worker threads for the vertex shader, created on the first draw big
+    * enough to use them.
+    */
+   unsigned num_threads;
+   boolean queue_created;
+   struct util_queue queue;
+   struct llvm_vs_job jobs[LLVM_VS_MAX_THREADS];
 };
 
 
@@ -138,6 +177,140 @@ llvm_middle_end_prepare_gs(struct llvm_middle_end *fpme)
    gs->current_variant = variant;
 }
 
+static void
+llvm_middle_end_prepare_tcs(struct llvm_middle_end *fpme)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_llvm *llvm = fpme->llvm;
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_tcs_llvm_variant *variant = NULL;
+   struct draw_tcs_llvm_variant_list_item *li;
+   struct llvm_tess_ctrl_shader *shader = llvm_tess_ctrl_shader(tcs);
+   char store[DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE];
+   unsigned i;
+
+   key = draw_tess_llvm_make_variant_key(llvm, PIPE_SHADER_TESS_CTRL, store);
+
+   /* Search shader's list of variants for the key */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      /* found the variant, move to head of global list (for LRU) */
+      move_to_head(&llvm->tcs_variants_list, &variant->list_item_global);
+   }
+   else {
+      /* Need to create new variant */
+
+      /* First check if we've created too many variants.  If so, free
+       * 3.125% of the LRU to avoid using too much memory.
+       */
+      if (llvm->nr_tcs_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+            debug_printf("Evicting TCS: %u tcs variants,\t%u total variants\n",
+                      shader->variants_cached, llvm->nr_tcs_variants);
+         }
+
+         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+            struct draw_tcs_llvm_variant_list_item *item;
+            if (is_empty_list(&llvm->tcs_variants_list)) {
+               break;
+            }
+            item = last_elem(&llvm->tcs_variants_list);
+            assert(item);
+            assert(item->base);
+            draw_tcs_llvm_destroy_variant(item->base);
+         }
+      }
+
+      variant = draw_tcs_llvm_create_variant(llvm, key);
+
+      if (variant) {
+         insert_at_head(&shader->variants, &variant->list_item_local);
+         insert_at_head(&llvm->tcs_variants_list,
+                        &variant->list_item_global);
+         llvm->nr_tcs_variants++;
+         shader->variants_cached++;
+      }
+   }
+
+   tcs->current_variant = variant;
+}
+
+static void
+llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_llvm *llvm = fpme->llvm;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   struct draw_tess_llvm_variant_key *key;
+   struct draw_tes_llvm_variant *variant = NULL;
+   struct draw_tes_llvm_variant_list_item *li;
+   struct llvm_tess_eval_shader *shader = llvm_tess_eval_shader(tes);
+   char store[DRAW_TESS_LLVM_MAX_VARIANT_KEY_SIZE];
+   unsigned i;
+
+   key = draw_tess_llvm_make_variant_key(llvm, PIPE_SHADER_TESS_EVAL, store);
+
+   /* Search shader's list of variants for the key */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      /* found the variant, move to head of global list (for LRU) */
+      move_to_head(&llvm->tes_variants_list, &variant->list_item_global);
+   }
+   else {
+      /* Need to create new variant */
+
+      /* First check if we've created too many variants.  If so, free
+       * 3.125% of the LRU to avoid using too much memory.
+       */
+      if (llvm->nr_tes_variants >= DRAW_MAX_SHADER_VARIANTS) {
+         if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+            debug_printf("Evicting TES: %u tes variants,\t%u total variants\n",
+                      shader->variants_cached, llvm->nr_tes_variants);
+         }
+
+         for (i = 0; i < DRAW_MAX_SHADER_VARIANTS / 32; i++) {
+            struct draw_tes_llvm_variant_list_item *item;
+            if (is_empty_list(&llvm->tes_variants_list)) {
+               break;
+            }
+            item = last_elem(&llvm->tes_variants_list);
+            assert(item);
+            assert(item->base);
+            draw_tes_llvm_destroy_variant(item->base);
+         }
+      }
+
+      variant = draw_tes_llvm_create_variant(llvm, key);
+
+      if (variant) {
+         insert_at_head(&shader->variants, &variant->list_item_local);
+         insert_at_head(&llvm->tes_variants_list,
+                        &variant->list_item_global);
+         llvm->nr_tes_variants++;
+         shader->variants_cached++;
+      }
+   }
+
+   tes->current_variant = variant;
+}
+
 /**
  * Prepare/validate middle part of the vertex pipeline.
  * NOTE: if you change this function, also look at the non-LLVM
@@ -154,7 +327,10 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
    struct draw_llvm *llvm = fpme->llvm;
    struct draw_vertex_shader *vs = draw->vs.vertex_shader;
    struct draw_geometry_shader *gs = draw->gs.geometry_shader;
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
    const unsigned out_prim = gs ? gs->output_primitive :
+      tes ? draw_tes_output_primitive(tes) :
       u_assembled_prim(in_prim);
    unsigned point_clip = draw->rasterizer->fill_front == PIPE_POLYGON_MODE_POINT ||
                          out_prim == PIPE_PRIM_POINTS;
@@ -173,7 +349,7 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
                             draw->rasterizer->clip_halfz,
                             (draw->vs.edgeflag_output ? TRUE : FALSE) );
 
-   draw_pt_so_emit_prepare( fpme->so_emit, gs == NULL );
+   draw_pt_so_emit_prepare( fpme->so_emit, gs == NULL && tes == NULL );
 
    if (!(opt & PT_PIPELINE)) {
       draw_pt_emit_prepare( fpme->emit, out_prim,
@@ -270,6 +446,12 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
    if (gs) {
       llvm_middle_end_prepare_gs(fpme);
    }
+   if (tcs) {
+      llvm_middle_end_prepare_tcs(fpme);
+   }
+   if (tes) {
+      llvm_middle_end_prepare_tes(fpme);
+   }
 }
 
 
@@ -307,6 +489,25 @@ llvm_middle_end_bind_parameters(struct draw_pt_middle_end *middle)
       }
    }
 
+   for (i = 0; i < ARRAY_SIZE(llvm->tcs_jit_context.vs_constants); ++i) {
+      int num_consts =
+         draw->pt.user.tcs_constants_size[i] / (sizeof(float) * 4);
+      llvm->tcs_jit_context.vs_constants[i] = draw->pt.user.tcs_constants[i];
+      llvm->tcs_jit_context.num_vs_constants[i] = num_consts;
+      if (num_consts == 0) {
+         llvm->tcs_jit_context.vs_constants[i] = fake_const_buf;
+      }
+   }
+   for (i = 0; i < ARRAY_SIZE(llvm->tes_jit_context.vs_constants); ++i) {
+      int num_consts =
+         draw->pt.user.tes_constants_size[i] / (sizeof(float) * 4);
+      llvm->tes_jit_context.vs_constants[i] = draw->pt.user.tes_constants[i];
+      llvm->tes_jit_context.num_vs_constants[i] = num_consts;
+      if (num_consts == 0) {
+         llvm->tes_jit_context.vs_constants[i] = fake_const_buf;
+      }
+   }
+
    llvm->jit_context.planes =
       (float (*)[DRAW_TOTAL_CLIP_PLANES][4]) draw->pt.user.planes[0];
    llvm->gs_jit_context.planes =
@@ -347,6 +548,113 @@ emit(struct pt_emit *emit,
 }
 
 
+static void
+llvm_vs_job_run(struct llvm_vs_job *job)
+{
+   struct llvm_middle_end *fpme = job->fpme;
+   struct draw_context *draw = fpme->draw;
+
+   job->clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                                  job->verts,
+                                                  draw->pt.user.vbuffer,
+                                                  job->count,
+                                                  job->start_or_maxelt,
+                                                  fpme->vertex_size,
+                                                  draw->pt.vertex_buffer,
+                                                  draw->instance_id,
+                                                  job->vid_base,
+                                                  draw->start_instance,
+                                                  job->elts);
+}
+
+
+static void
+llvm_vs_job_execute(void *data, int thread_index)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *) data;
+   unsigned fpstate = util_fpstate_get();
+
+   /* Same float state as the draw thread, see draw_vbo() */
+   util_fpstate_set_denorms_to_zero(fpstate);
+   llvm_vs_job_run(job);
+   util_fpstate_set(fpstate);
+}
+
+
+/**
+ * Run fetch and vertex shader over all the vertices of a draw.
+ *
+ * The jit function shades whole vectors of vertices, clamping the ones past
+ * the count, so the vertices can be split in vector aligned ranges which
+ * are shaded independently by worker threads, each one writing its outputs
+ * straight to its own part of \p verts.  The vertices thus end up in the
+ * same order as with a single call and everything after the vertex shader
+ * runs unchanged on the draw thread.
+ */
+static boolean
+llvm_middle_end_run_vs(struct llvm_middle_end *fpme,
+                       struct vertex_header *verts,
+                       unsigned count,
+                       unsigned start_or_maxelt,
+                       const unsigned *elts,
+                       unsigned vid_base)
+{
+   const unsigned vector_length = lp_native_vector_width / 32;
+   unsigned num_jobs = MIN2(fpme->num_threads, count / LLVM_VS_MIN_CHUNK);
+   unsigned chunk, start, i;
+   boolean clipped = FALSE;
+
+   if (num_jobs > 1 && !fpme->queue_created) {
+      fpme->queue_created = util_queue_init(&fpme->queue, "drawvs",
+                                            LLVM_VS_MAX_THREADS,
+                                            fpme->num_threads - 1, 0);
+      if (!fpme->queue_created)
+         fpme->num_threads = 1;
+   }
+
+   if (num_jobs <= 1 || !fpme->queue_created) {
+      struct llvm_vs_job *job = &fpme->jobs[0];
+
+      job->verts = verts;
+      job->count = count;
+      job->start_or_maxelt = start_or_maxelt;
+      job->elts = elts;
+      job->vid_base = vid_base;
+      llvm_vs_job_run(job);
+      return job->clipped;
+   }
+
+   chunk = align(DIV_ROUND_UP(count, num_jobs), vector_length);
+   num_jobs = DIV_ROUND_UP(count, chunk);
+
+   for (i = 0, start = 0; i < num_jobs; i++, start += chunk) {
+      struct llvm_vs_job *job = &fpme->jobs[i];
+
+      job->verts = (struct vertex_header *)
+         ((char *) verts + start * fpme->vertex_size);
+      job->count = MIN2(chunk, count - start);
+      job->start_or_maxelt = elts ? start_or_maxelt : start_or_maxelt + start;
+      job->elts = elts ? elts + start : NULL;
+      job->vid_base = vid_base;
+
+      /* The first range is shaded by the draw thread itself */
+      if (i > 0)
+         util_queue_add_job(&fpme->queue, job, &job->fence,
+                            llvm_vs_job_execute, NULL);
+   }
+
+   llvm_vs_job_run(&fpme->jobs[0]);
+   clipped = fpme->jobs[0].clipped;
+
+   for (i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&fpme->jobs[i].fence);
+      clipped |= fpme->jobs[i].clipped;
+   }
+
+   return clipped;
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -355,6 +663,10 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_tess_eval_shader *teshader = draw->tes.tess_eval_shader;
+   const struct tgsi_shader_info *gs_input_info = &draw->vs.vertex_shader->info;
+   struct draw_prim_info tes_prim_info;
+   struct draw_vertex_info tes_vert_info;
    struct draw_prim_info gs_prim_info;
    struct draw_vertex_info llvm_vert_info;
    struct draw_vertex_info gs_vert_info;
@@ -381,8 +693,12 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 
    if (draw->collect_statistics) {
       draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      if (prim_info->prim == PIPE_PRIM_PATCHES)
+         draw->statistics.ia_primitives +=
+            prim_info->count / draw->pt.vertices_per_patch;
+      else
+         draw->statistics.ia_primitives +=
+            u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
       draw->statistics.vs_invocations += fetch_info->count;
    }
 
@@ -396,31 +712,45 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       vid_base = draw->pt.user.eltBias;
       elts = fetch_info->elts;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
+   clipped = llvm_middle_end_run_vs(fpme, llvm_vert_info.verts,
+                                    fetch_info->count, start_or_maxelt,
+                                    elts, vid_base);
 
    /* Finished with fetch and vs:
     */
    fetch_info = NULL;
    vert_info = &llvm_vert_info;
 
+   if ((opt & PT_SHADE) && teshader) {
+      draw_tess_run(draw,
+                    vert_info,
+                    prim_info,
+                    gs_input_info,
+                    &tes_vert_info,
+                    &tes_prim_info);
+
+      FREE(vert_info->verts);
+      vert_info = &tes_vert_info;
+      prim_info = &tes_prim_info;
+      gs_input_info = &teshader->info;
+
+      if (!prim_info->count) {
+         FREE(vert_info->verts);
+         return;
+      }
+
+      /* the emit path counts vertices with 16 bits */
+      if (prim_info->count > 0xffff)
+         opt |= PT_PIPELINE;
+   }
+
    if ((opt & PT_SHADE) && gshader) {
-      struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
       draw_geometry_shader_run(gshader,
                                draw->pt.user.gs_constants,
                                draw->pt.user.gs_constants_size,
                                vert_info,
                                prim_info,
-                               &vshader->info,
+                               gs_input_info,
                                &gs_vert_info,
                                &gs_prim_info);
 
@@ -460,7 +790,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
     * will try to access non-existent position output.
     */
    if (draw_current_shader_position_output(draw) != -1) {
-      if ((opt & PT_SHADE) && (gshader ||
+      if ((opt & PT_SHADE) && (gshader || teshader ||
                                draw->vs.vertex_shader->info.writes_viewport_index)) {
          clipped = draw_pt_post_vs_run( fpme->post_vs, vert_info, prim_info );
       }
@@ -596,6 +926,13 @@ static void
 llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   unsigned i;
+
+   if (fpme->queue_created)
+      util_queue_destroy(&fpme->queue);
+
+   for (i = 0; i < LLVM_VS_MAX_THREADS; i++)
+      util_queue_fence_destroy(&fpme->jobs[i].fence);
 
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
@@ -617,6 +954,7 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned i;
 
    if (!draw->llvm)
       return NULL;
@@ -625,6 +963,11 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    if (!fpme)
       goto fail;
 
+   for (i = 0; i < LLVM_VS_MAX_THREADS; i++) {
+      fpme->jobs[i].fpme = fpme;
+      util_queue_fence_init(&fpme->jobs[i].fence);
+   }
+
    fpme->base.prepare         = llvm_middle_end_prepare;
    fpme->base.bind_parameters = llvm_middle_end_bind_parameters;
    fpme->base.run             = llvm_middle_end_run;
@@ -657,6 +1000,10 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   fpme->num_threads = debug_get_num_option("DRAW_NUM_THREADS",
+                                            util_cpu_caps.nr_cpus);
+   fpme->num_threads = CLAMP(fpme->num_threads, 1, LLVM_VS_MAX_THREADS);
+
    return &fpme->base;
 
  fail:
@@ -209,6 +209,7 @@ CONCAT(vsplit_segment_fan_, ELT_TYPE)(struct vsplit_frontend *vsplit,
 #define LOCAL_VARS                                                         \
    struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;   \
    const unsigned prim = vsplit->prim;                                     \
+   const unsigned vertices_per_patch = vsplit->draw->pt.vertices_per_patch; \
    const unsigned max_count_simple = vsplit->segment_size;                 \
    const unsigned max_count_loop = vsplit->segment_size - 1;               \
    const unsigned max_count_fan = vsplit->segment_size;
@@ -277,6 +278,7 @@ vsplit_segment_fan_linear(struct vsplit_frontend *vsplit, unsigned flags,
 #define LOCAL_VARS                                                         \
    struct vsplit_frontend *vsplit = (struct vsplit_frontend *) frontend;   \
    const unsigned prim = vsplit->prim;                                     \
+   const unsigned vertices_per_patch = vsplit->draw->pt.vertices_per_patch; \
    const unsigned max_count_simple = vsplit->max_vertices;                 \
    const unsigned max_count_loop = vsplit->segment_size - 1;               \
    const unsigned max_count_fan = vsplit->segment_size;
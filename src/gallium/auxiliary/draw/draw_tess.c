@@ -0,0 +1,1533 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Tessellation control and evaluation shaders, run with the TGSI
+ * interpreter or compiled by draw_llvm, and the fixed function tessellator
+ * in between.
+ *
+ * Patches are processed TGSI_QUAD_SIZE at a time: the control shader runs
+ * one invocation for all of them at once, one patch per SoA channel, and
+ * the evaluation shader is fed with domain points of any of these patches
+ * so that all its channels are busy regardless of the tessellation levels.
+ */
+
+#include "draw_tess.h"
+#include "draw_private.h"
+#include "draw_context.h"
+#ifdef HAVE_LLVM
+#include "draw_llvm.h"
+#include "gallivm/lp_bld_tgsi.h"
+#endif
+
+#include "tgsi/tgsi_parse.h"
+#include "tgsi/tgsi_exec.h"
+
+#include "pipe/p_shader_tokens.h"
+
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_prim.h"
+
+/** Number of patches shaded together, one per SoA channel */
+#define TESS_PATCH_BATCH TGSI_QUAD_SIZE
+
+/** Maximum tessellation level, GL_MAX_TESS_GEN_LEVEL */
+#define TESS_MAX_LEVEL 64
+
+
+static int
+tess_find_output(const struct tgsi_shader_info *info,
+                 unsigned semantic, unsigned index)
+{
+   unsigned i;
+
+   for (i = 0; i < info->num_outputs; i++) {
+      if (info->output_semantic_name[i] == semantic &&
+          info->output_semantic_index[i] == index)
+         return i;
+   }
+   return -1;
+}
+
+static inline boolean
+tess_is_patch_semantic(unsigned semantic)
+{
+   return semantic == TGSI_SEMANTIC_PATCH ||
+          semantic == TGSI_SEMANTIC_TESSOUTER ||
+          semantic == TGSI_SEMANTIC_TESSINNER;
+}
+
+/**
+ * Return the given channel of a system value register, or NULL if the
+ * shader doesn't read that system value.  The LLVM variants get all of
+ * them in jit_sv.
+ */
+static inline union tgsi_exec_channel *
+tess_system_value(struct tgsi_exec_machine *machine,
+                  union tgsi_exec_channel *jit_sv,
+                  unsigned semantic, unsigned chan)
+{
+   unsigned i;
+
+   if (jit_sv) {
+      switch (semantic) {
+      case TGSI_SEMANTIC_PRIMID:
+         return &jit_sv[DRAW_TESS_SV_PRIMID];
+      case TGSI_SEMANTIC_VERTICESIN:
+         return &jit_sv[DRAW_TESS_SV_VERTICESIN];
+      case TGSI_SEMANTIC_INVOCATIONID:
+         return &jit_sv[DRAW_TESS_SV_INVOCATIONID];
+      case TGSI_SEMANTIC_TESSCOORD:
+         return &jit_sv[DRAW_TESS_SV_TESSCOORD + chan];
+      case TGSI_SEMANTIC_TESSOUTER:
+         return &jit_sv[DRAW_TESS_SV_TESSOUTER + chan];
+      case TGSI_SEMANTIC_TESSINNER:
+         return &jit_sv[DRAW_TESS_SV_TESSINNER + chan];
+      default:
+         return NULL;
+      }
+   }
+
+   i = machine->SysSemanticToIndex[semantic];
+
+   if (i >= ARRAY_SIZE(machine->SystemValue))
+      return NULL;
+   return &machine->SystemValue[i].xyzw[chan];
+}
+
+static void
+tess_bind_machine(struct draw_context *draw,
+                  struct tgsi_exec_machine *machine,
+                  const struct tgsi_token *tokens,
+                  struct tgsi_sampler *sampler,
+                  struct tgsi_image *image,
+                  struct tgsi_buffer *buffer)
+{
+   if (!draw->llvm && machine->Tokens != tokens)
+      tgsi_exec_machine_bind_shader(machine, tokens, sampler, image, buffer);
+}
+
+/**
+ * Grow an array of elements of the given size to hold at least count of
+ * them.  Returns NULL, leaving the array untouched, on failure.
+ */
+static void *
+tess_grow(void *ptr, unsigned *max, unsigned count, unsigned size)
+{
+   if (count > *max) {
+      const unsigned new_max = MAX2(count, *max * 2);
+
+      ptr = REALLOC(ptr, *max * size, new_max * size);
+      if (ptr)
+         *max = new_max;
+   }
+   return ptr;
+}
+
+
+/*
+ * Fixed function tessellator.
+ */
+
+/**
+ * A tessellation level after clamping and rounding: the edge is split
+ * into n segments, which are all of the same length unless the spacing
+ * is fractional and f < n.
+ */
+struct tess_level {
+   float f;
+   unsigned n;
+};
+
+static struct tess_level
+tess_round_level(unsigned spacing, float level)
+{
+   struct tess_level l;
+   float min_level = spacing == PIPE_TESS_SPACING_FRACTIONAL_EVEN ? 2.0f : 1.0f;
+   float max_level = spacing == PIPE_TESS_SPACING_FRACTIONAL_ODD ?
+                     TESS_MAX_LEVEL - 1 : TESS_MAX_LEVEL;
+
+   /* written so that NaN clamps to the minimum */
+   if (!(level > min_level))
+      l.f = min_level;
+   else if (level > max_level)
+      l.f = max_level;
+   else
+      l.f = level;
+
+   l.n = (unsigned) ceilf(l.f);
+
+   switch (spacing) {
+   case PIPE_TESS_SPACING_FRACTIONAL_ODD:
+      l.n |= 1;
+      break;
+   case PIPE_TESS_SPACING_FRACTIONAL_EVEN:
+      l.n += l.n & 1;
+      break;
+   default:
+      l.f = (float) l.n;
+      break;
+   }
+   return l;
+}
+
+/**
+ * The rounding of an inner level of one when some outer level isn't: it
+ * is treated as 1 + epsilon, which only matters for the segment count.
+ */
+static struct tess_level
+tess_epsilon_level(unsigned spacing)
+{
+   struct tess_level l;
+
+   if (spacing == PIPE_TESS_SPACING_FRACTIONAL_ODD) {
+      l.f = 1.0f;
+      l.n = 3;
+   }
+   else {
+      l.f = 2.0f;
+      l.n = 2;
+   }
+   return l;
+}
+
+/**
+ * Position of the i-th of the n + 1 points subdividing a unit edge.
+ * Fractional levels give n - 2 segments of equal length plus two shorter
+ * ones, one at each end, so that the subdivision is symmetric and the
+ * edges shared by two patches match.
+ */
+static float
+tess_edge_point(struct tess_level l, unsigned i)
+{
+   float r, len;
+
+   if (i == 0)
+      return 0.0f;
+   if (i >= l.n)
+      return 1.0f;
+   if (2 * i > l.n)
+      return 1.0f - tess_edge_point(l, l.n - i);
+   if (l.n < 3 || l.f == (float) l.n)
+      return (float) i / l.n;
+
+   /* length of the short segments relative to the long ones */
+   r = 1.0f - (l.n - l.f) * 0.5f;
+   len = 1.0f / ((l.n - 2) + 2.0f * r);
+   return (r + (i - 1)) * len;
+}
+
+/**
+ * Make room for a patch whose levels split edges in at most max_n segments.
+ */
+static boolean
+tess_mesh_reserve(struct draw_tess_mesh *mesh, unsigned max_n)
+{
+   /* Generous bounds for all domains: an (n + 1) x (n + 5) grid of points,
+    * and at most four triangles per point.
+    */
+   const unsigned coords = mesh->num_coords + (max_n + 1) * (max_n + 5);
+   const unsigned indices = mesh->num_indices + (max_n + 1) * (max_n + 5) * 12;
+   void *p;
+
+   p = tess_grow(mesh->coords, &mesh->max_coords, coords,
+                 sizeof(mesh->coords[0]));
+   if (!p)
+      return FALSE;
+   mesh->coords = p;
+
+   p = tess_grow(mesh->indices, &mesh->max_indices, indices,
+                 sizeof(mesh->indices[0]));
+   if (!p)
+      return FALSE;
+   mesh->indices = p;
+
+   return TRUE;
+}
+
+static inline unsigned
+tess_add_coord(struct draw_tess_mesh *mesh, float u, float v, float w)
+{
+   float *coord = mesh->coords[mesh->num_coords];
+
+   assert(mesh->num_coords < mesh->max_coords);
+   coord[0] = u;
+   coord[1] = v;
+   coord[2] = w;
+   return mesh->num_coords++;
+}
+
+static inline void
+tess_add_line(struct draw_tess_mesh *mesh, unsigned i0, unsigned i1)
+{
+   assert(mesh->num_indices + 2 <= mesh->max_indices);
+   mesh->indices[mesh->num_indices++] = i0;
+   mesh->indices[mesh->num_indices++] = i1;
+}
+
+/**
+ * Add a triangle, counter-clockwise in the (u, v) plane.
+ */
+static inline void
+tess_add_tri(struct draw_tess_mesh *mesh,
+             unsigned i0, unsigned i1, unsigned i2)
+{
+   const float *p0 = mesh->coords[i0];
+   const float *p1 = mesh->coords[i1];
+   const float *p2 = mesh->coords[i2];
+   const float area = (p1[0] - p0[0]) * (p2[1] - p0[1]) -
+                      (p2[0] - p0[0]) * (p1[1] - p0[1]);
+
+   assert(mesh->num_indices + 3 <= mesh->max_indices);
+   mesh->indices[mesh->num_indices++] = i0;
+   if (area < 0.0f) {
+      mesh->indices[mesh->num_indices++] = i2;
+      mesh->indices[mesh->num_indices++] = i1;
+   }
+   else {
+      mesh->indices[mesh->num_indices++] = i1;
+      mesh->indices[mesh->num_indices++] = i2;
+   }
+}
+
+/**
+ * Connect one side of a ring of points to the facing side of the next
+ * inner ring with a strip of triangles.  Both sides run in the same
+ * direction, and the side whose next point comes first along it advances,
+ * which keeps the triangles well shaped when the point counts differ.
+ */
+static void
+tess_stitch(struct draw_tess_mesh *mesh,
+            const unsigned *outer, unsigned num_outer,
+            const unsigned *inner, unsigned num_inner)
+{
+   const float *a = mesh->coords[outer[0]];
+   const float *b = mesh->coords[outer[num_outer - 1]];
+   const float du = b[0] - a[0];
+   const float dv = b[1] - a[1];
+   unsigned o = 0, i = 0;
+
+   while (o + 1 < num_outer || i + 1 < num_inner) {
+      boolean advance_outer;
+
+      if (i + 1 == num_inner) {
+         advance_outer = TRUE;
+      }
+      else if (o + 1 == num_outer) {
+         advance_outer = FALSE;
+      }
+      else {
+         const float *po = mesh->coords[outer[o + 1]];
+         const float *pi = mesh->coords[inner[i + 1]];
+
+         advance_outer = (po[0] - a[0]) * du + (po[1] - a[1]) * dv <=
+                         (pi[0] - a[0]) * du + (pi[1] - a[1]) * dv;
+      }
+
+      if (advance_outer) {
+         tess_add_tri(mesh, outer[o], outer[o + 1], inner[i]);
+         o++;
+      }
+      else {
+         tess_add_tri(mesh, outer[o], inner[i + 1], inner[i]);
+         i++;
+      }
+   }
+}
+
+/**
+ * Subdivide the sides of the outermost ring, from corner j to corner j + 1,
+ * according to the outer levels.  The corners are shared between sides.
+ */
+static void
+tess_outer_ring(struct draw_tess_mesh *mesh,
+                unsigned num_sides,
+                const float (*corner)[3],
+                const struct tess_level *level,
+                unsigned (*side)[TESS_MAX_LEVEL + 1],
+                unsigned *side_len)
+{
+   unsigned corner_idx[4];
+   unsigned j, k;
+
+   for (j = 0; j < num_sides; j++)
+      corner_idx[j] = tess_add_coord(mesh, corner[j][0], corner[j][1],
+                                     corner[j][2]);
+
+   for (j = 0; j < num_sides; j++) {
+      const float *c0 = corner[j];
+      const float *c1 = corner[(j + 1) % num_sides];
+
+      side[j][0] = corner_idx[j];
+      for (k = 1; k < level[j].n; k++) {
+         const float t = tess_edge_point(level[j], k);
+
+         side[j][k] = tess_add_coord(mesh,
+                                     c0[0] + (c1[0] - c0[0]) * t,
+                                     c0[1] + (c1[1] - c0[1]) * t,
+                                     c0[2] + (c1[2] - c0[2]) * t);
+      }
+      side[j][level[j].n] = corner_idx[(j + 1) % num_sides];
+      side_len[j] = level[j].n + 1;
+   }
+}
+
+/**
+ * Triangle domain: concentric triangles, the outermost one subdivided by
+ * the outer levels and the inner ones by the inner level, two segments
+ * fewer for each ring, down to a single point or triangle.
+ */
+static void
+tess_triangles(struct draw_tess_mesh *mesh, unsigned spacing,
+               const float *outer_level, const float *inner_level)
+{
+   static const float corner[3][3] = {
+      { 1.0f, 0.0f, 0.0f },
+      { 0.0f, 1.0f, 0.0f },
+      { 0.0f, 0.0f, 1.0f }
+   };
+   /* outer level of each side: u == 0 is side 1, v == 0 side 2, w == 0
+    * side 0
+    */
+   static const unsigned side_level[3] = { 2, 0, 1 };
+   unsigned ring[3][TESS_MAX_LEVEL + 1], next[3][TESS_MAX_LEVEL + 1];
+   unsigned ring_len[3];
+   struct tess_level outer[3], inner;
+   float a = 0.0f;
+   unsigned j, k;
+
+   inner = tess_round_level(spacing, inner_level[0]);
+   for (j = 0; j < 3; j++)
+      outer[j] = tess_round_level(spacing, outer_level[side_level[j]]);
+
+   if (inner.n == 1) {
+      if (outer[0].n == 1 && outer[1].n == 1 && outer[2].n == 1) {
+         tess_add_tri(mesh,
+                      tess_add_coord(mesh, 1.0f, 0.0f, 0.0f),
+                      tess_add_coord(mesh, 0.0f, 1.0f, 0.0f),
+                      tess_add_coord(mesh, 0.0f, 0.0f, 1.0f));
+         return;
+      }
+      inner = tess_epsilon_level(spacing);
+   }
+
+   tess_outer_ring(mesh, 3, corner, outer, ring, ring_len);
+
+   for (;;) {
+      const unsigned m = inner.n - 2;
+      struct tess_level next_level;
+      unsigned next_corner[3];
+      float ring_corner[3][3];
+
+      if (m == 0) {
+         const unsigned center =
+            tess_add_coord(mesh, 1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f);
+
+         for (j = 0; j < 3; j++)
+            tess_stitch(mesh, ring[j], ring_len[j], &center, 1);
+         break;
+      }
+
+      /* The corners of the next ring are where the perpendiculars to the
+       * sides at the subdivision points closest to the corners meet.
+       */
+      a += (2.0f / 3.0f) * tess_edge_point(inner, 1) * (1.0f - 3.0f * a);
+      for (j = 0; j < 3; j++) {
+         for (k = 0; k < 3; k++)
+            ring_corner[j][k] = j == k ? 1.0f - 2.0f * a : a;
+         next_corner[j] = tess_add_coord(mesh, ring_corner[j][0],
+                                         ring_corner[j][1],
+                                         ring_corner[j][2]);
+      }
+
+      next_level.f = inner.f - 2.0f;
+      next_level.n = m;
+
+      for (j = 0; j < 3; j++) {
+         const float *c0 = ring_corner[j];
+         const float *c1 = ring_corner[(j + 1) % 3];
+
+         next[j][0] = next_corner[j];
+         for (k = 1; k < m; k++) {
+            const float t = tess_edge_point(next_level, k);
+
+            next[j][k] = tess_add_coord(mesh,
+                                        c0[0] + (c1[0] - c0[0]) * t,
+                                        c0[1] + (c1[1] - c0[1]) * t,
+                                        c0[2] + (c1[2] - c0[2]) * t);
+         }
+         next[j][m] = next_corner[(j + 1) % 3];
+
+         tess_stitch(mesh, ring[j], ring_len[j], next[j], m + 1);
+      }
+
+      if (m == 1) {
+         tess_add_tri(mesh, next_corner[0], next_corner[1], next_corner[2]);
+         break;
+      }
+
+      memcpy(ring, next, sizeof(ring));
+      ring_len[0] = ring_len[1] = ring_len[2] = m + 1;
+      inner = next_level;
+   }
+}
+
+/**
+ * Quad domain: a grid following the inner levels, whose outermost cells
+ * are replaced by a ring connecting it to the sides subdivided by the outer
+ * levels.
+ */
+static void
+tess_quads(struct draw_tess_mesh *mesh, unsigned spacing,
+           const float *outer_level, const float *inner_level)
+{
+   static const float corner[4][3] = {
+      { 0.0f, 0.0f, 0.0f },
+      { 1.0f, 0.0f, 0.0f },
+      { 1.0f, 1.0f, 0.0f },
+      { 0.0f, 1.0f, 0.0f }
+   };
+   /* outer level of each side: u == 0 is side 3, v == 0 side 0, u == 1
+    * side 1 and v == 1 side 2
+    */
+   static const unsigned side_level[4] = { 1, 2, 3, 0 };
+   unsigned ring[4][TESS_MAX_LEVEL + 1], inner_ring[4][TESS_MAX_LEVEL + 1];
+   unsigned ring_len[4];
+   struct tess_level outer[4], inner[2];
+   unsigned nu, nv, grid;
+   unsigned i, j;
+
+   inner[0] = tess_round_level(spacing, inner_level[0]);
+   inner[1] = tess_round_level(spacing, inner_level[1]);
+   for (j = 0; j < 4; j++)
+      outer[j] = tess_round_level(spacing, outer_level[side_level[j]]);
+
+   if (inner[0].n == 1 || inner[1].n == 1) {
+      if (inner[0].n == 1 && inner[1].n == 1 &&
+          outer[0].n == 1 && outer[1].n == 1 &&
+          outer[2].n == 1 && outer[3].n == 1) {
+         const unsigned i0 = tess_add_coord(mesh, 0.0f, 0.0f, 0.0f);
+         const unsigned i1 = tess_add_coord(mesh, 1.0f, 0.0f, 0.0f);
+         const unsigned i2 = tess_add_coord(mesh, 1.0f, 1.0f, 0.0f);
+         const unsigned i3 = tess_add_coord(mesh, 0.0f, 1.0f, 0.0f);
+
+         tess_add_tri(mesh, i0, i1, i2);
+         tess_add_tri(mesh, i0, i2, i3);
+         return;
+      }
+      if (inner[0].n == 1)
+         inner[0] = tess_epsilon_level(spacing);
+      if (inner[1].n == 1)
+         inner[1] = tess_epsilon_level(spacing);
+   }
+
+   tess_outer_ring(mesh, 4, corner, outer, ring, ring_len);
+
+   /* inner grid points, the ones not on the domain boundary */
+   nu = inner[0].n - 1;
+   nv = inner[1].n - 1;
+   grid = mesh->num_coords;
+   for (j = 0; j < nv; j++) {
+      const float v = tess_edge_point(inner[1], j + 1);
+
+      for (i = 0; i < nu; i++)
+         tess_add_coord(mesh, tess_edge_point(inner[0], i + 1), v, 0.0f);
+   }
+
+#define GRID(i, j) (grid + (j) * nu + (i))
+
+   /* the sides of the grid, in the same direction as the outer sides; they
+    * degenerate to a line or a point for the smallest inner levels
+    */
+   for (i = 0; i < nu; i++) {
+      inner_ring[0][i] = GRID(i, 0);
+      inner_ring[2][i] = GRID(nu - 1 - i, nv - 1);
+   }
+   for (j = 0; j < nv; j++) {
+      inner_ring[1][j] = GRID(nu - 1, j);
+      inner_ring[3][j] = GRID(0, nv - 1 - j);
+   }
+
+   for (j = 0; j < 4; j++)
+      tess_stitch(mesh, ring[j], ring_len[j], inner_ring[j], j & 1 ? nv : nu);
+
+   for (j = 0; j + 1 < nv; j++) {
+      for (i = 0; i + 1 < nu; i++) {
+         tess_add_tri(mesh, GRID(i, j), GRID(i + 1, j), GRID(i + 1, j + 1));
+         tess_add_tri(mesh, GRID(i, j), GRID(i + 1, j + 1), GRID(i, j + 1));
+      }
+   }
+
+#undef GRID
+}
+
+/**
+ * Isoline domain: the first outer level gives the number of lines, always
+ * with equal spacing, the second one the number of segments of each line.
+ */
+static void
+tess_isolines(struct draw_tess_mesh *mesh, unsigned spacing,
+              const float *outer_level)
+{
+   const struct tess_level lines =
+      tess_round_level(PIPE_TESS_SPACING_EQUAL, outer_level[0]);
+   const struct tess_level segments =
+      tess_round_level(spacing, outer_level[1]);
+   unsigned i, j;
+
+   for (j = 0; j < lines.n; j++) {
+      const float v = (float) j / lines.n;
+      const unsigned first = mesh->num_coords;
+
+      for (i = 0; i <= segments.n; i++)
+         tess_add_coord(mesh, tess_edge_point(segments, i), v, 0.0f);
+      for (i = 0; i < segments.n; i++)
+         tess_add_line(mesh, first + i, first + i + 1);
+   }
+}
+
+/**
+ * Tessellate one patch, appending its domain points and primitives to
+ * the mesh.  Patches with a relevant outer level that isn't positive are
+ * culled.
+ */
+static void
+tess_patch(struct draw_tess_eval_shader *tes,
+           const float *outer, const float *inner)
+{
+   struct draw_tess_mesh *mesh = &tes->mesh;
+   const unsigned num_outer = tes->prim_mode == PIPE_PRIM_QUADS ? 4 :
+                              tes->prim_mode == PIPE_PRIM_TRIANGLES ? 3 : 2;
+   const unsigned num_inner = tes->prim_mode == PIPE_PRIM_QUADS ? 2 :
+                              tes->prim_mode == PIPE_PRIM_TRIANGLES ? 1 : 0;
+   unsigned max_n = 0;
+   unsigned i;
+
+   for (i = 0; i < num_outer; i++) {
+      /* also catches NaN */
+      if (!(outer[i] > 0.0f))
+         return;
+      max_n = MAX2(max_n, tess_round_level(tes->spacing, outer[i]).n);
+   }
+   for (i = 0; i < num_inner; i++)
+      max_n = MAX2(max_n, tess_round_level(tes->spacing, inner[i]).n);
+   max_n = MAX2(max_n, 3);
+
+   if (!tess_mesh_reserve(mesh, max_n))
+      return;
+
+   switch (tes->prim_mode) {
+   case PIPE_PRIM_TRIANGLES:
+      tess_triangles(mesh, tes->spacing, outer, inner);
+      break;
+   case PIPE_PRIM_QUADS:
+      tess_quads(mesh, tes->spacing, outer, inner);
+      break;
+   default:
+      tess_isolines(mesh, tes->spacing, outer);
+      break;
+   }
+}
+
+
+/*
+ * Shader execution.
+ */
+
+/**
+ * Run all the invocations of the control shader with the interpreter.
+ */
+static void
+tess_exec_run_ctrl(struct draw_tess_ctrl_shader *tcs,
+                   unsigned vertices_in,
+                   unsigned num_patches,
+                   unsigned patch_id)
+{
+   struct tgsi_exec_machine *machine = tcs->machine;
+   union tgsi_exec_channel *sv;
+   unsigned lane, invocation, i;
+   boolean hit_barrier, restart;
+
+   for (i = 0; i < tcs->num_machines; i++) {
+      struct tgsi_exec_machine *m = tcs->machines[i];
+
+      if ((sv = tess_system_value(m, NULL, TGSI_SEMANTIC_PRIMID, 0))) {
+         for (lane = 0; lane < num_patches; lane++)
+            sv->u[lane] = patch_id + lane;
+      }
+      if ((sv = tess_system_value(m, NULL, TGSI_SEMANTIC_VERTICESIN, 0))) {
+         for (lane = 0; lane < TGSI_QUAD_SIZE; lane++)
+            sv->u[lane] = vertices_in;
+      }
+      if ((sv = tess_system_value(m, NULL, TGSI_SEMANTIC_INVOCATIONID, 0))) {
+         for (lane = 0; lane < TGSI_QUAD_SIZE; lane++)
+            sv->u[lane] = i;
+      }
+      /* keep the unused channels from storing to images and buffers */
+      m->NonHelperMask = (1 << num_patches) - 1;
+   }
+
+   if (tcs->num_machines == 1) {
+      /* Without barriers the invocations run one after the other, each for
+       * all the patches.  Memory barriers still stop the machine.
+       */
+      for (invocation = 0; invocation < tcs->vertices_out; invocation++) {
+         if ((sv = tess_system_value(machine, NULL,
+                                     TGSI_SEMANTIC_INVOCATIONID, 0))) {
+            for (lane = 0; lane < TGSI_QUAD_SIZE; lane++)
+               sv->u[lane] = invocation;
+         }
+         tgsi_exec_machine_run(machine, 0);
+         while (machine->pc != -1)
+            tgsi_exec_machine_run(machine, machine->pc);
+      }
+   }
+   else {
+      /* Every invocation runs up to the next barrier before any of them
+       * is resumed past it, like the threads of a compute shader.
+       */
+      restart = FALSE;
+      do {
+         hit_barrier = FALSE;
+         for (i = 0; i < tcs->num_machines; i++) {
+            struct tgsi_exec_machine *m = tcs->machines[i];
+
+            if (restart && m->pc == -1)
+               continue;
+            tgsi_exec_machine_run(m, restart ? m->pc : 0);
+            hit_barrier |= m->pc != -1;
+         }
+         restart = TRUE;
+      } while (hit_barrier);
+   }
+}
+
+#ifdef HAVE_LLVM
+/**
+ * Run all the invocations of the LLVM variant, one after the other for
+ * each phase, so that none of them gets past a barrier before the others
+ * reached it.
+ */
+static void
+tess_llvm_run_ctrl(struct draw_tess_ctrl_shader *tcs,
+                   unsigned vertices_in,
+                   unsigned patch_id)
+{
+   union tgsi_exec_channel *sv = tcs->jit_sv;
+   unsigned lane, phase, invocation;
+
+   for (lane = 0; lane < TGSI_QUAD_SIZE; lane++) {
+      sv[DRAW_TESS_SV_PRIMID].u[lane] = patch_id + lane;
+      sv[DRAW_TESS_SV_VERTICESIN].u[lane] = vertices_in;
+   }
+
+   for (phase = 0; phase < tcs->num_phases; phase++) {
+      for (invocation = 0; invocation < tcs->vertices_out; invocation++) {
+         union tgsi_exec_channel *temps = tcs->jit_temps ?
+            tcs->jit_temps + invocation * tcs->jit_temps_size : NULL;
+
+         for (lane = 0; lane < TGSI_QUAD_SIZE; lane++)
+            sv[DRAW_TESS_SV_INVOCATIONID].u[lane] = invocation;
+
+         tcs->current_variant->jit_func(&tcs->draw->llvm->tcs_jit_context,
+                                        tcs->inputs,
+                                        tcs->outputs,
+                                        sv,
+                                        phase,
+                                        temps);
+      }
+   }
+}
+#endif
+
+/**
+ * Run the tessellation control shader on num_patches patches and store
+ * their output control points in cp, vertices_out rows of
+ * info.num_outputs attributes per patch.  Per-patch outputs live in the
+ * first row.
+ */
+static void
+tess_run_ctrl(struct draw_tess_ctrl_shader *tcs,
+              const struct draw_vertex_info *input_verts,
+              const struct draw_prim_info *input_prim,
+              const int *input_map,
+              unsigned vertices_in,
+              unsigned first_patch,
+              unsigned num_patches,
+              unsigned patch_id,
+              float (*cp)[4])
+{
+   const unsigned num_outputs = tcs->info.num_outputs;
+   unsigned lane, v, slot, chan;
+
+   for (lane = 0; lane < num_patches; lane++) {
+      for (v = 0; v < vertices_in; v++) {
+         const unsigned i = input_prim->start +
+                            (first_patch + lane) * vertices_in + v;
+         const unsigned idx = input_prim->linear ? i : input_prim->elts[i];
+         const struct vertex_header *vertex = (const struct vertex_header *)
+            ((const char *)input_verts->verts + idx * input_verts->stride);
+
+         for (slot = 0; slot < tcs->info.num_inputs; slot++) {
+            struct tgsi_exec_vector *in =
+               &tcs->inputs[v * TGSI_EXEC_TESS_ATTRIB_STRIDE + slot];
+
+            for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+               in->xyzw[chan].f[lane] = input_map[slot] < 0 ? 0.0f :
+                  vertex->data[input_map[slot]][chan];
+            }
+         }
+      }
+   }
+
+#ifdef HAVE_LLVM
+   if (tcs->draw->llvm)
+      tess_llvm_run_ctrl(tcs, vertices_in, patch_id);
+   else
+#endif
+      tess_exec_run_ctrl(tcs, vertices_in, num_patches, patch_id);
+
+   for (lane = 0; lane < num_patches; lane++) {
+      for (v = 0; v < tcs->vertices_out; v++) {
+         const struct tgsi_exec_vector *out =
+            &tcs->outputs[v * TGSI_EXEC_TESS_ATTRIB_STRIDE];
+
+         for (slot = 0; slot < num_outputs; slot++) {
+            for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+               cp[slot][chan] = out[slot].xyzw[chan].f[lane];
+         }
+         cp += num_outputs;
+      }
+   }
+}
+
+/**
+ * Without a control shader the input vertices are the control points.
+ */
+static void
+tess_copy_ctrl(const struct draw_vertex_info *input_verts,
+               const struct draw_prim_info *input_prim,
+               unsigned num_outputs,
+               unsigned vertices_in,
+               unsigned first_patch,
+               unsigned num_patches,
+               float (*cp)[4])
+{
+   unsigned i;
+
+   for (i = 0; i < num_patches * vertices_in; i++) {
+      const unsigned j = input_prim->start + first_patch * vertices_in + i;
+      const unsigned idx = input_prim->linear ? j : input_prim->elts[j];
+      const struct vertex_header *vertex = (const struct vertex_header *)
+         ((const char *)input_verts->verts + idx * input_verts->stride);
+
+      memcpy(cp, vertex->data, num_outputs * sizeof(cp[0]));
+      cp += num_outputs;
+   }
+}
+
+/**
+ * Run the tessellation evaluation shader on all the domain points of the
+ * mesh, first_coord[p] being the first point of patch p.  Channels are
+ * filled with consecutive points whatever patch they belong to, and the
+ * patch inputs of a channel are only reloaded when its patch changes.
+ */
+static void
+tess_run_eval(struct draw_tess_eval_shader *tes,
+              const int *eval_map,
+              const float (*cp)[4],
+              unsigned cp_rows,
+              unsigned cp_slots,
+              const float (*outer)[4],
+              const float (*inner)[2],
+              const unsigned *first_coord,
+              unsigned num_patches,
+              unsigned patch_id,
+              unsigned vertex_size)
+{
+   struct tgsi_exec_machine *machine = tes->machine;
+   const struct draw_tess_mesh *mesh = &tes->mesh;
+   unsigned lane_patch[TGSI_QUAD_SIZE];
+   union tgsi_exec_channel *sv;
+   unsigned patch = 0;
+   unsigned i, lane, slot, chan, v;
+
+   for (lane = 0; lane < TGSI_QUAD_SIZE; lane++)
+      lane_patch[lane] = ~0u;
+
+   if ((sv = tess_system_value(machine, tes->jit_sv,
+                               TGSI_SEMANTIC_VERTICESIN, 0))) {
+      for (lane = 0; lane < TGSI_QUAD_SIZE; lane++)
+         sv->u[lane] = cp_rows;
+   }
+
+   for (i = 0; i < mesh->num_coords; i += TGSI_QUAD_SIZE) {
+      const unsigned n = MIN2(mesh->num_coords - i, TGSI_QUAD_SIZE);
+
+      for (lane = 0; lane < n; lane++) {
+         const float *coord = mesh->coords[i + lane];
+
+         while (patch + 1 < num_patches && i + lane >= first_coord[patch + 1])
+            patch++;
+
+         if (lane_patch[lane] != patch) {
+            const float (*patch_cp)[4] = cp + patch * cp_rows * cp_slots;
+
+            for (slot = 0; slot < tes->info.num_inputs; slot++) {
+               const int src = eval_map[slot];
+               const unsigned rows =
+                  tess_is_patch_semantic(tes->info.input_semantic_name[slot]) ?
+                  1 : cp_rows;
+
+               for (v = 0; v < rows; v++) {
+                  struct tgsi_exec_vector *in =
+                     &tes->inputs[v * TGSI_EXEC_TESS_ATTRIB_STRIDE + slot];
+
+                  for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+                     in->xyzw[chan].f[lane] = src < 0 ? 0.0f :
+                        patch_cp[v * cp_slots + src][chan];
+                  }
+               }
+            }
+
+            for (chan = 0; chan < 4; chan++) {
+               if ((sv = tess_system_value(machine, tes->jit_sv,
+                                           TGSI_SEMANTIC_TESSOUTER, chan)))
+                  sv->f[lane] = outer[patch][chan];
+            }
+            for (chan = 0; chan < 2; chan++) {
+               if ((sv = tess_system_value(machine, tes->jit_sv,
+                                           TGSI_SEMANTIC_TESSINNER, chan)))
+                  sv->f[lane] = inner[patch][chan];
+            }
+            if ((sv = tess_system_value(machine, tes->jit_sv,
+                                        TGSI_SEMANTIC_PRIMID, 0)))
+               sv->u[lane] = patch_id + patch;
+
+            lane_patch[lane] = patch;
+         }
+
+         for (chan = 0; chan < 3; chan++) {
+            if ((sv = tess_system_value(machine, tes->jit_sv,
+                                        TGSI_SEMANTIC_TESSCOORD, chan)))
+               sv->f[lane] = coord[chan];
+         }
+      }
+
+#ifdef HAVE_LLVM
+      if (tes->draw->llvm) {
+         tes->current_variant->jit_func(&tes->draw->llvm->tes_jit_context,
+                                        tes->inputs,
+                                        tes->jit_sv,
+                                        tes->outputs);
+      }
+      else
+#endif
+      {
+         machine->NonHelperMask = (1 << n) - 1;
+         tgsi_exec_machine_run(machine, 0);
+      }
+
+      for (lane = 0; lane < n; lane++) {
+         struct vertex_header *vh = (struct vertex_header *)
+            ((char *)tes->domain_verts + (i + lane) * vertex_size);
+
+         vh->clipmask = 0;
+         vh->edgeflag = 1;
+         vh->pad = 0;
+         vh->vertex_id = UNDEFINED_VERTEX_ID;
+
+         for (slot = 0; slot < tes->info.num_outputs; slot++) {
+            for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+               vh->data[slot][chan] = tes->outputs[slot].xyzw[chan].f[lane];
+         }
+      }
+   }
+}
+
+unsigned
+draw_tes_output_primitive(const struct draw_tess_eval_shader *tes)
+{
+   if (tes->point_mode)
+      return PIPE_PRIM_POINTS;
+   if (tes->prim_mode == PIPE_PRIM_LINES)
+      return PIPE_PRIM_LINES;
+   return PIPE_PRIM_TRIANGLES;
+}
+
+int
+draw_tess_run(struct draw_context *draw,
+              const struct draw_vertex_info *input_verts,
+              const struct draw_prim_info *input_prim,
+              const struct tgsi_shader_info *input_info,
+              struct draw_vertex_info *output_verts,
+              struct draw_prim_info *output_prims)
+{
+   struct draw_tess_ctrl_shader *tcs = draw->tcs.tess_ctrl_shader;
+   struct draw_tess_eval_shader *tes = draw->tes.tess_eval_shader;
+   struct draw_tess_mesh *mesh = &tes->mesh;
+   const unsigned vertices_in = draw->pt.vertices_per_patch;
+   const unsigned num_patches = vertices_in ?
+      input_prim->count / vertices_in : 0;
+   const unsigned cp_rows = tcs ? tcs->vertices_out : vertices_in;
+   const struct tgsi_shader_info *cp_info = tcs ? &tcs->info : input_info;
+   const unsigned cp_slots = cp_info->num_outputs;
+   const unsigned vertex_size = sizeof(struct vertex_header) +
+                                draw_total_tes_outputs(draw) * 4 * sizeof(float);
+   const unsigned out_prim = draw_tes_output_primitive(tes);
+   const unsigned verts_per_prim = u_vertices_per_prim(out_prim);
+   int input_map[PIPE_MAX_SHADER_INPUTS];
+   int eval_map[PIPE_MAX_SHADER_INPUTS];
+   float outer[TESS_PATCH_BATCH][4];
+   float inner[TESS_PATCH_BATCH][2];
+   unsigned first_coord[TESS_PATCH_BATCH];
+   char *out = NULL;
+   unsigned max_out = 0, emitted = 0;
+   float (*cp)[4];
+   unsigned first, slot, i;
+
+   assert(cp_rows <= TGSI_MAX_PATCH_VERTICES);
+
+   cp = MALLOC(TESS_PATCH_BATCH * cp_rows * MAX2(cp_slots, 1) * sizeof(cp[0]));
+   if (!cp)
+      goto out;
+
+   if (tcs) {
+      /* the LLVM variants get their constants in the jit context */
+      if (!draw->llvm) {
+         for (i = 0; i < tcs->num_machines; i++) {
+            tess_bind_machine(draw, tcs->machines[i], tcs->state.tokens,
+                              draw->tcs.tgsi.sampler, draw->tcs.tgsi.image,
+                              draw->tcs.tgsi.buffer);
+            tgsi_exec_set_constant_buffers(tcs->machines[i],
+                                           PIPE_MAX_CONSTANT_BUFFERS,
+                                           draw->pt.user.tcs_constants,
+                                           draw->pt.user.tcs_constants_size);
+         }
+      }
+      for (slot = 0; slot < tcs->info.num_inputs; slot++) {
+         input_map[slot] = tess_find_output(input_info,
+                                            tcs->info.input_semantic_name[slot],
+                                            tcs->info.input_semantic_index[slot]);
+      }
+   }
+
+   if (!draw->llvm) {
+      tess_bind_machine(draw, tes->machine, tes->state.tokens,
+                        draw->tes.tgsi.sampler, draw->tes.tgsi.image,
+                        draw->tes.tgsi.buffer);
+      tgsi_exec_set_constant_buffers(tes->machine, PIPE_MAX_CONSTANT_BUFFERS,
+                                     draw->pt.user.tes_constants,
+                                     draw->pt.user.tes_constants_size);
+   }
+   for (slot = 0; slot < tes->info.num_inputs; slot++) {
+      eval_map[slot] = tess_find_output(cp_info,
+                                        tes->info.input_semantic_name[slot],
+                                        tes->info.input_semantic_index[slot]);
+   }
+
+   for (first = 0; first < num_patches; first += TESS_PATCH_BATCH) {
+      const unsigned batch = MIN2(num_patches - first, TESS_PATCH_BATCH);
+      const unsigned patch_id = tes->in_patch_idx + first;
+      unsigned p, i, count;
+      void *ptr;
+
+      if (tcs) {
+         tess_run_ctrl(tcs, input_verts, input_prim, input_map, vertices_in,
+                       first, batch, patch_id, cp);
+      }
+      else {
+         tess_copy_ctrl(input_verts, input_prim, cp_slots, vertices_in,
+                        first, batch, cp);
+      }
+
+      mesh->num_coords = 0;
+      mesh->num_indices = 0;
+
+      for (p = 0; p < batch; p++) {
+         const float (*patch_cp)[4] = cp + p * cp_rows * cp_slots;
+
+         for (i = 0; i < 4; i++) {
+            outer[p][i] = tcs && tcs->tess_outer_output >= 0 ?
+               patch_cp[tcs->tess_outer_output][i] :
+               draw->default_outer_tess_level[i];
+         }
+         for (i = 0; i < 2; i++) {
+            inner[p][i] = tcs && tcs->tess_inner_output >= 0 ?
+               patch_cp[tcs->tess_inner_output][i] :
+               draw->default_inner_tess_level[i];
+         }
+
+         first_coord[p] = mesh->num_coords;
+         tess_patch(tes, outer[p], inner[p]);
+      }
+
+      if (!mesh->num_coords)
+         continue;
+
+      ptr = tess_grow(tes->domain_verts, &tes->max_domain_verts,
+                      mesh->num_coords, vertex_size);
+      if (!ptr)
+         break;
+      tes->domain_verts = ptr;
+
+      tess_run_eval(tes, eval_map, (const float (*)[4])cp, cp_rows, cp_slots,
+                    (const float (*)[4])outer, (const float (*)[2])inner,
+                    first_coord, batch, patch_id, vertex_size);
+
+      if (draw->collect_statistics)
+         draw->statistics.ds_invocations += mesh->num_coords;
+
+      /* Expand the mesh into a list of primitives */
+      count = tes->point_mode ? mesh->num_coords : mesh->num_indices;
+      if (!count)
+         continue;
+
+      ptr = tess_grow(out, &max_out, emitted + count, vertex_size);
+      if (!ptr)
+         break;
+      out = ptr;
+
+      if (tes->point_mode) {
+         memcpy(out + emitted * vertex_size, tes->domain_verts,
+                count * vertex_size);
+      }
+      else {
+         for (i = 0; i < count; i++) {
+            unsigned idx = mesh->indices[i];
+
+            /* clockwise output swaps the last two vertices of triangles */
+            if (verts_per_prim == 3 && tes->vertices_cw && i % 3 != 0)
+               idx = mesh->indices[i % 3 == 1 ? i + 1 : i - 1];
+
+            memcpy(out + (emitted + i) * vertex_size,
+                   (const char *)tes->domain_verts + idx * vertex_size,
+                   vertex_size);
+         }
+      }
+      emitted += count;
+   }
+
+   if (draw->collect_statistics && tcs)
+      draw->statistics.hs_invocations += num_patches * tcs->vertices_out;
+
+   tes->in_patch_idx += num_patches;
+
+out:
+   FREE(cp);
+
+   tes->primitive_length = emitted;
+
+   output_verts->verts = (struct vertex_header *)out;
+   output_verts->vertex_size = vertex_size;
+   output_verts->stride = vertex_size;
+   output_verts->count = emitted;
+
+   output_prims->linear = TRUE;
+   output_prims->elts = NULL;
+   output_prims->start = 0;
+   output_prims->count = emitted;
+   output_prims->prim = out_prim;
+   output_prims->flags = 0x0;
+   output_prims->primitive_lengths = &tes->primitive_length;
+   output_prims->primitive_count = 1;
+
+   return emitted;
+}
+
+
+/*
+ * State.
+ */
+
+boolean
+draw_tess_init(struct draw_context *draw)
+{
+   unsigned i;
+
+   if (!draw->llvm) {
+      draw->tcs.tgsi.machine = tgsi_exec_machine_create(PIPE_SHADER_TESS_CTRL);
+      if (!draw->tcs.tgsi.machine)
+         return FALSE;
+
+      draw->tes.tgsi.machine = tgsi_exec_machine_create(PIPE_SHADER_TESS_EVAL);
+      if (!draw->tes.tgsi.machine)
+         return FALSE;
+   }
+
+   for (i = 0; i < 4; i++)
+      draw->default_outer_tess_level[i] = 1.0f;
+   for (i = 0; i < 2; i++)
+      draw->default_inner_tess_level[i] = 1.0f;
+
+   return TRUE;
+}
+
+void
+draw_tess_destroy(struct draw_context *draw)
+{
+   if (draw->tcs.tgsi.machine)
+      tgsi_exec_machine_destroy(draw->tcs.tgsi.machine);
+   if (draw->tes.tgsi.machine)
+      tgsi_exec_machine_destroy(draw->tes.tgsi.machine);
+}
+
+/*
+ * Called at the very begin of the draw call with a new instance,
+ * patch ids restart from zero.
+ */
+void
+draw_tess_new_instance(struct draw_context *draw)
+{
+   if (draw->tes.tess_eval_shader)
+      draw->tes.tess_eval_shader->in_patch_idx = 0;
+}
+
+void
+draw_set_tess_state(struct draw_context *draw,
+                    const float default_outer_level[4],
+                    const float default_inner_level[2])
+{
+   draw_do_flush(draw, DRAW_FLUSH_PARAMETER_CHANGE);
+
+   memcpy(draw->default_outer_tess_level, default_outer_level,
+          sizeof(draw->default_outer_tess_level));
+   memcpy(draw->default_inner_tess_level, default_inner_level,
+          sizeof(draw->default_inner_tess_level));
+}
+
+struct draw_tess_ctrl_shader *
+draw_create_tess_ctrl_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *state)
+{
+#ifdef HAVE_LLVM
+   boolean use_llvm = draw->llvm != NULL;
+   struct llvm_tess_ctrl_shader *llvm_tcs = NULL;
+#endif
+   struct draw_tess_ctrl_shader *tcs;
+   unsigned i;
+
+#ifdef HAVE_LLVM
+   if (use_llvm) {
+      llvm_tcs = CALLOC_STRUCT(llvm_tess_ctrl_shader);
+
+      if (!llvm_tcs)
+         return NULL;
+
+      tcs = &llvm_tcs->base;
+
+      make_empty_list(&llvm_tcs->variants);
+   } else
+#endif
+   {
+      tcs = CALLOC_STRUCT(draw_tess_ctrl_shader);
+   }
+
+   if (!tcs)
+      return NULL;
+
+   tcs->draw = draw;
+   tcs->state = *state;
+   tcs->state.tokens = tgsi_dup_tokens(state->tokens);
+   if (!tcs->state.tokens) {
+      FREE(tcs);
+      return NULL;
+   }
+
+   tgsi_scan_shader(state->tokens, &tcs->info);
+
+   tcs->vertices_out = tcs->info.properties[TGSI_PROPERTY_TCS_VERTICES_OUT];
+   tcs->tess_outer_output =
+      tess_find_output(&tcs->info, TGSI_SEMANTIC_TESSOUTER, 0);
+   tcs->tess_inner_output =
+      tess_find_output(&tcs->info, TGSI_SEMANTIC_TESSINNER, 0);
+
+   tcs->machine = draw->tcs.tgsi.machine;
+   tcs->machines[0] = tcs->machine;
+   tcs->num_machines = 1;
+
+   /* Barriers need the invocations to run side by side. */
+   if (!draw->llvm && tcs->info.opcode_count[TGSI_OPCODE_BARRIER]) {
+      assert(tcs->vertices_out <= TGSI_MAX_PATCH_VERTICES);
+
+      for (i = 1; i < tcs->vertices_out; i++) {
+         struct tgsi_exec_machine *machine =
+            tgsi_exec_machine_create(PIPE_SHADER_TESS_CTRL);
+
+         if (!machine) {
+            draw_delete_tess_ctrl_shader(draw, tcs);
+            return NULL;
+         }
+
+         align_free(machine->Inputs);
+         align_free(machine->Outputs);
+         machine->Inputs = tcs->machine->Inputs;
+         machine->Outputs = tcs->machine->Outputs;
+         tcs->machines[tcs->num_machines++] = machine;
+      }
+   }
+
+#ifdef HAVE_LLVM
+   if (use_llvm) {
+      const unsigned io_size = TGSI_MAX_PATCH_VERTICES *
+                               TGSI_EXEC_TESS_ATTRIB_STRIDE *
+                               sizeof(struct tgsi_exec_vector);
+
+      tcs->inputs = align_malloc(io_size, 16);
+      tcs->outputs = align_malloc(io_size, 16);
+      tcs->jit_sv = align_malloc(DRAW_TESS_SV_NUM * sizeof(tcs->jit_sv[0]), 16);
+
+      tcs->num_phases = tcs->info.opcode_count[TGSI_OPCODE_BARRIER] + 1;
+      if (tcs->num_phases > 1) {
+         tcs->jit_temps_size = lp_build_tgsi_tess_temps_size(&tcs->info);
+         if (tcs->jit_temps_size) {
+            tcs->jit_temps = align_malloc(tcs->vertices_out *
+                                          tcs->jit_temps_size *
+                                          sizeof(tcs->jit_temps[0]), 16);
+            if (!tcs->jit_temps) {
+               draw_delete_tess_ctrl_shader(draw, tcs);
+               return NULL;
+            }
+         }
+      }
+
+      if (!tcs->inputs || !tcs->outputs || !tcs->jit_sv) {
+         draw_delete_tess_ctrl_shader(draw, tcs);
+         return NULL;
+      }
+
+      llvm_tcs->variant_key_size =
+         draw_tess_llvm_variant_key_size(
+            MAX2(tcs->info.file_max[TGSI_FILE_SAMPLER]+1,
+                 tcs->info.file_max[TGSI_FILE_SAMPLER_VIEW]+1));
+   } else
+#endif
+   {
+      tcs->inputs = tcs->machine->Inputs;
+      tcs->outputs = tcs->machine->Outputs;
+   }
+
+   return tcs;
+}
+
+void
+draw_bind_tess_ctrl_shader(struct draw_context *draw,
+                           struct draw_tess_ctrl_shader *dtcs)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+
+   draw->tcs.tess_ctrl_shader = dtcs;
+   if (dtcs) {
+      tess_bind_machine(draw, dtcs->machine, dtcs->state.tokens,
+                        draw->tcs.tgsi.sampler, draw->tcs.tgsi.image,
+                        draw->tcs.tgsi.buffer);
+   }
+}
+
+void
+draw_delete_tess_ctrl_shader(struct draw_context *draw,
+                             struct draw_tess_ctrl_shader *dtcs)
+{
+   unsigned i;
+
+   if (!dtcs)
+      return;
+
+#ifdef HAVE_LLVM
+   if (draw->llvm) {
+      struct llvm_tess_ctrl_shader *shader = llvm_tess_ctrl_shader(dtcs);
+      struct draw_tcs_llvm_variant_list_item *li;
+
+      li = first_elem(&shader->variants);
+      while(!at_end(&shader->variants, li)) {
+         struct draw_tcs_llvm_variant_list_item *next = next_elem(li);
+         draw_tcs_llvm_destroy_variant(li->base);
+         li = next;
+      }
+
+      assert(shader->variants_cached == 0);
+
+      align_free(dtcs->inputs);
+      align_free(dtcs->outputs);
+      align_free(dtcs->jit_sv);
+      align_free(dtcs->jit_temps);
+   }
+#endif
+
+   for (i = 1; i < dtcs->num_machines; i++) {
+      /* the inputs and outputs belong to the first machine */
+      dtcs->machines[i]->Inputs = NULL;
+      dtcs->machines[i]->Outputs = NULL;
+      tgsi_exec_machine_destroy(dtcs->machines[i]);
+   }
+
+   FREE((void*) dtcs->state.tokens);
+   FREE(dtcs);
+}
+
+struct draw_tess_eval_shader *
+draw_create_tess_eval_shader(struct draw_context *draw,
+                             const struct pipe_shader_state *state)
+{
+#ifdef HAVE_LLVM
+   boolean use_llvm = draw->llvm != NULL;
+   struct llvm_tess_eval_shader *llvm_tes = NULL;
+#endif
+   struct draw_tess_eval_shader *tes;
+   unsigned i;
+
+#ifdef HAVE_LLVM
+   if (use_llvm) {
+      llvm_tes = CALLOC_STRUCT(llvm_tess_eval_shader);
+
+      if (!llvm_tes)
+         return NULL;
+
+      tes = &llvm_tes->base;
+
+      make_empty_list(&llvm_tes->variants);
+   } else
+#endif
+   {
+      tes = CALLOC_STRUCT(draw_tess_eval_shader);
+   }
+
+   if (!tes)
+      return NULL;
+
+   tes->draw = draw;
+   tes->state = *state;
+   tes->state.tokens = tgsi_dup_tokens(state->tokens);
+   if (!tes->state.tokens) {
+      FREE(tes);
+      return NULL;
+   }
+
+   tgsi_scan_shader(state->tokens, &tes->info);
+
+   tes->prim_mode = tes->info.properties[TGSI_PROPERTY_TES_PRIM_MODE];
+   tes->spacing = tes->info.properties[TGSI_PROPERTY_TES_SPACING];
+   tes->vertices_cw = tes->info.properties[TGSI_PROPERTY_TES_VERTEX_ORDER_CW];
+   tes->point_mode = tes->info.properties[TGSI_PROPERTY_TES_POINT_MODE];
+
+   tes->position_output = -1;
+   for (i = 0; i < tes->info.num_outputs; i++) {
+      if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_POSITION &&
+          tes->info.output_semantic_index[i] == 0)
+         tes->position_output = i;
+      if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_VIEWPORT_INDEX)
+         tes->viewport_index_output = i;
+      if (tes->info.output_semantic_name[i] == TGSI_SEMANTIC_CLIPDIST) {
+         debug_assert(tes->info.output_semantic_index[i] <
+                      PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT);
+         tes->ccdistance_output[tes->info.output_semantic_index[i]] = i;
+      }
+   }
+
+   tes->machine = draw->tes.tgsi.machine;
+
+#ifdef HAVE_LLVM
+   if (use_llvm) {
+      tes->inputs = align_malloc(TGSI_MAX_PATCH_VERTICES *
+                                 TGSI_EXEC_TESS_ATTRIB_STRIDE *
+                                 sizeof(struct tgsi_exec_vector), 16);
+      tes->outputs = align_malloc(PIPE_MAX_SHADER_OUTPUTS *
+                                  sizeof(struct tgsi_exec_vector), 16);
+      tes->jit_sv = align_malloc(DRAW_TESS_SV_NUM * sizeof(tes->jit_sv[0]), 16);
+
+      if (!tes->inputs || !tes->outputs || !tes->jit_sv) {
+         draw_delete_tess_eval_shader(draw, tes);
+         return NULL;
+      }
+
+      llvm_tes->variant_key_size =
+         draw_tess_llvm_variant_key_size(
+            MAX2(tes->info.file_max[TGSI_FILE_SAMPLER]+1,
+                 tes->info.file_max[TGSI_FILE_SAMPLER_VIEW]+1));
+   } else
+#endif
+   {
+      tes->inputs = tes->machine->Inputs;
+      tes->outputs = tes->machine->Outputs;
+   }
+
+   return tes;
+}
+
+void
+draw_bind_tess_eval_shader(struct draw_context *draw,
+                           struct draw_tess_eval_shader *dtes)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+
+   if (dtes) {
+      draw->tes.tess_eval_shader = dtes;
+      draw->tes.num_tes_outputs = dtes->info.num_outputs;
+      draw->tes.position_output = dtes->position_output;
+      tess_bind_machine(draw, dtes->machine, dtes->state.tokens,
+                        draw->tes.tgsi.sampler, draw->tes.tgsi.image,
+                        draw->tes.tgsi.buffer);
+   }
+   else {
+      draw->tes.tess_eval_shader = NULL;
+      draw->tes.num_tes_outputs = 0;
+   }
+}
+
+void
+draw_delete_tess_eval_shader(struct draw_context *draw,
+                             struct draw_tess_eval_shader *dtes)
+{
+   if (!dtes)
+      return;
+
+#ifdef HAVE_LLVM
+   if (draw->llvm) {
+      struct llvm_tess_eval_shader *shader = llvm_tess_eval_shader(dtes);
+      struct draw_tes_llvm_variant_list_item *li;
+
+      li = first_elem(&shader->variants);
+      while(!at_end(&shader->variants, li)) {
+         struct draw_tes_llvm_variant_list_item *next = next_elem(li);
+         draw_tes_llvm_destroy_variant(li->base);
+         li = next;
+      }
+
+      assert(shader->variants_cached == 0);
+
+      align_free(dtes->inputs);
+      align_free(dtes->outputs);
+      align_free(dtes->jit_sv);
+   }
+#endif
+
+   FREE(dtes->mesh.coords);
+   FREE(dtes->mesh.indices);
+   FREE(dtes->domain_verts);
+   FREE((void*) dtes->state.tokens);
+   FREE(dtes);
+}
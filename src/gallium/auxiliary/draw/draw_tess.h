@@ -0,0 +1,171 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#ifndef DRAW_TESS_H
+#define DRAW_TESS_H
+
+#include "draw_context.h"
+#include "tgsi/tgsi_exec.h"
+#include "tgsi/tgsi_scan.h"
+#include "draw_private.h"
+
+struct draw_context;
+#ifdef HAVE_LLVM
+struct draw_tcs_llvm_variant;
+struct draw_tes_llvm_variant;
+#endif
+
+/**
+ * Domain points and connectivity of the patches currently being tessellated.
+ * Coordinates are (u, v, w), with w only meaningful for triangle domains.
+ */
+struct draw_tess_mesh {
+   float (*coords)[3];
+   unsigned num_coords;
+   unsigned max_coords;
+
+   unsigned *indices;
+   unsigned num_indices;
+   unsigned max_indices;
+};
+
+/**
+ * System values of the shaders run with LLVM, which are passed one
+ * channel per value in this order.
+ */
+enum draw_tess_sv {
+   DRAW_TESS_SV_PRIMID = 0,
+   DRAW_TESS_SV_VERTICESIN,
+   DRAW_TESS_SV_INVOCATIONID,
+   DRAW_TESS_SV_TESSCOORD,
+   DRAW_TESS_SV_TESSOUTER = DRAW_TESS_SV_TESSCOORD + 3,
+   DRAW_TESS_SV_TESSINNER = DRAW_TESS_SV_TESSOUTER + 4,
+   DRAW_TESS_SV_NUM = DRAW_TESS_SV_TESSINNER + 2
+};
+
+/**
+ * Private version of the compiled tessellation control shader
+ */
+struct draw_tess_ctrl_shader {
+   struct draw_context *draw;
+
+   struct tgsi_exec_machine *machine;
+
+   /**
+    * Machines of the invocations of a shader with barriers, which need
+    * registers and a program counter of their own.  The first one is
+    * machine, the others share its inputs and outputs.
+    */
+   struct tgsi_exec_machine *machines[TGSI_MAX_PATCH_VERTICES];
+   unsigned num_machines;
+
+   /**
+    * Inputs and outputs of the patches, TGSI_EXEC_TESS_ATTRIB_STRIDE
+    * attributes per control point.  The ones of machine when there is one.
+    */
+   struct tgsi_exec_vector *inputs;
+   struct tgsi_exec_vector *outputs;
+
+   /** System values of the LLVM variants, NULL with the interpreter */
+   union tgsi_exec_channel *jit_sv;
+
+   struct pipe_shader_state state;
+   struct tgsi_shader_info info;
+
+   unsigned vertices_out;
+   int tess_outer_output;
+   int tess_inner_output;
+
+#ifdef HAVE_LLVM
+   struct draw_tcs_llvm_variant *current_variant;
+
+   /**
+    * With barriers, the variant returns at each one and is called again
+    * with the next phase, and the registers of the invocations are kept
+    * here in between, jit_temps_size channels for each.
+    */
+   unsigned num_phases;
+   union tgsi_exec_channel *jit_temps;
+   unsigned jit_temps_size;
+#endif
+};
+
+/**
+ * Private version of the compiled tessellation evaluation shader
+ */
+struct draw_tess_eval_shader {
+   struct draw_context *draw;
+
+   struct tgsi_exec_machine *machine;
+
+   /** See draw_tess_ctrl_shader, only the first row of outputs is used */
+   struct tgsi_exec_vector *inputs;
+   struct tgsi_exec_vector *outputs;
+   union tgsi_exec_channel *jit_sv;
+
+   struct pipe_shader_state state;
+   struct tgsi_shader_info info;
+
+   unsigned prim_mode;   /**< PIPE_PRIM_TRIANGLES, QUADS or LINES */
+   unsigned spacing;     /**< PIPE_TESS_SPACING_x */
+   boolean vertices_cw;
+   boolean point_mode;
+
+   unsigned position_output;
+   unsigned viewport_index_output;
+   unsigned ccdistance_output[PIPE_MAX_CLIP_OR_CULL_DISTANCE_ELEMENT_COUNT];
+
+   /** Patch id of the next patch, reset for every instance */
+   unsigned in_patch_idx;
+
+   /* Scratch storage kept around between draws */
+   struct draw_tess_mesh mesh;
+   struct vertex_header *domain_verts;
+   unsigned max_domain_verts;
+   unsigned primitive_length;
+
+#ifdef HAVE_LLVM
+   struct draw_tes_llvm_variant *current_variant;
+#endif
+};
+
+unsigned draw_tes_output_primitive(const struct draw_tess_eval_shader *tes);
+
+void draw_tess_new_instance(struct draw_context *draw);
+
+/*
+ * Runs the tessellation control shader, the fixed function tessellator
+ * and the tessellation evaluation shader on the patches described by
+ * input_prim.  Returns the number of vertices emitted.
+ */
+int draw_tess_run(struct draw_context *draw,
+                  const struct draw_vertex_info *input_verts,
+                  const struct draw_prim_info *input_prim,
+                  const struct tgsi_shader_info *input_info,
+                  struct draw_vertex_info *output_verts,
+                  struct draw_prim_info *output_prims);
+
+#endif
@@ -189,6 +189,12 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    if (gallivm->builder)
       LLVMDisposeBuilder(gallivm->builder);
 
+   /* The object cache must outlive the engine which references it. */
+   if (gallivm->cache) {
+      lp_free_objcache(gallivm->cache->jit_obj_cache);
+      gallivm->cache->jit_obj_cache = NULL;
+   }
+
    /* The LLVMContext should be owned by the parent of gallivm. */
 
    gallivm->engine = NULL;
@@ -198,6 +204,7 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->cache = NULL;
 }
 
 
@@ -224,7 +231,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) || gallivm->fast_codegen) {
          optlevel = None;
       }
       else {
@@ -234,6 +241,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
                                                     gallivm->module,
+                                                    gallivm->cache,
                                                     gallivm->memorymgr,
                                                     (unsigned) optlevel,
                                                     use_mcjit,
@@ -285,7 +293,7 @@ fail:
  */
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm, const char *name,
-                   LLVMContextRef context)
+                   LLVMContextRef context, struct lp_cached_code *cache)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -294,6 +302,8 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       return FALSE;
 
    gallivm->context = context;
+   /* Object caching relies on MCJIT's ObjectCache interface. */
+   gallivm->cache = (use_mcjit && HAVE_LLVM >= 0x0306) ? cache : NULL;
 
    if (!gallivm->context)
       goto fail;
@@ -493,15 +503,18 @@ lp_build_init(void)
 
 /**
  * Create a new gallivm_state object.
+ * \param cache  optional object code cache, see struct lp_cached_code.
+ *               Must stay valid until gallivm_free_ir() is called.
  */
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context)
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache)
 {
    struct gallivm_state *gallivm;
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm, name, context)) {
+      if (!init_gallivm_state(gallivm, name, context, cache)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -568,10 +581,33 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
-   /* Run optimization passes */
+   if (gallivm->cache) {
+      /*
+       * Function names usually embed per-process shader/variant counters.
+       * Give them names that only depend on their position in the module
+       * so that symbols of a cached object can be resolved in any process.
+       */
+      unsigned func_no = 0;
+
+      func = LLVMGetFirstFunction(gallivm->module);
+      while (func) {
+         if (!LLVMIsDeclaration(func)) {
+            char func_name[32];
+            util_snprintf(func_name, sizeof(func_name), "cached_func%u",
+                          func_no++);
+            LLVMSetValueName(func, func_name);
+         }
+         func = LLVMGetNextFunction(func);
+      }
+   }
+
+   /*
+    * Run optimization passes, unless the object code is coming from the
+    * cache, in which case the optimized IR would never be used.
+    */
    LLVMInitializeFunctionPassManager(gallivm->passmgr);
    func = LLVMGetFirstFunction(gallivm->module);
-   while (func) {
+   while (func && !(gallivm->cache && gallivm->cache->data_size)) {
       if (0) {
          debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
       }
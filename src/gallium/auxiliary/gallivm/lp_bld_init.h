@@ -39,6 +39,23 @@
 extern "C" {
 #endif
 
+/**
+ * Object code of a compiled module, as exchanged with a shader cache.
+ *
+ * Before compilation the caller may fill in data/data_size with a
+ * previously cached object, in which case codegen is skipped.  Otherwise,
+ * once the module's functions have been jitted, data/data_size hold the
+ * freshly generated object (allocated with malloc) which the caller may
+ * store.  dont_cache is set when the generated code refers to
+ * process-specific addresses and must therefore not be persisted.
+ */
+struct lp_cached_code {
+   void *data;
+   size_t data_size;
+   boolean dont_cache;
+   void *jit_obj_cache;
+};
+
 struct gallivm_state
 {
    char *module_name;
@@ -50,6 +67,9 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
+   /** Favour compilation speed over code quality in the backend */
+   boolean fast_codegen;
    unsigned compiled;
 };
 
@@ -59,7 +79,8 @@ lp_build_init(void);
 
 
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context);
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache);
 
 void
 gallivm_destroy(struct gallivm_state *gallivm);
@@ -0,0 +1,97 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation.
+ *
+ * This is the NIR counterpart of lp_bld_tgsi.h: it walks the structured
+ * control flow of a NIR shader directly instead of going through TGSI
+ * tokens, using the same SoA layout, execution masks and sampler interface
+ * as the TGSI translator so the two can be used interchangeably by drivers.
+ */
+
+#ifndef LP_BLD_NIR_H
+#define LP_BLD_NIR_H
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_tgsi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct nir_shader;
+struct lp_build_mask_context;
+struct lp_build_sampler_soa;
+struct lp_bld_tgsi_system_values;
+struct gallivm_state;
+
+
+/**
+ * Translate a NIR shader into SoA LLVM IR.
+ *
+ * The shader must have had its I/O lowered (load_input/store_output/
+ * load_uniform with driver_location bases in vec4 units), be scalarized
+ * and be out of SSA form for values live across divergent control flow
+ * (see lp_build_nir_prepare()).
+ *
+ * The inputs/outputs arrays are indexed by driver_location, exactly like
+ * the TGSI input/output register files.  The output pointers are allocated
+ * by this function.
+ */
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const struct lp_bld_tgsi_system_values *system_values,
+                 const LLVMValueRef (*inputs)[4],
+                 LLVMValueRef (*outputs)[4],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 struct lp_build_sampler_soa *sampler);
+
+
+/**
+ * Run the lowering passes lp_build_nir_soa() depends on.
+ *
+ * Must be called once on every shader before translating it.  Returns
+ * FALSE if the shader uses anything lp_build_nir_soa() can't translate, in
+ * which case the driver must reject it.
+ */
+boolean
+lp_build_nir_prepare(struct nir_shader *shader);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LP_BLD_NIR_H */
@@ -0,0 +1,1581 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * NIR to LLVM IR translation -- SoA.
+ *
+ * Every 32bit NIR value is represented as one LLVM vector per channel, with
+ * one element per pixel/vertex, exactly like the TGSI SoA translator.  SSA
+ * values map straight to LLVM values.  NIR registers (what is left after
+ * going out of SSA: phi webs and lowered local arrays) become allocas which
+ * are written under the current execution mask.
+ *
+ * Control flow is structured in NIR, so if/loop/break/continue map onto the
+ * same lp_exec_mask machinery the TGSI translator uses.
+ *
+ * Only what a GLSL fragment shader produces through the state tracker is
+ * handled: 32bit ALU ops, direct input/output access, default uniform block
+ * and UBO loads, discard and the common texture opcodes.
+ */
+
+#include "pipe/p_config.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "compiler/nir/nir.h"
+#include "compiler/nir_types.h"
+#include "lp_bld_nir.h"
+#include "lp_bld_type.h"
+#include "lp_bld_const.h"
+#include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
+#include "lp_bld_init.h"
+#include "lp_bld_logic.h"
+#include "lp_bld_flow.h"
+#include "lp_bld_quad.h"
+#include "lp_bld_tgsi.h"
+#include "lp_bld_limits.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_sample.h"
+#include "lp_bld_struct.h"
+
+
+struct lp_build_nir_soa_context
+{
+   struct lp_build_context base;     /**< float */
+   struct lp_build_context uint_bld;
+   struct lp_build_context int_bld;
+
+   nir_shader *shader;
+
+   struct lp_build_mask_context *mask;
+   struct lp_exec_mask exec_mask;
+
+   LLVMValueRef consts_ptr;
+   LLVMValueRef const_sizes_ptr;
+   LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
+   LLVMValueRef consts_sizes[LP_MAX_TGSI_CONST_BUFFERS];
+
+   const struct lp_bld_tgsi_system_values *system_values;
+   const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS];
+   LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS];
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+   struct lp_build_sampler_soa *sampler;
+
+   /** Input slot holding gl_FrontFacing, or -1 */
+   int face_input;
+
+   /**
+    * Channel each output slot's component 0 is written to.  TGSI puts the
+    * fragment depth in .z and the stencil reference in .y, NIR in .x.
+    */
+   ubyte output_chan[PIPE_MAX_SHADER_OUTPUTS];
+
+   /** SSA values, four channels per def, stored as float vectors */
+   LLVMValueRef (*ssa_defs)[TGSI_NUM_CHANNELS];
+
+   /** Per register: array of 4 * max(1, num_array_elems) allocas */
+   LLVMValueRef **regs;
+};
+
+
+static int
+type_size(const struct glsl_type *type)
+{
+   return glsl_count_attribute_slots(type, false);
+}
+
+
+/**
+ * Convert each loop to LCSSA form so that values computed inside a loop
+ * and used after it go through a phi, which becomes a register written
+ * under the execution mask when going out of SSA.  Otherwise channels
+ * which left the loop early would see the value of the last iteration.
+ */
+static void
+lcssa_cf_list(struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list) {
+      switch (node->type) {
+      case nir_cf_node_if: {
+         nir_if *nif = nir_cf_node_as_if(node);
+         lcssa_cf_list(&nif->then_list);
+         lcssa_cf_list(&nif->else_list);
+         break;
+      }
+      case nir_cf_node_loop: {
+         nir_loop *loop = nir_cf_node_as_loop(node);
+         /* inner loops first, their phis are then handled like any value */
+         lcssa_cf_list(&loop->body);
+         nir_convert_loop_to_lcssa(loop);
+         break;
+      }
+      default:
+         break;
+      }
+   }
+}
+
+
+/*
+ * The translator has no fallback for what it doesn't know, so refuse the
+ * shader up front rather than silently computing garbage.
+ */
+
+static boolean
+alu_op_supported(nir_op op)
+{
+   switch (op) {
+   case nir_op_vec2:
+   case nir_op_vec3:
+   case nir_op_vec4:
+   case nir_op_fmov:
+   case nir_op_imov:
+   case nir_op_i2i32:
+   case nir_op_u2u32:
+   case nir_op_f2f32:
+   case nir_op_fneg:
+   case nir_op_fabs:
+   case nir_op_fsign:
+   case nir_op_fsat:
+   case nir_op_frcp:
+   case nir_op_frsq:
+   case nir_op_fsqrt:
+   case nir_op_fexp2:
+   case nir_op_flog2:
+   case nir_op_ftrunc:
+   case nir_op_fceil:
+   case nir_op_ffloor:
+   case nir_op_ffract:
+   case nir_op_fround_even:
+   case nir_op_fsin:
+   case nir_op_fcos:
+   case nir_op_fddx:
+   case nir_op_fddx_fine:
+   case nir_op_fddx_coarse:
+   case nir_op_fddy:
+   case nir_op_fddy_fine:
+   case nir_op_fddy_coarse:
+   case nir_op_fadd:
+   case nir_op_fsub:
+   case nir_op_fmul:
+   case nir_op_fdiv:
+   case nir_op_fmin:
+   case nir_op_fmax:
+   case nir_op_fpow:
+   case nir_op_ffma:
+   case nir_op_flrp:
+   case nir_op_flt:
+   case nir_op_fge:
+   case nir_op_feq:
+   case nir_op_fne:
+   case nir_op_ilt:
+   case nir_op_ige:
+   case nir_op_ieq:
+   case nir_op_ine:
+   case nir_op_ult:
+   case nir_op_uge:
+   case nir_op_ineg:
+   case nir_op_iabs:
+   case nir_op_isign:
+   case nir_op_iadd:
+   case nir_op_isub:
+   case nir_op_imul:
+   case nir_op_imul_high:
+   case nir_op_umul_high:
+   case nir_op_idiv:
+   case nir_op_udiv:
+   case nir_op_umod:
+   case nir_op_irem:
+   case nir_op_imod:
+   case nir_op_imin:
+   case nir_op_imax:
+   case nir_op_umin:
+   case nir_op_umax:
+   case nir_op_inot:
+   case nir_op_iand:
+   case nir_op_ior:
+   case nir_op_ixor:
+   case nir_op_ishl:
+   case nir_op_ishr:
+   case nir_op_ushr:
+   case nir_op_i2f32:
+   case nir_op_u2f32:
+   case nir_op_f2i32:
+   case nir_op_f2u32:
+   case nir_op_f2b:
+   case nir_op_i2b:
+   case nir_op_b2f:
+   case nir_op_b2i:
+   case nir_op_bcsel:
+   case nir_op_fcsel:
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+static boolean
+intrinsic_supported(const nir_intrinsic_instr *instr)
+{
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_input:
+   case nir_intrinsic_store_output:
+   case nir_intrinsic_load_uniform:
+   case nir_intrinsic_load_ubo:
+   case nir_intrinsic_discard:
+   case nir_intrinsic_discard_if:
+   case nir_intrinsic_load_primitive_id:
+   case nir_intrinsic_load_instance_id:
+   case nir_intrinsic_load_base_vertex:
+   case nir_intrinsic_load_invocation_id:
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+
+static boolean
+tex_supported(const nir_tex_instr *instr)
+{
+   unsigned i;
+
+   switch (instr->op) {
+   case nir_texop_tex:
+   case nir_texop_txb:
+   case nir_texop_txl:
+   case nir_texop_txd:
+   case nir_texop_txf:
+   case nir_texop_txs:
+   case nir_texop_lod:
+      break;
+   case nir_texop_tg4:
+      /* the sampler generator only gathers the first component */
+      if (instr->component)
+         return FALSE;
+      break;
+   default:
+      return FALSE;
+   }
+
+   for (i = 0; i < instr->num_srcs; i++) {
+      switch (instr->src[i].src_type) {
+      case nir_tex_src_coord:
+      case nir_tex_src_comparator:
+      case nir_tex_src_bias:
+      case nir_tex_src_lod:
+      case nir_tex_src_ddx:
+      case nir_tex_src_ddy:
+      case nir_tex_src_offset:
+         break;
+      default:
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+instr_supported(const nir_instr *instr)
+{
+   switch (instr->type) {
+   case nir_instr_type_alu:
+      return alu_op_supported(nir_instr_as_alu(instr)->op);
+   case nir_instr_type_intrinsic:
+      return intrinsic_supported(nir_instr_as_intrinsic(instr));
+   case nir_instr_type_tex:
+      return tex_supported(nir_instr_as_tex(instr));
+   case nir_instr_type_load_const:
+   case nir_instr_type_ssa_undef:
+   case nir_instr_type_jump:
+      return TRUE;
+   default:
+      /* phis and parallel copies are gone after nir_convert_from_ssa */
+      return FALSE;
+   }
+}
+
+
+static boolean
+shader_supported(nir_shader *nir)
+{
+   nir_foreach_function(func, nir) {
+      if (!func->impl)
+         continue;
+      nir_foreach_block(block, func->impl) {
+         nir_foreach_instr(instr, block) {
+            if (!instr_supported(instr)) {
+               if (gallivm_debug & GALLIVM_DEBUG_IR) {
+                  debug_printf("gallivm: unsupported NIR instruction: ");
+                  nir_print_instr(instr, stderr);
+                  debug_printf("\n");
+               }
+               return FALSE;
+            }
+         }
+      }
+   }
+   return TRUE;
+}
+
+
+boolean
+lp_build_nir_prepare(struct nir_shader *nir)
+{
+   nir_lower_tex_options tex_options;
+   bool progress;
+
+   NIR_PASS_V(nir, nir_lower_returns);
+   NIR_PASS_V(nir, nir_lower_indirect_derefs,
+              nir_var_shader_in | nir_var_shader_out | nir_var_local);
+   NIR_PASS_V(nir, nir_lower_io,
+              nir_var_shader_in | nir_var_shader_out | nir_var_uniform,
+              type_size, (nir_lower_io_options)0);
+
+   memset(&tex_options, 0, sizeof(tex_options));
+   tex_options.lower_txp = ~0u;
+   NIR_PASS_V(nir, nir_lower_tex, &tex_options);
+
+   NIR_PASS_V(nir, nir_lower_vars_to_ssa);
+   NIR_PASS_V(nir, nir_lower_alu_to_scalar);
+   NIR_PASS_V(nir, nir_lower_phis_to_scalar);
+
+   do {
+      progress = false;
+      NIR_PASS(progress, nir, nir_copy_prop);
+      NIR_PASS(progress, nir, nir_opt_remove_phis);
+      NIR_PASS(progress, nir, nir_opt_dce);
+      NIR_PASS(progress, nir, nir_opt_dead_cf);
+      NIR_PASS(progress, nir, nir_opt_cse);
+      NIR_PASS(progress, nir, nir_opt_if);
+      NIR_PASS(progress, nir, nir_opt_peephole_select, 8);
+      NIR_PASS(progress, nir, nir_opt_algebraic);
+      NIR_PASS(progress, nir, nir_opt_constant_folding);
+      NIR_PASS(progress, nir, nir_opt_undef);
+      NIR_PASS(progress, nir, nir_opt_loop_unroll,
+               nir_var_shader_in | nir_var_shader_out | nir_var_local);
+   } while (progress);
+
+   NIR_PASS_V(nir, nir_opt_algebraic_late);
+   NIR_PASS_V(nir, nir_copy_prop);
+   NIR_PASS_V(nir, nir_opt_dce);
+
+   NIR_PASS_V(nir, nir_lower_locals_to_regs);
+   NIR_PASS_V(nir, nir_remove_dead_variables, nir_var_local);
+
+   nir_foreach_function(func, nir) {
+      if (func->impl)
+         lcssa_cf_list(&func->impl->body);
+   }
+   NIR_PASS_V(nir, nir_convert_from_ssa, true);
+
+   return shader_supported(nir);
+}
+
+
+static inline unsigned
+dest_num_components(const nir_dest *dest)
+{
+   return dest->is_ssa ? dest->ssa.num_components : dest->reg.reg->num_components;
+}
+
+
+static LLVMValueRef
+cast_to_int(struct lp_build_nir_soa_context *bld, LLVMValueRef val)
+{
+   return LLVMBuildBitCast(bld->base.gallivm->builder, val,
+                           bld->int_bld.vec_type, "");
+}
+
+
+static LLVMValueRef
+cast_to_float(struct lp_build_nir_soa_context *bld, LLVMValueRef val)
+{
+   return LLVMBuildBitCast(bld->base.gallivm->builder, val,
+                           bld->base.vec_type, "");
+}
+
+
+/**
+ * Return the build context matching a NIR ALU type.
+ */
+static struct lp_build_context *
+get_bld(struct lp_build_nir_soa_context *bld, nir_alu_type type)
+{
+   switch (nir_alu_type_get_base_type(type)) {
+   case nir_type_float:
+      return &bld->base;
+   case nir_type_int:
+      return &bld->int_bld;
+   default:
+      return &bld->uint_bld;
+   }
+}
+
+
+static LLVMValueRef *
+get_reg_ptrs(struct lp_build_nir_soa_context *bld,
+             nir_register *reg, unsigned base_offset)
+{
+   assert(reg->index < nir_shader_get_entrypoint(bld->shader)->reg_alloc);
+   return &bld->regs[reg->index][base_offset * TGSI_NUM_CHANNELS];
+}
+
+
+/**
+ * Fetch one channel of a source, as a float vector.
+ */
+static LLVMValueRef
+get_src(struct lp_build_nir_soa_context *bld, nir_src src, unsigned chan)
+{
+   if (src.is_ssa) {
+      LLVMValueRef val = bld->ssa_defs[src.ssa->index][chan];
+      return val ? val : bld->base.undef;
+   }
+
+   /* Indirect register access was lowered by lp_build_nir_prepare() */
+   assert(!src.reg.indirect);
+   return LLVMBuildLoad(bld->base.gallivm->builder,
+                        get_reg_ptrs(bld, src.reg.reg,
+                                     src.reg.base_offset)[chan], "");
+}
+
+
+static void
+store_dest(struct lp_build_nir_soa_context *bld, const nir_dest *dest,
+           unsigned chan, LLVMValueRef val)
+{
+   val = cast_to_float(bld, val);
+
+   if (dest->is_ssa) {
+      bld->ssa_defs[dest->ssa.index][chan] = val;
+   }
+   else {
+      assert(!dest->reg.indirect);
+      lp_exec_mask_store(&bld->exec_mask, &bld->base, val,
+                         get_reg_ptrs(bld, dest->reg.reg,
+                                      dest->reg.base_offset)[chan]);
+   }
+}
+
+
+/**
+ * Whether a source is the same for every channel of the vector, which lets
+ * the sampler pick a single lod for the whole vector.
+ */
+static boolean
+src_is_uniform(nir_src src)
+{
+   nir_instr *parent;
+
+   if (!src.is_ssa)
+      return FALSE;
+
+   parent = src.ssa->parent_instr;
+   if (parent->type == nir_instr_type_load_const)
+      return TRUE;
+   if (parent->type == nir_instr_type_intrinsic) {
+      nir_intrinsic_instr *intr = nir_instr_as_intrinsic(parent);
+      return intr->intrinsic == nir_intrinsic_load_uniform &&
+             nir_src_as_const_value(intr->src[0]) != NULL;
+   }
+   return FALSE;
+}
+
+
+static enum lp_sampler_lod_property
+lod_property(struct lp_build_nir_soa_context *bld, nir_src src)
+{
+   if (src_is_uniform(src))
+      return LP_SAMPLER_LOD_SCALAR;
+   else if (bld->shader->info.stage == MESA_SHADER_FRAGMENT &&
+            !(gallivm_debug & GALLIVM_DEBUG_NO_QUAD_LOD))
+      return LP_SAMPLER_LOD_PER_QUAD;
+   else
+      return LP_SAMPLER_LOD_PER_ELEMENT;
+}
+
+
+/*
+ * ALU
+ */
+
+static LLVMValueRef
+get_alu_src(struct lp_build_nir_soa_context *bld,
+            const nir_alu_instr *instr,
+            unsigned src_idx, unsigned chan)
+{
+   const nir_alu_src *src = &instr->src[src_idx];
+   nir_alu_type type = nir_op_infos[instr->op].input_types[src_idx];
+   struct lp_build_context *type_bld = get_bld(bld, type);
+   LLVMValueRef val = get_src(bld, src->src, src->swizzle[chan]);
+
+   val = LLVMBuildBitCast(bld->base.gallivm->builder, val,
+                          type_bld->vec_type, "");
+   if (src->abs)
+      val = lp_build_abs(type_bld, val);
+   if (src->negate)
+      val = lp_build_negate(type_bld, val);
+   return val;
+}
+
+
+/*
+ * Integer division by zero must not raise SIGFPE.  Like the TGSI
+ * translator, divide by ~0 instead and fix up the result afterwards.
+ */
+static LLVMValueRef
+emit_int_div(struct lp_build_nir_soa_context *bld, nir_op op,
+             LLVMValueRef a, LLVMValueRef b)
+{
+   LLVMBuilderRef builder = bld->base.gallivm->builder;
+   struct lp_build_context *int_bld =
+      op == nir_op_udiv || op == nir_op_umod ? &bld->uint_bld : &bld->int_bld;
+   LLVMValueRef div_mask = lp_build_cmp(&bld->uint_bld, PIPE_FUNC_EQUAL,
+                                        b, bld->uint_bld.zero);
+   LLVMValueRef divisor = LLVMBuildOr(builder, div_mask, b, "");
+   LLVMValueRef result;
+
+   switch (op) {
+   case nir_op_idiv:
+      result = lp_build_div(int_bld, a, divisor);
+      /* idiv by zero doesn't have a guaranteed return value chose 0 for now. */
+      return LLVMBuildAnd(builder, LLVMBuildNot(builder, div_mask, ""),
+                          result, "");
+   case nir_op_udiv:
+      result = lp_build_div(int_bld, a, divisor);
+      return LLVMBuildOr(builder, div_mask, result, "");
+   case nir_op_umod:
+   case nir_op_irem:
+      result = lp_build_mod(int_bld, a, divisor);
+      return LLVMBuildOr(builder, div_mask, result, "");
+   case nir_op_imod: {
+      /* the result takes the sign of the divisor rather than the dividend */
+      LLVMValueRef fixup;
+      result = lp_build_mod(int_bld, a, divisor);
+      fixup = LLVMBuildAnd(builder,
+                           lp_build_cmp(int_bld, PIPE_FUNC_NOTEQUAL,
+                                        result, int_bld->zero),
+                           lp_build_cmp(int_bld, PIPE_FUNC_LESS,
+                                        LLVMBuildXor(builder, result,
+                                                     divisor, ""),
+                                        int_bld->zero), "");
+      result = lp_build_select(int_bld, fixup,
+                               lp_build_add(int_bld, result, divisor),
+                               result);
+      return LLVMBuildOr(builder, div_mask, result, "");
+   }
+   default:
+      assert(0);
+      return int_bld->undef;
+   }
+}
+
+
+static LLVMValueRef
+emit_alu_op(struct lp_build_nir_soa_context *bld, nir_op op,
+            LLVMValueRef src[4])
+{
+   struct gallivm_state *gallivm = bld->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *float_bld = &bld->base;
+   struct lp_build_context *int_bld = &bld->int_bld;
+   struct lp_build_context *uint_bld = &bld->uint_bld;
+   LLVMValueRef tmp;
+
+   switch (op) {
+   case nir_op_fmov:
+   case nir_op_imov:
+   case nir_op_i2i32:
+   case nir_op_u2u32:
+   case nir_op_f2f32:
+      return src[0];
+
+   /* float */
+   case nir_op_fneg:
+      return lp_build_negate(float_bld, src[0]);
+   case nir_op_fabs:
+      return lp_build_abs(float_bld, src[0]);
+   case nir_op_fsign:
+      return lp_build_sgn(float_bld, src[0]);
+   case nir_op_fsat:
+      return lp_build_clamp_zero_one_nanzero(float_bld, src[0]);
+   case nir_op_frcp:
+      return lp_build_rcp(float_bld, src[0]);
+   case nir_op_frsq:
+      return lp_build_rsqrt(float_bld, src[0]);
+   case nir_op_fsqrt:
+      return lp_build_sqrt(float_bld, src[0]);
+   case nir_op_fexp2:
+      return lp_build_exp2(float_bld, src[0]);
+   case nir_op_flog2:
+      return lp_build_log2_safe(float_bld, src[0]);
+   case nir_op_ftrunc:
+      return lp_build_trunc(float_bld, src[0]);
+   case nir_op_fceil:
+      return lp_build_ceil(float_bld, src[0]);
+   case nir_op_ffloor:
+      return lp_build_floor(float_bld, src[0]);
+   case nir_op_ffract:
+      return lp_build_fract(float_bld, src[0]);
+   case nir_op_fround_even:
+      return lp_build_round(float_bld, src[0]);
+   case nir_op_fsin:
+      return lp_build_sin(float_bld, src[0]);
+   case nir_op_fcos:
+      return lp_build_cos(float_bld, src[0]);
+   case nir_op_fddx:
+   case nir_op_fddx_fine:
+   case nir_op_fddx_coarse:
+      return lp_build_ddx(float_bld, src[0]);
+   case nir_op_fddy:
+   case nir_op_fddy_fine:
+   case nir_op_fddy_coarse:
+      return lp_build_ddy(float_bld, src[0]);
+   case nir_op_fadd:
+      return lp_build_add(float_bld, src[0], src[1]);
+   case nir_op_fsub:
+      return lp_build_sub(float_bld, src[0], src[1]);
+   case nir_op_fmul:
+      return lp_build_mul(float_bld, src[0], src[1]);
+   case nir_op_fdiv:
+      return lp_build_div(float_bld, src[0], src[1]);
+   case nir_op_fmin:
+      return lp_build_min_ext(float_bld, src[0], src[1],
+                              GALLIVM_NAN_RETURN_OTHER);
+   case nir_op_fmax:
+      return lp_build_max_ext(float_bld, src[0], src[1],
+                              GALLIVM_NAN_RETURN_OTHER);
+   case nir_op_fpow:
+      return lp_build_pow(float_bld, src[0], src[1]);
+   case nir_op_ffma:
+      return lp_build_mad(float_bld, src[0], src[1], src[2]);
+   case nir_op_flrp:
+      return lp_build_lerp(float_bld, src[2], src[0], src[1], 0);
+
+   /* comparisons, producing NIR_TRUE (~0) / NIR_FALSE (0) */
+   case nir_op_flt:
+      return lp_build_cmp(float_bld, PIPE_FUNC_LESS, src[0], src[1]);
+   case nir_op_fge:
+      return lp_build_cmp(float_bld, PIPE_FUNC_GEQUAL, src[0], src[1]);
+   case nir_op_feq:
+      return lp_build_cmp(float_bld, PIPE_FUNC_EQUAL, src[0], src[1]);
+   case nir_op_fne:
+      return lp_build_cmp(float_bld, PIPE_FUNC_NOTEQUAL, src[0], src[1]);
+   case nir_op_ilt:
+      return lp_build_cmp(int_bld, PIPE_FUNC_LESS, src[0], src[1]);
+   case nir_op_ige:
+      return lp_build_cmp(int_bld, PIPE_FUNC_GEQUAL, src[0], src[1]);
+   case nir_op_ieq:
+      return lp_build_cmp(uint_bld, PIPE_FUNC_EQUAL, src[0], src[1]);
+   case nir_op_ine:
+      return lp_build_cmp(uint_bld, PIPE_FUNC_NOTEQUAL, src[0], src[1]);
+   case nir_op_ult:
+      return lp_build_cmp(uint_bld, PIPE_FUNC_LESS, src[0], src[1]);
+   case nir_op_uge:
+      return lp_build_cmp(uint_bld, PIPE_FUNC_GEQUAL, src[0], src[1]);
+
+   /* integer */
+   case nir_op_ineg:
+      return lp_build_negate(int_bld, src[0]);
+   case nir_op_iabs:
+      return lp_build_abs(int_bld, src[0]);
+   case nir_op_isign:
+      return lp_build_sgn(int_bld, src[0]);
+   case nir_op_iadd:
+      return lp_build_add(uint_bld, src[0], src[1]);
+   case nir_op_isub:
+      return lp_build_sub(uint_bld, src[0], src[1]);
+   case nir_op_imul:
+      return lp_build_mul(uint_bld, src[0], src[1]);
+   case nir_op_imul_high:
+      lp_build_mul_32_lohi(int_bld, src[0], src[1], &tmp);
+      return tmp;
+   case nir_op_umul_high:
+      lp_build_mul_32_lohi(uint_bld, src[0], src[1], &tmp);
+      return tmp;
+   case nir_op_idiv:
+   case nir_op_udiv:
+   case nir_op_umod:
+   case nir_op_irem:
+   case nir_op_imod:
+      return emit_int_div(bld, op, src[0], src[1]);
+   case nir_op_imin:
+      return lp_build_min(int_bld, src[0], src[1]);
+   case nir_op_imax:
+      return lp_build_max(int_bld, src[0], src[1]);
+   case nir_op_umin:
+      return lp_build_min(uint_bld, src[0], src[1]);
+   case nir_op_umax:
+      return lp_build_max(uint_bld, src[0], src[1]);
+   case nir_op_inot:
+      return lp_build_not(uint_bld, src[0]);
+   case nir_op_iand:
+      return lp_build_and(uint_bld, src[0], src[1]);
+   case nir_op_ior:
+      return lp_build_or(uint_bld, src[0], src[1]);
+   case nir_op_ixor:
+      return lp_build_xor(uint_bld, src[0], src[1]);
+   case nir_op_ishl:
+   case nir_op_ishr:
+   case nir_op_ushr: {
+      /* shift counts are taken modulo the bit size, as in GLSL/TGSI */
+      LLVMValueRef count_mask = lp_build_const_int_vec(gallivm, uint_bld->type,
+                                                       uint_bld->type.width - 1);
+      LLVMValueRef count = lp_build_and(uint_bld, src[1], count_mask);
+      if (op == nir_op_ishl)
+         return lp_build_shl(uint_bld, src[0], count);
+      else if (op == nir_op_ishr)
+         return lp_build_shr(int_bld, src[0], count);
+      else
+         return lp_build_shr(uint_bld, src[0], count);
+   }
+
+   /* conversions */
+   case nir_op_i2f32:
+      return lp_build_int_to_float(float_bld, src[0]);
+   case nir_op_u2f32:
+      return LLVMBuildUIToFP(builder, src[0], float_bld->vec_type, "");
+   case nir_op_f2i32:
+      return lp_build_itrunc(float_bld, src[0]);
+   case nir_op_f2u32:
+      return LLVMBuildFPToUI(builder, src[0], uint_bld->vec_type, "");
+   case nir_op_f2b:
+      return lp_build_cmp(float_bld, PIPE_FUNC_NOTEQUAL,
+                          src[0], float_bld->zero);
+   case nir_op_i2b:
+      return lp_build_cmp(uint_bld, PIPE_FUNC_NOTEQUAL,
+                          src[0], uint_bld->zero);
+   case nir_op_b2f:
+      return LLVMBuildAnd(builder, src[0],
+                          cast_to_int(bld, float_bld->one), "");
+   case nir_op_b2i:
+      return LLVMBuildAnd(builder, src[0], uint_bld->one, "");
+
+   /* selects */
+   case nir_op_bcsel:
+      return lp_build_select(uint_bld, src[0], src[1], src[2]);
+   case nir_op_fcsel:
+      tmp = lp_build_cmp(float_bld, PIPE_FUNC_NOTEQUAL,
+                         src[0], float_bld->zero);
+      return lp_build_select(float_bld, tmp, src[1], src[2]);
+
+   default:
+      /* rejected by alu_op_supported() */
+      unreachable("unhandled NIR alu op");
+   }
+}
+
+
+static void
+visit_alu(struct lp_build_nir_soa_context *bld, nir_alu_instr *instr)
+{
+   const nir_op_info *info = &nir_op_infos[instr->op];
+   unsigned num_components = dest_num_components(&instr->dest.dest);
+   unsigned chan, i;
+
+   assert(nir_dest_bit_size(instr->dest.dest) == 32);
+
+   for (chan = 0; chan < num_components; chan++) {
+      LLVMValueRef src[4];
+      LLVMValueRef result;
+
+      if (!instr->dest.dest.is_ssa &&
+          !(instr->dest.write_mask & (1 << chan)))
+         continue;
+
+      switch (instr->op) {
+      case nir_op_vec2:
+      case nir_op_vec3:
+      case nir_op_vec4:
+         result = get_alu_src(bld, instr, chan, 0);
+         break;
+      default:
+         /* lp_build_nir_prepare() scalarized everything but moves/vecs */
+         for (i = 0; i < info->num_inputs; i++)
+            src[i] = get_alu_src(bld, instr, i, chan);
+         result = emit_alu_op(bld, instr->op, src);
+         break;
+      }
+
+      if (instr->dest.saturate) {
+         result = cast_to_float(bld, result);
+         result = lp_build_clamp_zero_one_nanzero(&bld->base, result);
+      }
+
+      store_dest(bld, &instr->dest.dest, chan, result);
+   }
+}
+
+
+static void
+visit_load_const(struct lp_build_nir_soa_context *bld,
+                 nir_load_const_instr *instr)
+{
+   unsigned chan;
+
+   assert(instr->def.bit_size == 32);
+
+   for (chan = 0; chan < instr->def.num_components; chan++) {
+      bld->ssa_defs[instr->def.index][chan] =
+         cast_to_float(bld, lp_build_const_int_vec(bld->base.gallivm,
+                                                   bld->uint_bld.type,
+                                                   instr->value.u32[chan]));
+   }
+}
+
+
+static void
+visit_ssa_undef(struct lp_build_nir_soa_context *bld,
+                nir_ssa_undef_instr *instr)
+{
+   unsigned chan;
+
+   for (chan = 0; chan < instr->def.num_components; chan++)
+      bld->ssa_defs[instr->def.index][chan] = bld->base.undef;
+}
+
+
+/*
+ * Intrinsics
+ */
+
+/**
+ * Gather one scalar per channel from a constant buffer, returning zero for
+ * out of bounds channels (see build_gather() in lp_bld_tgsi_soa.c).
+ */
+static LLVMValueRef
+gather_const(struct lp_build_nir_soa_context *bld,
+             LLVMValueRef base_ptr,
+             LLVMValueRef num_consts,
+             LLVMValueRef index_vec)
+{
+   struct gallivm_state *gallivm = bld->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->uint_bld;
+   LLVMValueRef overflow_mask;
+   LLVMValueRef res = bld->base.undef;
+   unsigned i;
+
+   /* num_consts is in vec4 units */
+   num_consts = lp_build_shl_imm(uint_bld,
+                                 lp_build_broadcast_scalar(uint_bld, num_consts),
+                                 2);
+   overflow_mask = lp_build_compare(gallivm, uint_bld->type, PIPE_FUNC_GEQUAL,
+                                    index_vec, num_consts);
+   index_vec = lp_build_select(uint_bld, overflow_mask, uint_bld->zero,
+                               index_vec);
+
+   for (i = 0; i < bld->base.type.length; i++) {
+      LLVMValueRef ii = lp_build_const_int32(gallivm, i);
+      LLVMValueRef index = LLVMBuildExtractElement(builder, index_vec, ii, "");
+      LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, base_ptr,
+                                             &index, 1, "gather_ptr");
+      LLVMValueRef scalar = LLVMBuildLoad(builder, scalar_ptr, "");
+      res = LLVMBuildInsertElement(builder, res, scalar, ii, "");
+   }
+
+   return lp_build_select(&bld->base, overflow_mask, bld->base.zero, res);
+}
+
+
+static void
+get_const_buffer(struct lp_build_nir_soa_context *bld, unsigned index,
+                 LLVMValueRef *ptr, LLVMValueRef *size)
+{
+   struct gallivm_state *gallivm = bld->base.gallivm;
+
+   assert(index < LP_MAX_TGSI_CONST_BUFFERS);
+
+   /*
+    * Code emission is linear so the first use always dominates the
+    * following ones.
+    */
+   if (!bld->consts[index]) {
+      LLVMValueRef idx = lp_build_const_int32(gallivm, index);
+      bld->consts[index] = lp_build_array_get(gallivm, bld->consts_ptr, idx);
+      bld->consts_sizes[index] =
+         lp_build_array_get(gallivm, bld->const_sizes_ptr, idx);
+   }
+   *ptr = bld->consts[index];
+   *size = bld->consts_sizes[index];
+}
+
+
+/**
+ * Load num_components consecutive floats at the given float offset of a
+ * constant buffer.  offset_vec is the dynamic part of the offset, or NULL.
+ */
+static void
+emit_load_const(struct lp_build_nir_soa_context *bld,
+                nir_intrinsic_instr *instr,
+                unsigned buffer,
+                unsigned const_offset,
+                LLVMValueRef offset_vec)
+{
+   struct gallivm_state *gallivm = bld->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef consts_ptr, num_consts;
+   unsigned chan;
+
+   get_const_buffer(bld, buffer, &consts_ptr, &num_consts);
+
+   for (chan = 0; chan < instr->num_components; chan++) {
+      LLVMValueRef res;
+
+      if (offset_vec) {
+         LLVMValueRef index_vec =
+            lp_build_add(&bld->uint_bld, offset_vec,
+                         lp_build_const_int_vec(gallivm, bld->uint_bld.type,
+                                                const_offset + chan));
+         res = gather_const(bld, consts_ptr, num_consts, index_vec);
+      }
+      else {
+         /* Same as the direct constant fetch in the TGSI translator */
+         LLVMValueRef index = lp_build_const_int32(gallivm, const_offset + chan);
+         LLVMValueRef scalar_ptr = LLVMBuildGEP(builder, consts_ptr,
+                                                &index, 1, "");
+         LLVMValueRef scalar = LLVMBuildLoad(builder, scalar_ptr, "");
+         res = lp_build_broadcast_scalar(&bld->base, scalar);
+      }
+      store_dest(bld, &instr->dest, chan, res);
+   }
+}
+
+
+static void
+visit_load_uniform(struct lp_build_nir_soa_context *bld,
+                   nir_intrinsic_instr *instr)
+{
+   nir_const_value *offset = nir_src_as_const_value(instr->src[0]);
+   unsigned base = nir_intrinsic_base(instr) * 4;
+   LLVMValueRef offset_vec = NULL;
+
+   /* base and offset are in vec4 units, the buffer is addressed in floats */
+   if (offset) {
+      base += offset->u32[0] * 4;
+   }
+   else {
+      offset_vec = cast_to_int(bld, get_src(bld, instr->src[0], 0));
+      offset_vec = lp_build_shl_imm(&bld->uint_bld, offset_vec, 2);
+   }
+
+   emit_load_const(bld, instr, 0, base, offset_vec);
+}
+
+
+static void
+visit_load_ubo(struct lp_build_nir_soa_context *bld,
+               nir_intrinsic_instr *instr)
+{
+   nir_const_value *index = nir_src_as_const_value(instr->src[0]);
+   nir_const_value *offset = nir_src_as_const_value(instr->src[1]);
+   LLVMValueRef offset_vec = NULL;
+   unsigned base = 0;
+
+   /* Block indices are dynamically uniform, and constant after lowering */
+   assert(index);
+   if (!index) {
+      unsigned chan;
+      for (chan = 0; chan < instr->num_components; chan++)
+         store_dest(bld, &instr->dest, chan, bld->base.undef);
+      return;
+   }
+
+   /* the state tracker binds UBO n to constant buffer n + 1 */
+   if (offset) {
+      base = offset->u32[0] / 4;
+   }
+   else {
+      offset_vec = cast_to_int(bld, get_src(bld, instr->src[1], 0));
+      offset_vec = lp_build_shr_imm(&bld->uint_bld, offset_vec, 2);
+   }
+
+   emit_load_const(bld, instr, index->u32[0] + 1, base, offset_vec);
+}
+
+
+static void
+visit_load_input(struct lp_build_nir_soa_context *bld,
+                 nir_intrinsic_instr *instr)
+{
+   nir_const_value *offset = nir_src_as_const_value(instr->src[0]);
+   unsigned index = nir_intrinsic_base(instr);
+   unsigned comp = nir_intrinsic_component(instr);
+   unsigned chan;
+
+   /* Indirect input access was lowered by lp_build_nir_prepare() */
+   assert(offset);
+   if (offset)
+      index += offset->u32[0];
+
+   for (chan = 0; chan < instr->num_components; chan++) {
+      LLVMValueRef val = bld->inputs[index][comp + chan];
+
+      if (!val) {
+         val = bld->base.undef;
+      }
+      else if ((int)index == bld->face_input) {
+         /*
+          * The rasterizer provides the facing as +/-1.0, while NIR wants a
+          * proper boolean.
+          */
+         val = lp_build_cmp(&bld->base, PIPE_FUNC_GREATER,
+                            val, bld->base.zero);
+      }
+      store_dest(bld, &instr->dest, chan, val);
+   }
+}
+
+
+static void
+visit_store_output(struct lp_build_nir_soa_context *bld,
+                   nir_intrinsic_instr *instr)
+{
+   nir_const_value *offset = nir_src_as_const_value(instr->src[1]);
+   unsigned index = nir_intrinsic_base(instr);
+   unsigned comp = nir_intrinsic_component(instr);
+   unsigned write_mask = nir_intrinsic_write_mask(instr);
+   unsigned chan;
+
+   assert(offset);
+   if (offset)
+      index += offset->u32[0];
+   comp += bld->output_chan[index];
+
+   for (chan = 0; chan < instr->num_components; chan++) {
+      LLVMValueRef ptr;
+
+      if (!(write_mask & (1 << chan)))
+         continue;
+
+      ptr = bld->outputs[index][comp + chan];
+      assert(ptr);
+      if (!ptr)
+         continue;
+
+      lp_exec_mask_store(&bld->exec_mask, &bld->base,
+                         get_src(bld, instr->src[0], chan), ptr);
+   }
+}
+
+
+static void
+emit_discard(struct lp_build_nir_soa_context *bld, LLVMValueRef cond)
+{
+   LLVMBuilderRef builder = bld->base.gallivm->builder;
+   LLVMValueRef mask;
+
+   /* For those channels which are "alive" (and pass cond), kill them */
+   if (cond)
+      mask = LLVMBuildNot(builder, cast_to_int(bld, cond), "");
+   else
+      mask = LLVMConstNull(bld->int_bld.vec_type);
+
+   if (bld->exec_mask.has_mask) {
+      LLVMValueRef invmask = LLVMBuildNot(builder,
+                                          bld->exec_mask.exec_mask, "kilp");
+      mask = LLVMBuildOr(builder, mask, invmask, "");
+   }
+
+   lp_build_mask_update(bld->mask, mask);
+   lp_build_mask_check(bld->mask);
+}
+
+
+static void
+visit_system_value(struct lp_build_nir_soa_context *bld,
+                   nir_intrinsic_instr *instr,
+                   LLVMValueRef value)
+{
+   LLVMValueRef val = value;
+
+   if (val) {
+      val = lp_build_broadcast_scalar(&bld->uint_bld, val);
+   }
+   else {
+      _debug_printf("warning: unhandled NIR system value %s\n",
+                    nir_intrinsic_infos[instr->intrinsic].name);
+      val = bld->uint_bld.zero;
+   }
+
+   store_dest(bld, &instr->dest, 0, val);
+}
+
+
+static void
+visit_intrinsic(struct lp_build_nir_soa_context *bld,
+                nir_intrinsic_instr *instr)
+{
+   const struct lp_bld_tgsi_system_values *sv = bld->system_values;
+
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_input:
+      visit_load_input(bld, instr);
+      break;
+   case nir_intrinsic_store_output:
+      visit_store_output(bld, instr);
+      break;
+   case nir_intrinsic_load_uniform:
+      visit_load_uniform(bld, instr);
+      break;
+   case nir_intrinsic_load_ubo:
+      visit_load_ubo(bld, instr);
+      break;
+   case nir_intrinsic_discard:
+      emit_discard(bld, NULL);
+      break;
+   case nir_intrinsic_discard_if:
+      emit_discard(bld, get_src(bld, instr->src[0], 0));
+      break;
+   case nir_intrinsic_load_primitive_id:
+      visit_system_value(bld, instr, sv ? sv->prim_id : NULL);
+      break;
+   case nir_intrinsic_load_instance_id:
+      visit_system_value(bld, instr, sv ? sv->instance_id : NULL);
+      break;
+   case nir_intrinsic_load_base_vertex:
+      visit_system_value(bld, instr, sv ? sv->basevertex : NULL);
+      break;
+   case nir_intrinsic_load_invocation_id:
+      visit_system_value(bld, instr, sv ? sv->invocation_id : NULL);
+      break;
+   default:
+      /* rejected by intrinsic_supported() */
+      unreachable("unhandled NIR intrinsic");
+   }
+}
+
+
+/*
+ * Texturing
+ */
+
+static enum pipe_texture_target
+tex_pipe_target(const nir_tex_instr *instr)
+{
+   switch (instr->sampler_dim) {
+   case GLSL_SAMPLER_DIM_1D:
+      return instr->is_array ? PIPE_TEXTURE_1D_ARRAY : PIPE_TEXTURE_1D;
+   case GLSL_SAMPLER_DIM_2D:
+   case GLSL_SAMPLER_DIM_MS:
+   case GLSL_SAMPLER_DIM_EXTERNAL:
+      return instr->is_array ? PIPE_TEXTURE_2D_ARRAY : PIPE_TEXTURE_2D;
+   case GLSL_SAMPLER_DIM_3D:
+      return PIPE_TEXTURE_3D;
+   case GLSL_SAMPLER_DIM_CUBE:
+      return instr->is_array ? PIPE_TEXTURE_CUBE_ARRAY : PIPE_TEXTURE_CUBE;
+   case GLSL_SAMPLER_DIM_RECT:
+      return PIPE_TEXTURE_RECT;
+   case GLSL_SAMPLER_DIM_BUF:
+      return PIPE_BUFFER;
+   default:
+      assert(0);
+      return PIPE_TEXTURE_2D;
+   }
+}
+
+
+static void
+emit_tex_size(struct lp_build_nir_soa_context *bld, nir_tex_instr *instr)
+{
+   struct lp_sampler_size_query_params params;
+   LLVMValueRef sizes[4];
+   int lod_idx = nir_tex_instr_src_index(instr, nir_tex_src_lod);
+   unsigned chan;
+
+   memset(&params, 0, sizeof(params));
+   params.int_type = bld->int_bld.type;
+   params.texture_unit = instr->texture_index;
+   params.target = tex_pipe_target(instr);
+   params.context_ptr = bld->context_ptr;
+   params.is_sviewinfo = TRUE;
+   params.sizes_out = sizes;
+
+   if (lod_idx >= 0 &&
+       params.target != PIPE_BUFFER && params.target != PIPE_TEXTURE_RECT) {
+      params.explicit_lod = cast_to_int(bld, get_src(bld, instr->src[lod_idx].src, 0));
+      params.lod_property = lod_property(bld, instr->src[lod_idx].src);
+   }
+   else {
+      params.explicit_lod = NULL;
+      params.lod_property = LP_SAMPLER_LOD_SCALAR;
+   }
+
+   bld->sampler->emit_size_query(bld->sampler, bld->base.gallivm, &params);
+
+   for (chan = 0; chan < dest_num_components(&instr->dest); chan++)
+      store_dest(bld, &instr->dest, chan, sizes[chan]);
+}
+
+
+static void
+visit_tex(struct lp_build_nir_soa_context *bld, nir_tex_instr *instr)
+{
+   struct gallivm_state *gallivm = bld->base.gallivm;
+   struct lp_sampler_params params;
+   struct lp_derivatives derivs;
+   LLVMValueRef coords[5];
+   LLVMValueRef offsets[3] = { NULL };
+   LLVMValueRef texel[4];
+   LLVMValueRef lod = NULL;
+   enum lp_sampler_lod_property lod_prop = LP_SAMPLER_LOD_SCALAR;
+   enum lp_sampler_op_type sample_op = LP_SAMPLER_OP_TEXTURE;
+   unsigned sample_key = 0;
+   unsigned num_spatial = instr->coord_components - (instr->is_array ? 1 : 0);
+   boolean is_fetch = FALSE;
+   unsigned i, chan;
+
+   if (!bld->sampler) {
+      _debug_printf("warning: found texture instruction but no sampler generator supplied\n");
+      for (chan = 0; chan < dest_num_components(&instr->dest); chan++)
+         store_dest(bld, &instr->dest, chan, bld->base.undef);
+      return;
+   }
+
+   switch (instr->op) {
+   case nir_texop_txs:
+      emit_tex_size(bld, instr);
+      return;
+   case nir_texop_tex:
+   case nir_texop_txb:
+   case nir_texop_txl:
+   case nir_texop_txd:
+      break;
+   case nir_texop_txf:
+      sample_op = LP_SAMPLER_OP_FETCH;
+      is_fetch = TRUE;
+      break;
+   case nir_texop_tg4:
+      sample_op = LP_SAMPLER_OP_GATHER;
+      break;
+   case nir_texop_lod:
+      sample_op = LP_SAMPLER_OP_LODQ;
+      break;
+   default:
+      /* rejected by tex_supported() */
+      unreachable("unhandled NIR texture op");
+   }
+
+   sample_key = sample_op << LP_SAMPLER_OP_TYPE_SHIFT;
+   memset(&params, 0, sizeof(params));
+
+   for (i = 0; i < 5; i++)
+      coords[i] = is_fetch ? bld->int_bld.undef : bld->base.undef;
+
+   for (i = 0; i < instr->num_srcs; i++) {
+      nir_src src = instr->src[i].src;
+
+      switch (instr->src[i].src_type) {
+      case nir_tex_src_coord: {
+         unsigned c;
+         for (c = 0; c < num_spatial; c++)
+            coords[c] = get_src(bld, src, c);
+         /* Layer coord always goes into 3rd slot, except for cube map arrays */
+         if (instr->is_array) {
+            unsigned layer_slot =
+               instr->sampler_dim == GLSL_SAMPLER_DIM_CUBE ? 3 : 2;
+            coords[layer_slot] = get_src(bld, src, num_spatial);
+         }
+         if (is_fetch) {
+            for (c = 0; c < 5; c++)
+               coords[c] = cast_to_int(bld, coords[c]);
+         }
+         break;
+      }
+      case nir_tex_src_comparator:
+         /* Shadow coord occupies always 5th slot. */
+         sample_key |= LP_SAMPLER_SHADOW;
+         coords[4] = get_src(bld, src, 0);
+         break;
+      case nir_tex_src_bias:
+         sample_key |= LP_SAMPLER_LOD_BIAS << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         lod = get_src(bld, src, 0);
+         lod_prop = lod_property(bld, src);
+         break;
+      case nir_tex_src_lod:
+         /* buffers and rect textures have no mip levels */
+         if (is_fetch && (instr->sampler_dim == GLSL_SAMPLER_DIM_BUF ||
+                          instr->sampler_dim == GLSL_SAMPLER_DIM_MS))
+            break;
+         sample_key |= LP_SAMPLER_LOD_EXPLICIT << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         lod = get_src(bld, src, 0);
+         if (is_fetch)
+            lod = cast_to_int(bld, lod);
+         lod_prop = lod_property(bld, src);
+         break;
+      case nir_tex_src_ddx:
+      case nir_tex_src_ddy: {
+         unsigned dim, num_derivs = MIN2(num_spatial, 3);
+         sample_key |= LP_SAMPLER_LOD_DERIVATIVES << LP_SAMPLER_LOD_CONTROL_SHIFT;
+         for (dim = 0; dim < num_derivs; dim++) {
+            if (instr->src[i].src_type == nir_tex_src_ddx)
+               derivs.ddx[dim] = get_src(bld, src, dim);
+            else
+               derivs.ddy[dim] = get_src(bld, src, dim);
+         }
+         params.derivs = &derivs;
+         lod_prop = (gallivm_debug & GALLIVM_DEBUG_NO_QUAD_LOD) ?
+                    LP_SAMPLER_LOD_PER_ELEMENT : LP_SAMPLER_LOD_PER_QUAD;
+         break;
+      }
+      case nir_tex_src_offset: {
+         unsigned dim;
+         sample_key |= LP_SAMPLER_OFFSETS;
+         for (dim = 0; dim < MIN2(num_spatial, 3); dim++)
+            offsets[dim] = cast_to_int(bld, get_src(bld, src, dim));
+         break;
+      }
+      default:
+         unreachable("unhandled NIR texture source");
+      }
+   }
+
+   /* tex_supported() only lets through gathers of the first component */
+   assert(instr->op != nir_texop_tg4 || instr->component == 0);
+
+   sample_key |= lod_prop << LP_SAMPLER_LOD_PROPERTY_SHIFT;
+
+   params.type = bld->base.type;
+   params.sample_key = sample_key;
+   params.texture_index = instr->texture_index;
+   /* texel fetches don't use a sampler, see emit_fetch_texels() */
+   params.sampler_index = is_fetch ? 0 : instr->sampler_index;
+   params.context_ptr = bld->context_ptr;
+   params.thread_data_ptr = bld->thread_data_ptr;
+   params.coords = coords;
+   params.offsets = offsets;
+   params.lod = lod;
+   params.texel = texel;
+
+   bld->sampler->emit_tex_sample(bld->sampler, gallivm, &params);
+
+   for (chan = 0; chan < dest_num_components(&instr->dest); chan++)
+      store_dest(bld, &instr->dest, chan, texel[chan]);
+}
+
+
+/*
+ * Control flow
+ */
+
+static void
+visit_cf_list(struct lp_build_nir_soa_context *bld, struct exec_list *list);
+
+
+static void
+visit_jump(struct lp_build_nir_soa_context *bld, nir_jump_instr *instr)
+{
+   switch (instr->type) {
+   case nir_jump_break:
+      lp_exec_break(&bld->exec_mask, NULL);
+      break;
+   case nir_jump_continue:
+      lp_exec_continue(&bld->exec_mask);
+      break;
+   default:
+      /* returns were lowered by lp_build_nir_prepare() */
+      assert(0);
+      break;
+   }
+}
+
+
+static void
+visit_block(struct lp_build_nir_soa_context *bld, nir_block *block)
+{
+   nir_foreach_instr(instr, block) {
+      switch (instr->type) {
+      case nir_instr_type_alu:
+         visit_alu(bld, nir_instr_as_alu(instr));
+         break;
+      case nir_instr_type_load_const:
+         visit_load_const(bld, nir_instr_as_load_const(instr));
+         break;
+      case nir_instr_type_ssa_undef:
+         visit_ssa_undef(bld, nir_instr_as_ssa_undef(instr));
+         break;
+      case nir_instr_type_intrinsic:
+         visit_intrinsic(bld, nir_instr_as_intrinsic(instr));
+         break;
+      case nir_instr_type_tex:
+         visit_tex(bld, nir_instr_as_tex(instr));
+         break;
+      case nir_instr_type_jump:
+         visit_jump(bld, nir_instr_as_jump(instr));
+         break;
+      default:
+         /* phis and parallel copies are gone after nir_convert_from_ssa */
+         unreachable("unhandled NIR instruction type");
+      }
+   }
+}
+
+
+static void
+visit_if(struct lp_build_nir_soa_context *bld, nir_if *nif)
+{
+   LLVMValueRef cond = cast_to_int(bld, get_src(bld, nif->condition, 0));
+
+   lp_exec_mask_cond_push(&bld->exec_mask, cond);
+   visit_cf_list(bld, &nif->then_list);
+
+   if (nir_if_first_else_block(nif) != nir_if_last_else_block(nif) ||
+       !exec_list_is_empty(&nir_if_first_else_block(nif)->instr_list)) {
+      lp_exec_mask_cond_invert(&bld->exec_mask);
+      visit_cf_list(bld, &nif->else_list);
+   }
+
+   lp_exec_mask_cond_pop(&bld->exec_mask);
+}
+
+
+static void
+visit_loop(struct lp_build_nir_soa_context *bld, nir_loop *loop)
+{
+   lp_exec_bgnloop(&bld->exec_mask);
+   visit_cf_list(bld, &loop->body);
+   lp_exec_endloop(bld->base.gallivm, &bld->exec_mask);
+}
+
+
+static void
+visit_cf_list(struct lp_build_nir_soa_context *bld, struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list) {
+      switch (node->type) {
+      case nir_cf_node_block:
+         visit_block(bld, nir_cf_node_as_block(node));
+         break;
+      case nir_cf_node_if:
+         visit_if(bld, nir_cf_node_as_if(node));
+         break;
+      case nir_cf_node_loop:
+         visit_loop(bld, nir_cf_node_as_loop(node));
+         break;
+      default:
+         assert(0);
+         break;
+      }
+   }
+}
+
+
+void
+lp_build_nir_soa(struct gallivm_state *gallivm,
+                 struct nir_shader *shader,
+                 struct lp_type type,
+                 struct lp_build_mask_context *mask,
+                 LLVMValueRef consts_ptr,
+                 LLVMValueRef const_sizes_ptr,
+                 const struct lp_bld_tgsi_system_values *system_values,
+                 const LLVMValueRef (*inputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
+                 LLVMValueRef context_ptr,
+                 LLVMValueRef thread_data_ptr,
+                 struct lp_build_sampler_soa *sampler)
+{
+   struct lp_build_nir_soa_context bld;
+   nir_function_impl *impl = nir_shader_get_entrypoint(shader);
+   unsigned i, chan;
+
+   memset(&bld, 0, sizeof bld);
+   lp_build_context_init(&bld.base, gallivm, type);
+   lp_build_context_init(&bld.uint_bld, gallivm, lp_uint_type(type));
+   lp_build_context_init(&bld.int_bld, gallivm, lp_int_type(type));
+
+   bld.shader = shader;
+   bld.mask = mask;
+   bld.consts_ptr = consts_ptr;
+   bld.const_sizes_ptr = const_sizes_ptr;
+   bld.system_values = system_values;
+   bld.inputs = inputs;
+   bld.outputs = outputs;
+   bld.context_ptr = context_ptr;
+   bld.thread_data_ptr = thread_data_ptr;
+   bld.sampler = sampler;
+   bld.face_input = -1;
+
+   nir_foreach_variable(var, &shader->inputs) {
+      if (shader->info.stage == MESA_SHADER_FRAGMENT &&
+          var->data.location == VARYING_SLOT_FACE)
+         bld.face_input = var->data.driver_location;
+   }
+
+   nir_foreach_variable(var, &shader->outputs) {
+      unsigned slots = type_size(var->type);
+      for (i = 0; i < slots; i++) {
+         unsigned index = var->data.driver_location + i;
+         assert(index < PIPE_MAX_SHADER_OUTPUTS);
+         if (shader->info.stage == MESA_SHADER_FRAGMENT) {
+            if (var->data.location == FRAG_RESULT_DEPTH)
+               bld.output_chan[index] = 2;
+            else if (var->data.location == FRAG_RESULT_STENCIL)
+               bld.output_chan[index] = 1;
+         }
+         for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+            if (!outputs[index][chan])
+               outputs[index][chan] = lp_build_alloca(gallivm,
+                                                      bld.base.vec_type,
+                                                      "output");
+         }
+      }
+   }
+
+   bld.ssa_defs = CALLOC(MAX2(impl->ssa_alloc, 1), sizeof(*bld.ssa_defs));
+   bld.regs = CALLOC(MAX2(impl->reg_alloc, 1), sizeof(*bld.regs));
+
+   nir_foreach_register(reg, &impl->registers) {
+      unsigned num_elems = MAX2(reg->num_array_elems, 1) * TGSI_NUM_CHANNELS;
+
+      assert(reg->bit_size == 32);
+      bld.regs[reg->index] = CALLOC(num_elems, sizeof(LLVMValueRef));
+      for (i = 0; i < num_elems; i++) {
+         if (i % TGSI_NUM_CHANNELS < reg->num_components)
+            bld.regs[reg->index][i] = lp_build_alloca(gallivm,
+                                                      bld.base.vec_type,
+                                                      "reg");
+      }
+   }
+
+   lp_exec_mask_init(&bld.exec_mask, &bld.base);
+
+   visit_cf_list(&bld, &impl->body);
+
+   lp_exec_mask_fini(&bld.exec_mask);
+
+   for (i = 0; i < impl->reg_alloc; i++)
+      FREE(bld.regs[i]);
+   FREE(bld.regs);
+   FREE(bld.ssa_defs);
+}
@@ -67,6 +67,9 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_mem_iface;
+struct lp_build_tgsi_tess_iface;
+struct lp_build_tgsi_context;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +173,18 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+
+   /* Compute shaders: thread_id holds vectors, the others scalars. */
+   LLVMValueRef thread_id[3];
+   LLVMValueRef block_id[3];
+   LLVMValueRef grid_size[3];
+   LLVMValueRef block_size[3];
+
+   /* Tessellation shaders, all vectors. */
+   LLVMValueRef vertices_in;
+   LLVMValueRef tess_coord[3];
+   LLVMValueRef tess_outer[4];
+   LLVMValueRef tess_inner[2];
 };
 
 
@@ -230,7 +245,13 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_mem_iface *mem_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface);
+
+
+unsigned
+lp_build_tgsi_tess_temps_size(const struct tgsi_shader_info *info);
 
 
 void
@@ -306,6 +327,25 @@ struct lp_exec_mask {
    int function_stack_size;
 };
 
+/*
+ * Execution mask helpers, shared with the NIR translator
+ * (lp_bld_nir_soa.c) which has the same structured control flow.
+ */
+void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld);
+void lp_exec_mask_fini(struct lp_exec_mask *mask);
+void lp_exec_mask_cond_push(struct lp_exec_mask *mask, LLVMValueRef val);
+void lp_exec_mask_cond_invert(struct lp_exec_mask *mask);
+void lp_exec_mask_cond_pop(struct lp_exec_mask *mask);
+void lp_exec_bgnloop(struct lp_exec_mask *mask);
+void lp_exec_break(struct lp_exec_mask *mask,
+                   struct lp_build_tgsi_context *bld_base);
+void lp_exec_continue(struct lp_exec_mask *mask);
+void lp_exec_endloop(struct gallivm_state *gallivm, struct lp_exec_mask *mask);
+void lp_exec_mask_store(struct lp_exec_mask *mask,
+                        struct lp_build_context *bld_store,
+                        LLVMValueRef val,
+                        LLVMValueRef dst_ptr);
+
 struct lp_build_tgsi_inst_list
 {
    struct tgsi_full_instruction *instructions;
@@ -398,6 +438,13 @@ struct lp_build_tgsi_context
      */
    void (*emit_prologue)(struct lp_build_tgsi_context*);
 
+   /** This function allows the user to insert some instructions after the
+     * declarations and immediates have been emitted, right before the
+     * first instruction.  It is optional and does not need to be
+     * implemented.
+     */
+   void (*emit_prologue_post_decl)(struct lp_build_tgsi_context*);
+
    /** This function allows the user to insert some instructions at the end of
      * the program.  This callback is intended to be used for emitting
      * instructions to handle the export for the output registers, but it can
@@ -430,6 +477,100 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Members of an image descriptor, see lp_build_tgsi_mem_iface::image_member.
+ */
+enum lp_build_image_member {
+   LP_IMAGE_BASE = 0,     /**< i8 *, first texel of the view */
+   LP_IMAGE_WIDTH,        /**< width in texels, 0 if no image is bound */
+   LP_IMAGE_HEIGHT,
+   LP_IMAGE_DEPTH,        /**< slices of 3D images, layers of arrays */
+   LP_IMAGE_ROW_STRIDE,   /**< in bytes */
+   LP_IMAGE_IMG_STRIDE,   /**< in bytes, between slices or layers */
+   LP_IMAGE_CPP,          /**< bytes per texel of the view's format */
+   LP_IMAGE_PACK,         /**< util_format pack_rgba_* of the view's format */
+   LP_IMAGE_NUM_MEMBERS
+};
+
+/**
+ * Memory the shader can write to.
+ *
+ * Shader buffers are addressed through pointers to an array of base
+ * pointers and an array of sizes in bytes, both indexed by the
+ * TGSI_FILE_BUFFER index.
+ * TGSI_FILE_MEMORY maps to the shared memory of the work group and is
+ * only available to compute shaders.  Accesses outside of a buffer or
+ * image are discarded, and loads from there return zero.
+ */
+struct lp_build_tgsi_mem_iface
+{
+   LLVMValueRef ssbo_ptr;
+   LLVMValueRef ssbo_sizes_ptr;
+   LLVMValueRef shared_ptr;
+   LLVMValueRef shared_size;
+
+   /* Return the scalar member 'member' of the descriptor of image 'unit',
+    * an i32 which needn't be constant.
+    */
+   LLVMValueRef (*image_member)(const struct lp_build_tgsi_mem_iface *mem_iface,
+                                struct gallivm_state *gallivm,
+                                LLVMValueRef unit,
+                                enum lp_build_image_member member);
+
+   /* Suspend the invocations of the current vector until every
+    * invocation of the work group has reached the barrier.  NULL outside
+    * of compute shaders.
+    */
+   void (*emit_barrier)(const struct lp_build_tgsi_mem_iface *mem_iface,
+                        struct lp_build_tgsi_context *bld_base);
+};
+
+/**
+ * Tessellation control and evaluation shaders.
+ *
+ * Inputs and the outputs of control shaders are addressed by vertex and
+ * attribute, per-patch ones being those of vertex 0.  Vertex and
+ * attribute indices are vectors if the matching is_*_indirect flag is
+ * set, i32 constants otherwise.
+ *
+ * A control shader with barriers runs in phases, phase n starting after
+ * the n-th barrier and returning at the next one.  Temporary and address
+ * registers are saved to temps_ptr before returning and restored when
+ * resuming, see lp_build_tgsi_tess_temps_size().
+ */
+struct lp_build_tgsi_tess_iface
+{
+   LLVMValueRef (*fetch_input)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                               struct lp_build_tgsi_context *bld_base,
+                               boolean is_vindex_indirect,
+                               LLVMValueRef vertex_index,
+                               boolean is_aindex_indirect,
+                               LLVMValueRef attrib_index,
+                               LLVMValueRef swizzle_index);
+
+   /* Control shaders only */
+   LLVMValueRef (*fetch_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                                struct lp_build_tgsi_context *bld_base,
+                                boolean is_vindex_indirect,
+                                LLVMValueRef vertex_index,
+                                boolean is_aindex_indirect,
+                                LLVMValueRef attrib_index,
+                                LLVMValueRef swizzle_index);
+   void (*store_output)(const struct lp_build_tgsi_tess_iface *tess_iface,
+                        struct lp_build_tgsi_context *bld_base,
+                        boolean is_vindex_indirect,
+                        LLVMValueRef vertex_index,
+                        boolean is_aindex_indirect,
+                        LLVMValueRef attrib_index,
+                        LLVMValueRef swizzle_index,
+                        LLVMValueRef value,
+                        LLVMValueRef mask_vec);
+
+   /* i32 phase to run and <4 x float> * storage, NULL without barriers */
+   LLVMValueRef phase;
+   LLVMValueRef temps_ptr;
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -443,6 +584,14 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_mem_iface *mem_iface;
+
+   const struct lp_build_tgsi_tess_iface *tess_iface;
+   /* Barriers of control shaders, see lp_build_tgsi_tess_iface */
+   LLVMValueRef phase_switch;
+   LLVMBasicBlockRef phase_end_block;
+   unsigned num_phases;
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
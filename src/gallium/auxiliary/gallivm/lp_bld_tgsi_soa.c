@@ -39,6 +39,7 @@
 #include "pipe/p_config.h"
 #include "pipe/p_shader_tokens.h"
 #include "util/u_debug.h"
+#include "util/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "tgsi/tgsi_dump.h"
@@ -58,6 +59,7 @@
 #include "lp_bld_logic.h"
 #include "lp_bld_swizzle.h"
 #include "lp_bld_flow.h"
+#include "lp_bld_format.h"
 #include "lp_bld_quad.h"
 #include "lp_bld_tgsi.h"
 #include "lp_bld_limits.h"
@@ -195,7 +197,7 @@ lp_exec_mask_function_init(struct lp_exec_mask *mask, int function_idx)
       ctx->loop_limiter);
 }
 
-static void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld)
+void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context *bld)
 {
    mask->bld = bld;
    mask->has_mask = FALSE;
@@ -213,7 +215,7 @@ static void lp_exec_mask_init(struct lp_exec_mask *mask, struct lp_build_context
    lp_exec_mask_function_init(mask, 0);
 }
 
-static void
+void
 lp_exec_mask_fini(struct lp_exec_mask *mask)
 {
    FREE(mask->function_stack);
@@ -263,8 +265,8 @@ static void lp_exec_mask_update(struct lp_exec_mask *mask)
                      has_ret_mask);
 }
 
-static void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
-                                   LLVMValueRef val)
+void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
+                            LLVMValueRef val)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -285,7 +287,7 @@ static void lp_exec_mask_cond_push(struct lp_exec_mask *mask,
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
+void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -308,7 +310,7 @@ static void lp_exec_mask_cond_invert(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
+void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
 {
    struct function_ctx *ctx = func_ctx(mask);
    assert(ctx->cond_stack_size);
@@ -319,7 +321,7 @@ static void lp_exec_mask_cond_pop(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_bgnloop(struct lp_exec_mask *mask)
+void lp_exec_bgnloop(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -352,8 +354,8 @@ static void lp_exec_bgnloop(struct lp_exec_mask *mask)
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_break(struct lp_exec_mask *mask,
-                          struct lp_build_tgsi_context * bld_base)
+void lp_exec_break(struct lp_exec_mask *mask,
+                   struct lp_build_tgsi_context * bld_base)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -402,7 +404,7 @@ static void lp_exec_break(struct lp_exec_mask *mask,
    lp_exec_mask_update(mask);
 }
 
-static void lp_exec_continue(struct lp_exec_mask *mask)
+void lp_exec_continue(struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    LLVMValueRef exec_mask = LLVMBuildNot(builder,
@@ -417,8 +419,8 @@ static void lp_exec_continue(struct lp_exec_mask *mask)
 }
 
 
-static void lp_exec_endloop(struct gallivm_state *gallivm,
-                            struct lp_exec_mask *mask)
+void lp_exec_endloop(struct gallivm_state *gallivm,
+                     struct lp_exec_mask *mask)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    struct function_ctx *ctx = func_ctx(mask);
@@ -727,10 +729,10 @@ static void lp_exec_default(struct lp_exec_mask *mask,
  * should be stored into the address
  * (0 means don't store this bit, 1 means do store).
  */
-static void lp_exec_mask_store(struct lp_exec_mask *mask,
-                               struct lp_build_context *bld_store,
-                               LLVMValueRef val,
-                               LLVMValueRef dst_ptr)
+void lp_exec_mask_store(struct lp_exec_mask *mask,
+                        struct lp_build_context *bld_store,
+                        LLVMValueRef val,
+                        LLVMValueRef dst_ptr)
 {
    LLVMBuilderRef builder = mask->bld->gallivm->builder;
    LLVMValueRef exec_mask = mask->has_mask ? mask->exec_mask : NULL;
@@ -1040,14 +1042,12 @@ emit_mask_scatter(struct lp_build_tgsi_soa_context *bld,
 
 /**
  * Read the current value of the ADDR register, convert the floats to
- * ints, add the base index and return the vector of offsets.
- * The offsets will be used to index into the constant buffer or
- * temporary register file.
+ * ints and add the base index, without any clamping.
  */
 static LLVMValueRef
-get_indirect_index(struct lp_build_tgsi_soa_context *bld,
-                   unsigned reg_file, unsigned reg_index,
-                   const struct tgsi_ind_register *indirect_reg)
+get_indirect_offset(struct lp_build_tgsi_soa_context *bld,
+                    unsigned reg_index,
+                    const struct tgsi_ind_register *indirect_reg)
 {
    LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
    struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
@@ -1055,10 +1055,6 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
    unsigned swizzle = indirect_reg->Swizzle;
    LLVMValueRef base;
    LLVMValueRef rel;
-   LLVMValueRef max_index;
-   LLVMValueRef index;
-
-   assert(bld->indirect_files & (1 << reg_file));
 
    base = lp_build_const_int_vec(bld->bld_base.base.gallivm, uint_bld->type, reg_index);
 
@@ -1082,7 +1078,28 @@ get_indirect_index(struct lp_build_tgsi_soa_context *bld,
       rel = uint_bld->zero;
    }
 
-   index = lp_build_add(uint_bld, base, rel);
+   return lp_build_add(uint_bld, base, rel);
+}
+
+
+/**
+ * Read the current value of the ADDR register, convert the floats to
+ * ints, add the base index and return the vector of offsets.
+ * The offsets will be used to index into the constant buffer or
+ * temporary register file.
+ */
+static LLVMValueRef
+get_indirect_index(struct lp_build_tgsi_soa_context *bld,
+                   unsigned reg_file, unsigned reg_index,
+                   const struct tgsi_ind_register *indirect_reg)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef max_index;
+   LLVMValueRef index;
+
+   assert(bld->indirect_files & (1 << reg_file));
+
+   index = get_indirect_offset(bld, reg_index, indirect_reg);
 
    /*
     * emit_fetch_constant handles constant buffer overflow so this code
@@ -1533,6 +1550,98 @@ emit_fetch_gs_input(
    return res;
 }
 
+/**
+ * Outputs of tessellation control shaders are shared by the invocations
+ * of a patch, so they are read and written in place through the
+ * interface rather than gathered at the end.
+ */
+static inline boolean
+outputs_in_memory(const struct lp_build_tgsi_soa_context *bld)
+{
+   return bld->tess_iface && bld->tess_iface->store_output;
+}
+
+/**
+ * Vertex index of a tessellation shader input or control shader output.
+ * Per-patch registers have no dimension and live in vertex 0.  Indirect
+ * indices aren't clamped, that is up to the interface.
+ */
+static LLVMValueRef
+get_tess_vertex_index(struct lp_build_tgsi_soa_context *bld,
+                      boolean has_dimension,
+                      const struct tgsi_dimension *dim,
+                      const struct tgsi_ind_register *dim_indirect)
+{
+   if (has_dimension && dim->Indirect)
+      return get_indirect_offset(bld, dim->Index, dim_indirect);
+
+   return lp_build_const_int32(bld->bld_base.base.gallivm,
+                               has_dimension ? dim->Index : 0);
+}
+
+static LLVMValueRef
+emit_fetch_tess(
+   struct lp_build_tgsi_context * bld_base,
+   const struct tgsi_full_src_register * reg,
+   enum tgsi_opcode_type stype,
+   unsigned swizzle)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned num_chans = tgsi_type_is_64bit(stype) ? 2 : 1;
+   const boolean is_vindex_indirect =
+      reg->Register.Dimension && reg->Dimension.Indirect;
+   LLVMValueRef attrib_index;
+   LLVMValueRef vertex_index;
+   LLVMValueRef res[2];
+   unsigned i;
+
+   if (reg->Register.Indirect) {
+      attrib_index = get_indirect_index(bld,
+                                        reg->Register.File,
+                                        reg->Register.Index,
+                                        &reg->Indirect);
+   } else {
+      attrib_index = lp_build_const_int32(gallivm, reg->Register.Index);
+   }
+
+   vertex_index = get_tess_vertex_index(bld, reg->Register.Dimension,
+                                        &reg->Dimension, &reg->DimIndirect);
+
+   for (i = 0; i < num_chans; i++) {
+      LLVMValueRef swizzle_index = lp_build_const_int32(gallivm, swizzle + i);
+
+      if (reg->Register.File == TGSI_FILE_OUTPUT) {
+         res[i] = tess_iface->fetch_output(tess_iface, bld_base,
+                                           is_vindex_indirect,
+                                           vertex_index,
+                                           reg->Register.Indirect,
+                                           attrib_index,
+                                           swizzle_index);
+      } else {
+         res[i] = tess_iface->fetch_input(tess_iface, bld_base,
+                                          is_vindex_indirect,
+                                          vertex_index,
+                                          reg->Register.Indirect,
+                                          attrib_index,
+                                          swizzle_index);
+      }
+      assert(res[i]);
+   }
+
+   if (tgsi_type_is_64bit(stype)) {
+      return emit_fetch_64bit(bld_base, stype, res[0], res[1]);
+   } else if (stype == TGSI_TYPE_UNSIGNED) {
+      return LLVMBuildBitCast(builder, res[0], bld_base->uint_bld.vec_type, "");
+   } else if (stype == TGSI_TYPE_SIGNED) {
+      return LLVMBuildBitCast(builder, res[0], bld_base->int_bld.vec_type, "");
+   }
+
+   return res[0];
+}
+
 static LLVMValueRef
 emit_fetch_temporary(
    struct lp_build_tgsi_context * bld_base,
@@ -1647,6 +1756,66 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      if (swizzle < 3)
+         res = bld->system_values.thread_id[swizzle];
+      else
+         res = bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+   case TGSI_SEMANTIC_GRID_SIZE:
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+   {
+      const LLVMValueRef *values;
+
+      switch (info->system_value_semantic_name[reg->Register.Index]) {
+      case TGSI_SEMANTIC_BLOCK_ID:
+         values = bld->system_values.block_id;
+         break;
+      case TGSI_SEMANTIC_GRID_SIZE:
+         values = bld->system_values.grid_size;
+         break;
+      default:
+         values = bld->system_values.block_size;
+         break;
+      }
+
+      if (swizzle < 3)
+         res = lp_build_broadcast_scalar(&bld_base->uint_bld, values[swizzle]);
+      else
+         res = bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+   }
+
+   case TGSI_SEMANTIC_VERTICESIN:
+      res = bld->system_values.vertices_in;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_TESSCOORD:
+      if (swizzle < 3)
+         res = bld->system_values.tess_coord[swizzle];
+      else
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSOUTER:
+      res = bld->system_values.tess_outer[swizzle];
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
+   case TGSI_SEMANTIC_TESSINNER:
+      if (swizzle < 2)
+         res = bld->system_values.tess_inner[swizzle];
+      else
+         res = bld_base->base.zero;
+      atype = TGSI_TYPE_FLOAT;
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -1691,25 +1860,18 @@ emit_fetch_deriv(
 }
 
 /**
- * store an array of vec-length 64-bit into two arrays of vec_length floats
- * i.e.
- * value is d0, d1, d2, d3 etc.
- * each 64-bit has high and low pieces x, y
- * so gets stored into the separate channels as:
- * chan_ptr = d0.x, d1.x, d2.x, d3.x
- * chan_ptr2 = d0.y, d1.y, d2.y, d3.y
+ * Split an array of vec-length 64-bit into the vectors of their x and y
+ * pieces, see emit_store_64bit_chan.
  */
 static void
-emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
-                      LLVMValueRef chan_ptr, LLVMValueRef chan_ptr2,
-                      LLVMValueRef value)
+split_64bit_chan(struct lp_build_tgsi_context *bld_base,
+                 LLVMValueRef value,
+                 LLVMValueRef *temp,
+                 LLVMValueRef *temp2)
 {
-   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    struct gallivm_state *gallivm = bld_base->base.gallivm;
    LLVMBuilderRef builder = gallivm->builder;
-   struct lp_build_context *float_bld = &bld_base->base;
    unsigned i;
-   LLVMValueRef temp, temp2;
    LLVMValueRef shuffles[LP_MAX_VECTOR_WIDTH/32];
    LLVMValueRef shuffles2[LP_MAX_VECTOR_WIDTH/32];
 
@@ -1718,21 +1880,101 @@ emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
       shuffles2[i] = lp_build_const_int32(gallivm, (i * 2) + 1);
    }
 
-   temp = LLVMBuildShuffleVector(builder, value,
-                                 LLVMGetUndef(LLVMTypeOf(value)),
-                                 LLVMConstVector(shuffles,
-                                                 bld_base->base.type.length),
-                                 "");
-   temp2 = LLVMBuildShuffleVector(builder, value,
+   *temp = LLVMBuildShuffleVector(builder, value,
                                   LLVMGetUndef(LLVMTypeOf(value)),
-                                  LLVMConstVector(shuffles2,
+                                  LLVMConstVector(shuffles,
                                                   bld_base->base.type.length),
                                   "");
+   *temp2 = LLVMBuildShuffleVector(builder, value,
+                                   LLVMGetUndef(LLVMTypeOf(value)),
+                                   LLVMConstVector(shuffles2,
+                                                   bld_base->base.type.length),
+                                   "");
+}
+
+/**
+ * store an array of vec-length 64-bit into two arrays of vec_length floats
+ * i.e.
+ * value is d0, d1, d2, d3 etc.
+ * each 64-bit has high and low pieces x, y
+ * so gets stored into the separate channels as:
+ * chan_ptr = d0.x, d1.x, d2.x, d3.x
+ * chan_ptr2 = d0.y, d1.y, d2.y, d3.y
+ */
+static void
+emit_store_64bit_chan(struct lp_build_tgsi_context *bld_base,
+                      LLVMValueRef chan_ptr, LLVMValueRef chan_ptr2,
+                      LLVMValueRef value)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct lp_build_context *float_bld = &bld_base->base;
+   LLVMValueRef temp, temp2;
+
+   split_64bit_chan(bld_base, value, &temp, &temp2);
 
    lp_exec_mask_store(&bld->exec_mask, float_bld, temp, chan_ptr);
    lp_exec_mask_store(&bld->exec_mask, float_bld, temp2, chan_ptr2);
 }
 
+static LLVMValueRef
+mask_vec(struct lp_build_tgsi_context *bld_base);
+
+/**
+ * Store to an output of a tessellation control shader.
+ */
+static void
+emit_store_tess_output(struct lp_build_tgsi_context *bld_base,
+                       const struct tgsi_full_dst_register *reg,
+                       LLVMValueRef indirect_index,
+                       unsigned chan_index,
+                       enum tgsi_opcode_type dtype,
+                       LLVMValueRef value)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct lp_build_tgsi_tess_iface *tess_iface = bld->tess_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const boolean is_vindex_indirect =
+      reg->Register.Dimension && reg->Dimension.Indirect;
+   LLVMValueRef attrib_index;
+   LLVMValueRef vertex_index;
+   LLVMValueRef values[2];
+   LLVMValueRef exec_mask = mask_vec(bld_base);
+   unsigned num_chans = 1;
+   unsigned i;
+
+   if (reg->Register.Indirect)
+      attrib_index = indirect_index;
+   else
+      attrib_index = lp_build_const_int32(gallivm, reg->Register.Index);
+
+   vertex_index = get_tess_vertex_index(bld, reg->Register.Dimension,
+                                        &reg->Dimension, &reg->DimIndirect);
+
+   if (tgsi_type_is_64bit(dtype)) {
+      value = LLVMBuildBitCast(builder, value,
+                               LLVMVectorType(LLVMFloatTypeInContext(gallivm->context),
+                                              bld_base->base.type.length * 2), "");
+      split_64bit_chan(bld_base, value, &values[0], &values[1]);
+      num_chans = 2;
+   } else {
+      /* Outputs are always stored as floats */
+      values[0] = LLVMBuildBitCast(builder, value,
+                                   bld_base->base.vec_type, "");
+   }
+
+   for (i = 0; i < num_chans; i++) {
+      tess_iface->store_output(tess_iface, bld_base,
+                               is_vindex_indirect,
+                               vertex_index,
+                               reg->Register.Indirect,
+                               attrib_index,
+                               lp_build_const_int32(gallivm, chan_index + i),
+                               values[i],
+                               exec_mask);
+   }
+}
+
 /**
  * Register store.
  */
@@ -1786,6 +2028,12 @@ emit_store_chan(
 
    switch( reg->Register.File ) {
    case TGSI_FILE_OUTPUT:
+      if (outputs_in_memory(bld)) {
+         emit_store_tess_output(bld_base, reg, indirect_index, chan_index,
+                                dtype, value);
+         break;
+      }
+
       /* Outputs are always stored as floats */
       value = LLVMBuildBitCast(builder, value, float_bld->vec_type, "");
 
@@ -2850,7 +3098,8 @@ lp_emit_declaration_soa(
       break;
 
    case TGSI_FILE_OUTPUT:
-      if (!(bld->indirect_files & (1 << TGSI_FILE_OUTPUT))) {
+      if (!(bld->indirect_files & (1 << TGSI_FILE_OUTPUT)) &&
+          !outputs_in_memory(bld)) {
          for (idx = first; idx <= last; ++idx) {
             for (i = 0; i < TGSI_NUM_CHANNELS; i++)
                bld->outputs[idx][i] = lp_build_alloca(gallivm,
@@ -3639,74 +3888,1106 @@ cont_emit(
    lp_exec_continue(&bld->exec_mask);
 }
 
-static void emit_prologue(struct lp_build_tgsi_context * bld_base)
+/*
+ * Shader buffer, image and shared memory access.
+ *
+ * Each invocation computes its own address, so stores and atomics are done
+ * one lane at a time, skipping the lanes which are inactive or whose access
+ * does not fit in the buffer or image.  Image loads fetch the texels of all
+ * the lanes at once.
+ */
+
+/**
+ * Return a vector with the TGSI_FILE_BUFFER index accessed by each lane.
+ */
+static LLVMValueRef
+get_mem_index_vec(struct lp_build_tgsi_soa_context *bld,
+                  unsigned file,
+                  unsigned index,
+                  boolean indirect,
+                  const struct tgsi_ind_register *indirect_reg)
 {
-   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
-   struct gallivm_state * gallivm = bld_base->base.gallivm;
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
 
-   if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
-      LLVMValueRef array_size =
-         lp_build_const_int32(gallivm,
-                         bld_base->info->file_max[TGSI_FILE_TEMPORARY] * 4 + 4);
-      bld->temps_array = lp_build_array_alloca(gallivm,
-                                              bld_base->base.vec_type, array_size,
-                                              "temp_array");
-   }
+   if (file == TGSI_FILE_BUFFER && indirect)
+      return get_indirect_index(bld, file, index, indirect_reg);
 
-   if (bld->indirect_files & (1 << TGSI_FILE_OUTPUT)) {
-      LLVMValueRef array_size =
-         lp_build_const_int32(gallivm,
-                            bld_base->info->file_max[TGSI_FILE_OUTPUT] * 4 + 4);
-      bld->outputs_array = lp_build_array_alloca(gallivm,
-                                                bld_base->base.vec_type, array_size,
-                                                "output_array");
+   return lp_build_const_int_vec(gallivm, bld->bld_base.uint_bld.type, index);
+}
+
+/**
+ * Return the base pointer and size in bytes of the memory lane 'lane'
+ * accesses.
+ */
+static void
+get_mem_lane_base(struct lp_build_tgsi_soa_context *bld,
+                  unsigned file,
+                  LLVMValueRef index_vec,
+                  unsigned lane,
+                  LLVMValueRef *base,
+                  LLVMValueRef *size)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+
+   if (file == TGSI_FILE_MEMORY) {
+      *base = bld->mem_iface->shared_ptr;
+      *size = bld->mem_iface->shared_size;
    }
+   else {
+      LLVMValueRef index =
+         LLVMBuildExtractElement(builder, index_vec,
+                                 lp_build_const_int32(gallivm, lane), "");
 
-   if (bld->indirect_files & (1 << TGSI_FILE_IMMEDIATE)) {
-      LLVMValueRef array_size =
-         lp_build_const_int32(gallivm,
-                         bld_base->info->file_max[TGSI_FILE_IMMEDIATE] * 4 + 4);
-      bld->imms_array = lp_build_array_alloca(gallivm,
-                                              bld_base->base.vec_type, array_size,
-                                              "imms_array");
+      *base = lp_build_array_get(gallivm, bld->mem_iface->ssbo_ptr, index);
+      *size = lp_build_array_get(gallivm, bld->mem_iface->ssbo_sizes_ptr,
+                                 index);
    }
+}
 
-   /* If we have indirect addressing in inputs we need to copy them into
-    * our alloca array to be able to iterate over them */
-   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) && !bld->gs_iface) {
-      unsigned index, chan;
-      LLVMTypeRef vec_type = bld_base->base.vec_type;
-      LLVMValueRef array_size = lp_build_const_int32(gallivm,
-            bld_base->info->file_max[TGSI_FILE_INPUT]*4 + 4);
-      bld->inputs_array = lp_build_array_alloca(gallivm,
-                                               vec_type, array_size,
-                                               "input_array");
+/**
+ * Open a conditional block executed only if lane 'lane' is active and
+ * 'bytes' bytes at its offset fit in the memory it accesses, and return
+ * the pointer to the first dword within the block.
+ */
+static LLVMValueRef
+begin_mem_lane(struct lp_build_tgsi_soa_context *bld,
+               unsigned file,
+               LLVMValueRef index_vec,
+               LLVMValueRef offset_vec,
+               LLVMValueRef exec_mask,
+               unsigned lane,
+               unsigned bytes,
+               struct lp_build_if_state *ifthen)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef lane_index = lp_build_const_int32(gallivm, lane);
+   LLVMValueRef bytes_val = lp_build_const_int32(gallivm, bytes);
+   LLVMValueRef base, size, offset, active, in_bounds, ptr;
+
+   get_mem_lane_base(bld, file, index_vec, lane, &base, &size);
+
+   offset = LLVMBuildExtractElement(builder, offset_vec, lane_index, "");
+   active = LLVMBuildExtractElement(builder, exec_mask, lane_index, "");
+   active = LLVMBuildICmp(builder, LLVMIntNE, active,
+                          LLVMConstNull(int32_type), "");
+
+   /* offset + bytes <= size, without overflowing */
+   in_bounds = LLVMBuildAnd(builder,
+                            LLVMBuildICmp(builder, LLVMIntUGE, size,
+                                          bytes_val, ""),
+                            LLVMBuildICmp(builder, LLVMIntULE, offset,
+                                          LLVMBuildSub(builder, size,
+                                                       bytes_val, ""), ""),
+                            "");
+
+   lp_build_if(ifthen, gallivm, LLVMBuildAnd(builder, active, in_bounds, ""));
+
+   ptr = LLVMBuildGEP(builder, base, &offset, 1, "");
+   return LLVMBuildBitCast(builder, ptr, LLVMPointerType(int32_type, 0), "");
+}
 
-      assert(bld_base->info->num_inputs
-                        <= bld_base->info->file_max[TGSI_FILE_INPUT] + 1);
+/**
+ * Insert the scalar 'value' at position 'lane' of the vector in 'vec_ptr'.
+ */
+static void
+store_mem_lane_result(struct lp_build_tgsi_soa_context *bld,
+                      LLVMValueRef vec_ptr,
+                      unsigned lane,
+                      LLVMValueRef value)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef vec = LLVMBuildLoad(builder, vec_ptr, "");
 
-      for (index = 0; index < bld_base->info->num_inputs; ++index) {
-         for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
-            LLVMValueRef lindex =
-               lp_build_const_int32(gallivm, index * 4 + chan);
-            LLVMValueRef input_ptr =
-               LLVMBuildGEP(gallivm->builder, bld->inputs_array,
-                            &lindex, 1, "");
-            LLVMValueRef value = bld->inputs[index][chan];
-            if (value)
-               LLVMBuildStore(gallivm->builder, value, input_ptr);
-         }
-      }
-   }
+   vec = LLVMBuildInsertElement(builder, vec, value,
+                                lp_build_const_int32(gallivm, lane), "");
+   LLVMBuildStore(builder, vec, vec_ptr);
+}
 
-   if (bld->gs_iface) {
-      struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
-      bld->emitted_prims_vec_ptr =
-         lp_build_alloca(gallivm,
-                         uint_bld->vec_type,
-                         "emitted_prims_ptr");
-      bld->emitted_vertices_vec_ptr =
-         lp_build_alloca(gallivm,
+/**
+ * Open a conditional block executed only if lane 'lane' of 'mask' is set,
+ * and return the address at byte 'offsets[lane]' of 'base' within it.
+ */
+static LLVMValueRef
+begin_image_lane(struct lp_build_tgsi_soa_context *bld,
+                 LLVMValueRef base,
+                 LLVMValueRef offsets,
+                 LLVMValueRef mask,
+                 unsigned lane,
+                 struct lp_build_if_state *ifthen)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef lane_index = lp_build_const_int32(gallivm, lane);
+   LLVMValueRef active, offset;
+
+   active = LLVMBuildExtractElement(builder, mask, lane_index, "");
+   active = LLVMBuildICmp(builder, LLVMIntNE, active,
+                          LLVMConstNull(LLVMTypeOf(active)), "");
+   lp_build_if(ifthen, gallivm, active);
+
+   offset = LLVMBuildExtractElement(builder, offsets, lane_index, "");
+   return LLVMBuildGEP(builder, base, &offset, 1, "");
+}
+
+/**
+ * Multisampled images aren't supported, accesses to them are dropped.
+ */
+static boolean
+image_target_supported(unsigned target)
+{
+   return target != TGSI_TEXTURE_UNKNOWN &&
+          target != TGSI_TEXTURE_2D_MSAA &&
+          target != TGSI_TEXTURE_2D_ARRAY_MSAA;
+}
+
+/**
+ * Return a member of the descriptor of image 'unit', broadcast to a vector.
+ */
+static LLVMValueRef
+get_image_member_vec(struct lp_build_tgsi_soa_context *bld,
+                     LLVMValueRef unit,
+                     enum lp_build_image_member member)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMValueRef value;
+
+   value = bld->mem_iface->image_member(bld->mem_iface, gallivm, unit, member);
+   return lp_build_broadcast_scalar(&bld->bld_base.uint_bld, value);
+}
+
+/**
+ * Return the image units the lanes may access, and for each of them the
+ * mask of the active lanes accessing it.  A direct access is to a single
+ * unit, an indirect one can be to any of the declared units.
+ */
+static unsigned
+get_image_units(struct lp_build_tgsi_soa_context *bld,
+                unsigned index,
+                boolean indirect,
+                const struct tgsi_ind_register *indirect_reg,
+                LLVMValueRef exec_mask,
+                LLVMValueRef units[LP_MAX_TGSI_SHADER_IMAGES],
+                LLVMValueRef masks[LP_MAX_TGSI_SHADER_IMAGES])
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef index_vec;
+   unsigned num_units, unit;
+
+   if (!indirect) {
+      assert(index < LP_MAX_TGSI_SHADER_IMAGES);
+      units[0] = lp_build_const_int32(gallivm, index);
+      masks[0] = exec_mask;
+      return 1;
+   }
+
+   /* get_indirect_index() clamps the index to the declared range. */
+   index_vec = get_indirect_index(bld, TGSI_FILE_IMAGE, index, indirect_reg);
+   num_units = bld->bld_base.info->file_max[TGSI_FILE_IMAGE] + 1;
+   assert(num_units <= LP_MAX_TGSI_SHADER_IMAGES);
+
+   for (unit = 0; unit < num_units; unit++) {
+      LLVMValueRef unit_vec =
+         lp_build_const_int_vec(gallivm, uint_bld->type, unit);
+
+      units[unit] = lp_build_const_int32(gallivm, unit);
+      masks[unit] = LLVMBuildAnd(builder, exec_mask,
+                                 lp_build_cmp(uint_bld, PIPE_FUNC_EQUAL,
+                                              index_vec, unit_vec), "");
+   }
+
+   return num_units;
+}
+
+/**
+ * Fetch the coordinates of an image access from source 'src': x, y and
+ * the slice or layer, zero where the target has fewer dimensions.
+ */
+static void
+get_image_coords(struct lp_build_tgsi_soa_context *bld,
+                 const struct tgsi_full_instruction *inst,
+                 unsigned src,
+                 LLVMValueRef coords[3])
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   unsigned num_coords, chan;
+
+   switch (inst->Memory.Texture) {
+   case TGSI_TEXTURE_1D_ARRAY:
+   case TGSI_TEXTURE_2D:
+   case TGSI_TEXTURE_RECT:
+      num_coords = 2;
+      break;
+   case TGSI_TEXTURE_2D_ARRAY:
+   case TGSI_TEXTURE_3D:
+   case TGSI_TEXTURE_CUBE:
+   case TGSI_TEXTURE_CUBE_ARRAY:
+      num_coords = 3;
+      break;
+   default:
+      num_coords = 1;
+      break;
+   }
+
+   for (chan = 0; chan < 3; chan++) {
+      if (chan < num_coords) {
+         coords[chan] = lp_build_emit_fetch(bld_base, inst, src, chan);
+         coords[chan] = LLVMBuildBitCast(builder, coords[chan],
+                                         uint_bld->vec_type, "");
+      }
+      else
+         coords[chan] = uint_bld->zero;
+   }
+
+   /* The layer of 1D arrays is their second coordinate. */
+   if (inst->Memory.Texture == TGSI_TEXTURE_1D_ARRAY) {
+      coords[2] = coords[1];
+      coords[1] = uint_bld->zero;
+   }
+}
+
+/**
+ * Return the byte offsets within image 'unit' of the texels at 'coords'.
+ * The lanes whose texel is outside of the image are cleared from 'mask',
+ * as are all of them when the image's texels don't have the size of
+ * 'format' (unless that is PIPE_FORMAT_NONE), and their offset is zero.
+ */
+static LLVMValueRef
+get_image_offsets(struct lp_build_tgsi_soa_context *bld,
+                  LLVMValueRef unit,
+                  const LLVMValueRef coords[3],
+                  enum pipe_format format,
+                  LLVMValueRef *mask)
+{
+   static const enum lp_build_image_member size_members[3] = {
+      LP_IMAGE_WIDTH, LP_IMAGE_HEIGHT, LP_IMAGE_DEPTH
+   };
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef in_bounds = *mask;
+   LLVMValueRef cpp, row_stride, img_stride, offsets;
+   unsigned i;
+
+   for (i = 0; i < 3; i++) {
+      LLVMValueRef size = get_image_member_vec(bld, unit, size_members[i]);
+
+      in_bounds = LLVMBuildAnd(builder, in_bounds,
+                               lp_build_cmp(uint_bld, PIPE_FUNC_LESS,
+                                            coords[i], size), "");
+   }
+
+   cpp = get_image_member_vec(bld, unit, LP_IMAGE_CPP);
+   if (format != PIPE_FORMAT_NONE) {
+      LLVMValueRef format_cpp =
+         lp_build_const_int_vec(gallivm, uint_bld->type,
+                                util_format_get_blocksize(format));
+
+      in_bounds = LLVMBuildAnd(builder, in_bounds,
+                               lp_build_cmp(uint_bld, PIPE_FUNC_EQUAL,
+                                            cpp, format_cpp), "");
+      cpp = format_cpp;
+   }
+   row_stride = get_image_member_vec(bld, unit, LP_IMAGE_ROW_STRIDE);
+   img_stride = get_image_member_vec(bld, unit, LP_IMAGE_IMG_STRIDE);
+
+   offsets = lp_build_mul(uint_bld, coords[0], cpp);
+   offsets = lp_build_add(uint_bld, offsets,
+                          lp_build_mul(uint_bld, coords[1], row_stride));
+   offsets = lp_build_add(uint_bld, offsets,
+                          lp_build_mul(uint_bld, coords[2], img_stride));
+   offsets = LLVMBuildAnd(builder, offsets, in_bounds, "");
+
+   *mask = in_bounds;
+   return offsets;
+}
+
+/**
+ * Return the type the texels of an image of the given format are loaded
+ * as, integers for pure integer formats.
+ */
+static struct lp_type
+get_image_texel_type(struct lp_build_tgsi_soa_context *bld,
+                     const struct util_format_description *desc)
+{
+   struct lp_type type = bld->bld_base.base.type;
+   int chan = util_format_get_first_non_void_channel(desc->format);
+
+   if (chan >= 0 && desc->channel[chan].pure_integer) {
+      if (desc->channel[chan].type == UTIL_FORMAT_TYPE_SIGNED)
+         return lp_int_type(type);
+      return lp_uint_type(type);
+   }
+
+   return type;
+}
+
+/**
+ * Whether texels of the given format are stored as they are computed,
+ * one dword per channel.
+ */
+static boolean
+image_format_is_dwords(const struct util_format_description *desc)
+{
+   unsigned chan;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN)
+      return FALSE;
+
+   for (chan = 0; chan < desc->nr_channels; chan++) {
+      if (desc->channel[chan].size != 32 ||
+          desc->swizzle[chan] != chan)
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+static void
+image_load_emit(struct lp_build_tgsi_soa_context *bld,
+                struct lp_build_emit_data *emit_data)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   enum pipe_format format = inst->Memory.Format;
+   const struct util_format_description *desc;
+   struct lp_type texel_type;
+   LLVMValueRef units[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef masks[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef coords[3], results[TGSI_NUM_CHANNELS];
+   unsigned num_units, i, chan;
+
+   /* Only images with a declared format can be read. */
+   if (format == PIPE_FORMAT_NONE ||
+       !image_target_supported(inst->Memory.Texture)) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+         emit_data->output[chan] = uint_bld->zero;
+      return;
+   }
+
+   desc = util_format_description(format);
+   texel_type = get_image_texel_type(bld, desc);
+
+   get_image_coords(bld, inst, 1, coords);
+   num_units = get_image_units(bld, res->Register.Index,
+                               res->Register.Indirect, &res->Indirect,
+                               mask_vec(bld_base), units, masks);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      results[chan] = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+      LLVMBuildStore(builder, uint_bld->zero, results[chan]);
+   }
+
+   for (i = 0; i < num_units; i++) {
+      struct lp_build_if_state ifthen;
+      LLVMValueRef mask = masks[i];
+      LLVMValueRef offsets, base, rgba[4];
+
+      offsets = get_image_offsets(bld, units[i], coords, format, &mask);
+
+      /* Unbound images have no memory at all to read from. */
+      lp_build_if(&ifthen, gallivm,
+                  lp_build_any_true_range(uint_bld, uint_bld->type.length,
+                                          mask));
+
+      base = bld->mem_iface->image_member(bld->mem_iface, gallivm, units[i],
+                                          LP_IMAGE_BASE);
+      lp_build_fetch_rgba_soa(gallivm, desc, texel_type, TRUE, base, offsets,
+                              uint_bld->zero, uint_bld->zero, NULL, rgba);
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         LLVMValueRef value = LLVMBuildBitCast(builder, rgba[chan],
+                                               uint_bld->vec_type, "");
+
+         value = lp_build_select(uint_bld, mask, value,
+                                 LLVMBuildLoad(builder, results[chan], ""));
+         LLVMBuildStore(builder, value, results[chan]);
+      }
+
+      lp_build_endif(&ifthen);
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      emit_data->output[chan] = LLVMBuildLoad(builder, results[chan], "");
+}
+
+/**
+ * Texels of formats with one dword per channel are stored directly.  The
+ * others are converted by the pack function of the bound view's format,
+ * which matches the declared format unless the application relies on
+ * reinterpreting texels of the same size, and is the only one known for
+ * images without a declared format.
+ */
+static void
+image_store_emit(struct lp_build_tgsi_soa_context *bld,
+                 struct lp_build_emit_data *emit_data)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_dst_register *res = &inst->Dst[0];
+   enum pipe_format format = inst->Memory.Format;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef int8_ptr_type =
+      LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   LLVMTypeRef pack_ptr_type = NULL;
+   LLVMValueRef units[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef masks[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef coords[3], values[TGSI_NUM_CHANNELS];
+   LLVMValueRef texel = NULL;
+   unsigned num_dwords = 0;
+   unsigned num_units, i, lane, chan;
+
+   if (!image_target_supported(inst->Memory.Texture))
+      return;
+
+   if (format != PIPE_FORMAT_NONE) {
+      const struct util_format_description *desc =
+         util_format_description(format);
+
+      if (image_format_is_dwords(desc))
+         num_dwords = desc->nr_channels;
+   }
+
+   if (!num_dwords) {
+      /* void pack_rgba_*(dst, dst_stride, src, src_stride, width, height) */
+      LLVMTypeRef arg_types[6];
+
+      arg_types[0] = int8_ptr_type;
+      arg_types[1] = int32_type;
+      arg_types[2] = int8_ptr_type;
+      arg_types[3] = int32_type;
+      arg_types[4] = int32_type;
+      arg_types[5] = int32_type;
+      pack_ptr_type =
+         LLVMPointerType(LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                          arg_types, 6, 0), 0);
+      texel = lp_build_alloca(gallivm, LLVMArrayType(int32_type, 4), "texel");
+   }
+
+   get_image_coords(bld, inst, 0, coords);
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      values[chan] = lp_build_emit_fetch(bld_base, inst, 1, chan);
+      values[chan] = LLVMBuildBitCast(builder, values[chan],
+                                      uint_bld->vec_type, "");
+   }
+
+   num_units = get_image_units(bld, res->Register.Index,
+                               res->Register.Indirect, &res->Indirect,
+                               mask_vec(bld_base), units, masks);
+
+   for (i = 0; i < num_units; i++) {
+      LLVMValueRef mask = masks[i];
+      LLVMValueRef offsets, base, pack = NULL;
+
+      offsets = get_image_offsets(bld, units[i], coords, format, &mask);
+      base = bld->mem_iface->image_member(bld->mem_iface, gallivm, units[i],
+                                          LP_IMAGE_BASE);
+      if (!num_dwords) {
+         pack = bld->mem_iface->image_member(bld->mem_iface, gallivm,
+                                             units[i], LP_IMAGE_PACK);
+         pack = LLVMBuildBitCast(builder, pack, pack_ptr_type, "");
+      }
+
+      for (lane = 0; lane < uint_bld->type.length; lane++) {
+         struct lp_build_if_state ifthen;
+         LLVMValueRef lane_index = lp_build_const_int32(gallivm, lane);
+         LLVMValueRef ptr = begin_image_lane(bld, base, offsets, mask, lane,
+                                             &ifthen);
+
+         if (num_dwords) {
+            ptr = LLVMBuildBitCast(builder, ptr,
+                                   LLVMPointerType(int32_type, 0), "");
+            for (chan = 0; chan < num_dwords; chan++) {
+               LLVMValueRef chan_index = lp_build_const_int32(gallivm, chan);
+
+               LLVMBuildStore(builder,
+                              LLVMBuildExtractElement(builder, values[chan],
+                                                      lane_index, ""),
+                              LLVMBuildGEP(builder, ptr, &chan_index, 1, ""));
+            }
+         }
+         else {
+            LLVMValueRef args[6];
+
+            for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+               LLVMValueRef indices[2];
+
+               indices[0] = lp_build_const_int32(gallivm, 0);
+               indices[1] = lp_build_const_int32(gallivm, chan);
+               LLVMBuildStore(builder,
+                              LLVMBuildExtractElement(builder, values[chan],
+                                                      lane_index, ""),
+                              LLVMBuildGEP(builder, texel, indices, 2, ""));
+            }
+
+            args[0] = ptr;
+            args[1] = lp_build_const_int32(gallivm, 0);
+            args[2] = LLVMBuildBitCast(builder, texel, int8_ptr_type, "");
+            args[3] = lp_build_const_int32(gallivm, 0);
+            args[4] = lp_build_const_int32(gallivm, 1);
+            args[5] = lp_build_const_int32(gallivm, 1);
+            LLVMBuildCall(builder, pack, args, ARRAY_SIZE(args), "");
+         }
+
+         lp_build_endif(&ifthen);
+      }
+   }
+}
+
+static void
+image_resq_emit(struct lp_build_tgsi_soa_context *bld,
+                struct lp_build_emit_data *emit_data)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   unsigned target = inst->Memory.Texture;
+   LLVMValueRef units[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef masks[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef sizes[TGSI_NUM_CHANNELS];
+   unsigned num_units, i, chan;
+
+   num_units = get_image_units(bld, res->Register.Index,
+                               res->Register.Indirect, &res->Indirect,
+                               mask_vec(bld_base), units, masks);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      sizes[chan] = uint_bld->zero;
+
+   for (i = 0; i < num_units; i++) {
+      LLVMValueRef width, height, depth;
+      LLVMValueRef unit_sizes[TGSI_NUM_CHANNELS];
+
+      width = get_image_member_vec(bld, units[i], LP_IMAGE_WIDTH);
+      height = get_image_member_vec(bld, units[i], LP_IMAGE_HEIGHT);
+      depth = get_image_member_vec(bld, units[i], LP_IMAGE_DEPTH);
+
+      unit_sizes[0] = width;
+      unit_sizes[1] = uint_bld->zero;
+      unit_sizes[2] = uint_bld->zero;
+      unit_sizes[3] = uint_bld->zero;
+
+      switch (target) {
+      case TGSI_TEXTURE_1D_ARRAY:
+         unit_sizes[1] = depth;
+         break;
+      case TGSI_TEXTURE_2D:
+      case TGSI_TEXTURE_RECT:
+      case TGSI_TEXTURE_CUBE:
+      case TGSI_TEXTURE_2D_MSAA:
+         unit_sizes[1] = height;
+         break;
+      case TGSI_TEXTURE_2D_ARRAY:
+      case TGSI_TEXTURE_3D:
+      case TGSI_TEXTURE_2D_ARRAY_MSAA:
+         unit_sizes[1] = height;
+         unit_sizes[2] = depth;
+         break;
+      case TGSI_TEXTURE_CUBE_ARRAY:
+         unit_sizes[1] = height;
+         unit_sizes[2] = lp_build_div(uint_bld, depth,
+                                      lp_build_const_int_vec(gallivm,
+                                                             uint_bld->type,
+                                                             6));
+         break;
+      default:
+         break;
+      }
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+         sizes[chan] = lp_build_select(uint_bld, masks[i],
+                                       unit_sizes[chan], sizes[chan]);
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      emit_data->output[chan] = sizes[chan];
+}
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   unsigned writemask = inst->Dst[0].Register.WriteMask;
+   LLVMValueRef index_vec, offset_vec, exec_mask;
+   LLVMValueRef results[TGSI_NUM_CHANNELS];
+   unsigned chan, lane, num_chans;
+
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      image_load_emit(bld, emit_data);
+      return;
+   }
+
+   index_vec = get_mem_index_vec(bld, res->Register.File, res->Register.Index,
+                                 res->Register.Indirect, &res->Indirect);
+   offset_vec = lp_build_emit_fetch(bld_base, inst, 1, TGSI_CHAN_X);
+   offset_vec = LLVMBuildBitCast(builder, offset_vec, uint_bld->vec_type, "");
+   exec_mask = mask_vec(bld_base);
+
+   num_chans = util_last_bit(writemask);
+   for (chan = 0; chan < num_chans; chan++) {
+      results[chan] = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+      LLVMBuildStore(builder, uint_bld->zero, results[chan]);
+   }
+
+   for (lane = 0; lane < uint_bld->type.length; lane++) {
+      struct lp_build_if_state ifthen;
+      LLVMValueRef ptr = begin_mem_lane(bld, res->Register.File, index_vec,
+                                        offset_vec, exec_mask, lane,
+                                        num_chans * 4, &ifthen);
+
+      for (chan = 0; chan < num_chans; chan++) {
+         LLVMValueRef chan_index, chan_ptr, value;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         chan_index = lp_build_const_int32(gallivm, chan);
+         chan_ptr = LLVMBuildGEP(builder, ptr, &chan_index, 1, "");
+         value = LLVMBuildLoad(builder, chan_ptr, "");
+         store_mem_lane_result(bld, results[chan], lane, value);
+      }
+
+      lp_build_endif(&ifthen);
+   }
+
+   for (chan = 0; chan < num_chans; chan++) {
+      if (writemask & (1 << chan))
+         emit_data->output[chan] = LLVMBuildLoad(builder, results[chan], "");
+   }
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_dst_register *res = &inst->Dst[0];
+   unsigned writemask = res->Register.WriteMask;
+   LLVMValueRef index_vec, offset_vec, exec_mask;
+   LLVMValueRef values[TGSI_NUM_CHANNELS];
+   unsigned chan, lane, num_chans;
+
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      image_store_emit(bld, emit_data);
+      return;
+   }
+
+   index_vec = get_mem_index_vec(bld, res->Register.File, res->Register.Index,
+                                 res->Register.Indirect, &res->Indirect);
+   offset_vec = lp_build_emit_fetch(bld_base, inst, 0, TGSI_CHAN_X);
+   offset_vec = LLVMBuildBitCast(builder, offset_vec, uint_bld->vec_type, "");
+   exec_mask = mask_vec(bld_base);
+
+   num_chans = util_last_bit(writemask);
+   for (chan = 0; chan < num_chans; chan++) {
+      if (!(writemask & (1 << chan)))
+         continue;
+      values[chan] = lp_build_emit_fetch(bld_base, inst, 1, chan);
+      values[chan] = LLVMBuildBitCast(builder, values[chan],
+                                      uint_bld->vec_type, "");
+   }
+
+   for (lane = 0; lane < uint_bld->type.length; lane++) {
+      struct lp_build_if_state ifthen;
+      LLVMValueRef lane_index = lp_build_const_int32(gallivm, lane);
+      LLVMValueRef ptr = begin_mem_lane(bld, res->Register.File, index_vec,
+                                        offset_vec, exec_mask, lane,
+                                        num_chans * 4, &ifthen);
+
+      for (chan = 0; chan < num_chans; chan++) {
+         LLVMValueRef chan_index, chan_ptr, value;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         chan_index = lp_build_const_int32(gallivm, chan);
+         chan_ptr = LLVMBuildGEP(builder, ptr, &chan_index, 1, "");
+         value = LLVMBuildExtractElement(builder, values[chan], lane_index, "");
+         LLVMBuildStore(builder, value, chan_ptr);
+      }
+
+      lp_build_endif(&ifthen);
+   }
+}
+
+/**
+ * Do the atomic operation of 'opcode' on the dword at 'ptr' and return its
+ * previous value.
+ */
+static LLVMValueRef
+emit_atomic_lane(struct lp_build_tgsi_soa_context *bld,
+                 unsigned opcode,
+                 LLVMAtomicRMWBinOp op,
+                 LLVMValueRef ptr,
+                 LLVMValueRef value,
+                 LLVMValueRef cmp)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   LLVMValueRef old;
+
+   if (opcode == TGSI_OPCODE_ATOMCAS) {
+#if HAVE_LLVM >= 0x0309
+      old = LLVMBuildAtomicCmpXchg(builder, ptr, cmp, value,
+                                   LLVMAtomicOrderingSequentiallyConsistent,
+                                   LLVMAtomicOrderingSequentiallyConsistent,
+                                   FALSE);
+      old = LLVMBuildExtractValue(builder, old, 0, "");
+#else
+      assert(0);
+      old = LLVMBuildLoad(builder, ptr, "");
+#endif
+   }
+   else {
+      old = LLVMBuildAtomicRMW(builder, op, ptr, value,
+                               LLVMAtomicOrderingSequentiallyConsistent,
+                               FALSE);
+   }
+
+   return old;
+}
+
+/**
+ * Image atomics operate on single dword texels, of integer formats but
+ * for exchanges which can be done on floats as well.
+ */
+static void
+image_atomic_emit(struct lp_build_tgsi_soa_context *bld,
+                  struct lp_build_emit_data *emit_data,
+                  LLVMAtomicRMWBinOp op,
+                  LLVMValueRef value_vec,
+                  LLVMValueRef cmp_vec,
+                  LLVMValueRef result)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   unsigned opcode = inst->Instruction.Opcode;
+   enum pipe_format format = inst->Memory.Format;
+   LLVMValueRef units[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef masks[LP_MAX_TGSI_SHADER_IMAGES];
+   LLVMValueRef coords[3];
+   unsigned num_units, i, lane;
+
+   if (!image_target_supported(inst->Memory.Texture))
+      return;
+
+   if (format != PIPE_FORMAT_R32_UINT &&
+       format != PIPE_FORMAT_R32_SINT &&
+       !(format == PIPE_FORMAT_R32_FLOAT &&
+         opcode == TGSI_OPCODE_ATOMXCHG))
+      return;
+
+   get_image_coords(bld, inst, 1, coords);
+   num_units = get_image_units(bld, res->Register.Index,
+                               res->Register.Indirect, &res->Indirect,
+                               mask_vec(bld_base), units, masks);
+
+   for (i = 0; i < num_units; i++) {
+      LLVMValueRef mask = masks[i];
+      LLVMValueRef offsets, base;
+
+      offsets = get_image_offsets(bld, units[i], coords, format, &mask);
+      base = bld->mem_iface->image_member(bld->mem_iface, gallivm, units[i],
+                                          LP_IMAGE_BASE);
+
+      for (lane = 0; lane < uint_bld->type.length; lane++) {
+         struct lp_build_if_state ifthen;
+         LLVMValueRef lane_index = lp_build_const_int32(gallivm, lane);
+         LLVMValueRef ptr = begin_image_lane(bld, base, offsets, mask, lane,
+                                             &ifthen);
+         LLVMValueRef value, cmp = NULL, old;
+
+         ptr = LLVMBuildBitCast(builder, ptr,
+                                LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0),
+                                "");
+         value = LLVMBuildExtractElement(builder, value_vec, lane_index, "");
+         if (cmp_vec)
+            cmp = LLVMBuildExtractElement(builder, cmp_vec, lane_index, "");
+
+         old = emit_atomic_lane(bld, opcode, op, ptr, value, cmp);
+         store_mem_lane_result(bld, result, lane, old);
+
+         lp_build_endif(&ifthen);
+      }
+   }
+}
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   unsigned opcode = inst->Instruction.Opcode;
+   LLVMAtomicRMWBinOp op = LLVMAtomicRMWBinOpAdd;
+   LLVMValueRef index_vec, offset_vec, exec_mask, value_vec, cmp_vec = NULL;
+   LLVMValueRef result;
+   unsigned lane, chan;
+
+   switch (opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   case TGSI_OPCODE_ATOMCAS:
+      break;
+   default:
+      assert(0);
+      break;
+   }
+
+   value_vec = lp_build_emit_fetch(bld_base, inst, 2, TGSI_CHAN_X);
+   value_vec = LLVMBuildBitCast(builder, value_vec, uint_bld->vec_type, "");
+   if (opcode == TGSI_OPCODE_ATOMCAS) {
+      /* src2 is the compare value, src3 the new value */
+      cmp_vec = value_vec;
+      value_vec = lp_build_emit_fetch(bld_base, inst, 3, TGSI_CHAN_X);
+      value_vec = LLVMBuildBitCast(builder, value_vec, uint_bld->vec_type, "");
+   }
+
+   result = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+   LLVMBuildStore(builder, uint_bld->zero, result);
+
+   /*
+    * Every active lane does its own operation on the x channel of the
+    * texel or dword it addresses, the previous value is returned in all
+    * the channels.
+    */
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      image_atomic_emit(bld, emit_data, op, value_vec, cmp_vec, result);
+   }
+   else {
+      index_vec = get_mem_index_vec(bld, res->Register.File,
+                                    res->Register.Index,
+                                    res->Register.Indirect, &res->Indirect);
+      offset_vec = lp_build_emit_fetch(bld_base, inst, 1, TGSI_CHAN_X);
+      offset_vec = LLVMBuildBitCast(builder, offset_vec,
+                                    uint_bld->vec_type, "");
+      exec_mask = mask_vec(bld_base);
+
+      for (lane = 0; lane < uint_bld->type.length; lane++) {
+         struct lp_build_if_state ifthen;
+         LLVMValueRef lane_index = lp_build_const_int32(gallivm, lane);
+         LLVMValueRef ptr = begin_mem_lane(bld, res->Register.File,
+                                           index_vec, offset_vec, exec_mask,
+                                           lane, 4, &ifthen);
+         LLVMValueRef value, cmp = NULL, old;
+
+         value = LLVMBuildExtractElement(builder, value_vec, lane_index, "");
+         if (cmp_vec)
+            cmp = LLVMBuildExtractElement(builder, cmp_vec, lane_index, "");
+
+         old = emit_atomic_lane(bld, opcode, op, ptr, value, cmp);
+         store_mem_lane_result(bld, result, lane, old);
+
+         lp_build_endif(&ifthen);
+      }
+   }
+
+   result = LLVMBuildLoad(builder, result, "");
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      emit_data->output[chan] = result;
+}
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   LLVMValueRef index_vec, result;
+   unsigned lane, chan;
+
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      image_resq_emit(bld, emit_data);
+      return;
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      emit_data->output[chan] = uint_bld->zero;
+
+   if (res->Register.File != TGSI_FILE_BUFFER)
+      return;
+
+   index_vec = get_mem_index_vec(bld, res->Register.File, res->Register.Index,
+                                 res->Register.Indirect, &res->Indirect);
+
+   result = uint_bld->undef;
+   for (lane = 0; lane < uint_bld->type.length; lane++) {
+      LLVMValueRef base, size;
+
+      get_mem_lane_base(bld, res->Register.File, index_vec, lane,
+                        &base, &size);
+      result = LLVMBuildInsertElement(builder, result, size,
+                                      lp_build_const_int32(gallivm, lane), "");
+   }
+
+   emit_data->output[0] = result;
+}
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+
+   if (bld->mem_iface->emit_barrier)
+      bld->mem_iface->emit_barrier(bld->mem_iface, bld_base);
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   /* Invocations may run on different threads, keep the memory accesses
+    * on either side of the barrier in order.
+    */
+   LLVMBuildFence(bld_base->base.gallivm->builder,
+                  LLVMAtomicOrderingSequentiallyConsistent, FALSE, "");
+}
+
+static void emit_prologue(struct lp_build_tgsi_context * bld_base)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state * gallivm = bld_base->base.gallivm;
+
+   if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
+      LLVMValueRef array_size =
+         lp_build_const_int32(gallivm,
+                         bld_base->info->file_max[TGSI_FILE_TEMPORARY] * 4 + 4);
+      bld->temps_array = lp_build_array_alloca(gallivm,
+                                              bld_base->base.vec_type, array_size,
+                                              "temp_array");
+   }
+
+   if (bld->indirect_files & (1 << TGSI_FILE_OUTPUT) &&
+       !outputs_in_memory(bld)) {
+      LLVMValueRef array_size =
+         lp_build_const_int32(gallivm,
+                            bld_base->info->file_max[TGSI_FILE_OUTPUT] * 4 + 4);
+      bld->outputs_array = lp_build_array_alloca(gallivm,
+                                                bld_base->base.vec_type, array_size,
+                                                "output_array");
+   }
+
+   if (bld->indirect_files & (1 << TGSI_FILE_IMMEDIATE)) {
+      LLVMValueRef array_size =
+         lp_build_const_int32(gallivm,
+                         bld_base->info->file_max[TGSI_FILE_IMMEDIATE] * 4 + 4);
+      bld->imms_array = lp_build_array_alloca(gallivm,
+                                              bld_base->base.vec_type, array_size,
+                                              "imms_array");
+   }
+
+   /* If we have indirect addressing in inputs we need to copy them into
+    * our alloca array to be able to iterate over them */
+   if (bld->indirect_files & (1 << TGSI_FILE_INPUT) &&
+       !bld->gs_iface && !bld->tess_iface) {
+      unsigned index, chan;
+      LLVMTypeRef vec_type = bld_base->base.vec_type;
+      LLVMValueRef array_size = lp_build_const_int32(gallivm,
+            bld_base->info->file_max[TGSI_FILE_INPUT]*4 + 4);
+      bld->inputs_array = lp_build_array_alloca(gallivm,
+                                               vec_type, array_size,
+                                               "input_array");
+
+      assert(bld_base->info->num_inputs
+                        <= bld_base->info->file_max[TGSI_FILE_INPUT] + 1);
+
+      for (index = 0; index < bld_base->info->num_inputs; ++index) {
+         for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+            LLVMValueRef lindex =
+               lp_build_const_int32(gallivm, index * 4 + chan);
+            LLVMValueRef input_ptr =
+               LLVMBuildGEP(gallivm->builder, bld->inputs_array,
+                            &lindex, 1, "");
+            LLVMValueRef value = bld->inputs[index][chan];
+            if (value)
+               LLVMBuildStore(gallivm->builder, value, input_ptr);
+         }
+      }
+   }
+
+   if (bld->gs_iface) {
+      struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+      bld->emitted_prims_vec_ptr =
+         lp_build_alloca(gallivm,
+                         uint_bld->vec_type,
+                         "emitted_prims_ptr");
+      bld->emitted_vertices_vec_ptr =
+         lp_build_alloca(gallivm,
                          uint_bld->vec_type,
                          "emitted_vertices_ptr");
       bld->total_emitted_vertices_vec_ptr =
@@ -3725,11 +5006,112 @@ static void emit_prologue(struct lp_build_tgsi_context * bld_base)
    if (DEBUG_EXECUTION) {
       lp_build_printf(gallivm, "\n");
       emit_dump_file(bld, TGSI_FILE_CONSTANT);
-      if (!bld->gs_iface)
+      if (!bld->gs_iface && !bld->tess_iface)
          emit_dump_file(bld, TGSI_FILE_INPUT);
    }
 }
 
+/**
+ * Save or restore the temporary and address registers of a control
+ * shader with barriers, see lp_build_tgsi_tess_iface.
+ */
+static void
+emit_phase_temps(struct lp_build_tgsi_soa_context *bld, boolean save)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_shader_info *info = bld->bld_base.info;
+   const int num_temps = info->file_max[TGSI_FILE_TEMPORARY] + 1;
+   const int num_regs = num_temps + info->file_max[TGSI_FILE_ADDRESS] + 1;
+   int index;
+   unsigned chan;
+
+   for (index = 0; index < num_regs; index++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         LLVMValueRef reg_ptr, slot_ptr, lindex;
+
+         if (index < num_temps)
+            reg_ptr = get_file_ptr(bld, TGSI_FILE_TEMPORARY, index, chan);
+         else
+            reg_ptr = bld->addr[index - num_temps][chan];
+         if (!reg_ptr)
+            continue;
+
+         lindex = lp_build_const_int32(gallivm, index * 4 + chan);
+         slot_ptr = LLVMBuildGEP(builder, bld->tess_iface->temps_ptr,
+                                 &lindex, 1, "");
+         /* address registers are integers */
+         slot_ptr = LLVMBuildBitCast(builder, slot_ptr,
+                                     LLVMTypeOf(reg_ptr), "");
+
+         if (save)
+            LLVMBuildStore(builder, LLVMBuildLoad(builder, reg_ptr, ""),
+                           slot_ptr);
+         else
+            LLVMBuildStore(builder, LLVMBuildLoad(builder, slot_ptr, ""),
+                           reg_ptr);
+      }
+   }
+}
+
+/**
+ * Jump to the phase of a control shader with barriers the caller asked
+ * for.  Phase 0 starts with the first instruction, each top level
+ * barrier adds a case.
+ */
+static void emit_prologue_post_decl(struct lp_build_tgsi_context * bld_base)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state * gallivm = bld_base->base.gallivm;
+   LLVMBasicBlockRef phase_block;
+
+   if (!bld->tess_iface || !bld->tess_iface->phase)
+      return;
+
+   phase_block = lp_build_insert_new_block(gallivm, "phase");
+   bld->phase_end_block = lp_build_insert_new_block(gallivm, "phase_end");
+   bld->phase_switch =
+      LLVMBuildSwitch(gallivm->builder, bld->tess_iface->phase,
+                      bld->phase_end_block,
+                      bld_base->info->opcode_count[TGSI_OPCODE_BARRIER] + 1);
+   LLVMAddCase(bld->phase_switch, lp_build_const_int32(gallivm, 0),
+               phase_block);
+   bld->num_phases = 1;
+
+   LLVMPositionBuilderAtEnd(gallivm->builder, phase_block);
+}
+
+/**
+ * Barrier of a tessellation control shader: end the current phase and
+ * start the next one, which the caller runs once all the invocations of
+ * the patch are done with this one.  Barriers can't be in flow control
+ * in control shaders, there's nothing to split there.
+ */
+static void
+tess_barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state * gallivm = bld_base->base.gallivm;
+   LLVMBasicBlockRef phase_block;
+
+   if (!bld->phase_switch || bld->exec_mask.has_mask)
+      return;
+
+   emit_phase_temps(bld, TRUE);
+   LLVMBuildBr(gallivm->builder, bld->phase_end_block);
+
+   phase_block = lp_build_insert_new_block(gallivm, "phase");
+   LLVMAddCase(bld->phase_switch,
+               lp_build_const_int32(gallivm, bld->num_phases++),
+               phase_block);
+   LLVMPositionBuilderAtEnd(gallivm->builder, phase_block);
+
+   emit_phase_temps(bld, FALSE);
+}
+
 static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
 {
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
@@ -3763,6 +5145,12 @@ static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
                                  &bld->bld_base,
                                  total_emitted_vertices_vec,
                                  emitted_prims_vec);
+   } else if (outputs_in_memory(bld)) {
+      /* the outputs have been stored already, just end the last phase */
+      if (bld->phase_end_block) {
+         LLVMBuildBr(builder, bld->phase_end_block);
+         LLVMPositionBuilderAtEnd(builder, bld->phase_end_block);
+      }
    } else {
       gather_outputs(bld);
    }
@@ -3782,7 +5170,9 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_mem_iface *mem_iface,
+                  const struct lp_build_tgsi_tess_iface *tess_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3862,6 +5252,7 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
    bld.bld_base.emit_immediate = lp_emit_immediate_soa;
 
    bld.bld_base.emit_prologue = emit_prologue;
+   bld.bld_base.emit_prologue_post_decl = emit_prologue_post_decl;
    bld.bld_base.emit_epilogue = emit_epilogue;
 
    /* Set opcode actions */
@@ -3938,6 +5329,36 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (mem_iface) {
+      bld.mem_iface = mem_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+   }
+
+   if (tess_iface) {
+      /* inputs are always indirect with tessellation shaders */
+      bld.indirect_files |= (1 << TGSI_FILE_INPUT);
+      bld.tess_iface = tess_iface;
+      bld.bld_base.emit_fetch_funcs[TGSI_FILE_INPUT] = emit_fetch_tess;
+      if (tess_iface->store_output) {
+         bld.bld_base.emit_fetch_funcs[TGSI_FILE_OUTPUT] = emit_fetch_tess;
+         bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = tess_barrier_emit;
+      }
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
@@ -3961,3 +5382,14 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
    }
    lp_exec_mask_fini(&bld.exec_mask);
 }
+
+
+/**
+ * Number of vectors lp_build_tgsi_tess_iface::temps_ptr must point to.
+ */
+unsigned
+lp_build_tgsi_tess_temps_size(const struct tgsi_shader_info *info)
+{
+   return (info->file_max[TGSI_FILE_TEMPORARY] + 1 +
+           info->file_max[TGSI_FILE_ADDRESS] + 1) * TGSI_NUM_CHANNELS;
+}
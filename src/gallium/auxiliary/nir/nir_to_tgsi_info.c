@@ -0,0 +1,323 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Build a tgsi_shader_info describing a NIR shader, the NIR counterpart of
+ * tgsi_scan_shader().
+ */
+
+#include "compiler/nir/nir.h"
+#include "compiler/nir_types.h"
+#include "tgsi/tgsi_from_mesa.h"
+#include "util/u_math.h"
+
+#include "nir_to_tgsi_info.h"
+
+
+static unsigned
+var_slots(const nir_variable *var)
+{
+   return glsl_count_attribute_slots(var->type, false);
+}
+
+
+static unsigned
+tgsi_interpolate(const nir_variable *var, unsigned semantic_name)
+{
+   switch (semantic_name) {
+   case TGSI_SEMANTIC_POSITION:
+      return TGSI_INTERPOLATE_LINEAR;
+   case TGSI_SEMANTIC_FACE:
+   case TGSI_SEMANTIC_PRIMID:
+      return TGSI_INTERPOLATE_CONSTANT;
+   default:
+      break;
+   }
+
+   switch (var->data.interpolation) {
+   case INTERP_MODE_FLAT:
+      return TGSI_INTERPOLATE_CONSTANT;
+   case INTERP_MODE_NOPERSPECTIVE:
+      return TGSI_INTERPOLATE_LINEAR;
+   case INTERP_MODE_SMOOTH:
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   case INTERP_MODE_NONE:
+   default:
+      /* glShadeModel() controls unqualified colors */
+      if (semantic_name == TGSI_SEMANTIC_COLOR ||
+          semantic_name == TGSI_SEMANTIC_BCOLOR)
+         return TGSI_INTERPOLATE_COLOR;
+      return TGSI_INTERPOLATE_PERSPECTIVE;
+   }
+}
+
+
+static void
+scan_intrinsic(const nir_intrinsic_instr *instr,
+               struct tgsi_shader_info *info)
+{
+   switch (instr->intrinsic) {
+   case nir_intrinsic_load_input: {
+      nir_const_value *offset = nir_src_as_const_value(instr->src[0]);
+      unsigned index = nir_intrinsic_base(instr) + (offset ? offset->u32[0] : 0);
+      unsigned mask = ((1u << instr->num_components) - 1) <<
+                      nir_intrinsic_component(instr);
+
+      if (index < PIPE_MAX_SHADER_INPUTS) {
+         /* indirect access may touch every slot of the array */
+         if (!offset)
+            mask = TGSI_WRITEMASK_XYZW;
+         info->input_usage_mask[index] |= mask;
+      }
+      break;
+   }
+   case nir_intrinsic_store_output: {
+      nir_const_value *offset = nir_src_as_const_value(instr->src[1]);
+      unsigned index = nir_intrinsic_base(instr) + (offset ? offset->u32[0] : 0);
+
+      if (index < PIPE_MAX_SHADER_OUTPUTS)
+         info->output_usagemask[index] |=
+            nir_intrinsic_write_mask(instr) << nir_intrinsic_component(instr);
+      break;
+   }
+   case nir_intrinsic_discard:
+   case nir_intrinsic_discard_if:
+      info->uses_kill = TRUE;
+      break;
+   case nir_intrinsic_load_primitive_id:
+      info->uses_primid = TRUE;
+      break;
+   case nir_intrinsic_load_instance_id:
+      info->uses_instanceid = TRUE;
+      break;
+   case nir_intrinsic_load_vertex_id:
+      info->uses_vertexid = TRUE;
+      break;
+   case nir_intrinsic_load_base_vertex:
+      info->uses_basevertex = TRUE;
+      break;
+   case nir_intrinsic_load_invocation_id:
+      info->uses_invocationid = TRUE;
+      break;
+   default:
+      break;
+   }
+}
+
+
+static void
+scan_tex(const nir_tex_instr *instr, struct tgsi_shader_info *info)
+{
+   unsigned unit = instr->texture_index;
+
+   info->num_memory_instructions++;
+
+   if (unit < PIPE_MAX_SAMPLERS) {
+      info->file_mask[TGSI_FILE_SAMPLER] |= 1u << unit;
+      info->file_max[TGSI_FILE_SAMPLER] =
+         MAX2(info->file_max[TGSI_FILE_SAMPLER], (int)unit);
+      info->samplers_declared |= 1u << unit;
+      if (instr->sampler_dim == GLSL_SAMPLER_DIM_MS)
+         info->is_msaa_sampler[unit] = TRUE;
+   }
+
+   if (instr->op == nir_texop_txd || instr->op == nir_texop_tex ||
+       instr->op == nir_texop_txb || instr->op == nir_texop_lod)
+      info->uses_derivatives = TRUE;
+}
+
+
+void
+nir_tgsi_scan_shader(const struct nir_shader *nir,
+                     struct tgsi_shader_info *info,
+                     bool needs_texcoord_semantic)
+{
+   unsigned i;
+
+   memset(info, 0, sizeof(*info));
+   for (i = 0; i < TGSI_FILE_COUNT; i++)
+      info->file_max[i] = -1;
+   for (i = 0; i < ARRAY_SIZE(info->const_file_max); i++)
+      info->const_file_max[i] = -1;
+
+   info->processor = pipe_shader_type_from_mesa(nir->info.stage);
+
+   nir_foreach_variable(var, &nir->inputs) {
+      unsigned slots = var_slots(var);
+
+      for (i = 0; i < slots; i++) {
+         unsigned index = var->data.driver_location + i;
+         unsigned semantic_name, semantic_index;
+
+         if (index >= PIPE_MAX_SHADER_INPUTS)
+            break;
+
+         if (nir->info.stage == MESA_SHADER_VERTEX) {
+            semantic_name = TGSI_SEMANTIC_GENERIC;
+            semantic_index = var->data.location - VERT_ATTRIB_GENERIC0 + i;
+         }
+         else {
+            tgsi_get_gl_varying_semantic(var->data.location + i,
+                                         needs_texcoord_semantic,
+                                         &semantic_name, &semantic_index);
+         }
+
+         info->input_semantic_name[index] = semantic_name;
+         info->input_semantic_index[index] = semantic_index;
+         info->input_interpolate[index] = tgsi_interpolate(var, semantic_name);
+         info->input_interpolate_loc[index] =
+            var->data.sample ? TGSI_INTERPOLATE_LOC_SAMPLE :
+            var->data.centroid ? TGSI_INTERPOLATE_LOC_CENTROID :
+            TGSI_INTERPOLATE_LOC_CENTER;
+         info->input_cylindrical_wrap[index] = 0;
+
+         switch (semantic_name) {
+         case TGSI_SEMANTIC_POSITION:
+            info->reads_position = TRUE;
+            break;
+         case TGSI_SEMANTIC_FACE:
+            info->uses_frontface = TRUE;
+            break;
+         case TGSI_SEMANTIC_PRIMID:
+            info->uses_primid = TRUE;
+            break;
+         case TGSI_SEMANTIC_COLOR:
+            info->colors_read |= 0xf << (semantic_index * 4);
+            break;
+         default:
+            break;
+         }
+
+         info->num_inputs = MAX2(info->num_inputs, index + 1);
+         info->file_mask[TGSI_FILE_INPUT] |= 1u << index;
+         info->file_max[TGSI_FILE_INPUT] =
+            MAX2(info->file_max[TGSI_FILE_INPUT], (int)index);
+      }
+   }
+
+   nir_foreach_variable(var, &nir->outputs) {
+      unsigned slots = var_slots(var);
+
+      for (i = 0; i < slots; i++) {
+         unsigned index = var->data.driver_location + i;
+         unsigned semantic_name, semantic_index;
+
+         if (index >= PIPE_MAX_SHADER_OUTPUTS)
+            break;
+
+         if (nir->info.stage == MESA_SHADER_FRAGMENT) {
+            tgsi_get_gl_frag_result_semantic(var->data.location + i,
+                                             &semantic_name, &semantic_index);
+            /* the second source for dual source blending */
+            semantic_index += var->data.index;
+
+            switch (var->data.location) {
+            case FRAG_RESULT_DEPTH:
+               info->writes_z = TRUE;
+               break;
+            case FRAG_RESULT_STENCIL:
+               info->writes_stencil = TRUE;
+               break;
+            case FRAG_RESULT_SAMPLE_MASK:
+               info->writes_samplemask = TRUE;
+               break;
+            case FRAG_RESULT_COLOR:
+               info->properties[TGSI_PROPERTY_FS_COLOR0_WRITES_ALL_CBUFS] = 1;
+               /* fallthrough */
+            default:
+               info->colors_written |= 1 << semantic_index;
+               break;
+            }
+         }
+         else {
+            tgsi_get_gl_varying_semantic(var->data.location + i,
+                                         needs_texcoord_semantic,
+                                         &semantic_name, &semantic_index);
+         }
+
+         info->output_semantic_name[index] = semantic_name;
+         info->output_semantic_index[index] = semantic_index;
+
+         info->num_outputs = MAX2(info->num_outputs, index + 1);
+         info->file_mask[TGSI_FILE_OUTPUT] |= 1u << index;
+         info->file_max[TGSI_FILE_OUTPUT] =
+            MAX2(info->file_max[TGSI_FILE_OUTPUT], (int)index);
+      }
+   }
+
+   if (nir->info.stage == MESA_SHADER_FRAGMENT &&
+       nir->info.fs.early_fragment_tests)
+      info->properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL] = 1;
+
+   nir_foreach_function(func, nir) {
+      if (!func->impl)
+         continue;
+
+      nir_foreach_block(block, func->impl) {
+         nir_foreach_instr(instr, block) {
+            switch (instr->type) {
+            case nir_instr_type_intrinsic:
+               scan_intrinsic(nir_instr_as_intrinsic(instr), info);
+               break;
+            case nir_instr_type_tex:
+               scan_tex(nir_instr_as_tex(instr), info);
+               break;
+            case nir_instr_type_alu:
+               switch (nir_instr_as_alu(instr)->op) {
+               case nir_op_fddx:
+               case nir_op_fddy:
+               case nir_op_fddx_fine:
+               case nir_op_fddy_fine:
+               case nir_op_fddx_coarse:
+               case nir_op_fddy_coarse:
+                  info->uses_derivatives = TRUE;
+                  break;
+               default:
+                  break;
+               }
+               break;
+            default:
+               break;
+            }
+            info->num_instructions++;
+         }
+      }
+   }
+
+   /*
+    * Texturing in NIR always uses the same unit for the sampler and the
+    * view, like the TGSI TEX opcodes, so there are no SVIEW declarations.
+    */
+   info->file_count[TGSI_FILE_SAMPLER] =
+      util_bitcount(info->file_mask[TGSI_FILE_SAMPLER]);
+   info->file_count[TGSI_FILE_INPUT] =
+      util_bitcount(info->file_mask[TGSI_FILE_INPUT]);
+   info->file_count[TGSI_FILE_OUTPUT] =
+      util_bitcount(info->file_mask[TGSI_FILE_OUTPUT]);
+
+   /*
+    * There are no tokens, but drivers use num_tokens <= 1 to detect a
+    * missing (null) shader, which a NIR shader never is.
+    */
+   info->num_tokens = info->num_instructions + 2;
+}
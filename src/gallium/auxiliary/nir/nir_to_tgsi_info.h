@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef _NIR_TO_TGSI_INFO_H_
+#define _NIR_TO_TGSI_INFO_H_
+
+#include "tgsi/tgsi_scan.h"
+
+struct nir_shader;
+
+/*
+ * Fill in a tgsi_shader_info from a NIR shader, so that drivers consuming
+ * NIR can keep using the TGSI based summary for their state setup.
+ *
+ * The shader is expected to have gone through nir_lower_io with
+ * driver_location assigned to its inputs and outputs; input/output indices
+ * in the info are driver_locations.  Only the fields drivers look at for
+ * the vertex layout, sampler usage and fragment side effects are filled in.
+ */
+void
+nir_tgsi_scan_shader(const struct nir_shader *nir,
+                     struct tgsi_shader_info *info,
+                     bool needs_texcoord_semantic);
+
+#endif /* _NIR_TO_TGSI_INFO_H_ */
@@ -1085,6 +1085,206 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+/**
+ * Kinds of pre-decoded instructions.  Everything but the most common
+ * arithmetic opcodes goes through exec_instruction().
+ */
+enum tgsi_exec_op_kind {
+   TGSI_EXEC_OP_SLOW,
+   TGSI_EXEC_OP_MOV,
+   TGSI_EXEC_OP_ADD,
+   TGSI_EXEC_OP_MUL,
+   TGSI_EXEC_OP_MAD,
+   TGSI_EXEC_OP_MIN,
+   TGSI_EXEC_OP_MAX,
+   TGSI_EXEC_OP_DP3,
+   TGSI_EXEC_OP_DP4,
+   TGSI_EXEC_OP_COUNT
+};
+
+/**
+ * A direct source operand with the register lookup already done.
+ * Constants are still looked up at run time since the buffers
+ * change between draws.
+ */
+struct tgsi_exec_op_src {
+   unsigned file;
+   const struct tgsi_exec_vector *vec;   /**< TEMPORARY, INPUT, SYSTEM_VALUE */
+   const float *imm;                     /**< IMMEDIATE */
+   unsigned buffer;                      /**< CONSTANT */
+   int index;                            /**< CONSTANT */
+   ubyte swizzle[TGSI_NUM_CHANNELS];
+   boolean absolute;
+   boolean negate;
+};
+
+struct tgsi_exec_op {
+   enum tgsi_exec_op_kind kind;
+   unsigned dst_file;                    /**< TEMPORARY or OUTPUT */
+   int dst_index;
+   unsigned write_mask;
+   boolean saturate;
+   struct tgsi_exec_op_src src[3];
+};
+
+
+static boolean
+predecode_src(const struct tgsi_exec_machine *mach,
+              const struct tgsi_full_src_register *reg,
+              struct tgsi_exec_op_src *src)
+{
+   const int index = reg->Register.Index;
+   uint chan;
+
+   if (reg->Register.Indirect)
+      return FALSE;
+   if (reg->Register.Dimension &&
+       (reg->Register.File != TGSI_FILE_CONSTANT ||
+        reg->Dimension.Indirect))
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      if (index >= TGSI_EXEC_NUM_TEMPS)
+         return FALSE;
+      src->vec = &mach->Temps[index];
+      break;
+   case TGSI_FILE_INPUT:
+      if (!mach->Inputs ||
+          mach->ShaderType == PIPE_SHADER_TESS_CTRL ||
+          mach->ShaderType == PIPE_SHADER_TESS_EVAL)
+         return FALSE;
+      src->vec = &mach->Inputs[index];
+      break;
+   case TGSI_FILE_SYSTEM_VALUE:
+      if (index >= TGSI_MAX_MISC_INPUTS)
+         return FALSE;
+      src->vec = &mach->SystemValue[index];
+      break;
+   case TGSI_FILE_IMMEDIATE:
+      if (index >= (int) mach->ImmLimit)
+         return FALSE;
+      src->imm = mach->Imms[index];
+      break;
+   case TGSI_FILE_CONSTANT:
+      src->buffer = reg->Register.Dimension ? reg->Dimension.Index : 0;
+      src->index = index;
+      if (src->buffer >= PIPE_MAX_CONSTANT_BUFFERS)
+         return FALSE;
+      break;
+   default:
+      return FALSE;
+   }
+
+   src->file = reg->Register.File;
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      src->swizzle[chan] = tgsi_util_get_full_src_register_swizzle(reg, chan);
+   src->absolute = reg->Register.Absolute;
+   src->negate = reg->Register.Negate;
+   return TRUE;
+}
+
+
+static boolean
+predecode_instruction(const struct tgsi_exec_machine *mach,
+                      const struct tgsi_full_instruction *inst,
+                      struct tgsi_exec_op *op)
+{
+   const struct tgsi_full_dst_register *dst = &inst->Dst[0];
+   uint i;
+
+   switch (inst->Instruction.Opcode) {
+   case TGSI_OPCODE_MOV:
+      op->kind = TGSI_EXEC_OP_MOV;
+      break;
+   case TGSI_OPCODE_ADD:
+      op->kind = TGSI_EXEC_OP_ADD;
+      break;
+   case TGSI_OPCODE_MUL:
+      op->kind = TGSI_EXEC_OP_MUL;
+      break;
+   case TGSI_OPCODE_MAD:
+      op->kind = TGSI_EXEC_OP_MAD;
+      break;
+   case TGSI_OPCODE_MIN:
+      op->kind = TGSI_EXEC_OP_MIN;
+      break;
+   case TGSI_OPCODE_MAX:
+      op->kind = TGSI_EXEC_OP_MAX;
+      break;
+   case TGSI_OPCODE_DP3:
+      op->kind = TGSI_EXEC_OP_DP3;
+      break;
+   case TGSI_OPCODE_DP4:
+      op->kind = TGSI_EXEC_OP_DP4;
+      break;
+   default:
+      return FALSE;
+   }
+
+   if (inst->Instruction.NumDstRegs != 1 ||
+       inst->Instruction.NumSrcRegs > ARRAY_SIZE(op->src))
+      return FALSE;
+
+   /* Only direct temporaries and outputs of the shader stages where
+    * output writes don't depend on the invocation.
+    */
+   if (dst->Register.Indirect || dst->Register.Dimension)
+      return FALSE;
+   switch (dst->Register.File) {
+   case TGSI_FILE_TEMPORARY:
+      if (dst->Register.Index >= TGSI_EXEC_NUM_TEMPS)
+         return FALSE;
+      break;
+   case TGSI_FILE_OUTPUT:
+      if (!mach->Outputs || mach->ShaderType == PIPE_SHADER_TESS_CTRL)
+         return FALSE;
+      break;
+   default:
+      return FALSE;
+   }
+   op->dst_file = dst->Register.File;
+   op->dst_index = dst->Register.Index;
+   op->write_mask = dst->Register.WriteMask;
+   op->saturate = inst->Instruction.Saturate;
+
+   for (i = 0; i < inst->Instruction.NumSrcRegs; i++) {
+      if (!predecode_src(mach, &inst->Src[i], &op->src[i]))
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Resolve the register files, swizzles and modifiers of the bound
+ * shader's instructions once, so that tgsi_exec_machine_run() doesn't
+ * need to walk the full instruction of the common arithmetic opcodes
+ * for every quad.  Must be called after the immediates are parsed.
+ */
+static struct tgsi_exec_op *
+predecode_instructions(const struct tgsi_exec_machine *mach)
+{
+   struct tgsi_exec_op *ops;
+   uint i;
+
+   if (!mach->NumInstructions)
+      return NULL;
+
+   ops = CALLOC(mach->NumInstructions, sizeof(struct tgsi_exec_op));
+   if (!ops)
+      return NULL;
+
+   for (i = 0; i < mach->NumInstructions; i++) {
+      if (!predecode_instruction(mach, &mach->Instructions[i], &ops[i]))
+         ops[i].kind = TGSI_EXEC_OP_SLOW;
+   }
+
+   return ops;
+}
+
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -1127,6 +1327,9 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      FREE(mach->Ops);
+      mach->Ops = NULL;
+
       return;
    }
 
@@ -1273,6 +1476,9 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   FREE(mach->Ops);
+   mach->Ops = predecode_instructions(mach);
 }
 
 
@@ -1292,7 +1498,21 @@ tgsi_exec_machine_create(enum pipe_shader_type shader_type)
    mach->Addrs = &mach->Temps[TGSI_EXEC_TEMP_ADDR];
    mach->MaxGeometryShaderOutputs = TGSI_MAX_TOTAL_VERTICES;
 
-   if (shader_type != PIPE_SHADER_COMPUTE) {
+   if (shader_type == PIPE_SHADER_TESS_CTRL ||
+       shader_type == PIPE_SHADER_TESS_EVAL) {
+      /* inputs of both are per patch vertex, as are the control outputs */
+      const unsigned size = sizeof(struct tgsi_exec_vector) *
+         TGSI_MAX_PATCH_VERTICES * TGSI_EXEC_TESS_ATTRIB_STRIDE;
+
+      mach->Inputs = align_malloc(size, 16);
+      if (shader_type == PIPE_SHADER_TESS_CTRL)
+         mach->Outputs = align_malloc(size, 16);
+      else
+         mach->Outputs = align_malloc(sizeof(struct tgsi_exec_vector) * PIPE_MAX_SHADER_OUTPUTS, 16);
+      if (!mach->Inputs || !mach->Outputs)
+         goto fail;
+   }
+   else if (shader_type != PIPE_SHADER_COMPUTE) {
       mach->Inputs = align_malloc(sizeof(struct tgsi_exec_vector) * PIPE_MAX_SHADER_INPUTS, 16);
       mach->Outputs = align_malloc(sizeof(struct tgsi_exec_vector) * PIPE_MAX_SHADER_OUTPUTS, 16);
       if (!mach->Inputs || !mach->Outputs)
@@ -1335,6 +1555,7 @@ void
 tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 {
    if (mach) {
+      FREE(mach->Ops);
       FREE(mach->Instructions);
       FREE(mach->Declarations);
 
@@ -1519,6 +1740,16 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_INPUT:
+      if (mach->ShaderType == PIPE_SHADER_TESS_CTRL ||
+          mach->ShaderType == PIPE_SHADER_TESS_EVAL) {
+         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+            int pos = index2D->i[i] * TGSI_EXEC_TESS_ATTRIB_STRIDE + index->i[i];
+            assert(pos >= 0);
+            assert(pos < TGSI_MAX_PATCH_VERTICES * TGSI_EXEC_TESS_ATTRIB_STRIDE);
+            chan->u[i] = mach->Inputs[pos].xyzw[swizzle].u[i];
+         }
+         break;
+      }
       for (i = 0; i < TGSI_QUAD_SIZE; i++) {
          /*
          if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
@@ -1572,10 +1803,15 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
    case TGSI_FILE_OUTPUT:
       /* vertex/fragment output vars can be read too */
       for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-         assert(index->i[i] >= 0);
-         assert(index2D->i[i] == 0);
+         int pos = index->i[i];
+
+         assert(pos >= 0);
+         if (mach->ShaderType == PIPE_SHADER_TESS_CTRL)
+            pos += index2D->i[i] * TGSI_EXEC_TESS_ATTRIB_STRIDE;
+         else
+            assert(index2D->i[i] == 0);
 
-         chan->u[i] = mach->Outputs[index->i[i]].xyzw[swizzle].u[i];
+         chan->u[i] = mach->Outputs[pos].xyzw[swizzle].u[i];
       }
       break;
 
@@ -1899,6 +2135,15 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
    case TGSI_FILE_OUTPUT:
       index = mach->Temps[TEMP_OUTPUT_I].xyzw[TEMP_OUTPUT_C].u[0]
          + reg->Register.Index;
+      if (mach->ShaderType == PIPE_SHADER_TESS_CTRL) {
+         /* All the channels of a control shader run the same invocation,
+          * each one for its own patch, so the vertex index is uniform;
+          * take it from any enabled channel.
+          */
+         const uint execmask = mach->ExecMask;
+         index += index2D.i[execmask ? ffs(execmask) - 1 : 0] *
+                  TGSI_EXEC_TESS_ATTRIB_STRIDE;
+      }
       dst = &mach->Outputs[offset + index].xyzw[chan_index];
 #if 0
       debug_printf("NumOutputs = %d, TEMP_O_C/I = %d, redindex = %d\n",
@@ -1956,24 +2201,18 @@ store_dest_double(struct tgsi_exec_machine *mach,
          dst->i[i] = chan->i[i];
 }
 
-static void
-store_dest(struct tgsi_exec_machine *mach,
-           const union tgsi_exec_channel *chan,
-           const struct tgsi_full_dst_register *reg,
-           const struct tgsi_full_instruction *inst,
-           uint chan_index,
-           enum tgsi_exec_datatype dst_datatype)
+/**
+ * Write the enabled channels of a register, optionally clamped to [0, 1].
+ */
+static inline void
+store_channel(union tgsi_exec_channel *dst,
+              const union tgsi_exec_channel *chan,
+              uint execmask,
+              boolean saturate)
 {
-   union tgsi_exec_channel *dst;
-   const uint execmask = mach->ExecMask;
    int i;
 
-   dst = store_dest_dstret(mach, chan, reg, inst, chan_index,
-                    dst_datatype);
-   if (!dst)
-      return;
-
-   if (!inst->Instruction.Saturate) {
+   if (!saturate) {
       for (i = 0; i < TGSI_QUAD_SIZE; i++)
          if (execmask & (1 << i))
             dst->i[i] = chan->i[i];
@@ -1991,6 +2230,24 @@ store_dest(struct tgsi_exec_machine *mach,
    }
 }
 
+static void
+store_dest(struct tgsi_exec_machine *mach,
+           const union tgsi_exec_channel *chan,
+           const struct tgsi_full_dst_register *reg,
+           const struct tgsi_full_instruction *inst,
+           uint chan_index,
+           enum tgsi_exec_datatype dst_datatype)
+{
+   union tgsi_exec_channel *dst;
+
+   dst = store_dest_dstret(mach, chan, reg, inst, chan_index,
+                    dst_datatype);
+   if (!dst)
+      return;
+
+   store_channel(dst, chan, mach->ExecMask, inst->Instruction.Saturate);
+}
+
 #define FETCH(VAL,INDEX,CHAN)\
     fetch_source(mach, VAL, &inst->Src[INDEX], CHAN, TGSI_EXEC_DATA_FLOAT)
 
@@ -6096,6 +6353,265 @@ tgsi_exec_machine_setup_masks(struct tgsi_exec_machine *mach)
    assert(mach->CallStackTop == 0);
 }
 
+static inline void
+fetch_op_source(const struct tgsi_exec_machine *mach,
+                union tgsi_exec_channel *chan,
+                const struct tgsi_exec_op_src *src,
+                uint chan_index)
+{
+   const uint swizzle = src->swizzle[chan_index];
+
+   switch (src->file) {
+   case TGSI_FILE_IMMEDIATE:
+      chan->f[0] =
+      chan->f[1] =
+      chan->f[2] =
+      chan->f[3] = src->imm[swizzle];
+      break;
+   case TGSI_FILE_CONSTANT:
+      {
+         /* same bounds check as fetch_src_file_channel() */
+         const uint *buf = (const uint *)mach->Consts[src->buffer];
+         const int pos = src->index * 4 + swizzle;
+
+         assert(buf);
+         chan->u[0] =
+         chan->u[1] =
+         chan->u[2] =
+         chan->u[3] = pos < (int) mach->ConstsSize[src->buffer] ? buf[pos] : 0;
+      }
+      break;
+   default:
+      *chan = src->vec->xyzw[swizzle];
+      break;
+   }
+
+   if (src->absolute)
+      micro_abs(chan, chan);
+   if (src->negate)
+      micro_neg(chan, chan);
+}
+
+static inline void
+store_op_dest(struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_op *op,
+              const union tgsi_exec_channel *chan,
+              uint chan_index)
+{
+   struct tgsi_exec_vector *dst;
+
+   if (op->dst_file == TGSI_FILE_TEMPORARY)
+      dst = &mach->Temps[op->dst_index];
+   else
+      dst = &mach->Outputs[mach->Temps[TEMP_OUTPUT_I].xyzw[TEMP_OUTPUT_C].u[0] +
+                           op->dst_index];
+
+   store_channel(&dst->xyzw[chan_index], chan, mach->ExecMask, op->saturate);
+}
+
+/*
+ * The pre-decoded counterparts of exec_vector_unary/binary/trinary and
+ * exec_dp3/dp4, built from the same micro ops so the results are
+ * bit-identical.  All channels are computed before any is stored in
+ * case the destination is also a source.
+ */
+
+static inline void
+exec_op_mov(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      if (op->write_mask & (1 << chan))
+         fetch_op_source(mach, &dst.xyzw[chan], &op->src[0], chan);
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      if (op->write_mask & (1 << chan))
+         store_op_dest(mach, op, &dst.xyzw[chan], chan);
+}
+
+static inline void
+exec_op_binary(struct tgsi_exec_machine *mach,
+               const struct tgsi_exec_op *op,
+               micro_binary_op micro)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->write_mask & (1 << chan)) {
+         union tgsi_exec_channel src[2];
+
+         fetch_op_source(mach, &src[0], &op->src[0], chan);
+         fetch_op_source(mach, &src[1], &op->src[1], chan);
+         micro(&dst.xyzw[chan], &src[0], &src[1]);
+      }
+   }
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      if (op->write_mask & (1 << chan))
+         store_op_dest(mach, op, &dst.xyzw[chan], chan);
+}
+
+static inline void
+exec_op_mad(struct tgsi_exec_machine *mach,
+            const struct tgsi_exec_op *op)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->write_mask & (1 << chan)) {
+         union tgsi_exec_channel src[3];
+
+         fetch_op_source(mach, &src[0], &op->src[0], chan);
+         fetch_op_source(mach, &src[1], &op->src[1], chan);
+         fetch_op_source(mach, &src[2], &op->src[2], chan);
+         micro_mad(&dst.xyzw[chan], &src[0], &src[1], &src[2]);
+      }
+   }
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      if (op->write_mask & (1 << chan))
+         store_op_dest(mach, op, &dst.xyzw[chan], chan);
+}
+
+static inline void
+exec_op_dp(struct tgsi_exec_machine *mach,
+           const struct tgsi_exec_op *op,
+           uint last_chan)
+{
+   union tgsi_exec_channel arg[3];
+   uint chan;
+
+   fetch_op_source(mach, &arg[0], &op->src[0], TGSI_CHAN_X);
+   fetch_op_source(mach, &arg[1], &op->src[1], TGSI_CHAN_X);
+   micro_mul(&arg[2], &arg[0], &arg[1]);
+
+   for (chan = TGSI_CHAN_Y; chan <= last_chan; chan++) {
+      fetch_op_source(mach, &arg[0], &op->src[0], chan);
+      fetch_op_source(mach, &arg[1], &op->src[1], chan);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      if (op->write_mask & (1 << chan))
+         store_op_dest(mach, op, &arg[2], chan);
+}
+
+/*
+ * With GCC style computed gotos every handler jumps straight to the next
+ * one instead of going back through a single, badly predicted switch.
+ */
+#if defined(__GNUC__)
+#define EXEC_OP_THREADED 1
+#define EXEC_OP_CASE(kind) case TGSI_EXEC_OP_##kind: op_##kind
+#define EXEC_OP_NEXT() \
+   do { \
+      if (mach->pc == -1) \
+         return FALSE; \
+      assert(mach->pc < (int) mach->NumInstructions); \
+      op = &mach->Ops[mach->pc]; \
+      goto *dispatch[op->kind]; \
+   } while (0)
+#else
+#define EXEC_OP_THREADED 0
+#define EXEC_OP_CASE(kind) case TGSI_EXEC_OP_##kind
+#define EXEC_OP_NEXT() continue
+#endif
+
+/**
+ * Run the pre-decoded instructions from mach->pc until pc is set to -1.
+ * \return TRUE if a compute shader hit a barrier
+ */
+static boolean
+exec_ops(struct tgsi_exec_machine *mach)
+{
+#if EXEC_OP_THREADED
+   static const void *const dispatch[TGSI_EXEC_OP_COUNT] = {
+      [TGSI_EXEC_OP_SLOW] = &&op_SLOW,
+      [TGSI_EXEC_OP_MOV] = &&op_MOV,
+      [TGSI_EXEC_OP_ADD] = &&op_ADD,
+      [TGSI_EXEC_OP_MUL] = &&op_MUL,
+      [TGSI_EXEC_OP_MAD] = &&op_MAD,
+      [TGSI_EXEC_OP_MIN] = &&op_MIN,
+      [TGSI_EXEC_OP_MAX] = &&op_MAX,
+      [TGSI_EXEC_OP_DP3] = &&op_DP3,
+      [TGSI_EXEC_OP_DP4] = &&op_DP4,
+   };
+#endif
+   const struct tgsi_exec_op *op;
+
+   for (;;) {
+      if (mach->pc == -1)
+         return FALSE;
+
+      assert(mach->pc < (int) mach->NumInstructions);
+      op = &mach->Ops[mach->pc];
+#if EXEC_OP_THREADED
+      goto *dispatch[op->kind];
+#endif
+
+      switch (op->kind) {
+      EXEC_OP_CASE(SLOW):
+         /* for compute and tessellation control shaders if we hit a
+          * barrier return now for later rescheduling
+          */
+         if (exec_instruction(mach, mach->Instructions + mach->pc, &mach->pc) &&
+             (mach->ShaderType == PIPE_SHADER_COMPUTE ||
+              mach->ShaderType == PIPE_SHADER_TESS_CTRL))
+            return TRUE;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(MOV):
+         exec_op_mov(mach, op);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(ADD):
+         exec_op_binary(mach, op, micro_add);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(MUL):
+         exec_op_binary(mach, op, micro_mul);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(MAD):
+         exec_op_mad(mach, op);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(MIN):
+         exec_op_binary(mach, op, micro_min);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(MAX):
+         exec_op_binary(mach, op, micro_max);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(DP3):
+         exec_op_dp(mach, op, TGSI_CHAN_Z);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      EXEC_OP_CASE(DP4):
+         exec_op_dp(mach, op, TGSI_CHAN_W);
+         mach->pc++;
+         EXEC_OP_NEXT();
+
+      default:
+         assert(0);
+         return FALSE;
+      }
+   }
+}
+
+#undef EXEC_OP_CASE
+#undef EXEC_OP_NEXT
+
 /**
  * Run TGSI interpreter.
  * \return bitmask of "alive" quad components
@@ -6129,6 +6645,10 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
          memset(temps, 0, sizeof(temps));
          memset(outputs, 0, sizeof(outputs));
       }
+#else
+      /* execute the pre-decoded instructions, if we have them */
+      if (mach->Ops && exec_ops(mach))
+         return 0;
 #endif
 
       /* execute instructions, until pc is set to -1 */
@@ -6143,8 +6663,11 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
          assert(mach->pc < (int) mach->NumInstructions);
          barrier_hit = exec_instruction(mach, mach->Instructions + mach->pc, &mach->pc);
 
-         /* for compute shaders if we hit a barrier return now for later rescheduling */
-         if (barrier_hit && mach->ShaderType == PIPE_SHADER_COMPUTE)
+         /* for compute and tessellation control shaders if we hit a barrier
+          * return now for later rescheduling
+          */
+         if (barrier_hit && (mach->ShaderType == PIPE_SHADER_COMPUTE ||
+                             mach->ShaderType == PIPE_SHADER_TESS_CTRL))
             return 0;
 
 #if DEBUG_EXECUTION
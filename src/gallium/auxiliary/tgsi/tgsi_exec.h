@@ -298,6 +298,15 @@ struct tgsi_sampler
  */
 #define TGSI_EXEC_MAX_INPUT_ATTRIBS 32
 
+/* Stride between the per-vertex inputs and outputs of two vertices of a
+ * patch in tessellation shaders.  Patch attributes have their own register
+ * indices and are stored with vertex zero.
+ */
+#define TGSI_EXEC_TESS_ATTRIB_STRIDE PIPE_MAX_SHADER_INPUTS
+
+/* The maximum number of vertices per patch */
+#define TGSI_MAX_PATCH_VERTICES 32
+
 /* The maximum number of bytes per constant buffer.
  */
 #define TGSI_EXEC_MAX_CONST_BUFFER_SIZE  (4096 * sizeof(float[4]))
@@ -342,6 +351,8 @@ enum tgsi_break_type {
 #define TGSI_EXEC_MAX_BREAK_STACK (TGSI_EXEC_MAX_LOOP_NESTING + TGSI_EXEC_MAX_SWITCH_NESTING)
 
 
+struct tgsi_exec_op;
+
 /**
  * Run-time virtual machine state for executing TGSI shader.
  */
@@ -442,6 +453,9 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Pre-decoded form of Instructions, same indexing, may be NULL */
+   struct tgsi_exec_op *Ops;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
@@ -55,6 +55,9 @@ llvmpipe_flush( struct pipe_context *pipe,
    /* ask the setup module to flush */
    lp_setup_flush(llvmpipe->setup, fence, reason);
 
+   /* Following scenes can use any newly optimized shader code */
+   llvmpipe_install_fs_variants(llvmpipe);
+
    /* Enable to dump BMPs of the color/depth buffers each frame */
    if (0) {
       static unsigned frame_no = 1;
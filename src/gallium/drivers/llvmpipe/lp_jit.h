@@ -38,6 +38,7 @@
 
 #include "gallivm/lp_bld_struct.h"
 #include "gallivm/lp_bld_limits.h"
+#include "gallivm/lp_bld_tgsi.h"
 
 #include "pipe/p_state.h"
 #include "lp_texture.h"
@@ -45,6 +46,7 @@
 
 struct lp_build_format_cache;
 struct lp_fragment_shader_variant;
+struct lp_compute_shader_variant;
 struct llvmpipe_screen;
 
 
@@ -78,6 +80,23 @@ struct lp_jit_viewport
 };
 
 
+/**
+ * An image view as seen by shader image load/store, the fields and their
+ * order are those of enum lp_build_image_member.
+ */
+struct lp_jit_image
+{
+   void *base;            /* first texel of the view */
+   uint32_t width;        /* 0 when no image is bound */
+   uint32_t height;
+   uint32_t depth;        /* slices of 3D views, layers of arrays */
+   uint32_t row_stride;
+   uint32_t img_stride;
+   uint32_t cpp;
+   void *pack;            /* util_format pack_rgba_* of the view's format */
+};
+
+
 enum {
    LP_JIT_TEXTURE_WIDTH = 0,
    LP_JIT_TEXTURE_HEIGHT,
@@ -108,6 +127,19 @@ enum {
 };
 
 
+enum {
+   LP_JIT_IMAGE_BASE = LP_IMAGE_BASE,
+   LP_JIT_IMAGE_WIDTH = LP_IMAGE_WIDTH,
+   LP_JIT_IMAGE_HEIGHT = LP_IMAGE_HEIGHT,
+   LP_JIT_IMAGE_DEPTH = LP_IMAGE_DEPTH,
+   LP_JIT_IMAGE_ROW_STRIDE = LP_IMAGE_ROW_STRIDE,
+   LP_JIT_IMAGE_IMG_STRIDE = LP_IMAGE_IMG_STRIDE,
+   LP_JIT_IMAGE_CPP = LP_IMAGE_CPP,
+   LP_JIT_IMAGE_PACK = LP_IMAGE_PACK,
+   LP_JIT_IMAGE_NUM_FIELDS = LP_IMAGE_NUM_MEMBERS
+};
+
+
 /**
  * This structure is passed directly to the generated fragment shader.
  *
@@ -135,6 +167,10 @@ struct lp_jit_context
 
    struct lp_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    struct lp_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+
+   uint8_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   uint32_t ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
+   struct lp_jit_image images[LP_MAX_TGSI_SHADER_IMAGES];
 };
 
 
@@ -153,6 +189,9 @@ enum {
    LP_JIT_CTX_VIEWPORTS,
    LP_JIT_CTX_TEXTURES,
    LP_JIT_CTX_SAMPLERS,
+   LP_JIT_CTX_SSBOS,
+   LP_JIT_CTX_SSBO_SIZES,
+   LP_JIT_CTX_IMAGES,
    LP_JIT_CTX_COUNT
 };
 
@@ -187,6 +226,15 @@ enum {
 #define lp_jit_context_samplers(_gallivm, _ptr) \
    lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SAMPLERS, "samplers")
 
+#define lp_jit_context_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SSBOS, "ssbos")
+
+#define lp_jit_context_ssbo_sizes(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SSBO_SIZES, "ssbo_sizes")
+
+#define lp_jit_context_images(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_IMAGES, "images")
+
 
 struct lp_jit_thread_data
 {
@@ -254,6 +302,29 @@ typedef void
                     unsigned depth_stride);
 
 
+/**
+ * typedef for compute shader function
+ *
+ * Runs one vector of invocations of a work group.
+ *
+ * @param context       jit context
+ * @param thread_data   task thread data
+ * @param shared        work group shared memory
+ * @param block_id      x, y, z id of the work group
+ * @param grid_size     x, y, z number of work groups
+ * @param invocation    linear index of the first invocation in the vector
+ * @param barrier_data  passed to the barrier function
+ */
+typedef void
+(*lp_jit_cs_func)(const struct lp_jit_context *context,
+                  struct lp_jit_thread_data *thread_data,
+                  uint8_t *shared,
+                  const uint32_t *block_id,
+                  const uint32_t *grid_size,
+                  uint32_t invocation,
+                  void *barrier_data);
+
+
 void
 lp_jit_screen_cleanup(struct llvmpipe_screen *screen);
 
@@ -266,4 +337,25 @@ void
 lp_jit_init_types(struct lp_fragment_shader_variant *lp);
 
 
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp);
+
+
+/**
+ * Shader buffer and image access through the jit context.
+ */
+struct lp_jit_mem_iface
+{
+   struct lp_build_tgsi_mem_iface base;
+
+   LLVMValueRef context_ptr;
+};
+
+
+void
+lp_jit_init_mem_iface(struct lp_jit_mem_iface *iface,
+                      struct gallivm_state *gallivm,
+                      LLVMValueRef context_ptr);
+
+
 #endif /* LP_JIT_H */
@@ -61,9 +61,6 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
-
-
 /**
  * Max bytes per scene.  This may be replaced by a runtime parameter.
  */
@@ -91,4 +88,9 @@
  */
 #define LP_MAX_SETUP_VARIANTS 64
 
+/**
+ * Max number of compute shader variants kept for each compute shader.
+ */
+#define LP_MAX_CS_VARIANTS 16
+
 #endif /* LP_LIMITS_H */
@@ -26,6 +26,8 @@
  **************************************************************************/
 
 #include <limits.h>
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
@@ -57,6 +59,110 @@ const struct lp_rasterizer_task *jit_task = NULL;
 #endif
 
 
+static inline uint64_t
+bin_queue_pack(unsigned head, unsigned tail)
+{
+   return (uint64_t)head | ((uint64_t)tail << 32);
+}
+
+
+/**
+ * Split the scene's bins into one contiguous range per thread.
+ *
+ * The split only depends on the framebuffer size and the thread count,
+ * so as long as those don't change a given thread keeps working on the
+ * same region of the framebuffer from one scene to the next, and the
+ * colour/depth data of those tiles is likely to still be in its caches.
+ */
+static void
+lp_rast_assign_bins( struct lp_rasterizer *rast,
+                     const struct lp_scene *scene )
+{
+   const unsigned num_tasks = MAX2(1, rast->num_threads);
+   const unsigned num_bins = lp_scene_get_num_bins(scene);
+   unsigned i;
+
+   for (i = 0; i < num_tasks; i++) {
+      unsigned head = (uint64_t)num_bins * i / num_tasks;
+      unsigned tail = (uint64_t)num_bins * (i + 1) / num_tasks;
+
+      p_atomic_set(&rast->tasks[i].bins.range, bin_queue_pack(head, tail));
+   }
+}
+
+
+/**
+ * Take a bin from the front (own work) or the back (stealing) of a queue.
+ * \return FALSE if the queue is empty
+ */
+static boolean
+bin_queue_pop( struct lp_rast_bin_queue *queue,
+               boolean steal,
+               unsigned *bin_index )
+{
+   uint64_t range = p_atomic_read(&queue->range);
+
+   for (;;) {
+      unsigned head = (unsigned)range;
+      unsigned tail = (unsigned)(range >> 32);
+      uint64_t new_range, old_range;
+
+      if (head >= tail)
+         return FALSE;
+
+      if (steal)
+         new_range = bin_queue_pack(head, tail - 1);
+      else
+         new_range = bin_queue_pack(head + 1, tail);
+
+      old_range = p_atomic_cmpxchg(&queue->range, range, new_range);
+      if (old_range == range) {
+         *bin_index = steal ? tail - 1 : head;
+         return TRUE;
+      }
+
+      range = old_range;
+   }
+}
+
+
+/**
+ * Get the next bin for this thread to rasterize.  Once the thread's own
+ * queue is drained, steal bins from the other threads, starting with the
+ * next one along so that the thieves spread out over the victims.
+ */
+static struct cmd_bin *
+lp_rast_next_bin( struct lp_rasterizer_task *task,
+                  int *x, int *y )
+{
+   struct lp_rasterizer *rast = task->rast;
+   struct lp_scene *scene = task->scene;
+   const unsigned num_tasks = MAX2(1, rast->num_threads);
+   unsigned bin_index;
+   unsigned i;
+
+   if (!bin_queue_pop(&task->bins, FALSE, &bin_index)) {
+      for (i = 1; i < num_tasks; i++) {
+         struct lp_rasterizer_task *victim =
+            &rast->tasks[(task->thread_index + i) % num_tasks];
+
+         if (bin_queue_pop(&victim->bins, TRUE, &bin_index)) {
+            LP_COUNT(nr_stolen_bins);
+            break;
+         }
+      }
+
+      if (i == num_tasks)
+         return NULL;
+   }
+
+   *x = bin_index % scene->tiles_x;
+   *y = bin_index / scene->tiles_x;
+
+   return lp_scene_get_bin(scene, *x, *y);
+}
+
+
 /**
  * Begin rasterizing a scene.
  * Called once per scene by one thread.
@@ -70,16 +176,61 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_rast_assign_bins( rast, scene );
 }
 
 
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+
+   lp_scene_end_rasterization( scene );
 
    rast->curr_scene = NULL;
+
+   /* This must come last: as soon as the fence is signalled the setup
+    * code may recycle the scene and start binning into it again.
+    */
+   if (scene->fence) {
+      lp_fence_signal(scene->fence);
+   }
+}
+
+
+/**
+ * Set up the hierarchical Z state for a tile, see lp_rast_hiz_cull().
+ * The bounds are only maintained for single layer depth buffers.
+ */
+static void
+lp_rast_hiz_begin(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+
+   task->hiz_enabled = FALSE;
+   lp_rast_hiz_invalidate(task);
+
+   if (scene->fb.zsbuf && scene->fb_max_layer == 0) {
+      const struct util_format_description *desc =
+         util_format_description(scene->fb.zsbuf->format);
+
+      if (util_format_has_depth(desc)) {
+         const struct util_format_channel_description *chan =
+            &desc->channel[desc->swizzle[0]];
+
+         task->hiz_enabled = TRUE;
+         if (chan->type == UTIL_FORMAT_TYPE_FLOAT) {
+            task->hiz_margin = 1.0f / (1 << 20);
+            task->hiz_zmax = FLT_MAX;
+         }
+         else {
+            /* unorm values are clamped to [0,1] */
+            task->hiz_margin = MAX2(1.0f / (float)((1u << chan->size) - 1),
+                                    1.0f / (1 << 20));
+            task->hiz_zmax = 1.0f;
+         }
+      }
+   }
 }
 
 
@@ -109,6 +260,8 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->ps_invocations = 0;
 
+   lp_rast_hiz_begin(task);
+
    for (i = 0; i < task->scene->fb.nr_cbufs; i++) {
       if (task->scene->fb.cbufs[i]) {
          task->color_tiles[i] = scene->cbufs[i].map +
@@ -281,6 +434,27 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
          }
          dst_layer += scene->zsbuf.layer_stride;
       }
+
+      /* Now the whole tile has the same depth, read it back */
+      if (task->hiz_enabled) {
+         enum pipe_format format = scene->fb.zsbuf->format;
+         uint64_t zmask64 = util_pack64_mask_z_stencil(format, 0xffffffff, 0);
+
+         if ((clear_mask64 & zmask64) == zmask64) {
+            float z;
+            unsigned k;
+
+            util_format_description(format)->unpack_z_float(&z, 0,
+                                                            task->depth_tile,
+                                                            0, 1, 1);
+            task->hiz_tile_max = z;
+            for (k = 0; k < ARRAY_SIZE(task->hiz_block_max); k++)
+               task->hiz_block_max[k] = z;
+         }
+         else if (clear_mask64 & zmask64) {
+            lp_rast_hiz_invalidate(task);
+         }
+      }
    }
 }
 
@@ -316,6 +490,14 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    }
    variant = state->variant;
 
+   if (variant->hiz_invalidate) {
+      lp_rast_hiz_invalidate(task);
+   }
+   else if (lp_rast_hiz_cull(task, inputs, tile_x, tile_y, TILE_SIZE)) {
+      LP_COUNT(nr_hiz_culled_64);
+      return;
+   }
+
    /* render the whole 64x64 tile in 4x4 chunks */
    for (y = 0; y < task->height; y += 4){
       for (x = 0; x < task->width; x += 4) {
@@ -365,6 +547,8 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          END_JIT_CALL();
       }
    }
+
+   lp_rast_hiz_tighten(task, inputs, tile_x, tile_y, TILE_SIZE);
 }
 
 
@@ -686,7 +870,7 @@ rasterize_scene(struct lp_rasterizer_task *task,
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_rast_next_bin(task, &i, &j))) {
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
@@ -708,10 +892,6 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -760,20 +940,43 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
+/**
+ * Run a job on every rasterizer thread and wait for all of them to finish.
+ *
+ * The threads must be idle: the caller makes sure no scene is queued or
+ * being rasterized, and that no other scene or job gets queued meanwhile.
+ */
 void
-lp_rast_finish( struct lp_rasterizer *rast )
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 lp_rast_job_func func,
+                 void *data )
 {
+   unsigned i;
+
    if (rast->num_threads == 0) {
-      /* nothing to do */
+      unsigned fpstate = util_fpstate_get();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+
+      func(data, 0, &rast->tasks[0].thread_data);
+
+      util_fpstate_set(fpstate);
+      return;
    }
-   else {
-      int i;
 
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
+   rast->job_func = func;
+   rast->job_data = data;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_signal(&rast->tasks[i].work_ready);
+   }
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_wait(&rast->job_done);
    }
+
+   rast->job_func = NULL;
+   rast->job_data = NULL;
 }
 
 
@@ -782,7 +985,7 @@ lp_rast_finish( struct lp_rasterizer *rast )
  * It's a simple loop:
  *   1. wait for work
  *   2. do work
- *   3. signal that we're done
+ * Completion of each scene is signalled through the scene's fence.
  */
 static int
 thread_function(void *init_data)
@@ -796,6 +999,12 @@ thread_function(void *init_data)
    util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    u_thread_setname(thread_name);
 
+   /* Keeping each thread on one CPU means the tiles it is assigned in
+    * lp_rast_assign_bins() stay in that CPU's caches across scenes.
+    */
+   if (rast->pin_threads)
+      u_thread_pin_to_cpu(task->thread_index % util_cpu_caps.nr_cpus);
+
    /* Make sure that denorms are treated like zeros. This is 
     * the behavior required by D3D10. OpenGL doesn't care.
     */
@@ -811,6 +1020,13 @@ thread_function(void *init_data)
       if (rast->exit_flag)
          break;
 
+      if (rast->job_func) {
+         rast->job_func(rast->job_data, task->thread_index,
+                        &task->thread_data);
+         pipe_semaphore_signal(&rast->job_done);
+         continue;
+      }
+
       if (task->thread_index == 0) {
          /* thread[0]:
           *  - get next scene to rasterize
@@ -835,17 +1051,16 @@ thread_function(void *init_data)
       /* wait for all threads to finish with this scene */
       util_barrier_wait( &rast->barrier );
 
-      /* XXX: shouldn't be necessary:
+      /* thread[0]:
+       *  - unmap the framebuffer surfaces
+       *  - signal the scene's fence
        */
       if (task->thread_index == 0) {
          lp_rast_end( rast );
       }
 
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -891,6 +1106,18 @@ lp_rast_create( unsigned num_threads )
       goto no_rast;
    }
 
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof(struct lp_rasterizer_task));
+   if (!rast->tasks) {
+      goto no_tasks;
+   }
+
+   if (num_threads) {
+      rast->threads = CALLOC(num_threads, sizeof(thrd_t));
+      if (!rast->threads) {
+         goto no_threads;
+      }
+   }
+
    rast->full_scenes = lp_scene_queue_create();
    if (!rast->full_scenes) {
       goto no_full_scenes;
@@ -910,6 +1137,9 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->pin_threads = debug_get_bool_option("LP_PIN_THREADS", FALSE);
+
+   pipe_semaphore_init(&rast->job_done, 0);
 
    create_rast_threads(rast);
 
@@ -923,7 +1153,7 @@ lp_rast_create( unsigned num_threads )
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
@@ -931,6 +1161,10 @@ no_thread_data_cache:
 
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
+   FREE(rast->threads);
+no_threads:
+   FREE(rast->tasks);
+no_tasks:
    FREE(rast);
 no_rast:
    return NULL;
@@ -977,8 +1211,12 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
       util_barrier_destroy( &rast->barrier );
    }
 
+   pipe_semaphore_destroy(&rast->job_done);
+
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
 
@@ -166,8 +166,19 @@ void
 lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
+
+/**
+ * A job run once by every rasterizer thread, used for work other than
+ * scenes (compute grids).
+ */
+typedef void (*lp_rast_job_func)(void *data,
+                                 unsigned thread_index,
+                                 struct lp_jit_thread_data *thread_data);
+
 void
-lp_rast_finish( struct lp_rasterizer *rast );
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 lp_rast_job_func func,
+                 void *data );
 
 
 union lp_rast_cmd_arg {
@@ -28,7 +28,9 @@
 #ifndef LP_RAST_PRIV_H
 #define LP_RAST_PRIV_H
 
+#include <float.h>
 #include "util/u_format.h"
+#include "util/u_math.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
@@ -76,6 +78,21 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/**
+ * Per-thread queue of bins to rasterize.
+ *
+ * The bins of a scene are numbered in raster order and each thread gets
+ * a contiguous range of them.  The owner takes bins from the front, idle
+ * threads steal from the back.  Head and tail are packed in one 64-bit
+ * word so both can be updated with a single compare-and-swap.
+ */
+struct lp_rast_bin_queue
+{
+   uint64_t range;   /**< head in the low 32 bits, tail in the high ones */
+};
+
+
 /**
  * Per-thread rasterization state
  */
@@ -97,11 +114,24 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** bins of the current scene assigned to this thread */
+   struct lp_rast_bin_queue bins;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
+   /**
+    * Hierarchical Z: upper bounds of the depth values in the current tile
+    * and in each of its 16x16 blocks, LP_HIZ_UNKNOWN if not known.
+    */
+   boolean hiz_enabled;
+   float hiz_margin;      /**< depth buffer precision */
+   float hiz_zmax;        /**< largest depth the buffer can represent */
+   float hiz_tile_max;
+   float hiz_block_max[(TILE_SIZE / 16) * (TILE_SIZE / 16)];
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -124,13 +154,21 @@ struct lp_rasterizer
    struct lp_scene *curr_scene;
 
    /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
+
+   /** Pin each rasterization thread to its own CPU */
+   boolean pin_threads;
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
+
+   /** Job run instead of a scene, see lp_rast_run_job() */
+   lp_rast_job_func job_func;
+   void *job_data;
+   pipe_semaphore job_done;
 };
 
 
@@ -216,6 +254,144 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
 }
 
 
+/*
+ * Hierarchical Z.
+ *
+ * The depth bounds of a tile become known when its depth buffer is cleared
+ * and are lowered each time a 16x16 block is fully covered by a primitive
+ * whose depth test can only make the stored values smaller.  With a LESS or
+ * LEQUAL depth test, a block whose nearest fragment lies behind the bound
+ * can't produce any visible fragment and isn't shaded at all.
+ * Nothing is carried over between scenes.
+ */
+#define LP_HIZ_UNKNOWN FLT_MAX
+
+
+static inline void
+lp_rast_hiz_invalidate(struct lp_rasterizer_task *task)
+{
+   unsigned i;
+
+   task->hiz_tile_max = LP_HIZ_UNKNOWN;
+   for (i = 0; i < ARRAY_SIZE(task->hiz_block_max); i++)
+      task->hiz_block_max[i] = LP_HIZ_UNKNOWN;
+}
+
+
+/**
+ * Conservative range of a primitive's depth over a square of pixels.
+ * \param x, y location of the square in window coords
+ */
+static inline void
+lp_rast_hiz_z_range(const struct lp_rast_shader_inputs *inputs,
+                    int x, int y, unsigned size,
+                    float *zmin, float *zmax)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float ex = dzdx * (float)(size - 1);
+   const float ey = dzdy * (float)(size - 1);
+   const float z = a0 + dzdx * (float)x + dzdy * (float)y;
+   /* the shader may round differently, don't rely on the last bits */
+   const float err = (fabsf(a0) +
+                      fabsf(dzdx) * (float)(x + size) +
+                      fabsf(dzdy) * (float)(y + size)) * (1.0f / (1 << 20));
+
+   *zmin = z + MIN2(ex, 0.0f) + MIN2(ey, 0.0f) - err;
+   *zmax = z + MAX2(ex, 0.0f) + MAX2(ey, 0.0f) + err;
+}
+
+
+/**
+ * Depth bound of the 16x16 blocks overlapping a square of pixels.
+ * \param x, y location of the square in window coords
+ */
+static inline float
+lp_rast_hiz_bound(const struct lp_rasterizer_task *task,
+                  int x, int y, unsigned size)
+{
+   unsigned bx0, by0, bx1, by1, bx, by;
+   float bound = 0.0f;
+
+   if (size == TILE_SIZE)
+      return task->hiz_tile_max;
+
+   bx0 = (x - task->x) / 16;
+   by0 = (y - task->y) / 16;
+   bx1 = MIN2((x - task->x + size - 1) / 16, TILE_SIZE / 16 - 1);
+   by1 = MIN2((y - task->y + size - 1) / 16, TILE_SIZE / 16 - 1);
+
+   for (by = by0; by <= by1; by++)
+      for (bx = bx0; bx <= bx1; bx++)
+         bound = MAX2(bound, task->hiz_block_max[by * (TILE_SIZE / 16) + bx]);
+
+   return bound;
+}
+
+
+/**
+ * Test a square of pixels of a primitive against the depth bounds.
+ * \param x, y location of the square in window coords
+ * \return TRUE if none of its fragments can pass the depth test
+ */
+static inline boolean
+lp_rast_hiz_cull(const struct lp_rasterizer_task *task,
+                 const struct lp_rast_shader_inputs *inputs,
+                 int x, int y, unsigned size)
+{
+   float bound, zmin, zmax;
+
+   if (!task->state->variant->hiz_cull)
+      return FALSE;
+
+   bound = lp_rast_hiz_bound(task, x, y, size) + task->hiz_margin;
+
+   /* Unknown, or fragments might get clamped down to the bound */
+   if (!(bound < task->hiz_zmax))
+      return FALSE;
+
+   lp_rast_hiz_z_range(inputs, x, y, size, &zmin, &zmax);
+
+   return zmin > bound;
+}
+
+
+/**
+ * Lower the depth bounds after shading a fully covered 16x16 block, or a
+ * whole tile.
+ * \param x, y location of the block in window coords
+ */
+static inline void
+lp_rast_hiz_tighten(struct lp_rasterizer_task *task,
+                    const struct lp_rast_shader_inputs *inputs,
+                    int x, int y, unsigned size)
+{
+   float zmin, zmax, tile_max;
+   unsigned i;
+
+   if (!task->hiz_enabled || !task->state->variant->hiz_tighten)
+      return;
+
+   lp_rast_hiz_z_range(inputs, x, y, size, &zmin, &zmax);
+   zmax += task->hiz_margin;
+
+   if (size == TILE_SIZE) {
+      for (i = 0; i < ARRAY_SIZE(task->hiz_block_max); i++)
+         task->hiz_block_max[i] = MIN2(task->hiz_block_max[i], zmax);
+   }
+   else {
+      assert(size == 16);
+      i = ((y - task->y) / 16) * (TILE_SIZE / 16) + (x - task->x) / 16;
+      task->hiz_block_max[i] = MIN2(task->hiz_block_max[i], zmax);
+   }
+
+   tile_max = 0.0f;
+   for (i = 0; i < ARRAY_SIZE(task->hiz_block_max); i++)
+      tile_max = MAX2(tile_max, task->hiz_block_max[i]);
+   task->hiz_tile_max = tile_max;
+}
+
 
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
@@ -63,6 +63,31 @@ block_full_16(struct lp_rasterizer_task *task,
 	 block_full_4(task, tri, x + ix, y + iy);
 }
 
+/**
+ * Hierarchical Z test for a triangle contained in a single 16x16 or 4x4
+ * block, which doesn't go through the tile level test.
+ * \param x, y location of the block in window coords
+ * \return TRUE if the triangle is hidden
+ */
+static inline boolean
+contained_hiz_cull(struct lp_rasterizer_task *task,
+                   const struct lp_rast_triangle *tri,
+                   int x, int y, unsigned size)
+{
+   if (task->state->variant->hiz_invalidate) {
+      lp_rast_hiz_invalidate(task);
+      return FALSE;
+   }
+
+   if (lp_rast_hiz_cull(task, &tri->inputs, x, y, size)) {
+      LP_COUNT_ADD(nr_hiz_culled_16, size == 16);
+      LP_COUNT_ADD(nr_hiz_culled_4, size == 4);
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
 static inline unsigned
 build_mask_linear(int32_t c, int32_t dcdx, int32_t dcdy)
 {
@@ -265,6 +290,9 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
    __m128i unused;
 
+   if (contained_hiz_cull(task, tri, x, y, 16))
+      return;
+
    transpose4_epi32(&p0, &p1, &p2, &zero,
                     &c, &unused, &dcdx, &dcdy);
 
@@ -373,6 +401,9 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
    __m128i span_2;                /* 0,dcdx,2dcdx,3dcdx for plane 2 */
    __m128i unused;
 
+   if (contained_hiz_cull(task, tri, x, y, 4))
+      return;
+
    transpose4_epi32(&p0, &p1, &p2, &zero,
                     &c, &unused, &dcdx, &dcdy);
 
@@ -556,6 +587,9 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    __m128i vshuf_mask1;
    __m128i vshuf_mask2;
 
+   if (contained_hiz_cull(task, tri, x, y, 16))
+      return;
+
 #ifdef PIPE_ARCH_LITTLE_ENDIAN
    vshuf_mask0 = (__m128i) vec_splats((unsigned int) 0x03020100);
    vshuf_mask1 = (__m128i) vec_splats((unsigned int) 0x07060504);
@@ -36,6 +36,11 @@
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_debug.h"
+#include "util/disk_cache.h"
+#include "compiler/nir/nir.h"
+#include <llvm-c/ExecutionEngine.h>
 
 #include "os/os_misc.h"
 #include "util/os_time.h"
@@ -81,6 +86,7 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "no_async",       PERF_NO_ASYNC, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -212,7 +218,10 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
-      return 0;
+      return HAVE_LLVM >= 0x0309;
+   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
+      /* shader buffers are available to fragment and compute shaders */
+      return HAVE_LLVM >= 0x0309 ? 16 : 0;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
       return 1;
    case PIPE_CAP_USER_CONSTANT_BUFFERS:
@@ -267,11 +276,13 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_TEXTURE_QUERY_LOD:
    case PIPE_CAP_CONDITIONAL_RENDER_INVERTED:
    case PIPE_CAP_TGSI_ARRAY_COMPONENTS:
+   case PIPE_CAP_QUERY_SO_OVERFLOW:
+      return 1;
    case PIPE_CAP_DOUBLES:
    case PIPE_CAP_INT64:
    case PIPE_CAP_INT64_DIVMOD:
-   case PIPE_CAP_QUERY_SO_OVERFLOW:
-      return 1;
+      /* the NIR translator only handles 32bit types */
+      return !llvmpipe_screen(screen)->use_nir;
 
    case PIPE_CAP_VENDOR_ID:
       return 0xFFFFFFFF;
@@ -310,10 +321,11 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return 1;
    case PIPE_CAP_CLEAR_TEXTURE:
       return 1;
+   case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
+      return 32;
    case PIPE_CAP_MULTISAMPLE_Z_RESOLVE:
    case PIPE_CAP_RESOURCE_FROM_USER_MEMORY:
    case PIPE_CAP_DEVICE_RESET_STATUS_QUERY:
-   case PIPE_CAP_MAX_SHADER_PATCH_VARYINGS:
    case PIPE_CAP_DEPTH_BOUNDS_TEST:
    case PIPE_CAP_TGSI_TXQS:
    case PIPE_CAP_FORCE_PERSAMPLE_INTERP:
@@ -324,7 +336,6 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_MULTI_DRAW_INDIRECT_PARAMS:
    case PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL:
    case PIPE_CAP_TGSI_FS_FACE_IS_INTEGER_SYSVAL:
-   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
    case PIPE_CAP_INVALIDATE_BUFFER:
    case PIPE_CAP_GENERATE_MIPMAP:
    case PIPE_CAP_STRING_MARKER:
@@ -380,10 +391,28 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
    {
    case PIPE_SHADER_FRAGMENT:
       switch (param) {
+      case PIPE_SHADER_CAP_PREFERRED_IR:
+         if (llvmpipe_screen(screen)->use_nir)
+            return PIPE_SHADER_IR_NIR;
+         else
+            return PIPE_SHADER_IR_TGSI;
+      case PIPE_SHADER_CAP_SUPPORTED_IRS:
+         return (1 << PIPE_SHADER_IR_TGSI) | (1 << PIPE_SHADER_IR_NIR);
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         /* not implemented by the NIR path */
+         if (HAVE_LLVM < 0x0309 || llvmpipe_screen(screen)->use_nir)
+            return 0;
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      case PIPE_SHADER_CAP_MAX_SHADER_IMAGES:
+         if (HAVE_LLVM < 0x0309 || llvmpipe_screen(screen)->use_nir)
+            return 0;
+         return LP_MAX_TGSI_SHADER_IMAGES;
       default:
          return gallivm_get_shader_param(param);
       }
    case PIPE_SHADER_VERTEX:
+   case PIPE_SHADER_TESS_CTRL:
+   case PIPE_SHADER_TESS_EVAL:
    case PIPE_SHADER_GEOMETRY:
       switch (param) {
       case PIPE_SHADER_CAP_MAX_TEXTURE_SAMPLERS:
@@ -403,11 +432,113 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
       default:
          return draw_get_shader_param(shader, param);
       }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+      case PIPE_SHADER_CAP_MAX_INPUTS:
+      case PIPE_SHADER_CAP_MAX_OUTPUTS:
+         return 0;
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      case PIPE_SHADER_CAP_MAX_SHADER_IMAGES:
+         return LP_MAX_TGSI_SHADER_IMAGES;
+      default:
+         return gallivm_get_shader_param(param);
+      }
    default:
       return 0;
    }
 }
 
+
+static int
+llvmpipe_get_compute_param(struct pipe_screen *_screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 1024;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = 1024;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
+static const nir_shader_compiler_options lp_nir_options = {
+   .lower_scmp = true,
+   .lower_flrp32 = true,
+   .lower_flrp64 = true,
+   .lower_ffma = true,
+   .lower_fmod32 = true,
+   .lower_fmod64 = true,
+   .lower_bitfield_extract = true,
+   .lower_bitfield_insert = true,
+   .lower_uadd_carry = true,
+   .lower_usub_borrow = true,
+   .lower_pack_half_2x16 = true,
+   .lower_pack_unorm_2x16 = true,
+   .lower_pack_snorm_2x16 = true,
+   .lower_pack_unorm_4x8 = true,
+   .lower_pack_snorm_4x8 = true,
+   .lower_unpack_half_2x16 = true,
+   .lower_unpack_unorm_2x16 = true,
+   .lower_unpack_snorm_2x16 = true,
+   .lower_unpack_unorm_4x8 = true,
+   .lower_unpack_snorm_4x8 = true,
+   .lower_extract_byte = true,
+   .lower_extract_word = true,
+   .native_integers = true,
+   .max_unroll_iterations = 32,
+};
+
+static const void *
+llvmpipe_get_compiler_options(struct pipe_screen *screen,
+                              enum pipe_shader_ir ir,
+                              enum pipe_shader_type shader)
+{
+   assert(ir == PIPE_SHADER_IR_NIR);
+   return &lp_nir_options;
+}
+
 static float
 llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 {
@@ -508,6 +639,16 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
       }
    }
 
+   if (bind & PIPE_BIND_SHADER_IMAGE) {
+      /* Image stores go through the format's pack functions, texel by
+       * texel.
+       */
+      if (format_desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+          format_desc->block.width != 1 ||
+          format_desc->block.height != 1)
+         return FALSE;
+   }
+
    if (bind & PIPE_BIND_DISPLAY_TARGET) {
       if(!winsys->is_displaytarget_format_supported(winsys, bind, format))
          return FALSE;
@@ -557,6 +698,18 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
+   struct lp_fence *fence = NULL;
+
+   /* Contexts don't wait for their scenes to be rasterized when flushing,
+    * so make sure all rendering has landed before presenting.
+    */
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   mtx_unlock(&screen->rast_mutex);
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 
    assert(texture->dt);
    if (texture->dt)
@@ -569,9 +722,16 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
 
+   if (screen->async_fs_compile)
+      util_queue_destroy(&screen->fs_compile_queue);
+
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   lp_fence_reference(&screen->last_fence, NULL);
+
+   disk_cache_destroy(screen->disk_shader_cache);
+
    lp_jit_screen_cleanup(screen);
 
    if(winsys->destroy)
@@ -624,6 +784,119 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+
+/**
+ * Bitmask of the global state which, besides the shader and its variant
+ * key, affects the code generated by gallivm.
+ */
+static uint64_t
+lp_disk_cache_driver_flags(void)
+{
+   uint64_t flags = 0;
+   unsigned bit = 0;
+
+#define LP_CPU_FLAG(cap) flags |= (uint64_t)!!util_cpu_caps.cap << bit++
+   LP_CPU_FLAG(has_sse);
+   LP_CPU_FLAG(has_sse2);
+   LP_CPU_FLAG(has_sse3);
+   LP_CPU_FLAG(has_ssse3);
+   LP_CPU_FLAG(has_sse4_1);
+   LP_CPU_FLAG(has_sse4_2);
+   LP_CPU_FLAG(has_popcnt);
+   LP_CPU_FLAG(has_avx);
+   LP_CPU_FLAG(has_avx2);
+   LP_CPU_FLAG(has_f16c);
+   LP_CPU_FLAG(has_fma);
+   LP_CPU_FLAG(has_xop);
+   LP_CPU_FLAG(has_altivec);
+   LP_CPU_FLAG(has_neon);
+   LP_CPU_FLAG(has_avx512f);
+   LP_CPU_FLAG(has_avx512dq);
+   LP_CPU_FLAG(has_avx512bw);
+   LP_CPU_FLAG(has_avx512vl);
+#undef LP_CPU_FLAG
+
+   flags |= (uint64_t)!!(gallivm_debug & GALLIVM_DEBUG_NO_OPT) << bit++;
+
+   assert(bit <= 32);
+   flags |= (uint64_t)lp_native_vector_width << 32;
+
+   return flags;
+}
+
+
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+   uint32_t mesa_timestamp, llvm_timestamp;
+   char timestamp_str[32];
+
+   /* Generated code also depends on the LLVM version in use. */
+   if (!disk_cache_get_function_timestamp(lp_disk_cache_create,
+                                          &mesa_timestamp) ||
+       !disk_cache_get_function_timestamp(LLVMLinkInMCJIT,
+                                          &llvm_timestamp))
+      return;
+
+   util_snprintf(timestamp_str, sizeof(timestamp_str), "%u_%u",
+                 mesa_timestamp, llvm_timestamp);
+
+   screen->disk_shader_cache =
+      disk_cache_create("llvmpipe", timestamp_str,
+                        lp_disk_cache_driver_flags());
+}
+
+
+/**
+ * Look up the object code of a shader variant in the disk cache.
+ * On a hit, cache->data is set to a malloc'ed copy of the object.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20])
+{
+   cache_key sha1;
+   size_t binary_size;
+   void *buffer;
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
+                          20, sha1);
+
+   buffer = disk_cache_get(screen->disk_shader_cache, sha1, &binary_size);
+   if (!buffer) {
+      cache->data_size = 0;
+      return;
+   }
+
+   cache->data = buffer;
+   cache->data_size = binary_size;
+}
+
+
+/**
+ * Store the freshly generated object code of a shader variant.
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20])
+{
+   cache_key sha1;
+
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
+                          20, sha1);
+   disk_cache_put(screen->disk_shader_cache, sha1, cache->data,
+                  cache->data_size, NULL);
+}
+
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -651,6 +924,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
 
    screen->winsys = winsys;
+   screen->use_nir = debug_get_bool_option("LP_NIR", FALSE);
 
    screen->base.destroy = llvmpipe_destroy_screen;
 
@@ -659,6 +933,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_device_vendor = llvmpipe_get_vendor; // TODO should be the CPU vendor
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
+   screen->base.get_compiler_options = llvmpipe_get_compiler_options;
    screen->base.get_paramf = llvmpipe_get_paramf;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
@@ -676,7 +952,6 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = 0;
 #endif
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
-   screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
@@ -686,5 +961,22 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
+   /* Contexts share the LLVM context on embedded platforms, so they can't
+    * compile in the background.
+    */
+#ifndef PIPE_SUBSYSTEM_EMBEDDED
+   if (util_cpu_caps.nr_cpus > 1 && !(LP_PERF & PERF_NO_ASYNC)) {
+      unsigned num_compile_threads = CLAMP(util_cpu_caps.nr_cpus / 2, 1, 4);
+
+      screen->async_fs_compile =
+         util_queue_init(&screen->fs_compile_queue, "lpfs", 32,
+                         num_compile_threads,
+                         UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                         UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY);
+   }
+#endif
+
+   lp_disk_cache_create(screen);
+
    return &screen->base;
 }
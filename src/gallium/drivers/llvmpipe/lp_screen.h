@@ -37,10 +37,14 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_queue.h"
 #include "gallivm/lp_bld.h"
 
 
 struct sw_winsys;
+struct lp_fence;
+struct lp_cached_code;
+struct disk_cache;
 
 
 struct llvmpipe_screen
@@ -57,6 +61,26 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
+
+   /** Fence of the most recently queued scene, protected by rast_mutex.
+    * Scenes are rasterized in queue order, so once this is signalled all
+    * rendering submitted by any context has completed.
+    */
+   struct lp_fence *last_fence;
+
+   /**
+    * Persistent cache of generated shader code, may be NULL.  Not handed
+    * to the state tracker through get_disk_shader_cache, which would make
+    * it cache TGSI/NIR in it as well.
+    */
+   struct disk_cache *disk_shader_cache;
+
+   /** Background compilation of optimized fragment shader variants */
+   struct util_queue fs_compile_queue;
+   boolean async_fs_compile;
+
+   /** Ask for fragment shaders in NIR rather than TGSI */
+   boolean use_nir;
 };
 
 
@@ -69,5 +93,15 @@ llvmpipe_screen( struct pipe_screen *pipe )
 }
 
 
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20]);
+
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20]);
+
 
 #endif /* LP_SCREEN_H */
@@ -35,6 +35,7 @@
 #include <limits.h>
 
 #include "pipe/p_defines.h"
+#include "util/u_format.h"
 #include "util/u_framebuffer.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
@@ -64,23 +65,64 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
+/**
+ * Wait for a scene handed to the rasterizer to finish and release all the
+ * data it holds, so that it can be used for binning again.
+ */
+static void
+lp_setup_recycle_scene(struct lp_scene *scene)
+{
+   if (scene->fence) {
+      if (LP_DEBUG & DEBUG_SETUP)
+         debug_printf("%s: wait for scene %d\n",
+                      __FUNCTION__, scene->fence->id);
+
+      /* Note this also serializes against lp_fence_signal() still holding
+       * the fence mutex, which matters if we drop the last reference below.
+       */
+      if (lp_fence_issued(scene->fence))
+         lp_fence_wait(scene->fence);
+   }
+
+   lp_scene_recycle(scene);
+}
+
+
+/**
+ * Release the data of any scene the rasterizer has already finished with,
+ * without blocking.  Keeps completed scenes from holding on to resource
+ * references and bin memory until the ring comes around to them again.
+ */
+static void
+lp_setup_recycle_idle_scenes(struct lp_setup_context *setup)
+{
+   unsigned i;
+
+   for (i = 0; i < setup->num_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+
+      if (scene != setup->scene &&
+          scene->fence &&
+          lp_fence_issued(scene->fence) &&
+          lp_fence_signalled(scene->fence))
+         lp_setup_recycle_scene(scene);
+   }
+}
+
+
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
    assert(setup->scene == NULL);
 
    setup->scene_idx++;
-   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   setup->scene_idx %= setup->num_scenes;
 
    setup->scene = setup->scenes[setup->scene_idx];
 
-   if (setup->scene->fence) {
-      if (LP_DEBUG & DEBUG_SETUP)
-         debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
-
-      lp_fence_wait(setup->scene->fence);
-   }
+   /* The scene may still be queued or being rasterized.
+    */
+   lp_setup_recycle_scene(setup->scene);
 
    lp_scene_begin_binning(setup->scene, &setup->fb, setup->rasterizer_discard);
 
@@ -165,25 +207,20 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   mtx_lock(&screen->rast_mutex);
-
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* Hand the scene over to the rasterizer without waiting for it.  The
+    * scene is only reused once its fence has been signalled, see
+    * lp_setup_get_empty_scene(), so binning of the next scene overlaps
+    * with rasterization of this one.
     */
+   mtx_lock(&screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
+   lp_fence_reference(&screen->last_fence, scene->fence);
    mtx_unlock(&screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
+   lp_setup_recycle_idle_scenes( setup );
+
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
 }
 
@@ -199,9 +236,10 @@ begin_binning( struct lp_setup_context *setup )
    assert(scene);
    assert(scene->fence == NULL);
 
-   /* Always create a fence:
+   /* Always create a fence.  It is signalled once, by the rasterizer,
+    * after it is completely done with the scene:
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -342,7 +380,7 @@ set_scene_state( struct lp_setup_context *setup,
 
 fail:
    if (setup->scene) {
-      lp_scene_end_rasterization(setup->scene);
+      lp_scene_recycle(setup->scene);
       setup->scene = NULL;
    }
 
@@ -785,6 +823,124 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Fill in the jit texture description of a sampler view.
+ * The caller must hold a reference to the view's resource for as long as
+ * the jit texture is in use.
+ */
+void
+lp_setup_jit_texture(struct lp_jit_texture *jit_tex,
+                     struct pipe_sampler_view *view)
+{
+   struct pipe_resource *res = view->texture;
+   struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
+
+   if (!lp_tex->dt) {
+      /* regular texture - setup array of mipmap level offsets */
+      int j;
+      unsigned first_level = 0;
+      unsigned last_level = 0;
+
+      if (llvmpipe_resource_is_texture(res)) {
+         first_level = view->u.tex.first_level;
+         last_level = view->u.tex.last_level;
+         assert(first_level <= last_level);
+         assert(last_level <= res->last_level);
+         jit_tex->base = lp_tex->tex_data;
+      }
+      else {
+        jit_tex->base = lp_tex->data;
+      }
+
+      if (LP_PERF & PERF_TEX_MEM) {
+         /* use dummy tile memory */
+         jit_tex->base = lp_dummy_tile;
+         jit_tex->width = TILE_SIZE/8;
+         jit_tex->height = TILE_SIZE/8;
+         jit_tex->depth = 1;
+         jit_tex->first_level = 0;
+         jit_tex->last_level = 0;
+         jit_tex->mip_offsets[0] = 0;
+         jit_tex->row_stride[0] = 0;
+         jit_tex->img_stride[0] = 0;
+      }
+      else {
+         jit_tex->width = res->width0;
+         jit_tex->height = res->height0;
+         jit_tex->depth = res->depth0;
+         jit_tex->first_level = first_level;
+         jit_tex->last_level = last_level;
+
+         if (llvmpipe_resource_is_texture(res)) {
+            for (j = first_level; j <= last_level; j++) {
+               jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
+               jit_tex->row_stride[j] = lp_tex->row_stride[j];
+               jit_tex->img_stride[j] = lp_tex->img_stride[j];
+            }
+
+            if (res->target == PIPE_TEXTURE_1D_ARRAY ||
+                res->target == PIPE_TEXTURE_2D_ARRAY ||
+                res->target == PIPE_TEXTURE_CUBE ||
+                res->target == PIPE_TEXTURE_CUBE_ARRAY) {
+               /*
+                * For array textures, we don't have first_layer, instead
+                * adjust last_layer (stored as depth) plus the mip level offsets
+                * (as we have mip-first layout can't just adjust base ptr).
+                * XXX For mip levels, could do something similar.
+                */
+               jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+               for (j = first_level; j <= last_level; j++) {
+                  jit_tex->mip_offsets[j] += view->u.tex.first_layer *
+                                             lp_tex->img_stride[j];
+               }
+               if (view->target == PIPE_TEXTURE_CUBE ||
+                   view->target == PIPE_TEXTURE_CUBE_ARRAY) {
+                  assert(jit_tex->depth % 6 == 0);
+               }
+               assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+               assert(view->u.tex.last_layer < res->array_size);
+            }
+         }
+         else {
+            /*
+             * For buffers, we don't have "offset", instead adjust
+             * the size (stored as width) plus the base pointer.
+             */
+            unsigned view_blocksize = util_format_get_blocksize(view->format);
+            /* probably don't really need to fill that out */
+            jit_tex->mip_offsets[0] = 0;
+            jit_tex->row_stride[0] = 0;
+            jit_tex->img_stride[0] = 0;
+
+            /* everything specified in number of elements here. */
+            jit_tex->width = view->u.buf.size / view_blocksize;
+            jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
+            /* XXX Unsure if we need to sanitize parameters? */
+            assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+         }
+      }
+   }
+   else {
+      /* display target texture/surface */
+      /*
+       * XXX: Where should this be unmapped?
+       */
+      struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
+      struct sw_winsys *winsys = screen->winsys;
+      jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
+                                                   PIPE_TRANSFER_READ);
+      jit_tex->row_stride[0] = lp_tex->row_stride[0];
+      jit_tex->img_stride[0] = lp_tex->img_stride[0];
+      jit_tex->mip_offsets[0] = 0;
+      jit_tex->width = res->width0;
+      jit_tex->height = res->height0;
+      jit_tex->depth = res->depth0;
+      jit_tex->first_level = jit_tex->last_level = 0;
+      assert(jit_tex->base);
+   }
+}
+
+
 /**
  * Called during state validation when LP_NEW_SAMPLER_VIEW is set.
  */
@@ -806,7 +962,6 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
 
       if (view) {
          struct pipe_resource *res = view->texture;
-         struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
          struct lp_jit_texture *jit_tex;
          jit_tex = &setup->fs.current.jit_context.textures[i];
 
@@ -815,109 +970,7 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
           */
          pipe_resource_reference(&setup->fs.current_tex[i], res);
 
-         if (!lp_tex->dt) {
-            /* regular texture - setup array of mipmap level offsets */
-            int j;
-            unsigned first_level = 0;
-            unsigned last_level = 0;
-
-            if (llvmpipe_resource_is_texture(res)) {
-               first_level = view->u.tex.first_level;
-               last_level = view->u.tex.last_level;
-               assert(first_level <= last_level);
-               assert(last_level <= res->last_level);
-               jit_tex->base = lp_tex->tex_data;
-            }
-            else {
-              jit_tex->base = lp_tex->data;
-            }
-
-            if (LP_PERF & PERF_TEX_MEM) {
-               /* use dummy tile memory */
-               jit_tex->base = lp_dummy_tile;
-               jit_tex->width = TILE_SIZE/8;
-               jit_tex->height = TILE_SIZE/8;
-               jit_tex->depth = 1;
-               jit_tex->first_level = 0;
-               jit_tex->last_level = 0;
-               jit_tex->mip_offsets[0] = 0;
-               jit_tex->row_stride[0] = 0;
-               jit_tex->img_stride[0] = 0;
-            }
-            else {
-               jit_tex->width = res->width0;
-               jit_tex->height = res->height0;
-               jit_tex->depth = res->depth0;
-               jit_tex->first_level = first_level;
-               jit_tex->last_level = last_level;
-
-               if (llvmpipe_resource_is_texture(res)) {
-                  for (j = first_level; j <= last_level; j++) {
-                     jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
-                     jit_tex->row_stride[j] = lp_tex->row_stride[j];
-                     jit_tex->img_stride[j] = lp_tex->img_stride[j];
-                  }
-
-                  if (res->target == PIPE_TEXTURE_1D_ARRAY ||
-                      res->target == PIPE_TEXTURE_2D_ARRAY ||
-                      res->target == PIPE_TEXTURE_CUBE ||
-                      res->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                     /*
-                      * For array textures, we don't have first_layer, instead
-                      * adjust last_layer (stored as depth) plus the mip level offsets
-                      * (as we have mip-first layout can't just adjust base ptr).
-                      * XXX For mip levels, could do something similar.
-                      */
-                     jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
-                     for (j = first_level; j <= last_level; j++) {
-                        jit_tex->mip_offsets[j] += view->u.tex.first_layer *
-                                                   lp_tex->img_stride[j];
-                     }
-                     if (view->target == PIPE_TEXTURE_CUBE ||
-                         view->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                        assert(jit_tex->depth % 6 == 0);
-                     }
-                     assert(view->u.tex.first_layer <= view->u.tex.last_layer);
-                     assert(view->u.tex.last_layer < res->array_size);
-                  }
-               }
-               else {
-                  /*
-                   * For buffers, we don't have "offset", instead adjust
-                   * the size (stored as width) plus the base pointer.
-                   */
-                  unsigned view_blocksize = util_format_get_blocksize(view->format);
-                  /* probably don't really need to fill that out */
-                  jit_tex->mip_offsets[0] = 0;
-                  jit_tex->row_stride[0] = 0;
-                  jit_tex->img_stride[0] = 0;
-
-                  /* everything specified in number of elements here. */
-                  jit_tex->width = view->u.buf.size / view_blocksize;
-                  jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
-                  /* XXX Unsure if we need to sanitize parameters? */
-                  assert(view->u.buf.offset + view->u.buf.size <= res->width0);
-               }
-            }
-         }
-         else {
-            /* display target texture/surface */
-            /*
-             * XXX: Where should this be unmapped?
-             */
-            struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
-            struct sw_winsys *winsys = screen->winsys;
-            jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
-                                                         PIPE_TRANSFER_READ);
-            jit_tex->row_stride[0] = lp_tex->row_stride[0];
-            jit_tex->img_stride[0] = lp_tex->img_stride[0];
-            jit_tex->mip_offsets[0] = 0;
-            jit_tex->width = res->width0;
-            jit_tex->height = res->height0;
-            jit_tex->depth = res->depth0;
-            jit_tex->first_level = jit_tex->last_level = 0;
-            assert(jit_tex->base);
-         }
+         lp_setup_jit_texture(jit_tex, view);
       }
       else {
          pipe_resource_reference(&setup->fs.current_tex[i], NULL);
@@ -929,6 +982,149 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Fill in the jit pointer and size of a shader buffer, an unbound or out
+ * of range buffer gets size zero.
+ * The caller must hold a reference to the buffer for as long as the
+ * pointer is in use.
+ */
+void
+lp_setup_jit_ssbo(uint8_t **jit_ssbo,
+                  uint32_t *jit_ssbo_size,
+                  const struct pipe_shader_buffer *buffer)
+{
+   if (buffer->buffer &&
+       buffer->buffer_offset < buffer->buffer->width0) {
+      *jit_ssbo = (uint8_t *) llvmpipe_resource_data(buffer->buffer) +
+                  buffer->buffer_offset;
+      *jit_ssbo_size = MIN2(buffer->buffer_size,
+                            buffer->buffer->width0 - buffer->buffer_offset);
+   }
+   else {
+      *jit_ssbo = NULL;
+      *jit_ssbo_size = 0;
+   }
+}
+
+
+/**
+ * Fill in the jit image description of an image view.  Unbound views, and
+ * the ones the generated code can't access, get width zero, which makes
+ * every access out of bounds.
+ * The caller must hold a reference to the view's resource for as long as
+ * the jit image is in use.
+ */
+void
+lp_setup_jit_image(struct lp_jit_image *jit_img,
+                   const struct pipe_image_view *view)
+{
+   const struct util_format_description *desc;
+   struct pipe_resource *res = view->resource;
+   struct llvmpipe_resource *lp_res;
+
+   memset(jit_img, 0, sizeof *jit_img);
+
+   if (!res || res->nr_samples > 1)
+      return;
+
+   lp_res = llvmpipe_resource(res);
+   if (lp_res->dt)
+      return;
+
+   desc = util_format_description(view->format);
+   if (!desc || desc->block.width != 1 || desc->block.height != 1)
+      return;
+
+   if (util_format_is_pure_uint(view->format))
+      jit_img->pack = (void *) desc->pack_rgba_uint;
+   else if (util_format_is_pure_sint(view->format))
+      jit_img->pack = (void *) desc->pack_rgba_sint;
+   else
+      jit_img->pack = (void *) desc->pack_rgba_float;
+   if (!jit_img->pack)
+      return;
+
+   jit_img->cpp = desc->block.bits / 8;
+
+   if (llvmpipe_resource_is_texture(res)) {
+      unsigned level = view->u.tex.level;
+
+      if (level > res->last_level ||
+          view->u.tex.first_layer > view->u.tex.last_layer)
+         return;
+
+      jit_img->base = (uint8_t *) lp_res->tex_data +
+                      lp_res->mip_offsets[level] +
+                      view->u.tex.first_layer * lp_res->img_stride[level];
+      jit_img->row_stride = lp_res->row_stride[level];
+      jit_img->img_stride = lp_res->img_stride[level];
+      jit_img->height = u_minify(res->height0, level);
+      jit_img->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+      jit_img->width = u_minify(res->width0, level);
+   }
+   else {
+      unsigned offset = MIN2(view->u.buf.offset, res->width0);
+
+      jit_img->base = (uint8_t *) lp_res->data + offset;
+      jit_img->height = 1;
+      jit_img->depth = 1;
+      jit_img->width = MIN2(view->u.buf.size, res->width0 - offset) /
+                       jit_img->cpp;
+   }
+}
+
+
+/**
+ * Called during state validation when LP_NEW_FS_SSBOS is set.
+ */
+void
+lp_setup_set_fs_ssbos(struct lp_setup_context *setup,
+                      unsigned num,
+                      const struct pipe_shader_buffer *buffers)
+{
+   unsigned i;
+
+   LP_DBG(DEBUG_SETUP, "%s %p\n", __FUNCTION__, (void *) buffers);
+
+   assert(num <= ARRAY_SIZE(setup->fs.current_ssbos));
+
+   for (i = 0; i < num; i++) {
+      pipe_resource_reference(&setup->fs.current_ssbos[i],
+                              buffers[i].buffer);
+      lp_setup_jit_ssbo(&setup->fs.current.jit_context.ssbos[i],
+                        &setup->fs.current.jit_context.ssbo_sizes[i],
+                        &buffers[i]);
+   }
+
+   setup->dirty |= LP_SETUP_NEW_FS;
+}
+
+
+/**
+ * Called during state validation when LP_NEW_FS_IMAGES is set.
+ */
+void
+lp_setup_set_fs_images(struct lp_setup_context *setup,
+                       unsigned num,
+                       const struct pipe_image_view *images)
+{
+   unsigned i;
+
+   LP_DBG(DEBUG_SETUP, "%s %p\n", __FUNCTION__, (void *) images);
+
+   assert(num <= ARRAY_SIZE(setup->fs.current_images));
+
+   for (i = 0; i < num; i++) {
+      pipe_resource_reference(&setup->fs.current_images[i],
+                              images[i].resource);
+      lp_setup_jit_image(&setup->fs.current.jit_context.images[i],
+                         &images[i]);
+   }
+
+   setup->dirty |= LP_SETUP_NEW_FS;
+}
+
+
 /**
  * Called during state validation when LP_NEW_SAMPLER is set.
  */
@@ -964,7 +1160,8 @@ lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
 /**
  * Is the given texture referenced by any scene?
  * Note: we have to check all scenes including any scenes currently
- * being rendered and the current scene being built.
+ * being rendered and the current scene being built.  Scenes whose
+ * fence has already been signalled are done and can be skipped.
  */
 unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
@@ -981,11 +1178,21 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
-      }
+   /* check the scene being built and all scenes still being rasterized,
+    * including their render targets which may differ from the current ones
+    */
+   for (i = 0; i < setup->num_scenes; i++) {
+      const struct lp_scene *scene = setup->scenes[i];
+      unsigned referenced;
+
+      if (scene->fence &&
+          lp_fence_issued(scene->fence) &&
+          lp_fence_signalled(scene->fence))
+         continue;
+
+      referenced = lp_scene_is_resource_referenced(scene, texture);
+      if (referenced)
+         return referenced;
    }
 
    return LP_UNREFERENCED;
@@ -1162,12 +1369,41 @@ try_update_scene_state( struct lp_setup_context *setup )
             if (setup->fs.current_tex[i]) {
                if (!lp_scene_add_resource_reference(scene,
                                                     setup->fs.current_tex[i],
+                                                    FALSE,
+                                                    new_scene)) {
+                  assert(!new_scene);
+                  return FALSE;
+               }
+            }
+         }
+
+         /* Shader buffers and images may also be written by the shader. */
+         for (i = 0; i < ARRAY_SIZE(setup->fs.current_ssbos); i++) {
+            if (setup->fs.current_ssbos[i]) {
+               if (!lp_scene_add_resource_reference(scene,
+                                                    setup->fs.current_ssbos[i],
+                                                    TRUE,
                                                     new_scene)) {
                   assert(!new_scene);
                   return FALSE;
                }
             }
          }
+         for (i = 0; i < ARRAY_SIZE(setup->fs.current_images); i++) {
+            if (setup->fs.current_images[i]) {
+               if (!lp_scene_add_resource_reference(scene,
+                                                    setup->fs.current_images[i],
+                                                    TRUE,
+                                                    new_scene)) {
+                  assert(!new_scene);
+                  return FALSE;
+               }
+            }
+         }
+
+         if (setup->fs.current.variant &&
+             setup->fs.current.variant->shader->info.base.writes_memory)
+            scene->fs_writes_memory = TRUE;
       }
    }
 
@@ -1279,17 +1515,23 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->fs.current_tex[i], NULL);
    }
 
+   for (i = 0; i < ARRAY_SIZE(setup->fs.current_ssbos); i++) {
+      pipe_resource_reference(&setup->fs.current_ssbos[i], NULL);
+   }
+
+   for (i = 0; i < ARRAY_SIZE(setup->fs.current_images); i++) {
+      pipe_resource_reference(&setup->fs.current_images[i], NULL);
+   }
+
    for (i = 0; i < ARRAY_SIZE(setup->constants); i++) {
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+   /* wait for any scenes still in flight, then free them all */
+   for (i = 0; i < setup->num_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
-         lp_fence_wait(scene->fence);
-
+      lp_setup_recycle_scene(scene);
       lp_scene_destroy(scene);
    }
 
@@ -1333,8 +1575,12 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
+   setup->num_scenes = debug_get_num_option("LP_NUM_SCENES",
+                                            LP_DEFAULT_NUM_SCENES);
+   setup->num_scenes = CLAMP(setup->num_scenes, 1, MAX_SCENES);
+
    /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
+   for (i = 0; i < setup->num_scenes; i++) {
       setup->scenes[i] = lp_scene_create( pipe );
       if (!setup->scenes[i]) {
          goto no_scenes;
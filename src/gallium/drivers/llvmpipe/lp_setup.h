@@ -44,6 +44,8 @@ struct lp_fragment_shader_variant;
 struct lp_jit_context;
 struct llvmpipe_query;
 struct pipe_fence_handle;
+struct pipe_shader_buffer;
+struct pipe_image_view;
 struct lp_setup_variant;
 struct lp_setup_context;
 
@@ -125,11 +127,34 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
                        unsigned num_viewports,
                        const struct pipe_viewport_state *viewports);
 
+void
+lp_setup_jit_texture(struct lp_jit_texture *jit_tex,
+                     struct pipe_sampler_view *view);
+
 void
 lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
                                     unsigned num,
                                     struct pipe_sampler_view **views);
 
+void
+lp_setup_jit_ssbo(uint8_t **jit_ssbo,
+                  uint32_t *jit_ssbo_size,
+                  const struct pipe_shader_buffer *buffer);
+
+void
+lp_setup_jit_image(struct lp_jit_image *jit_img,
+                   const struct pipe_image_view *view);
+
+void
+lp_setup_set_fs_ssbos(struct lp_setup_context *setup,
+                      unsigned num,
+                      const struct pipe_shader_buffer *buffers);
+
+void
+lp_setup_set_fs_images(struct lp_setup_context *setup,
+                       unsigned num,
+                       const struct pipe_image_view *images);
+
 void
 lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
                                     unsigned num,
@@ -55,8 +55,14 @@ struct lp_setup_variant;
 
 
 /** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
+#define MAX_SCENES 16
+
+/**
+ * Default number of scenes per context.  Binning of a new scene can
+ * proceed while up to (num_scenes - 1) older scenes are still being
+ * rasterized.  Can be overridden with the LP_NUM_SCENES env var.
+ */
+#define LP_DEFAULT_NUM_SCENES 4
 
 
 
@@ -87,6 +93,7 @@ struct lp_setup_context
     */
    struct draw_stage *vbuf;
    unsigned num_threads;
+   unsigned num_scenes;
    unsigned scene_idx;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
@@ -134,6 +141,8 @@ struct lp_setup_context
       struct lp_rast_state current;  /**< currently set state */
       struct pipe_resource *current_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
       unsigned current_tex_num;
+      struct pipe_resource *current_ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+      struct pipe_resource *current_images[LP_MAX_TGSI_SHADER_IMAGES];
    } fs;
 
    /** fragment shader constants */
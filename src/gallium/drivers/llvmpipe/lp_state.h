@@ -56,6 +56,10 @@
 #define LP_NEW_GS            0x10000
 #define LP_NEW_SO            0x20000
 #define LP_NEW_SO_BUFFERS    0x40000
+#define LP_NEW_FS_SSBOS      0x80000
+#define LP_NEW_FS_IMAGES     0x100000
+#define LP_NEW_TCS           0x200000
+#define LP_NEW_TES           0x400000
 
 
 
@@ -120,6 +124,12 @@ llvmpipe_init_vs_funcs(struct llvmpipe_context *llvmpipe);
 void
 llvmpipe_init_gs_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_init_tess_funcs(struct llvmpipe_context *llvmpipe);
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe);
+
 void
 llvmpipe_init_rasterizer_funcs(struct llvmpipe_context *llvmpipe);
 
@@ -136,4 +146,14 @@ llvmpipe_prepare_geometry_sampling(struct llvmpipe_context *ctx,
                                    unsigned num,
                                    struct pipe_sampler_view **views);
 
+void
+llvmpipe_prepare_tess_ctrl_sampling(struct llvmpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+
+void
+llvmpipe_prepare_tess_eval_sampling(struct llvmpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+
 #endif
@@ -0,0 +1,1258 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * Each variant is a function running one vector of invocations of a work
+ * group.  A grid is run by the rasterizer threads, each of them taking
+ * whole work groups in turn, so no synchronization is needed between the
+ * invocations of a work group except for barriers.  When the shader has
+ * barriers each vector of the work group runs on its own fiber, and a
+ * barrier switches back to the thread's scheduler, which resumes the
+ * fibers round robin.  Where fibers aren't available a single rasterizer
+ * thread runs the grid, with one helper thread per other vector of the
+ * work group, and barriers wait for all of them.
+ */
+
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_atomic.h"
+#include "util/u_pointer.h"
+#include "util/u_string.h"
+#include "util/u_thread.h"
+#include "util/simple_list.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_swizzle.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_tgsi.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_fence.h"
+#include "lp_flush.h"
+#include "lp_limits.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_setup.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_tex_sample.h"
+#include "lp_texture.h"
+
+#if defined(PIPE_OS_WINDOWS)
+#include <windows.h>
+#elif defined(LP_CS_FIBERS)
+#include <ucontext.h>
+#endif
+
+
+/** Compute shader number (for debugging) */
+static unsigned cs_no = 0;
+
+/** Stack size of the fibers running the invocations of a work group */
+#define LP_CS_FIBER_STACK_SIZE (128 * 1024)
+
+
+/**
+ * The shader state a grid is run with, shared by the threads.
+ */
+struct lp_cs_job
+{
+   const struct lp_compute_shader_variant *variant;
+
+   struct lp_jit_context jit_context;
+   uint32_t grid_size[3];
+
+   uint64_t num_blocks;
+   unsigned vectors_per_block;
+   unsigned shared_size;
+   boolean use_fibers;
+   boolean use_threads;
+
+   /** Index of the next work group to run */
+   int64_t next_block;
+};
+
+
+struct lp_cs_fiber
+{
+   boolean done;
+#if defined(PIPE_OS_WINDOWS)
+   LPVOID fiber;
+#elif defined(LP_CS_FIBERS)
+   ucontext_t context;
+   void *stack;
+#endif
+};
+
+
+/**
+ * State of a thread while it runs a grid.
+ */
+struct lp_cs_thread
+{
+   struct lp_cs_job *job;
+   struct lp_jit_thread_data *thread_data;
+
+   uint8_t *shared;
+   uint32_t block_id[3];
+
+   /** One fiber per vector of the work group, when there are barriers */
+   struct lp_cs_fiber *fibers;
+   unsigned current_fiber;
+#if defined(PIPE_OS_WINDOWS)
+   LPVOID main_fiber;
+#elif defined(LP_CS_FIBERS)
+   ucontext_t main_context;
+#else
+   struct lp_cs_group *group;
+#endif
+};
+
+
+#if !defined(LP_CS_FIBERS)
+
+/**
+ * The threads running the vectors of a work group together.
+ */
+struct lp_cs_group
+{
+   /** Waited for by all the vectors at barriers and around work groups */
+   util_barrier barrier;
+
+   /** Held while the helpers are created */
+   mtx_t start_mutex;
+   boolean failed;
+
+   /** No work group is left */
+   boolean done;
+};
+
+
+struct lp_cs_helper
+{
+   struct lp_cs_thread thread;
+   struct lp_jit_thread_data thread_data;
+   unsigned vector;
+   thrd_t handle;
+};
+
+#endif
+
+
+/** Subclass of lp_jit_mem_iface */
+struct lp_cs_iface
+{
+   struct lp_jit_mem_iface base;
+
+   LLVMValueRef barrier_data;
+};
+
+
+static void
+cs_run_vector(struct lp_cs_thread *thread,
+              unsigned vector,
+              void *barrier_data)
+{
+   struct lp_cs_job *job = thread->job;
+
+   job->variant->jit_function(&job->jit_context,
+                              thread->thread_data,
+                              thread->shared,
+                              thread->block_id,
+                              job->grid_size,
+                              vector * job->variant->vector_length,
+                              barrier_data);
+}
+
+
+/**
+ * Called by the generated code at a barrier, with the lp_cs_thread as
+ * barrier data.
+ */
+static void
+lp_cs_barrier(void *data)
+{
+#if defined(LP_CS_FIBERS)
+   struct lp_cs_thread *thread = (struct lp_cs_thread *) data;
+
+   /* Work groups of a single vector don't use fibers nor need waiting. */
+   if (!thread)
+      return;
+
+   /* The scheduler resumes us once every other fiber got here. */
+#if defined(PIPE_OS_WINDOWS)
+   SwitchToFiber(thread->main_fiber);
+#else
+   swapcontext(&thread->fibers[thread->current_fiber].context,
+               &thread->main_context);
+#endif
+#else
+   struct lp_cs_thread *thread = (struct lp_cs_thread *) data;
+
+   if (!thread)
+      return;
+
+   util_barrier_wait(&thread->group->barrier);
+#endif
+}
+
+
+#if defined(LP_CS_FIBERS)
+
+#if defined(PIPE_OS_WINDOWS)
+
+/* The fibers are created once per thread and run the same vector of every
+ * work group the thread takes, so nothing is allocated per work group.
+ */
+static VOID CALLBACK
+cs_fiber_entry(LPVOID data)
+{
+   struct lp_cs_thread *thread = (struct lp_cs_thread *) data;
+
+   for (;;) {
+      unsigned vector = thread->current_fiber;
+
+      cs_run_vector(thread, vector, thread);
+      thread->fibers[vector].done = TRUE;
+
+      /* Fibers must not return, resumed for the next work group. */
+      SwitchToFiber(thread->main_fiber);
+   }
+}
+
+#else
+
+/* makecontext() only passes ints, so the pointer is split in two. */
+static void
+cs_fiber_entry(int hi, int lo)
+{
+   struct lp_cs_thread *thread = (struct lp_cs_thread *)
+      (uintptr_t) (((uint64_t) (unsigned) hi << 32) | (unsigned) lo);
+   unsigned vector = thread->current_fiber;
+
+   cs_run_vector(thread, vector, thread);
+   thread->fibers[vector].done = TRUE;
+
+   /* Returning resumes uc_link, the scheduler. */
+}
+
+#endif
+
+
+static boolean
+cs_init_fibers(struct lp_cs_thread *thread)
+{
+   unsigned num_fibers = thread->job->vectors_per_block;
+
+   thread->fibers = CALLOC(num_fibers, sizeof(struct lp_cs_fiber));
+   if (!thread->fibers)
+      return FALSE;
+
+#if defined(PIPE_OS_WINDOWS)
+   thread->main_fiber = ConvertThreadToFiber(NULL);
+   if (!thread->main_fiber)
+      return FALSE;
+
+   {
+      unsigned i;
+
+      for (i = 0; i < num_fibers; i++) {
+         thread->fibers[i].fiber = CreateFiber(LP_CS_FIBER_STACK_SIZE,
+                                               cs_fiber_entry, thread);
+         if (!thread->fibers[i].fiber)
+            return FALSE;
+      }
+   }
+#else
+   {
+      unsigned i;
+
+      for (i = 0; i < num_fibers; i++) {
+         thread->fibers[i].stack = MALLOC(LP_CS_FIBER_STACK_SIZE);
+         if (!thread->fibers[i].stack)
+            return FALSE;
+      }
+   }
+#endif
+
+   return TRUE;
+}
+
+
+static void
+cs_fini_fibers(struct lp_cs_thread *thread)
+{
+   if (!thread->fibers)
+      return;
+
+#if defined(PIPE_OS_WINDOWS)
+   {
+      unsigned i;
+
+      for (i = 0; i < thread->job->vectors_per_block; i++) {
+         if (thread->fibers[i].fiber)
+            DeleteFiber(thread->fibers[i].fiber);
+      }
+   }
+   if (thread->main_fiber)
+      ConvertFiberToThread();
+#else
+   {
+      unsigned i;
+
+      for (i = 0; i < thread->job->vectors_per_block; i++)
+         FREE(thread->fibers[i].stack);
+   }
+#endif
+
+   FREE(thread->fibers);
+   thread->fibers = NULL;
+}
+
+
+/**
+ * Run a work group whose shader has barriers.  Every round resumes each
+ * unfinished fiber until its next barrier, so no vector gets past a
+ * barrier before all of them reached it.
+ */
+static void
+cs_run_block_fibers(struct lp_cs_thread *thread)
+{
+   unsigned num_fibers = thread->job->vectors_per_block;
+   unsigned remaining = num_fibers;
+   unsigned i;
+
+   for (i = 0; i < num_fibers; i++) {
+      struct lp_cs_fiber *fiber = &thread->fibers[i];
+
+      fiber->done = FALSE;
+#if !defined(PIPE_OS_WINDOWS)
+      {
+         uint64_t ptr = (uintptr_t) thread;
+
+         getcontext(&fiber->context);
+         fiber->context.uc_stack.ss_sp = fiber->stack;
+         fiber->context.uc_stack.ss_size = LP_CS_FIBER_STACK_SIZE;
+         fiber->context.uc_link = &thread->main_context;
+         makecontext(&fiber->context, (void (*)(void)) cs_fiber_entry, 2,
+                     (int) (ptr >> 32), (int) ptr);
+      }
+#endif
+   }
+
+   while (remaining) {
+      for (i = 0; i < num_fibers; i++) {
+         struct lp_cs_fiber *fiber = &thread->fibers[i];
+
+         if (fiber->done)
+            continue;
+
+         thread->current_fiber = i;
+#if defined(PIPE_OS_WINDOWS)
+         SwitchToFiber(fiber->fiber);
+#else
+         swapcontext(&thread->main_context, &fiber->context);
+#endif
+
+         if (fiber->done)
+            remaining--;
+      }
+   }
+}
+
+#else /* !LP_CS_FIBERS */
+
+
+static int
+cs_helper_thread(void *data)
+{
+   struct lp_cs_helper *helper = (struct lp_cs_helper *) data;
+   struct lp_cs_thread *thread = &helper->thread;
+   struct lp_cs_group *group = thread->group;
+   boolean failed;
+
+   mtx_lock(&group->start_mutex);
+   failed = group->failed;
+   mtx_unlock(&group->start_mutex);
+
+   if (failed)
+      return 0;
+
+   for (;;) {
+      util_barrier_wait(&group->barrier);
+      if (group->done)
+         break;
+
+      cs_run_vector(thread, helper->vector, thread);
+      util_barrier_wait(&group->barrier);
+   }
+
+   return 0;
+}
+
+
+/**
+ * Run the work groups of a shader with barriers, the calling thread runs
+ * the first vector of each and a helper thread each other vector.  The
+ * barrier is waited for before and after every work group, so the helpers
+ * always see the current block id.
+ */
+static void
+cs_run_blocks_threads(struct lp_cs_thread *thread)
+{
+   struct lp_cs_job *job = thread->job;
+   unsigned num_helpers = job->vectors_per_block - 1;
+   struct lp_cs_helper *helpers;
+   struct lp_cs_group group;
+   unsigned created = 0;
+   uint64_t block;
+   unsigned i;
+
+   helpers = CALLOC(num_helpers, sizeof *helpers);
+   if (!helpers)
+      return;
+
+   memset(&group, 0, sizeof group);
+   util_barrier_init(&group.barrier, job->vectors_per_block);
+   (void) mtx_init(&group.start_mutex, mtx_plain);
+   thread->group = &group;
+
+   /* The helpers check for failure first thing, so that none waits for
+    * the barrier when some couldn't be created.
+    */
+   mtx_lock(&group.start_mutex);
+   for (i = 0; i < num_helpers; i++) {
+      struct lp_cs_helper *helper = &helpers[i];
+
+      helper->thread.job = job;
+      helper->thread.thread_data = &helper->thread_data;
+      helper->thread.shared = thread->shared;
+      helper->thread.group = &group;
+      helper->vector = i + 1;
+
+      helper->thread_data.cache =
+         align_malloc(sizeof(struct lp_build_format_cache), 16);
+      if (!helper->thread_data.cache) {
+         group.failed = TRUE;
+         break;
+      }
+      memset(helper->thread_data.cache, 0,
+             sizeof(struct lp_build_format_cache));
+
+      helper->handle = u_thread_create(cs_helper_thread, helper);
+      if (!helper->handle) {
+         group.failed = TRUE;
+         break;
+      }
+      created++;
+   }
+   mtx_unlock(&group.start_mutex);
+
+   if (!group.failed) {
+      while ((block = p_atomic_inc_return(&job->next_block) - 1) <
+             job->num_blocks) {
+         uint64_t yz = block / job->grid_size[0];
+
+         thread->block_id[0] = block % job->grid_size[0];
+         thread->block_id[1] = yz % job->grid_size[1];
+         thread->block_id[2] = yz / job->grid_size[1];
+         for (i = 0; i < num_helpers; i++)
+            memcpy(helpers[i].thread.block_id, thread->block_id,
+                   sizeof thread->block_id);
+
+         util_barrier_wait(&group.barrier);
+         cs_run_vector(thread, 0, thread);
+         util_barrier_wait(&group.barrier);
+      }
+
+      group.done = TRUE;
+      util_barrier_wait(&group.barrier);
+   }
+
+   for (i = 0; i < created; i++)
+      thrd_join(helpers[i].handle, NULL);
+
+   for (i = 0; i < num_helpers; i++) {
+      if (helpers[i].thread_data.cache)
+         align_free(helpers[i].thread_data.cache);
+   }
+
+   mtx_destroy(&group.start_mutex);
+   util_barrier_destroy(&group.barrier);
+   FREE(helpers);
+   thread->group = NULL;
+}
+
+#endif /* LP_CS_FIBERS */
+
+
+/**
+ * Rasterizer thread entrypoint: run work groups until none is left.
+ *
+ * A thread which can't allocate what it needs leaves the work groups to
+ * the others, llvmpipe_launch_grid() notices if none could run them.
+ */
+static void
+cs_run_job(void *data,
+           unsigned thread_index,
+           struct lp_jit_thread_data *thread_data)
+{
+   struct lp_cs_job *job = (struct lp_cs_job *) data;
+   struct lp_cs_thread thread;
+   uint64_t block;
+   unsigned i;
+
+   /* The helper threads are created by the first thread alone. */
+   if (job->use_threads && thread_index != 0)
+      return;
+
+   memset(&thread, 0, sizeof thread);
+   thread.job = job;
+   thread.thread_data = thread_data;
+
+   thread.shared = align_malloc(MAX2(job->shared_size, 16), 16);
+   if (!thread.shared)
+      return;
+
+#if !defined(LP_CS_FIBERS)
+   if (job->use_threads) {
+      cs_run_blocks_threads(&thread);
+      align_free(thread.shared);
+      return;
+   }
+#endif
+
+#if defined(LP_CS_FIBERS)
+   if (job->use_fibers && !cs_init_fibers(&thread)) {
+      cs_fini_fibers(&thread);
+      align_free(thread.shared);
+      return;
+   }
+#endif
+
+   while ((block = p_atomic_inc_return(&job->next_block) - 1) <
+          job->num_blocks) {
+      uint64_t yz = block / job->grid_size[0];
+
+      thread.block_id[0] = block % job->grid_size[0];
+      thread.block_id[1] = yz % job->grid_size[1];
+      thread.block_id[2] = yz / job->grid_size[1];
+
+#if defined(LP_CS_FIBERS)
+      if (job->use_fibers) {
+         cs_run_block_fibers(&thread);
+         continue;
+      }
+#endif
+
+      /* Without barriers, or with a single vector, the vectors can simply
+       * run one after the other.
+       */
+      for (i = 0; i < job->vectors_per_block; i++)
+         cs_run_vector(&thread, i, NULL);
+   }
+
+#if defined(LP_CS_FIBERS)
+   cs_fini_fibers(&thread);
+#endif
+   align_free(thread.shared);
+}
+
+
+static void
+cs_emit_barrier(const struct lp_build_tgsi_mem_iface *mem_iface,
+                struct lp_build_tgsi_context *bld_base)
+{
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *) mem_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMValueRef barrier_data = iface->barrier_data;
+   LLVMTypeRef arg_type = LLVMTypeOf(barrier_data);
+   LLVMValueRef function;
+
+   function = lp_build_const_func_pointer(gallivm,
+                                          func_to_pointer((func_pointer)lp_cs_barrier),
+                                          LLVMVoidTypeInContext(gallivm->context),
+                                          &arg_type, 1, "lp_cs_barrier");
+
+   LLVMBuildCall(gallivm->builder, function, &barrier_data, 1, "");
+}
+
+
+/**
+ * Generate the function running one vector of invocations.
+ * Any change to the prototype must be reflected in lp_jit.h's
+ * lp_jit_cs_func, and vice-versa.
+ */
+static void
+generate_compute(struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   const struct lp_compute_shader_variant_key *key = &variant->key;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(lc);
+   LLVMTypeRef int8_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   LLVMTypeRef arg_types[7];
+   LLVMTypeRef func_type;
+   LLVMValueRef function;
+   LLVMValueRef context_ptr, thread_data_ptr;
+   LLVMValueRef shared_ptr, block_id_ptr, grid_size_ptr, invocation;
+   LLVMValueRef barrier_data;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef lanes[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef linear_id, block_width, block_height, tmp, mask_val;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_type cs_type;
+   struct lp_build_context uint_bld;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_mask_context mask;
+   struct lp_cs_iface cs_iface;
+   char func_name[64];
+   unsigned num_invocations;
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = MIN2(lp_native_vector_width / 32, 16);
+
+   variant->vector_length = cs_type.length;
+
+   util_snprintf(func_name, sizeof(func_name), "cs%u_variant%u",
+                 shader->no, variant->no);
+
+   arg_types[0] = variant->jit_context_ptr_type;       /* context */
+   arg_types[1] = variant->jit_thread_data_ptr_type;   /* per thread data */
+   arg_types[2] = int8_ptr_type;                       /* shared */
+   arg_types[3] = LLVMPointerType(int32_type, 0);      /* block_id */
+   arg_types[4] = LLVMPointerType(int32_type, 0);      /* grid_size */
+   arg_types[5] = int32_type;                          /* invocation */
+   arg_types[6] = int8_ptr_type;                       /* barrier_data */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(lc),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   variant->function = function;
+
+   context_ptr     = LLVMGetParam(function, 0);
+   thread_data_ptr = LLVMGetParam(function, 1);
+   shared_ptr      = LLVMGetParam(function, 2);
+   block_id_ptr    = LLVMGetParam(function, 3);
+   grid_size_ptr   = LLVMGetParam(function, 4);
+   invocation      = LLVMGetParam(function, 5);
+   barrier_data    = LLVMGetParam(function, 6);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(thread_data_ptr, "thread_data");
+   lp_build_name(shared_ptr, "shared");
+   lp_build_name(block_id_ptr, "block_id");
+   lp_build_name(grid_size_ptr, "grid_size");
+   lp_build_name(invocation, "invocation");
+   lp_build_name(barrier_data, "barrier_data");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(lc, function, "entry");
+   builder = gallivm->builder;
+   assert(builder);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(cs_type));
+
+   memset(&system_values, 0, sizeof system_values);
+
+   /* Linear index of each invocation within the work group */
+   for (i = 0; i < cs_type.length; i++)
+      lanes[i] = lp_build_const_int32(gallivm, i);
+   linear_id = LLVMBuildAdd(builder,
+                            lp_build_broadcast_scalar(&uint_bld, invocation),
+                            LLVMConstVector(lanes, cs_type.length), "");
+
+   block_width = lp_build_const_int_vec(gallivm, uint_bld.type,
+                                        key->block_size[0]);
+   block_height = lp_build_const_int_vec(gallivm, uint_bld.type,
+                                         key->block_size[1]);
+
+   system_values.thread_id[0] = LLVMBuildURem(builder, linear_id,
+                                              block_width, "");
+   tmp = LLVMBuildUDiv(builder, linear_id, block_width, "");
+   system_values.thread_id[1] = LLVMBuildURem(builder, tmp, block_height, "");
+   system_values.thread_id[2] = LLVMBuildUDiv(builder, tmp, block_height, "");
+
+   for (i = 0; i < 3; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+
+      system_values.block_id[i] =
+         LLVMBuildLoad(builder,
+                       LLVMBuildGEP(builder, block_id_ptr, &index, 1, ""),
+                       "");
+      system_values.grid_size[i] =
+         LLVMBuildLoad(builder,
+                       LLVMBuildGEP(builder, grid_size_ptr, &index, 1, ""),
+                       "");
+      system_values.block_size[i] =
+         lp_build_const_int32(gallivm, key->block_size[i]);
+   }
+
+   /* The last vector of a work group may be partially used. */
+   num_invocations = key->block_size[0] * key->block_size[1] *
+                     key->block_size[2];
+   mask_val = lp_build_cmp(&uint_bld, PIPE_FUNC_LESS, linear_id,
+                           lp_build_const_int_vec(gallivm, uint_bld.type,
+                                                  num_invocations));
+   lp_build_mask_begin(&mask, gallivm, cs_type, mask_val);
+
+   consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_context_num_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = lp_llvm_sampler_soa_create(key->state);
+
+   lp_jit_init_mem_iface(&cs_iface.base, gallivm, context_ptr);
+   cs_iface.base.base.shared_ptr = shared_ptr;
+   cs_iface.base.base.shared_size =
+      lp_build_const_int32(gallivm, shader->base.req_local_mem);
+   cs_iface.base.base.emit_barrier = cs_emit_barrier;
+   cs_iface.barrier_data = barrier_data;
+
+   lp_build_tgsi_soa(gallivm, shader->base.prog, cs_type, &mask,
+                     consts_ptr, num_consts_ptr, &system_values,
+                     NULL, NULL, context_ptr, thread_data_ptr,
+                     sampler, &shader->info.base, NULL, &cs_iface.base.base,
+                     NULL);
+
+   lp_build_mask_end(&mask);
+
+   sampler->destroy(sampler);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct lp_compute_shader_variant_key *key)
+{
+   struct lp_compute_shader_variant *variant;
+   char module_name[64];
+
+   variant = CALLOC_STRUCT(lp_compute_shader_variant);
+   if (!variant)
+      return NULL;
+
+   variant->shader = shader;
+   variant->list_item.base = variant;
+   variant->no = shader->variants_created++;
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
+                 shader->no, variant->no);
+
+   /* Compute shaders aren't put in the shader cache. */
+   variant->gallivm = gallivm_create(module_name, lp->context, NULL);
+   if (!variant->gallivm) {
+      FREE(variant);
+      return NULL;
+   }
+
+   lp_jit_init_cs_types(variant);
+
+   generate_compute(shader, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_function = (lp_jit_cs_func)
+      gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   return variant;
+}
+
+
+static void
+destroy_variant(struct lp_compute_shader_variant *variant)
+{
+   remove_from_list(&variant->list_item);
+   gallivm_destroy(variant->gallivm);
+   FREE(variant);
+}
+
+
+static void
+make_variant_key(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct pipe_grid_info *info,
+                 struct lp_compute_shader_variant_key *key)
+{
+   unsigned i;
+
+   memset(key, 0, shader->variant_key_size);
+
+   for (i = 0; i < 3; i++)
+      key->block_size[i] = info->block[i];
+
+   /* This value will be the same for all the variants of a given shader:
+    */
+   key->nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
+
+   for (i = 0; i < key->nr_samplers; ++i) {
+      if (shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+         lp_sampler_static_sampler_state(&key->state[i].sampler_state,
+                                         lp->samplers[PIPE_SHADER_COMPUTE][i]);
+      }
+   }
+
+   /* See make_variant_key() in lp_state_fs.c */
+   if (shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+}
+
+
+/**
+ * Find or generate the variant of the bound compute shader for the
+ * current state.
+ */
+static struct lp_compute_shader_variant *
+llvmpipe_update_cs(struct llvmpipe_context *lp,
+                   const struct pipe_grid_info *info)
+{
+   struct lp_compute_shader *shader = lp->cs;
+   struct lp_compute_shader_variant_key key;
+   struct lp_compute_shader_variant *variant;
+   struct lp_cs_variant_list_item *li;
+   unsigned count = 0;
+
+   make_variant_key(lp, shader, info, &key);
+
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
+         /* Keep the list in least recently used order. */
+         move_to_head(&shader->variants, li);
+         return li->base;
+      }
+      li = next_elem(li);
+      count++;
+   }
+
+   /* Grids run synchronously, so old variants can be dropped right away. */
+   if (count >= LP_MAX_CS_VARIANTS)
+      destroy_variant(last_elem(&shader->variants)->base);
+
+   variant = generate_variant(lp, shader, &key);
+   if (variant)
+      insert_at_head(&shader->variants, &variant->list_item);
+
+   return variant;
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct lp_compute_shader *shader;
+   int nr_samplers, nr_sampler_views;
+   struct tgsi_full_instruction *inst;
+   struct tgsi_parse_context parse;
+
+   if (templ->ir_type != PIPE_SHADER_IR_TGSI)
+      return NULL;
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->no = cs_no++;
+   make_empty_list(&shader->variants);
+
+   shader->base = *templ;
+   /* we need to keep a local copy of the tokens */
+   shader->base.prog = tgsi_dup_tokens(templ->prog);
+   if (!shader->base.prog) {
+      FREE(shader);
+      return NULL;
+   }
+
+   /* get/save the summary info for this shader */
+   lp_build_tgsi_info(shader->base.prog, &shader->info);
+
+   tgsi_parse_init(&parse, shader->base.prog);
+   while (!tgsi_parse_end_of_tokens(&parse)) {
+      tgsi_parse_token(&parse);
+      if (parse.FullToken.Token.Type == TGSI_TOKEN_TYPE_INSTRUCTION) {
+         inst = &parse.FullToken.FullInstruction;
+         if (inst->Instruction.Opcode == TGSI_OPCODE_BARRIER)
+            shader->uses_barrier = TRUE;
+      }
+   }
+   tgsi_parse_free(&parse);
+
+   nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
+   nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+
+   shader->variant_key_size = Offset(struct lp_compute_shader_variant_key,
+                                     state[MAX2(nr_samplers, nr_sampler_views)]);
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      tgsi_dump(shader->base.prog, 0);
+   }
+
+   return shader;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe,
+                            void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *) cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe,
+                              void *cs)
+{
+   struct lp_compute_shader *shader = (struct lp_compute_shader *) cs;
+   struct lp_cs_variant_list_item *li;
+
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      struct lp_cs_variant_list_item *next = next_elem(li);
+      destroy_variant(li->base);
+      li = next;
+   }
+
+   FREE((void *) shader->base.prog);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* Only fragment and compute shaders have access to shader buffers. */
+   if (shader != PIPE_SHADER_FRAGMENT && shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= ARRAY_SIZE(llvmpipe->ssbos[shader]));
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->ssbos[shader][start_slot + i];
+
+      if (buffers) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+
+   if (shader == PIPE_SHADER_FRAGMENT)
+      llvmpipe->dirty |= LP_NEW_FS_SSBOS;
+}
+
+
+static void
+llvmpipe_set_shader_images(struct pipe_context *pipe,
+                           enum pipe_shader_type shader,
+                           unsigned start_slot, unsigned count,
+                           const struct pipe_image_view *images)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* Only fragment and compute shaders have access to images. */
+   if (shader != PIPE_SHADER_FRAGMENT && shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= ARRAY_SIZE(llvmpipe->images[shader]));
+
+   for (i = 0; i < count; i++) {
+      struct pipe_image_view *dst = &llvmpipe->images[shader][start_slot + i];
+
+      if (images) {
+         pipe_resource_reference(&dst->resource, images[i].resource);
+         dst->format = images[i].format;
+         dst->access = images[i].access;
+         dst->u = images[i].u;
+      }
+      else {
+         pipe_resource_reference(&dst->resource, NULL);
+         memset(dst, 0, sizeof *dst);
+      }
+   }
+
+   if (shader == PIPE_SHADER_FRAGMENT)
+      llvmpipe->dirty |= LP_NEW_FS_IMAGES;
+}
+
+
+/**
+ * Shader writes are done by the time the rasterizer threads are idle.
+ */
+static void
+llvmpipe_memory_barrier(struct pipe_context *pipe,
+                        unsigned flags)
+{
+   llvmpipe_finish(pipe, __FUNCTION__);
+}
+
+
+static void
+fill_grid_size(struct pipe_context *pipe,
+               const struct pipe_grid_info *info,
+               uint32_t grid_size[3])
+{
+   struct pipe_transfer *transfer;
+   uint32_t *params;
+
+   if (!info->indirect) {
+      grid_size[0] = info->grid[0];
+      grid_size[1] = info->grid[1];
+      grid_size[2] = info->grid[2];
+      return;
+   }
+
+   params = pipe_buffer_map_range(pipe, info->indirect,
+                                  info->indirect_offset,
+                                  3 * sizeof(uint32_t),
+                                  PIPE_TRANSFER_READ,
+                                  &transfer);
+   if (!transfer) {
+      grid_size[0] = grid_size[1] = grid_size[2] = 0;
+      return;
+   }
+
+   grid_size[0] = params[0];
+   grid_size[1] = params[1];
+   grid_size[2] = params[2];
+   pipe_buffer_unmap(pipe, transfer);
+}
+
+
+static void
+fill_job_resources(struct llvmpipe_context *llvmpipe,
+                   struct lp_cs_job *job)
+{
+   static const float fake_const_buf[4];
+   struct lp_jit_context *jit_context = &job->jit_context;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(jit_context->constants); i++) {
+      const struct pipe_constant_buffer *cb =
+         &llvmpipe->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer)
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      else if (cb->user_buffer)
+         data = (const ubyte *) cb->user_buffer;
+
+      if (data) {
+         jit_context->constants[i] =
+            (const float *) (data + cb->buffer_offset);
+         jit_context->num_constants[i] =
+            MIN2(cb->buffer_size, LP_MAX_TGSI_CONST_BUFFER_SIZE) /
+            (sizeof(float) * 4);
+      }
+      else {
+         jit_context->constants[i] = fake_const_buf;
+         jit_context->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < llvmpipe->num_sampler_views[PIPE_SHADER_COMPUTE]; i++) {
+      struct pipe_sampler_view *view =
+         llvmpipe->sampler_views[PIPE_SHADER_COMPUTE][i];
+
+      if (view)
+         lp_setup_jit_texture(&jit_context->textures[i], view);
+   }
+
+   for (i = 0; i < llvmpipe->num_samplers[PIPE_SHADER_COMPUTE]; i++) {
+      const struct pipe_sampler_state *sampler =
+         llvmpipe->samplers[PIPE_SHADER_COMPUTE][i];
+
+      if (sampler) {
+         struct lp_jit_sampler *jit_sam = &jit_context->samplers[i];
+
+         jit_sam->min_lod = sampler->min_lod;
+         jit_sam->max_lod = sampler->max_lod;
+         jit_sam->lod_bias = sampler->lod_bias;
+         COPY_4V(jit_sam->border_color, sampler->border_color.f);
+      }
+   }
+
+   for (i = 0; i < ARRAY_SIZE(jit_context->ssbos); i++)
+      lp_setup_jit_ssbo(&jit_context->ssbos[i], &jit_context->ssbo_sizes[i],
+                        &llvmpipe->ssbos[PIPE_SHADER_COMPUTE][i]);
+
+   for (i = 0; i < ARRAY_SIZE(jit_context->images); i++)
+      lp_setup_jit_image(&jit_context->images[i],
+                         &llvmpipe->images[PIPE_SHADER_COMPUTE][i]);
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_compute_shader_variant *variant;
+   struct lp_fence *fence = NULL;
+   struct lp_cs_job *job;
+   uint32_t grid_size[3];
+   unsigned block_invocations;
+
+   if (!shader)
+      return;
+
+   fill_grid_size(pipe, info, grid_size);
+   if (!grid_size[0] || !grid_size[1] || !grid_size[2])
+      return;
+
+   block_invocations = info->block[0] * info->block[1] * info->block[2];
+   if (!block_invocations)
+      return;
+
+   variant = llvmpipe_update_cs(llvmpipe, info);
+   if (!variant)
+      return;
+
+   job = CALLOC_STRUCT(lp_cs_job);
+   if (!job)
+      return;
+
+   job->variant = variant;
+   memcpy(job->grid_size, grid_size, sizeof job->grid_size);
+   job->num_blocks = (uint64_t) grid_size[0] * grid_size[1] * grid_size[2];
+   job->vectors_per_block = DIV_ROUND_UP(block_invocations,
+                                         variant->vector_length);
+   job->shared_size = shader->base.req_local_mem;
+#if defined(LP_CS_FIBERS)
+   job->use_fibers = shader->uses_barrier && job->vectors_per_block > 1;
+#else
+   job->use_threads = shader->uses_barrier && job->vectors_per_block > 1;
+#endif
+
+   /* Make the results of previous rendering visible to the shader. */
+   llvmpipe_finish(pipe, __FUNCTION__);
+
+   fill_job_resources(llvmpipe, job);
+
+   /* The rasterizer threads are shared by all the contexts of the screen,
+    * let the scenes queued by other contexts complete before borrowing
+    * them.  Holding rast_mutex keeps new ones from being queued meanwhile.
+    */
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
+   lp_rast_run_job(screen->rast, cs_run_job, job);
+   mtx_unlock(&screen->rast_mutex);
+
+   /* Every thread takes one block past the last, unless none could run. */
+   if (job->next_block < job->num_blocks)
+      debug_printf("llvmpipe: out of memory, compute grid not run\n");
+
+   FREE(job);
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.set_shader_images = llvmpipe_set_shader_images;
+   llvmpipe->pipe.memory_barrier = llvmpipe_memory_barrier;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
@@ -68,11 +68,16 @@
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
+#include "compiler/blob.h"
+#include "compiler/nir/nir.h"
+#include "compiler/nir/nir_serialize.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_scan.h"
 #include "tgsi/tgsi_parse.h"
+#include "nir/nir_to_tgsi_info.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_conv.h"
@@ -80,6 +85,7 @@
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_logic.h"
 #include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_nir.h"
 #include "gallivm/lp_bld_swizzle.h"
 #include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_debug.h"
@@ -96,6 +102,7 @@
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 #include "lp_state.h"
 #include "lp_tex_sample.h"
@@ -345,7 +352,19 @@ generate_fs_loop(struct gallivm_state *gallivm,
       zs_format_desc = util_format_description(key->zsbuf_format);
       assert(zs_format_desc);
 
-      if (!shader->info.base.writes_z && !shader->info.base.writes_stencil) {
+      if (shader->info.base.properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL]) {
+         /* The tests and writes happen before the shader runs, whatever it
+          * does afterwards.
+          */
+         depth_mode = EARLY_DEPTH_TEST | EARLY_DEPTH_WRITE;
+      }
+      else if (shader->info.base.writes_memory) {
+         /* Fragments failing the tests must still see their side effects
+          * happen, so the shader runs for all of them.
+          */
+         depth_mode = LATE_DEPTH_TEST | LATE_DEPTH_WRITE;
+      }
+      else if (!shader->info.base.writes_z && !shader->info.base.writes_stencil) {
          if (key->alpha.enabled ||
              key->blend.alpha_to_coverage ||
              shader->info.base.uses_kill ||
@@ -475,11 +494,24 @@ generate_fs_loop(struct gallivm_state *gallivm,
    lp_build_interp_soa_update_inputs_dyn(interp, gallivm, loop_state.counter);
 
    /* Build the actual shader */
-   lp_build_tgsi_soa(gallivm, tokens, type, &mask,
-                     consts_ptr, num_consts_ptr, &system_values,
-                     interp->inputs,
-                     outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      lp_build_nir_soa(gallivm, shader->base.ir.nir, type, &mask,
+                       consts_ptr, num_consts_ptr, &system_values,
+                       interp->inputs,
+                       outputs, context_ptr, thread_data_ptr,
+                       sampler);
+   else {
+      struct lp_jit_mem_iface mem_iface;
+
+      lp_jit_init_mem_iface(&mem_iface, gallivm, context_ptr);
+
+      lp_build_tgsi_soa(gallivm, tokens, type, &mask,
+                        consts_ptr, num_consts_ptr, &system_values,
+                        interp->inputs,
+                        outputs, context_ptr, thread_data_ptr,
+                        sampler, &shader->info.base, NULL, &mem_iface.base,
+                        NULL);
+   }
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -2397,8 +2429,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2781,44 +2812,126 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 {
    debug_printf("llvmpipe: Fragment shader #%u variant #%u:\n", 
                 variant->shader->no, variant->no);
-   tgsi_dump(variant->shader->base.tokens, 0);
+   if (variant->shader->base.type == PIPE_SHADER_IR_NIR)
+      nir_print_shader(variant->shader->base.ir.nir, stderr);
+   else
+      tgsi_dump(variant->shader->base.tokens, 0);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
+   debug_printf("variant->hiz_cull = %u\n", variant->hiz_cull);
    debug_printf("\n");
 }
 
 
 /**
- * Generate a new fragment shader variant from the shader code and
- * other state indicated by the key.
+ * Compute the shader cache key of a fragment shader variant.
+ */
+static void
+lp_fs_get_ir_cache_key(const struct lp_fragment_shader *shader,
+                       const struct lp_fragment_shader_variant_key *key,
+                       unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      _mesa_sha1_update(&ctx, shader->nir_sha1, sizeof(shader->nir_sha1));
+   else
+      _mesa_sha1_update(&ctx, shader->base.tokens,
+                        tgsi_num_tokens(shader->base.tokens) *
+                        sizeof(struct tgsi_token));
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
+/**
+ * Generate the code of a fragment shader variant.
+ *
+ * \param context  LLVM context to build the IR in
+ * \param cached   shader cache entry to read from/store into, or NULL
+ * \param fast     favour compilation speed over code quality
+ */
+static boolean
+generate_variant_code(struct llvmpipe_screen *screen,
+                      LLVMContextRef context,
+                      struct lp_fragment_shader_variant *variant,
+                      struct lp_cached_code *cached,
+                      unsigned char ir_sha1_cache_key[20],
+                      boolean fast)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+   char module_name[64];
+   bool needs_caching = cached && !cached->data_size;
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+                 shader->no, variant->no);
+
+   variant->gallivm = gallivm_create(module_name, context, cached);
+   if (!variant->gallivm)
+      return FALSE;
+
+   variant->gallivm->fast_codegen = fast;
+
+   lp_jit_init_types(variant);
+
+   generate_fragment(shader, variant, RAST_EDGE_TEST);
+
+   if (variant->opaque) {
+      /* Specialized shader, which doesn't need to read the color buffer. */
+      generate_fragment(shader, variant, RAST_WHOLE);
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+         gallivm_jit_function(variant->gallivm,
+                              variant->function[RAST_EDGE_TEST]);
+
+   if (variant->function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_WHOLE]);
+   } else {
+      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   }
+
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, cached, ir_sha1_cache_key);
+   gallivm_free_ir(variant->gallivm);
+
+   return TRUE;
+}
+
+
+/**
+ * Allocate a variant and initialize the state which doesn't depend on the
+ * generated code.
  */
 static struct lp_fragment_shader_variant *
-generate_variant(struct llvmpipe_context *lp,
-                 struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+create_variant(struct lp_fragment_shader *shader,
+               const struct lp_fragment_shader_variant_key *key,
+               unsigned no)
 {
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
    boolean fullcolormask;
-   char module_name[64];
 
    variant = CALLOC_STRUCT(lp_fragment_shader_variant);
    if (!variant)
       return NULL;
 
-   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
-
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
-
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
+   variant->no = no;
+   util_queue_fence_init(&variant->async.fence);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
@@ -2843,6 +2956,41 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.writes_samplemask
       ? TRUE : FALSE;
 
+   /*
+    * Depth values only ever decrease with LESS/LEQUAL tests, which is what
+    * the rasterizer's depth bounds rely on.  Culled tiles don't run the
+    * shader, so its side effects must not be needed.
+    */
+   variant->hiz_cull =
+         key->depth.enabled &&
+         (!shader->info.base.writes_memory ||
+          shader->info.base.properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL]) &&
+         (key->depth.func == PIPE_FUNC_LESS ||
+          key->depth.func == PIPE_FUNC_LEQUAL) &&
+         !key->stencil[0].enabled &&
+         !key->depth_clamp &&
+         !shader->info.base.writes_z
+      ? TRUE : FALSE;
+
+   variant->hiz_tighten =
+         variant->hiz_cull &&
+         key->depth.writemask &&
+         !key->alpha.enabled &&
+         !key->blend.alpha_to_coverage &&
+         !shader->info.base.uses_kill &&
+         !shader->info.base.writes_samplemask
+      ? TRUE : FALSE;
+
+   variant->hiz_invalidate =
+         key->depth.enabled &&
+         key->depth.writemask &&
+         (shader->info.base.writes_z ||
+          (key->depth.func != PIPE_FUNC_NEVER &&
+           key->depth.func != PIPE_FUNC_LESS &&
+           key->depth.func != PIPE_FUNC_EQUAL &&
+           key->depth.func != PIPE_FUNC_LEQUAL))
+      ? TRUE : FALSE;
+
    if ((shader->info.base.num_tokens <= 1) &&
        !key->depth.enabled && !key->stencil[0].enabled) {
       variant->ps_inv_multiplier = 0;
@@ -2850,47 +2998,162 @@ generate_variant(struct llvmpipe_context *lp,
       variant->ps_inv_multiplier = 1;
    }
 
+   return variant;
+}
+
+
+static void
+destroy_variant(struct lp_fragment_shader_variant *variant)
+{
+   util_queue_fence_destroy(&variant->async.fence);
+   if (variant->gallivm)
+      gallivm_destroy(variant->gallivm);
+   if (variant->fallback_gallivm)
+      gallivm_destroy(variant->fallback_gallivm);
+   FREE(variant);
+}
+
+
+/**
+ * Worker thread entrypoint: generate the optimized code of a variant into
+ * its shadow variant.
+ */
+static void
+compile_variant_job(void *data, int thread_index)
+{
+   struct lp_fragment_shader_variant *variant = data;
+   struct lp_fragment_shader_variant *shadow = variant->async.shadow;
+   struct lp_cached_code cached = { 0 };
+   LLVMContextRef context;
+
+   /* LLVM contexts can't be used from several threads at once. */
+   context = LLVMContextCreate();
+   if (!context)
+      return;
+
+   generate_variant_code(variant->async.screen, context, shadow, &cached,
+                         variant->async.ir_sha1_cache_key, FALSE);
+
+   LLVMContextDispose(context);
+   free(cached.data);
+}
+
+
+/**
+ * Generate a new fragment shader variant from the shader code and
+ * other state indicated by the key.
+ */
+static struct lp_fragment_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader *shader,
+                 const struct lp_fragment_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fragment_shader_variant *variant;
+   struct lp_cached_code cached = { 0 };
+   unsigned char ir_sha1_cache_key[20];
+   boolean async;
+
+   variant = create_variant(shader, key, shader->variants_created);
+   if (!variant)
+      return NULL;
+
+   shader->variants_created++;
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
+   lp_fs_get_ir_cache_key(shader, key, ir_sha1_cache_key);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
 
    /*
-    * Compile everything
+    * Unless the optimized code can be loaded from the disk cache, quickly
+    * generate code to draw with and optimize in the background.
     */
+   async = screen->async_fs_compile && !cached.data_size;
 
-   gallivm_compile_module(variant->gallivm);
+   if (!generate_variant_code(screen, lp->context, variant,
+                              async ? NULL : &cached, ir_sha1_cache_key,
+                              async)) {
+      free(cached.data);
+      destroy_variant(variant);
+      return NULL;
+   }
+   free(cached.data);
 
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+   if (async) {
+      struct lp_fragment_shader_variant *shadow =
+         create_variant(shader, key, variant->no);
 
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
+      if (shadow) {
+         variant->async.shadow = shadow;
+         variant->async.screen = screen;
+         memcpy(variant->async.ir_sha1_cache_key, ir_sha1_cache_key,
+                sizeof(ir_sha1_cache_key));
+         util_queue_add_job(&screen->fs_compile_queue, variant,
+                            &variant->async.fence, compile_variant_job, NULL);
+         lp->nr_fs_variants_pending++;
+      }
    }
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
-   }
+   return variant;
+}
 
-   gallivm_free_ir(variant->gallivm);
 
-   return variant;
+/**
+ * Release the shadow variant of a variant, after its compile job finished
+ * or was dropped.
+ */
+static void
+release_shadow_variant(struct llvmpipe_context *lp,
+                       struct lp_fragment_shader_variant *variant)
+{
+   destroy_variant(variant->async.shadow);
+   variant->async.shadow = NULL;
+   assert(lp->nr_fs_variants_pending);
+   lp->nr_fs_variants_pending--;
+}
+
+
+/**
+ * Switch variants whose optimized code finished compiling over to it.
+ * Called at scene boundaries so that each scene is likely to run the same
+ * code throughout, though both versions are correct for the variant.
+ */
+void
+llvmpipe_install_fs_variants(struct llvmpipe_context *lp)
+{
+   struct lp_fs_variant_list_item *li;
+
+   if (!lp->nr_fs_variants_pending)
+      return;
+
+   li = first_elem(&lp->fs_variants_list);
+   while (!at_end(&lp->fs_variants_list, li)) {
+      struct lp_fragment_shader_variant *variant = li->base;
+      struct lp_fragment_shader_variant *shadow = variant->async.shadow;
+
+      li = next_elem(li);
+
+      if (!shadow || !util_queue_fence_is_signalled(&variant->async.fence))
+         continue;
+
+      if (shadow->gallivm && shadow->jit_function[RAST_EDGE_TEST]) {
+         /* Scenes still in flight may be running the fast code. */
+         assert(!variant->fallback_gallivm);
+         variant->fallback_gallivm = variant->gallivm;
+         variant->gallivm = shadow->gallivm;
+         shadow->gallivm = NULL;
+
+         variant->jit_function[RAST_EDGE_TEST] =
+            shadow->jit_function[RAST_EDGE_TEST];
+         variant->jit_function[RAST_WHOLE] =
+            shadow->jit_function[RAST_WHOLE];
+      }
+
+      release_shadow_variant(lp, variant);
+   }
 }
 
 
@@ -2911,14 +3174,40 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    shader->no = fs_no++;
    make_empty_list(&shader->variants);
 
-   /* get/save the summary info for this shader */
-   lp_build_tgsi_info(templ->tokens, &shader->info);
+   if (templ->type == PIPE_SHADER_IR_NIR) {
+      /* we take ownership of the shader */
+      nir_shader *nir = templ->ir.nir;
+      struct blob blob;
+
+      if (!lp_build_nir_prepare(nir)) {
+         debug_printf("llvmpipe: unsupported NIR fragment shader\n");
+         ralloc_free(nir);
+         FREE(shader);
+         return NULL;
+      }
+
+      nir_tgsi_scan_shader(nir, &shader->info.base, false);
+
+      blob_init(&blob);
+      nir_serialize(&blob, nir);
+      _mesa_sha1_compute(blob.data, blob.size, shader->nir_sha1);
+      blob_finish(&blob);
+
+      shader->base.type = PIPE_SHADER_IR_NIR;
+      shader->base.ir.nir = nir;
+   }
+   else {
+      /* get/save the summary info for this shader */
+      lp_build_tgsi_info(templ->tokens, &shader->info);
 
-   /* we need to keep a local copy of the tokens */
-   shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+      /* we need to keep a local copy of the tokens */
+      shader->base.tokens = tgsi_dup_tokens(templ->tokens);
+   }
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      if (shader->base.type == PIPE_SHADER_IR_NIR)
+         ralloc_free(shader->base.ir.nir);
       FREE((void *) shader->base.tokens);
       FREE(shader);
       return NULL;
@@ -2972,7 +3261,10 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
       unsigned attrib;
       debug_printf("llvmpipe: Create fragment shader #%u %p:\n",
                    shader->no, (void *) shader);
-      tgsi_dump(templ->tokens, 0);
+      if (shader->base.type == PIPE_SHADER_IR_NIR)
+         nir_print_shader(shader->base.ir.nir, stderr);
+      else
+         tgsi_dump(templ->tokens, 0);
       debug_printf("usage masks:\n");
       for (attrib = 0; attrib < shader->info.base.num_inputs; ++attrib) {
          unsigned usage_mask = shader->info.base.input_usage_mask[attrib];
@@ -3024,7 +3316,11 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
-   gallivm_destroy(variant->gallivm);
+   if (variant->async.shadow) {
+      util_queue_drop_job(&variant->async.screen->fs_compile_queue,
+                          &variant->async.fence);
+      release_shadow_variant(lp, variant);
+   }
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3035,7 +3331,7 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
    lp->nr_fs_variants--;
    lp->nr_fs_instrs -= variant->nr_instrs;
 
-   FREE(variant);
+   destroy_variant(variant);
 }
 
 
@@ -3067,6 +3363,8 @@ llvmpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
    draw_delete_fragment_shader(llvmpipe->draw, shader->draw_data);
 
    assert(shader->variants_cached == 0);
+   if (shader->base.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(shader->base.ir.nir);
    FREE((void *) shader->base.tokens);
    FREE(shader);
 }
@@ -3095,7 +3393,9 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
    }
 
    if (shader == PIPE_SHADER_VERTEX ||
-       shader == PIPE_SHADER_GEOMETRY) {
+       shader == PIPE_SHADER_GEOMETRY ||
+       shader == PIPE_SHADER_TESS_CTRL ||
+       shader == PIPE_SHADER_TESS_EVAL) {
       /* Pass the constants to the 'draw' module */
       const unsigned size = cb ? cb->buffer_size : 0;
       const ubyte *data;
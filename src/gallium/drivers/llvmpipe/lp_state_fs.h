@@ -32,6 +32,7 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_state.h"
+#include "util/u_queue.h"
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
@@ -40,6 +41,7 @@
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct llvmpipe_screen;
 
 
 /** Indexes into jit_function[] array */
@@ -100,6 +102,16 @@ struct lp_fragment_shader_variant
    boolean opaque;
    uint8_t ps_inv_multiplier;
 
+   /**
+    * Hierarchical Z, see lp_rast_hiz_cull().
+    * hiz_cull: fragments behind the tile's depth bounds can be skipped.
+    * hiz_tighten: fully covered blocks leave depth <= the primitive's zmax.
+    * hiz_invalidate: the depth buffer may grow, the bounds must be dropped.
+    */
+   boolean hiz_cull;
+   boolean hiz_tighten;
+   boolean hiz_invalidate;
+
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_ptr_type;
@@ -113,6 +125,22 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /**
+    * When the variant is first needed it is compiled quickly with little
+    * backend optimization, and the fully optimized code is generated in
+    * the background into a shadow variant.  It is installed at the next
+    * scene boundary, see llvmpipe_install_fs_variants().
+    */
+   struct {
+      struct util_queue_fence fence;
+      struct lp_fragment_shader_variant *shadow;
+      struct llvmpipe_screen *screen;
+      unsigned char ir_sha1_cache_key[20];
+   } async;
+
+   /** Code replaced by the optimized one, kept alive for in-flight scenes */
+   struct gallivm_state *fallback_gallivm;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -140,6 +168,9 @@ struct lp_fragment_shader
 
    /** Fragment shader input interpolation info */
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
+
+   /** SHA1 of the serialized shader, for NIR shaders which have no tokens */
+   unsigned char nir_sha1[20];
 };
 
 
@@ -150,6 +181,9 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant);
 
+void
+llvmpipe_install_fs_variants(struct llvmpipe_context *lp);
+
 boolean
 llvmpipe_rasterization_disabled(struct llvmpipe_context *lp);
 
@@ -0,0 +1,836 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \brief  Binned rasterization on worker threads.
+ *
+ * Instead of rasterizing the primitives as they come out of the draw
+ * module, the setup code hands them over to the binner which copies their
+ * vertices and sorts them into lists of the framebuffer tiles (TILE_SIZE
+ * squared, the same tiles as the surface tile caches) they may touch.
+ *
+ * When the primitives are flushed, at the end of each draw or when the
+ * rendering state changes, the tiles are rasterized in parallel.  Each
+ * thread has a private copy of the context state with its own fragment
+ * shader machine, quad pipeline and surface/texture tile caches, and runs
+ * the regular setup code over the primitives of a tile, in order, with the
+ * cliprects narrowed to the tile.
+ *
+ * Tile boundaries are multiples of the 16 pixel spans of the triangle
+ * rasterizer, so every tile sees exactly the same quads, in the same
+ * batches, as with a single thread and the results are identical.
+ */
+
+#include "util/u_atomic.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_queue.h"
+#include "tgsi/tgsi_exec.h"
+
+#include "sp_bin.h"
+#include "sp_context.h"
+#include "sp_quad_pipe.h"
+#include "sp_setup.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+
+
+/**
+ * Max number of primitives to bin before rasterizing them, this bounds
+ * the memory used to hold the vertices of huge draws.
+ */
+#define SP_BIN_MAX_PRIMS (64 * 1024)
+
+/** Marks the first tile a primitive is binned to */
+#define SP_BIN_FIRST (1u << 31)
+
+
+/** A primitive waiting to be rasterized */
+struct sp_bin_prim {
+   unsigned type;      /**< PIPE_PRIM_POINTS, LINES or TRIANGLES */
+   unsigned fpstate;   /**< float state when the primitive was set up */
+   unsigned verts;     /**< offset of the vertices in sp_binner::verts */
+};
+
+
+/** The primitives touching a tile, in submission order */
+struct sp_bin {
+   unsigned *prims;    /**< sp_binner::prims indices | SP_BIN_FIRST */
+   unsigned count;
+   unsigned max;
+};
+
+
+struct sp_bin_worker {
+   struct sp_binner *binner;
+   struct util_queue_fence fence;
+
+   /** Private copy of the context, pointing to the objects below */
+   struct softpipe_context sp;
+   struct pipe_scissor_state cliprect[PIPE_MAX_VIEWPORTS];
+
+   struct setup_context *setup;
+   struct tgsi_exec_machine *fs_machine;
+   struct sp_tgsi_sampler *sampler;
+
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+};
+
+
+struct sp_binner {
+   struct softpipe_context *softpipe;
+
+   unsigned num_threads;
+   unsigned num_workers;
+   boolean queue_created;
+   struct util_queue queue;
+   struct sp_bin_worker *workers;
+
+   /** Framebuffer size and tiles of the binned primitives */
+   float width, height;
+   unsigned tiles_x, tiles_y;
+   unsigned vertex_floats;
+
+   struct sp_bin *bins;
+   unsigned max_bins;
+   unsigned *used_tiles;
+   unsigned num_used_tiles;
+
+   struct sp_bin_prim *prims;
+   unsigned num_prims;
+   unsigned max_prims;
+
+   float *verts;
+   unsigned num_verts;   /**< in floats */
+   unsigned max_verts;
+
+   /** Next sp_binner::used_tiles entry to rasterize */
+   int next_tile;
+
+   /**
+    * Set when the context's own tile caches were used to rasterize, they
+    * must be written back before the workers touch the surfaces.
+    */
+   boolean main_caches_dirty;
+};
+
+
+/**
+ * Make room for \p count elements of \p size bytes in a growing array.
+ */
+static boolean
+bin_grow(void **ptr, unsigned *max, unsigned count, unsigned size)
+{
+   unsigned new_max;
+   void *new_ptr;
+
+   if (count <= *max)
+      return TRUE;
+
+   new_max = MAX3(*max * 2, count, 64);
+   new_ptr = REALLOC(*ptr, *max * size, new_max * size);
+   if (!new_ptr)
+      return FALSE;
+
+   *ptr = new_ptr;
+   *max = new_max;
+   return TRUE;
+}
+
+
+static void
+bin_worker_destroy(struct sp_bin_worker *worker)
+{
+   unsigned i;
+
+   util_queue_fence_destroy(&worker->fence);
+
+   sp_setup_destroy_context(worker->setup);
+
+   if (worker->shade)
+      worker->shade->destroy(worker->shade);
+   if (worker->depth_test)
+      worker->depth_test->destroy(worker->depth_test);
+   if (worker->blend)
+      worker->blend->destroy(worker->blend);
+   if (worker->pstipple)
+      worker->pstipple->destroy(worker->pstipple);
+
+   tgsi_exec_machine_destroy(worker->fs_machine);
+   FREE(worker->sampler);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_destroy_tile_cache(worker->cbuf_cache[i]);
+   sp_destroy_tile_cache(worker->zsbuf_cache);
+
+   for (i = 0; i < ARRAY_SIZE(worker->tex_cache); i++) {
+      if (worker->tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(worker->tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(worker->tex_cache[i]);
+      }
+   }
+}
+
+
+static boolean
+bin_worker_init(struct sp_bin_worker *worker, struct sp_binner *binner)
+{
+   struct pipe_context *pipe = &binner->softpipe->pipe;
+   struct softpipe_context *sp = &worker->sp;
+   unsigned i;
+
+   worker->binner = binner;
+   util_queue_fence_init(&worker->fence);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      worker->cbuf_cache[i] = sp_create_tile_cache(pipe);
+      if (!worker->cbuf_cache[i])
+         return FALSE;
+   }
+   worker->zsbuf_cache = sp_create_tile_cache(pipe);
+
+   worker->sampler = sp_create_tgsi_sampler();
+   worker->fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
+
+   worker->shade = sp_quad_shade_stage(sp);
+   worker->depth_test = sp_quad_depth_test_stage(sp);
+   worker->blend = sp_quad_blend_stage(sp);
+   worker->pstipple = sp_quad_polygon_stipple_stage(sp);
+
+   worker->setup = sp_setup_create_context(sp);
+
+   return worker->zsbuf_cache &&
+          worker->sampler &&
+          worker->fs_machine &&
+          worker->shade &&
+          worker->depth_test &&
+          worker->blend &&
+          worker->pstipple &&
+          worker->setup;
+}
+
+
+/**
+ * Copy the current context state to a worker, redirecting it to the
+ * worker's own machine, quad stages and caches.
+ */
+static boolean
+bin_worker_snapshot(struct sp_bin_worker *worker)
+{
+   struct softpipe_context *softpipe = worker->binner->softpipe;
+   const struct sp_fragment_shader_variant *variant = softpipe->fs_variant;
+   struct softpipe_context *sp = &worker->sp;
+   struct sp_tgsi_sampler *sampler = worker->sampler;
+   unsigned i;
+
+   memcpy(sp, softpipe, sizeof *sp);
+
+   sp->binner = NULL;
+   sp->dirty = 0;
+   sp->occlusion_count = 0;
+   memset(&sp->pipeline_statistics, 0, sizeof sp->pipeline_statistics);
+
+   sp->fs_machine = worker->fs_machine;
+   sp->quad.shade = worker->shade;
+   sp->quad.depth_test = worker->depth_test;
+   sp->quad.blend = worker->blend;
+   sp->quad.pstipple = worker->pstipple;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp->cbuf_cache[i] = worker->cbuf_cache[i];
+   sp->zsbuf_cache = worker->zsbuf_cache;
+
+   /* Same sampler views, sampled through the worker's texture caches */
+   memcpy(sampler, softpipe->tgsi.sampler[PIPE_SHADER_FRAGMENT],
+          sizeof *sampler);
+
+   for (i = 0; i < ARRAY_SIZE(worker->tex_cache); i++) {
+      struct pipe_sampler_view *view =
+         i < softpipe->num_sampler_views[PIPE_SHADER_FRAGMENT] ?
+         softpipe->sampler_views[PIPE_SHADER_FRAGMENT][i] : NULL;
+      struct softpipe_tex_tile_cache *tc = worker->tex_cache[i];
+
+      if (!tc) {
+         if (!view)
+            continue;
+
+         tc = sp_create_tex_tile_cache(&softpipe->pipe);
+         if (!tc)
+            return FALSE;
+         worker->tex_cache[i] = tc;
+      }
+
+      sp_tex_tile_cache_set_sampler_view(tc, view);
+
+      if (view) {
+         struct softpipe_resource *spt = softpipe_resource(view->texture);
+
+         if (spt->timestamp != tc->timestamp) {
+            sp_tex_tile_cache_validate_texture(tc);
+            tc->timestamp = spt->timestamp;
+         }
+
+         sampler->sp_sview[i].cache = tc;
+      }
+   }
+
+   sp->tgsi.sampler[PIPE_SHADER_FRAGMENT] = sampler;
+
+   /* The sampler is always the same object, only rebind on new tokens */
+   if (worker->fs_machine->Tokens != variant->tokens) {
+      variant->prepare(variant, worker->fs_machine,
+                       (struct tgsi_sampler *) sampler,
+                       (struct tgsi_image *)
+                          softpipe->tgsi.image[PIPE_SHADER_FRAGMENT],
+                       (struct tgsi_buffer *)
+                          softpipe->tgsi.buffer[PIPE_SHADER_FRAGMENT]);
+   }
+
+   memcpy(worker->cliprect, softpipe->cliprect, sizeof worker->cliprect);
+
+   sp_build_quad_pipeline(sp);
+   sp_setup_prepare(worker->setup);
+
+   return TRUE;
+}
+
+
+/**
+ * Rasterize the primitives of the tiles not taken by another thread yet.
+ */
+static void
+bin_worker_run(struct sp_bin_worker *worker)
+{
+   struct sp_binner *binner = worker->binner;
+   struct softpipe_context *softpipe = binner->softpipe;
+   struct softpipe_context *sp = &worker->sp;
+   struct setup_context *setup = worker->setup;
+   const unsigned fpstate = util_fpstate_get();
+   unsigned cur_fpstate = fpstate;
+   unsigned t, i;
+
+   while ((t = p_atomic_inc_return(&binner->next_tile) - 1) <
+          binner->num_used_tiles) {
+      const unsigned tile = binner->used_tiles[t];
+      const struct sp_bin *bin = &binner->bins[tile];
+      const unsigned x = (tile % binner->tiles_x) * TILE_SIZE;
+      const unsigned y = (tile / binner->tiles_x) * TILE_SIZE;
+
+      for (i = 0; i < PIPE_MAX_VIEWPORTS; i++) {
+         const struct pipe_scissor_state *clip = &worker->cliprect[i];
+
+         sp->cliprect[i].minx = MAX2(clip->minx, x);
+         sp->cliprect[i].miny = MAX2(clip->miny, y);
+         sp->cliprect[i].maxx = MIN2(clip->maxx, x + TILE_SIZE);
+         sp->cliprect[i].maxy = MIN2(clip->maxy, y + TILE_SIZE);
+      }
+
+      /* Take over the pending clears of the tile */
+      for (i = 0; i < sp->framebuffer.nr_cbufs; i++) {
+         if (sp->framebuffer.cbufs[i])
+            sp_tile_cache_copy_clear(sp->cbuf_cache[i],
+                                     softpipe->cbuf_cache[i], x, y);
+      }
+      if (sp->framebuffer.zsbuf)
+         sp_tile_cache_copy_clear(sp->zsbuf_cache,
+                                  softpipe->zsbuf_cache, x, y);
+
+      for (i = 0; i < bin->count; i++) {
+         const unsigned entry = bin->prims[i];
+         const struct sp_bin_prim *prim =
+            &binner->prims[entry & ~SP_BIN_FIRST];
+         const float *v = binner->verts + prim->verts;
+         const unsigned stride = binner->vertex_floats;
+
+         if (prim->fpstate != cur_fpstate) {
+            util_fpstate_set(prim->fpstate);
+            cur_fpstate = prim->fpstate;
+         }
+
+         sp->reduced_prim = prim->type;
+
+         switch (prim->type) {
+         case PIPE_PRIM_TRIANGLES:
+            {
+               /* Only count the primitive once */
+               const uint64_t c_primitives =
+                  sp->pipeline_statistics.c_primitives;
+
+               sp_setup_tri(setup,
+                            (const float (*)[4]) v,
+                            (const float (*)[4]) (v + stride),
+                            (const float (*)[4]) (v + 2 * stride));
+
+               if (!(entry & SP_BIN_FIRST))
+                  sp->pipeline_statistics.c_primitives = c_primitives;
+            }
+            break;
+         case PIPE_PRIM_LINES:
+            sp_setup_line(setup,
+                          (const float (*)[4]) v,
+                          (const float (*)[4]) (v + stride));
+            break;
+         default:
+            sp_setup_point(setup, (const float (*)[4]) v);
+            break;
+         }
+      }
+   }
+
+   for (i = 0; i < sp->framebuffer.nr_cbufs; i++)
+      sp_flush_tile_cache(sp->cbuf_cache[i]);
+   sp_flush_tile_cache(sp->zsbuf_cache);
+
+   if (cur_fpstate != fpstate)
+      util_fpstate_set(fpstate);
+}
+
+
+static void
+bin_worker_execute(void *data, int thread_index)
+{
+   bin_worker_run((struct sp_bin_worker *) data);
+}
+
+
+/**
+ * Add a primitive with the given vertices and window bounds to the bins of
+ * all the tiles it overlaps.
+ */
+static void
+bin_prim(struct sp_binner *binner, unsigned type,
+         const float (**v)[4], unsigned nr,
+         float minx, float miny, float maxx, float maxy)
+{
+   const unsigned vertex_floats = binner->vertex_floats;
+   boolean first = TRUE;
+   unsigned tx0, ty0, tx1, ty1, tx, ty, index, i;
+   struct sp_bin_prim *prim;
+
+   if (minx >= binner->width || miny >= binner->height ||
+       maxx < 0.0f || maxy < 0.0f) {
+      /* Offscreen, but triangles still count as clipper primitives when
+       * they aren't culled.
+       */
+      if (!binner->softpipe->active_statistics_queries)
+         return;
+      tx0 = tx1 = ty0 = ty1 = 0;
+   }
+   else {
+      /* careful with NaNs, they cover the whole framebuffer */
+      tx0 = minx >= 0.0f ? (unsigned) minx / TILE_SIZE : 0;
+      ty0 = miny >= 0.0f ? (unsigned) miny / TILE_SIZE : 0;
+      tx1 = maxx < binner->width ?
+         (unsigned) maxx / TILE_SIZE : binner->tiles_x - 1;
+      ty1 = maxy < binner->height ?
+         (unsigned) maxy / TILE_SIZE : binner->tiles_y - 1;
+   }
+
+   if (binner->num_prims == SP_BIN_MAX_PRIMS)
+      sp_binner_flush(binner);
+
+   if (!bin_grow((void **) &binner->prims, &binner->max_prims,
+                 binner->num_prims + 1, sizeof *binner->prims) ||
+       !bin_grow((void **) &binner->verts, &binner->max_verts,
+                 binner->num_verts + nr * vertex_floats, sizeof(float)))
+      return;
+
+   index = binner->num_prims++;
+   prim = &binner->prims[index];
+   prim->type = type;
+   prim->fpstate = util_fpstate_get();
+   prim->verts = binner->num_verts;
+
+   for (i = 0; i < nr; i++) {
+      memcpy(binner->verts + binner->num_verts, v[i],
+             vertex_floats * sizeof(float));
+      binner->num_verts += vertex_floats;
+   }
+
+   for (ty = ty0; ty <= ty1; ty++) {
+      for (tx = tx0; tx <= tx1; tx++) {
+         const unsigned tile = ty * binner->tiles_x + tx;
+         struct sp_bin *bin = &binner->bins[tile];
+
+         if (!bin_grow((void **) &bin->prims, &bin->max,
+                       bin->count + 1, sizeof *bin->prims))
+            continue;
+
+         if (!bin->count)
+            binner->used_tiles[binner->num_used_tiles++] = tile;
+
+         bin->prims[bin->count++] = index | (first ? SP_BIN_FIRST : 0);
+         first = FALSE;
+      }
+   }
+}
+
+
+static inline boolean
+vert_is_finite(const float (*v)[4])
+{
+   return !util_is_inf_or_nan(v[0][0]) && !util_is_inf_or_nan(v[0][1]);
+}
+
+
+void
+sp_binner_tri(struct sp_binner *binner,
+              const float (*v0)[4],
+              const float (*v1)[4],
+              const float (*v2)[4])
+{
+   const float (*v[3])[4] = { v0, v1, v2 };
+
+   if (!vert_is_finite(v0) || !vert_is_finite(v1) || !vert_is_finite(v2)) {
+      bin_prim(binner, PIPE_PRIM_TRIANGLES, v, 3,
+               0.0f, 0.0f, binner->width - 1.0f, binner->height - 1.0f);
+      return;
+   }
+
+   bin_prim(binner, PIPE_PRIM_TRIANGLES, v, 3,
+            MIN3(v0[0][0], v1[0][0], v2[0][0]) - 1.0f,
+            MIN3(v0[0][1], v1[0][1], v2[0][1]) - 1.0f,
+            MAX3(v0[0][0], v1[0][0], v2[0][0]) + 1.0f,
+            MAX3(v0[0][1], v1[0][1], v2[0][1]) + 1.0f);
+}
+
+
+void
+sp_binner_line(struct sp_binner *binner,
+               const float (*v0)[4],
+               const float (*v1)[4])
+{
+   const float (*v[2])[4] = { v0, v1 };
+
+   if (!vert_is_finite(v0) || !vert_is_finite(v1)) {
+      bin_prim(binner, PIPE_PRIM_LINES, v, 2,
+               0.0f, 0.0f, binner->width - 1.0f, binner->height - 1.0f);
+      return;
+   }
+
+   bin_prim(binner, PIPE_PRIM_LINES, v, 2,
+            MIN2(v0[0][0], v1[0][0]) - 2.0f,
+            MIN2(v0[0][1], v1[0][1]) - 2.0f,
+            MAX2(v0[0][0], v1[0][0]) + 2.0f,
+            MAX2(v0[0][1], v1[0][1]) + 2.0f);
+}
+
+
+void
+sp_binner_point(struct sp_binner *binner,
+                const float (*v0)[4])
+{
+   const struct softpipe_context *softpipe = binner->softpipe;
+   const float (*v[1])[4] = { v0 };
+   const int sizeAttr = softpipe->psize_slot;
+   const float size
+      = sizeAttr > 0 ? v0[sizeAttr][0]
+      : softpipe->rasterizer->point_size;
+   const float extent = 0.5f * size + 2.0f;
+
+   if (!vert_is_finite(v0) || util_is_inf_or_nan(size)) {
+      bin_prim(binner, PIPE_PRIM_POINTS, v, 1,
+               0.0f, 0.0f, binner->width - 1.0f, binner->height - 1.0f);
+      return;
+   }
+
+   bin_prim(binner, PIPE_PRIM_POINTS, v, 1,
+            v0[0][0] - extent, v0[0][1] - extent,
+            v0[0][0] + extent, v0[0][1] + extent);
+}
+
+
+/**
+ * Called by the setup code before it gets new primitives.  Returns FALSE
+ * if the primitives must be rasterized directly, on the context's thread.
+ */
+boolean
+sp_binner_begin(struct sp_binner *binner)
+{
+   struct softpipe_context *softpipe = binner->softpipe;
+   const struct sp_fragment_shader_variant *variant = softpipe->fs_variant;
+   unsigned tiles, i;
+
+   if (softpipe->no_rast || softpipe->rasterizer->rasterizer_discard)
+      return FALSE;
+
+   /* Shaders with side effects see the fragments in order */
+   if (!variant ||
+       variant->info.writes_memory ||
+       variant->info.file_count[TGSI_FILE_IMAGE] ||
+       variant->info.file_count[TGSI_FILE_BUFFER]) {
+      sp_binner_flush(binner);
+      binner->main_caches_dirty = TRUE;
+      return FALSE;
+   }
+
+   /* Still binning with the same state */
+   if (binner->num_prims)
+      return TRUE;
+
+   binner->width = (float) softpipe->framebuffer.width;
+   binner->height = (float) softpipe->framebuffer.height;
+   binner->tiles_x = DIV_ROUND_UP(softpipe->framebuffer.width, TILE_SIZE);
+   binner->tiles_y = DIV_ROUND_UP(softpipe->framebuffer.height, TILE_SIZE);
+   binner->vertex_floats = softpipe->vertex_info.size;
+
+   tiles = binner->tiles_x * binner->tiles_y;
+   if (!tiles)
+      return FALSE;
+
+   if (tiles > binner->max_bins) {
+      struct sp_bin *bins = REALLOC(binner->bins,
+                                    binner->max_bins * sizeof *bins,
+                                    tiles * sizeof *bins);
+      unsigned *used_tiles = REALLOC(binner->used_tiles,
+                                     binner->max_bins * sizeof *used_tiles,
+                                     tiles * sizeof *used_tiles);
+      if (bins)
+         binner->bins = bins;
+      if (used_tiles)
+         binner->used_tiles = used_tiles;
+      if (!bins || !used_tiles) {
+         binner->main_caches_dirty = TRUE;
+         return FALSE;
+      }
+
+      memset(bins + binner->max_bins, 0,
+             (tiles - binner->max_bins) * sizeof *bins);
+      binner->max_bins = tiles;
+   }
+
+   if (binner->main_caches_dirty) {
+      for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+         sp_flush_tile_cache(softpipe->cbuf_cache[i]);
+      sp_flush_tile_cache(softpipe->zsbuf_cache);
+      binner->main_caches_dirty = FALSE;
+   }
+
+   for (i = 0; i < binner->num_threads; i++) {
+      if (!bin_worker_snapshot(&binner->workers[i])) {
+         binner->main_caches_dirty = TRUE;
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Rasterize all the binned primitives.
+ */
+void
+sp_binner_flush(struct sp_binner *binner)
+{
+   struct softpipe_context *softpipe = binner->softpipe;
+   unsigned num_jobs, i, c;
+
+   if (!binner->num_prims)
+      return;
+
+   num_jobs = MIN2(binner->num_threads, binner->num_used_tiles);
+
+   if (num_jobs > 1 && !binner->queue_created) {
+      binner->queue_created = util_queue_init(&binner->queue, "sprast",
+                                              SP_BIN_MAX_THREADS,
+                                              binner->num_threads - 1, 0);
+      if (!binner->queue_created) {
+         binner->num_threads = 1;
+         num_jobs = 1;
+      }
+   }
+
+   binner->next_tile = 0;
+
+   /* The first worker runs on the context's thread */
+   for (i = 1; i < num_jobs; i++)
+      util_queue_add_job(&binner->queue, &binner->workers[i],
+                         &binner->workers[i].fence, bin_worker_execute, NULL);
+
+   bin_worker_run(&binner->workers[0]);
+
+   for (i = 1; i < num_jobs; i++)
+      util_queue_fence_wait(&binner->workers[i].fence);
+
+   for (i = 0; i < binner->num_threads; i++) {
+      struct softpipe_context *sp = &binner->workers[i].sp;
+
+      softpipe->occlusion_count += sp->occlusion_count;
+      softpipe->pipeline_statistics.ps_invocations +=
+         sp->pipeline_statistics.ps_invocations;
+      softpipe->pipeline_statistics.c_primitives +=
+         sp->pipeline_statistics.c_primitives;
+
+      sp->occlusion_count = 0;
+      sp->pipeline_statistics.ps_invocations = 0;
+      sp->pipeline_statistics.c_primitives = 0;
+   }
+
+   /* The workers did the pending clears of the tiles */
+   for (i = 0; i < binner->num_used_tiles; i++) {
+      const unsigned tile = binner->used_tiles[i];
+      const unsigned x = (tile % binner->tiles_x) * TILE_SIZE;
+      const unsigned y = (tile / binner->tiles_x) * TILE_SIZE;
+
+      for (c = 0; c < softpipe->framebuffer.nr_cbufs; c++) {
+         if (softpipe->framebuffer.cbufs[c])
+            sp_tile_cache_reset_clear(softpipe->cbuf_cache[c], x, y);
+      }
+      if (softpipe->framebuffer.zsbuf)
+         sp_tile_cache_reset_clear(softpipe->zsbuf_cache, x, y);
+
+      binner->bins[tile].count = 0;
+   }
+
+   binner->num_used_tiles = 0;
+   binner->num_prims = 0;
+   binner->num_verts = 0;
+}
+
+
+/**
+ * Point the workers' surface caches to the context's framebuffer, called
+ * after its surfaces changed.
+ */
+void
+sp_binner_set_framebuffer(struct sp_binner *binner)
+{
+   const struct pipe_framebuffer_state *fb = &binner->softpipe->framebuffer;
+   unsigned i, j;
+
+   assert(!binner->num_prims);
+
+   for (i = 0; i < binner->num_threads; i++) {
+      struct sp_bin_worker *worker = &binner->workers[i];
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++)
+         sp_tile_cache_set_surface(worker->cbuf_cache[j], fb->cbufs[j]);
+      sp_tile_cache_set_surface(worker->zsbuf_cache, fb->zsbuf);
+   }
+}
+
+
+/**
+ * Invalidate the workers' texture caches.
+ */
+void
+sp_binner_flush_texture_caches(struct sp_binner *binner)
+{
+   unsigned i, j;
+
+   for (i = 0; i < binner->num_threads; i++) {
+      struct sp_bin_worker *worker = &binner->workers[i];
+
+      for (j = 0; j < ARRAY_SIZE(worker->tex_cache); j++) {
+         if (worker->tex_cache[j])
+            sp_flush_tex_tile_cache(worker->tex_cache[j]);
+      }
+   }
+}
+
+
+/**
+ * Called when a fragment shader variant is deleted.
+ */
+void
+sp_binner_unbind_fs_variant(struct sp_binner *binner,
+                            const struct sp_fragment_shader_variant *var)
+{
+   unsigned i;
+
+   for (i = 0; i < binner->num_threads; i++) {
+      struct tgsi_exec_machine *machine = binner->workers[i].fs_machine;
+
+      if (machine->Tokens == var->tokens)
+         tgsi_exec_machine_bind_shader(machine, NULL, NULL, NULL, NULL);
+   }
+}
+
+
+struct sp_binner *
+sp_binner_create(struct softpipe_context *softpipe, unsigned num_threads)
+{
+   struct sp_binner *binner = CALLOC_STRUCT(sp_binner);
+   unsigned i;
+
+   if (!binner)
+      return NULL;
+
+   binner->softpipe = softpipe;
+   binner->num_threads = MIN2(num_threads, SP_BIN_MAX_THREADS);
+   binner->num_workers = binner->num_threads;
+
+   binner->workers = CALLOC(binner->num_workers, sizeof *binner->workers);
+   if (!binner->workers) {
+      FREE(binner);
+      return NULL;
+   }
+
+   for (i = 0; i < binner->num_workers; i++) {
+      if (!bin_worker_init(&binner->workers[i], binner)) {
+         binner->num_workers = i + 1;
+         sp_binner_destroy(binner);
+         return NULL;
+      }
+   }
+
+   return binner;
+}
+
+
+void
+sp_binner_destroy(struct sp_binner *binner)
+{
+   unsigned i;
+
+   if (binner->queue_created)
+      util_queue_destroy(&binner->queue);
+
+   for (i = 0; i < binner->num_workers; i++)
+      bin_worker_destroy(&binner->workers[i]);
+   FREE(binner->workers);
+
+   for (i = 0; i < binner->max_bins; i++)
+      FREE(binner->bins[i].prims);
+   FREE(binner->bins);
+   FREE(binner->used_tiles);
+   FREE(binner->prims);
+   FREE(binner->verts);
+
+   FREE(binner);
+}
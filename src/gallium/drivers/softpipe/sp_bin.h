@@ -0,0 +1,76 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#ifndef SP_BIN_H
+#define SP_BIN_H
+
+#include "pipe/p_compiler.h"
+
+struct softpipe_context;
+struct sp_binner;
+struct sp_fragment_shader_variant;
+
+/** Max number of threads rasterizing the tiles of the framebuffer */
+#define SP_BIN_MAX_THREADS 16
+
+struct sp_binner *
+sp_binner_create(struct softpipe_context *softpipe, unsigned num_threads);
+
+void
+sp_binner_destroy(struct sp_binner *binner);
+
+boolean
+sp_binner_begin(struct sp_binner *binner);
+
+void
+sp_binner_tri(struct sp_binner *binner,
+              const float (*v0)[4],
+              const float (*v1)[4],
+              const float (*v2)[4]);
+
+void
+sp_binner_line(struct sp_binner *binner,
+               const float (*v0)[4],
+               const float (*v1)[4]);
+
+void
+sp_binner_point(struct sp_binner *binner,
+                const float (*v0)[4]);
+
+void
+sp_binner_flush(struct sp_binner *binner);
+
+void
+sp_binner_set_framebuffer(struct sp_binner *binner);
+
+void
+sp_binner_flush_texture_caches(struct sp_binner *binner);
+
+void
+sp_binner_unbind_fs_variant(struct sp_binner *binner,
+                            const struct sp_fragment_shader_variant *var);
+
+#endif /* SP_BIN_H */
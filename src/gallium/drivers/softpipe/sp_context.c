@@ -39,6 +39,7 @@
 #include "util/u_inlines.h"
 #include "util/u_upload_mgr.h"
 #include "tgsi/tgsi_exec.h"
+#include "sp_bin.h"
 #include "sp_buffer.h"
 #include "sp_clear.h"
 #include "sp_context.h"
@@ -60,6 +61,9 @@ softpipe_destroy( struct pipe_context *pipe )
    struct softpipe_context *softpipe = softpipe_context( pipe );
    uint i, sh;
 
+   if (softpipe->binner)
+      sp_binner_destroy(softpipe->binner);
+
 #if DO_PSTIPPLE_IN_HELPER_MODULE
    if (softpipe->pstipple.sampler)
       pipe->delete_sampler_state(pipe, softpipe->pstipple.sampler);
@@ -296,6 +300,16 @@ softpipe_create_context(struct pipe_screen *screen,
                         (struct tgsi_sampler *)
                            softpipe->tgsi.sampler[PIPE_SHADER_GEOMETRY]);
 
+   draw_texture_sampler(softpipe->draw,
+                        PIPE_SHADER_TESS_CTRL,
+                        (struct tgsi_sampler *)
+                           softpipe->tgsi.sampler[PIPE_SHADER_TESS_CTRL]);
+
+   draw_texture_sampler(softpipe->draw,
+                        PIPE_SHADER_TESS_EVAL,
+                        (struct tgsi_sampler *)
+                           softpipe->tgsi.sampler[PIPE_SHADER_TESS_EVAL]);
+
    draw_image(softpipe->draw,
               PIPE_SHADER_VERTEX,
               (struct tgsi_image *)
@@ -306,6 +320,16 @@ softpipe_create_context(struct pipe_screen *screen,
               (struct tgsi_image *)
               softpipe->tgsi.image[PIPE_SHADER_GEOMETRY]);
 
+   draw_image(softpipe->draw,
+              PIPE_SHADER_TESS_CTRL,
+              (struct tgsi_image *)
+              softpipe->tgsi.image[PIPE_SHADER_TESS_CTRL]);
+
+   draw_image(softpipe->draw,
+              PIPE_SHADER_TESS_EVAL,
+              (struct tgsi_image *)
+              softpipe->tgsi.image[PIPE_SHADER_TESS_EVAL]);
+
    draw_buffer(softpipe->draw,
               PIPE_SHADER_VERTEX,
               (struct tgsi_buffer *)
@@ -316,9 +340,26 @@ softpipe_create_context(struct pipe_screen *screen,
               (struct tgsi_buffer *)
               softpipe->tgsi.buffer[PIPE_SHADER_GEOMETRY]);
 
+   draw_buffer(softpipe->draw,
+              PIPE_SHADER_TESS_CTRL,
+              (struct tgsi_buffer *)
+              softpipe->tgsi.buffer[PIPE_SHADER_TESS_CTRL]);
+
+   draw_buffer(softpipe->draw,
+              PIPE_SHADER_TESS_EVAL,
+              (struct tgsi_buffer *)
+              softpipe->tgsi.buffer[PIPE_SHADER_TESS_EVAL]);
+
    if (debug_get_bool_option( "SOFTPIPE_NO_RAST", FALSE ))
       softpipe->no_rast = TRUE;
 
+   /* Rasterize the framebuffer tiles on worker threads? */
+   {
+      unsigned num_threads = debug_get_num_option("SOFTPIPE_NUM_THREADS", 1);
+      if (num_threads > 1)
+         softpipe->binner = sp_binner_create(softpipe, num_threads);
+   }
+
    softpipe->vbuf_backend = sp_create_vbuf_backend(softpipe);
    if (!softpipe->vbuf_backend)
       goto fail;
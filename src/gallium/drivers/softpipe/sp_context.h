@@ -56,6 +56,7 @@ struct sp_fragment_shader;
 struct sp_vertex_shader;
 struct sp_velems_state;
 struct sp_so_state;
+struct sp_binner;
 
 struct softpipe_context {
    struct pipe_context pipe;  /**< base class */
@@ -69,6 +70,8 @@ struct softpipe_context {
    struct sp_fragment_shader_variant *fs_variant;
    struct sp_vertex_shader *vs;
    struct sp_geometry_shader *gs;
+   struct sp_tess_ctrl_shader *tcs;
+   struct sp_tess_eval_shader *tes;
    struct sp_velems_state *velems;
    struct sp_so_state *so;
    struct sp_compute_shader *cs;
@@ -90,6 +93,8 @@ struct softpipe_context {
    struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
    struct pipe_resource *mapped_vs_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    struct pipe_resource *mapped_gs_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct pipe_resource *mapped_tcs_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct pipe_resource *mapped_tes_tex[PIPE_MAX_SHADER_SAMPLER_VIEWS];
 
    struct draw_so_target *so_targets[PIPE_MAX_SO_BUFFERS];
    unsigned num_so_targets;
@@ -187,6 +192,9 @@ struct softpipe_context {
    struct vbuf_render *vbuf_backend;
    struct draw_stage *vbuf;
 
+   /** Tile binning for rasterization on worker threads, may be NULL */
+   struct sp_binner *binner;
+
    struct blitter_context *blitter;
 
    boolean dirty_render_cache;
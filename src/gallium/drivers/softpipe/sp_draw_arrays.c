@@ -37,6 +37,7 @@
 #include "util/u_draw.h"
 #include "util/u_prim.h"
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_query.h"
 #include "sp_state.h"
@@ -128,6 +129,12 @@ softpipe_draw_vbo(struct pipe_context *pipe,
       softpipe_prepare_geometry_sampling(sp,
                                          sp->num_sampler_views[PIPE_SHADER_GEOMETRY],
                                          sp->sampler_views[PIPE_SHADER_GEOMETRY]);
+      softpipe_prepare_tess_ctrl_sampling(sp,
+                                          sp->num_sampler_views[PIPE_SHADER_TESS_CTRL],
+                                          sp->sampler_views[PIPE_SHADER_TESS_CTRL]);
+      softpipe_prepare_tess_eval_sampling(sp,
+                                          sp->num_sampler_views[PIPE_SHADER_TESS_EVAL],
+                                          sp->sampler_views[PIPE_SHADER_TESS_EVAL]);
    }
 
    if (sp->gs && !sp->gs->shader.tokens) {
@@ -156,6 +163,8 @@ softpipe_draw_vbo(struct pipe_context *pipe,
    if (softpipe_screen(sp->pipe.screen)->use_llvm) {
       softpipe_cleanup_vertex_sampling(sp);
       softpipe_cleanup_geometry_sampling(sp);
+      softpipe_cleanup_tess_ctrl_sampling(sp);
+      softpipe_cleanup_tess_eval_sampling(sp);
    }
 
    /*
@@ -165,6 +174,9 @@ softpipe_draw_vbo(struct pipe_context *pipe,
     */
    draw_flush(draw);
 
+   if (sp->binner)
+      sp_binner_flush(sp->binner);
+
    /* Note: leave drawing surfaces mapped */
    sp->dirty_render_cache = TRUE;
 }
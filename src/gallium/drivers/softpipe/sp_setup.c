@@ -32,6 +32,7 @@
  * \author  Brian Paul
  */
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_quad.h"
 #include "sp_quad_pipe.h"
@@ -73,6 +74,7 @@ struct edge {
  */
 struct setup_context {
    struct softpipe_context *softpipe;
+   struct sp_binner *binner;  /**< if set, primitives are binned */
 
    /* Vertices are just an array of floats making up each attribute in
     * turn.  Currently fixed at 4 floats, but should change in time.
@@ -821,6 +823,11 @@ sp_setup_tri(struct setup_context *setup,
 
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
+
+   if (setup->binner) {
+      sp_binner_tri(setup->binner, v0, v1, v2);
+      return;
+   }
    
    det = calc_det(v0, v1, v2);
    /*
@@ -1107,6 +1114,11 @@ sp_setup_line(struct setup_context *setup,
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
 
+   if (setup->binner) {
+      sp_binner_line(setup->binner, v0, v1);
+      return;
+   }
+
    if (dx == 0 && dy == 0)
       return;
 
@@ -1254,6 +1266,11 @@ sp_setup_point(struct setup_context *setup,
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
 
+   if (setup->binner) {
+      sp_binner_point(setup->binner, v0);
+      return;
+   }
+
    assert(setup->softpipe->reduced_prim == PIPE_PRIM_POINTS);
 
    if (setup->softpipe->layer_slot > 0) {
@@ -1455,6 +1472,9 @@ sp_setup_prepare(struct setup_context *setup)
    int i;
    unsigned max_layer = ~0;
    if (sp->dirty) {
+      /* the binned primitives were set up with the current state */
+      if (sp->binner)
+         sp_binner_flush(sp->binner);
       softpipe_update_derived(sp, sp->reduced_api_prim);
    }
 
@@ -1490,6 +1510,10 @@ sp_setup_prepare(struct setup_context *setup)
       /* 'draw' will do culling */
       setup->cull_face = PIPE_FACE_NONE;
    }
+
+   /* rasterize on the worker threads if possible */
+   setup->binner = sp->binner && sp_binner_begin(sp->binner) ?
+      sp->binner : NULL;
 }
 
 
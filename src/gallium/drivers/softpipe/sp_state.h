@@ -53,6 +53,8 @@
 #define SP_NEW_GS            0x8000
 #define SP_NEW_SO            0x10000
 #define SP_NEW_SO_BUFFERS    0x20000
+#define SP_NEW_TCS           0x40000
+#define SP_NEW_TES           0x80000
 
 
 struct tgsi_sampler;
@@ -122,6 +124,20 @@ struct sp_geometry_shader {
    int max_sampler;
 };
 
+/** Subclass of pipe_shader_state */
+struct sp_tess_ctrl_shader {
+   struct pipe_shader_state shader;
+   struct draw_tess_ctrl_shader *draw_data;
+   int max_sampler;
+};
+
+/** Subclass of pipe_shader_state */
+struct sp_tess_eval_shader {
+   struct pipe_shader_state shader;
+   struct draw_tess_eval_shader *draw_data;
+   int max_sampler;
+};
+
 struct sp_velems_state {
    unsigned count;
    struct pipe_vertex_element velem[PIPE_MAX_ATTRIBS];
@@ -220,6 +236,22 @@ void
 softpipe_cleanup_geometry_sampling(struct softpipe_context *ctx);
 
 
+void
+softpipe_prepare_tess_ctrl_sampling(struct softpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+void
+softpipe_cleanup_tess_ctrl_sampling(struct softpipe_context *ctx);
+
+
+void
+softpipe_prepare_tess_eval_sampling(struct softpipe_context *ctx,
+                                    unsigned num,
+                                    struct pipe_sampler_view **views);
+void
+softpipe_cleanup_tess_eval_sampling(struct softpipe_context *ctx);
+
+
 void
 softpipe_launch_grid(struct pipe_context *context,
                      const struct pipe_grid_info *info);
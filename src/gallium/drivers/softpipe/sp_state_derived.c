@@ -311,6 +311,14 @@ update_tgsi_samplers( struct softpipe_context *softpipe )
       set_shader_sampler(softpipe, PIPE_SHADER_GEOMETRY,
                          softpipe->gs->max_sampler);
    }
+   if (softpipe->tcs) {
+      set_shader_sampler(softpipe, PIPE_SHADER_TESS_CTRL,
+                         softpipe->tcs->max_sampler);
+   }
+   if (softpipe->tes) {
+      set_shader_sampler(softpipe, PIPE_SHADER_TESS_EVAL,
+                         softpipe->tes->max_sampler);
+   }
 
    /* XXX is this really necessary here??? */
    for (sh = 0; sh < ARRAY_SIZE(softpipe->tex_cache); sh++) {
@@ -463,7 +471,9 @@ softpipe_update_derived(struct softpipe_context *softpipe, unsigned prim)
    if (softpipe->dirty & (SP_NEW_SAMPLER |
                           SP_NEW_TEXTURE |
                           SP_NEW_FS | 
-                          SP_NEW_VS))
+                          SP_NEW_VS |
+                          SP_NEW_TCS |
+                          SP_NEW_TES))
       update_tgsi_samplers( softpipe );
 
    if (softpipe->dirty & (SP_NEW_RASTERIZER |
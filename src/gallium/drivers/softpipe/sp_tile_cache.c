@@ -85,6 +85,19 @@ clear_clear_flag(uint *bitvec, union tile_address addr, unsigned max)
    assert(pos / 32 < max);
    bitvec[pos / 32] &= ~(1 << (pos & 31));
 }
+
+
+/**
+ * Mark the tile at (x,y) as cleared.
+ */
+static inline void
+set_clear_flag(uint *bitvec, union tile_address addr, unsigned max)
+{
+   int pos;
+   pos = addr_to_clear_pos(addr);
+   assert(pos / 32 < max);
+   bitvec[pos / 32] |= 1 << (pos & 31);
+}
    
 
 struct softpipe_tile_cache *
@@ -626,6 +639,52 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
 
 
 
+/**
+ * Copy the pending clear of the tile containing (x,y), in all layers, from
+ * one cache of the surface to another one.  Used to hand a tile over to a
+ * rasterizer thread which has its own cache of the same surface.
+ */
+void
+sp_tile_cache_copy_clear(struct softpipe_tile_cache *dst,
+                         const struct softpipe_tile_cache *src,
+                         unsigned x, unsigned y)
+{
+   int layer;
+
+   assert(dst->surface == src->surface);
+
+   dst->clear_color = src->clear_color;
+   dst->clear_val = src->clear_val;
+
+   for (layer = 0; layer < src->num_maps; layer++) {
+      union tile_address addr = tile_address(x, y, layer);
+
+      if (is_clear_flag_set(src->clear_flags, addr, src->clear_flags_size))
+         set_clear_flag(dst->clear_flags, addr, dst->clear_flags_size);
+      else
+         clear_clear_flag(dst->clear_flags, addr, dst->clear_flags_size);
+   }
+}
+
+
+/**
+ * Forget the pending clear of the tile containing (x,y), in all layers.
+ * The tile must not be in the cache.
+ */
+void
+sp_tile_cache_reset_clear(struct softpipe_tile_cache *tc,
+                          unsigned x, unsigned y)
+{
+   int layer;
+
+   for (layer = 0; layer < tc->num_maps; layer++) {
+      union tile_address addr = tile_address(x, y, layer);
+
+      clear_clear_flag(tc->clear_flags, addr, tc->clear_flags_size);
+   }
+}
+
+
 /**
  * When a whole surface is being cleared to a value we can avoid
  * fetching tiles above.
@@ -123,6 +123,15 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
                     const union pipe_color_union *color,
                     uint64_t clearValue);
 
+extern void
+sp_tile_cache_copy_clear(struct softpipe_tile_cache *dst,
+                         const struct softpipe_tile_cache *src,
+                         unsigned x, unsigned y);
+
+extern void
+sp_tile_cache_reset_clear(struct softpipe_tile_cache *tc,
+                          unsigned x, unsigned y);
+
 extern struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
                     union tile_address addr );
@@ -0,0 +1,261 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures how vertex processing in the draw module scales with
+ * DRAW_NUM_THREADS, on a driver using it such as llvmpipe or softpipe.
+ *
+ * Usage: vs-bench [max threads]
+ *
+ * Large point lists go through a long vertex shader, once per thread count
+ * from one up to the given maximum.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipe/p_state.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_inlines.h"
+#include "cso_cache/cso_context.h"
+#include "tgsi/tgsi_text.h"
+#include "util/u_draw_quad.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "util/os_time.h"
+#include "pipe-loader/pipe_loader.h"
+
+#define WIDTH 64
+#define HEIGHT 64
+#define NUM_VERTS (64 * 1024)
+#define NUM_DRAWS 20
+#define NUM_MADS 64
+
+struct program
+{
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_resource *vbuf;
+	struct pipe_resource *target;
+
+	void *vs;
+	void *fs;
+};
+
+static void *create_vs(struct pipe_context *pipe)
+{
+	struct tgsi_token tokens[1024];
+	struct pipe_shader_state state;
+	char text[4096], *s = text;
+	unsigned i;
+
+	s += sprintf(s, "VERT\n"
+		     "DCL IN[0]\n"
+		     "DCL OUT[0], POSITION\n"
+		     "DCL TEMP[0]\n"
+		     "IMM[0] FLT32 { 0.999, 0.001, 0.0, 0.0 }\n"
+		     "MOV TEMP[0], IN[0]\n");
+	for (i = 0; i < NUM_MADS; i++)
+		s += sprintf(s, "MAD TEMP[0].xy, TEMP[0], IMM[0].xxxx, IMM[0].yyyy\n");
+	sprintf(s, "MOV OUT[0], TEMP[0]\n"
+		"END\n");
+
+	if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens)))
+		return NULL;
+
+	pipe_shader_state_from_tgsi(&state, tokens);
+	return pipe->create_vs_state(pipe, &state);
+}
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+	struct pipe_resource tmplt;
+	float *vertices;
+	unsigned i;
+
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	/* points spread over the whole viewport */
+	vertices = MALLOC(NUM_VERTS * 4 * sizeof(float));
+	for (i = 0; i < NUM_VERTS; i++) {
+		vertices[i * 4 + 0] = (float)(i % 251) / 125.0f - 1.0f;
+		vertices[i * 4 + 1] = (float)(i % 241) / 120.0f - 1.0f;
+		vertices[i * 4 + 2] = 0.0f;
+		vertices[i * 4 + 3] = 1.0f;
+	}
+	p->vbuf = pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+				     PIPE_USAGE_DEFAULT,
+				     NUM_VERTS * 4 * sizeof(float));
+	pipe_buffer_write(p->pipe, p->vbuf, 0, NUM_VERTS * 4 * sizeof(float),
+			  vertices);
+	FREE(vertices);
+
+	memset(&tmplt, 0, sizeof(tmplt));
+	tmplt.target = PIPE_TEXTURE_2D;
+	tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	tmplt.width0 = WIDTH;
+	tmplt.height0 = HEIGHT;
+	tmplt.depth0 = 1;
+	tmplt.array_size = 1;
+	tmplt.bind = PIPE_BIND_RENDER_TARGET;
+	p->target = p->screen->resource_create(p->screen, &tmplt);
+
+	memset(&surf_tmpl, 0, sizeof(surf_tmpl));
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	p->vs = create_vs(p->pipe);
+	p->fs = util_make_empty_fragment_shader(p->pipe);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf, NULL);
+
+	p->pipe->destroy(p->pipe);
+}
+
+static double draw(struct program *p)
+{
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_vertex_element velem;
+	struct pipe_fence_handle *fence = NULL;
+	int64_t start;
+	unsigned i;
+
+	memset(&blend, 0, sizeof(blend));
+	blend.rt[0].colormask = PIPE_MASK_RGBA;
+	memset(&depthstencil, 0, sizeof(depthstencil));
+	memset(&rasterizer, 0, sizeof(rasterizer));
+	rasterizer.half_pixel_center = 1;
+	rasterizer.bottom_edge_rule = 1;
+	rasterizer.depth_clip = 1;
+	rasterizer.point_size = 1.0f;
+
+	memset(&viewport, 0, sizeof(viewport));
+	viewport.scale[0] = WIDTH / 2.0f;
+	viewport.scale[1] = HEIGHT / 2.0f;
+	viewport.scale[2] = 0.5f;
+	viewport.translate[0] = WIDTH / 2.0f;
+	viewport.translate[1] = HEIGHT / 2.0f;
+	viewport.translate[2] = 0.5f;
+
+	memset(&velem, 0, sizeof(velem));
+	velem.src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+	cso_set_blend(p->cso, &blend);
+	cso_set_depth_stencil_alpha(p->cso, &depthstencil);
+	cso_set_rasterizer(p->cso, &rasterizer);
+	cso_set_viewport(p->cso, &viewport);
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+	cso_set_vertex_elements(p->cso, 1, &velem);
+
+	/* warm up, compiling the shader variants */
+	util_draw_vertex_buffer(p->pipe, p->cso, p->vbuf, 0, 0,
+				PIPE_PRIM_POINTS, NUM_VERTS, 1);
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+
+	start = os_time_get_nano();
+	for (i = 0; i < NUM_DRAWS; i++)
+		util_draw_vertex_buffer(p->pipe, p->cso, p->vbuf, 0, 0,
+					PIPE_PRIM_POINTS, NUM_VERTS, 1);
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+
+	return (os_time_get_nano() - start) / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+	struct pipe_loader_device *dev;
+	struct program prog;
+	unsigned max_threads = argc > 1 ? atoi(argv[1]) : 8;
+	double base = 0.0;
+	unsigned t;
+
+	if (!pipe_loader_probe(&dev, 1)) {
+		fprintf(stderr, "no device found\n");
+		return 1;
+	}
+
+	memset(&prog, 0, sizeof(prog));
+	prog.screen = pipe_loader_create_screen(dev);
+	if (!prog.screen)
+		return 1;
+
+	printf("%s: %u points, %u MADs per vertex\n",
+	       prog.screen->get_name(prog.screen), NUM_VERTS, NUM_MADS);
+	printf("%8s %12s %8s\n", "threads", "Mverts/s", "speedup");
+
+	for (t = 1; t <= max_threads; t++) {
+		char value[16];
+		double secs;
+
+		/* read by the draw module when the context is created */
+		snprintf(value, sizeof(value), "%u", t);
+		setenv("DRAW_NUM_THREADS", value, 1);
+
+		init_prog(&prog);
+		secs = draw(&prog);
+		close_prog(&prog);
+
+		if (t == 1)
+			base = secs;
+		printf("%8u %12.2f %8.2f\n", t,
+		       NUM_VERTS * (double)NUM_DRAWS / secs / 1e6, base / secs);
+	}
+
+	prog.screen->destroy(prog.screen);
+	pipe_loader_release(&dev, 1);
+
+	return 0;
+}
@@ -89,6 +89,15 @@ class PrintCode(gl_XML.gl_print_base):
         out('debug_print_sync_fallback("{0}");'.format(func.name))
         self.print_sync_call(func)
 
+    def print_finish(self, func):
+        out('_mesa_glthread_finish_before(ctx, _gloffset_{0});'.format(
+                func.name))
+
+    def print_call_after(self, func):
+        if func.marshal_call_after:
+            assert func.return_type == 'void'
+            out('{0};'.format(func.marshal_call_after))
+
     def print_sync_body(self, func):
         out('/* {0}: marshalled synchronously */'.format(func.name))
         out('static {0} GLAPIENTRY'.format(func.return_type))
@@ -96,9 +105,10 @@ class PrintCode(gl_XML.gl_print_base):
         out('{')
         with indent():
             out('GET_CURRENT_CONTEXT(ctx);')
-            out('_mesa_glthread_finish(ctx);')
+            self.print_finish(func)
             out('debug_print_sync("{0}");'.format(func.name))
             self.print_sync_call(func)
+            self.print_call_after(func)
         out('}')
         out('')
         out('')
@@ -133,6 +143,7 @@ class PrintCode(gl_XML.gl_print_base):
         if not func.fixed_params and not func.variable_params:
             out('(void) cmd;\n')
         out('_mesa_post_marshal_hook(ctx);')
+        self.print_call_after(func)
 
     def print_async_struct(self, func):
         out('struct marshal_cmd_{0}'.format(func.name))
@@ -246,7 +257,7 @@ class PrintCode(gl_XML.gl_print_base):
             if func.marshal_fail:
                 out('if ({0}) {{'.format(func.marshal_fail))
                 with indent():
-                    out('_mesa_glthread_finish(ctx);')
+                    self.print_finish(func)
                     out('_mesa_glthread_restore_dispatch(ctx);')
                     self.print_sync_dispatch(func)
                     out('return;')
@@ -262,8 +273,9 @@ class PrintCode(gl_XML.gl_print_base):
         if need_fallback_sync:
             out('fallback_to_sync:')
         with indent():
-            out('_mesa_glthread_finish(ctx);')
+            self.print_finish(func)
             self.print_sync_dispatch(func)
+            self.print_call_after(func)
 
         out('}')
 
@@ -284,8 +296,7 @@ class PrintCode(gl_XML.gl_print_base):
             out('const struct marshal_cmd_base *cmd_base = cmd;')
             out('switch (cmd_base->cmd_id) {')
             for func in api.functionIterateAll():
-                flavor = func.marshal_flavor()
-                if flavor in ('skip', 'sync'):
+                if not func.marshal_has_cmd():
                     continue
                 out('case DISPATCH_CMD_{0}:'.format(func.name))
                 with indent():
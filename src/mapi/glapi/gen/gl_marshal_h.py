@@ -55,8 +55,7 @@ class PrintCode(gl_XML.gl_print_base):
         print 'enum marshal_dispatch_cmd_id'
         print '{'
         for func in api.functionIterateAll():
-            flavor = func.marshal_flavor()
-            if flavor in ('skip', 'sync'):
+            if not func.marshal_has_cmd():
                 continue
             print '   DISPATCH_CMD_{0},'.format(func.name)
         print '};'
@@ -58,6 +58,7 @@ class marshal_function(gl_XML.gl_function):
         # Store the "marshal" attribute, if present.
         self.marshal = element.get('marshal')
         self.marshal_fail = element.get('marshal_fail')
+        self.marshal_call_after = element.get('marshal_call_after')
 
     def marshal_flavor(self):
         """Find out how this function should be marshalled between
@@ -84,3 +85,18 @@ class marshal_function(gl_XML.gl_function):
                 # written logic to handle this yet.  TODO: fix.
                 return 'sync'
         return 'async'
+
+    def marshal_has_cmd(self):
+        """Find out whether calls to this function can be queued for the
+        server thread, which needs a command ID and an unmarshal function.
+        Custom marshalling of functions that return something to the client
+        thread only answers what it can without syncing."""
+        flavor = self.marshal_flavor()
+        if flavor == 'custom':
+            if self.return_type != 'void':
+                return False
+            for p in self.parameters:
+                if p.is_output:
+                    return False
+            return True
+        return flavor not in ('skip', 'sync')
@@ -30,6 +30,7 @@
 
 #include "context.h"
 #include "barrier.h"
+#include "bufferobj.h"
 
 
 static void
@@ -63,6 +64,9 @@ _mesa_MemoryBarrier(GLbitfield barriers)
 {
    GET_CURRENT_CONTEXT(ctx);
 
+   if (barriers & GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT)
+      _mesa_dirty_persistent_minmax_caches(ctx);
+
    if (ctx->Driver.MemoryBarrier)
       ctx->Driver.MemoryBarrier(ctx, barriers);
 }
@@ -573,6 +573,35 @@ count_buffer_size(GLuint key, void *data, void *userData)
 }
 
 
+/**
+ * Callback called from _mesa_HashWalk()
+ */
+static void
+dirty_persistent_minmax_cache(GLuint key, void *data, void *userData)
+{
+   struct gl_buffer_object *bufObj = (struct gl_buffer_object *) data;
+
+   (void) key;
+   (void) userData;
+   if (bufObj->Mappings[MAP_USER].AccessFlags & GL_MAP_PERSISTENT_BIT)
+      bufObj->MinMaxCacheDirty = true;
+}
+
+
+/**
+ * Mark the index min/max cache of every persistently mapped buffer as
+ * dirty.  glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT) makes
+ * client writes through such mappings visible, as
+ * glFlushMappedBufferRange() does.
+ */
+void
+_mesa_dirty_persistent_minmax_caches(struct gl_context *ctx)
+{
+   _mesa_HashWalk(ctx->Shared->BufferObjects, dirty_persistent_minmax_cache,
+                  NULL);
+}
+
+
 /**
  * Compute total size (in bytes) of all buffer objects for the given context.
  * For debugging purposes.
@@ -3413,6 +3442,8 @@ flush_mapped_buffer_range(struct gl_context *ctx,
 
    assert(bufObj->Mappings[MAP_USER].AccessFlags & GL_MAP_WRITE_BIT);
 
+   bufObj->MinMaxCacheDirty = true;
+
    if (ctx->Driver.FlushMappedBufferRange)
       ctx->Driver.FlushMappedBufferRange(ctx, offset, length, bufObj,
                                          MAP_USER);
@@ -3426,6 +3457,8 @@ _mesa_FlushMappedBufferRange_no_error(GLenum target, GLintptr offset,
    struct gl_buffer_object **bufObjPtr = get_buffer_target(ctx, target);
    struct gl_buffer_object *bufObj = *bufObjPtr;
 
+   bufObj->MinMaxCacheDirty = true;
+
    if (ctx->Driver.FlushMappedBufferRange)
       ctx->Driver.FlushMappedBufferRange(ctx, offset, length, bufObj,
                                          MAP_USER);
@@ -3454,6 +3487,8 @@ _mesa_FlushMappedNamedBufferRange_no_error(GLuint buffer, GLintptr offset,
    GET_CURRENT_CONTEXT(ctx);
    struct gl_buffer_object *bufObj = _mesa_lookup_bufferobj(ctx, buffer);
 
+   bufObj->MinMaxCacheDirty = true;
+
    if (ctx->Driver.FlushMappedBufferRange)
       ctx->Driver.FlushMappedBufferRange(ctx, offset, length, bufObj,
                                          MAP_USER);
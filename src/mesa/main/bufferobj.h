@@ -129,6 +129,9 @@ _mesa_reference_buffer_object(struct gl_context *ctx,
 extern GLuint
 _mesa_total_buffer_object_memory(struct gl_context *ctx);
 
+extern void
+_mesa_dirty_persistent_minmax_caches(struct gl_context *ctx);
+
 extern void
 _mesa_init_buffer_object_functions(struct dd_function_table *driver);
 
@@ -288,6 +288,9 @@
 /** For GL_ARB_pipeline_statistics_query */
 #define MAX_PIPELINE_STATISTICS             11
 
+/** For GL_ARB_parallel_shader_compile */
+#define MAX_SHADER_COMPILER_THREADS         4
+
 /** For GL_ARB_tessellation_shader */
 /*@{*/
 #define MAX_TESS_GEN_LEVEL 64
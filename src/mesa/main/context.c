@@ -1310,6 +1310,8 @@ _mesa_free_context_data( struct gl_context *ctx )
       _mesa_make_current(ctx, NULL, NULL);
    }
 
+   _mesa_destroy_link_queue(ctx);
+
    /* unreference WinSysDraw/Read buffers */
    _mesa_reference_framebuffer(&ctx->WinSysDrawBuffer, NULL);
    _mesa_reference_framebuffer(&ctx->WinSysReadBuffer, NULL);
@@ -1884,6 +1886,9 @@ _mesa_Finish(void)
    FLUSH_VERTICES(ctx, 0);
    FLUSH_CURRENT(ctx, 0);
 
+   /* Links are commands too, other contexts may rely on them being done. */
+   _mesa_finish_link_queue(ctx);
+
    if (ctx->Driver.Finish) {
       ctx->Driver.Finish(ctx);
    }
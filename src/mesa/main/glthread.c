@@ -33,9 +33,11 @@
  */
 
 #include "main/mtypes.h"
+#include "main/dispatch.h"
 #include "main/glthread.h"
 #include "main/marshal.h"
 #include "main/marshal_generated.h"
+#include "util/debug.h"
 #include "util/u_atomic.h"
 #include "util/u_thread.h"
 
@@ -92,8 +94,16 @@ _mesa_glthread_init(struct gl_context *ctx)
    }
 
    glthread->stats.queue = &glthread->queue;
+   if (env_var_as_boolean("MESA_GLTHREAD_STATS", false)) {
+      glthread->stats.num_calls = MAX2(_glapi_get_dispatch_table_size(),
+                                       _gloffset_COUNT);
+      glthread->stats.num_syncs_per_call =
+         calloc(glthread->stats.num_calls, sizeof(unsigned));
+   }
+
    ctx->CurrentClientDispatch = ctx->MarshalExec;
    ctx->GLThread = glthread;
+   _mesa_glthread_invalidate_state(ctx);
 
    /* Execute the thread initialization function in the thread. */
    struct util_queue_fence fence;
@@ -104,6 +114,27 @@ _mesa_glthread_init(struct gl_context *ctx)
    util_queue_fence_destroy(&fence);
 }
 
+/**
+ * Prints the MESA_GLTHREAD_STATS report: which entrypoints made the main
+ * thread wait for the worker thread, and how often.
+ */
+static void
+print_sync_stats(const struct util_queue_monitoring *stats)
+{
+   fprintf(stderr, "glthread: %u syncs, %u items offloaded, %u direct\n",
+           stats->num_syncs, stats->num_offloaded_items,
+           stats->num_direct_items);
+
+   for (unsigned i = 0; i < stats->num_calls; i++) {
+      if (stats->num_syncs_per_call[i]) {
+         const char *name = _glapi_get_proc_name(i);
+
+         fprintf(stderr, "glthread: %8u syncs in %s\n",
+                 stats->num_syncs_per_call[i], name ? name : "(unknown)");
+      }
+   }
+}
+
 void
 _mesa_glthread_destroy(struct gl_context *ctx)
 {
@@ -118,6 +149,11 @@ _mesa_glthread_destroy(struct gl_context *ctx)
    for (unsigned i = 0; i < MARSHAL_MAX_BATCHES; i++)
       util_queue_fence_destroy(&glthread->batches[i].fence);
 
+   if (glthread->stats.num_syncs_per_call) {
+      print_sync_stats(&glthread->stats);
+      free(glthread->stats.num_syncs_per_call);
+   }
+
    free(glthread);
    ctx->GLThread = NULL;
 
@@ -137,6 +173,24 @@ _mesa_glthread_restore_dispatch(struct gl_context *ctx)
        ctx->CurrentClientDispatch = ctx->CurrentServerDispatch;
        _glapi_set_dispatch(ctx->CurrentClientDispatch);
    }
+
+   /* Calls made directly don't update the shadow state. */
+   if (ctx->GLThread)
+      _mesa_glthread_invalidate_state(ctx);
+}
+
+/**
+ * Forgets all state shadowed on the main thread, for calls that change it
+ * in ways we don't track (glPopAttrib, display lists, indexed variants).
+ */
+void
+_mesa_glthread_invalidate_state(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   glthread->shadow.known = 0;
+   glthread->shadow.known_caps = 0;
+   glthread->shadow.no_error_at = -1;
 }
 
 void
@@ -162,6 +216,7 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
    }
 
    p_atomic_add(&glthread->stats.num_offloaded_items, next->used);
+   glthread->shadow.no_error_at = -1;
 
    util_queue_add_job(&glthread->queue, next, &next->fence,
                       glthread_unmarshal_batch, NULL);
@@ -174,13 +229,15 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
  *
  * This can be used by the main thread to synchronize access to the context,
  * since the worker thread will be idle after this.
+ *
+ * Returns whether the main thread actually had to wait or execute commands.
  */
-void
-_mesa_glthread_finish(struct gl_context *ctx)
+static bool
+glthread_finish(struct gl_context *ctx)
 {
    struct glthread_state *glthread = ctx->GLThread;
    if (!glthread)
-      return;
+      return false;
 
    /* If this is called from the worker thread, then we've hit a path that
     * might be called from either the main thread or the worker (such as some
@@ -188,12 +245,15 @@ _mesa_glthread_finish(struct gl_context *ctx)
     * synchronize against ourself.
     */
    if (u_thread_is_self(glthread->queue.threads[0]))
-      return;
+      return false;
 
    struct glthread_batch *last = &glthread->batches[glthread->last];
    struct glthread_batch *next = &glthread->batches[glthread->next];
    bool synced = false;
 
+   /* The caller is about to call into the context directly. */
+   glthread->shadow.no_error_at = -1;
+
    if (!util_queue_fence_is_signalled(&last->fence)) {
       util_queue_fence_wait(&last->fence);
       synced = true;
@@ -217,4 +277,26 @@ _mesa_glthread_finish(struct gl_context *ctx)
 
    if (synced)
       p_atomic_inc(&glthread->stats.num_syncs);
+
+   return synced;
+}
+
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   glthread_finish(ctx);
+}
+
+/**
+ * Like _mesa_glthread_finish(), but accounts the sync, if there is one, to
+ * the entrypoint at dispatch table offset \p offset for MESA_GLTHREAD_STATS.
+ */
+void
+_mesa_glthread_finish_before(struct gl_context *ctx, unsigned offset)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread_finish(ctx) && glthread->stats.num_syncs_per_call &&
+       offset < glthread->stats.num_calls)
+      p_atomic_inc(&glthread->stats.num_syncs_per_call[offset]);
 }
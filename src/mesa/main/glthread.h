@@ -51,6 +51,57 @@
 
 enum marshal_dispatch_cmd_id;
 
+/** A vertex array of the default vertex array object. */
+struct glthread_attrib
+{
+   /** Client memory address of the array, if it doesn't use a VBO. */
+   const GLubyte *pointer;
+
+   /** Size of one element in bytes. */
+   unsigned element_size;
+
+   /** Distance between elements in bytes, never 0. */
+   unsigned stride;
+};
+
+/**
+ * Vertex array state tracked on the main thread to decide whether a draw
+ * reads client memory, and to copy it.  Only the default vertex array
+ * object is tracked, since binding another one disables glthread outside
+ * of core contexts, and core contexts have no client arrays.
+ */
+struct glthread_client_arrays
+{
+   struct glthread_attrib attribs[VERT_ATTRIB_MAX];
+
+   /** VERT_BIT_* of enabled arrays. */
+   GLbitfield enabled;
+
+   /** VERT_BIT_* of arrays sourced from client memory. */
+   GLbitfield user;
+
+   /**
+    * VERT_BIT_* of arrays whose layout may differ from attribs[] (bad
+    * parameters, divisors, ARB_vertex_attrib_binding).  Draws sync when
+    * one of them is an enabled client array.
+    */
+   GLbitfield untracked;
+
+   /** glInterleavedArrays() was called, nothing above is reliable. */
+   bool unknown;
+
+   /** The unit selected by glClientActiveTexture(). */
+   unsigned client_active_texture;
+
+   /** Current GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER bindings. */
+   GLuint array_buffer;
+   GLuint element_array_buffer;
+
+   bool primitive_restart;
+   bool primitive_restart_fixed_index;
+   GLuint restart_index;
+};
+
 /** A single batch of commands queued up for execution. */
 struct glthread_batch
 {
@@ -84,24 +135,64 @@ struct glthread_state
    /** Index of the batch being filled and about to be submitted. */
    unsigned next;
 
-   /**
-    * Tracks on the main thread side whether the current vertex array binding
-    * is in a VBO.
-    */
-   bool vertex_array_is_vbo;
+   /** Vertex arrays, as seen by the main thread. */
+   struct glthread_client_arrays arrays;
+
+   /** Vertex arrays saved by glPushClientAttrib(). */
+   struct glthread_client_arrays client_attrib_stack[MAX_CLIENT_ATTRIB_STACK_DEPTH];
+   GLbitfield client_attrib_mask[MAX_CLIENT_ATTRIB_STACK_DEPTH];
+   unsigned client_attrib_depth;
 
    /**
-    * Tracks on the main thread side whether the current element array (index
-    * buffer) binding is in a VBO.
+    * Main thread copies of commonly queried state, so that glGet*() and
+    * glIsEnabled() can be answered without waiting for the worker thread.
+    * Every value starts out unknown and is learned either from a call that
+    * sets it to a value that is known to be valid, or from a query that had
+    * to sync anyway.
     */
-   bool element_array_is_vbo;
+   struct {
+      /** GLTHREAD_KNOWN_* bits of the values below that are valid. */
+      unsigned known;
+
+      /** Bits of glthread_cap_bit() capabilities whose state is known. */
+      unsigned known_caps;
+
+      /** Bits of glthread_cap_bit() capabilities that are enabled. */
+      unsigned enabled_caps;
+
+      GLenum active_texture;
+      GLenum matrix_mode;
+      GLint viewport[4];
+
+      /**
+       * The amount of the current batch that was used when glGetError()
+       * last returned, or -1.  The error flag is GL_NO_ERROR while nothing
+       * has been added to the batch since.
+       */
+      int no_error_at;
+
+      /**
+       * A display list may have left a glBegin() open.  Set by
+       * glCallList(), cleared by glEnd() or once a sync has shown that no
+       * primitive is open.  The calls tracked here fail between glBegin()
+       * and glEnd().
+       */
+      bool maybe_in_begin_end;
+   } shadow;
 };
 
+#define GLTHREAD_KNOWN_ACTIVE_TEXTURE  (1 << 0)
+#define GLTHREAD_KNOWN_MATRIX_MODE     (1 << 1)
+#define GLTHREAD_KNOWN_VIEWPORT        (1 << 2)
+
 void _mesa_glthread_init(struct gl_context *ctx);
 void _mesa_glthread_destroy(struct gl_context *ctx);
 
 void _mesa_glthread_restore_dispatch(struct gl_context *ctx);
 void _mesa_glthread_flush_batch(struct gl_context *ctx);
 void _mesa_glthread_finish(struct gl_context *ctx);
+void _mesa_glthread_finish_before(struct gl_context *ctx, unsigned offset);
+
+void _mesa_glthread_invalidate_state(struct gl_context *ctx);
 
 #endif /* _GLTHREAD_H*/
@@ -130,6 +130,18 @@ invalid_target:
    return;
 }
 
+/* GL_ARB_parallel_shader_compile */
+void GLAPIENTRY
+_mesa_MaxShaderCompilerThreadsARB(GLuint count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   /* The link queue picks up the new count the next time it is used.  Zero
+    * makes glLinkProgram synchronous again.
+    */
+   ctx->Hint.MaxShaderCompilerThreads = count;
+}
+
 
 /**********************************************************************/
 /*****                      Initialization                        *****/
@@ -146,4 +158,5 @@ void _mesa_init_hint( struct gl_context * ctx )
    ctx->Hint.TextureCompression = GL_DONT_CARE;
    ctx->Hint.GenerateMipmap = GL_DONT_CARE;
    ctx->Hint.FragmentShaderDerivative = GL_DONT_CARE;
+   ctx->Hint.MaxShaderCompilerThreads = 0xffffffff;
 }
@@ -27,8 +27,14 @@
  * thread when automatic code generation isn't appropriate.
  */
 
+#include "main/bufferobj.h"
 #include "main/enums.h"
+#include "main/glformats.h"
 #include "main/macros.h"
+#include "main/texstate.h"
+#include "main/varray.h"
+#include "util/bitscan.h"
+#include "vbo/vbo.h"
 #include "marshal.h"
 #include "dispatch.h"
 #include "marshal_generated.h"
@@ -95,14 +101,372 @@ _mesa_marshal_Enable(GLenum cap)
                                             sizeof(*cmd));
       cmd->cap = cap;
       _mesa_post_marshal_hook(ctx);
+      _mesa_glthread_Enable(ctx, cap);
       return;
    }
 
-   _mesa_glthread_finish(ctx);
+   _mesa_glthread_finish_before(ctx, _gloffset_Enable);
    debug_print_sync_fallback("Enable");
    CALL_Enable(ctx->CurrentServerDispatch, (cap));
 }
 
+/**
+ * Whether the calls being marshalled are between glBegin() and glEnd(),
+ * where everything tracked here fails with GL_INVALID_OPERATION.  glBegin()
+ * stops using glthread, so only a display list can have left a primitive
+ * open; that is found out by syncing.
+ */
+static bool
+in_begin_end(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->shadow.maybe_in_begin_end) {
+      _mesa_glthread_finish(ctx);
+      glthread->shadow.maybe_in_begin_end = _mesa_inside_begin_end(ctx);
+   }
+   return glthread->shadow.maybe_in_begin_end;
+}
+
+/**
+ * The capabilities whose state is shadowed on the main thread.  They are
+ * valid in every API, so glEnable() and glDisable() of them only fail
+ * between glBegin() and glEnd().
+ */
+static unsigned
+glthread_cap_bit(GLenum cap)
+{
+   switch (cap) {
+   case GL_BLEND:
+      return 1 << 0;
+   case GL_CULL_FACE:
+      return 1 << 1;
+   case GL_DEPTH_TEST:
+      return 1 << 2;
+   case GL_DITHER:
+      return 1 << 3;
+   case GL_POLYGON_OFFSET_FILL:
+      return 1 << 4;
+   case GL_SCISSOR_TEST:
+      return 1 << 5;
+   case GL_STENCIL_TEST:
+      return 1 << 6;
+   case GL_SAMPLE_ALPHA_TO_COVERAGE:
+      return 1 << 7;
+   case GL_SAMPLE_COVERAGE:
+      return 1 << 8;
+   default:
+      return 0;
+   }
+}
+
+static void
+track_cap(struct glthread_state *glthread, unsigned bit, bool enabled)
+{
+   glthread->shadow.known_caps |= bit;
+   if (enabled)
+      glthread->shadow.enabled_caps |= bit;
+   else
+      glthread->shadow.enabled_caps &= ~bit;
+}
+
+/**
+ * glEnable() and glDisable() of the caps that affect how draws read vertex
+ * arrays and indices.
+ */
+static void
+track_array_cap(struct gl_context *ctx, GLenum cap, bool enabled)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   switch (cap) {
+   case GL_VERTEX_ARRAY:
+   case GL_NORMAL_ARRAY:
+   case GL_COLOR_ARRAY:
+   case GL_TEXTURE_COORD_ARRAY:
+   case GL_INDEX_ARRAY:
+   case GL_EDGE_FLAG_ARRAY:
+   case GL_FOG_COORDINATE_ARRAY:
+   case GL_SECONDARY_COLOR_ARRAY:
+   case GL_POINT_SIZE_ARRAY_OES:
+      _mesa_glthread_ClientState(ctx, cap, enabled);
+      break;
+   case GL_PRIMITIVE_RESTART:
+      if (_mesa_is_desktop_gl(ctx) && ctx->Version >= 31)
+         arrays->primitive_restart = enabled;
+      break;
+   case GL_PRIMITIVE_RESTART_FIXED_INDEX:
+      if (_mesa_is_gles3(ctx) || ctx->Extensions.ARB_ES3_compatibility)
+         arrays->primitive_restart_fixed_index = enabled;
+      break;
+   }
+}
+
+void
+_mesa_glthread_CallList(struct gl_context *ctx)
+{
+   _mesa_glthread_invalidate_state(ctx);
+   ctx->GLThread->shadow.maybe_in_begin_end = true;
+}
+
+void
+_mesa_glthread_End(struct gl_context *ctx)
+{
+   /* glEnd() either ends the primitive or fails outside of one. */
+   ctx->GLThread->shadow.maybe_in_begin_end = false;
+}
+
+void
+_mesa_glthread_Enable(struct gl_context *ctx, GLenum cap)
+{
+   if (in_begin_end(ctx))
+      return;
+
+   track_cap(ctx->GLThread, glthread_cap_bit(cap), true);
+   track_array_cap(ctx, cap, true);
+}
+
+void
+_mesa_glthread_Disable(struct gl_context *ctx, GLenum cap)
+{
+   if (in_begin_end(ctx))
+      return;
+
+   track_cap(ctx->GLThread, glthread_cap_bit(cap), false);
+   track_array_cap(ctx, cap, false);
+}
+
+void
+_mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (in_begin_end(ctx))
+      return;
+
+   /* Out of range units generate an error and don't change anything. */
+   if (texture - GL_TEXTURE0 < _mesa_max_tex_unit(ctx)) {
+      glthread->shadow.active_texture = texture;
+      glthread->shadow.known |= GLTHREAD_KNOWN_ACTIVE_TEXTURE;
+   }
+}
+
+static bool
+has_matrix_mode(const struct gl_context *ctx)
+{
+   return ctx->API == API_OPENGL_COMPAT || ctx->API == API_OPENGLES;
+}
+
+void
+_mesa_glthread_MatrixMode(struct gl_context *ctx, GLenum mode)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (in_begin_end(ctx))
+      return;
+
+   switch (mode) {
+   case GL_MODELVIEW:
+   case GL_PROJECTION:
+   case GL_TEXTURE:
+      if (has_matrix_mode(ctx)) {
+         glthread->shadow.matrix_mode = mode;
+         glthread->shadow.known |= GLTHREAD_KNOWN_MATRIX_MODE;
+      }
+      break;
+   default:
+      /* The others depend on extensions, don't bother checking them. */
+      glthread->shadow.known &= ~GLTHREAD_KNOWN_MATRIX_MODE;
+      break;
+   }
+}
+
+void
+_mesa_glthread_Viewport(struct gl_context *ctx, GLint x, GLint y,
+                        GLsizei width, GLsizei height)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   float min = ctx->Const.ViewportBounds.Min;
+   float max = ctx->Const.ViewportBounds.Max;
+
+   if (in_begin_end(ctx))
+      return;
+
+   /* Negative sizes generate an error and don't change anything. */
+   if (width < 0 || height < 0)
+      return;
+
+   /* Only remember values that clamp_viewport() doesn't change. */
+   if (width > ctx->Const.MaxViewportWidth ||
+       height > ctx->Const.MaxViewportHeight ||
+       ((ctx->Extensions.ARB_viewport_array ||
+         (ctx->Extensions.OES_viewport_array && _mesa_is_gles31(ctx))) &&
+        (x < min || x > max || y < min || y > max))) {
+      glthread->shadow.known &= ~GLTHREAD_KNOWN_VIEWPORT;
+      return;
+   }
+
+   glthread->shadow.viewport[0] = x;
+   glthread->shadow.viewport[1] = y;
+   glthread->shadow.viewport[2] = width;
+   glthread->shadow.viewport[3] = height;
+   glthread->shadow.known |= GLTHREAD_KNOWN_VIEWPORT;
+}
+
+/**
+ * Returns the number of values written to \p values if \p pname is shadowed
+ * and known, or 0 if the query has to be executed by Mesa.
+ */
+static unsigned
+get_shadowed_state(const struct gl_context *ctx, GLenum pname, GLint *values)
+{
+   const struct glthread_state *glthread = ctx->GLThread;
+   unsigned bit = glthread_cap_bit(pname);
+
+   if (glthread->shadow.known_caps & bit) {
+      values[0] = (glthread->shadow.enabled_caps & bit) != 0;
+      return 1;
+   }
+
+   switch (pname) {
+   case GL_ACTIVE_TEXTURE:
+      if (!(glthread->shadow.known & GLTHREAD_KNOWN_ACTIVE_TEXTURE))
+         return 0;
+      values[0] = glthread->shadow.active_texture;
+      return 1;
+   case GL_MATRIX_MODE:
+      if (!(glthread->shadow.known & GLTHREAD_KNOWN_MATRIX_MODE))
+         return 0;
+      values[0] = glthread->shadow.matrix_mode;
+      return 1;
+   case GL_VIEWPORT:
+      if (!(glthread->shadow.known & GLTHREAD_KNOWN_VIEWPORT))
+         return 0;
+      memcpy(values, glthread->shadow.viewport, 4 * sizeof(GLint));
+      return 4;
+   default:
+      return 0;
+   }
+}
+
+/**
+ * Remembers the result of a query that had to be executed by Mesa.
+ */
+static void
+learn_shadowed_state(struct gl_context *ctx, GLenum pname,
+                     const GLint *values)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   unsigned bit = glthread_cap_bit(pname);
+
+   if (bit) {
+      track_cap(glthread, bit, values[0] != 0);
+      return;
+   }
+
+   switch (pname) {
+   case GL_ACTIVE_TEXTURE:
+      glthread->shadow.active_texture = values[0];
+      glthread->shadow.known |= GLTHREAD_KNOWN_ACTIVE_TEXTURE;
+      break;
+   case GL_MATRIX_MODE:
+      if (has_matrix_mode(ctx)) {
+         glthread->shadow.matrix_mode = values[0];
+         glthread->shadow.known |= GLTHREAD_KNOWN_MATRIX_MODE;
+      }
+      break;
+   case GL_VIEWPORT:
+      memcpy(glthread->shadow.viewport, values, 4 * sizeof(GLint));
+      glthread->shadow.known |= GLTHREAD_KNOWN_VIEWPORT;
+      break;
+   }
+}
+
+/* IsEnabled: answered from the shadowed state when possible */
+GLboolean GLAPIENTRY
+_mesa_marshal_IsEnabled(GLenum cap)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   unsigned bit = glthread_cap_bit(cap);
+   GLboolean result;
+
+   if (glthread->shadow.known_caps & bit) {
+      debug_print_marshal("IsEnabled");
+      return (glthread->shadow.enabled_caps & bit) != 0;
+   }
+
+   _mesa_glthread_finish_before(ctx, _gloffset_IsEnabled);
+   debug_print_sync("IsEnabled");
+   result = CALL_IsEnabled(ctx->CurrentServerDispatch, (cap));
+   if (bit)
+      track_cap(glthread, bit, result);
+   return result;
+}
+
+/* GetBooleanv: answered from the shadowed state when possible */
+void GLAPIENTRY
+_mesa_marshal_GetBooleanv(GLenum pname, GLboolean *params)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   unsigned bit = glthread_cap_bit(pname);
+
+   if (glthread->shadow.known_caps & bit) {
+      debug_print_marshal("GetBooleanv");
+      params[0] = (glthread->shadow.enabled_caps & bit) != 0;
+      return;
+   }
+
+   _mesa_glthread_finish_before(ctx, _gloffset_GetBooleanv);
+   debug_print_sync("GetBooleanv");
+   CALL_GetBooleanv(ctx->CurrentServerDispatch, (pname, params));
+   if (bit)
+      track_cap(glthread, bit, params[0]);
+}
+
+/* GetIntegerv: answered from the shadowed state when possible */
+void GLAPIENTRY
+_mesa_marshal_GetIntegerv(GLenum pname, GLint *params)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (get_shadowed_state(ctx, pname, params)) {
+      debug_print_marshal("GetIntegerv");
+      return;
+   }
+
+   _mesa_glthread_finish_before(ctx, _gloffset_GetIntegerv);
+   debug_print_sync("GetIntegerv");
+   CALL_GetIntegerv(ctx->CurrentServerDispatch, (pname, params));
+   learn_shadowed_state(ctx, pname, params);
+}
+
+/**
+ * GetError: nothing can have set the error flag if no command was queued
+ * since the last call, which is the common case of applications checking
+ * errors after every call.
+ */
+GLenum GLAPIENTRY
+_mesa_marshal_GetError(void)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   GLenum error;
+
+   if (glthread->shadow.no_error_at ==
+       (int)glthread->batches[glthread->next].used) {
+      debug_print_marshal("GetError");
+      return GL_NO_ERROR;
+   }
+
+   _mesa_glthread_finish_before(ctx, _gloffset_GetError);
+   debug_print_sync("GetError");
+   error = CALL_GetError(ctx->CurrentServerDispatch, ());
+   glthread->shadow.no_error_at = glthread->batches[glthread->next].used;
+   return error;
+}
+
 struct marshal_cmd_ShaderSource
 {
    struct marshal_cmd_base cmd_base;
@@ -232,16 +596,19 @@ track_vbo_binding(struct gl_context *ctx, GLenum target, GLuint buffer)
 {
    struct glthread_state *glthread = ctx->GLThread;
 
+   if (in_begin_end(ctx))
+      return;
+
    switch (target) {
    case GL_ARRAY_BUFFER:
-      glthread->vertex_array_is_vbo = (buffer != 0);
+      glthread->arrays.array_buffer = buffer;
       break;
    case GL_ELEMENT_ARRAY_BUFFER:
       /* The current element array buffer binding is actually tracked in the
        * vertex array object instead of the context, so this would need to
        * change on vertex array object updates.
        */
-      glthread->element_array_is_vbo = (buffer != 0);
+      glthread->arrays.element_array_buffer = buffer;
       break;
    }
 }
@@ -288,6 +655,266 @@ _mesa_marshal_BindBuffer(GLenum target, GLuint buffer)
    }
 }
 
+/**
+ * gl*Pointer(): remember where the array is and how large its elements are,
+ * so that draws can copy it if it's in client memory.
+ */
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                             GLint size, GLenum type, GLsizei stride,
+                             const GLvoid *pointer)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   struct glthread_attrib *array = &arrays->attribs[attrib];
+   const GLbitfield bit = VERT_BIT(attrib);
+   GLint element_size =
+      _mesa_bytes_per_vertex_attrib(size == GL_BGRA ? 4 : size, type);
+
+   if (in_begin_end(ctx))
+      return;
+
+   /* Leave the layout of erroneous calls to the draw-time checks. */
+   if (element_size <= 0 || stride < 0) {
+      arrays->untracked |= bit;
+      return;
+   }
+
+   arrays->untracked &= ~bit;
+   array->element_size = element_size;
+   array->stride = stride ? stride : element_size;
+
+   if (arrays->array_buffer == 0 && pointer) {
+      array->pointer = pointer;
+      arrays->user |= bit;
+   } else {
+      array->pointer = NULL;
+      arrays->user &= ~bit;
+   }
+}
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size,
+                               GLenum type, GLsizei stride,
+                               const GLvoid *pointer)
+{
+   unsigned unit = ctx->GLThread->arrays.client_active_texture;
+
+   _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_TEX(unit), size, type,
+                                stride, pointer);
+}
+
+void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index,
+                                   GLint size, GLenum type, GLsizei stride,
+                                   const GLvoid *pointer)
+{
+   if (index >= ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs)
+      return;
+
+   _mesa_glthread_AttribPointer(ctx, VERT_ATTRIB_GENERIC(index), size, type,
+                                stride, pointer);
+}
+
+/**
+ * glInterleavedArrays() sets several arrays at once, give up on tracking
+ * them instead of duplicating its table.
+ */
+void
+_mesa_glthread_InterleavedArrays(struct gl_context *ctx)
+{
+   ctx->GLThread->arrays.unknown = true;
+}
+
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   gl_vert_attrib attrib;
+
+   if (in_begin_end(ctx))
+      return;
+
+   switch (array) {
+   case GL_VERTEX_ARRAY:
+      attrib = VERT_ATTRIB_POS;
+      break;
+   case GL_NORMAL_ARRAY:
+      attrib = VERT_ATTRIB_NORMAL;
+      break;
+   case GL_COLOR_ARRAY:
+      attrib = VERT_ATTRIB_COLOR0;
+      break;
+   case GL_INDEX_ARRAY:
+      attrib = VERT_ATTRIB_COLOR_INDEX;
+      break;
+   case GL_TEXTURE_COORD_ARRAY:
+      attrib = VERT_ATTRIB_TEX(arrays->client_active_texture);
+      break;
+   case GL_EDGE_FLAG_ARRAY:
+      attrib = VERT_ATTRIB_EDGEFLAG;
+      break;
+   case GL_FOG_COORDINATE_ARRAY:
+      attrib = VERT_ATTRIB_FOG;
+      break;
+   case GL_SECONDARY_COLOR_ARRAY:
+      attrib = VERT_ATTRIB_COLOR1;
+      break;
+   case GL_POINT_SIZE_ARRAY_OES:
+      attrib = VERT_ATTRIB_POINT_SIZE;
+      break;
+   case GL_PRIMITIVE_RESTART_NV:
+      if (ctx->Extensions.NV_primitive_restart)
+         arrays->primitive_restart = enable;
+      return;
+   default:
+      return;
+   }
+
+   if (enable)
+      arrays->enabled |= VERT_BIT(attrib);
+   else
+      arrays->enabled &= ~VERT_BIT(attrib);
+}
+
+void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 bool enable)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (in_begin_end(ctx))
+      return;
+
+   if (index >= ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs)
+      return;
+
+   if (enable)
+      arrays->enabled |= VERT_BIT_GENERIC(index);
+   else
+      arrays->enabled &= ~VERT_BIT_GENERIC(index);
+}
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture)
+{
+   if (in_begin_end(ctx))
+      return;
+
+   if (texture - GL_TEXTURE0 < ctx->Const.MaxTextureCoordUnits)
+      ctx->GLThread->arrays.client_active_texture = texture - GL_TEXTURE0;
+}
+
+/**
+ * Instanced arrays and ARB_vertex_attrib_binding make generic arrays read
+ * memory in ways the copies don't cover, so draws sync while such arrays
+ * are client arrays.
+ */
+void
+_mesa_glthread_VertexAttribDivisor(struct gl_context *ctx, GLuint index,
+                                   GLuint divisor)
+{
+   struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (in_begin_end(ctx))
+      return;
+
+   if (index >= ctx->Const.Program[MESA_SHADER_VERTEX].MaxAttribs)
+      return;
+
+   if (divisor)
+      arrays->untracked |= VERT_BIT_GENERIC(index);
+   else
+      arrays->untracked &= ~VERT_BIT_GENERIC(index);
+}
+
+void
+_mesa_glthread_untrack_generic_arrays(struct gl_context *ctx)
+{
+   ctx->GLThread->arrays.untracked |= VERT_BIT_GENERIC_ALL;
+}
+
+void
+_mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx, GLuint index)
+{
+   if (in_begin_end(ctx))
+      return;
+
+   ctx->GLThread->arrays.restart_index = index;
+}
+
+void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (in_begin_end(ctx))
+      return;
+
+   if (glthread->client_attrib_depth >= MAX_CLIENT_ATTRIB_STACK_DEPTH)
+      return;
+
+   glthread->client_attrib_stack[glthread->client_attrib_depth] =
+      glthread->arrays;
+   glthread->client_attrib_mask[glthread->client_attrib_depth] = mask;
+   glthread->client_attrib_depth++;
+}
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (in_begin_end(ctx))
+      return;
+
+   if (glthread->client_attrib_depth == 0)
+      return;
+
+   glthread->client_attrib_depth--;
+   if (glthread->client_attrib_mask[glthread->client_attrib_depth] &
+       GL_CLIENT_VERTEX_ARRAY_BIT) {
+      glthread->arrays =
+         glthread->client_attrib_stack[glthread->client_attrib_depth];
+   }
+}
+
+/**
+ * Deleting a bound buffer unbinds it.  glPopClientAttrib() doesn't restore
+ * saved bindings of deleted buffers as they were, so just stop trusting the
+ * saved state.
+ */
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (in_begin_end(ctx))
+      return;
+
+   if (n < 0 || !buffers)
+      return;
+
+   for (GLsizei i = 0; i < n; i++) {
+      GLuint id = buffers[i];
+
+      if (id == 0)
+         continue;
+
+      if (glthread->arrays.array_buffer == id)
+         glthread->arrays.array_buffer = 0;
+      if (glthread->arrays.element_array_buffer == id)
+         glthread->arrays.element_array_buffer = 0;
+
+      for (unsigned j = 0; j < glthread->client_attrib_depth; j++) {
+         if (glthread->client_attrib_stack[j].array_buffer == id ||
+             glthread->client_attrib_stack[j].element_array_buffer == id)
+            glthread->client_attrib_stack[j].unknown = true;
+      }
+   }
+}
+
+
 /* BufferData: marshalled asynchronously */
 struct marshal_cmd_BufferData
 {
@@ -747,3 +1374,472 @@ _mesa_marshal_ClearBufferfi(GLenum buffer, GLint drawbuffer,
                          (buffer, drawbuffer, depth, stencil));
    }
 }
+
+
+/**
+ * Draws that read client memory.
+ *
+ * The enabled client arrays, and the indices when they are in client memory
+ * too, are copied into the command (or into a heap block when they don't
+ * fit in a batch), so that the application may change its memory as soon
+ * as the draw call returns, like the GL requires.  The worker thread points
+ * the arrays at the copies for the duration of the draw.
+ */
+struct marshal_user_array
+{
+   /** The pointer given to gl*Pointer(), checked by the worker. */
+   const GLubyte *pointer;
+   GLuint element_size;
+   GLsizei stride;
+   /** Where vertex 0 would be, relative to the start of the copies. */
+   intptr_t offset;
+};
+
+/**
+ * Returns the size of the copies of vertices \p start to \p end of the
+ * arrays \p user_arrays, starting at \p size bytes, or SIZE_MAX if they are
+ * too large to be worth copying.
+ */
+static size_t
+user_arrays_size(const struct glthread_client_arrays *arrays,
+                 GLbitfield user_arrays, unsigned start, unsigned end,
+                 size_t size)
+{
+   while (user_arrays) {
+      const struct glthread_attrib *array =
+         &arrays->attribs[u_bit_scan(&user_arrays)];
+      uint64_t array_size =
+         (uint64_t) (end - start) * array->stride + array->element_size;
+
+      size = ALIGN(size, 8) + array_size;
+      if (size > INT32_MAX)
+         return SIZE_MAX;
+   }
+   return size;
+}
+
+/**
+ * Copies vertices \p start to \p end of the arrays \p user_arrays to
+ * \p data + \p pos and fills the descriptors the worker needs to find them.
+ */
+static void
+copy_user_arrays(const struct glthread_client_arrays *arrays,
+                 GLbitfield user_arrays, unsigned start, unsigned end,
+                 struct marshal_user_array *descs, GLubyte *data, size_t pos)
+{
+   for (unsigned i = 0; user_arrays; i++) {
+      const struct glthread_attrib *array =
+         &arrays->attribs[u_bit_scan(&user_arrays)];
+      size_t array_size =
+         (size_t) (end - start) * array->stride + array->element_size;
+
+      pos = ALIGN(pos, 8);
+      memcpy(data + pos, array->pointer + (size_t) start * array->stride,
+             array_size);
+
+      descs[i].pointer = array->pointer;
+      descs[i].element_size = array->element_size;
+      descs[i].stride = array->stride;
+      descs[i].offset = (intptr_t) pos - (intptr_t) start * array->stride;
+      pos += array_size;
+   }
+}
+
+/**
+ * Points the client arrays of the current vertex array object at the copies
+ * in \p data, returning the application's pointers in \p ptrs.  Returns
+ * false without changing anything if the arrays don't look like the main
+ * thread thought, which only happens after erroneous gl*Pointer() calls.
+ * The draw then reads the arrays as they are bound, as it would without
+ * the thread.
+ */
+static bool
+bind_user_arrays(struct gl_context *ctx, GLbitfield user_arrays,
+                 const struct marshal_user_array *descs,
+                 const GLubyte *data, const GLubyte **ptrs)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   GLbitfield others =
+      vao->_Enabled & ~vao->VertexAttribBufferMask & ~user_arrays;
+   GLbitfield mask = user_arrays;
+
+   /* Other enabled client arrays would be read from client memory. */
+   while (others) {
+      if (vao->VertexAttrib[u_bit_scan(&others)].Ptr)
+         return false;
+   }
+
+   for (unsigned i = 0; mask; i++) {
+      const unsigned attrib = u_bit_scan(&mask);
+      const struct gl_array_attributes *array = &vao->VertexAttrib[attrib];
+
+      if (!array->Enabled ||
+          array->BufferBindingIndex != attrib ||
+          _mesa_is_bufferobj(vao->BufferBinding[attrib].BufferObj) ||
+          array->Ptr != descs[i].pointer ||
+          array->_ElementSize != descs[i].element_size ||
+          vao->BufferBinding[attrib].Stride != descs[i].stride)
+         return false;
+
+      ptrs[i] = data + descs[i].offset;
+   }
+
+   if (user_arrays)
+      _mesa_exchange_client_array_pointers(ctx, user_arrays, ptrs);
+   return true;
+}
+
+/**
+ * Returns whether the main thread can't copy what a draw reads from client
+ * memory, because it doesn't know the layout of some of the arrays.
+ */
+static bool
+user_arrays_unknown(const struct gl_context *ctx, GLbitfield user_arrays)
+{
+   const struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   return arrays->unknown || (user_arrays & arrays->untracked);
+}
+
+/* DrawArrays: marshalled asynchronously, with client arrays copied */
+struct marshal_cmd_DrawArrays
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum mode;
+   GLint first;
+   GLsizei count;
+   GLbitfield user_arrays;
+   /** The copies of the arrays, if they aren't in the command. */
+   GLubyte *heap;
+   /* Next are struct marshal_user_array descs[bitcount(user_arrays)],
+    * followed by the copies unless heap is set.
+    */
+};
+
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_DrawArrays *cmd)
+{
+   const GLenum mode = cmd->mode;
+   const GLint first = cmd->first;
+   const GLsizei count = cmd->count;
+   const GLbitfield user_arrays = cmd->user_arrays;
+   const struct marshal_user_array *descs =
+      (const struct marshal_user_array *) (cmd + 1);
+   const GLubyte *ptrs[VERT_ATTRIB_MAX];
+
+   if (!user_arrays) {
+      CALL_DrawArrays(ctx->CurrentServerDispatch, (mode, first, count));
+      return;
+   }
+
+   const unsigned num_arrays = util_bitcount(user_arrays);
+   const GLubyte *data = cmd->heap ? cmd->heap :
+                         (const GLubyte *) (descs + num_arrays);
+
+   const bool bound = bind_user_arrays(ctx, user_arrays, descs, data, ptrs);
+
+   CALL_DrawArrays(ctx->CurrentServerDispatch, (mode, first, count));
+
+   if (bound)
+      _mesa_exchange_client_array_pointers(ctx, user_arrays, ptrs);
+   free(cmd->heap);
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   const struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   const GLbitfield user_arrays = _mesa_glthread_get_user_arrays(ctx);
+   struct marshal_cmd_DrawArrays *cmd;
+   debug_print_marshal("DrawArrays");
+
+   if (!user_arrays) {
+      cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_DrawArrays,
+                                            sizeof(*cmd));
+      cmd->mode = mode;
+      cmd->first = first;
+      cmd->count = count;
+      cmd->user_arrays = 0;
+      cmd->heap = NULL;
+      _mesa_post_marshal_hook(ctx);
+      return;
+   }
+
+   /* Leave errors and empty draws to Mesa. */
+   if (user_arrays_unknown(ctx, user_arrays) || first < 0 || count <= 0)
+      goto fallback_to_sync;
+
+   const unsigned num_arrays = util_bitcount(user_arrays);
+   const unsigned start = first;
+   const unsigned end = start + count - 1;
+   const size_t descs_size =
+      sizeof(*cmd) + num_arrays * sizeof(struct marshal_user_array);
+   const size_t data_size =
+      user_arrays_size(arrays, user_arrays, start, end, 0);
+
+   if (end < start || data_size == SIZE_MAX)
+      goto fallback_to_sync;
+
+   const bool inline_data = descs_size + data_size <= MARSHAL_MAX_CMD_SIZE;
+   GLubyte *heap = NULL;
+
+   if (!inline_data) {
+      heap = malloc(data_size);
+      if (!heap)
+         goto fallback_to_sync;
+   }
+
+   cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_DrawArrays,
+                                         inline_data ? descs_size + data_size
+                                                     : descs_size);
+   cmd->mode = mode;
+   cmd->first = first;
+   cmd->count = count;
+   cmd->user_arrays = user_arrays;
+   cmd->heap = heap;
+
+   struct marshal_user_array *descs = (struct marshal_user_array *) (cmd + 1);
+   copy_user_arrays(arrays, user_arrays, start, end, descs,
+                    heap ? heap : (GLubyte *) (descs + num_arrays), 0);
+   _mesa_post_marshal_hook(ctx);
+   return;
+
+fallback_to_sync:
+   _mesa_glthread_finish_before(ctx, _gloffset_DrawArrays);
+   debug_print_sync_fallback("DrawArrays");
+   CALL_DrawArrays(ctx->CurrentServerDispatch, (mode, first, count));
+}
+
+/* DrawElements and DrawRangeElements: marshalled asynchronously, with client
+ * arrays and indices copied
+ */
+struct marshal_cmd_DrawElements
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum mode;
+   GLsizei count;
+   GLenum type;
+   GLuint start;
+   GLuint end;
+   /** The range of vertices the copies of the user arrays hold. */
+   GLuint min_index;
+   GLuint max_index;
+   GLbitfield user_arrays;
+   /** Whether the indices are copied, instead of being an offset. */
+   bool user_indices;
+   /** What the application passed, even if the indices are copied. */
+   const GLvoid *indices;
+   /** The copies of the indices and arrays, if they aren't in the command. */
+   GLubyte *heap;
+   /* Next are struct marshal_user_array descs[bitcount(user_arrays)],
+    * followed by the copies unless heap is set.  The indices come first.
+    */
+};
+
+static void
+unmarshal_draw_elements(struct gl_context *ctx,
+                        const struct marshal_cmd_DrawElements *cmd,
+                        bool range)
+{
+   const GLenum mode = cmd->mode;
+   const GLsizei count = cmd->count;
+   const GLenum type = cmd->type;
+   GLuint start = cmd->start;
+   GLuint end = cmd->end;
+   const GLbitfield user_arrays = cmd->user_arrays;
+   const struct marshal_user_array *descs =
+      (const struct marshal_user_array *) (cmd + 1);
+   const GLvoid *indices = cmd->indices;
+   const GLubyte *ptrs[VERT_ATTRIB_MAX];
+   bool bound = false;
+
+   /* If an index buffer is bound after all, which only happens after
+    * erroneous calls, draw with the bindings as they are like Mesa would
+    * without the thread.
+    */
+   if (cmd->user_indices &&
+       !_mesa_is_bufferobj(ctx->Array.VAO->IndexBufferObj)) {
+      const unsigned num_arrays = util_bitcount(user_arrays);
+      const GLubyte *data = cmd->heap ? cmd->heap :
+                            (const GLubyte *) (descs + num_arrays);
+
+      indices = data;
+
+      if (user_arrays) {
+         bound = bind_user_arrays(ctx, user_arrays, descs, data, ptrs);
+
+         /* Only these vertices were copied, the draw mustn't upload more
+          * whatever range the application gave.
+          */
+         if (bound) {
+            start = cmd->min_index;
+            end = cmd->max_index;
+         }
+      }
+   }
+
+   if (range) {
+      CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                             (mode, start, end, count, type, indices));
+   } else {
+      CALL_DrawElements(ctx->CurrentServerDispatch,
+                        (mode, count, type, indices));
+   }
+
+   if (bound)
+      _mesa_exchange_client_array_pointers(ctx, user_arrays, ptrs);
+   free(cmd->heap);
+}
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_DrawElements *cmd)
+{
+   unmarshal_draw_elements(ctx, cmd, false);
+}
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_DrawRangeElements *cmd)
+{
+   unmarshal_draw_elements(ctx, cmd, true);
+}
+
+/**
+ * Queues a DrawElements or DrawRangeElements command, or returns false if
+ * the draw must be executed synchronously.
+ */
+static bool
+marshal_draw_elements(struct gl_context *ctx, uint16_t cmd_id, GLenum mode,
+                      GLuint start, GLuint end, GLsizei count, GLenum type,
+                      const GLvoid *indices)
+{
+   const struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+   const GLbitfield user_arrays = _mesa_glthread_get_user_arrays(ctx);
+   const bool user_indices = ctx->API != API_OPENGL_CORE &&
+                             arrays->element_array_buffer == 0;
+   struct marshal_cmd_DrawElements *cmd;
+
+   if (!user_arrays && !user_indices) {
+      cmd = _mesa_glthread_allocate_command(ctx, cmd_id, sizeof(*cmd));
+      cmd->mode = mode;
+      cmd->count = count;
+      cmd->type = type;
+      cmd->start = start;
+      cmd->end = end;
+      cmd->min_index = 0;
+      cmd->max_index = 0;
+      cmd->user_arrays = 0;
+      cmd->user_indices = false;
+      cmd->indices = indices;
+      cmd->heap = NULL;
+      _mesa_post_marshal_hook(ctx);
+      return true;
+   }
+
+   /* Leave errors and empty draws to Mesa.  The range of vertices is only
+    * known when the indices are in client memory too.
+    */
+   if (user_arrays_unknown(ctx, user_arrays) || count <= 0 || end < start ||
+       !user_indices || !indices ||
+       (type != GL_UNSIGNED_BYTE && type != GL_UNSIGNED_SHORT &&
+        type != GL_UNSIGNED_INT))
+      return false;
+
+   const unsigned index_size = vbo_sizeof_ib_type(type);
+   const size_t indices_size = (size_t) count * index_size;
+   unsigned min_index = 0, max_index = 0;
+
+   if (user_arrays) {
+      const bool restart = arrays->primitive_restart ||
+                           arrays->primitive_restart_fixed_index;
+      const unsigned restart_index =
+         arrays->primitive_restart_fixed_index ?
+         0xffffffffu >> 8 * (4 - index_size) : arrays->restart_index;
+
+      vbo_get_minmax_index_mapped(count, index_size, restart_index, restart,
+                                  indices, &min_index, &max_index);
+      if (min_index > max_index)
+         return false;
+   }
+
+   const unsigned num_arrays = util_bitcount(user_arrays);
+   const size_t descs_size =
+      sizeof(*cmd) + num_arrays * sizeof(struct marshal_user_array);
+   const size_t data_size =
+      user_arrays_size(arrays, user_arrays, min_index, max_index,
+                       indices_size);
+
+   if (data_size == SIZE_MAX)
+      return false;
+
+   const bool inline_data = descs_size + data_size <= MARSHAL_MAX_CMD_SIZE;
+   GLubyte *heap = NULL;
+
+   if (!inline_data) {
+      heap = malloc(data_size);
+      if (!heap)
+         return false;
+   }
+
+   cmd = _mesa_glthread_allocate_command(ctx, cmd_id,
+                                         inline_data ? descs_size + data_size
+                                                     : descs_size);
+   cmd->mode = mode;
+   cmd->count = count;
+   cmd->type = type;
+   cmd->start = start;
+   cmd->end = end;
+   cmd->min_index = min_index;
+   cmd->max_index = max_index;
+   cmd->user_arrays = user_arrays;
+   cmd->user_indices = true;
+   cmd->indices = indices;
+   cmd->heap = heap;
+
+   struct marshal_user_array *descs = (struct marshal_user_array *) (cmd + 1);
+   GLubyte *data = heap ? heap : (GLubyte *) (descs + num_arrays);
+
+   memcpy(data, indices, indices_size);
+   copy_user_arrays(arrays, user_arrays, min_index, max_index, descs, data,
+                    indices_size);
+   _mesa_post_marshal_hook(ctx);
+   return true;
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawElements");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawElements, mode, 0, 0,
+                             count, type, indices))
+      return;
+
+   _mesa_glthread_finish_before(ctx, _gloffset_DrawElements);
+   debug_print_sync_fallback("DrawElements");
+   CALL_DrawElements(ctx->CurrentServerDispatch,
+                     (mode, count, type, indices));
+}
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   debug_print_marshal("DrawRangeElements");
+
+   if (marshal_draw_elements(ctx, DISPATCH_CMD_DrawRangeElements, mode,
+                             start, end, count, type, indices))
+      return;
+
+   _mesa_glthread_finish_before(ctx, _gloffset_DrawRangeElements);
+   debug_print_sync_fallback("DrawRangeElements");
+   CALL_DrawRangeElements(ctx->CurrentServerDispatch,
+                          (mode, start, end, count, type, indices));
+}
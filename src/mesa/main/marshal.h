@@ -70,16 +70,29 @@ _mesa_glthread_allocate_command(struct gl_context *ctx,
 }
 
 /**
- * Instead of conditionally handling marshaling previously-bound user vertex
- * array data in draw calls (deprecated and removed in GL core), we just
- * disable threading at the point where the user sets a user vertex array.
+ * Returns the enabled vertex arrays that are sourced from client memory
+ * (deprecated and removed in GL core).
  */
-static inline bool
-_mesa_glthread_is_non_vbo_vertex_attrib_pointer(const struct gl_context *ctx)
+static inline GLbitfield
+_mesa_glthread_get_user_arrays(const struct gl_context *ctx)
 {
-   struct glthread_state *glthread = ctx->GLThread;
+   const struct glthread_client_arrays *arrays = &ctx->GLThread->arrays;
+
+   if (ctx->API == API_OPENGL_CORE)
+      return 0;
+
+   return arrays->unknown ? VERT_BIT_ALL : arrays->enabled & arrays->user;
+}
 
-   return ctx->API != API_OPENGL_CORE && !glthread->vertex_array_is_vbo;
+/**
+ * glDrawArrays(), glDrawElements() and glDrawRangeElements() copy client
+ * arrays on the main thread.  The other draw calls don't, so we just
+ * disable threading when they read client memory.
+ */
+static inline bool
+_mesa_glthread_has_non_vbo_vertices(const struct gl_context *ctx)
+{
+   return _mesa_glthread_get_user_arrays(ctx) != 0;
 }
 
 /**
@@ -91,7 +104,9 @@ _mesa_glthread_is_non_vbo_draw_elements(const struct gl_context *ctx)
 {
    struct glthread_state *glthread = ctx->GLThread;
 
-   return ctx->API != API_OPENGL_CORE && !glthread->element_array_is_vbo;
+   return ctx->API != API_OPENGL_CORE &&
+          (glthread->arrays.element_array_buffer == 0 ||
+           _mesa_glthread_has_non_vbo_vertices(ctx));
 }
 
 #define DEBUG_MARSHAL_PRINT_CALLS 0
@@ -187,6 +202,9 @@ struct marshal_cmd_ClearBuffer;
 #define marshal_cmd_ClearBufferiv   marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferuiv  marshal_cmd_ClearBuffer
 #define marshal_cmd_ClearBufferfi   marshal_cmd_ClearBuffer
+struct marshal_cmd_DrawArrays;
+struct marshal_cmd_DrawElements;
+#define marshal_cmd_DrawRangeElements marshal_cmd_DrawElements
 
 void
 _mesa_unmarshal_Enable(struct gl_context *ctx,
@@ -195,6 +213,88 @@ _mesa_unmarshal_Enable(struct gl_context *ctx,
 void GLAPIENTRY
 _mesa_marshal_Enable(GLenum cap);
 
+void
+_mesa_glthread_CallList(struct gl_context *ctx);
+
+void
+_mesa_glthread_End(struct gl_context *ctx);
+
+void
+_mesa_glthread_Enable(struct gl_context *ctx, GLenum cap);
+
+void
+_mesa_glthread_Disable(struct gl_context *ctx, GLenum cap);
+
+void
+_mesa_glthread_ActiveTexture(struct gl_context *ctx, GLenum texture);
+
+void
+_mesa_glthread_MatrixMode(struct gl_context *ctx, GLenum mode);
+
+void
+_mesa_glthread_Viewport(struct gl_context *ctx, GLint x, GLint y,
+                        GLsizei width, GLsizei height);
+
+void
+_mesa_glthread_AttribPointer(struct gl_context *ctx, gl_vert_attrib attrib,
+                             GLint size, GLenum type, GLsizei stride,
+                             const GLvoid *pointer);
+
+void
+_mesa_glthread_TexCoordPointer(struct gl_context *ctx, GLint size,
+                               GLenum type, GLsizei stride,
+                               const GLvoid *pointer);
+
+void
+_mesa_glthread_VertexAttribPointer(struct gl_context *ctx, GLuint index,
+                                   GLint size, GLenum type, GLsizei stride,
+                                   const GLvoid *pointer);
+
+void
+_mesa_glthread_InterleavedArrays(struct gl_context *ctx);
+
+void
+_mesa_glthread_ClientState(struct gl_context *ctx, GLenum array, bool enable);
+
+void
+_mesa_glthread_VertexAttribArray(struct gl_context *ctx, GLuint index,
+                                 bool enable);
+
+void
+_mesa_glthread_ClientActiveTexture(struct gl_context *ctx, GLenum texture);
+
+void
+_mesa_glthread_VertexAttribDivisor(struct gl_context *ctx, GLuint index,
+                                   GLuint divisor);
+
+void
+_mesa_glthread_untrack_generic_arrays(struct gl_context *ctx);
+
+void
+_mesa_glthread_PrimitiveRestartIndex(struct gl_context *ctx, GLuint index);
+
+void
+_mesa_glthread_PushClientAttrib(struct gl_context *ctx, GLbitfield mask);
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers);
+
+GLboolean GLAPIENTRY
+_mesa_marshal_IsEnabled(GLenum cap);
+
+void GLAPIENTRY
+_mesa_marshal_GetBooleanv(GLenum pname, GLboolean *params);
+
+void GLAPIENTRY
+_mesa_marshal_GetIntegerv(GLenum pname, GLint *params);
+
+GLenum GLAPIENTRY
+_mesa_marshal_GetError(void);
+
 void GLAPIENTRY
 _mesa_marshal_ShaderSource(GLuint shader, GLsizei count,
                            const GLchar * const *string, const GLint *length);
@@ -281,4 +381,28 @@ void GLAPIENTRY
 _mesa_marshal_ClearBufferfi(GLenum buffer, GLint drawbuffer,
                             const GLfloat depth, const GLint stencil);
 
+void
+_mesa_unmarshal_DrawArrays(struct gl_context *ctx,
+                           const struct marshal_cmd_DrawArrays *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawArrays(GLenum mode, GLint first, GLsizei count);
+
+void
+_mesa_unmarshal_DrawElements(struct gl_context *ctx,
+                             const struct marshal_cmd_DrawElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawElements(GLenum mode, GLsizei count, GLenum type,
+                           const GLvoid *indices);
+
+void
+_mesa_unmarshal_DrawRangeElements(struct gl_context *ctx,
+                                  const struct marshal_cmd_DrawRangeElements *cmd);
+
+void GLAPIENTRY
+_mesa_marshal_DrawRangeElements(GLenum mode, GLuint start, GLuint end,
+                                GLsizei count, GLenum type,
+                                const GLvoid *indices);
+
 #endif /* MARSHAL_H */
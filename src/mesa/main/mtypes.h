@@ -48,6 +48,7 @@
 #include "compiler/glsl/list.h"
 #include "util/bitscan.h"
 #include "util/simple_mtx.h"
+#include "util/u_queue.h"
 #include "util/u_dynarray.h"
 
 
@@ -639,6 +640,7 @@ struct gl_hint_attrib
    GLenum TextureCompression;   /**< GL_ARB_texture_compression */
    GLenum GenerateMipmap;       /**< GL_SGIS_generate_mipmap */
    GLenum FragmentShaderDerivative; /**< GL_ARB_fragment_shader */
+   GLuint MaxShaderCompilerThreads; /**< GL_ARB_parallel_shader_compile */
 };
 
 
@@ -2593,6 +2595,15 @@ struct gl_shader
 
    enum gl_compile_status CompileStatus;
 
+   /**
+    * Number of background links of programs this shader is attached to that
+    * haven't finished yet, queued by any context.  Changing the source or IR
+    * of the shader waits on LinkCond until there are none left.
+    */
+   int PendingLinks;
+   mtx_t LinkMutex;
+   cnd_t LinkCond;
+
 #ifdef DEBUG
    unsigned SourceChecksum;       /**< for debug/logging purposes */
 #endif
@@ -2914,6 +2925,12 @@ struct gl_shader_program
    GLint RefCount;  /**< Reference count */
    GLboolean DeletePending;
 
+   /**
+    * Unsignalled while glLinkProgram runs in the background for
+    * GL_ARB_parallel_shader_compile.  Looking the program up waits for it.
+    */
+   struct util_queue_fence LinkFence;
+
    /**
     * Is the application intending to glGetProgramBinary this program?
     */
@@ -3838,6 +3855,12 @@ struct gl_constants
     */
    bool GLSLTessLevelsAsInputs;
 
+   /**
+    * Whether Driver.LinkShader may run on a thread where the context isn't
+    * current, which lets glLinkProgram return before linking finishes.
+    */
+   bool BackgroundLinkShader;
+
    /**
     * Always use the GetTransformFeedbackVertexCount() driver hook, rather
     * than passing the transform feedback object to the drawing function.
@@ -4854,6 +4877,13 @@ struct gl_context
     */
    struct gl_pipeline_object *_Shader;
 
+   /**
+    * GL_ARB_parallel_shader_compile: threads running glLinkProgram in the
+    * background, created on first use, and how many links they have left.
+    */
+   struct util_queue LinkQueue;
+   int PendingLinks;
+
    struct gl_query_state Query;  /**< occlusion, timer queries */
 
    struct gl_transform_feedback_state TransformFeedback;
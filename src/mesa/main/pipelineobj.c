@@ -501,6 +501,12 @@ _mesa_bind_pipeline(struct gl_context *ctx,
                     struct gl_pipeline_object *pipe)
 {
    int i;
+
+   /* Links running in the background read ctx->_Shader, which this may free,
+    * and glUniform uses the pipeline's active program without looking it up.
+    */
+   _mesa_finish_link_queue(ctx);
+
    /* First bind the Pipeline to pipeline binding point */
    _mesa_reference_pipeline_object(ctx, &ctx->Pipeline.Current, pipe);
 
@@ -60,6 +60,7 @@
 #include "util/hash_table.h"
 #include "util/mesa-sha1.h"
 #include "util/crc32.h"
+#include "util/u_atomic.h"
 
 /**
  * Return mask of GLSL_x flags by examining the MESA_GLSL env var.
@@ -166,6 +167,57 @@ _mesa_free_shader_state(struct gl_context *ctx)
 }
 
 
+/**
+ * Wait for all the links this context is running in the background.
+ */
+void
+_mesa_finish_link_queue(struct gl_context *ctx)
+{
+   if (p_atomic_read(&ctx->PendingLinks))
+      util_queue_finish(&ctx->LinkQueue);
+}
+
+
+/**
+ * Finish the links running in the background and stop their threads.
+ */
+void
+_mesa_destroy_link_queue(struct gl_context *ctx)
+{
+   if (!util_queue_is_initialized(&ctx->LinkQueue))
+      return;
+
+   util_queue_finish(&ctx->LinkQueue);
+   util_queue_destroy(&ctx->LinkQueue);
+   memset(&ctx->LinkQueue, 0, sizeof(ctx->LinkQueue));
+}
+
+
+/**
+ * Set up ctx->LinkQueue with the number of threads asked for by
+ * glMaxShaderCompilerThreadsARB.  Returns false if programs should be linked
+ * right away instead.
+ */
+static bool
+init_link_queue(struct gl_context *ctx)
+{
+   const unsigned threads = MIN2(ctx->Hint.MaxShaderCompilerThreads,
+                                 MAX_SHADER_COMPILER_THREADS);
+
+   if (util_queue_is_initialized(&ctx->LinkQueue)) {
+      if (ctx->LinkQueue.num_threads == threads)
+         return true;
+      _mesa_destroy_link_queue(ctx);
+   }
+
+   if (threads == 0)
+      return false;
+
+   return util_queue_init(&ctx->LinkQueue, "gllink", 32, threads,
+                          UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+}
+
+
 /**
  * Copy string from <src> to <dst>, up to maxLength characters, returning
  * length of <dst> in <length>.
@@ -651,8 +703,21 @@ static void
 get_programiv(struct gl_context *ctx, GLuint program, GLenum pname,
               GLint *params)
 {
-   struct gl_shader_program *shProg
-      = _mesa_lookup_shader_program_err(ctx, program, "glGetProgramiv(program)");
+   struct gl_shader_program *shProg;
+
+   /* GL_ARB_parallel_shader_compile: this is how applications find out
+    * whether a link has finished without waiting for it.
+    */
+   if (pname == GL_COMPLETION_STATUS_ARB && _mesa_is_desktop_gl(ctx)) {
+      shProg = _mesa_lookup_shader_program_err_nowait(ctx, program,
+                                                      "glGetProgramiv(program)");
+      if (shProg)
+         *params = util_queue_fence_is_signalled(&shProg->LinkFence);
+      return;
+   }
+
+   shProg = _mesa_lookup_shader_program_err(ctx, program,
+                                            "glGetProgramiv(program)");
 
    /* Is transform feedback available in this context?
     */
@@ -960,6 +1025,15 @@ get_shaderiv(struct gl_context *ctx, GLuint name, GLenum pname, GLint *params)
    case GL_SHADER_SOURCE_LENGTH:
       *params = shader->Source ? strlen((char *) shader->Source) + 1 : 0;
       break;
+   case GL_COMPLETION_STATUS_ARB:
+      /* Shaders are compiled right away, only linking is done in the
+       * background.
+       */
+      if (_mesa_is_desktop_gl(ctx)) {
+         *params = GL_TRUE;
+         break;
+      }
+      /* fallthrough */
    default:
       _mesa_error(ctx, GL_INVALID_ENUM, "glGetShaderiv(pname)");
       return;
@@ -1078,6 +1152,8 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
    if (!sh)
       return;
 
+   _mesa_wait_for_shader_links(sh);
+
    if (!sh->Source) {
       /* If the user called glCompileShader without first calling
        * glShaderSource, we should fail to compile, but not raise a GL_ERROR.
@@ -1135,12 +1211,137 @@ _mesa_compile_shader(struct gl_context *ctx, struct gl_shader *sh)
 }
 
 
+/**
+ * Things to do once a program has been linked, on whichever thread did it.
+ */
+static void
+link_program_done(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   /* Capture .shader_test files. */
+   const char *capture_path = _mesa_get_shader_capture_path();
+   if (shProg->Name != 0 && shProg->Name != ~0 && capture_path != NULL) {
+      FILE *file;
+      char *filename = ralloc_asprintf(NULL, "%s/%u.shader_test",
+                                       capture_path, shProg->Name);
+      file = fopen(filename, "w");
+      if (file) {
+         fprintf(file, "[require]\nGLSL%s >= %u.%02u\n",
+                 shProg->IsES ? " ES" : "",
+                 shProg->data->Version / 100, shProg->data->Version % 100);
+         if (shProg->SeparateShader)
+            fprintf(file, "GL_ARB_separate_shader_objects\nSSO ENABLED\n");
+         fprintf(file, "\n");
+
+         for (unsigned i = 0; i < shProg->NumShaders; i++) {
+            fprintf(file, "[%s shader]\n%s\n",
+                    _mesa_shader_stage_to_string(shProg->Shaders[i]->Stage),
+                    shProg->Shaders[i]->Source);
+         }
+         fclose(file);
+      } else {
+         _mesa_warning(ctx, "Failed to open %s", filename);
+      }
+
+      ralloc_free(filename);
+   }
+
+   if (shProg->data->LinkStatus == linking_failure &&
+       (ctx->_Shader->Flags & GLSL_REPORT_ERRORS)) {
+      _mesa_debug(ctx, "Error linking program %u:\n%s\n",
+                  shProg->Name, shProg->data->InfoLog);
+   }
+
+   /* debug code */
+   if (0) {
+      GLuint i;
+
+      printf("Link %u shaders in program %u: %s\n",
+                   shProg->NumShaders, shProg->Name,
+                   shProg->data->LinkStatus ? "Success" : "Failed");
+
+      for (i = 0; i < shProg->NumShaders; i++) {
+         printf(" shader %u, stage %u\n",
+                      shProg->Shaders[i]->Name,
+                      shProg->Shaders[i]->Stage);
+      }
+   }
+}
+
+
+struct link_program_job {
+   struct gl_context *ctx;
+   struct gl_shader_program *shProg;
+};
+
+
+static void
+link_program_execute(void *data, int thread_index)
+{
+   struct link_program_job *job = (struct link_program_job *) data;
+   struct gl_context *ctx = job->ctx;
+   struct gl_shader_program *shProg = job->shProg;
+
+   _mesa_glsl_link_shader(ctx, shProg);
+   link_program_done(ctx, shProg);
+
+   /* Not in a cleanup callback: that runs after the fence is signalled,
+    * when the program may already have been deleted.
+    */
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      _mesa_shader_link_finished(shProg->Shaders[i]);
+   p_atomic_dec(&ctx->PendingLinks);
+   free(job);
+}
+
+
+/**
+ * Link \c shProg on ctx->LinkQueue, for GL_ARB_parallel_shader_compile.
+ *
+ * Deleting the programs of the previous link may need the driver's context,
+ * so that is done here.  Everything else happens on the queue, and looking
+ * the program up waits for it.  Returns false if the program must be linked
+ * right away instead.
+ */
+static bool
+queue_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
+{
+   if (!ctx->Const.BackgroundLinkShader || !init_link_queue(ctx))
+      return false;
+
+   struct link_program_job *job = malloc(sizeof(*job));
+   if (!job)
+      return false;
+
+   job->ctx = ctx;
+   job->shProg = shProg;
+
+   _mesa_clear_shader_program_data(ctx, shProg);
+
+   for (unsigned i = 0; i < shProg->NumShaders; i++)
+      _mesa_shader_link_started(shProg->Shaders[i]);
+   p_atomic_inc(&ctx->PendingLinks);
+
+   /* Links ahead of this one keep the queue busy, have the cache load the
+    * program meanwhile.
+    */
+   _mesa_glsl_prefetch_shader_program(ctx, shProg);
+
+   util_queue_add_job(&ctx->LinkQueue, job, &shProg->LinkFence,
+                      link_program_execute, NULL);
+   return true;
+}
+
+
 /**
  * Link a program's shaders.
+ *
+ * With \p background set, the program may be linked on another thread if
+ * nothing needs the result before the application looks the program up
+ * again.
  */
 static ALWAYS_INLINE void
 link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
-             bool no_error)
+             bool no_error, bool background)
 {
    if (!shProg)
       return;
@@ -1168,6 +1369,16 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
    }
 
    FLUSH_VERTICES(ctx, 0);
+
+   /* A program in use has to be installed again right away, and glUniform
+    * changes the active program without looking it up.
+    */
+   if (background && !programs_in_use &&
+       ctx->Shader.ActiveProgram != shProg &&
+       ctx->_Shader->ActiveProgram != shProg &&
+       queue_link_program(ctx, shProg))
+      return;
+
    _mesa_glsl_link_shader(ctx, shProg);
 
    /* From section 7.3 (Program Objects) of the OpenGL 4.5 spec:
@@ -1192,75 +1403,28 @@ link_program(struct gl_context *ctx, struct gl_shader_program *shProg,
       }
    }
 
-   /* Capture .shader_test files. */
-   const char *capture_path = _mesa_get_shader_capture_path();
-   if (shProg->Name != 0 && shProg->Name != ~0 && capture_path != NULL) {
-      FILE *file;
-      char *filename = ralloc_asprintf(NULL, "%s/%u.shader_test",
-                                       capture_path, shProg->Name);
-      file = fopen(filename, "w");
-      if (file) {
-         fprintf(file, "[require]\nGLSL%s >= %u.%02u\n",
-                 shProg->IsES ? " ES" : "",
-                 shProg->data->Version / 100, shProg->data->Version % 100);
-         if (shProg->SeparateShader)
-            fprintf(file, "GL_ARB_separate_shader_objects\nSSO ENABLED\n");
-         fprintf(file, "\n");
-
-         for (unsigned i = 0; i < shProg->NumShaders; i++) {
-            fprintf(file, "[%s shader]\n%s\n",
-                    _mesa_shader_stage_to_string(shProg->Shaders[i]->Stage),
-                    shProg->Shaders[i]->Source);
-         }
-         fclose(file);
-      } else {
-         _mesa_warning(ctx, "Failed to open %s", filename);
-      }
-
-      ralloc_free(filename);
-   }
-
-   if (shProg->data->LinkStatus == linking_failure &&
-       (ctx->_Shader->Flags & GLSL_REPORT_ERRORS)) {
-      _mesa_debug(ctx, "Error linking program %u:\n%s\n",
-                  shProg->Name, shProg->data->InfoLog);
-   }
-
-   /* debug code */
-   if (0) {
-      GLuint i;
-
-      printf("Link %u shaders in program %u: %s\n",
-                   shProg->NumShaders, shProg->Name,
-                   shProg->data->LinkStatus ? "Success" : "Failed");
-
-      for (i = 0; i < shProg->NumShaders; i++) {
-         printf(" shader %u, stage %u\n",
-                      shProg->Shaders[i]->Name,
-                      shProg->Shaders[i]->Stage);
-      }
-   }
+   link_program_done(ctx, shProg);
 }
 
 
 static void
 link_program_error(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program(ctx, shProg, false);
+   link_program(ctx, shProg, false, true);
 }
 
 
 static void
 link_program_no_error(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program(ctx, shProg, true);
+   link_program(ctx, shProg, true, true);
 }
 
 
 void
 _mesa_link_program(struct gl_context *ctx, struct gl_shader_program *shProg)
 {
-   link_program_error(ctx, shProg);
+   link_program(ctx, shProg, false, false);
 }
 
 
@@ -1943,6 +2107,7 @@ shader_source(struct gl_context *ctx, GLuint shaderObj, GLsizei count,
    }
 #endif /* ENABLE_SHADER_CACHE */
 
+   _mesa_wait_for_shader_links(sh);
    set_shader_source(sh, source);
 
    free(offsets);
@@ -93,6 +93,8 @@ _mesa_init_shader(struct gl_shader *shader)
    shader->info.Geom.VerticesOut = -1;
    shader->info.Geom.InputType = GL_TRIANGLES;
    shader->info.Geom.OutputType = GL_TRIANGLE_STRIP;
+   mtx_init(&shader->LinkMutex, mtx_plain);
+   cnd_init(&shader->LinkCond);
 }
 
 /**
@@ -121,6 +123,9 @@ _mesa_new_shader(GLuint name, gl_shader_stage stage)
 void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
+   _mesa_wait_for_shader_links(sh);
+   cnd_destroy(&sh->LinkCond);
+   mtx_destroy(&sh->LinkMutex);
    free((void *)sh->Source);
    free((void *)sh->FallbackSource);
    free(sh->Label);
@@ -128,6 +133,50 @@ _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 }
 
 
+/**
+ * Record that a program \c sh is attached to is being linked in the
+ * background.
+ */
+void
+_mesa_shader_link_started(struct gl_shader *sh)
+{
+   mtx_lock(&sh->LinkMutex);
+   sh->PendingLinks++;
+   mtx_unlock(&sh->LinkMutex);
+}
+
+
+/**
+ * Called by the thread that linked a program \c sh is attached to, once
+ * it's done reading the shader.
+ */
+void
+_mesa_shader_link_finished(struct gl_shader *sh)
+{
+   mtx_lock(&sh->LinkMutex);
+   if (--sh->PendingLinks == 0)
+      cnd_broadcast(&sh->LinkCond);
+   mtx_unlock(&sh->LinkMutex);
+}
+
+
+/**
+ * Wait for the background links that may be reading \c sh, whichever
+ * context queued them, before its source or IR changes.
+ */
+void
+_mesa_wait_for_shader_links(struct gl_shader *sh)
+{
+   if (!p_atomic_read(&sh->PendingLinks))
+      return;
+
+   mtx_lock(&sh->LinkMutex);
+   while (sh->PendingLinks)
+      cnd_wait(&sh->LinkCond, &sh->LinkMutex);
+   mtx_unlock(&sh->LinkMutex);
+}
+
+
 /**
  * Delete a shader object.
  */
@@ -293,6 +342,8 @@ init_shader_program(struct gl_shader_program *prog)
    prog->TransformFeedback.BufferMode = GL_INTERLEAVED_ATTRIBS;
 
    exec_list_make_empty(&prog->EmptyUniformLocations);
+
+   util_queue_fence_init(&prog->LinkFence);
 }
 
 /**
@@ -404,12 +455,16 @@ _mesa_delete_shader_program(struct gl_context *ctx,
                             struct gl_shader_program *shProg)
 {
    _mesa_free_shader_program_data(ctx, shProg);
+   util_queue_fence_destroy(&shProg->LinkFence);
    ralloc_free(shProg);
 }
 
 
 /**
  * Lookup a GLSL program object.
+ *
+ * If the program is being linked in the background, this waits for the link
+ * to finish, so callers may read and change everything linking produces.
  */
 struct gl_shader_program *
 _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
@@ -425,6 +480,8 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
       if (shProg && shProg->Type != GL_SHADER_PROGRAM_MESA) {
          return NULL;
       }
+      if (shProg)
+         util_queue_fence_wait(&shProg->LinkFence);
       return shProg;
    }
    return NULL;
@@ -437,6 +494,23 @@ _mesa_lookup_shader_program(struct gl_context *ctx, GLuint name)
 struct gl_shader_program *
 _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
                                 const char *caller)
+{
+   struct gl_shader_program *shProg =
+      _mesa_lookup_shader_program_err_nowait(ctx, name, caller);
+
+   if (shProg)
+      util_queue_fence_wait(&shProg->LinkFence);
+   return shProg;
+}
+
+
+/**
+ * As above, but don't wait for a link running in the background.  Only
+ * fields glLinkProgram doesn't touch may be used on the result.
+ */
+struct gl_shader_program *
+_mesa_lookup_shader_program_err_nowait(struct gl_context *ctx, GLuint name,
+                                       const char *caller)
 {
    if (!name) {
       _mesa_error(ctx, GL_INVALID_VALUE, "%s", caller);
@@ -48,6 +48,21 @@ _mesa_init_shader_state(struct gl_context * ctx);
 extern void
 _mesa_free_shader_state(struct gl_context *ctx);
 
+extern void
+_mesa_finish_link_queue(struct gl_context *ctx);
+
+extern void
+_mesa_destroy_link_queue(struct gl_context *ctx);
+
+extern void
+_mesa_shader_link_started(struct gl_shader *sh);
+
+extern void
+_mesa_shader_link_finished(struct gl_shader *sh);
+
+extern void
+_mesa_wait_for_shader_links(struct gl_shader *sh);
+
 
 extern void
 _mesa_reference_shader(struct gl_context *ctx, struct gl_shader **ptr,
@@ -97,6 +112,10 @@ extern struct gl_shader_program *
 _mesa_lookup_shader_program_err(struct gl_context *ctx, GLuint name,
                                 const char *caller);
 
+extern struct gl_shader_program *
+_mesa_lookup_shader_program_err_nowait(struct gl_context *ctx, GLuint name,
+                                       const char *caller);
+
 extern struct gl_shader_program *
 _mesa_new_shader_program(GLuint name);
 
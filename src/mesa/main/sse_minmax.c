@@ -29,66 +29,111 @@
 #include <smmintrin.h>
 #include <stdint.h>
 
-void
-_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
-                         unsigned *max_index, const unsigned count)
-{
-   unsigned max_ui = 0;
-   unsigned min_ui = ~0U;
-   unsigned i = 0;
-   unsigned aligned_count = count;
-
-   /* handle the first few values without SSE until the pointer is aligned */
-   while (((uintptr_t)ui_indices & 15) && aligned_count) {
-      if (*ui_indices > max_ui)
-         max_ui = *ui_indices;
-      if (*ui_indices < min_ui)
-         min_ui = *ui_indices;
-
-      aligned_count--;
-      ui_indices++;
-   }
-
-   /* TODO: The actual threshold for SSE begin useful may be higher than 8.
-    * Some careful microbenchmarks and measurement are required to
-    * find the actual tipping point.
-    */
-   if (aligned_count >= 8) {
-      unsigned max_arr[4] __attribute__ ((aligned (16)));
-      unsigned min_arr[4] __attribute__ ((aligned (16)));
-      unsigned vec_count;
-      __m128i max_ui4 = _mm_setzero_si128();
-      __m128i min_ui4 = _mm_set1_epi32(~0U);
-      __m128i ui_indices4;
-      __m128i *ui_indices_ptr;
-
-      vec_count = aligned_count & ~0x3;
-      ui_indices_ptr = (__m128i *)ui_indices;
-      for (i = 0; i < vec_count / 4; i++) {
-         ui_indices4 = _mm_load_si128(&ui_indices_ptr[i]);
-         max_ui4 = _mm_max_epu32(ui_indices4, max_ui4);
-         min_ui4 = _mm_min_epu32(ui_indices4, min_ui4);
-      }
+/* The same loop for the three index sizes.  Restart indices are replaced
+ * by the neutral value of each operation, all ones for min and zero for
+ * max, so that they don't need to be branched over.
+ */
+#define INDEX_MIN_MAX(name, type, min_op, max_op, cmpeq_op, set1_op)          \
+static void                                                                   \
+name(const type *indices, unsigned count, bool restart,                       \
+     unsigned restart_index, unsigned *min_index, unsigned *max_index)        \
+{                                                                             \
+   const unsigned vec_len = sizeof(__m128i) / sizeof(type);                   \
+   unsigned max_ui = 0;                                                       \
+   unsigned min_ui = ~0U;                                                     \
+   unsigned i = 0;                                                            \
+                                                                              \
+   /* A restart index wider than the indices never matches. */                \
+   if (restart_index > (type) ~0U)                                            \
+      restart = false;                                                        \
+                                                                              \
+   if (count >= 2 * vec_len) {                                                \
+      type max_arr[sizeof(__m128i) / sizeof(type)];                           \
+      type min_arr[sizeof(__m128i) / sizeof(type)];                           \
+      const __m128i *ptr = (const __m128i *)indices;                          \
+      const unsigned vec_count = count / vec_len;                             \
+      __m128i max4 = _mm_setzero_si128();                                     \
+      __m128i min4 = _mm_set1_epi32(~0);                                      \
+                                                                              \
+      if (restart) {                                                          \
+         const __m128i restart4 = set1_op(restart_index);                     \
+                                                                              \
+         for (i = 0; i < vec_count; i++) {                                    \
+            __m128i v = _mm_loadu_si128(&ptr[i]);                             \
+            __m128i skip = cmpeq_op(v, restart4);                             \
+            max4 = max_op(_mm_andnot_si128(skip, v), max4);                   \
+            min4 = min_op(_mm_or_si128(skip, v), min4);                       \
+         }                                                                    \
+      } else {                                                                \
+         for (i = 0; i < vec_count; i++) {                                    \
+            __m128i v = _mm_loadu_si128(&ptr[i]);                             \
+            max4 = max_op(v, max4);                                           \
+            min4 = min_op(v, min4);                                           \
+         }                                                                    \
+      }                                                                       \
+                                                                              \
+      _mm_storeu_si128((__m128i *)max_arr, max4);                             \
+      _mm_storeu_si128((__m128i *)min_arr, min4);                             \
+                                                                              \
+      for (i = 0; i < vec_len; i++) {                                         \
+         if (max_arr[i] > max_ui)                                             \
+            max_ui = max_arr[i];                                              \
+         if (min_arr[i] < min_ui)                                             \
+            min_ui = min_arr[i];                                              \
+      }                                                                       \
+      i = vec_count * vec_len;                                                \
+   }                                                                          \
+                                                                              \
+   for (; i < count; i++) {                                                   \
+      if (restart && indices[i] == restart_index)                             \
+         continue;                                                            \
+      if (indices[i] > max_ui)                                                \
+         max_ui = indices[i];                                                 \
+      if (indices[i] < min_ui)                                                \
+         min_ui = indices[i];                                                 \
+   }                                                                          \
+                                                                              \
+   /* Only restart indices were found, the vectors ended up with the          \
+    * neutral values.                                                         \
+    */                                                                        \
+   if (min_ui > max_ui) {                                                     \
+      min_ui = ~0U;                                                           \
+      max_ui = 0;                                                             \
+   }                                                                          \
+                                                                              \
+   *min_index = min_ui;                                                       \
+   *max_index = max_ui;                                                       \
+}
 
-      _mm_store_si128((__m128i *)max_arr, max_ui4);
-      _mm_store_si128((__m128i *)min_arr, min_ui4);
+#define set1_epi8(x)  _mm_set1_epi8((char)(x))
+#define set1_epi16(x) _mm_set1_epi16((short)(x))
+#define set1_epi32(x) _mm_set1_epi32((int)(x))
 
-      for (i = 0; i < 4; i++) {
-         if (max_arr[i] > max_ui)
-            max_ui = max_arr[i];
-         if (min_arr[i] < min_ui)
-            min_ui = min_arr[i];
-      }
-      i = vec_count;
-   }
+INDEX_MIN_MAX(ubyte_array_min_max, uint8_t, _mm_min_epu8, _mm_max_epu8,
+              _mm_cmpeq_epi8, set1_epi8)
+INDEX_MIN_MAX(ushort_array_min_max, uint16_t, _mm_min_epu16, _mm_max_epu16,
+              _mm_cmpeq_epi16, set1_epi16)
+INDEX_MIN_MAX(uint_array_min_max, uint32_t, _mm_min_epu32, _mm_max_epu32,
+              _mm_cmpeq_epi32, set1_epi32)
 
-   for (; i < aligned_count; i++) {
-      if (ui_indices[i] > max_ui)
-         max_ui = ui_indices[i];
-      if (ui_indices[i] < min_ui)
-         min_ui = ui_indices[i];
+void
+_mesa_index_array_min_max(const void *indices, unsigned index_size,
+                          unsigned count, bool restart,
+                          unsigned restart_index,
+                          unsigned *min_index, unsigned *max_index)
+{
+   switch (index_size) {
+   case 1:
+      ubyte_array_min_max(indices, count, restart, restart_index,
+                          min_index, max_index);
+      break;
+   case 2:
+      ushort_array_min_max(indices, count, restart, restart_index,
+                           min_index, max_index);
+      break;
+   default:
+      uint_array_min_max(indices, count, restart, restart_index,
+                         min_index, max_index);
+      break;
    }
-
-   *min_index = min_ui;
-   *max_index = max_ui;
 }
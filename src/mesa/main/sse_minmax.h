@@ -28,8 +28,17 @@
 #ifndef SSE_MINMAX_H
 #define SSE_MINMAX_H
 
+#include <stdbool.h>
+
+/**
+ * Min and max of \p count indices of \p index_size bytes, skipping
+ * \p restart_index if \p restart is set.  If all indices are skipped,
+ * the min is ~0 and the max is 0.
+ */
 void
-_mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
-                         unsigned *max_index, const unsigned count);
+_mesa_index_array_min_max(const void *indices, unsigned index_size,
+                          unsigned count, bool restart,
+                          unsigned restart_index,
+                          unsigned *min_index, unsigned *max_index);
 
 #endif /* SSE_MINMAX_H */
@@ -63,6 +63,7 @@
 #include "get.h"
 #include "dispatch.h"
 #include "mtypes.h"
+#include "shaderobj.h"
 #include "util/hash_table.h"
 #include "util/set.h"
 
@@ -290,6 +291,11 @@ fence_sync(struct gl_context *ctx, GLenum condition, GLbitfield flags)
       syncObj->Flags = flags;
       syncObj->StatusFlag = 0;
 
+      /* Contexts waiting for the fence may then use the programs this
+       * one linked in the background.
+       */
+      _mesa_finish_link_queue(ctx);
+
       ctx->Driver.FenceSync(ctx, syncObj, condition, flags);
 
       simple_mtx_lock(&ctx->Shared->Mutex);
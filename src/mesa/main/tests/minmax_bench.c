@@ -0,0 +1,166 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Time the SSE4.1 index min/max kernels against a scalar loop.
+ *
+ * Usage: minmax_bench [-n iterations] [count]
+ *
+ * Every index size is scanned with and without primitive restart, with
+ * indices starting at an unaligned address.  The time is the best of all
+ * iterations, and the kernels are checked against the scalar loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "main/sse_minmax.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+
+static unsigned iterations = 100;
+
+#define SCALAR_MIN_MAX(type)                                          \
+   do {                                                               \
+      const type *p = indices;                                        \
+      for (unsigned i = 0; i < count; i++) {                          \
+         if (restart && p[i] == restart_index)                        \
+            continue;                                                 \
+         if (p[i] < min_ui) min_ui = p[i];                            \
+         if (p[i] > max_ui) max_ui = p[i];                            \
+      }                                                               \
+   } while (0)
+
+/* The loops vbo_get_minmax_index_mapped() uses without SSE4.1. */
+static void
+scalar_min_max(const void *indices, unsigned index_size, unsigned count,
+               bool restart, unsigned restart_index,
+               unsigned *min_index, unsigned *max_index)
+{
+   unsigned min_ui = ~0U, max_ui = 0;
+
+   switch (index_size) {
+   case 1:
+      SCALAR_MIN_MAX(uint8_t);
+      break;
+   case 2:
+      SCALAR_MIN_MAX(uint16_t);
+      break;
+   default:
+      SCALAR_MIN_MAX(uint32_t);
+      break;
+   }
+
+   *min_index = min_ui;
+   *max_index = max_ui;
+}
+
+typedef void (*min_max_func)(const void *indices, unsigned index_size,
+                             unsigned count, bool restart,
+                             unsigned restart_index,
+                             unsigned *min_index, unsigned *max_index);
+
+static double
+bench(min_max_func func, const void *indices, unsigned index_size,
+      unsigned count, bool restart, unsigned restart_index,
+      unsigned *min_index, unsigned *max_index)
+{
+   int64_t best_ns = INT64_MAX;
+
+   for (unsigned i = 0; i < iterations; i++) {
+      int64_t start = os_time_get_nano();
+      func(indices, index_size, count, restart, restart_index,
+           min_index, max_index);
+      best_ns = MIN2(best_ns, os_time_get_nano() - start);
+   }
+
+   return (double) best_ns / count;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned count = 1 << 20;
+   int i = 1;
+   bool failed = false;
+
+   if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+      iterations = MAX2(atoi(argv[2]), 1);
+      i = 3;
+   }
+   if (i < argc)
+      count = MAX2(atoi(argv[i]), 1);
+
+   /* One extra element to start the indices at an unaligned address. */
+   uint8_t *buffer = malloc((count + 1) * 4);
+   if (!buffer)
+      return 1;
+
+   printf("%-6s %-8s %12s %12s\n", "size", "restart", "scalar ns/i",
+          "sse4.1 ns/i");
+
+   for (unsigned index_size = 1; index_size <= 4; index_size *= 2) {
+      const unsigned restart_index = 0xffffffffu >> (8 * (4 - index_size));
+      void *indices = buffer + index_size;
+
+      /* Something mesh-like: mostly increasing, with restarts. */
+      srand(index_size);
+      for (unsigned j = 0; j < count; j++) {
+         unsigned v = (j / 3 + rand() % 64) & restart_index;
+
+         if (rand() % 100 == 0)
+            v = restart_index;
+
+         if (index_size == 1)
+            ((uint8_t *)indices)[j] = v;
+         else if (index_size == 2)
+            ((uint16_t *)indices)[j] = v;
+         else
+            ((uint32_t *)indices)[j] = v;
+      }
+
+      for (unsigned restart = 0; restart <= 1; restart++) {
+         unsigned ref_min = 0, ref_max = 0, min_index = 0, max_index = 0;
+         double scalar_ns, sse_ns;
+
+         scalar_ns = bench(scalar_min_max, indices, index_size, count,
+                           restart, restart_index, &ref_min, &ref_max);
+         sse_ns = bench(_mesa_index_array_min_max, indices, index_size,
+                        count, restart, restart_index,
+                        &min_index, &max_index);
+
+         printf("%-6u %-8s %12.4f %12.4f\n", index_size,
+                restart ? "yes" : "no", scalar_ns, sse_ns);
+
+         if (min_index != ref_min || max_index != ref_max) {
+            fprintf(stderr, "mismatch: min %u max %u, expected %u %u\n",
+                    min_index, max_index, ref_min, ref_max);
+            failed = true;
+         }
+      }
+   }
+
+   free(buffer);
+   return failed ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Time decompressing S3TC/ETC/BPTC textures texel by texel against whole
+ * block decoding.
+ *
+ * Usage: texcompress_bench [-n iterations] [size]
+ *
+ * Every format decodes a size x size image of random blocks three ways:
+ * with the per-texel fetch function, with the block decoder, and texel by
+ * texel through a block cache the way swrast samples.  The time is the
+ * best of all iterations, and the results are checked against the
+ * per-texel fetch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "main/formats.h"
+#include "main/texcompress.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+
+static unsigned iterations = 10;
+
+static const mesa_format formats[] = {
+   MESA_FORMAT_RGB_DXT1,
+   MESA_FORMAT_RGBA_DXT1,
+   MESA_FORMAT_RGBA_DXT3,
+   MESA_FORMAT_RGBA_DXT5,
+   MESA_FORMAT_SRGBA_DXT5,
+   MESA_FORMAT_ETC1_RGB8,
+   MESA_FORMAT_ETC2_RGB8,
+   MESA_FORMAT_ETC2_RGBA8_EAC,
+   MESA_FORMAT_ETC2_RG11_EAC,
+   MESA_FORMAT_ETC2_SIGNED_RG11_EAC,
+   MESA_FORMAT_ETC2_RGB8_PUNCHTHROUGH_ALPHA1,
+   MESA_FORMAT_BPTC_RGBA_UNORM,
+   MESA_FORMAT_BPTC_SRGB_ALPHA_UNORM,
+   MESA_FORMAT_BPTC_RGB_SIGNED_FLOAT,
+   MESA_FORMAT_BPTC_RGB_UNSIGNED_FLOAT,
+};
+
+enum method {
+   METHOD_TEXEL,
+   METHOD_BLOCK,
+   METHOD_CACHE,
+};
+
+static void
+decode(enum method method, mesa_format format, unsigned size,
+       const GLubyte *src, GLfloat *dst)
+{
+   const GLuint bytes = _mesa_get_format_bytes(format);
+   const GLint row_stride = size / 4 * bytes;
+   compressed_fetch_func fetch;
+   compressed_fetch_block_func fetch_block;
+   static struct mesa_block_cache cache;
+   unsigned x, y;
+
+   switch (method) {
+   case METHOD_TEXEL:
+      fetch = _mesa_get_compressed_fetch_func(format);
+      for (y = 0; y < size; y++) {
+         for (x = 0; x < size; x++)
+            fetch(src, size, x, y, dst + (y * size + x) * 4);
+      }
+      break;
+   case METHOD_BLOCK:
+      _mesa_decompress_image(format, size, size, src, row_stride, dst);
+      break;
+   case METHOD_CACHE:
+      fetch_block = _mesa_get_compressed_fetch_block_func(format);
+      _mesa_block_cache_invalidate(&cache);
+      for (y = 0; y < size; y++) {
+         for (x = 0; x < size; x++) {
+            const GLubyte *block = src + y / 4 * row_stride + x / 4 * bytes;
+            const GLfloat (*texels)[4] =
+               _mesa_block_cache_fetch(&cache, fetch_block, block, bytes);
+
+            memcpy(dst + (y * size + x) * 4, texels[y % 4 * 4 + x % 4],
+                   sizeof(texels[0]));
+         }
+      }
+      break;
+   }
+}
+
+static double
+bench(enum method method, mesa_format format, unsigned size,
+      const GLubyte *src, GLfloat *dst)
+{
+   int64_t best_ns = INT64_MAX;
+
+   for (unsigned i = 0; i < iterations; i++) {
+      int64_t start = os_time_get_nano();
+      decode(method, format, size, src, dst);
+      best_ns = MIN2(best_ns, os_time_get_nano() - start);
+   }
+
+   return (double) best_ns / (size * size);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned size = 512;
+   int i = 1;
+   bool failed = false;
+
+   if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+      iterations = MAX2(atoi(argv[2]), 1);
+      i = 3;
+   }
+   if (i < argc)
+      size = MAX2(atoi(argv[i]), 4);
+   size = (size + 3) & ~3u;
+
+   const size_t texels = (size_t) size * size;
+   GLubyte *src = malloc(texels);   /* at most one byte per texel */
+   GLfloat *ref = malloc(texels * 4 * sizeof(GLfloat));
+   GLfloat *dst = malloc(texels * 4 * sizeof(GLfloat));
+   if (!src || !ref || !dst)
+      return 1;
+
+   srand(0);
+   for (size_t j = 0; j < texels; j++)
+      src[j] = rand();
+
+   printf("%-42s %11s %11s %11s\n", "format", "texel ns/t", "block ns/t",
+          "cache ns/t");
+
+   for (unsigned f = 0; f < ARRAY_SIZE(formats); f++) {
+      const mesa_format format = formats[f];
+      double texel_ns, block_ns, cache_ns;
+
+      texel_ns = bench(METHOD_TEXEL, format, size, src, ref);
+      block_ns = bench(METHOD_BLOCK, format, size, src, dst);
+      if (memcmp(ref, dst, texels * 4 * sizeof(GLfloat))) {
+         fprintf(stderr, "%s: block decoding mismatch\n",
+                 _mesa_get_format_name(format));
+         failed = true;
+      }
+      cache_ns = bench(METHOD_CACHE, format, size, src, dst);
+      if (memcmp(ref, dst, texels * 4 * sizeof(GLfloat))) {
+         fprintf(stderr, "%s: cached decoding mismatch\n",
+                 _mesa_get_format_name(format));
+         failed = true;
+      }
+
+      printf("%-42s %11.3f %11.3f %11.3f\n", _mesa_get_format_name(format),
+             texel_ns, block_ns, cache_ns);
+   }
+
+   free(src);
+   free(ref);
+   free(dst);
+   return failed ? 1 : 0;
+}
@@ -902,6 +902,7 @@ _mesa_get_compressed_fetch_func(mesa_format format)
    case MESA_FORMAT_LAYOUT_LATC:
       return _mesa_get_compressed_rgtc_func(format);
    case MESA_FORMAT_LAYOUT_ETC1:
+   case MESA_FORMAT_LAYOUT_ETC2:
       return _mesa_get_etc_fetch_func(format);
    case MESA_FORMAT_LAYOUT_BPTC:
       return _mesa_get_bptc_fetch_func(format);
@@ -911,6 +912,58 @@ _mesa_get_compressed_fetch_func(mesa_format format)
 }
 
 
+/**
+ * Return a function decoding a whole block for the given format, or NULL
+ * if the format has no block decoder.  Only formats with 4x4 blocks have
+ * one.
+ */
+compressed_fetch_block_func
+_mesa_get_compressed_fetch_block_func(mesa_format format)
+{
+   switch (_mesa_get_format_layout(format)) {
+   case MESA_FORMAT_LAYOUT_S3TC:
+      return _mesa_get_dxt_fetch_block_func(format);
+   case MESA_FORMAT_LAYOUT_ETC1:
+   case MESA_FORMAT_LAYOUT_ETC2:
+      return _mesa_get_etc_fetch_block_func(format);
+   case MESA_FORMAT_LAYOUT_BPTC:
+      return _mesa_get_bptc_fetch_block_func(format);
+   default:
+      return NULL;
+   }
+}
+
+
+/**
+ * Decompress an image one whole block at a time.
+ */
+static void
+decompress_image_blocks(compressed_fetch_block_func fetch_block,
+                        GLuint bytes, GLuint width, GLuint height,
+                        const GLubyte *src, GLint srcRowStride,
+                        GLfloat *dest)
+{
+   GLfloat texels[16][4];
+   GLuint x, y, j;
+
+   for (y = 0; y < height; y += 4) {
+      const GLubyte *block = src + (y / 4) * srcRowStride;
+      const GLuint rows = MIN2(height - y, 4);
+
+      for (x = 0; x < width; x += 4) {
+         const GLuint cols = MIN2(width - x, 4);
+
+         fetch_block(block, texels);
+         block += bytes;
+
+         for (j = 0; j < rows; j++)
+            memcpy(dest + ((y + j) * width + x) * 4, texels[j * 4],
+                   cols * sizeof(texels[0]));
+      }
+   }
+}
+
+
 /**
  * Decompress a compressed texture image, returning a GL_RGBA/GL_FLOAT image.
  * \param srcRowStride  stride in bytes between rows of blocks in the
@@ -921,6 +974,7 @@ _mesa_decompress_image(mesa_format format, GLuint width, GLuint height,
                        const GLubyte *src, GLint srcRowStride,
                        GLfloat *dest)
 {
+   compressed_fetch_block_func fetch_block;
    compressed_fetch_func fetch;
    GLuint i, j;
    GLuint bytes, bw, bh;
@@ -929,6 +983,14 @@ _mesa_decompress_image(mesa_format format, GLuint width, GLuint height,
    bytes = _mesa_get_format_bytes(format);
    _mesa_get_format_block_size(format, &bw, &bh);
 
+   fetch_block = _mesa_get_compressed_fetch_block_func(format);
+   if (fetch_block) {
+      assert(bw == 4 && bh == 4);
+      decompress_image_blocks(fetch_block, bytes, width, height,
+                              src, srcRowStride, dest);
+      return;
+   }
+
    fetch = _mesa_get_compressed_fetch_func(format);
    if (!fetch) {
       _mesa_problem(NULL, "Unexpected format in _mesa_decompress_image()");
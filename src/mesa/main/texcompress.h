@@ -25,6 +25,7 @@
 #ifndef TEXCOMPRESS_H
 #define TEXCOMPRESS_H
 
+#include <string.h>
 #include "formats.h"
 #include "glheader.h"
 
@@ -58,6 +59,64 @@ extern compressed_fetch_func
 _mesa_get_compressed_fetch_func(mesa_format format);
 
 
+/**
+ * A function to decode a whole 4x4 block of a compressed texture.
+ * The 16 texels are written as RGBA floats in row-major order.
+ */
+typedef void (*compressed_fetch_block_func)(const GLubyte *block,
+                                            GLfloat texels[16][4]);
+
+extern compressed_fetch_block_func
+_mesa_get_compressed_fetch_block_func(mesa_format format);
+
+
+#define MESA_BLOCK_CACHE_BITS 7
+#define MESA_BLOCK_CACHE_SIZE (1 << MESA_BLOCK_CACHE_BITS)
+
+/**
+ * Small direct-mapped cache of decoded 4x4 blocks, keyed by block address.
+ * Whoever owns one has to invalidate it whenever the texture memory it
+ * may have cached from can change (e.g. when the textures get mapped).
+ * It must not be shared between threads.
+ */
+struct mesa_block_cache
+{
+   const GLubyte *blocks[MESA_BLOCK_CACHE_SIZE];
+   GLfloat texels[MESA_BLOCK_CACHE_SIZE][16][4];
+};
+
+static inline void
+_mesa_block_cache_invalidate(struct mesa_block_cache *cache)
+{
+   memset(cache->blocks, 0, sizeof(cache->blocks));
+}
+
+/**
+ * Return the decoded texels of the block at the given address, decoding
+ * it first if it's not in the cache.
+ * \param block_bytes  size of a compressed block in bytes
+ */
+static inline const GLfloat (*
+_mesa_block_cache_fetch(struct mesa_block_cache *cache,
+                        compressed_fetch_block_func fetch_block,
+                        const GLubyte *block, GLuint block_bytes))[4]
+{
+   /* Fold in the higher bits so that vertically adjacent blocks of
+    * power of two sized textures don't land in the same slot.
+    */
+   const uintptr_t n = (uintptr_t) block / block_bytes;
+   const unsigned slot =
+      (n ^ (n >> MESA_BLOCK_CACHE_BITS)) & (MESA_BLOCK_CACHE_SIZE - 1);
+
+   if (cache->blocks[slot] != block) {
+      fetch_block(block, cache->texels[slot]);
+      cache->blocks[slot] = block;
+   }
+
+   return cache->texels[slot];
+}
+
+
 extern void
 _mesa_decompress_image(mesa_format format, GLuint width, GLuint height,
                        const GLubyte *src, GLint srcRowStride,
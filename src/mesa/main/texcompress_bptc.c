@@ -698,6 +698,162 @@ fetch_bptc_srgb_alpha_unorm(const GLubyte *map,
    texel[ACOMP] = UBYTE_TO_FLOAT(texel_bytes[3]);
 }
 
+/**
+ * Decode all 16 texels of a block, decoding the mode, partition and
+ * endpoints only once.
+ */
+static void
+decode_rgba_unorm_block(const uint8_t *block,
+                        uint8_t result[BLOCK_SIZE * BLOCK_SIZE][4])
+{
+   int mode_num = ffs(block[0]);
+   const struct bptc_unorm_mode *mode;
+   int bit_offset, secondary_bit_offset;
+   int partition_num;
+   int subset_num;
+   int rotation;
+   int index_selection;
+   int index_bits;
+   int indices[2];
+   int color_index, color_index_bits;
+   int alpha_index, alpha_index_bits;
+   uint8_t endpoints[3 * 2][4];
+   uint32_t subsets;
+   int component;
+   int texel;
+
+   if (mode_num == 0) {
+      /* According to the spec this mode is reserved and shouldn't be used. */
+      for (texel = 0; texel < BLOCK_SIZE * BLOCK_SIZE; texel++) {
+         memset(result[texel], 0, 3);
+         result[texel][3] = 0xff;
+      }
+      return;
+   }
+
+   mode = bptc_unorm_modes + mode_num - 1;
+   bit_offset = mode_num;
+
+   partition_num = extract_bits(block, bit_offset, mode->n_partition_bits);
+   bit_offset += mode->n_partition_bits;
+
+   switch (mode->n_subsets) {
+   case 1:
+      subsets = 0;
+      break;
+   case 2:
+      subsets = partition_table1[partition_num];
+      break;
+   case 3:
+      subsets = partition_table2[partition_num];
+      break;
+   default:
+      assert(false);
+      return;
+   }
+
+   if (mode->has_rotation_bits) {
+      rotation = extract_bits(block, bit_offset, 2);
+      bit_offset += 2;
+   } else {
+      rotation = 0;
+   }
+
+   if (mode->has_index_selection_bit) {
+      index_selection = extract_bits(block, bit_offset, 1);
+      bit_offset++;
+   } else {
+      index_selection = 0;
+   }
+
+   bit_offset = extract_unorm_endpoints(mode, block, bit_offset, endpoints);
+
+   /* The secondary indices follow all of the primary ones */
+   secondary_bit_offset = (bit_offset +
+                           BLOCK_SIZE * BLOCK_SIZE * mode->n_index_bits -
+                           mode->n_subsets);
+
+   for (texel = 0; texel < BLOCK_SIZE * BLOCK_SIZE; texel++) {
+      const bool anchor = is_anchor(mode->n_subsets, partition_num, texel);
+
+      subset_num = (subsets >> (texel * 2)) & 3;
+
+      index_bits = mode->n_index_bits;
+      if (anchor)
+         index_bits--;
+      indices[0] = extract_bits(block, bit_offset, index_bits);
+      bit_offset += index_bits;
+
+      if (mode->n_secondary_index_bits) {
+         index_bits = mode->n_secondary_index_bits;
+         if (anchor)
+            index_bits--;
+         indices[1] = extract_bits(block, secondary_bit_offset, index_bits);
+         secondary_bit_offset += index_bits;
+      }
+
+      color_index = indices[index_selection];
+      color_index_bits = (index_selection ?
+                          mode->n_secondary_index_bits :
+                          mode->n_index_bits);
+
+      /* Alpha uses the opposite index from the color components */
+      if (mode->n_secondary_index_bits && !index_selection) {
+         alpha_index = indices[1];
+         alpha_index_bits = mode->n_secondary_index_bits;
+      } else {
+         alpha_index = indices[0];
+         alpha_index_bits = mode->n_index_bits;
+      }
+
+      for (component = 0; component < 3; component++)
+         result[texel][component] =
+            interpolate(endpoints[subset_num * 2][component],
+                        endpoints[subset_num * 2 + 1][component],
+                        color_index,
+                        color_index_bits);
+
+      result[texel][3] = interpolate(endpoints[subset_num * 2][3],
+                                     endpoints[subset_num * 2 + 1][3],
+                                     alpha_index,
+                                     alpha_index_bits);
+
+      apply_rotation(rotation, result[texel]);
+   }
+}
+
+static void
+fetch_block_bptc_rgba_unorm(const GLubyte *block, GLfloat texels[16][4])
+{
+   uint8_t result[BLOCK_SIZE * BLOCK_SIZE][4];
+   int i;
+
+   decode_rgba_unorm_block(block, result);
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      texels[i][RCOMP] = UBYTE_TO_FLOAT(result[i][0]);
+      texels[i][GCOMP] = UBYTE_TO_FLOAT(result[i][1]);
+      texels[i][BCOMP] = UBYTE_TO_FLOAT(result[i][2]);
+      texels[i][ACOMP] = UBYTE_TO_FLOAT(result[i][3]);
+   }
+}
+
+static void
+fetch_block_bptc_srgb_alpha_unorm(const GLubyte *block, GLfloat texels[16][4])
+{
+   uint8_t result[BLOCK_SIZE * BLOCK_SIZE][4];
+   int i;
+
+   decode_rgba_unorm_block(block, result);
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      texels[i][RCOMP] = util_format_srgb_8unorm_to_linear_float(result[i][0]);
+      texels[i][GCOMP] = util_format_srgb_8unorm_to_linear_float(result[i][1]);
+      texels[i][BCOMP] = util_format_srgb_8unorm_to_linear_float(result[i][2]);
+      texels[i][ACOMP] = UBYTE_TO_FLOAT(result[i][3]);
+   }
+}
+
 static int32_t
 sign_extend(int32_t value,
             int n_bits)
@@ -949,6 +1105,102 @@ fetch_bptc_rgb_unsigned_float(const GLubyte *map,
    fetch_bptc_rgb_float(map, rowStride, i, j, texel, false);
 }
 
+/**
+ * Decode all 16 texels of a block, decoding the mode, partition and
+ * endpoints only once.
+ */
+static void
+fetch_block_bptc_rgb_float(const uint8_t *block,
+                           GLfloat texels[16][4],
+                           bool is_signed)
+{
+   int mode_num;
+   const struct bptc_float_mode *mode;
+   int bit_offset;
+   int partition_num;
+   int subset_num;
+   int index_bits;
+   int index;
+   int32_t endpoints[2 * 2][3];
+   uint32_t subsets;
+   int n_subsets;
+   int component;
+   int32_t value;
+   int texel;
+
+   if (block[0] & 0x2) {
+      mode_num = (((block[0] >> 1) & 0xe) | (block[0] & 1)) + 2;
+      bit_offset = 5;
+   } else {
+      mode_num = block[0] & 3;
+      bit_offset = 2;
+   }
+
+   mode = bptc_float_modes + mode_num;
+
+   if (mode->reserved) {
+      for (texel = 0; texel < BLOCK_SIZE * BLOCK_SIZE; texel++) {
+         memset(texels[texel], 0, sizeof texels[texel][0] * 3);
+         texels[texel][3] = 1.0f;
+      }
+      return;
+   }
+
+   bit_offset = extract_float_endpoints(mode, block, bit_offset,
+                                        endpoints, is_signed);
+
+   if (mode->n_partition_bits) {
+      partition_num = extract_bits(block, bit_offset, mode->n_partition_bits);
+      bit_offset += mode->n_partition_bits;
+
+      subsets = partition_table1[partition_num];
+      n_subsets = 2;
+   } else {
+      partition_num = 0;
+      subsets = 0;
+      n_subsets = 1;
+   }
+
+   for (texel = 0; texel < BLOCK_SIZE * BLOCK_SIZE; texel++) {
+      subset_num = (subsets >> (texel * 2)) & 3;
+
+      index_bits = mode->n_index_bits;
+      if (is_anchor(n_subsets, partition_num, texel))
+         index_bits--;
+      index = extract_bits(block, bit_offset, index_bits);
+      bit_offset += index_bits;
+
+      for (component = 0; component < 3; component++) {
+         value = interpolate(endpoints[subset_num * 2][component],
+                             endpoints[subset_num * 2 + 1][component],
+                             index,
+                             mode->n_index_bits);
+
+         if (is_signed)
+            value = finish_signed_unquantize(value);
+         else
+            value = finish_unsigned_unquantize(value);
+
+         texels[texel][component] = _mesa_half_to_float(value);
+      }
+
+      texels[texel][3] = 1.0f;
+   }
+}
+
+static void
+fetch_block_bptc_rgb_signed_float(const GLubyte *block, GLfloat texels[16][4])
+{
+   fetch_block_bptc_rgb_float(block, texels, true);
+}
+
+static void
+fetch_block_bptc_rgb_unsigned_float(const GLubyte *block,
+                                    GLfloat texels[16][4])
+{
+   fetch_block_bptc_rgb_float(block, texels, false);
+}
+
 compressed_fetch_func
 _mesa_get_bptc_fetch_func(mesa_format format)
 {
@@ -966,6 +1218,23 @@ _mesa_get_bptc_fetch_func(mesa_format format)
    }
 }
 
+compressed_fetch_block_func
+_mesa_get_bptc_fetch_block_func(mesa_format format)
+{
+   switch (format) {
+   case MESA_FORMAT_BPTC_RGBA_UNORM:
+      return fetch_block_bptc_rgba_unorm;
+   case MESA_FORMAT_BPTC_SRGB_ALPHA_UNORM:
+      return fetch_block_bptc_srgb_alpha_unorm;
+   case MESA_FORMAT_BPTC_RGB_SIGNED_FLOAT:
+      return fetch_block_bptc_rgb_signed_float;
+   case MESA_FORMAT_BPTC_RGB_UNSIGNED_FLOAT:
+      return fetch_block_bptc_rgb_unsigned_float;
+   default:
+      return NULL;
+   }
+}
+
 static void
 write_bits(struct bit_writer *writer, int n_bits, int value)
 {
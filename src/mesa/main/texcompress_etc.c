@@ -1408,7 +1408,7 @@ fetch_etc2_signed_r11_eac(const GLubyte *map,
    etc2_r11_parse_block(&block, src);
    etc2_signed_r11_fetch_texel(&block, i % 4, j % 4, (uint8_t *)&dst);
 
-   texel[RCOMP] = SHORT_TO_FLOAT(dst);
+   texel[RCOMP] = SHORT_TO_FLOAT((GLshort) dst);
    texel[GCOMP] = 0.0f;
    texel[BCOMP] = 0.0f;
    texel[ACOMP] = 1.0f;
@@ -1432,8 +1432,8 @@ fetch_etc2_signed_rg11_eac(const GLubyte *map,
    etc2_r11_parse_block(&block, src + 8);
    etc2_signed_r11_fetch_texel(&block, i % 4, j % 4, (uint8_t *)(dst + 1));
 
-   texel[RCOMP] = SHORT_TO_FLOAT(dst[0]);
-   texel[GCOMP] = SHORT_TO_FLOAT(dst[1]);
+   texel[RCOMP] = SHORT_TO_FLOAT((GLshort) dst[0]);
+   texel[GCOMP] = SHORT_TO_FLOAT((GLshort) dst[1]);
    texel[BCOMP] = 0.0f;
    texel[ACOMP] = 1.0f;
 }
@@ -1511,3 +1511,230 @@ _mesa_get_etc_fetch_func(mesa_format format)
       return NULL;
    }
 }
+
+
+/*
+ * Whole block decoding: each block is only parsed once for its 16 texels.
+ */
+
+static void
+etc_block_to_float(const uint8_t tex[16][4], GLfloat texels[16][4],
+                   bool srgb)
+{
+   unsigned i;
+
+   for (i = 0; i < 16; i++) {
+      if (srgb) {
+         texels[i][RCOMP] = util_format_srgb_8unorm_to_linear_float(tex[i][0]);
+         texels[i][GCOMP] = util_format_srgb_8unorm_to_linear_float(tex[i][1]);
+         texels[i][BCOMP] = util_format_srgb_8unorm_to_linear_float(tex[i][2]);
+      } else {
+         texels[i][RCOMP] = UBYTE_TO_FLOAT(tex[i][0]);
+         texels[i][GCOMP] = UBYTE_TO_FLOAT(tex[i][1]);
+         texels[i][BCOMP] = UBYTE_TO_FLOAT(tex[i][2]);
+      }
+      texels[i][ACOMP] = UBYTE_TO_FLOAT(tex[i][3]);
+   }
+}
+
+static void
+fetch_block_etc1_rgb8(const GLubyte *src, GLfloat texels[16][4])
+{
+   struct etc1_block block;
+   uint8_t tex[16][4];
+   int x, y;
+
+   etc1_parse_block(&block, src);
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++) {
+         etc1_fetch_texel(&block, x, y, tex[y * 4 + x]);
+         tex[y * 4 + x][3] = 0xff;
+      }
+   }
+
+   etc_block_to_float(tex, texels, false);
+}
+
+static void
+etc2_rgb8_decode_block(const uint8_t *src, uint8_t tex[16][4],
+                       bool punchthrough_alpha)
+{
+   struct etc2_block block;
+   int x, y;
+
+   etc2_rgb8_parse_block(&block, src, punchthrough_alpha);
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++) {
+         /* only the punchthrough variant writes alpha */
+         tex[y * 4 + x][3] = 0xff;
+         etc2_rgb8_fetch_texel(&block, x, y, tex[y * 4 + x],
+                               punchthrough_alpha);
+      }
+   }
+}
+
+static void
+etc2_rgba8_decode_block(const uint8_t *src, uint8_t tex[16][4])
+{
+   struct etc2_block block;
+   int x, y;
+
+   etc2_rgba8_parse_block(&block, src);
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++)
+         etc2_rgba8_fetch_texel(&block, x, y, tex[y * 4 + x]);
+   }
+}
+
+static void
+fetch_block_etc2_rgb8(const GLubyte *src, GLfloat texels[16][4])
+{
+   uint8_t tex[16][4];
+
+   etc2_rgb8_decode_block(src, tex, false /* punchthrough_alpha */);
+   etc_block_to_float(tex, texels, false);
+}
+
+static void
+fetch_block_etc2_srgb8(const GLubyte *src, GLfloat texels[16][4])
+{
+   uint8_t tex[16][4];
+
+   etc2_rgb8_decode_block(src, tex, false /* punchthrough_alpha */);
+   etc_block_to_float(tex, texels, true);
+}
+
+static void
+fetch_block_etc2_rgba8_eac(const GLubyte *src, GLfloat texels[16][4])
+{
+   uint8_t tex[16][4];
+
+   etc2_rgba8_decode_block(src, tex);
+   etc_block_to_float(tex, texels, false);
+}
+
+static void
+fetch_block_etc2_srgb8_alpha8_eac(const GLubyte *src, GLfloat texels[16][4])
+{
+   uint8_t tex[16][4];
+
+   etc2_rgba8_decode_block(src, tex);
+   etc_block_to_float(tex, texels, true);
+}
+
+static void
+fetch_block_etc2_rgb8_punchthrough_alpha1(const GLubyte *src,
+                                          GLfloat texels[16][4])
+{
+   uint8_t tex[16][4];
+
+   etc2_rgb8_decode_block(src, tex, true /* punchthrough_alpha */);
+   etc_block_to_float(tex, texels, false);
+}
+
+static void
+fetch_block_etc2_srgb8_punchthrough_alpha1(const GLubyte *src,
+                                           GLfloat texels[16][4])
+{
+   uint8_t tex[16][4];
+
+   etc2_rgb8_decode_block(src, tex, true /* punchthrough_alpha */);
+   etc_block_to_float(tex, texels, true);
+}
+
+/**
+ * Decode one R11 EAC block into channel \p comp of the texels.
+ */
+static void
+etc2_r11_decode_block(const uint8_t *src, GLfloat texels[16][4],
+                      unsigned comp, bool is_signed)
+{
+   struct etc2_block block;
+   GLushort dst;
+   int x, y;
+
+   etc2_r11_parse_block(&block, src);
+   for (y = 0; y < 4; y++) {
+      for (x = 0; x < 4; x++) {
+         if (is_signed) {
+            etc2_signed_r11_fetch_texel(&block, x, y, (uint8_t *)&dst);
+            texels[y * 4 + x][comp] = SHORT_TO_FLOAT((GLshort) dst);
+         } else {
+            etc2_r11_fetch_texel(&block, x, y, (uint8_t *)&dst);
+            texels[y * 4 + x][comp] = USHORT_TO_FLOAT(dst);
+         }
+      }
+   }
+}
+
+static void
+etc2_rg11_fetch_block(const uint8_t *src, GLfloat texels[16][4],
+                      unsigned num_comps, bool is_signed)
+{
+   unsigned i, comp;
+
+   for (comp = 0; comp < num_comps; comp++)
+      etc2_r11_decode_block(src + comp * 8, texels, comp, is_signed);
+
+   for (i = 0; i < 16; i++) {
+      for (comp = num_comps; comp < 3; comp++)
+         texels[i][comp] = 0.0f;
+      texels[i][ACOMP] = 1.0f;
+   }
+}
+
+static void
+fetch_block_etc2_r11_eac(const GLubyte *src, GLfloat texels[16][4])
+{
+   etc2_rg11_fetch_block(src, texels, 1, false);
+}
+
+static void
+fetch_block_etc2_rg11_eac(const GLubyte *src, GLfloat texels[16][4])
+{
+   etc2_rg11_fetch_block(src, texels, 2, false);
+}
+
+static void
+fetch_block_etc2_signed_r11_eac(const GLubyte *src, GLfloat texels[16][4])
+{
+   etc2_rg11_fetch_block(src, texels, 1, true);
+}
+
+static void
+fetch_block_etc2_signed_rg11_eac(const GLubyte *src, GLfloat texels[16][4])
+{
+   etc2_rg11_fetch_block(src, texels, 2, true);
+}
+
+
+compressed_fetch_block_func
+_mesa_get_etc_fetch_block_func(mesa_format format)
+{
+   switch (format) {
+   case MESA_FORMAT_ETC1_RGB8:
+      return fetch_block_etc1_rgb8;
+   case MESA_FORMAT_ETC2_RGB8:
+      return fetch_block_etc2_rgb8;
+   case MESA_FORMAT_ETC2_SRGB8:
+      return fetch_block_etc2_srgb8;
+   case MESA_FORMAT_ETC2_RGBA8_EAC:
+      return fetch_block_etc2_rgba8_eac;
+   case MESA_FORMAT_ETC2_SRGB8_ALPHA8_EAC:
+      return fetch_block_etc2_srgb8_alpha8_eac;
+   case MESA_FORMAT_ETC2_R11_EAC:
+      return fetch_block_etc2_r11_eac;
+   case MESA_FORMAT_ETC2_RG11_EAC:
+      return fetch_block_etc2_rg11_eac;
+   case MESA_FORMAT_ETC2_SIGNED_R11_EAC:
+      return fetch_block_etc2_signed_r11_eac;
+   case MESA_FORMAT_ETC2_SIGNED_RG11_EAC:
+      return fetch_block_etc2_signed_rg11_eac;
+   case MESA_FORMAT_ETC2_RGB8_PUNCHTHROUGH_ALPHA1:
+      return fetch_block_etc2_rgb8_punchthrough_alpha1;
+   case MESA_FORMAT_ETC2_SRGB8_PUNCHTHROUGH_ALPHA1:
+      return fetch_block_etc2_srgb8_punchthrough_alpha1;
+   default:
+      return NULL;
+   }
+}
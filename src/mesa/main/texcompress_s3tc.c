@@ -374,3 +374,164 @@ _mesa_get_dxt_fetch_func(mesa_format format)
       return NULL;
    }
 }
+
+
+/*
+ * Whole block decoding.  The palettes are only built once per block
+ * instead of once per texel as in the fetch_2d_texel_*() functions.
+ */
+
+static void
+dxt135_decode_block(const GLubyte *blksrc, GLuint dxt_type,
+                    GLubyte rgba[16][4])
+{
+   const GLushort color0 = blksrc[0] | (blksrc[1] << 8);
+   const GLushort color1 = blksrc[2] | (blksrc[3] << 8);
+   const GLuint bits = blksrc[4] | (blksrc[5] << 8) |
+      (blksrc[6] << 16) | (blksrc[7] << 24);
+   GLubyte palette[4][4];
+   GLuint i;
+
+   palette[0][RCOMP] = EXP5TO8R(color0);
+   palette[0][GCOMP] = EXP6TO8G(color0);
+   palette[0][BCOMP] = EXP5TO8B(color0);
+   palette[1][RCOMP] = EXP5TO8R(color1);
+   palette[1][GCOMP] = EXP6TO8G(color1);
+   palette[1][BCOMP] = EXP5TO8B(color1);
+   palette[0][ACOMP] = palette[1][ACOMP] = palette[2][ACOMP] = 255;
+
+   if (dxt_type > 1 || color0 > color1) {
+      for (i = 0; i < 3; i++) {
+         palette[2][i] = (palette[0][i] * 2 + palette[1][i]) / 3;
+         palette[3][i] = (palette[0][i] + palette[1][i] * 2) / 3;
+      }
+      palette[3][ACOMP] = 255;
+   }
+   else {
+      for (i = 0; i < 3; i++) {
+         palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+         palette[3][i] = 0;
+      }
+      /* only RGBA DXT1 has transparent black */
+      palette[3][ACOMP] = dxt_type == 1 ? 0 : 255;
+   }
+
+   for (i = 0; i < 16; i++)
+      memcpy(rgba[i], palette[(bits >> (2 * i)) & 3], 4);
+}
+
+static void
+dxt3_decode_block(const GLubyte *blksrc, GLubyte rgba[16][4])
+{
+   GLuint i;
+
+   dxt135_decode_block(blksrc + 8, 2, rgba);
+
+   for (i = 0; i < 16; i++) {
+      const GLubyte anibble = (blksrc[i / 2] >> (4 * (i & 1))) & 0xf;
+      rgba[i][ACOMP] = (GLubyte) EXP4TO8(anibble);
+   }
+}
+
+static void
+dxt5_decode_block(const GLubyte *blksrc, GLubyte rgba[16][4])
+{
+   const GLubyte alpha0 = blksrc[0];
+   const GLubyte alpha1 = blksrc[1];
+   const uint64_t codes = (uint64_t) blksrc[2] |
+      ((uint64_t) blksrc[3] << 8) | ((uint64_t) blksrc[4] << 16) |
+      ((uint64_t) blksrc[5] << 24) | ((uint64_t) blksrc[6] << 32) |
+      ((uint64_t) blksrc[7] << 40);
+   GLubyte palette[8];
+   GLuint code, i;
+
+   palette[0] = alpha0;
+   palette[1] = alpha1;
+   for (code = 2; code < 8; code++) {
+      if (alpha0 > alpha1)
+         palette[code] = (alpha0 * (8 - code) + alpha1 * (code - 1)) / 7;
+      else if (code < 6)
+         palette[code] = (alpha0 * (6 - code) + alpha1 * (code - 1)) / 5;
+      else if (code == 6)
+         palette[code] = 0;
+      else
+         palette[code] = 255;
+   }
+
+   dxt135_decode_block(blksrc + 8, 2, rgba);
+
+   for (i = 0; i < 16; i++)
+      rgba[i][ACOMP] = palette[(codes >> (3 * i)) & 0x7];
+}
+
+static void
+block_to_float(const GLubyte tex[16][4], GLfloat texels[16][4])
+{
+   GLuint i;
+
+   for (i = 0; i < 16; i++) {
+      texels[i][RCOMP] = UBYTE_TO_FLOAT(tex[i][RCOMP]);
+      texels[i][GCOMP] = UBYTE_TO_FLOAT(tex[i][GCOMP]);
+      texels[i][BCOMP] = UBYTE_TO_FLOAT(tex[i][BCOMP]);
+      texels[i][ACOMP] = UBYTE_TO_FLOAT(tex[i][ACOMP]);
+   }
+}
+
+static void
+block_to_float_srgb(const GLubyte tex[16][4], GLfloat texels[16][4])
+{
+   GLuint i;
+
+   for (i = 0; i < 16; i++) {
+      texels[i][RCOMP] = util_format_srgb_8unorm_to_linear_float(tex[i][RCOMP]);
+      texels[i][GCOMP] = util_format_srgb_8unorm_to_linear_float(tex[i][GCOMP]);
+      texels[i][BCOMP] = util_format_srgb_8unorm_to_linear_float(tex[i][BCOMP]);
+      texels[i][ACOMP] = UBYTE_TO_FLOAT(tex[i][ACOMP]);
+   }
+}
+
+#define DXT_FETCH_BLOCK(name, decode, to_float)                         \
+static void                                                             \
+fetch_block_##name(const GLubyte *block, GLfloat texels[16][4])         \
+{                                                                       \
+   GLubyte tex[16][4];                                                  \
+   decode;                                                              \
+   to_float(tex, texels);                                               \
+}
+
+DXT_FETCH_BLOCK(rgb_dxt1, dxt135_decode_block(block, 0, tex), block_to_float)
+DXT_FETCH_BLOCK(rgba_dxt1, dxt135_decode_block(block, 1, tex), block_to_float)
+DXT_FETCH_BLOCK(rgba_dxt3, dxt3_decode_block(block, tex), block_to_float)
+DXT_FETCH_BLOCK(rgba_dxt5, dxt5_decode_block(block, tex), block_to_float)
+DXT_FETCH_BLOCK(srgb_dxt1, dxt135_decode_block(block, 0, tex), block_to_float_srgb)
+DXT_FETCH_BLOCK(srgba_dxt1, dxt135_decode_block(block, 1, tex), block_to_float_srgb)
+DXT_FETCH_BLOCK(srgba_dxt3, dxt3_decode_block(block, tex), block_to_float_srgb)
+DXT_FETCH_BLOCK(srgba_dxt5, dxt5_decode_block(block, tex), block_to_float_srgb)
+
+#undef DXT_FETCH_BLOCK
+
+
+compressed_fetch_block_func
+_mesa_get_dxt_fetch_block_func(mesa_format format)
+{
+   switch (format) {
+   case MESA_FORMAT_RGB_DXT1:
+      return fetch_block_rgb_dxt1;
+   case MESA_FORMAT_RGBA_DXT1:
+      return fetch_block_rgba_dxt1;
+   case MESA_FORMAT_RGBA_DXT3:
+      return fetch_block_rgba_dxt3;
+   case MESA_FORMAT_RGBA_DXT5:
+      return fetch_block_rgba_dxt5;
+   case MESA_FORMAT_SRGB_DXT1:
+      return fetch_block_srgb_dxt1;
+   case MESA_FORMAT_SRGBA_DXT1:
+      return fetch_block_srgba_dxt1;
+   case MESA_FORMAT_SRGBA_DXT3:
+      return fetch_block_srgba_dxt3;
+   case MESA_FORMAT_SRGBA_DXT5:
+      return fetch_block_srgba_dxt5;
+   default:
+      return NULL;
+   }
+}
@@ -47,5 +47,8 @@ _mesa_texstore_rgba_dxt5(TEXSTORE_PARAMS);
 extern compressed_fetch_func
 _mesa_get_dxt_fetch_func(mesa_format format);
 
+extern compressed_fetch_block_func
+_mesa_get_dxt_fetch_block_func(mesa_format format);
+
 
 #endif /* TEXCOMPRESS_S3TC_H */
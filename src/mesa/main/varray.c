@@ -2791,6 +2791,38 @@ _mesa_VertexArrayBindingDivisor(GLuint vaobj, GLuint bindingIndex,
 }
 
 
+/**
+ * Points the client arrays \p arrays (VERT_BIT_*) of the current vertex
+ * array object at \p ptrs, and returns their previous pointers in \p ptrs.
+ *
+ * glthread uses this to draw from the copies of client arrays it makes on
+ * the application thread.
+ */
+void
+_mesa_exchange_client_array_pointers(struct gl_context *ctx,
+                                     GLbitfield arrays,
+                                     const GLubyte **ptrs)
+{
+   struct gl_vertex_array_object *vao = ctx->Array.VAO;
+   GLbitfield mask;
+   unsigned i;
+
+   FLUSH_VERTICES(ctx, _NEW_ARRAY);
+
+   mask = arrays;
+   for (i = 0; mask; i++) {
+      const unsigned attrib = u_bit_scan(&mask);
+      struct gl_array_attributes *array = &vao->VertexAttrib[attrib];
+      const GLubyte *ptr = array->Ptr;
+
+      array->Ptr = ptrs[i];
+      vao->BufferBinding[attrib].Offset = (GLintptr) ptrs[i];
+      ptrs[i] = ptr;
+   }
+   vao->NewArrays |= arrays;
+}
+
+
 /**
  * Copy one client vertex array to another.
  */
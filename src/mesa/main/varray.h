@@ -458,6 +458,11 @@ _mesa_VertexArrayBindingDivisor_no_error(GLuint vaobj, GLuint bindingIndex,
 extern void GLAPIENTRY
 _mesa_VertexArrayBindingDivisor(GLuint vaobj, GLuint bindingIndex, GLuint divisor);
 
+extern void
+_mesa_exchange_client_array_pointers(struct gl_context *ctx,
+                                     GLbitfield arrays,
+                                     const GLubyte **ptrs);
+
 extern void
 _mesa_copy_client_array(struct gl_context *ctx,
                         struct gl_vertex_array *dst,
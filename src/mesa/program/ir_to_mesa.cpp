@@ -3113,4 +3113,21 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 #endif
 }
 
+/**
+ * Start reading the cached link of \p prog ahead of _mesa_glsl_link_shader(),
+ * for links that wait on the link queue.
+ */
+void
+_mesa_glsl_prefetch_shader_program(struct gl_context *ctx,
+                                   struct gl_shader_program *prog)
+{
+#ifdef ENABLE_SHADER_CACHE
+   /* link_shaders() doesn't look programs with transform feedback up. */
+   if (prog->TransformFeedback.NumVarying > 0)
+      return;
+
+   shader_cache_prefetch_program_metadata(ctx, prog);
+#endif
+}
+
 } /* extern "C" */
@@ -534,6 +534,11 @@ st_create_context_priv(struct gl_context *ctx, struct pipe_context *pipe,
    st->shader_has_one_variant[MESA_SHADER_GEOMETRY] = st->has_shareable_shaders;
    st->shader_has_one_variant[MESA_SHADER_COMPUTE] = st->has_shareable_shaders;
 
+   /* Linking only translates to TGSI or NIR, which needs no pipe context,
+    * so it can run on another thread.
+    */
+   ctx->Const.BackgroundLinkShader = true;
+
    st->bitmap.cache.empty = true;
 
    _mesa_override_extensions(ctx);
@@ -636,6 +641,9 @@ st_destroy_context(struct st_context *st)
    /* This must be called first so that glthread has a chance to finish */
    _mesa_glthread_destroy(ctx);
 
+   /* Programs linked in the background use the st_context. */
+   _mesa_destroy_link_queue(ctx);
+
    _mesa_HashWalk(ctx->Shared->TexObjects, destroy_tex_sampler_cb, st);
 
    st_reference_fragprog(st, &st->fp, NULL);
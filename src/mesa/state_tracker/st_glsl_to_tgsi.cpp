@@ -170,6 +170,12 @@ public:
    struct gl_linked_shader *shader;
    struct gl_shader_compiler_options *options;
 
+   /**
+    * Link errors of this stage.  The stages are translated in parallel, so
+    * st_link_shader() appends them to the program's info log afterwards.
+    */
+   char *link_log;
+
    int next_temp;
 
    unsigned *array_sizes;
@@ -204,6 +210,9 @@ public:
    bool precise;
    bool need_uarl;
 
+   /** Nesting depth of array constants being visited */
+   int in_array;
+
    variable_storage *find_variable_storage(ir_variable *var);
 
    int add_constant(gl_register_file file, gl_constant_value values[8],
@@ -353,17 +362,19 @@ static st_dst_reg address_reg2 = st_dst_reg(PROGRAM_ADDRESS, WRITEMASK_X, GLSL_T
 static st_dst_reg sampler_reladdr = st_dst_reg(PROGRAM_ADDRESS, WRITEMASK_X, GLSL_TYPE_FLOAT, 2);
 
 static void
-fail_link(struct gl_shader_program *prog, const char *fmt, ...) PRINTFLIKE(2, 3);
+fail_link(glsl_to_tgsi_visitor *v, const char *fmt, ...) PRINTFLIKE(2, 3);
 
 static void
-fail_link(struct gl_shader_program *prog, const char *fmt, ...)
+fail_link(glsl_to_tgsi_visitor *v, const char *fmt, ...)
 {
    va_list args;
+
+   if (v->link_log == NULL)
+      v->link_log = ralloc_strdup(v->mem_ctx, "");
+
    va_start(args, fmt);
-   ralloc_vasprintf_append(&prog->data->InfoLog, fmt, args);
+   ralloc_vasprintf_append(&v->link_log, fmt, args);
    va_end(args);
-
-   prog->data->LinkStatus = linking_failure;
 }
 
 int
@@ -1139,7 +1150,7 @@ glsl_to_tgsi_visitor::visit(ir_variable *ir)
 
       if (storage->file == PROGRAM_TEMPORARY &&
           dst.index != storage->index + (int) ir->get_num_state_slots()) {
-         fail_link(this->shader_program,
+         fail_link(this,
                   "failed to load builtin uniform `%s'  (%d/%d regs loaded)\n",
                   ir->name, dst.index - storage->index,
                   type_size(ir->type));
@@ -3034,7 +3045,6 @@ glsl_to_tgsi_visitor::visit(ir_constant *ir)
    gl_constant_value *values = (gl_constant_value *) stack_vals;
    GLenum gl_type = GL_NONE;
    unsigned int i;
-   static int in_array = 0;
    gl_register_file file = in_array ? PROGRAM_CONSTANT : PROGRAM_IMMEDIATE;
 
    /* Unfortunately, 4 floats is all we can get into
@@ -4452,9 +4462,11 @@ glsl_to_tgsi_visitor::glsl_to_tgsi_visitor()
    ctx = NULL;
    prog = NULL;
    precise = 0;
+   in_array = 0;
    shader_program = NULL;
    shader = NULL;
    options = NULL;
+   link_log = NULL;
    have_sqrt = false;
    have_fma = false;
    use_shared_memory = false;
@@ -6649,13 +6661,16 @@ out:
 
 
 /**
- * Convert a shader's GLSL IR into a Mesa gl_program, although without
- * generating Mesa IR.
+ * Translate a shader's GLSL IR into glsl_to_tgsi instructions and optimize
+ * them.
+ *
+ * This only touches \p shader and its gl_program, so the stages of a program
+ * can be translated in parallel.  get_mesa_program_tgsi() does the rest.
  */
-static struct gl_program *
-get_mesa_program_tgsi(struct gl_context *ctx,
-                      struct gl_shader_program *shader_program,
-                      struct gl_linked_shader *shader)
+static glsl_to_tgsi_visitor *
+generate_tgsi(struct gl_context *ctx,
+              struct gl_shader_program *shader_program,
+              struct gl_linked_shader *shader)
 {
    glsl_to_tgsi_visitor* v;
    struct gl_program *prog;
@@ -6747,6 +6762,23 @@ get_mesa_program_tgsi(struct gl_context *ctx,
    /* Write the END instruction. */
    v->emit_asm(NULL, TGSI_OPCODE_END);
 
+   return v;
+}
+
+/**
+ * Convert a shader's GLSL IR into a Mesa gl_program, although without
+ * generating Mesa IR.
+ *
+ * \p v is the result of generate_tgsi().
+ */
+static struct gl_program *
+get_mesa_program_tgsi(struct gl_context *ctx,
+                      struct gl_shader_program *shader_program,
+                      struct gl_linked_shader *shader,
+                      glsl_to_tgsi_visitor *v)
+{
+   struct gl_program *prog = shader->Program;
+
    if (ctx->_Shader->Flags & GLSL_DUMP) {
       _mesa_log("\n");
       _mesa_log("GLSL IR for linked %s program %d:\n",
@@ -6882,6 +6914,152 @@ has_unsupported_control_flow(exec_list *ir,
    return visitor.unsupported;
 }
 
+/**
+ * Lower and optimize the GLSL IR of one linked stage for the driver.
+ * Called via link_foreach_stage_parallel().
+ */
+static void
+lower_linked_stage(struct gl_context *ctx, struct gl_shader_program *prog,
+                   struct gl_linked_shader *shader, void *data)
+{
+   struct pipe_screen *pscreen = ctx->st->pipe->screen;
+   exec_list *ir = shader->ir;
+   gl_shader_stage stage = shader->Stage;
+   const struct gl_shader_compiler_options *options =
+         &ctx->Const.ShaderCompilerOptions[stage];
+   enum pipe_shader_type ptarget = pipe_shader_type_from_mesa(stage);
+   bool have_dround = pscreen->get_shader_param(pscreen, ptarget,
+                                                PIPE_SHADER_CAP_TGSI_DROUND_SUPPORTED);
+   bool have_dfrexp = pscreen->get_shader_param(pscreen, ptarget,
+                                                PIPE_SHADER_CAP_TGSI_DFRACEXP_DLDEXP_SUPPORTED);
+   bool have_ldexp = pscreen->get_shader_param(pscreen, ptarget,
+                                               PIPE_SHADER_CAP_TGSI_LDEXP_SUPPORTED);
+   unsigned if_threshold = pscreen->get_shader_param(pscreen, ptarget,
+                                                     PIPE_SHADER_CAP_LOWER_IF_THRESHOLD);
+
+   /* If there are forms of indirect addressing that the driver
+    * cannot handle, perform the lowering pass.
+    */
+   if (options->EmitNoIndirectInput || options->EmitNoIndirectOutput ||
+       options->EmitNoIndirectTemp || options->EmitNoIndirectUniform) {
+      lower_variable_index_to_cond_assign(stage, ir,
+                                          options->EmitNoIndirectInput,
+                                          options->EmitNoIndirectOutput,
+                                          options->EmitNoIndirectTemp,
+                                          options->EmitNoIndirectUniform);
+   }
+
+   if (!pscreen->get_param(pscreen, PIPE_CAP_INT64_DIVMOD))
+      lower_64bit_integer_instructions(ir, DIV64 | MOD64);
+
+   if (ctx->Extensions.ARB_shading_language_packing) {
+      unsigned lower_inst = LOWER_PACK_SNORM_2x16 |
+                            LOWER_UNPACK_SNORM_2x16 |
+                            LOWER_PACK_UNORM_2x16 |
+                            LOWER_UNPACK_UNORM_2x16 |
+                            LOWER_PACK_SNORM_4x8 |
+                            LOWER_UNPACK_SNORM_4x8 |
+                            LOWER_UNPACK_UNORM_4x8 |
+                            LOWER_PACK_UNORM_4x8;
+
+      if (ctx->Extensions.ARB_gpu_shader5)
+         lower_inst |= LOWER_PACK_USE_BFI |
+                       LOWER_PACK_USE_BFE;
+      if (!ctx->st->has_half_float_packing)
+         lower_inst |= LOWER_PACK_HALF_2x16 |
+                       LOWER_UNPACK_HALF_2x16;
+
+      lower_packing_builtins(ir, lower_inst);
+   }
+
+   if (!pscreen->get_param(pscreen, PIPE_CAP_TEXTURE_GATHER_OFFSETS))
+      lower_offset_arrays(ir);
+   do_mat_op_to_vec(ir);
+
+   if (stage == MESA_SHADER_FRAGMENT)
+      lower_blend_equation_advanced(shader);
+
+   lower_instructions(ir,
+                      MOD_TO_FLOOR |
+                      FDIV_TO_MUL_RCP |
+                      EXP_TO_EXP2 |
+                      LOG_TO_LOG2 |
+                      (have_ldexp ? 0 : LDEXP_TO_ARITH) |
+                      (have_dfrexp ? 0 : DFREXP_DLDEXP_TO_ARITH) |
+                      CARRY_TO_ARITH |
+                      BORROW_TO_ARITH |
+                      (have_dround ? 0 : DOPS_TO_DFRAC) |
+                      (options->EmitNoPow ? POW_TO_EXP2 : 0) |
+                      (!ctx->Const.NativeIntegers ? INT_DIV_TO_MUL_RCP : 0) |
+                      (options->EmitNoSat ? SAT_TO_CLAMP : 0) |
+                      (ctx->Const.ForceGLSLAbsSqrt ? SQRT_TO_ABS_SQRT : 0) |
+                      /* Assume that if ARB_gpu_shader5 is not supported
+                       * then all of the extended integer functions need
+                       * lowering.  It may be necessary to add some caps
+                       * for individual instructions.
+                       */
+                      (!ctx->Extensions.ARB_gpu_shader5
+                       ? BIT_COUNT_TO_MATH |
+                         EXTRACT_TO_SHIFTS |
+                         INSERT_TO_SHIFTS |
+                         REVERSE_TO_SHIFTS |
+                         FIND_LSB_TO_FLOAT_CAST |
+                         FIND_MSB_TO_FLOAT_CAST |
+                         IMUL_HIGH_TO_MUL
+                       : 0));
+
+   do_vec_index_to_cond_assign(ir);
+   lower_vector_insert(ir, true);
+   lower_quadop_vector(ir, false);
+   lower_noise(ir);
+   if (options->MaxIfDepth == 0) {
+      lower_discard(ir);
+   }
+
+   if (ctx->Const.GLSLOptimizeConservatively) {
+      /* Do it once and repeat only if there's unsupported control flow. */
+      do {
+         do_common_optimization(ir, true, true, options,
+                                ctx->Const.NativeIntegers);
+         lower_if_to_cond_assign(stage, ir,
+                                 options->MaxIfDepth, if_threshold);
+      } while (has_unsupported_control_flow(ir, options));
+   } else {
+      /* Repeat it until it stops making changes. */
+      bool progress;
+      do {
+         progress = do_common_optimization(ir, true, true, options,
+                                           ctx->Const.NativeIntegers);
+         progress |= lower_if_to_cond_assign(stage, ir,
+                                             options->MaxIfDepth, if_threshold);
+      } while (progress);
+   }
+
+   validate_ir_tree(ir);
+}
+
+/**
+ * Run generate_tgsi() for stages the driver wants as TGSI.  \p data is an
+ * array of visitors indexed by stage.
+ * Called via link_foreach_stage_parallel().
+ */
+static void
+generate_linked_stage_tgsi(struct gl_context *ctx,
+                           struct gl_shader_program *prog,
+                           struct gl_linked_shader *shader, void *data)
+{
+   glsl_to_tgsi_visitor **visitors = (glsl_to_tgsi_visitor **) data;
+   struct pipe_screen *pscreen = ctx->st->pipe->screen;
+   enum pipe_shader_type ptarget = pipe_shader_type_from_mesa(shader->Stage);
+
+   if (pscreen->get_shader_param(pscreen, ptarget,
+                                 PIPE_SHADER_CAP_PREFERRED_IR) ==
+       PIPE_SHADER_IR_NIR)
+      return;
+
+   visitors[shader->Stage] = generate_tgsi(ctx, prog, shader);
+}
+
 extern "C" {
 
 /**
@@ -6901,128 +7079,19 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
    struct pipe_screen *pscreen = ctx->st->pipe->screen;
    assert(prog->data->LinkStatus);
 
-   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
-      if (prog->_LinkedShaders[i] == NULL)
-         continue;
-
-      struct gl_linked_shader *shader = prog->_LinkedShaders[i];
-      exec_list *ir = shader->ir;
-      gl_shader_stage stage = shader->Stage;
-      const struct gl_shader_compiler_options *options =
-            &ctx->Const.ShaderCompilerOptions[stage];
-      enum pipe_shader_type ptarget = pipe_shader_type_from_mesa(stage);
-      bool have_dround = pscreen->get_shader_param(pscreen, ptarget,
-                                                   PIPE_SHADER_CAP_TGSI_DROUND_SUPPORTED);
-      bool have_dfrexp = pscreen->get_shader_param(pscreen, ptarget,
-                                                   PIPE_SHADER_CAP_TGSI_DFRACEXP_DLDEXP_SUPPORTED);
-      bool have_ldexp = pscreen->get_shader_param(pscreen, ptarget,
-                                                  PIPE_SHADER_CAP_TGSI_LDEXP_SUPPORTED);
-      unsigned if_threshold = pscreen->get_shader_param(pscreen, ptarget,
-                                                        PIPE_SHADER_CAP_LOWER_IF_THRESHOLD);
-
-      /* If there are forms of indirect addressing that the driver
-       * cannot handle, perform the lowering pass.
-       */
-      if (options->EmitNoIndirectInput || options->EmitNoIndirectOutput ||
-          options->EmitNoIndirectTemp || options->EmitNoIndirectUniform) {
-         lower_variable_index_to_cond_assign(stage, ir,
-                                             options->EmitNoIndirectInput,
-                                             options->EmitNoIndirectOutput,
-                                             options->EmitNoIndirectTemp,
-                                             options->EmitNoIndirectUniform);
-      }
-
-      if (!pscreen->get_param(pscreen, PIPE_CAP_INT64_DIVMOD))
-         lower_64bit_integer_instructions(ir, DIV64 | MOD64);
-
-      if (ctx->Extensions.ARB_shading_language_packing) {
-         unsigned lower_inst = LOWER_PACK_SNORM_2x16 |
-                               LOWER_UNPACK_SNORM_2x16 |
-                               LOWER_PACK_UNORM_2x16 |
-                               LOWER_UNPACK_UNORM_2x16 |
-                               LOWER_PACK_SNORM_4x8 |
-                               LOWER_UNPACK_SNORM_4x8 |
-                               LOWER_UNPACK_UNORM_4x8 |
-                               LOWER_PACK_UNORM_4x8;
-
-         if (ctx->Extensions.ARB_gpu_shader5)
-            lower_inst |= LOWER_PACK_USE_BFI |
-                          LOWER_PACK_USE_BFE;
-         if (!ctx->st->has_half_float_packing)
-            lower_inst |= LOWER_PACK_HALF_2x16 |
-                          LOWER_UNPACK_HALF_2x16;
-
-         lower_packing_builtins(ir, lower_inst);
-      }
-
-      if (!pscreen->get_param(pscreen, PIPE_CAP_TEXTURE_GATHER_OFFSETS))
-         lower_offset_arrays(ir);
-      do_mat_op_to_vec(ir);
-
-      if (stage == MESA_SHADER_FRAGMENT)
-         lower_blend_equation_advanced(shader);
-
-      lower_instructions(ir,
-                         MOD_TO_FLOOR |
-                         FDIV_TO_MUL_RCP |
-                         EXP_TO_EXP2 |
-                         LOG_TO_LOG2 |
-                         (have_ldexp ? 0 : LDEXP_TO_ARITH) |
-                         (have_dfrexp ? 0 : DFREXP_DLDEXP_TO_ARITH) |
-                         CARRY_TO_ARITH |
-                         BORROW_TO_ARITH |
-                         (have_dround ? 0 : DOPS_TO_DFRAC) |
-                         (options->EmitNoPow ? POW_TO_EXP2 : 0) |
-                         (!ctx->Const.NativeIntegers ? INT_DIV_TO_MUL_RCP : 0) |
-                         (options->EmitNoSat ? SAT_TO_CLAMP : 0) |
-                         (ctx->Const.ForceGLSLAbsSqrt ? SQRT_TO_ABS_SQRT : 0) |
-                         /* Assume that if ARB_gpu_shader5 is not supported
-                          * then all of the extended integer functions need
-                          * lowering.  It may be necessary to add some caps
-                          * for individual instructions.
-                          */
-                         (!ctx->Extensions.ARB_gpu_shader5
-                          ? BIT_COUNT_TO_MATH |
-                            EXTRACT_TO_SHIFTS |
-                            INSERT_TO_SHIFTS |
-                            REVERSE_TO_SHIFTS |
-                            FIND_LSB_TO_FLOAT_CAST |
-                            FIND_MSB_TO_FLOAT_CAST |
-                            IMUL_HIGH_TO_MUL
-                          : 0));
-
-      do_vec_index_to_cond_assign(ir);
-      lower_vector_insert(ir, true);
-      lower_quadop_vector(ir, false);
-      lower_noise(ir);
-      if (options->MaxIfDepth == 0) {
-         lower_discard(ir);
-      }
-
-      if (ctx->Const.GLSLOptimizeConservatively) {
-         /* Do it once and repeat only if there's unsupported control flow. */
-         do {
-            do_common_optimization(ir, true, true, options,
-                                   ctx->Const.NativeIntegers);
-            lower_if_to_cond_assign((gl_shader_stage)i, ir,
-                                    options->MaxIfDepth, if_threshold);
-         } while (has_unsupported_control_flow(ir, options));
-      } else {
-         /* Repeat it until it stops making changes. */
-         bool progress;
-         do {
-            progress = do_common_optimization(ir, true, true, options,
-                                              ctx->Const.NativeIntegers);
-            progress |= lower_if_to_cond_assign((gl_shader_stage)i, ir,
-                                                options->MaxIfDepth, if_threshold);
-         } while (progress);
-      }
-
-      validate_ir_tree(ir);
-   }
+   /* The stages are independent from here on, so do the heavy lifting for
+    * all of them at once.  Only the bookkeeping that touches state shared
+    * between stages (uniform storage, the driver's program objects) is left
+    * for the serial loop below.
+    */
+   link_foreach_stage_parallel(ctx, prog, lower_linked_stage, NULL);
 
    build_program_resource_list(ctx, prog);
 
+   glsl_to_tgsi_visitor *visitors[MESA_SHADER_STAGES] = { NULL };
+   link_foreach_stage_parallel(ctx, prog, generate_linked_stage_tgsi,
+                               visitors);
+
    for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
       struct gl_linked_shader *shader = prog->_LinkedShaders[i];
       if (shader == NULL)
@@ -7038,7 +7107,12 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       if (preferred_ir == PIPE_SHADER_IR_NIR) {
          linked_prog = st_nir_get_mesa_program(ctx, prog, shader);
       } else {
-         linked_prog = get_mesa_program_tgsi(ctx, prog, shader);
+         if (visitors[i]->link_log) {
+            ralloc_strcat(&prog->data->InfoLog, visitors[i]->link_log);
+            prog->data->LinkStatus = linking_failure;
+         }
+
+         linked_prog = get_mesa_program_tgsi(ctx, prog, shader, visitors[i]);
          st_set_prog_affected_state_flags(linked_prog);
       }
 
@@ -7047,6 +7121,11 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
                                               _mesa_shader_stage_to_program(i),
                                               linked_prog)) {
             _mesa_reference_program(ctx, &shader->Program, NULL);
+
+            for (unsigned j = i + 1; j < MESA_SHADER_STAGES; j++) {
+               if (visitors[j])
+                  free_glsl_to_tgsi_visitor(visitors[j]);
+            }
             return GL_FALSE;
          }
       }
@@ -1855,11 +1855,20 @@ st_print_current_vertex_program(void)
 
 /**
  * Compile one shader variant.
+ *
+ * Only the thread the context is current on may use st->pipe, so this does
+ * nothing for programs linked in the background by glLinkProgram; their
+ * first variant is compiled when they are drawn with.
  */
 void
 st_precompile_shader_variant(struct st_context *st,
                              struct gl_program *prog)
 {
+   GET_CURRENT_CONTEXT(ctx);
+
+   if (ctx != st->ctx)
+      return;
+
    switch (prog->Target) {
    case GL_VERTEX_PROGRAM_ARB: {
       struct st_vertex_program *p = (struct st_vertex_program *)prog;
@@ -163,6 +163,9 @@ struct swrast_texture_image
 
    /** For fetching texels from compressed textures */
    compressed_fetch_func FetchCompressedTexel;
+
+   /** For decoding whole blocks into SWcontext::BlockCache, may be NULL */
+   compressed_fetch_block_func FetchCompressedBlock;
 };
 
 
@@ -324,6 +327,9 @@ typedef struct
    /** State used during execution of fragment programs */
    struct gl_program_machine FragProgMachine;
 
+   /** Decoded blocks of compressed textures, invalidated when mapping them */
+   struct mesa_block_cache BlockCache;
+
    /** Temporary arrays for stencil operations.  To avoid large stack
     * allocations.
     */
@@ -33,6 +33,7 @@
  */
 
 
+#include "main/context.h"
 #include "main/macros.h"
 #include "main/texcompress.h"
 #include "main/texcompress_fxt1.h"
@@ -76,6 +77,26 @@ fetch_compressed(const struct swrast_texture_image *swImage,
    _mesa_get_format_block_size(swImage->Base.TexFormat, &bw, &bh);
    assert(swImage->RowStride * bw % texelBytes == 0);
 
+   /* Neighbouring fetches mostly hit the same few blocks, so decode whole
+    * blocks into the cache of the current context instead of decoding
+    * the block header again for every texel.
+    */
+   if (swImage->FetchCompressedBlock) {
+      GET_CURRENT_CONTEXT(ctx);
+
+      if (ctx) {
+         const GLubyte *block = (const GLubyte *) swImage->ImageSlices[k] +
+            (j / bh) * swImage->RowStride + (i / bw) * texelBytes;
+         const GLfloat (*texels)[4] =
+            _mesa_block_cache_fetch(&SWRAST_CONTEXT(ctx)->BlockCache,
+                                    swImage->FetchCompressedBlock,
+                                    block, texelBytes);
+
+         COPY_4V(texel, texels[(j % bh) * bw + (i % bw)]);
+         return;
+      }
+   }
+
    swImage->FetchCompressedTexel(swImage->ImageSlices[k],
                                  swImage->RowStride * bw / texelBytes,
                                  i, j, texel);
@@ -507,6 +528,8 @@ set_fetch_functions(const struct gl_sampler_object *samp,
    }
 
    texImage->FetchCompressedTexel = _mesa_get_compressed_fetch_func(format);
+   texImage->FetchCompressedBlock =
+      _mesa_get_compressed_fetch_block_func(format);
 
    assert(texImage->FetchTexel);
 }
@@ -265,6 +265,9 @@ _swrast_map_texture(struct gl_context *ctx, struct gl_texture_object *texObj)
    const GLuint faces = _mesa_num_tex_faces(texObj->Target);
    GLuint face, level;
 
+   /* The texture memory may have changed since the blocks were decoded */
+   _mesa_block_cache_invalidate(&SWRAST_CONTEXT(ctx)->BlockCache);
+
    for (face = 0; face < faces; face++) {
       for (level = texObj->BaseLevel; level < MAX_TEXTURE_LEVELS; level++) {
          struct gl_texture_image *texImage = texObj->Image[face][level];
@@ -75,6 +75,8 @@ vbo_minmax_cache_delete_entry(struct hash_entry *entry)
 static GLboolean
 vbo_use_minmax_cache(struct gl_buffer_object *bufferObj)
 {
+   const GLbitfield access = bufferObj->Mappings[MAP_USER].AccessFlags;
+
    if (bufferObj->UsageHistory & (USAGE_TEXTURE_BUFFER |
                                   USAGE_ATOMIC_COUNTER_BUFFER |
                                   USAGE_SHADER_STORAGE_BUFFER |
@@ -83,9 +85,15 @@ vbo_use_minmax_cache(struct gl_buffer_object *bufferObj)
                                   USAGE_DISABLE_MINMAX_CACHE))
       return GL_FALSE;
 
-   if ((bufferObj->Mappings[MAP_USER].AccessFlags &
-        (GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT)) ==
-       (GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT))
+   /* Writes through persistent mappings aren't seen, except for those
+    * that must be made visible with glFlushMappedBufferRange() or
+    * glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT), which both
+    * dirty the cache.
+    */
+   if ((access & (GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT)) ==
+       (GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT) &&
+       (access & (GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_COHERENT_BIT)) !=
+       GL_MAP_FLUSH_EXPLICIT_BIT)
       return GL_FALSE;
 
    return GL_TRUE;
@@ -228,40 +236,27 @@ out:
 
 
 /**
- * Compute min and max elements by scanning the index buffer for
- * glDraw[Range]Elements() calls.
- * If primitive restart is enabled, we need to ignore restart
- * indexes when computing min/max.
+ * Compute min and max elements of \p count indices of \p index_size bytes
+ * at \p indices, skipping \p restartIndex if \p restart is set.
+ * If all indices are skipped, *min_index will be greater than *max_index.
  */
-static void
-vbo_get_minmax_index(struct gl_context *ctx,
-                     const struct _mesa_prim *prim,
-                     const struct _mesa_index_buffer *ib,
-                     GLuint *min_index, GLuint *max_index,
-                     const GLuint count)
+void
+vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
+                            unsigned restartIndex, bool restart,
+                            const void *indices,
+                            unsigned *min_index, unsigned *max_index)
 {
-   const GLboolean restart = ctx->Array._PrimitiveRestart;
-   const GLuint restartIndex =
-      _mesa_primitive_restart_index(ctx, ib->index_size);
-   const char *indices;
    GLuint i;
-   GLintptr offset = 0;
-
-   indices = (char *) ib->ptr + prim->start * ib->index_size;
-   if (_mesa_is_bufferobj(ib->obj)) {
-      GLsizeiptr size = MIN2(count * ib->index_size, ib->obj->Size);
 
-      if (vbo_get_minmax_cached(ib->obj, ib->index_size, (GLintptr) indices,
-                                count, min_index, max_index))
-         return;
-
-      offset = (GLintptr) indices;
-      indices = ctx->Driver.MapBufferRange(ctx, offset, size,
-                                           GL_MAP_READ_BIT, ib->obj,
-                                           MAP_INTERNAL);
+#if defined(USE_SSE41)
+   if (cpu_has_sse4_1) {
+      _mesa_index_array_min_max(indices, index_size, count, restart,
+                                restartIndex, min_index, max_index);
+      return;
    }
+#endif
 
-   switch (ib->index_size) {
+   switch (index_size) {
    case 4: {
       const GLuint *ui_indices = (const GLuint *)indices;
       GLuint max_ui = 0;
@@ -275,16 +270,10 @@ vbo_get_minmax_index(struct gl_context *ctx,
          }
       }
       else {
-#if defined(USE_SSE41)
-         if (cpu_has_sse4_1) {
-            _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
+         for (i = 0; i < count; i++) {
+            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
+            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
          }
-         else
-#endif
-            for (i = 0; i < count; i++) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
       }
       *min_index = min_ui;
       *max_index = max_ui;
@@ -337,16 +326,54 @@ vbo_get_minmax_index(struct gl_context *ctx,
    default:
       unreachable("not reached");
    }
+}
 
-   if (_mesa_is_bufferobj(ib->obj)) {
-      vbo_minmax_cache_store(ctx, ib->obj, ib->index_size, offset,
-                             count, *min_index, *max_index);
-      ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+
+/**
+ * Map the \p count indices from \p start, and those of the \p nr_rest
+ * draws that follow unless they are too far apart for that to be worth it.
+ * Returns the mapping of the index buffer range [*map_offset, *map_end).
+ */
+static const char *
+vbo_map_indices(struct gl_context *ctx, const struct _mesa_index_buffer *ib,
+                GLuint start, GLuint count,
+                const struct _mesa_prim *rest, GLuint nr_rest,
+                GLintptr *map_offset, GLintptr *map_end)
+{
+   GLuint end = start + count;
+   uint64_t total = count;
+   GLuint first = start, last = end;
+   GLuint i;
+
+   for (i = 0; i < nr_rest; i++) {
+      first = MIN2(first, rest[i].start);
+      last = MAX2(last, rest[i].start + rest[i].count);
+      total += rest[i].count;
+   }
+
+   /* Don't map much more than what will be read. */
+   if (last - first <= 2 * total) {
+      start = first;
+      end = last;
    }
+
+   GLsizeiptr size = MIN2((end - start) * ib->index_size, ib->obj->Size);
+
+   *map_offset = (GLintptr) ib->ptr + start * ib->index_size;
+   *map_end = *map_offset + size;
+   return ctx->Driver.MapBufferRange(ctx, *map_offset, size,
+                                     GL_MAP_READ_BIT, ib->obj,
+                                     MAP_INTERNAL);
 }
 
 /**
- * Compute min and max elements for nr_prims
+ * Compute min and max elements for nr_prims.
+ * If primitive restart is enabled, we need to ignore restart
+ * indexes when computing min/max.
+ *
+ * Index buffer objects are mapped once for all the draws when possible,
+ * and the result of each draw is looked up in and added to the minmax
+ * cache separately.
  */
 void
 vbo_get_minmax_indices(struct gl_context *ctx,
@@ -356,6 +383,12 @@ vbo_get_minmax_indices(struct gl_context *ctx,
                        GLuint *max_index,
                        GLuint nr_prims)
 {
+   const GLboolean restart = ctx->Array._PrimitiveRestart;
+   const GLuint restartIndex =
+      _mesa_primitive_restart_index(ctx, ib->index_size);
+   const bool is_bo = _mesa_is_bufferobj(ib->obj);
+   const char *map = NULL;
+   GLintptr map_offset = 0, map_end = 0;
    GLuint tmp_min, tmp_max;
    GLuint i;
    GLuint count;
@@ -365,17 +398,52 @@ vbo_get_minmax_indices(struct gl_context *ctx,
 
    for (i = 0; i < nr_prims; i++) {
       const struct _mesa_prim *start_prim;
+      GLintptr offset;
 
       start_prim = &prims[i];
       count = start_prim->count;
-      /* Do combination if possible to reduce map/unmap count */
+      /* Do combination if possible to reduce cache lookups */
       while ((i + 1 < nr_prims) &&
              (prims[i].start + prims[i].count == prims[i+1].start)) {
          count += prims[i+1].count;
          i++;
       }
-      vbo_get_minmax_index(ctx, start_prim, ib, &tmp_min, &tmp_max, count);
+
+      offset = (GLintptr) ib->ptr + start_prim->start * ib->index_size;
+
+      if (!is_bo) {
+         vbo_get_minmax_index_mapped(count, ib->index_size, restartIndex,
+                                     restart, (const char *) offset,
+                                     &tmp_min, &tmp_max);
+      } else {
+         if (vbo_get_minmax_cached(ib->obj, ib->index_size, offset, count,
+                                   &tmp_min, &tmp_max))
+            goto combine;
+
+         /* Remap if the previous mapping only covered other draws. */
+         if (map && (offset < map_offset ||
+                     offset + count * ib->index_size > map_end)) {
+            ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
+            map = NULL;
+         }
+         if (!map) {
+            map = vbo_map_indices(ctx, ib, start_prim->start, count,
+                                  &prims[i + 1], nr_prims - i - 1,
+                                  &map_offset, &map_end);
+         }
+
+         vbo_get_minmax_index_mapped(count, ib->index_size, restartIndex,
+                                     restart, map + (offset - map_offset),
+                                     &tmp_min, &tmp_max);
+         vbo_minmax_cache_store(ctx, ib->obj, ib->index_size, offset,
+                                count, tmp_min, tmp_max);
+      }
+
+   combine:
       *min_index = MIN2(*min_index, tmp_min);
       *max_index = MAX2(*max_index, tmp_max);
    }
+
+   if (map)
+      ctx->Driver.UnmapBuffer(ctx, ib->obj, MAP_INTERNAL);
 }
@@ -39,8 +39,18 @@
 #include <dirent.h>
 #include "zlib.h"
 
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "util/crc32.h"
 #include "util/debug.h"
+#include "util/hash_table.h"
+#include "util/list.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
 #include "util/u_queue.h"
@@ -49,6 +59,7 @@
 #include "main/errors.h"
 
 #include "disk_cache.h"
+#include "disk_cache_pack.h"
 
 /* Number of bits to mask off from a cache key to get an index. */
 #define CACHE_INDEX_KEY_BITS 16
@@ -71,7 +82,38 @@
  * - There is no strict requirement that cache versions be backwards
  *   compatible but effort should be taken to limit disruption where possible.
  */
-#define CACHE_VERSION 1
+#define CACHE_VERSION 2
+
+/* Compression of the data of an entry. It is recorded in each entry so
+ * that entries written with another codec can still be read back, as long
+ * as support for it was built in.
+ */
+enum cache_codec {
+   CACHE_CODEC_NONE = 0,
+   CACHE_CODEC_ZLIB = 1,
+   CACHE_CODEC_LZ4 = 2,
+   CACHE_CODEC_ZSTD = 3,
+};
+
+/* Favour ratio, decompression speed doesn't depend on the level. */
+#define CACHE_ZSTD_LEVEL 9
+
+/* Threads writing entries and running prefetches. */
+#define CACHE_QUEUE_THREADS 4
+
+/* Default size of the in-memory cache in front of the disk. */
+#define CACHE_DEFAULT_MEMORY_SIZE (16 * 1024 * 1024)
+
+/* An entry of the in-memory cache. */
+struct mem_cache_entry {
+   struct list_head link;
+
+   cache_key key;
+
+   /* Malloc'ed copy of the uncompressed data. */
+   void *data;
+   size_t size;
+};
 
 struct disk_cache {
    /* The path to the cache directory. */
@@ -99,6 +141,38 @@ struct disk_cache {
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
+
+   /* Single file storage, used instead of a file per entry when set. */
+   struct disk_cache_pack *pack;
+
+   /* Codec used to compress new entries. */
+   enum cache_codec codec;
+
+   /* Protects the in-memory cache and seed_xorshift128plus, which are
+    * used from the queue threads.
+    */
+   mtx_t mutex;
+
+   /* In-memory cache of recently used entries, keyed by cache_key. The
+    * list is in least recently used order.
+    */
+   struct hash_table *mem_entries;
+   struct list_head mem_lru;
+   uint64_t mem_size;
+   uint64_t mem_max_size;
+
+   /* Set by disk_cache_destroy(), queued prefetches are skipped. */
+   int destroying;
+};
+
+struct disk_cache_prefetch_job {
+   struct util_queue_fence fence;
+
+   struct disk_cache *cache;
+
+   /* Keys to load, stored right after the job. */
+   cache_key *keys;
+   unsigned num_keys;
 };
 
 struct disk_cache_put_job {
@@ -183,13 +257,98 @@ do {                                       \
    _dst += _src_size;                      \
 } while (0);
 
+/* Read a size in bytes from the environment variable 'name', given as a
+ * number optionally followed by 'K', 'M' or 'G'.  A bare number is in
+ * units of 'default_unit' bytes.  Returns 'default_size' if the variable
+ * isn't set or valid.
+ */
+static uint64_t
+get_size_from_env(const char *name, uint64_t default_size,
+                  uint64_t default_unit)
+{
+   const char *str = getenv(name);
+   uint64_t size;
+   char *end;
+
+   if (str == NULL)
+      return default_size;
+
+   size = strtoul(str, &end, 10);
+   if (end == str)
+      return default_size;
+
+   switch (*end) {
+   case 'K':
+   case 'k':
+      size *= 1024;
+      break;
+   case 'M':
+   case 'm':
+      size *= 1024*1024;
+      break;
+   case '\0':
+      size *= default_unit;
+      break;
+   case 'G':
+   case 'g':
+   default:
+      size *= 1024*1024*1024;
+      break;
+   }
+
+   return size;
+}
+
+static uint32_t
+mem_cache_key_hash(const void *key)
+{
+   uint32_t hash;
+
+   /* The key is a SHA-1, any part of it is as good as a hash. */
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+mem_cache_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+/* Pick the codec for new entries from MESA_DISK_CACHE_COMPRESSION. */
+static enum cache_codec
+choose_cache_codec(void)
+{
+   const char *name = getenv("MESA_DISK_CACHE_COMPRESSION");
+
+   if (name == NULL || strcmp(name, "zlib") == 0)
+      return CACHE_CODEC_ZLIB;
+
+   if (strcmp(name, "none") == 0)
+      return CACHE_CODEC_NONE;
+
+#ifdef HAVE_LZ4
+   if (strcmp(name, "lz4") == 0)
+      return CACHE_CODEC_LZ4;
+#endif
+
+#ifdef HAVE_ZSTD
+   if (strcmp(name, "zstd") == 0)
+      return CACHE_CODEC_ZSTD;
+#endif
+
+   fprintf(stderr, "Unsupported shader cache compression '%s', "
+           "using zlib.\n", name);
+   return CACHE_CODEC_ZLIB;
+}
+
 struct disk_cache *
 disk_cache_create(const char *gpu_name, const char *timestamp,
                   uint64_t driver_flags)
 {
    void *local;
    struct disk_cache *cache = NULL;
-   char *path, *max_size_str;
+   char *path;
    uint64_t max_size;
    int fd = -1;
    struct stat sb;
@@ -324,48 +483,38 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    cache->size = (uint64_t *) cache->index_mmap;
    cache->stored_keys = cache->index_mmap + sizeof(uint64_t);
 
-   max_size = 0;
-
-   max_size_str = getenv("MESA_GLSL_CACHE_MAX_SIZE");
-   if (max_size_str) {
-      char *end;
-      max_size = strtoul(max_size_str, &end, 10);
-      if (end == max_size_str) {
-         max_size = 0;
-      } else {
-         switch (*end) {
-         case 'K':
-         case 'k':
-            max_size *= 1024;
-            break;
-         case 'M':
-         case 'm':
-            max_size *= 1024*1024;
-            break;
-         case '\0':
-         case 'G':
-         case 'g':
-         default:
-            max_size *= 1024*1024*1024;
-            break;
-         }
-      }
-   }
-
    /* Default to 1GB for maximum cache size. */
+   max_size = get_size_from_env("MESA_GLSL_CACHE_MAX_SIZE", 0,
+                                1024*1024*1024);
    if (max_size == 0) {
       max_size = 1024*1024*1024;
    }
 
    cache->max_size = max_size;
 
-   /* 1 thread was chosen because we don't really care about getting things
-    * to disk quickly just that it's not blocking other tasks.
+   cache->codec = choose_cache_codec();
+
+   cache->mem_entries = _mesa_hash_table_create(cache, mem_cache_key_hash,
+                                                mem_cache_key_equal);
+   if (cache->mem_entries == NULL)
+      goto fail;
+   list_inithead(&cache->mem_lru);
+   cache->mem_size = 0;
+   cache->mem_max_size = get_size_from_env("MESA_DISK_CACHE_MEMORY_SIZE",
+                                           CACHE_DEFAULT_MEMORY_SIZE,
+                                           1024*1024);
+   cache->destroying = 0;
+   mtx_init(&cache->mutex, mtx_plain);
+
+   /* The threads run at minimum priority, we don't really care about
+    * getting things to disk quickly just that it's not blocking other tasks.
+    * Several are used so that prefetches can read and decompress entries in
+    * parallel.
     *
     * The queue will resize automatically when it's full, so adding new jobs
     * doesn't stall.
     */
-   util_queue_init(&cache->cache_queue, "disk_cache", 32, 1,
+   util_queue_init(&cache->cache_queue, "disk_cache", 32, CACHE_QUEUE_THREADS,
                    UTIL_QUEUE_INIT_RESIZE_IF_FULL |
                    UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY);
 
@@ -401,6 +550,13 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    DRV_KEY_CPY(drv_key_blob, &ptr_size, ptr_size_size)
    DRV_KEY_CPY(drv_key_blob, &driver_flags, driver_flags_size)
 
+   /* At user request, store all entries in a single indexed file rather
+    * than one file each. Fall back to the latter if it can't be opened.
+    */
+   cache->pack = NULL;
+   if (env_var_as_boolean("MESA_DISK_CACHE_SINGLE_FILE", false))
+      cache->pack = disk_cache_pack_open(cache->path, max_size);
+
    /* Seed our rand function */
    s_rand_xorshift128plus(cache->seed_xorshift128plus, true);
 
@@ -422,13 +578,149 @@ void
 disk_cache_destroy(struct disk_cache *cache)
 {
    if (cache) {
+      /* util_queue_destroy() drops the jobs still queued without running
+       * their cleanup, so let them all go through first.  Writes complete,
+       * prefetches nobody will use anymore return right away.
+       */
+      p_atomic_set(&cache->destroying, 1);
+      util_queue_finish(&cache->cache_queue);
       util_queue_destroy(&cache->cache_queue);
+      disk_cache_pack_close(cache->pack);
       munmap(cache->index_mmap, cache->index_mmap_size);
+
+      list_for_each_entry_safe(struct mem_cache_entry, entry,
+                               &cache->mem_lru, link) {
+         free(entry->data);
+         free(entry);
+      }
+      mtx_destroy(&cache->mutex);
    }
 
    ralloc_free(cache);
 }
 
+/* Remove an entry from the in-memory cache. Must be called with the cache
+ * mutex held.
+ */
+static void
+mem_cache_remove_locked(struct disk_cache *cache, struct hash_entry *he)
+{
+   struct mem_cache_entry *entry = (struct mem_cache_entry *) he->data;
+
+   _mesa_hash_table_remove(cache->mem_entries, he);
+   list_del(&entry->link);
+   cache->mem_size -= entry->size;
+
+   free(entry->data);
+   free(entry);
+}
+
+/* Return a malloc'ed copy of the data cached in memory for 'key', or NULL.
+ */
+static void *
+mem_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct hash_entry *he;
+   void *data = NULL;
+
+   mtx_lock(&cache->mutex);
+
+   he = _mesa_hash_table_search(cache->mem_entries, key);
+   if (he) {
+      struct mem_cache_entry *entry = (struct mem_cache_entry *) he->data;
+
+      data = malloc(entry->size);
+      if (data) {
+         memcpy(data, entry->data, entry->size);
+         *size = entry->size;
+
+         /* Move to the most recently used end. */
+         list_del(&entry->link);
+         list_addtail(&entry->link, &cache->mem_lru);
+      }
+   }
+
+   mtx_unlock(&cache->mutex);
+
+   return data;
+}
+
+static bool
+mem_cache_contains(struct disk_cache *cache, const cache_key key)
+{
+   bool found;
+
+   mtx_lock(&cache->mutex);
+   found = _mesa_hash_table_search(cache->mem_entries, key) != NULL;
+   mtx_unlock(&cache->mutex);
+
+   return found;
+}
+
+/* Keep a copy of 'data' in memory, evicting the least recently used entries
+ * to make room for it.
+ */
+static void
+mem_cache_put(struct disk_cache *cache, const cache_key key,
+              const void *data, size_t size)
+{
+   struct mem_cache_entry *entry;
+
+   if (size > cache->mem_max_size)
+      return;
+
+   entry = malloc(sizeof(*entry));
+   if (entry == NULL)
+      return;
+
+   entry->data = malloc(size);
+   if (entry->data == NULL) {
+      free(entry);
+      return;
+   }
+
+   memcpy(entry->key, key, CACHE_KEY_SIZE);
+   memcpy(entry->data, data, size);
+   entry->size = size;
+
+   mtx_lock(&cache->mutex);
+
+   if (_mesa_hash_table_search(cache->mem_entries, key)) {
+      mtx_unlock(&cache->mutex);
+      free(entry->data);
+      free(entry);
+      return;
+   }
+
+   while (cache->mem_size + size > cache->mem_max_size) {
+      struct mem_cache_entry *lru =
+         list_first_entry(&cache->mem_lru, struct mem_cache_entry, link);
+
+      mem_cache_remove_locked(cache,
+         _mesa_hash_table_search(cache->mem_entries, lru->key));
+   }
+
+   list_addtail(&entry->link, &cache->mem_lru);
+   _mesa_hash_table_insert(cache->mem_entries, entry->key, entry);
+   cache->mem_size += size;
+
+   mtx_unlock(&cache->mutex);
+}
+
+static void
+mem_cache_remove(struct disk_cache *cache, const cache_key key)
+{
+   struct hash_entry *he;
+
+   mtx_lock(&cache->mutex);
+
+   he = _mesa_hash_table_search(cache->mem_entries, key);
+   if (he)
+      mem_cache_remove_locked(cache, he);
+
+   mtx_unlock(&cache->mutex);
+}
+
 /* Return a filename within the cache's directory corresponding to 'key'. The
  * returned filename is ralloced with 'cache' as the parent context.
  *
@@ -616,7 +908,10 @@ evict_lru_item(struct disk_cache *cache)
     * and reasonably expect the directory to exist with a file in it.
     * Provides pseudo-LRU eviction to reduce checking all cache files.
     */
+   mtx_lock(&cache->mutex);
    uint64_t rand64 = rand_xorshift128plus(cache->seed_xorshift128plus);
+   mtx_unlock(&cache->mutex);
+
    if (asprintf(&dir_path, "%s/%02" PRIx64 , cache->path, rand64 & 0xff) < 0)
       return;
 
@@ -655,6 +950,13 @@ disk_cache_remove(struct disk_cache *cache, const cache_key key)
 {
    struct stat sb;
 
+   mem_cache_remove(cache, key);
+
+   if (cache->pack) {
+      disk_cache_pack_remove(cache->pack, key);
+      return;
+   }
+
    char *filename = get_cache_file(cache, key);
    if (filename == NULL) {
       return;
@@ -702,73 +1004,75 @@ write_all(int fd, const void *buf, size_t count)
    return done;
 }
 
-/* From the zlib docs:
- *    "If the memory is available, buffers sizes on the order of 128K or 256K
- *    bytes should be used."
- */
-#define BUFSIZE 256 * 1024
+/* Worst case compressed size of 'in_data_size' bytes. */
+static size_t
+compress_bound(enum cache_codec codec, size_t in_data_size)
+{
+   switch (codec) {
+   case CACHE_CODEC_ZLIB:
+      return compressBound(in_data_size);
+#ifdef HAVE_LZ4
+   case CACHE_CODEC_LZ4:
+      return LZ4_compressBound(in_data_size);
+#endif
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD:
+      return ZSTD_compressBound(in_data_size);
+#endif
+   default:
+      return in_data_size;
+   }
+}
 
 /**
- * Compresses cache entry in memory and writes it to disk. Returns the size
- * of the data written to disk.
+ * Compresses cache entry data into out_data, which must be at least
+ * compress_bound() bytes. Returns true if successful.
  */
-static size_t
-deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
-                          const char *filename)
+static bool
+compress_cache_data(enum cache_codec codec,
+                    const void *in_data, size_t in_data_size,
+                    void *out_data, size_t *out_data_size)
 {
-   unsigned char out[BUFSIZE];
-
-   /* allocate deflate state */
-   z_stream strm;
-   strm.zalloc = Z_NULL;
-   strm.zfree = Z_NULL;
-   strm.opaque = Z_NULL;
-   strm.next_in = (uint8_t *) in_data;
-   strm.avail_in = in_data_size;
-
-   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
-   if (ret != Z_OK)
-       return 0;
-
-   /* compress until end of in_data */
-   size_t compressed_size = 0;
-   int flush;
-   do {
-      int remaining = in_data_size - BUFSIZE;
-      flush = remaining > 0 ? Z_NO_FLUSH : Z_FINISH;
-      in_data_size -= BUFSIZE;
-
-      /* Run deflate() on input until the output buffer is not full (which
-       * means there is no more data to deflate).
-       */
-      do {
-         strm.avail_out = BUFSIZE;
-         strm.next_out = out;
-
-         ret = deflate(&strm, flush);    /* no bad return value */
-         assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-
-         size_t have = BUFSIZE - strm.avail_out;
-         compressed_size += have;
-
-         ssize_t written = write_all(dest, out, have);
-         if (written == -1) {
-            (void)deflateEnd(&strm);
-            return 0;
-         }
-      } while (strm.avail_out == 0);
-
-      /* all input should be used */
-      assert(strm.avail_in == 0);
-
-   } while (flush != Z_FINISH);
+   switch (codec) {
+   case CACHE_CODEC_NONE:
+      memcpy(out_data, in_data, in_data_size);
+      *out_data_size = in_data_size;
+      return true;
+
+   case CACHE_CODEC_ZLIB: {
+      uLongf size = *out_data_size;
+      if (compress2(out_data, &size, in_data, in_data_size,
+                    Z_BEST_COMPRESSION) != Z_OK)
+         return false;
+      *out_data_size = size;
+      return true;
+   }
 
-   /* stream should be complete */
-   assert(ret == Z_STREAM_END);
+#ifdef HAVE_LZ4
+   case CACHE_CODEC_LZ4: {
+      int size = LZ4_compress_default(in_data, out_data, in_data_size,
+                                      *out_data_size);
+      if (size <= 0)
+         return false;
+      *out_data_size = size;
+      return true;
+   }
+#endif
+
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD: {
+      size_t size = ZSTD_compress(out_data, *out_data_size,
+                                  in_data, in_data_size, CACHE_ZSTD_LEVEL);
+      if (ZSTD_isError(size))
+         return false;
+      *out_data_size = size;
+      return true;
+   }
+#endif
 
-   /* clean up and return */
-   (void)deflateEnd(&strm);
-   return compressed_size;
+   default:
+      return false;
+   }
 }
 
 static struct disk_cache_put_job *
@@ -831,8 +1135,93 @@ destroy_put_job(void *job, int thread_index)
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+
+   /* The enum cache_codec the data following this header is compressed
+    * with.
+    */
+   uint32_t codec;
 };
 
+/**
+ * Builds a complete cache entry in memory, laid out exactly like a cache
+ * file. Returns a malloc'ed buffer, or NULL on failure.
+ */
+static uint8_t *
+create_cache_entry(struct disk_cache_put_job *dc_job, size_t *entry_size)
+{
+   struct disk_cache *cache = dc_job->cache;
+   struct cache_entry_file_data cf_data;
+   size_t header_size, compressed_size;
+   uint8_t *entry, *p;
+
+   header_size = cache->driver_keys_blob_size + sizeof(uint32_t);
+   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
+      header_size += sizeof(uint32_t) +
+         dc_job->cache_item_metadata.num_keys * sizeof(cache_key);
+   }
+   header_size += sizeof(cf_data);
+
+   compressed_size = compress_bound(cache->codec, dc_job->size);
+   entry = malloc(header_size + compressed_size);
+   if (entry == NULL)
+      return NULL;
+
+   /* Start with the driver_keys_blob, this can be used find information
+    * about the mesa version that produced the entry or deal with hash
+    * collisions, should that ever become a real problem.
+    */
+   p = entry;
+   memcpy(p, cache->driver_keys_blob, cache->driver_keys_blob_size);
+   p += cache->driver_keys_blob_size;
+
+   /* Then the cache item metadata. This data can be used to deal with
+    * hash collisions, as well as providing useful information to 3rd party
+    * tools reading the cache files.
+    */
+   memcpy(p, &dc_job->cache_item_metadata.type, sizeof(uint32_t));
+   p += sizeof(uint32_t);
+
+   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
+      memcpy(p, &dc_job->cache_item_metadata.num_keys, sizeof(uint32_t));
+      p += sizeof(uint32_t);
+
+      memcpy(p, dc_job->cache_item_metadata.keys[0],
+             dc_job->cache_item_metadata.num_keys * sizeof(cache_key));
+      p += dc_job->cache_item_metadata.num_keys * sizeof(cache_key);
+   }
+
+   /* Create CRC of the data. We will read this when restoring the cache and
+    * use it to check for corruption.
+    */
+   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
+   cf_data.uncompressed_size = dc_job->size;
+   cf_data.codec = cache->codec;
+   memcpy(p, &cf_data, sizeof(cf_data));
+   p += sizeof(cf_data);
+
+   if (!compress_cache_data(cache->codec, dc_job->data, dc_job->size,
+                            p, &compressed_size)) {
+      free(entry);
+      return NULL;
+   }
+
+   *entry_size = header_size + compressed_size;
+   return entry;
+}
+
+static void
+cache_put_pack(struct disk_cache_put_job *dc_job)
+{
+   size_t entry_size;
+   uint8_t *entry = create_cache_entry(dc_job, &entry_size);
+
+   if (entry) {
+      disk_cache_pack_put(dc_job->cache->pack, dc_job->key, entry,
+                          entry_size);
+      free(entry);
+   }
+}
+
 static void
 cache_put(void *job, int thread_index)
 {
@@ -843,6 +1232,11 @@ cache_put(void *job, int thread_index)
    char *filename = NULL, *filename_tmp = NULL;
    struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
 
+   if (dc_job->cache->pack) {
+      cache_put_pack(dc_job);
+      return;
+   }
+
    filename = get_cache_file(dc_job->cache, dc_job->key);
    if (filename == NULL)
       goto done;
@@ -901,69 +1295,24 @@ cache_put(void *job, int thread_index)
     * by some other process.
     */
 
-   /* Write the driver_keys_blob, this can be used find information about the
-    * mesa version that produced the entry or deal with hash collisions,
-    * should that ever become a real problem.
-    */
-   ret = write_all(fd, dc_job->cache->driver_keys_blob,
-                   dc_job->cache->driver_keys_blob_size);
-   if (ret == -1) {
-      unlink(filename_tmp);
-      goto done;
-   }
-
-   /* Write the cache item metadata. This data can be used to deal with
-    * hash collisions, as well as providing useful information to 3rd party
-    * tools reading the cache files.
+   /* Now, finally, write out the contents to the temporary file, then
+    * rename them atomically to the destination filename, and also
+    * perform an atomic increment of the total cache size.
     */
-   ret = write_all(fd, &dc_job->cache_item_metadata.type,
-                   sizeof(uint32_t));
-   if (ret == -1) {
+   size_t entry_size;
+   uint8_t *entry = create_cache_entry(dc_job, &entry_size);
+   if (entry == NULL) {
       unlink(filename_tmp);
       goto done;
    }
 
-   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
-      ret = write_all(fd, &dc_job->cache_item_metadata.num_keys,
-                      sizeof(uint32_t));
-      if (ret == -1) {
-         unlink(filename_tmp);
-         goto done;
-      }
-
-      ret = write_all(fd, dc_job->cache_item_metadata.keys[0],
-                      dc_job->cache_item_metadata.num_keys *
-                      sizeof(cache_key));
-      if (ret == -1) {
-         unlink(filename_tmp);
-         goto done;
-      }
-   }
-
-   /* Create CRC of the data. We will read this when restoring the cache and
-    * use it to check for corruption.
-    */
-   struct cache_entry_file_data cf_data;
-   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
-   cf_data.uncompressed_size = dc_job->size;
-
-   size_t cf_data_size = sizeof(cf_data);
-   ret = write_all(fd, &cf_data, cf_data_size);
+   ret = write_all(fd, entry, entry_size);
+   free(entry);
    if (ret == -1) {
       unlink(filename_tmp);
       goto done;
    }
 
-   /* Now, finally, write out the contents to the temporary file, then
-    * rename them atomically to the destination filename, and also
-    * perform an atomic increment of the total cache size.
-    */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
-   if (file_size == 0) {
-      unlink(filename_tmp);
-      goto done;
-   }
    ret = rename(filename_tmp, filename);
    if (ret == -1) {
       unlink(filename_tmp);
@@ -999,6 +1348,9 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
    struct disk_cache_put_job *dc_job =
       create_put_job(cache, key, data, size, cache_item_metadata);
 
+   /* Make the item available right away, and after it has been written. */
+   mem_cache_put(cache, key, data, size);
+
    if (dc_job) {
       util_queue_fence_init(&dc_job->fence);
       util_queue_add_job(&cache->cache_queue, dc_job, &dc_job->fence,
@@ -1006,6 +1358,12 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
    }
 }
 
+void
+disk_cache_wait_for_idle(struct disk_cache *cache)
+{
+   util_queue_finish(&cache->cache_queue);
+}
+
 /**
  * Decompresses cache entry, returns true if successful.
  */
@@ -1045,26 +1403,65 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
    return true;
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+/**
+ * Decompresses cache entry data with the codec it was written with, returns
+ * true if successful.
+ */
+static bool
+decompress_cache_data(enum cache_codec codec,
+                      uint8_t *in_data, size_t in_data_size,
+                      uint8_t *out_data, size_t out_data_size)
 {
-   int fd = -1, ret;
+   switch (codec) {
+   case CACHE_CODEC_NONE:
+      if (in_data_size != out_data_size)
+         return false;
+      memcpy(out_data, in_data, in_data_size);
+      return true;
+
+   case CACHE_CODEC_ZLIB:
+      return inflate_cache_data(in_data, in_data_size,
+                                out_data, out_data_size);
+
+#ifdef HAVE_LZ4
+   case CACHE_CODEC_LZ4:
+      return LZ4_decompress_safe((const char *) in_data, (char *) out_data,
+                                 in_data_size, out_data_size) ==
+             out_data_size;
+#endif
+
+#ifdef HAVE_ZSTD
+   case CACHE_CODEC_ZSTD:
+      return ZSTD_decompress(out_data, out_data_size,
+                             in_data, in_data_size) == out_data_size;
+#endif
+
+   default:
+      /* Written by a build supporting more codecs than this one. */
+      return false;
+   }
+}
+
+/**
+ * Reads a whole cache file into a malloc'ed buffer.
+ */
+static uint8_t *
+read_cache_file(struct disk_cache *cache, const cache_key key,
+                size_t *file_size)
+{
+   int fd = -1;
    struct stat sb;
-   char *filename = NULL;
+   char *filename;
    uint8_t *data = NULL;
-   uint8_t *uncompressed_data = NULL;
-   uint8_t *file_header = NULL;
-
-   if (size)
-      *size = 0;
 
    filename = get_cache_file(cache, key);
    if (filename == NULL)
-      goto fail;
+      return NULL;
 
    fd = open(filename, O_RDONLY | O_CLOEXEC);
+   free(filename);
    if (fd == -1)
-      goto fail;
+      return NULL;
 
    if (fstat(fd, &sb) == -1)
       goto fail;
@@ -1073,36 +1470,66 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    if (data == NULL)
       goto fail;
 
-   size_t ck_size = cache->driver_keys_blob_size;
-   file_header = malloc(ck_size);
-   if (!file_header)
+   if (read_all(fd, data, sb.st_size) == -1)
       goto fail;
 
-   if (sb.st_size < ck_size)
+   close(fd);
+
+   *file_size = sb.st_size;
+   return data;
+
+ fail:
+   free(data);
+   close(fd);
+
+   return NULL;
+}
+
+/**
+ * Loads the entry for 'key' from disk and returns its uncompressed data.
+ */
+static void *
+load_cache_entry(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   uint8_t *entry = NULL;
+   uint8_t *uncompressed_data = NULL;
+   size_t entry_size = 0;
+
+   if (size)
+      *size = 0;
+
+   if (cache->pack)
+      entry = disk_cache_pack_get(cache->pack, key, &entry_size);
+   else
+      entry = read_cache_file(cache, key, &entry_size);
+   if (entry == NULL)
       goto fail;
 
-   ret = read_all(fd, file_header, ck_size);
-   if (ret == -1)
+   uint8_t *p = entry, *end = entry + entry_size;
+
+   size_t ck_size = cache->driver_keys_blob_size;
+   if (end - p < ck_size)
       goto fail;
 
    /* Check for extremely unlikely hash collisions */
-   if (memcmp(cache->driver_keys_blob, file_header, ck_size) != 0) {
+   if (memcmp(cache->driver_keys_blob, p, ck_size) != 0) {
       assert(!"Mesa cache keys mismatch!");
       goto fail;
    }
+   p += ck_size;
 
-   size_t cache_item_md_size = sizeof(uint32_t);
    uint32_t md_type;
-   ret = read_all(fd, &md_type, cache_item_md_size);
-   if (ret == -1)
+   if (end - p < sizeof(md_type))
       goto fail;
+   memcpy(&md_type, p, sizeof(md_type));
+   p += sizeof(md_type);
 
    if (md_type == CACHE_ITEM_TYPE_GLSL) {
       uint32_t num_keys;
-      cache_item_md_size += sizeof(uint32_t);
-      ret = read_all(fd, &num_keys, sizeof(uint32_t));
-      if (ret == -1)
+      if (end - p < sizeof(num_keys))
          goto fail;
+      memcpy(&num_keys, p, sizeof(num_keys));
+      p += sizeof(num_keys);
 
       /* The cache item metadata is currently just used for distributing
        * precompiled shaders, they are not used by Mesa so just skip them for
@@ -1110,30 +1537,25 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
        * TODO: pass the metadata back to the caller and do some basic
        * validation.
        */
-      cache_item_md_size += num_keys * sizeof(cache_key);
-      ret = lseek(fd, num_keys * sizeof(cache_key), SEEK_CUR);
-      if (ret == -1)
+      if ((end - p) / sizeof(cache_key) < num_keys)
          goto fail;
+      p += num_keys * sizeof(cache_key);
    }
 
    /* Load the CRC that was created when the file was written. */
    struct cache_entry_file_data cf_data;
-   size_t cf_data_size = sizeof(cf_data);
-   ret = read_all(fd, &cf_data, cf_data_size);
-   if (ret == -1)
-      goto fail;
-
-   /* Load the actual cache data. */
-   size_t cache_data_size =
-      sb.st_size - cf_data_size - ck_size - cache_item_md_size;
-   ret = read_all(fd, data, cache_data_size);
-   if (ret == -1)
+   if (end - p < sizeof(cf_data))
       goto fail;
+   memcpy(&cf_data, p, sizeof(cf_data));
+   p += sizeof(cf_data);
 
    /* Uncompress the cache data */
    uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
+   if (!uncompressed_data)
+      goto fail;
+
+   if (!decompress_cache_data(cf_data.codec, p, end - p, uncompressed_data,
+                              cf_data.uncompressed_size))
       goto fail;
 
    /* Check the data for corruption */
@@ -1141,10 +1563,7 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
                                         cf_data.uncompressed_size))
       goto fail;
 
-   free(data);
-   free(filename);
-   free(file_header);
-   close(fd);
+   free(entry);
 
    if (size)
       *size = cf_data.uncompressed_size;
@@ -1152,20 +1571,95 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return uncompressed_data;
 
  fail:
-   if (data)
-      free(data);
-   if (uncompressed_data)
-      free(uncompressed_data);
-   if (filename)
-      free(filename);
-   if (file_header)
-      free(file_header);
-   if (fd != -1)
-      close(fd);
+   free(entry);
+   free(uncompressed_data);
 
    return NULL;
 }
 
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   size_t data_size = 0;
+   void *data;
+
+   data = mem_cache_get(cache, key, &data_size);
+   if (data == NULL) {
+      data = load_cache_entry(cache, key, &data_size);
+      if (data)
+         mem_cache_put(cache, key, data, data_size);
+   }
+
+   if (size)
+      *size = data_size;
+
+   return data;
+}
+
+static void
+cache_prefetch(void *job, int thread_index)
+{
+   struct disk_cache_prefetch_job *pf_job =
+      (struct disk_cache_prefetch_job *) job;
+   struct disk_cache *cache = pf_job->cache;
+
+   for (unsigned i = 0; i < pf_job->num_keys; i++) {
+      size_t size;
+      void *data;
+
+      if (p_atomic_read(&cache->destroying))
+         return;
+
+      if (mem_cache_contains(cache, pf_job->keys[i]))
+         continue;
+
+      data = load_cache_entry(cache, pf_job->keys[i], &size);
+      if (data) {
+         mem_cache_put(cache, pf_job->keys[i], data, size);
+         free(data);
+      }
+   }
+}
+
+static void
+destroy_prefetch_job(void *job, int thread_index)
+{
+   free(job);
+}
+
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   if (cache->mem_max_size == 0)
+      return;
+
+   /* Split the keys between the queue threads so that entries are read
+    * and decompressed in parallel.
+    */
+   unsigned keys_per_job =
+      (num_keys + CACHE_QUEUE_THREADS - 1) / CACHE_QUEUE_THREADS;
+
+   for (unsigned first = 0; first < num_keys; first += keys_per_job) {
+      unsigned count = num_keys - first < keys_per_job ?
+                       num_keys - first : keys_per_job;
+      struct disk_cache_prefetch_job *pf_job = (struct disk_cache_prefetch_job *)
+         malloc(sizeof(*pf_job) + count * sizeof(cache_key));
+
+      if (pf_job == NULL)
+         return;
+
+      pf_job->cache = cache;
+      pf_job->keys = (cache_key *) (pf_job + 1);
+      memcpy(pf_job->keys, keys + first, count * sizeof(cache_key));
+      pf_job->num_keys = count;
+
+      util_queue_fence_init(&pf_job->fence);
+      util_queue_add_job(&cache->cache_queue, pf_job, &pf_job->fence,
+                         cache_prefetch, destroy_prefetch_job);
+   }
+}
+
 void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -0,0 +1,749 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef ENABLE_SHADER_CACHE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "c11/threads.h"
+#include "util/u_atomic.h"
+#include "util/ralloc.h"
+
+#include "disk_cache_pack.h"
+
+/* The pack is made of three files within the cache directory:
+ *
+ *   pack.dat  - A small header followed by the entries, each one prefixed
+ *               by a struct pack_record_header.  Records are only ever
+ *               appended, removed records are reclaimed by compaction.
+ *
+ *   pack.idx  - A struct pack_index_header followed by a fixed size open
+ *               addressing (linear probing) hash table of struct
+ *               pack_index_slot, mapped shared by every process using the
+ *               cache.
+ *
+ *   pack.lock - Held exclusively with flock() by writers, and while opening
+ *               the other two files so they are seen in a consistent state.
+ *
+ * Readers don't take any lock: a slot is published by storing its offset
+ * last, and the record header is checked against the key and size found in
+ * the slot before returning anything, so a racing remove or compaction can
+ * only turn a hit into a miss.
+ *
+ * Compaction writes new files next to the current ones, renames them into
+ * place and then flags the old index as stale.  Processes noticing the flag
+ * reopen the files.  Each generation is reference counted, so the previous
+ * one stays mapped only until the last thread reading from it is done.
+ */
+
+#define PACK_INDEX_NAME "pack.idx"
+#define PACK_DATA_NAME "pack.dat"
+#define PACK_LOCK_NAME "pack.lock"
+
+#define PACK_MAGIC 0x4b43504d /* "MPCK" */
+
+/* Bump whenever the layout of any of the structs below changes. */
+#define PACK_VERSION 1
+
+/* Number of slots of the hash table, must be a power of two. */
+#define PACK_INDEX_SLOTS (1 << 18)
+
+/* Special slot offsets, real offsets are past the data file header. */
+#define PACK_SLOT_EMPTY 0
+#define PACK_SLOT_REMOVED 1
+
+struct pack_index_header {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t num_slots;
+
+   /* Set once the files have been replaced by a compaction. */
+   uint32_t stale;
+
+   /* Offset at which the next record is appended to the data file. */
+   uint64_t data_size;
+
+   /* Size of the records still referenced by the index. */
+   uint64_t live_size;
+
+   /* Number of slots not empty, removed ones included. */
+   uint32_t num_used;
+
+   uint32_t pad[7];
+};
+
+struct pack_index_slot {
+   uint64_t offset;
+   uint32_t size;
+
+   /* Last access time, used to pick the entries surviving compaction. */
+   uint32_t atime;
+
+   uint8_t key[CACHE_KEY_SIZE];
+   uint32_t pad;
+};
+
+struct pack_data_header {
+   uint32_t magic;
+   uint32_t version;
+};
+
+struct pack_record_header {
+   uint8_t key[CACHE_KEY_SIZE];
+   uint32_t size;
+};
+
+/* One generation of the pack files. */
+struct pack_files {
+   /* One reference is held by the pack while this is the current
+    * generation, and one by every thread using it.
+    */
+   int refcount;
+
+   int data_fd;
+
+   struct pack_index_header *header;
+   struct pack_index_slot *slots;
+   size_t index_size;
+};
+
+struct disk_cache_pack {
+   char *index_path;
+   char *data_path;
+   char *lock_path;
+
+   uint64_t max_size;
+
+   /* Protects 'files', and taking references to it. */
+   mtx_t mutex;
+
+   struct pack_files *files;
+};
+
+static int
+pack_lock(struct disk_cache_pack *pack)
+{
+   int fd = open(pack->lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (fd == -1)
+      return -1;
+
+   if (flock(fd, LOCK_EX) == -1) {
+      close(fd);
+      return -1;
+   }
+
+   return fd;
+}
+
+static void
+pack_unlock(int fd)
+{
+   /* Closing the file releases the flock. */
+   close(fd);
+}
+
+static void
+pack_files_destroy(struct pack_files *files)
+{
+   munmap(files->header, files->index_size);
+   close(files->data_fd);
+   free(files);
+}
+
+/* Return a reference to the current generation. */
+static struct pack_files *
+pack_files_ref(struct disk_cache_pack *pack)
+{
+   struct pack_files *files;
+
+   mtx_lock(&pack->mutex);
+   files = pack->files;
+   p_atomic_inc(&files->refcount);
+   mtx_unlock(&pack->mutex);
+
+   return files;
+}
+
+static void
+pack_files_unref(struct pack_files *files)
+{
+   if (p_atomic_dec_zero(&files->refcount))
+      pack_files_destroy(files);
+}
+
+/* Make 'files' the current generation, handing the caller's reference to
+ * the pack, and drop the pack's reference to the previous one.
+ */
+static void
+pack_files_replace(struct disk_cache_pack *pack, struct pack_files *files)
+{
+   struct pack_files *old;
+
+   mtx_lock(&pack->mutex);
+   old = pack->files;
+   pack->files = files;
+   mtx_unlock(&pack->mutex);
+
+   pack_files_unref(old);
+}
+
+/* Reset both files to an empty pack. */
+static bool
+pack_files_init(struct pack_files *files, int index_fd)
+{
+   struct pack_data_header data_header = { PACK_MAGIC, PACK_VERSION };
+
+   if (ftruncate(files->data_fd, 0) == -1 ||
+       pwrite(files->data_fd, &data_header, sizeof(data_header), 0) !=
+       sizeof(data_header))
+      return false;
+
+   /* Truncating down first zeroes the whole table. */
+   if (ftruncate(index_fd, 0) == -1 ||
+       ftruncate(index_fd, files->index_size) == -1)
+      return false;
+
+   files->header->magic = PACK_MAGIC;
+   files->header->version = PACK_VERSION;
+   files->header->num_slots = PACK_INDEX_SLOTS;
+   files->header->data_size = sizeof(data_header);
+
+   return true;
+}
+
+/* Open, and create or reset when they aren't valid, the pack files at the
+ * given paths.  Must be called with the pack lock held.
+ */
+static struct pack_files *
+pack_files_open(const char *index_path, const char *data_path)
+{
+   struct pack_files *files;
+   struct pack_data_header data_header;
+   struct stat sb;
+   int index_fd;
+   bool valid;
+
+   files = calloc(1, sizeof(*files));
+   if (files == NULL)
+      return NULL;
+
+   files->refcount = 1;
+   files->index_size = sizeof(struct pack_index_header) +
+                       PACK_INDEX_SLOTS * sizeof(struct pack_index_slot);
+
+   files->data_fd = open(data_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (files->data_fd == -1) {
+      free(files);
+      return NULL;
+   }
+
+   index_fd = open(index_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (index_fd == -1)
+      goto fail;
+
+   if (fstat(index_fd, &sb) == -1)
+      goto fail;
+
+   valid = sb.st_size == files->index_size;
+
+   if (!valid && ftruncate(index_fd, files->index_size) == -1)
+      goto fail;
+
+   files->header = mmap(NULL, files->index_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, index_fd, 0);
+   if (files->header == MAP_FAILED) {
+      files->header = NULL;
+      goto fail;
+   }
+   files->slots = (struct pack_index_slot *) (files->header + 1);
+
+   valid = valid &&
+           files->header->magic == PACK_MAGIC &&
+           files->header->version == PACK_VERSION &&
+           files->header->num_slots == PACK_INDEX_SLOTS &&
+           !files->header->stale;
+
+   if (valid) {
+      valid = fstat(files->data_fd, &sb) == 0 &&
+              sb.st_size >= files->header->data_size &&
+              pread(files->data_fd, &data_header, sizeof(data_header), 0) ==
+              sizeof(data_header) &&
+              data_header.magic == PACK_MAGIC &&
+              data_header.version == PACK_VERSION;
+   }
+
+   if (!valid && !pack_files_init(files, index_fd))
+      goto fail;
+
+   close(index_fd);
+
+   return files;
+
+ fail:
+   if (files->header)
+      munmap(files->header, files->index_size);
+   if (index_fd != -1)
+      close(index_fd);
+   close(files->data_fd);
+   free(files);
+
+   return NULL;
+}
+
+/* Replace the current generation with the files now on disk if it went
+ * stale.  Takes over the caller's reference to 'stale' and returns one to
+ * the current generation.  Must be called with the pack lock held.
+ */
+static struct pack_files *
+pack_refresh_locked(struct disk_cache_pack *pack, struct pack_files *stale)
+{
+   struct pack_files *files;
+
+   /* Writers in this process hold the pack lock too, so nobody else
+    * replaces the current generation meanwhile.
+    */
+   if (pack->files == stale) {
+      files = pack_files_open(pack->index_path, pack->data_path);
+      if (files)
+         pack_files_replace(pack, files);
+   }
+
+   files = pack_files_ref(pack);
+   pack_files_unref(stale);
+
+   return files;
+}
+
+/* Return a reference to the current generation, reopening the files first
+ * if they were replaced by another process.
+ */
+static struct pack_files *
+pack_current_files(struct disk_cache_pack *pack)
+{
+   struct pack_files *files = pack_files_ref(pack);
+
+   if (p_atomic_read(&files->header->stale)) {
+      int lock_fd = pack_lock(pack);
+      if (lock_fd == -1)
+         return files;
+
+      files = pack_refresh_locked(pack, files);
+      pack_unlock(lock_fd);
+   }
+
+   return files;
+}
+
+static inline uint32_t
+pack_key_hash(const cache_key key)
+{
+   uint32_t hash;
+
+   /* The key is a SHA-1, any part of it is as good as a hash. */
+   memcpy(&hash, key, sizeof(hash));
+
+   return hash;
+}
+
+/* Return the slot holding 'key', or NULL. */
+static struct pack_index_slot *
+pack_find_slot(struct pack_files *files, const cache_key key)
+{
+   const uint32_t mask = files->header->num_slots - 1;
+   uint32_t i = pack_key_hash(key) & mask;
+
+   for (uint32_t n = 0; n <= mask; n++, i = (i + 1) & mask) {
+      struct pack_index_slot *slot = &files->slots[i];
+      uint64_t offset = p_atomic_read(&slot->offset);
+
+      if (offset == PACK_SLOT_EMPTY)
+         return NULL;
+
+      if (offset != PACK_SLOT_REMOVED &&
+          memcmp(slot->key, key, CACHE_KEY_SIZE) == 0)
+         return slot;
+   }
+
+   return NULL;
+}
+
+/* Return the slot a new record for 'key' should be published in, or NULL
+ * if the key is already present or the table is full.  Must be called with
+ * the pack lock held.
+ */
+static struct pack_index_slot *
+pack_insert_slot(struct pack_files *files, const cache_key key)
+{
+   const uint32_t mask = files->header->num_slots - 1;
+   struct pack_index_slot *removed = NULL;
+   uint32_t i = pack_key_hash(key) & mask;
+
+   for (uint32_t n = 0; n <= mask; n++, i = (i + 1) & mask) {
+      struct pack_index_slot *slot = &files->slots[i];
+
+      if (slot->offset == PACK_SLOT_EMPTY)
+         return removed ? removed : slot;
+
+      if (slot->offset == PACK_SLOT_REMOVED) {
+         if (!removed)
+            removed = slot;
+      } else if (memcmp(slot->key, key, CACHE_KEY_SIZE) == 0) {
+         return NULL;
+      }
+   }
+
+   return removed;
+}
+
+/* Append a record to the data file and publish it in the index.  Must be
+ * called with the pack lock held.
+ */
+static bool
+pack_append(struct pack_files *files, const cache_key key,
+            const void *data, size_t size, uint32_t atime)
+{
+   struct pack_record_header record;
+   struct pack_index_slot *slot;
+   uint64_t offset = files->header->data_size;
+
+   slot = pack_insert_slot(files, key);
+   if (slot == NULL)
+      return false;
+
+   memcpy(record.key, key, CACHE_KEY_SIZE);
+   record.size = size;
+
+   if (pwrite(files->data_fd, &record, sizeof(record), offset) !=
+       sizeof(record) ||
+       pwrite(files->data_fd, data, size, offset + sizeof(record)) != size)
+      return false;
+
+   if (slot->offset == PACK_SLOT_EMPTY)
+      files->header->num_used++;
+
+   memcpy(slot->key, key, CACHE_KEY_SIZE);
+   slot->size = size;
+   slot->atime = atime;
+   p_atomic_set(&slot->offset, offset);
+
+   files->header->data_size += sizeof(record) + size;
+   files->header->live_size += sizeof(record) + size;
+
+   return true;
+}
+
+/* Read the record published in 'slot' into a malloc'ed buffer, provided it
+ * still holds 'key'.
+ */
+static void *
+pack_read(struct pack_files *files, struct pack_index_slot *slot,
+          const cache_key key, size_t *size)
+{
+   struct pack_record_header record;
+   uint64_t offset = p_atomic_read(&slot->offset);
+   uint32_t data_size = slot->size;
+   void *data;
+
+   if (offset == PACK_SLOT_EMPTY || offset == PACK_SLOT_REMOVED)
+      return NULL;
+
+   if (pread(files->data_fd, &record, sizeof(record), offset) !=
+       sizeof(record))
+      return NULL;
+
+   /* The slot may have been reused since we looked at it. */
+   if (memcmp(record.key, key, CACHE_KEY_SIZE) != 0 ||
+       record.size != data_size)
+      return NULL;
+
+   data = malloc(data_size);
+   if (data == NULL)
+      return NULL;
+
+   if (pread(files->data_fd, data, data_size, offset + sizeof(record)) !=
+       data_size) {
+      free(data);
+      return NULL;
+   }
+
+   *size = data_size;
+   return data;
+}
+
+struct pack_live_slot {
+   struct pack_index_slot *slot;
+   uint32_t atime;
+   uint64_t offset;
+};
+
+static int
+compare_live_slots(const void *a, const void *b)
+{
+   const struct pack_live_slot *sa = a, *sb = b;
+
+   /* Most recently used first, and most recently written among those. */
+   if (sa->atime != sb->atime)
+      return sa->atime < sb->atime ? 1 : -1;
+   if (sa->offset != sb->offset)
+      return sa->offset < sb->offset ? 1 : -1;
+   return 0;
+}
+
+/* Rewrite the pack keeping the most recently used entries up to 3/4 of the
+ * maximum size, dropping removed records and tombstones.  Takes over the
+ * caller's reference to 'files' and returns one to the generation to use.
+ * Must be called with the pack lock held.
+ */
+static struct pack_files *
+pack_compact_locked(struct disk_cache_pack *pack, struct pack_files *files)
+{
+   struct pack_live_slot *live;
+   struct pack_files *compacted = NULL;
+   char *index_tmp = NULL, *data_tmp = NULL;
+   uint64_t budget = pack->max_size / 4 * 3, kept = 0;
+   unsigned num_live = 0;
+
+   live = malloc(files->header->num_used * sizeof(*live));
+   if (files->header->num_used && live == NULL)
+      return files;
+
+   for (uint32_t i = 0; i < files->header->num_slots; i++) {
+      struct pack_index_slot *slot = &files->slots[i];
+
+      if (slot->offset == PACK_SLOT_EMPTY || slot->offset == PACK_SLOT_REMOVED)
+         continue;
+
+      assert(num_live < files->header->num_used);
+      live[num_live].slot = slot;
+      live[num_live].atime = slot->atime;
+      live[num_live].offset = slot->offset;
+      num_live++;
+   }
+
+   qsort(live, num_live, sizeof(*live), compare_live_slots);
+
+   index_tmp = ralloc_asprintf(NULL, "%s.tmp", pack->index_path);
+   data_tmp = ralloc_asprintf(NULL, "%s.tmp", pack->data_path);
+   if (index_tmp == NULL || data_tmp == NULL)
+      goto done;
+
+   /* Leftovers from an interrupted compaction are reset by the open. */
+   compacted = pack_files_open(index_tmp, data_tmp);
+   if (compacted == NULL)
+      goto done;
+
+   for (unsigned i = 0; i < num_live; i++) {
+      struct pack_index_slot *slot = live[i].slot;
+      uint64_t record_size = sizeof(struct pack_record_header) + slot->size;
+      size_t size;
+      void *data;
+
+      if (kept + record_size > budget)
+         break;
+
+      data = pack_read(files, slot, slot->key, &size);
+      if (data == NULL)
+         continue;
+
+      if (pack_append(compacted, slot->key, data, size, slot->atime))
+         kept += record_size;
+
+      free(data);
+   }
+
+   /* The data file goes first so anyone opening the new index finds the
+    * matching data, they can't see the new data with the old index as
+    * opening is done with the lock held.
+    */
+   if (rename(data_tmp, pack->data_path) == -1 ||
+       rename(index_tmp, pack->index_path) == -1) {
+      pack_files_destroy(compacted);
+      unlink(index_tmp);
+      unlink(data_tmp);
+      goto done;
+   }
+
+   p_atomic_set(&files->header->stale, 1);
+
+   pack_files_replace(pack, compacted);
+   pack_files_unref(files);
+   files = pack_files_ref(pack);
+
+ done:
+   ralloc_free(index_tmp);
+   ralloc_free(data_tmp);
+   free(live);
+
+   return files;
+}
+
+struct disk_cache_pack *
+disk_cache_pack_open(const char *path, uint64_t max_size)
+{
+   struct disk_cache_pack *pack;
+   int lock_fd;
+
+   pack = rzalloc(NULL, struct disk_cache_pack);
+   if (pack == NULL)
+      return NULL;
+
+   pack->index_path = ralloc_asprintf(pack, "%s/%s", path, PACK_INDEX_NAME);
+   pack->data_path = ralloc_asprintf(pack, "%s/%s", path, PACK_DATA_NAME);
+   pack->lock_path = ralloc_asprintf(pack, "%s/%s", path, PACK_LOCK_NAME);
+   if (!pack->index_path || !pack->data_path || !pack->lock_path)
+      goto fail;
+
+   pack->max_size = max_size;
+
+   lock_fd = pack_lock(pack);
+   if (lock_fd == -1)
+      goto fail;
+
+   pack->files = pack_files_open(pack->index_path, pack->data_path);
+   pack_unlock(lock_fd);
+
+   if (pack->files == NULL)
+      goto fail;
+
+   mtx_init(&pack->mutex, mtx_plain);
+
+   return pack;
+
+ fail:
+   ralloc_free(pack);
+   return NULL;
+}
+
+void
+disk_cache_pack_close(struct disk_cache_pack *pack)
+{
+   if (pack == NULL)
+      return;
+
+   pack_files_unref(pack->files);
+   mtx_destroy(&pack->mutex);
+   ralloc_free(pack);
+}
+
+bool
+disk_cache_pack_put(struct disk_cache_pack *pack, const cache_key key,
+                    const void *data, size_t size)
+{
+   struct pack_files *files;
+   struct pack_index_header *header;
+   uint64_t record_size = sizeof(struct pack_record_header) + size;
+   bool ret;
+   int lock_fd;
+
+   if (record_size > pack->max_size || size > UINT32_MAX)
+      return false;
+
+   lock_fd = pack_lock(pack);
+   if (lock_fd == -1)
+      return false;
+
+   files = pack_files_ref(pack);
+   if (files->header->stale)
+      files = pack_refresh_locked(pack, files);
+
+   if (pack_find_slot(files, key)) {
+      pack_files_unref(files);
+      pack_unlock(lock_fd);
+      return true;
+   }
+
+   header = files->header;
+   if (header->live_size + record_size > pack->max_size ||
+       header->data_size + record_size > 2 * pack->max_size ||
+       header->num_used >= header->num_slots / 4 * 3)
+      files = pack_compact_locked(pack, files);
+
+   ret = pack_append(files, key, data, size, time(NULL));
+
+   pack_files_unref(files);
+   pack_unlock(lock_fd);
+
+   return ret;
+}
+
+void *
+disk_cache_pack_get(struct disk_cache_pack *pack, const cache_key key,
+                    size_t *size)
+{
+   struct pack_files *files = pack_current_files(pack);
+   struct pack_index_slot *slot;
+   void *data;
+
+   slot = pack_find_slot(files, key);
+   if (slot == NULL) {
+      pack_files_unref(files);
+      return NULL;
+   }
+
+   data = pack_read(files, slot, key, size);
+
+   /* Racy, but at worst an entry is considered a bit older than it is. */
+   if (data)
+      slot->atime = time(NULL);
+
+   pack_files_unref(files);
+
+   return data;
+}
+
+void
+disk_cache_pack_remove(struct disk_cache_pack *pack, const cache_key key)
+{
+   struct pack_files *files;
+   struct pack_index_slot *slot;
+   int lock_fd;
+
+   lock_fd = pack_lock(pack);
+   if (lock_fd == -1)
+      return;
+
+   files = pack_files_ref(pack);
+   if (files->header->stale)
+      files = pack_refresh_locked(pack, files);
+
+   slot = pack_find_slot(files, key);
+   if (slot) {
+      files->header->live_size -= sizeof(struct pack_record_header) +
+                                  slot->size;
+      p_atomic_set(&slot->offset, PACK_SLOT_REMOVED);
+   }
+
+   pack_files_unref(files);
+   pack_unlock(lock_fd);
+}
+
+#endif /* ENABLE_SHADER_CACHE */
@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Replay interference graphs recorded with MESA_RA_RECORD_DIR.
+ *
+ * Usage: ra_bench [-n iterations] <file or directory>...
+ *
+ * Every graph found is read back and colored the given number of times,
+ * asking for the best spill candidate whenever allocation fails, the same
+ * way a backend would before spilling.  The time per graph is the best of
+ * all iterations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <inttypes.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/ralloc.h"
+#include "util/register_allocate.h"
+
+static unsigned iterations = 10;
+
+static unsigned graph_count, failed_count;
+static int64_t total_ns;
+
+static int
+bench_file(const char *path, const struct stat *sb, int typeflag,
+           struct FTW *ftwbuf)
+{
+   struct ra_graph *g;
+   int64_t best_ns = INT64_MAX;
+   bool colored = false;
+   FILE *f;
+
+   if (typeflag != FTW_F)
+      return 0;
+
+   for (unsigned i = 0; i < iterations; i++) {
+      int64_t start, ns;
+
+      f = fopen(path, "r");
+      if (f == NULL)
+         return 0;
+      g = ra_read_graph(f);
+      fclose(f);
+
+      if (g == NULL) {
+         fprintf(stderr, "%s: not a register allocation graph\n", path);
+         return 0;
+      }
+
+      start = os_time_get_nano();
+      colored = ra_allocate(g);
+      if (!colored)
+         ra_get_best_spill_node(g);
+      ns = os_time_get_nano() - start;
+
+      if (ns < best_ns)
+         best_ns = ns;
+
+      ralloc_free(g);
+   }
+
+   printf("%-60s %-8s %10.3f\n", path,
+          colored ? "colored" : "spill", best_ns / 1e6);
+
+   graph_count++;
+   if (!colored)
+      failed_count++;
+   total_ns += best_ns;
+
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   int i = 1;
+
+   if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+      iterations = MAX2(atoi(argv[2]), 1);
+      i = 3;
+   }
+
+   if (i >= argc) {
+      fprintf(stderr, "Usage: %s [-n iterations] <file or directory>...\n",
+              argv[0]);
+      return 1;
+   }
+
+   printf("%-60s %-8s %10s\n", "graph", "result", "ms");
+
+   for (; i < argc; i++) {
+      if (nftw(argv[i], bench_file, 64, FTW_PHYS) != 0) {
+         fprintf(stderr, "Error reading %s\n", argv[i]);
+         return 1;
+      }
+   }
+
+   printf("\n%u graphs, %u needing a spill, %.3f ms total\n",
+          graph_count, failed_count, total_ns / 1e6);
+
+   return 0;
+}
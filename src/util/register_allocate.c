@@ -68,19 +68,43 @@
  * up front and stored in a 2-dimensional array, so that the cost of
  * coloring a node is constant with the number of registers.  We do
  * this during ra_set_finalize().
+ *
+ * Simplification keeps the trivially colorable nodes in a worklist, and the
+ * candidates for optimistic coloring in a tree ordered by q total, so that
+ * it doesn't have to rescan the whole graph every time a node is pushed.
+ * Nodes are still pushed in the same order as a repeated scan of the graph
+ * from the last node to the first would, so the coloring doesn't depend on
+ * the size of the graph.
  */
 
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "ralloc.h"
 #include "main/imports.h"
 #include "main/macros.h"
 #include "main/mtypes.h"
 #include "util/bitset.h"
+#include "util/u_atomic.h"
+#include "util/u_math.h"
+#include "c11/threads.h"
 #include "register_allocate.h"
 
 #define NO_REG ~0U
 
+/**
+ * Largest graph for which interferences are tracked in a node by node
+ * bitset.  Past that the n^2 bits get too large, and a hash set of the
+ * edges is used instead.
+ */
+#define RA_MAX_DENSE_NODES 2048
+
 struct ra_reg {
    BITSET_WORD *conflicts;
    unsigned int *conflict_list;
@@ -125,7 +149,8 @@ struct ra_node {
    /** @{
     *
     * List of which nodes this node interferes with.  This should be
-    * symmetric with the other node.
+    * symmetric with the other node.  The adjacency bitset is NULL for
+    * graphs of more than RA_MAX_DENSE_NODES nodes, see ra_graph::edges.
     */
    BITSET_WORD *adjacency;
    unsigned int *adjacency_list;
@@ -148,7 +173,8 @@ struct ra_node {
 
    /**
     * The q total, as defined in the Runeson/Nyström paper, for all the
-    * interfering nodes not in the stack.
+    * interfering nodes.  ra_simplify() works on a copy of it, as the one
+    * of the whole graph is needed for spilling.
     */
    unsigned int q_total;
 
@@ -158,6 +184,17 @@ struct ra_node {
    float spill_cost;
 };
 
+/**
+ * Open addressing hash set of the interferences of a large graph, each
+ * stored as the higher node index in the upper 32 bits and the lower one
+ * in the lower 32 bits.  0 marks an empty slot.
+ */
+struct ra_edge_set {
+   uint64_t *edges;
+   unsigned int size;
+   unsigned int count;
+};
+
 struct ra_graph {
    struct ra_regs *regs;
    /**
@@ -175,6 +212,9 @@ struct ra_graph {
     */
    unsigned int stack_optimistic_start;
 
+   /** Interferences, for graphs too large for the adjacency bitsets. */
+   struct ra_edge_set *edges;
+
    unsigned int (*select_reg_callback)(struct ra_graph *g, BITSET_WORD *regs,
                                        void *data);
    void *select_reg_callback_data;
@@ -391,10 +431,59 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
    }
 }
 
+static uint32_t
+ra_edge_hash(uint64_t edge)
+{
+   /* Fibonacci hashing, the low bits of the node indices alone are too
+    * regular.
+    */
+   return (uint32_t)((edge * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+static bool
+ra_edge_set_add(struct ra_graph *g, unsigned int n1, unsigned int n2)
+{
+   struct ra_edge_set *set = g->edges;
+   uint64_t edge = n1 > n2 ? ((uint64_t)n1 << 32) | n2 :
+                             ((uint64_t)n2 << 32) | n1;
+   unsigned int i;
+
+   if (set->count * 2 >= set->size) {
+      uint64_t *old_edges = set->edges;
+      unsigned int old_size = set->size;
+
+      set->size *= 2;
+      set->edges = rzalloc_array(set, uint64_t, set->size);
+
+      for (i = 0; i < old_size; i++) {
+         if (old_edges[i]) {
+            unsigned int j = ra_edge_hash(old_edges[i]) & (set->size - 1);
+            while (set->edges[j])
+               j = (j + 1) & (set->size - 1);
+            set->edges[j] = old_edges[i];
+         }
+      }
+
+      ralloc_free(old_edges);
+   }
+
+   for (i = ra_edge_hash(edge) & (set->size - 1); set->edges[i];
+        i = (i + 1) & (set->size - 1)) {
+      if (set->edges[i] == edge)
+         return false;
+   }
+
+   set->edges[i] = edge;
+   set->count++;
+
+   return true;
+}
+
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
+   if (g->nodes[n1].adjacency)
+      BITSET_SET(g->nodes[n1].adjacency, n2);
 
    assert(n1 != n2);
 
@@ -427,9 +516,19 @@ ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
 
    g->stack = rzalloc_array(g, unsigned int, count);
 
+   if (count > RA_MAX_DENSE_NODES) {
+      g->edges = rzalloc(g, struct ra_edge_set);
+      g->edges->size = 1024;
+      while (g->edges->size < 4 * count)
+         g->edges->size *= 2;
+      g->edges->edges = rzalloc_array(g->edges, uint64_t, g->edges->size);
+   }
+
    for (i = 0; i < count; i++) {
-      int bitset_count = BITSET_WORDS(count);
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      if (!g->edges) {
+         int bitset_count = BITSET_WORDS(count);
+         g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
+      }
 
       g->nodes[i].adjacency_list_size = 4;
       g->nodes[i].adjacency_list =
@@ -464,34 +563,195 @@ void
 ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
-   if (n1 != n2 && !BITSET_TEST(g->nodes[n1].adjacency, n2)) {
+   if (n1 == n2)
+      return;
+
+   if (g->edges ? ra_edge_set_add(g, n1, n2) :
+                  !BITSET_TEST(g->nodes[n1].adjacency, n2)) {
       ra_add_node_adjacency(g, n1, n2);
       ra_add_node_adjacency(g, n2, n1);
    }
 }
 
+/**
+ * Simplification state: trivially colorable nodes waiting to be pushed, in
+ * the order a scan of the graph going down from the last node visits them,
+ * and the other nodes by increasing q total for optimistic coloring.
+ */
+struct ra_simplify_state {
+   void *mem_ctx;
+
+   /** q totals for the interfering nodes not in the stack yet. */
+   unsigned int *q_total;
+
+   /** Number of nodes left to push. */
+   unsigned int remaining;
+
+   /** Nodes for the current scan, all below the last node pushed. */
+   BITSET_WORD *trivial;
+
+   /** Word of the trivial bitset the current scan is at. */
+   int scan_word;
+
+   /** Last node pushed by the current scan, or UINT_MAX at its start. */
+   unsigned int scan_pos;
+
+   /** Nodes that only the next scan will get to. */
+   BITSET_WORD *trivial_next;
+   unsigned int trivial_next_count;
+
+   /**
+    * Tournament tree of the optimistic coloring candidates: leaf n, at
+    * index leaves + n, holds the key of node n and every other entry the
+    * smallest key below it.  Nodes pushed on the stack are only taken out
+    * once they make it to the root.
+    *
+    * Most graphs never need an optimistic choice, so it is only built the
+    * first time one has to be made.
+    */
+   uint64_t *tree;
+   unsigned int leaves;
+};
+
+#define RA_NO_KEY UINT64_MAX
+
 static bool
-pq_test(struct ra_graph *g, unsigned int n)
+pq_test(struct ra_graph *g, struct ra_simplify_state *s, unsigned int n)
 {
    int n_class = g->nodes[n].class;
 
-   return g->nodes[n].q_total < g->regs->classes[n_class]->p;
+   return s->q_total[n] < g->regs->classes[n_class]->p;
+}
+
+/* Lowest q total first, then the highest node index like a scan would */
+static uint64_t
+ra_optimistic_key(struct ra_simplify_state *s, unsigned int n)
+{
+   return ((uint64_t)s->q_total[n] << 32) | ~n;
 }
 
 static void
-decrement_q(struct ra_graph *g, unsigned int n)
+ra_tree_set(struct ra_simplify_state *s, unsigned int n, uint64_t key)
+{
+   unsigned int i = s->leaves + n;
+
+   s->tree[i] = key;
+
+   for (i /= 2; i > 0; i /= 2) {
+      uint64_t min = MIN2(s->tree[2 * i], s->tree[2 * i + 1]);
+
+      if (s->tree[i] == min)
+         break;
+      s->tree[i] = min;
+   }
+}
+
+/**
+ * Returns the next node of the current scan, or ~0 at the end of it.
+ */
+static unsigned int
+ra_pop_trivial_node(struct ra_simplify_state *s)
+{
+   for (; s->scan_word >= 0; s->scan_word--) {
+      BITSET_WORD word = s->trivial[s->scan_word];
+
+      if (word) {
+         unsigned int bit = util_last_bit(word) - 1;
+
+         s->trivial[s->scan_word] &= ~BITSET_BIT(bit);
+         return s->scan_word * BITSET_WORDBITS + bit;
+      }
+   }
+
+   return ~0u;
+}
+
+/**
+ * Pushes a node on the stack, removing it from the graph.  Neighbors that
+ * become trivially colorable as a result are queued, the others get their
+ * optimistic coloring key updated.
+ *
+ * Nodes which already are trivially colorable or have a register assigned
+ * won't be looked at again, so their q total is left alone.
+ */
+static void
+ra_push_node(struct ra_graph *g, struct ra_simplify_state *s, unsigned int n)
 {
    unsigned int i;
    int n_class = g->nodes[n].class;
 
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+   g->nodes[n].in_stack = true;
+   s->remaining--;
+
    for (i = 0; i < g->nodes[n].adjacency_count; i++) {
       unsigned int n2 = g->nodes[n].adjacency_list[i];
-      unsigned int n2_class = g->nodes[n2].class;
+      struct ra_class *c2;
 
-      if (!g->nodes[n2].in_stack) {
-         assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
-         g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+      if (g->nodes[n2].in_stack || g->nodes[n2].reg != NO_REG)
+         continue;
+
+      c2 = g->regs->classes[g->nodes[n2].class];
+      if (s->q_total[n2] < c2->p)
+         continue;
+
+      assert(s->q_total[n2] >= c2->q[n_class]);
+      s->q_total[n2] -= c2->q[n_class];
+
+      if (s->q_total[n2] < c2->p) {
+         if (n2 < s->scan_pos) {
+            BITSET_SET(s->trivial, n2);
+         } else {
+            BITSET_SET(s->trivial_next, n2);
+            s->trivial_next_count++;
+         }
+      } else if (s->tree) {
+         /* Keys only go down, so the tree just needs fixing up to the first
+          * entry that is already lower.
+          */
+         uint64_t key = ra_optimistic_key(s, n2);
+         unsigned int j = s->leaves + n2;
+
+         for (s->tree[j] = key, j /= 2; j > 0 && s->tree[j] > key; j /= 2)
+            s->tree[j] = key;
+      }
+   }
+}
+
+/**
+ * Returns the node with the lowest q total.
+ */
+static unsigned int
+ra_pop_optimistic_node(struct ra_graph *g, struct ra_simplify_state *s)
+{
+   unsigned int i;
+
+   if (!s->tree) {
+      s->leaves = 1;
+      while (s->leaves < g->count)
+         s->leaves *= 2;
+      s->tree = ralloc_array(s->mem_ctx, uint64_t, 2 * s->leaves);
+
+      for (i = 0; i < s->leaves; i++) {
+         bool candidate = i < g->count && !g->nodes[i].in_stack &&
+                          g->nodes[i].reg == NO_REG;
+
+         s->tree[s->leaves + i] =
+            candidate ? ra_optimistic_key(s, i) : RA_NO_KEY;
       }
+      for (i = s->leaves - 1; i > 0; i--)
+         s->tree[i] = MIN2(s->tree[2 * i], s->tree[2 * i + 1]);
+   }
+
+   for (;;) {
+      unsigned int n = ~(uint32_t)s->tree[1];
+
+      assert(s->tree[1] != RA_NO_KEY);
+      ra_tree_set(s, n, RA_NO_KEY);
+
+      if (!g->nodes[n].in_stack)
+         return n;
    }
 }
 
@@ -508,47 +768,66 @@ decrement_q(struct ra_graph *g, unsigned int n)
 static void
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
+   struct ra_simplify_state s;
    unsigned int stack_optimistic_start = UINT_MAX;
-   int i;
-
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
-
-      progress = false;
-
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
-
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
+   unsigned int i;
+
+   memset(&s, 0, sizeof(s));
+   s.mem_ctx = ralloc_context(NULL);
+   s.scan_pos = UINT_MAX;
+
+   s.q_total = ralloc_array(s.mem_ctx, unsigned int, g->count);
+   s.trivial = rzalloc_array(s.mem_ctx, BITSET_WORD, BITSET_WORDS(g->count));
+   s.trivial_next = rzalloc_array(s.mem_ctx, BITSET_WORD,
+                                  BITSET_WORDS(g->count));
+   s.scan_word = BITSET_WORDS(g->count) - 1;
+
+   for (i = 0; i < g->count; i++) {
+      s.q_total[i] = g->nodes[i].q_total;
+
+      if (!g->nodes[i].in_stack && g->nodes[i].reg == NO_REG) {
+         s.remaining++;
+         if (pq_test(g, &s, i))
+            BITSET_SET(s.trivial, i);
       }
+   }
+
+   for (;;) {
+      unsigned int n = ra_pop_trivial_node(&s);
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
-            stack_optimistic_start = g->stack_count;
+      if (n != ~0u) {
+         s.scan_pos = n;
+         ra_push_node(g, &s, n);
+         continue;
+      }
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
+      if (s.trivial_next_count) {
+         BITSET_WORD *tmp = s.trivial;
+         s.trivial = s.trivial_next;
+         s.trivial_next = tmp;
+         s.trivial_next_count = 0;
+         s.scan_word = BITSET_WORDS(g->count) - 1;
+         s.scan_pos = UINT_MAX;
+         continue;
       }
+
+      if (s.remaining == 0)
+         break;
+
+      /* Nothing is trivially colorable any more. */
+      n = ra_pop_optimistic_node(g, &s);
+
+      if (stack_optimistic_start == UINT_MAX)
+         stack_optimistic_start = g->stack_count;
+
+      /* The next scan starts over from the top of the graph. */
+      s.scan_word = BITSET_WORDS(g->count) - 1;
+      s.scan_pos = UINT_MAX;
+      ra_push_node(g, &s, n);
    }
 
+   ralloc_free(s.mem_ctx);
+
    g->stack_optimistic_start = stack_optimistic_start;
 }
 
@@ -677,9 +956,215 @@ ra_select(struct ra_graph *g)
    return true;
 }
 
+/**
+ * Writes the register set and the interference graph out as text, in the
+ * format ra_read_graph() reads back.  The select_reg callback can't be
+ * saved, replays use the default register selection.
+ */
+void
+ra_write_graph(struct ra_graph *g, FILE *f)
+{
+   struct ra_regs *regs = g->regs;
+   unsigned int i, j;
+   BITSET_WORD tmp;
+   int r;
+
+   fprintf(f, "ra_graph 2\n");
+   fprintf(f, "regs %u %u %u\n", regs->count, regs->round_robin,
+           regs->class_count);
+
+   for (i = 0; i < regs->count; i++) {
+      fprintf(f, "conflicts %u", i);
+      BITSET_FOREACH_SET(r, tmp, regs->regs[i].conflicts, regs->count)
+         fprintf(f, " %d", r);
+      fprintf(f, " -1\n");
+   }
+
+   for (i = 0; i < regs->class_count; i++) {
+      fprintf(f, "class %u", i);
+      BITSET_FOREACH_SET(r, tmp, regs->classes[i]->regs, regs->count)
+         fprintf(f, " %d", r);
+      fprintf(f, " -1\n");
+
+      fprintf(f, "q %u", i);
+      for (j = 0; j < regs->class_count; j++)
+         fprintf(f, " %u", regs->classes[i]->q[j]);
+      fprintf(f, "\n");
+   }
+
+   fprintf(f, "nodes %u\n", g->count);
+
+   for (i = 0; i < g->count; i++) {
+      /* Spill costs are written as their bits, MSVC doesn't know %a. */
+      fprintf(f, "node %u %u %d %08x\n", i, g->nodes[i].class,
+              g->nodes[i].reg == NO_REG ? -1 : (int)g->nodes[i].reg,
+              fui(g->nodes[i].spill_cost));
+   }
+
+   /* Adjacency lists are written in order as that order decides the one
+    * nodes get pushed in.
+    */
+   for (i = 0; i < g->count; i++) {
+      fprintf(f, "adjacency %u %u", i, g->nodes[i].adjacency_count);
+      for (j = 0; j < g->nodes[i].adjacency_count; j++)
+         fprintf(f, " %u", g->nodes[i].adjacency_list[j]);
+      fprintf(f, "\n");
+   }
+}
+
+/**
+ * Reads a graph written by ra_write_graph().  The graph owns a new copy of
+ * the register set, freeing the graph frees both.
+ *
+ * Returns NULL if the input isn't a graph.
+ */
+struct ra_graph *
+ra_read_graph(FILE *f)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   struct ra_regs *regs;
+   struct ra_graph *g = NULL;
+   unsigned int version, count, round_robin, class_count;
+   unsigned int **q_values;
+   unsigned int i, j, n;
+   int r;
+
+   if (fscanf(f, " ra_graph %u", &version) != 1 || version != 2 ||
+       fscanf(f, " regs %u %u %u", &count, &round_robin, &class_count) != 3)
+      goto fail;
+
+   regs = ra_alloc_reg_set(mem_ctx, count, false);
+   if (round_robin)
+      ra_set_allocate_round_robin(regs);
+
+   for (i = 0; i < count; i++) {
+      if (fscanf(f, " conflicts %u", &n) != 1 || n != i)
+         goto fail;
+      while (fscanf(f, " %d", &r) == 1 && r >= 0) {
+         if (r >= count)
+            goto fail;
+         BITSET_SET(regs->regs[i].conflicts, r);
+      }
+   }
+
+   q_values = ralloc_array(mem_ctx, unsigned int *, class_count);
+
+   for (i = 0; i < class_count; i++) {
+      if (fscanf(f, " class %u", &n) != 1 || n != i ||
+          ra_alloc_reg_class(regs) != i)
+         goto fail;
+      while (fscanf(f, " %d", &r) == 1 && r >= 0) {
+         if (r >= count)
+            goto fail;
+         ra_class_add_reg(regs, i, r);
+      }
+
+      q_values[i] = ralloc_array(q_values, unsigned int, class_count);
+      if (fscanf(f, " q %u", &n) != 1 || n != i)
+         goto fail;
+      for (j = 0; j < class_count; j++) {
+         if (fscanf(f, " %u", &q_values[i][j]) != 1)
+            goto fail;
+      }
+   }
+
+   ra_set_finalize(regs, q_values);
+
+   if (fscanf(f, " nodes %u", &count) != 1)
+      goto fail;
+
+   g = ra_alloc_interference_graph(regs, count);
+   ralloc_steal(g, regs);
+
+   for (i = 0; i < count; i++) {
+      unsigned int class, spill_cost;
+
+      if (fscanf(f, " node %u %u %d %x", &n, &class, &r, &spill_cost) != 4 ||
+          n != i || class >= class_count || r >= (int)regs->count)
+         goto fail;
+
+      ra_set_node_class(g, i, class);
+      if (r >= 0)
+         ra_set_node_reg(g, i, r);
+      ra_set_node_spill_cost(g, i, uif(spill_cost));
+   }
+
+   for (i = 0; i < count; i++) {
+      unsigned int adjacency_count, n2;
+
+      if (fscanf(f, " adjacency %u %u", &n, &adjacency_count) != 2 || n != i)
+         goto fail;
+
+      for (j = 0; j < adjacency_count; j++) {
+         if (fscanf(f, " %u", &n2) != 1 || n2 >= count || n2 == i)
+            goto fail;
+
+         /* Both directions are in the file, so only add this one. */
+         if (g->edges)
+            ra_edge_set_add(g, i, n2);
+         ra_add_node_adjacency(g, i, n2);
+      }
+   }
+
+   ralloc_free(mem_ctx);
+
+   return g;
+
+fail:
+   ralloc_free(g);
+   ralloc_free(mem_ctx);
+
+   return NULL;
+}
+
+static const char *ra_record_dir;
+static once_flag ra_record_once_flag = ONCE_FLAG_INIT;
+
+static void
+ra_record_init(void)
+{
+   ra_record_dir = getenv("MESA_RA_RECORD_DIR");
+}
+
+/**
+ * Saves every graph allocated by the process in MESA_RA_RECORD_DIR, for
+ * replaying with ra_bench.
+ */
+static void
+ra_record_graph(struct ra_graph *g)
+{
+   static unsigned int graph_count;
+   char *filename;
+   FILE *f;
+
+   call_once(&ra_record_once_flag, ra_record_init);
+   if (ra_record_dir == NULL)
+      return;
+
+#ifdef _WIN32
+   int pid = _getpid();
+#else
+   int pid = getpid();
+#endif
+
+   filename = ralloc_asprintf(NULL, "%s/ra-%d-%u.txt", ra_record_dir, pid,
+                              p_atomic_inc_return(&graph_count));
+   f = fopen(filename, "w");
+   if (f) {
+      ra_write_graph(g, f);
+      fclose(f);
+   } else {
+      fprintf(stderr, "Failed to record register allocation graph in %s\n",
+              filename);
+   }
+
+   ralloc_free(filename);
+}
+
 bool
 ra_allocate(struct ra_graph *g)
 {
+   ra_record_graph(g);
    ra_simplify(g);
    return ra_select(g);
 }
@@ -713,23 +1198,18 @@ ra_set_node_reg(struct ra_graph *g, unsigned int n, unsigned int reg)
 static float
 ra_get_spill_benefit(struct ra_graph *g, unsigned int n)
 {
-   unsigned int j;
-   float benefit = 0;
    int n_class = g->nodes[n].class;
 
    /* Define the benefit of eliminating an interference between n, n2
     * through spilling as q(C, B) / p(C).  This is similar to the
     * "count number of edges" approach of traditional graph coloring,
     * but takes classes into account.
+    *
+    * Summed over all the interferences of the node, that is its q total
+    * over p(C), so picking a node to spill doesn't have to walk the
+    * adjacency lists.
     */
-   for (j = 0; j < g->nodes[n].adjacency_count; j++) {
-      unsigned int n2 = g->nodes[n].adjacency_list[j];
-      unsigned int n2_class = g->nodes[n2].class;
-      benefit += ((float)g->regs->classes[n_class]->q[n2_class] /
-                  g->regs->classes[n_class]->p);
-   }
-
-   return benefit;
+   return (float)g->nodes[n].q_total / g->regs->classes[n_class]->p;
 }
 
 /**
@@ -29,6 +29,7 @@
 #define REGISTER_ALLOCATE_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "util/bitset.h"
 
 #ifdef __cplusplus
@@ -93,6 +94,11 @@ void ra_set_node_spill_cost(struct ra_graph *g, unsigned int n, float cost);
 int ra_get_best_spill_node(struct ra_graph *g);
 /** @} */
 
+/** @{ Recording graphs to replay them outside of the driver */
+void ra_write_graph(struct ra_graph *g, FILE *f);
+struct ra_graph *ra_read_graph(FILE *f);
+/** @} */
+
 
 #ifdef __cplusplus
 }  // extern "C"
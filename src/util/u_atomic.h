@@ -49,6 +49,8 @@
 #define p_atomic_inc_return(v) __atomic_add_fetch((v), 1, __ATOMIC_ACQ_REL)
 #define p_atomic_dec_return(v) __atomic_sub_fetch((v), 1, __ATOMIC_ACQ_REL)
 #define p_atomic_xchg(v, i) __atomic_exchange_n((v), (i), __ATOMIC_ACQ_REL)
+#define p_atomic_acquire_fence() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define p_atomic_release_fence() __atomic_thread_fence(__ATOMIC_RELEASE)
 #define PIPE_NATIVE_ATOMIC_XCHG
 
 #else
@@ -61,6 +63,8 @@
 #define p_atomic_add(v, i) (void) __sync_add_and_fetch((v), (i))
 #define p_atomic_inc_return(v) __sync_add_and_fetch((v), 1)
 #define p_atomic_dec_return(v) __sync_sub_and_fetch((v), 1)
+#define p_atomic_acquire_fence() __sync_synchronize()
+#define p_atomic_release_fence() __sync_synchronize()
 
 #endif
 
@@ -91,6 +95,8 @@
 #define p_atomic_inc_return(_v) (++(*(_v)))
 #define p_atomic_dec_return(_v) (--(*(_v)))
 #define p_atomic_cmpxchg(_v, _old, _new) (*(_v) == (_old) ? (*(_v) = (_new), (_old)) : *(_v))
+#define p_atomic_acquire_fence() ((void) 0)
+#define p_atomic_release_fence() ((void) 0)
 
 #endif
 
@@ -121,6 +127,17 @@
 #define p_atomic_set(_v, _i) (*(_v) = (_i))
 #define p_atomic_read(_v) (*(_v))
 
+/* x86 doesn't reorder loads with loads nor stores with stores, only the
+ * compiler has to be kept from doing it.
+ */
+#if defined(_M_IX86) || defined(_M_X64)
+#define p_atomic_acquire_fence() _ReadWriteBarrier()
+#define p_atomic_release_fence() _ReadWriteBarrier()
+#else
+#define p_atomic_acquire_fence() MemoryBarrier()
+#define p_atomic_release_fence() MemoryBarrier()
+#endif
+
 #define p_atomic_dec_zero(_v) \
    (p_atomic_dec_return(_v) == 0)
 
@@ -167,6 +184,8 @@
 
 #define p_atomic_set(_v, _i) (*(_v) = (_i))
 #define p_atomic_read(_v) (*(_v))
+#define p_atomic_acquire_fence() membar_consumer()
+#define p_atomic_release_fence() membar_producer()
 
 #define p_atomic_dec_zero(v) (\
    sizeof(*v) == sizeof(uint8_t)  ? atomic_dec_8_nv ((uint8_t  *)(v)) == 0 : \
@@ -223,6 +242,13 @@
 #error "No pipe_atomic implementation selected"
 #endif
 
+/* p_atomic_set() and p_atomic_read() only order the accesses around them
+ * with the __atomic builtins.  To publish data through a flag or pointer
+ * on every platform, put p_atomic_release_fence() between writing the data
+ * and p_atomic_set(), and p_atomic_acquire_fence() between p_atomic_read()
+ * and reading the data.
+ */
+
 #ifndef PIPE_NATIVE_ATOMIC_XCHG
 static inline uint32_t p_atomic_xchg_32(uint32_t *v, uint32_t i)
 {
@@ -256,6 +256,12 @@ struct util_queue_monitoring
    unsigned num_offloaded_items;
    unsigned num_direct_items;
    unsigned num_syncs;
+
+   /* Optional breakdown of num_syncs by the call that caused them, indexed
+    * by a caller-defined call number below num_calls.  NULL if disabled.
+    */
+   unsigned *num_syncs_per_call;
+   unsigned num_calls;
 };
 
 #ifdef __cplusplus
@@ -69,6 +69,22 @@ static inline void u_thread_setname( const char *name )
    (void)name;
 }
 
+/**
+ * Bind the calling thread to the given CPU.  Does nothing on platforms
+ * where this isn't supported.
+ */
+static inline void u_thread_pin_to_cpu( unsigned cpu )
+{
+#if defined(__linux__) && defined(HAVE_PTHREAD) && defined(CPU_SET)
+   cpu_set_t set;
+
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+   (void)cpu;
+}
+
 /*
  * Thread statistics.
  */